@@ -0,0 +1,179 @@
+#!/bin/bash
+# one benchmark of all engines on a shared workload(see README.txt)
+# usage: ./bench.sh [spec] [work dir]
+#	spec = bench.spec by default, work dir = bench_<graph name> next to this script
+#	the workload(workload.cpp) is generated from the spec, every engine is built once(DistIdx once per density)
+#	and answers every (density, K, stratum) query file; one CSV row each in work dir/bench.csv:
+#	engine,density,k,stratum,queries,build_ms,index_bytes,p50_us,p99_us,qps,mismatches
+#	build_ms = wall time of the builder(s), p50/p99/qps from the engine's JSON stats(../common/query_stats.h),
+#	mismatches = queries whose distances differ from the dijkstra truth
+#	(exact for the integer engines, 1e-3 relative for the float ones, ROAD and DistIdx)
+#	with LOAD_RATES in the spec, also work dir/load.csv: the latency of every engine with a server mode at each
+#	arrival rate(loadgen.cpp, open loop), one row per engine and rate
+# env: THREADS = build threads, binaries WORKLOAD, GTREE_BUILD, GTREE_QUERY, GPTREE, ROAD_BIN(dir), SILC, CH_BUILD, CH_QUERY,
+#	LOADGEN
+HERE=$(cd $(dirname $0); pwd)
+SPEC=${1:-$HERE/bench.spec}
+. $SPEC || exit 1
+case $GRAPH in /*) ;; *) GRAPH=$(cd $(dirname $SPEC); pwd)/$GRAPH ;; esac
+WORK=${2:-$HERE/bench_$(basename $GRAPH)}
+THREADS=${THREADS:-$(nproc)}
+WORKLOAD=${WORKLOAD:-$HERE/workload}
+GTREE_BUILD=${GTREE_BUILD:-$HERE/../gtree/gtree_build}
+GTREE_QUERY=${GTREE_QUERY:-$HERE/../gtree/gtree_query}
+GPTREE=${GPTREE:-$HERE/../gtree_new_p2p/gptree}
+ROAD_BIN=${ROAD_BIN:-$HERE/../road/bin}
+SILC=${SILC:-$HERE/../silc/silc}
+CH_BUILD=${CH_BUILD:-$HERE/../ch/ch_build}
+CH_QUERY=${CH_QUERY:-$HERE/../ch/ch_query}
+LOADGEN=${LOADGEN:-$HERE/loadgen}
+
+mkdir -p $WORK && cd $WORK || exit 1
+$WORKLOAD -n $GRAPH -w w -p $DENSITIES -k $KS -t $STRATA -q $QUERIES -r $SEED -d ${DIST:-uniform} -j $THREADS > workload.log || exit 1
+grep GRAPH workload.log
+
+now_ms(){ echo $(( $(date +%s%N) / 1000000 )); }
+bytes(){ local s=0 f; for f in "$@"; do s=$(( s + $(stat -c %s $f) )); done; echo $s; }
+
+# ----- engines -----
+# have_E: binaries present, build_E density: sets BUILD_MS, INDEX_BYTES(only rebuilt when it depends on the density)
+# query_E density query: answers on stdout, stats in stats.json, SCALE/TOL: distances to the truth grid
+have_gtree(){ [ -x $GTREE_BUILD ] && [ -x $GTREE_QUERY ]; }
+build_gtree(){
+	[ -n "$GTREE_DONE" ] && return
+	local t=$(now_ms)
+	$GTREE_BUILD -n w -j $THREADS > gtree.build.log || return 1
+	BUILD_MS=$(( $(now_ms) - t )); INDEX_BYTES=$(bytes w.gidx); GTREE_DONE=1
+}
+query_gtree(){ cp w.o$1.object w.object; $GTREE_QUERY -n w -s stats.json < $2; }
+# serve_E density: the engine's server on $LOAD_ADDR in the background, its pid in SERVER_PID, a line LISTENING in E.serve.log
+serve_gtree(){ cp w.o$1.object w.object; $GTREE_QUERY -n w -l $LOAD_ADDR -t $THREADS > gtree.serve.log 2>&1 & SERVER_PID=$!; }
+
+have_gptree(){ [ -x $GPTREE ]; }
+build_gptree(){
+	[ -n "$GPTREE_DONE" ] && return
+	local t=$(now_ms)
+	$GPTREE -e w.gpedge -i w.gptree > gptree.build.log || return 1
+	BUILD_MS=$(( $(now_ms) - t )); INDEX_BYTES=$(bytes w.gptree); GPTREE_DONE=1; GPTREE_MS=$BUILD_MS
+}
+query_gptree(){ $GPTREE -l -e w.gpedge -i w.gptree -o w.o$1.object -w $2 -s stats.json; }
+
+# G*-Tree index, every query routed by the planner(../common/planner.h) to G*-Tree or a local expansion,
+# w.o<d>.plan = cost models calibrated on the first query file of density d(outside the timed queries)
+have_plan(){ have_gptree; }
+build_plan(){
+	rm -f w.o$1.plan
+	build_gptree || return 1
+	BUILD_MS=$GPTREE_MS; INDEX_BYTES=$(bytes w.gptree)
+}
+query_plan(){ $GPTREE -l -e w.gpedge -i w.gptree -o w.o$1.object -w $2 -s stats.json -P w.o$1.plan; }
+
+have_road(){ [ -x $ROAD_BIN/hiergraphloader ] && [ -x $ROAD_BIN/bench_nn ]; }
+build_road(){
+	[ -n "$ROAD_DONE" ] && return
+	local t=$(now_ms)
+	$ROAD_BIN/hiergraphloader -n w.cnode -e w.cedge -t $ROAD_T -l $ROAD_L -h w.road.idx > road.build.log 2>&1 || return 1
+	BUILD_MS=$(( $(now_ms) - t )); INDEX_BYTES=$(bytes w.road.idx); ROAD_DONE=1
+}
+query_road(){ $ROAD_BIN/bench_nn -h w.road.idx -o w.o$1.object -w $2 -s stats.json 2> /dev/null; }
+
+# the distance index holds the objects, one per density over one graph index
+have_distidx(){ [ -x $ROAD_BIN/graphobjloader ] && [ -x $ROAD_BIN/distidxloader ] && [ -x $ROAD_BIN/bench_nn ]; }
+build_distidx(){
+	local t=$(now_ms)
+	if [ -z "$DISTIDX_GRAPH_MS" ]; then
+		$ROAD_BIN/graphobjloader -n w.cnode -e w.cedge -i w.graph.idx -m 0 -c 0 -o /dev/null > distidx.build.log 2>&1 || return 1
+		DISTIDX_GRAPH_MS=$(( $(now_ms) - t ))
+		t=$(now_ms)
+	fi
+	$ROAD_BIN/distidxloader -i w.graph.idx -o w.o$1.object -d w.o$1.didx >> distidx.build.log 2>&1 || return 1
+	BUILD_MS=$(( $(now_ms) - t + DISTIDX_GRAPH_MS )); INDEX_BYTES=$(bytes w.graph.idx w.o$1.didx)
+}
+query_distidx(){ $ROAD_BIN/bench_nn -i w.graph.idx -d w.o$1.didx -w $2 -s stats.json 2> /dev/null; }
+
+have_silc(){ [ -x $SILC ]; }
+build_silc(){
+	[ -n "$SILC_DONE" ] && return
+	local t=$(now_ms)
+	$SILC w.cnode w.cedge 100000 w.morton 1 > silc.build.log || return 1
+	BUILD_MS=$(( $(now_ms) - t )); INDEX_BYTES=$(bytes w.morton w.morton.idx w.morton.lambda); SILC_DONE=1
+	sed -n 's/^BLOCKS=/SILC BLOCKS=/p' silc.build.log
+}
+query_silc(){ $SILC w.cnode w.cedge 100000 w.morton 0 w.o$1.object $2 stats.json; }
+
+have_ch(){ [ -x $CH_BUILD ] && [ -x $CH_QUERY ]; }
+build_ch(){
+	[ -n "$CH_DONE" ] && return
+	local t=$(now_ms)
+	$CH_BUILD -n w -j $THREADS > ch.build.log || return 1
+	BUILD_MS=$(( $(now_ms) - t )); INDEX_BYTES=$(bytes w.ch); CH_DONE=1
+}
+query_ch(){ $CH_QUERY -n w -o w.o$1.object -w $2 -s stats.json; }
+
+# queries of engine output $2 off the truth $1, answers scaled by $3, relative tolerance $4
+mismatches(){
+	awk -v scale=$3 -v tol=$4 '
+	FNR == NR { n++; k[n] = $2; for ( i = 3; i <= NF; i++ ) t[n, i - 2] = $i; next }
+	/^ID=/ { split( $2, a, "=" ); c++; d[c] = a[2] * scale; next }
+	/"KNN_SEARCH" RESULT:.*0.01MS/ {
+		q++
+		for ( i = 2; i <= c; i++ ){ v = d[i]; for ( j = i - 1; j > 0 && d[j] > v; j-- ) d[j+1] = d[j]; d[j+1] = v }
+		ok = c == k[q]
+		for ( i = 1; ok && i <= c; i++ ){ e = d[i] - t[q, i]; if ( e < 0 ) e = -e; if ( e > tol * t[q, i] + 0.5 ) ok = 0 }
+		bad += ! ok
+		c = 0
+	}
+	END{ print bad + ( n > q ? n - q : 0 ) }' $1 $2
+}
+
+# p50, p99, qps of the "total" phase in stats.json
+stats_row(){
+	local line=$(grep '"total": { "count"' stats.json)
+	local count=$(echo "$line" | sed 's/.*"count": \([0-9]*\).*/\1/')
+	local sum=$(echo "$line" | sed 's/.*"sum_us": \([0-9.]*\).*/\1/')
+	local p50=$(echo "$line" | sed 's/.*"p50_us": \([0-9.]*\).*/\1/')
+	local p99=$(echo "$line" | sed 's/.*"p99_us": \([0-9.]*\).*/\1/')
+	awk -v c=$count -v s=$sum -v p50=$p50 -v p99=$p99 'BEGIN{ printf "%s,%s,%.1f", p50, p99, ( s > 0 ? c * 1e6 / s : 0 ) }'
+}
+
+CSV=bench.csv
+echo "engine,density,k,stratum,queries,build_ms,index_bytes,p50_us,p99_us,qps,mismatches" > $CSV
+for E in $ENGINES; do
+	if ! have_$E; then
+		echo "SKIP $E: NO BINARY"
+		continue
+	fi
+	SCALE=1; TOL=0
+	case $E in road|distidx) SCALE=100000; TOL=0.001 ;; esac
+	for D in ${DENSITIES//,/ }; do
+		if ! build_$E $D; then
+			echo "SKIP $E: BUILD FAILED(see $WORK/$E.build.log)"
+			continue 2
+		fi
+		for K in ${KS//,/ }; do
+			for (( S = 0; S < STRATA; S++ )); do
+				W=w.o$D.k$K.s$S
+				rm -f stats.json
+				query_$E $D $W.query > $E.out
+				[ -f stats.json ] || { echo "SKIP $E $W: NO STATS"; continue; }
+				echo "$E,$D,$K,$S,$(wc -l < $W.query),$BUILD_MS,$INDEX_BYTES,$(stats_row),$(mismatches $W.truth $E.out $SCALE $TOL)" | tee -a $CSV
+			done
+		done
+	done
+done
+
+# ----- load curve -----
+LOAD_ADDR=unix:$WORK/load.sock
+if [ -n "$LOAD_RATES" ] && [ -x $LOADGEN ]; then
+	rm -f load.csv
+	D=${DENSITIES%%,*}; K=${KS%%,*}
+	cat w.o$D.k$K.s*.query > load.query
+	for E in $ENGINES; do
+		type serve_$E > /dev/null 2>&1 && have_$E && build_$E $D || continue
+		serve_$E $D
+		for (( i = 0; i < 600; i++ )); do grep -q LISTENING $E.serve.log 2> /dev/null && break; sleep 0.1; done
+		$LOADGEN -a $LOAD_ADDR -q load.query -r $LOAD_RATES -d $LOAD_SECONDS -c $LOAD_CONNS -e $E -o load.csv
+		kill $SERVER_PID; wait $SERVER_PID 2> /dev/null
+	done
+fi
+awk -F, 'NR > 1 && $11 > 0 { bad += $11 } END{ if ( bad ) print "MISMATCHES: " bad " queries, see " FILENAME; else print "ALL ENGINES AGREE WITH THE TRUTH" }' $CSV
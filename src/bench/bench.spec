@@ -0,0 +1,23 @@
+# benchmark workload spec, sourced by bench.sh(bash syntax)
+# graph = name of .cnode/.cedge, relative to src/bench or absolute
+GRAPH=../gtree/cal
+# object densities, fraction of the vertices
+DENSITIES=0.001,0.01,0.1
+KS=1,10,50
+# distance strata per (density, K), queries per stratum
+STRATA=4
+QUERIES=100
+SEED=1
+# object distribution: uniform, cluster:C[,F](C network clusters) or hotspot:H[,F](H gaussian hotspots),
+# see workload.cpp
+DIST=uniform
+# plan = G*-Tree behind the density-aware planner(../common/planner.h)
+ENGINES="gtree gptree plan road distidx silc ch"
+# load curve(loadgen.cpp, load.csv) of the engines with a server mode: arrival rates(queries per second,
+# empty = no curve), seconds per rate, client connections; the trace is every stratum of the first density and K
+LOAD_RATES=
+LOAD_SECONDS=5
+LOAD_CONNS=4
+# ROAD hierarchy: fanout(-t) and levels(-l) of hiergraphloader
+ROAD_T=4
+ROAD_L=8
@@ -0,0 +1,315 @@
+// open loop load generator for the server mode(gtree_query -l, see SERVER in ../gtree/gtree_query.cpp)
+//
+// the stdin loops and query files of the engines are closed loop: the next query waits for the answer
+// of the last one, so they measure service time and never a queue. this sends a query trace at a fixed
+// arrival rate instead, whatever the server does meanwhile, over -c connections(pipelined, the framing
+// of SERVER: request "tag layer locid K maxdist", response "tag count (id dis)*"), and reports latency
+// at each rate of -r, a throughput vs. tail latency curve.
+//
+// arrivals: poisson(exponential gaps at the rate) or bursty(poisson bursts of -b queries sent at once,
+// the same mean rate). the schedule of every query is fixed before the step starts.
+// coordinated omission: a sender that is late(the socket is full, the server stopped reading) sends
+// the queries it owes at once, and every latency is counted from the query's scheduled time, not from
+// when it went out, so a stall shows up in all the queries it delayed. the latency from the actual
+// send(what a closed loop client would see) is reported next to it as SENT_P99.
+//
+// options: -a addr = server, "unix:path" or "[host:]port"(default 127.0.0.1:7000)
+//          -q file = trace, "locid K [layer [maxdist]]" lines(workload .query files), replayed in a loop
+//          -g N = synthetic trace instead: uniform random locids of N vertices, K of -k(default 10)
+//          -r q1,q2,.. = target rates, queries per second(default 1000), one step each
+//          -d s = seconds per step(default 5), -w s = wait for late answers after a step(default 10)
+//          -c N = connections(default 4), -m poisson|bursty, -b N = queries per burst(default 16)
+//          -e name = engine label of the rows, -o file = rows appended as CSV, -s N = seed
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<math.h>
+#include<errno.h>
+#include<unistd.h>
+#include<sys/socket.h>
+#include<sys/un.h>
+#include<netinet/in.h>
+#include<netinet/tcp.h>
+#include<arpa/inet.h>
+#include<vector>
+#include<string>
+#include<thread>
+#include<atomic>
+#include "../common/query_stats.h"
+using namespace std;
+
+#define LOAD_START_NS 100000000LL // schedule starts this long after the connections are up
+#define LOAD_FRAME_INTS 5
+
+typedef struct{
+	int layer, locid, K, maxdist;
+}TraceQuery;
+
+vector<TraceQuery> trace;
+string addr = "127.0.0.1:7000", engine = "gtree";
+int conns = 4, burst = 16, seed = 1;
+double seconds = 5, wait_seconds = 10;
+bool bursty = false;
+
+// per step
+vector<long long> due, sent; // scheduled and actual send time of each query, ns
+vector< atomic<int> > done_flag( 0 );
+
+typedef struct{
+	StatsHist due_hist, sent_hist; // latency from the schedule, from the send
+	long long answered, errors, last;
+}ConnResult;
+
+// connected socket to addr, -1 on error
+int load_connect( const char* addr ){
+	int fd;
+	if ( strncmp( addr, "unix:", 5 ) == 0 ){
+		struct sockaddr_un sa;
+		memset( &sa, 0, sizeof(sa) );
+		sa.sun_family = AF_UNIX;
+		if ( strlen( addr + 5 ) >= sizeof(sa.sun_path) ) return -1;
+		strcpy( sa.sun_path, addr + 5 );
+		fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+		if ( fd < 0 ) return -1;
+		if ( connect( fd, (struct sockaddr*) &sa, sizeof(sa) ) != 0 ){
+			close( fd );
+			return -1;
+		}
+		return fd;
+	}
+	struct sockaddr_in sa;
+	memset( &sa, 0, sizeof(sa) );
+	sa.sin_family = AF_INET;
+	sa.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+	const char* port = strrchr( addr, ':' );
+	if ( port != NULL ){
+		string host( addr, port - addr );
+		if ( inet_pton( AF_INET, host.c_str(), &sa.sin_addr ) != 1 ) return -1;
+		port ++;
+	}
+	else port = addr;
+	sa.sin_port = htons( atoi( port ) );
+	fd = socket( AF_INET, SOCK_STREAM, 0 );
+	if ( fd < 0 ) return -1;
+	if ( connect( fd, (struct sockaddr*) &sa, sizeof(sa) ) != 0 ){
+		close( fd );
+		return -1;
+	}
+	int on = 1;
+	setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on) );
+	return fd;
+}
+
+bool send_full( int fd, const char* p, long long size ){
+	while( size > 0 ){
+		ssize_t n = send( fd, p, size, MSG_NOSIGNAL );
+		if ( n < 0 && errno == EINTR ) continue;
+		if ( n <= 0 ) return false;
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+bool recv_full( int fd, char* p, long long size ){
+	while( size > 0 ){
+		ssize_t n = recv( fd, p, size, 0 );
+		if ( n < 0 && errno == EINTR ) continue;
+		if ( n <= 0 ) return false;
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+void sleep_until( long long t ){
+	struct timespec ts;
+	ts.tv_sec = t / 1000000000LL;
+	ts.tv_nsec = t % 1000000000LL;
+	while( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL ) == EINTR );
+}
+
+// queries c, c + conns, .. of the step at their scheduled times, late ones at once
+void load_sender( int fd, int c ){
+	int frame[LOAD_FRAME_INTS];
+	for ( int i = c; i < due.size(); i += conns ){
+		if ( stats_now() < due[i] ) sleep_until( due[i] );
+		const TraceQuery &q = trace[ i % trace.size() ];
+		frame[0] = i;
+		frame[1] = q.layer;
+		frame[2] = q.locid;
+		frame[3] = q.K;
+		frame[4] = q.maxdist;
+		sent[i] = stats_now();
+		if ( ! send_full( fd, (const char*) frame, sizeof(frame) ) ) break;
+	}
+}
+
+// answers of one connection until all its queries are in or the deadline passes(the socket times out)
+void load_receiver( int fd, int c, ConnResult &r ){
+	int expect = 0;
+	for ( int i = c; i < due.size(); i += conns ) expect ++;
+	vector<int> body;
+	while( r.answered + r.errors < expect ){
+		int head[2];
+		if ( ! recv_full( fd, (char*) head, sizeof(head) ) ) break;
+		long long now = stats_now();
+		if ( head[1] > 0 ){
+			body.resize( head[1] * 2 );
+			if ( ! recv_full( fd, (char*) &body[0], (long long) body.size() * sizeof(int) ) ) break;
+		}
+		int i = head[0];
+		if ( i < 0 || i >= due.size() || i % conns != c || done_flag[i].exchange( 1 ) ) break;
+		if ( head[1] < 0 ){
+			r.errors ++;
+			continue;
+		}
+		r.answered ++;
+		r.last = now;
+		stats_hist_add( r.due_hist, now - due[i] );
+		stats_hist_add( r.sent_hist, now - sent[i] );
+	}
+}
+
+// one step at rate qps, a row on stdout and in csv
+void load_step( double qps, FILE* csv ){
+	long long n = (long long)( qps * seconds + 0.5 );
+	if ( n < 1 ) n = 1;
+	due.assign( n, 0 );
+	sent.assign( n, 0 );
+	vector< atomic<int> > flags( n );
+	for ( long long i = 0; i < n; i++ ) flags[i] = 0;
+	done_flag.swap( flags );
+	vector<int> fds( conns, -1 );
+	for ( int c = 0; c < conns; c++ ){
+		fds[c] = load_connect( addr.c_str() );
+		if ( fds[c] < 0 ){
+			printf("CANNOT CONNECT TO %s\n", addr.c_str() );
+			exit(1);
+		}
+		struct timeval tv;
+		long long wait = (long long)( ( seconds + wait_seconds ) * 1e6 );
+		tv.tv_sec = wait / 1000000;
+		tv.tv_usec = wait % 1000000;
+		setsockopt( fds[c], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv) );
+	}
+	// the schedule: exponential gaps between arrivals, an arrival is one query or a burst
+	long long start = stats_now() + LOAD_START_NS;
+	double t = 0, rate = bursty ? qps / burst : qps;
+	for ( long long i = 0; i < n; ){
+		double u = ( rand() + 1.0 ) / ( RAND_MAX + 2.0 );
+		t += -log( u ) / rate;
+		for ( int b = 0; b < ( bursty ? burst : 1 ) && i < n; b++ ) due[i++] = start + (long long)( t * 1e9 );
+	}
+	vector<ConnResult> res( conns );
+	memset( &res[0], 0, sizeof(ConnResult) * conns );
+	vector<thread> th;
+	for ( int c = 0; c < conns; c++ ){
+		th.push_back( thread( load_sender, fds[c], c ) );
+		th.push_back( thread( load_receiver, fds[c], c, ref( res[c] ) ) );
+	}
+	for ( int i = 0; i < th.size(); i++ ) th[i].join();
+	for ( int c = 0; c < conns; c++ ) close( fds[c] );
+
+	ConnResult all;
+	memset( &all, 0, sizeof(all) );
+	for ( int c = 0; c < conns; c++ ){
+		const ConnResult &r = res[c];
+		all.answered += r.answered;
+		all.errors += r.errors;
+		if ( r.last > all.last ) all.last = r.last;
+		for ( int k = 0; k < 2; k++ ){
+			StatsHist &to = k == 0 ? all.due_hist : all.sent_hist;
+			const StatsHist &from = k == 0 ? r.due_hist : r.sent_hist;
+			to.count += from.count;
+			to.sum += from.sum;
+			if ( from.max > to.max ) to.max = from.max;
+			for ( int b = 0; b < STATS_BUCKETS; b++ ) to.bucket[b] += from.bucket[b];
+		}
+	}
+	long long lost = n - all.answered - all.errors;
+	double span = all.last > start ? ( all.last - start ) / 1e9 : seconds;
+	double achieved = all.answered / ( span > seconds ? span : seconds );
+	const StatsHist &h = all.due_hist;
+	printf("LOAD %s RATE=%.0f ACHIEVED=%.1f QUERIES=%lld ERRORS=%lld LOST=%lld P50=%.1f P90=%.1f P99=%.1f P999=%.1f MAX=%.1f SENT_P99=%.1f (US)\n",
+		engine.c_str(), qps, achieved, n, all.errors, lost,
+		stats_hist_percentile( h, 0.5 ) / 1e3, stats_hist_percentile( h, 0.9 ) / 1e3, stats_hist_percentile( h, 0.99 ) / 1e3,
+		stats_hist_percentile( h, 0.999 ) / 1e3, h.max / 1e3, stats_hist_percentile( all.sent_hist, 0.99 ) / 1e3 );
+	fflush( stdout );
+	if ( csv != NULL ){
+		fprintf( csv, "%s,%s,%d,%.0f,%.1f,%lld,%lld,%lld,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n", engine.c_str(), bursty ? "bursty" : "poisson", conns,
+			qps, achieved, n, all.errors, lost,
+			stats_hist_percentile( h, 0.5 ) / 1e3, stats_hist_percentile( h, 0.9 ) / 1e3, stats_hist_percentile( h, 0.99 ) / 1e3,
+			stats_hist_percentile( h, 0.999 ) / 1e3, h.max / 1e3, stats_hist_percentile( all.sent_hist, 0.99 ) / 1e3 );
+		fflush( csv );
+	}
+}
+
+bool trace_load( const char* file ){
+	FILE* fin = fopen( file, "r" );
+	if ( fin == NULL ) return false;
+	char buf[256];
+	while( fgets( buf, sizeof(buf), fin ) != NULL ){
+		TraceQuery q = { 0, 0, 0, -1 };
+		if ( sscanf( buf, "%d %d %d %d", &q.locid, &q.K, &q.layer, &q.maxdist ) >= 2 ) trace.push_back( q );
+	}
+	fclose(fin);
+	return trace.size() > 0;
+}
+
+int main( int argc, char* argv[] ){
+	const char *trace_file = NULL, *rates = "1000", *csv_file = NULL;
+	int synthetic = 0, K = 10;
+	for ( int i = 1; i < argc; i++ ){
+		if ( strcmp( argv[i], "-a" ) == 0 && i + 1 < argc ) addr = argv[++i];
+		else if ( strcmp( argv[i], "-q" ) == 0 && i + 1 < argc ) trace_file = argv[++i];
+		else if ( strcmp( argv[i], "-g" ) == 0 && i + 1 < argc ) synthetic = atoi( argv[++i] );
+		else if ( strcmp( argv[i], "-k" ) == 0 && i + 1 < argc ) K = atoi( argv[++i] );
+		else if ( strcmp( argv[i], "-r" ) == 0 && i + 1 < argc ) rates = argv[++i];
+		else if ( strcmp( argv[i], "-d" ) == 0 && i + 1 < argc ) seconds = atof( argv[++i] );
+		else if ( strcmp( argv[i], "-w" ) == 0 && i + 1 < argc ) wait_seconds = atof( argv[++i] );
+		else if ( strcmp( argv[i], "-c" ) == 0 && i + 1 < argc ) conns = atoi( argv[++i] );
+		else if ( strcmp( argv[i], "-m" ) == 0 && i + 1 < argc ) bursty = strcmp( argv[++i], "bursty" ) == 0;
+		else if ( strcmp( argv[i], "-b" ) == 0 && i + 1 < argc ) burst = atoi( argv[++i] );
+		else if ( strcmp( argv[i], "-e" ) == 0 && i + 1 < argc ) engine = argv[++i];
+		else if ( strcmp( argv[i], "-o" ) == 0 && i + 1 < argc ) csv_file = argv[++i];
+		else if ( strcmp( argv[i], "-s" ) == 0 && i + 1 < argc ) seed = atoi( argv[++i] );
+	}
+	if ( conns < 1 ) conns = 1;
+	if ( burst < 1 ) burst = 1;
+	srand( seed );
+	if ( trace_file != NULL ){
+		if ( ! trace_load( trace_file ) ){
+			printf("CANNOT READ %s\n", trace_file );
+			exit(1);
+		}
+	}
+	else if ( synthetic > 0 ){
+		for ( int i = 0; i < 1000000; i++ ){
+			TraceQuery q = { 0, rand() % synthetic, K, -1 };
+			trace.push_back( q );
+		}
+	}
+	else{
+		printf("NEED -q TRACE OR -g VERTICES\n");
+		exit(1);
+	}
+	FILE* csv = NULL;
+	if ( csv_file != NULL ){
+		bool fresh = access( csv_file, F_OK ) != 0;
+		csv = fopen( csv_file, "a" );
+		if ( csv == NULL ){
+			printf("CANNOT WRITE %s\n", csv_file );
+			exit(1);
+		}
+		if ( fresh ) fprintf( csv, "engine,arrivals,connections,target_qps,achieved_qps,queries,errors,lost,p50_us,p90_us,p99_us,p999_us,max_us,sent_p99_us\n" );
+	}
+	for ( const char* s = rates; *s != '\0'; ){
+		double qps = atof( s );
+		if ( qps > 0 ) load_step( qps, csv );
+		s += strcspn( s, "," );
+		if ( *s == ',' ) s++;
+	}
+	if ( csv != NULL ) fclose(csv);
+	return 0;
+}
@@ -0,0 +1,145 @@
+// microbenchmark of the priority queues of the searches: std::priority_queue(binary heap of pairs, lazy
+// deletion, as the searches used), DHeap(../common/dheap.h, 4-ary with decrease-key) and RadixHeap
+// (../common/radix_heap.h, monotone, lazy deletion)
+//
+// options: -n name = graph name.cnode/.cedge(default cal), -q N = sources(default 200), -r seed(default 1),
+//          -k N = also the searches cut after N settled vertices(kNN like, default 1000)
+// every queue runs the same dijkstras from the same random sources; output per queue and search kind:
+// total ms, pushes and pops per microsecond, and the check sum of the settled distances(the same for all)
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<sys/time.h>
+#include<vector>
+#include<string>
+#include<queue>
+#include<thread>
+#include "../common/dheap.h"
+#include "../common/radix_heap.h"
+#include "../common/graph_csr.h"
+using namespace std;
+
+#define WEIGHT_INFLATE_FACTOR 100000
+
+CsrGraph Graph;
+
+double now_ms(){
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec * 1e3 + tv.tv_usec * 1e-3;
+}
+
+typedef struct{
+	long long pushes, pops, sum;
+}Count;
+
+// dijkstra from s until limit vertices are settled, dist[] = INF_DIST outside
+#define INF_DIST 0x3fffffff
+
+void run_binary( int s, int limit, vector<int> &dist, Count &c ){
+	priority_queue< pair<int,int>, vector< pair<int,int> >, greater< pair<int,int> > > q;
+	q.push( make_pair( 0, s ) );
+	c.pushes++;
+	int settled = 0;
+	while ( ! q.empty() && settled < limit ){
+		pair<int,int> t = q.top();
+		q.pop();
+		c.pops++;
+		int v = t.second;
+		if ( dist[v] != INF_DIST ) continue;
+		dist[v] = t.first;
+		c.sum += t.first;
+		settled++;
+		for ( long long e = Graph.offset[v]; e < Graph.offset[v+1]; e++ ){
+			if ( dist[Graph.target[e]] == INF_DIST ){
+				q.push( make_pair( t.first + Graph.weight[e], Graph.target[e] ) );
+				c.pushes++;
+			}
+		}
+	}
+}
+
+void run_dheap( DHeap &h, int s, int limit, Count &c ){
+	dheap_reset( h );
+	dheap_push( h, s, 0 );
+	c.pushes++;
+	int settled = 0;
+	while ( h.size > 0 && settled < limit ){
+		int v = dheap_pop( h );
+		c.pops++;
+		c.sum += h.key[v];
+		settled++;
+		for ( long long e = Graph.offset[v]; e < Graph.offset[v+1]; e++ ){
+			if ( ! dheap_settled( h, Graph.target[e] ) ){
+				dheap_push( h, Graph.target[e], h.key[v] + Graph.weight[e] );
+				c.pushes++;
+			}
+		}
+	}
+}
+
+void run_radix( RadixHeap<int> &q, int s, int limit, vector<int> &dist, Count &c ){
+	radix_clear( q );
+	radix_push( q, 0, s );
+	c.pushes++;
+	int settled = 0;
+	while ( ! radix_empty( q ) && settled < limit ){
+		pair<unsigned,int> t = radix_pop( q );
+		c.pops++;
+		int v = t.second;
+		if ( dist[v] != INF_DIST ) continue;
+		dist[v] = t.first;
+		c.sum += t.first;
+		settled++;
+		for ( long long e = Graph.offset[v]; e < Graph.offset[v+1]; e++ ){
+			if ( dist[Graph.target[e]] == INF_DIST ){
+				radix_push( q, t.first + Graph.weight[e], Graph.target[e] );
+				c.pushes++;
+			}
+		}
+	}
+}
+
+int main( int argc, char* argv[] ){
+	string name = "cal";
+	int sources = 200, seed = 1, cut = 1000;
+	for ( int i = 1; i < argc; i++ ){
+		if ( strcmp( argv[i], "-n" ) == 0 && i + 1 < argc ) name = argv[++i];
+		else if ( strcmp( argv[i], "-q" ) == 0 && i + 1 < argc ) sources = atoi( argv[++i] );
+		else if ( strcmp( argv[i], "-r" ) == 0 && i + 1 < argc ) seed = atoi( argv[++i] );
+		else if ( strcmp( argv[i], "-k" ) == 0 && i + 1 < argc ) cut = atoi( argv[++i] );
+	}
+	bool cached;
+	if ( ! csr_load( Graph, ( name + ".cnode" ).c_str(), ( name + ".cedge" ).c_str(), WEIGHT_INFLATE_FACTOR, thread::hardware_concurrency(), false, cached ) ){
+		printf("CANNOT LOAD %s.cnode/.cedge\n", name.c_str() );
+		exit(1);
+	}
+	printf("GRAPH %s n=%d adj=%lld sources=%d\n", name.c_str(), Graph.n, (long long) Graph.target.size(), sources );
+	srand( seed );
+	vector<int> src( sources );
+	for ( int i = 0; i < sources; i++ ) src[i] = rand() % Graph.n;
+	DHeap h;
+	dheap_init( h, Graph.n );
+	RadixHeap<int> r;
+	radix_clear( r );
+	vector<int> dist( Graph.n );
+	int limits[2] = { Graph.n, cut };
+	const char* kinds[2] = { "full", "cut" };
+	for ( int k = 0; k < 2; k++ ){
+		for ( int which = 0; which < 3; which++ ){
+			Count c = { 0, 0, 0 };
+			double t = now_ms();
+			for ( int i = 0; i < sources; i++ ){
+				if ( which != 1 ) dist.assign( Graph.n, INF_DIST );
+				if ( which == 0 ) run_binary( src[i], limits[k], dist, c );
+				else if ( which == 1 ) run_dheap( h, src[i], limits[k], c );
+				else run_radix( r, src[i], limits[k], dist, c );
+			}
+			t = now_ms() - t;
+			const char* names[3] = { "binary", "dheap", "radix" };
+			printf("%-6s %-6s %10.1f ms %8.1f push/us %8.1f pop/us sum=%lld\n", kinds[k], names[which], t,
+				t > 0 ? c.pushes / ( t * 1e3 ) : 0.0, t > 0 ? c.pops / ( t * 1e3 ) : 0.0, c.sum );
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,247 @@
+// vertex renumbering for memory locality(see README.txt)
+//
+// vertex ids are the line order of .cnode, often spatially random, so the vertices of a leaf,
+// adjacency lists and gtreepath entries of neighbours lie far apart in every engine. this
+// writes the same graph with the vertices in G-Tree leaf order(a depth first walk of the tree of
+// a .gidx built on the input, members of a leaf in a row) or, without an index, along a Hilbert
+// curve over the coordinates, plus the id map between both numberings:
+//	W.cnode, W.cedge   the graph renumbered, coordinates and weights as the input text
+//	W.idmap            "new old" per vertex, new ids in order
+// the map converts files at the boundary: inputs whose first field is a vertex(objects "vid oid",
+// queries "locid K", pairs "s t") to the new ids, engine output("ID=vid DIS=d", "PATH=v ..")
+// back to the original ones
+//
+// options: -n name = input graph name.cnode/.cedge(default cal), -w prefix = output(default name_r)
+//          -g file = G-Tree index(.gidx, gtree_build -n name) for leaf order, else Hilbert order
+//          -m file = id map of an earlier run, with -f file: first field of each line to the new
+//                    ids, with -b file: "ID=", "PATH=" vertices back to the old ids(stdout)
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<vector>
+#include<string>
+#include<algorithm>
+#include "../gtree/gtree_index.h"
+using namespace std;
+
+#define HILBERT_ORDER 16 // cells per side = 2^HILBERT_ORDER
+
+vector<int> to_new, to_old;
+
+// position of cell (x, y) along the Hilbert curve of a 2^order grid
+long long hilbert_index( unsigned x, unsigned y, int order ){
+	long long d = 0;
+	for ( unsigned s = 1u << ( order - 1 ); s > 0; s >>= 1 ){
+		unsigned rx = ( x & s ) > 0, ry = ( y & s ) > 0;
+		d += (long long) s * s * ( ( 3 * rx ) ^ ry );
+		// rotate the quadrant so the curve continues
+		if ( ry == 0 ){
+			if ( rx == 1 ){
+				x = s - 1 - ( x & ( s - 1 ) );
+				y = s - 1 - ( y & ( s - 1 ) );
+			}
+			swap( x, y );
+		}
+	}
+	return d;
+}
+
+void order_hilbert( const vector<double> &x, const vector<double> &y ){
+	int n = x.size();
+	double minx = *min_element( x.begin(), x.end() ), maxx = *max_element( x.begin(), x.end() );
+	double miny = *min_element( y.begin(), y.end() ), maxy = *max_element( y.begin(), y.end() );
+	double side = ( 1 << HILBERT_ORDER ) - 1;
+	vector< pair<long long,int> > key( n );
+	for ( int v = 0; v < n; v++ ){
+		unsigned cx = maxx > minx ? (unsigned)( ( x[v] - minx ) / ( maxx - minx ) * side ) : 0;
+		unsigned cy = maxy > miny ? (unsigned)( ( y[v] - miny ) / ( maxy - miny ) * side ) : 0;
+		key[v] = make_pair( hilbert_index( cx, cy, HILBERT_ORDER ), v );
+	}
+	sort( key.begin(), key.end() );
+	for ( int i = 0; i < n; i++ ) to_old.push_back( key[i].second );
+}
+
+// leaves of the tree depth first, each leaf's vertices in its order
+bool order_gtree( const char* file, int n ){
+	FrozenGTree fg = FrozenGTree();
+	if ( ! gtree_index_mmap( fg, file ) ) return false;
+	if ( fg.node_size != n ){
+		printf("INDEX %s HAS %d VERTICES, THE GRAPH %d\n", file, fg.node_size, n );
+		gtree_index_release( fg );
+		return false;
+	}
+	vector<char> seen( n, 0 );
+	vector<int> stk( 1, 0 );
+	while( ! stk.empty() ){
+		const FrozenTreeNode &t = fg.tnodes[stk.back()];
+		stk.pop_back();
+		for ( int i = 0; i < t.nleafnodes; i++ ){
+			int v = fg.pool[t.leafnodes + i];
+			if ( ! seen[v] ) to_old.push_back( v );
+			seen[v] = 1;
+		}
+		// first child on top
+		for ( int i = t.nchildren - 1; i >= 0; i-- ) stk.push_back( fg.pool[t.children + i] );
+	}
+	for ( int v = 0; v < n; v++ ){
+		if ( ! seen[v] ) to_old.push_back( v );
+	}
+	gtree_index_release( fg );
+	return true;
+}
+
+// lines of a text file
+bool read_lines( const char* file, vector<string> &out ){
+	FILE* fin = fopen( file, "r" );
+	if ( fin == NULL ) return false;
+	char buf[1 << 16];
+	while( fgets( buf, sizeof(buf), fin ) != NULL ){
+		int len = strlen( buf );
+		while( len > 0 && ( buf[len-1] == '\n' || buf[len-1] == '\r' ) ) buf[--len] = '\0';
+		out.push_back( buf );
+	}
+	fclose(fin);
+	return true;
+}
+
+bool renumber( const string &name, const string &prefix, const char* gidx ){
+	vector<string> nodes, edges;
+	if ( ! read_lines( ( name + ".cnode" ).c_str(), nodes ) || ! read_lines( ( name + ".cedge" ).c_str(), edges ) ){
+		printf("CANNOT READ %s.cnode/.cedge\n", name.c_str() );
+		return false;
+	}
+	int n = nodes.size();
+	vector<double> x( n ), y( n );
+	vector<string> coords( n );
+	for ( int v = 0; v < n; v++ ){
+		int nid, off = 0;
+		if ( sscanf( nodes[v].c_str(), "%d %lf %lf", &nid, &x[v], &y[v] ) != 3 ||
+			sscanf( nodes[v].c_str(), "%*d%n", &off ) != 0 ){
+			printf("BAD NODE LINE %d\n", v + 1 );
+			return false;
+		}
+		coords[v] = nodes[v].substr( off );
+	}
+	if ( gidx != NULL ){
+		if ( ! order_gtree( gidx, n ) ){
+			printf("CANNOT USE %s\n", gidx );
+			return false;
+		}
+	}
+	else order_hilbert( x, y );
+	to_new.assign( n, -1 );
+	for ( int i = 0; i < n; i++ ) to_new[to_old[i]] = i;
+
+	FILE* fnode = fopen( ( prefix + ".cnode" ).c_str(), "w" );
+	FILE* fedge = fopen( ( prefix + ".cedge" ).c_str(), "w" );
+	FILE* fmap = fopen( ( prefix + ".idmap" ).c_str(), "w" );
+	if ( fnode == NULL || fedge == NULL || fmap == NULL ){
+		printf("CANNOT WRITE %s.*\n", prefix.c_str() );
+		return false;
+	}
+	for ( int i = 0; i < n; i++ ){
+		fprintf( fnode, "%d%s\n", i, coords[to_old[i]].c_str() );
+		fprintf( fmap, "%d %d\n", i, to_old[i] );
+	}
+	// edge order kept, so each vertex lists its neighbours as before
+	for ( int i = 0; i < edges.size(); i++ ){
+		int eid, s, e, off = 0;
+		if ( sscanf( edges[i].c_str(), "%d %d %d%n", &eid, &s, &e, &off ) != 3 || s < 0 || s >= n || e < 0 || e >= n ){
+			printf("BAD EDGE LINE %d\n", i + 1 );
+			return false;
+		}
+		fprintf( fedge, "%d %d %d%s\n", eid, to_new[s], to_new[e], edges[i].c_str() + off );
+	}
+	fclose(fnode);
+	fclose(fedge);
+	fclose(fmap);
+	printf("RENUMBER %s: NODE_COUNT=%d EDGE_COUNT=%d ORDER=%s\n", prefix.c_str(), n, (int)edges.size(), gidx != NULL ? "GTREE" : "HILBERT" );
+	return true;
+}
+
+bool map_load( const char* file ){
+	FILE* fin = fopen( file, "r" );
+	if ( fin == NULL ) return false;
+	int a, b;
+	while( fscanf( fin, "%d %d", &a, &b ) == 2 ){
+		if ( a != to_old.size() ) break;
+		to_old.push_back( b );
+	}
+	fclose(fin);
+	to_new.assign( to_old.size(), -1 );
+	for ( int i = 0; i < to_old.size(); i++ ){
+		if ( to_old[i] < 0 || to_old[i] >= to_old.size() || to_new[to_old[i]] != -1 ) return false;
+		to_new[to_old[i]] = i;
+	}
+	return to_old.size() > 0;
+}
+
+int map_id( const vector<int> &m, int v ){
+	return v >= 0 && v < m.size() ? m[v] : v;
+}
+
+// first field of every line to the new ids
+bool map_forward( const char* file ){
+	vector<string> lines;
+	if ( ! read_lines( file, lines ) ) return false;
+	for ( int i = 0; i < lines.size(); i++ ){
+		int v, off = 0;
+		if ( sscanf( lines[i].c_str(), "%d%n", &v, &off ) == 1 ) printf( "%d%s\n", map_id( to_new, v ), lines[i].c_str() + off );
+		else printf( "%s\n", lines[i].c_str() );
+	}
+	return true;
+}
+
+// "ID=v" and every vertex after "PATH=" to the old ids, the rest as it is
+bool map_back( const char* file ){
+	vector<string> lines;
+	if ( ! read_lines( file, lines ) ) return false;
+	for ( int i = 0; i < lines.size(); i++ ){
+		const char* s = lines[i].c_str();
+		const char* path = strstr( s, "PATH=" );
+		string out;
+		while( *s != '\0' ){
+			int v, off = 0;
+			bool vertex = ( strncmp( s, "ID=", 3 ) == 0 && ( s == lines[i].c_str() || s[-1] == ' ' ) ) ||
+				( path != NULL && s >= path + 5 && ( s == path + 5 || s[-1] == ' ' ) );
+			int skip = strncmp( s, "ID=", 3 ) == 0 ? 3 : 0;
+			if ( vertex && sscanf( s + skip, "%d%n", &v, &off ) == 1 ){
+				char buf[32];
+				sprintf( buf, "%d", map_id( to_old, v ) );
+				out.append( s, skip );
+				out += buf;
+				s += skip + off;
+			}
+			else out += *s++;
+		}
+		printf( "%s\n", out.c_str() );
+	}
+	return true;
+}
+
+int main( int argc, char* argv[] ){
+	string name = "cal", prefix;
+	const char *gidx = NULL, *map = NULL, *forward = NULL, *back = NULL;
+	for ( int i = 1; i < argc; i++ ){
+		if ( strcmp( argv[i], "-n" ) == 0 && i + 1 < argc ) name = argv[++i];
+		else if ( strcmp( argv[i], "-w" ) == 0 && i + 1 < argc ) prefix = argv[++i];
+		else if ( strcmp( argv[i], "-g" ) == 0 && i + 1 < argc ) gidx = argv[++i];
+		else if ( strcmp( argv[i], "-m" ) == 0 && i + 1 < argc ) map = argv[++i];
+		else if ( strcmp( argv[i], "-f" ) == 0 && i + 1 < argc ) forward = argv[++i];
+		else if ( strcmp( argv[i], "-b" ) == 0 && i + 1 < argc ) back = argv[++i];
+	}
+	if ( map != NULL ){
+		if ( ! map_load( map ) ){
+			printf("CANNOT LOAD %s\n", map );
+			exit(1);
+		}
+		const char* file = forward != NULL ? forward : back;
+		if ( file == NULL || ! ( forward != NULL ? map_forward( file ) : map_back( file ) ) ){
+			printf("CANNOT READ %s\n", file != NULL ? file : "(NEED -f OR -b)" );
+			exit(1);
+		}
+		return 0;
+	}
+	if ( prefix.size() == 0 ) prefix = name + "_r";
+	return renumber( name, prefix, gidx ) ? 0 : 1;
+}
@@ -0,0 +1,426 @@
+// shared benchmark workload of the engines(see bench.sh, README.txt)
+//
+// from graph name.cnode/.cedge writes, for output prefix W:
+//	W.cnode, W.cedge    the graph with weights on the WEIGHT_INFLATE_FACTOR grid, every engine reads them
+//	                    as the same integers(int engines) or within float rounding(ROAD, DistIdx)
+//	W.gpedge            the same graph in the G*-Tree edge format("n m", then "u v c" 1-based, both directions)
+//	W.o<density>.object objects on distinct vertices("vid oid"), one file per density, drawn by -d:
+//	                    uniform       every vertex alike
+//	                    cluster:C[,F] C random seed vertices, each object uniform among the F * count / C
+//	                                  vertices nearest(network distance) to a random seed(default F = 4)
+//	                    hotspot:H[,F] H random centres, each object at settle rank |N(0, 1)| * F * count / H
+//	                                  of the dijkstra from a random centre(default F = 1), gaussian falloff
+//	W.manifest          the options and every file above with its size and FNV-1a 64 hash(W.cedge.csr, the
+//	                    binary CSR copy of ../common/graph_csr.h, hashed after its header: that holds mtimes),
+//	                    workload -v W.manifest checks a later run or a copied work dir against it
+//	W.o<density>.k<K>.s<stratum>.query  "locid K" lines
+//	W.o<density>.k<K>.s<stratum>.truth  "locid K d1 .. dK", dijkstra distances(integer grid)
+// queries are stratified by distance: a pool of random sources is ranked by the distance of their
+// K-th nearest object, then cut into equal quantile strata(0 = nearest), each sampled with the same count.
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<math.h>
+#include<vector>
+#include<string>
+#include<algorithm>
+#include<thread>
+#include "../common/dheap.h"
+#include "../common/task_pool.h"
+#include "../common/graph_csr.h"
+using namespace std;
+
+#define WEIGHT_INFLATE_FACTOR 100000
+
+string graph = "cal", prefix;
+vector<string> densities;
+vector<int> ks;
+int strata = 4;
+int queries = 100; // per stratum
+int seed = 1;
+int threads = 1;
+string distribution = "uniform";
+int dist_kind = 0; // 0 uniform, 1 cluster, 2 hotspot
+int dist_centers = 0;
+double dist_factor = 0;
+CsrGraph Graph;
+vector<string> outputs; // files of the manifest
+
+void split_list( const char* s, vector<string> &out ){
+	out.clear();
+	string cur;
+	for ( ; ; s++ ){
+		if ( *s == ',' || *s == '\0' ){
+			if ( cur.size() > 0 ) out.push_back( cur );
+			cur.clear();
+			if ( *s == '\0' ) break;
+		}
+		else cur += *s;
+	}
+}
+
+// graph in engine formats, weights on the integer grid
+bool graph_save(){
+	CsrGraph g;
+	bool cached;
+	if ( ! csr_load( g, ( graph + ".cnode" ).c_str(), ( graph + ".cedge" ).c_str(), WEIGHT_INFLATE_FACTOR, threads, false, cached ) ) return false;
+	FILE* fnode = fopen( ( prefix + ".cnode" ).c_str(), "w" );
+	FILE* fedge = fopen( ( prefix + ".cedge" ).c_str(), "w" );
+	FILE* fgp = fopen( ( prefix + ".gpedge" ).c_str(), "w" );
+	if ( fnode == NULL || fedge == NULL || fgp == NULL ){
+		printf("CANNOT WRITE %s.*\n", prefix.c_str() );
+		return false;
+	}
+	for ( int v = 0; v < g.n; v++ ){
+		fprintf( fnode, "%d %.17g %.17g\n", v, g.x[v], g.y[v] );
+	}
+	// a quarter unit up: truncating(gtree) and rounding(silc) both give the same int again
+	// self loops dropped, they are on no shortest path
+	long long arcs = 0;
+	for ( int v = 0; v < g.n; v++ ){
+		for ( long long i = g.offset[v]; i < g.offset[v+1]; i++ ) arcs += g.target[i] != v;
+	}
+	fprintf( fgp, "%d %lld\n", g.n, arcs );
+	int eid = 0;
+	for ( int v = 0; v < g.n; v++ ){
+		for ( long long i = g.offset[v]; i < g.offset[v+1]; i++ ){
+			if ( g.target[i] == v ) continue;
+			fprintf( fgp, "%d %d %d\n", v + 1, g.target[i] + 1, g.weight[i] );
+			if ( g.target[i] < v ) continue;
+			fprintf( fedge, "%d %d %d %.9f\n", eid++, v, g.target[i], ( g.weight[i] + 0.25 ) / WEIGHT_INFLATE_FACTOR );
+		}
+	}
+	fclose(fnode);
+	fclose(fedge);
+	fclose(fgp);
+	outputs.push_back( prefix + ".cnode" );
+	outputs.push_back( prefix + ".cedge" );
+	outputs.push_back( prefix + ".gpedge" );
+	printf("GRAPH %s: NODE_COUNT=%d EDGE_COUNT=%d\n", prefix.c_str(), g.n, eid );
+	return true;
+}
+
+// distances of the first k objects settled from s(fewer if not reachable)
+void dijkstra_knn( DHeap &h, int s, int k, const vector<char> &isobject, vector<int> &out ){
+	out.clear();
+	dheap_reset( h );
+	dheap_push( h, s, 0 );
+	while( h.size > 0 && out.size() < k ){
+		int v = dheap_pop( h );
+		int d = h.key[v];
+		if ( isobject[v] ) out.push_back( d );
+		const int* adj = &Graph.target[0] + Graph.offset[v];
+		const int* w = &Graph.weight[0] + Graph.offset[v];
+		for ( int i = 0; i < CSR_DEGREE(Graph, v); i++ ){
+			dheap_push( h, adj[i], d + w[i] );
+		}
+	}
+}
+
+// the first cap vertices settled from s, nearest first
+void dijkstra_ball( DHeap &h, int s, int cap, vector<int> &out ){
+	out.clear();
+	dheap_reset( h );
+	dheap_push( h, s, 0 );
+	while( h.size > 0 && out.size() < cap ){
+		int v = dheap_pop( h );
+		int d = h.key[v];
+		out.push_back( v );
+		const int* adj = &Graph.target[0] + Graph.offset[v];
+		const int* w = &Graph.weight[0] + Graph.offset[v];
+		for ( int i = 0; i < CSR_DEGREE(Graph, v); i++ ){
+			dheap_push( h, adj[i], d + w[i] );
+		}
+	}
+}
+
+// |N(0, 1)|, box-muller on rand() so the seed fixes it like everything else
+double gauss_abs(){
+	double u1 = ( rand() + 1.0 ) / ( RAND_MAX + 2.0 ), u2 = rand() / ( RAND_MAX + 1.0 );
+	return fabs( sqrt( -2 * log( u1 ) ) * cos( 2 * M_PI * u2 ) );
+}
+
+// count distinct object vertices of the -d distribution into objects;
+// order = a permutation of the vertices for the query sources to be shuffled from
+// (uniform: the one the objects were cut from, as it always was, so uniform workloads stay the same)
+void objects_pick( int count, vector<int> &order, vector<int> &objects ){
+	int n = Graph.n;
+	order.resize( n );
+	for ( int i = 0; i < n; i++ ) order[i] = i;
+	objects.clear();
+	if ( dist_kind == 0 ){
+		for ( int i = n - 1; i > 0; i-- ) swap( order[i], order[ rand() % ( i + 1 ) ] );
+		objects.assign( order.begin(), order.begin() + count );
+		return;
+	}
+
+	// seeds, then their neighbourhoods in parallel
+	int centers = dist_centers < count ? dist_centers : count;
+	double share = (double) count / centers;
+	int cap = (int) ceil( dist_factor * share * ( dist_kind == 1 ? 1 : 4 ) );
+	if ( cap < 1 ) cap = 1;
+	if ( cap > n ) cap = n;
+	vector<char> taken( n, 0 );
+	vector<int> seeds;
+	while( seeds.size() < centers ){
+		int v = rand() % n;
+		if ( taken[v] ) continue;
+		taken[v] = 1;
+		seeds.push_back( v );
+	}
+	fill( taken.begin(), taken.end(), 0 );
+	vector< vector<int> > ball( centers );
+	int nthreads = threads < centers ? threads : centers;
+	vector<DHeap> heaps( nthreads );
+	for ( int t = 0; t < nthreads; t++ ) dheap_init( heaps[t], n );
+	parallel_for( nthreads, centers, [&]( int worker, int i ){
+		dijkstra_ball( heaps[worker], seeds[i], cap, ball[i] );
+	} );
+
+	// a vertex drawn twice is drawn again, a few times, then any free vertex(small components, tight F)
+	int spilled = 0;
+	while( objects.size() < count ){
+		int v = -1;
+		for ( int tries = 0; tries < 32 && v < 0; tries++ ){
+			const vector<int> &b = ball[ rand() % centers ];
+			int r = dist_kind == 1 ? rand() % b.size() : (int)( gauss_abs() * dist_factor * share );
+			if ( r < b.size() && ! taken[ b[r] ] ) v = b[r];
+		}
+		if ( v < 0 ){
+			do v = rand() % n; while( taken[v] );
+			spilled++;
+		}
+		taken[v] = 1;
+		objects.push_back( v );
+	}
+	printf("OBJECTS %s: COUNT=%d CENTERS=%d BALL=%d SPILLED=%d\n", distribution.c_str(), count, centers, cap, spilled );
+}
+
+void density_save( const string &density ){
+	int n = Graph.n;
+	int kmax = *max_element( ks.begin(), ks.end() );
+	int count = (int)( atof( density.c_str() ) * n + 0.5 );
+	if ( count < kmax ) count = kmax;
+	if ( count > n ) count = n;
+
+	vector<int> order, objects;
+	objects_pick( count, order, objects );
+	vector<char> isobject( n, 0 );
+	string name = prefix + ".o" + density;
+	FILE* fout = fopen( ( name + ".object" ).c_str(), "w" );
+	for ( int i = 0; i < count; i++ ){
+		isobject[objects[i]] = 1;
+		fprintf( fout, "%d %d\n", objects[i], i );
+	}
+	fclose(fout);
+	outputs.push_back( name + ".object" );
+
+	// source pool, kmax nearest objects of each
+	int pool = strata * queries * 4 < n ? strata * queries * 4 : n;
+	for ( int i = n - 1; i > 0; i-- ) swap( order[i], order[ rand() % ( i + 1 ) ] );
+	vector< vector<int> > near( pool );
+	int nthreads = threads < pool ? threads : pool;
+	vector<DHeap> heaps( nthreads );
+	for ( int t = 0; t < nthreads; t++ ) dheap_init( heaps[t], n );
+	parallel_for( nthreads, pool, [&]( int worker, int i ){
+		dijkstra_knn( heaps[worker], order[i], kmax, isobject, near[i] );
+	} );
+
+	for ( int j = 0; j < ks.size(); j++ ){
+		int K = ks[j];
+		// (distance of the K-th object, pool index), unreachable ones left out
+		vector< pair<int,int> > rank;
+		for ( int i = 0; i < pool; i++ ){
+			if ( near[i].size() >= K ) rank.push_back( make_pair( near[i][K-1], i ) );
+		}
+		sort( rank.begin(), rank.end() );
+		for ( int s = 0; s < strata; s++ ){
+			int lo = (long long) rank.size() * s / strata, hi = (long long) rank.size() * ( s + 1 ) / strata;
+			int dlo = hi > lo ? rank[lo].first : 0, dhi = hi > lo ? rank[hi-1].first : 0;
+			for ( int i = hi - 1; i > lo; i-- ) swap( rank[i], rank[ lo + rand() % ( i - lo + 1 ) ] );
+			if ( hi - lo > queries ) hi = lo + queries;
+			char tag[64];
+			sprintf( tag, ".k%d.s%d", K, s );
+			FILE* fq = fopen( ( name + tag + ".query" ).c_str(), "w" );
+			FILE* ft = fopen( ( name + tag + ".truth" ).c_str(), "w" );
+			for ( int i = lo; i < hi; i++ ){
+				int src = order[ rank[i].second ];
+				fprintf( fq, "%d %d\n", src, K );
+				fprintf( ft, "%d %d", src, K );
+				for ( int k = 0; k < K; k++ ) fprintf( ft, " %d", near[ rank[i].second ][k] );
+				fprintf( ft, "\n" );
+			}
+			fclose(fq);
+			fclose(ft);
+			outputs.push_back( name + tag + ".query" );
+			outputs.push_back( name + tag + ".truth" );
+			printf("WORKLOAD %s%s: QUERIES=%d KDIST=[%d,%d]\n", name.c_str(), tag, hi - lo, dlo, dhi );
+		}
+	}
+}
+
+// FNV-1a 64 of a file from byte skip on, false if it cannot be read
+bool file_hash( const string &file, long long skip, long long &bytes, unsigned long long &hash ){
+	FILE* fin = fopen( file.c_str(), "rb" );
+	if ( fin == NULL ) return false;
+	hash = 14695981039346656037ULL;
+	bytes = 0;
+	vector<unsigned char> buf( 1 << 20 );
+	size_t got;
+	while( ( got = fread( &buf[0], 1, buf.size(), fin ) ) > 0 ){
+		for ( size_t i = 0; i < got; i++ ){
+			if ( bytes + (long long) i < skip ) continue;
+			hash = ( hash ^ buf[i] ) * 1099511628211ULL;
+		}
+		bytes += got;
+	}
+	fclose(fin);
+	return true;
+}
+
+// the header of a .csr copy stamps the mtimes of its text files, not part of the content
+long long hash_skip( const string &file ){
+	return file.size() > 4 && file.compare( file.size() - 4, 4, ".csr" ) == 0 ? sizeof(CsrHeader) : 0;
+}
+
+// "FILE name bytes hash" per output, names relative to the manifest(same dir)
+bool manifest_save( const char* plist, const char* klist ){
+	string path = prefix + ".manifest";
+	vector<long long> bytes( outputs.size() );
+	vector<unsigned long long> hash( outputs.size() );
+	vector<char> ok( outputs.size() );
+	int nthreads = threads < outputs.size() ? threads : outputs.size();
+	parallel_for( nthreads, outputs.size(), [&]( int worker, int i ){
+		ok[i] = file_hash( outputs[i], hash_skip( outputs[i] ), bytes[i], hash[i] );
+	} );
+	FILE* fout = fopen( path.c_str(), "w" );
+	if ( fout == NULL ){
+		printf("CANNOT WRITE %s\n", path.c_str() );
+		return false;
+	}
+	fprintf( fout, "GRAPH %s\nDENSITIES %s\nKS %s\nSTRATA %d\nQUERIES %d\nSEED %d\nDISTRIBUTION %s\n",
+		graph.c_str(), plist, klist, strata, queries, seed, distribution.c_str() );
+	long long total = 0;
+	for ( int i = 0; i < outputs.size(); i++ ){
+		if ( ! ok[i] ) continue;
+		size_t slash = outputs[i].rfind( '/' );
+		fprintf( fout, "FILE %s %lld %016llx\n", outputs[i].c_str() + ( slash == string::npos ? 0 : slash + 1 ), bytes[i], hash[i] );
+		total += bytes[i];
+	}
+	fclose(fout);
+	printf("MANIFEST %s: FILES=%d BYTES=%lld\n", path.c_str(), (int) outputs.size(), total );
+	return true;
+}
+
+// files of a manifest against their sizes and hashes, 0 if all match
+int manifest_check( const char* path ){
+	FILE* fin = fopen( path, "r" );
+	if ( fin == NULL ){
+		printf("CANNOT READ %s\n", path );
+		return 1;
+	}
+	string dir = path;
+	size_t slash = dir.rfind( '/' );
+	dir = slash == string::npos ? "" : dir.substr( 0, slash + 1 );
+	vector<string> files;
+	vector<long long> want_bytes;
+	vector<unsigned long long> want_hash;
+	char line[4096], file[4096];
+	long long b;
+	unsigned long long h;
+	while( fgets( line, sizeof(line), fin ) != NULL ){
+		if ( sscanf( line, "FILE %4095s %lld %llx", file, &b, &h ) != 3 ) continue;
+		files.push_back( dir + file );
+		want_bytes.push_back( b );
+		want_hash.push_back( h );
+	}
+	fclose(fin);
+	vector<char> bad( files.size(), 0 );
+	int nthreads = threads < files.size() ? threads : files.size();
+	parallel_for( nthreads, files.size(), [&]( int worker, int i ){
+		long long bytes;
+		unsigned long long hash;
+		bad[i] = ! file_hash( files[i], hash_skip( files[i] ), bytes, hash ) || bytes != want_bytes[i] || hash != want_hash[i];
+	} );
+	int mismatches = 0;
+	for ( int i = 0; i < files.size(); i++ ){
+		if ( bad[i] ) printf("MISMATCH %s\n", files[i].c_str() );
+		mismatches += bad[i];
+	}
+	printf("CHECK %s: FILES=%d MISMATCHES=%d\n", path, (int) files.size(), mismatches );
+	return mismatches > 0;
+}
+
+// -d argument, false if malformed
+bool distribution_parse( const char* s ){
+	distribution = s;
+	if ( strcmp( s, "uniform" ) == 0 ){
+		dist_kind = 0;
+		return true;
+	}
+	const char* arg = strchr( s, ':' );
+	if ( arg == NULL ) return false;
+	if ( strncmp( s, "cluster:", 8 ) == 0 ) dist_kind = 1;
+	else if ( strncmp( s, "hotspot:", 8 ) == 0 ) dist_kind = 2;
+	else return false;
+	dist_factor = dist_kind == 1 ? 4 : 1;
+	if ( sscanf( arg + 1, "%d,%lf", &dist_centers, &dist_factor ) < 1 ) return false;
+	return dist_centers > 0 && dist_factor > 0;
+}
+
+int main( int argc, char* argv[] ){
+	// options: -n name = input graph name.cnode/.cedge(default cal)
+	//          -w prefix = output prefix(default name_bench)
+	//          -p d1,d2.. = object densities, fraction of vertices(default 0.001,0.01,0.1)
+	//          -k K1,K2.. = K values(default 1,10,50)
+	//          -t N = distance strata, -q N = queries per stratum, -r N = seed
+	//          -d uniform|cluster:C[,F]|hotspot:H[,F] = object distribution(default uniform)
+	//          -j N = threads
+	//          -v W.manifest = only check the files of an earlier run against its manifest
+	const char* plist = "0.001,0.01,0.1";
+	const char* klist = "1,10,50";
+	const char* check = NULL;
+	threads = thread::hardware_concurrency();
+	for ( int i = 1; i < argc; i++ ){
+		if ( strcmp( argv[i], "-n" ) == 0 && i + 1 < argc ) graph = argv[++i];
+		else if ( strcmp( argv[i], "-w" ) == 0 && i + 1 < argc ) prefix = argv[++i];
+		else if ( strcmp( argv[i], "-p" ) == 0 && i + 1 < argc ) plist = argv[++i];
+		else if ( strcmp( argv[i], "-k" ) == 0 && i + 1 < argc ) klist = argv[++i];
+		else if ( strcmp( argv[i], "-t" ) == 0 && i + 1 < argc ) strata = atoi( argv[++i] );
+		else if ( strcmp( argv[i], "-q" ) == 0 && i + 1 < argc ) queries = atoi( argv[++i] );
+		else if ( strcmp( argv[i], "-r" ) == 0 && i + 1 < argc ) seed = atoi( argv[++i] );
+		else if ( strcmp( argv[i], "-j" ) == 0 && i + 1 < argc ) threads = atoi( argv[++i] );
+		else if ( strcmp( argv[i], "-d" ) == 0 && i + 1 < argc ){
+			if ( ! distribution_parse( argv[++i] ) ){
+				printf("BAD DISTRIBUTION %s, NEED uniform, cluster:C[,F] OR hotspot:H[,F]\n", argv[i] );
+				exit(1);
+			}
+		}
+		else if ( strcmp( argv[i], "-v" ) == 0 && i + 1 < argc ) check = argv[++i];
+	}
+	if ( prefix.size() == 0 ) prefix = graph + "_bench";
+	if ( threads < 1 ) threads = 1;
+	if ( check != NULL ) return manifest_check( check );
+	split_list( plist, densities );
+	vector<string> kv;
+	split_list( klist, kv );
+	for ( int i = 0; i < kv.size(); i++ ){
+		if ( atoi( kv[i].c_str() ) > 0 ) ks.push_back( atoi( kv[i].c_str() ) );
+	}
+	if ( densities.size() == 0 || ks.size() == 0 || strata < 1 || queries < 1 ){
+		printf("NEED -p DENSITIES, -k K VALUES, -t STRATA >= 1, -q QUERIES >= 1\n");
+		exit(1);
+	}
+
+	// benchmark copy first, the truth is computed on exactly what the engines read
+	if ( ! graph_save() ) exit(1);
+	bool cached;
+	if ( ! csr_load( Graph, ( prefix + ".cnode" ).c_str(), ( prefix + ".cedge" ).c_str(), WEIGHT_INFLATE_FACTOR, threads, false, cached ) ) exit(1);
+	outputs.push_back( prefix + ".cedge.csr" );
+	srand( seed );
+	for ( int i = 0; i < densities.size(); i++ ){
+		density_save( densities[i] );
+	}
+	if ( ! manifest_save( plist, klist ) ) exit(1);
+	return 0;
+}
@@ -0,0 +1,52 @@
+// contraction hierarchies index of a graph(../common/ch.h)
+//
+// options: -n name = data set name.cnode/.cedge(default cal), index written to name.ch
+//          -j N = build threads(default all cores, same index for any N)
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<string>
+#include<thread>
+#include<sys/time.h>
+#include "../common/graph_csr.h"
+#include "../common/ch.h"
+using namespace std;
+
+// same weights as gtree_build: (input edge) * WEIGHT_INFLATE_FACTOR
+#define WEIGHT_INFLATE_FACTOR 100000
+
+struct timeval tv;
+long long ts, te;
+#define TIME_TICK_START gettimeofday( &tv, NULL ); ts = tv.tv_sec * 100000 + tv.tv_usec / 10;
+#define TIME_TICK_END gettimeofday( &tv, NULL ); te = tv.tv_sec * 100000 + tv.tv_usec / 10;
+#define TIME_TICK_PRINT(T) printf("%s RESULT: %lld (0.01MS)\r\n", (#T), te - ts );
+
+int main( int argc, char* argv[] ){
+	string name = "cal";
+	int threads = thread::hardware_concurrency();
+	for ( int i = 1; i < argc; i++ ){
+		if ( strcmp( argv[i], "-n" ) == 0 && i + 1 < argc ) name = argv[++i];
+		else if ( strcmp( argv[i], "-j" ) == 0 && i + 1 < argc ) threads = atoi( argv[++i] );
+	}
+	if ( threads < 1 ) threads = 1;
+
+	CsrGraph g;
+	bool cached;
+	if ( ! csr_load( g, ( name + ".cnode" ).c_str(), ( name + ".cedge" ).c_str(), WEIGHT_INFLATE_FACTOR, threads, false, cached ) ){
+		printf("CANNOT LOAD %s.cnode/.cedge\n", name.c_str() );
+		exit(1);
+	}
+	printf("GRAPH %s: NODE_COUNT=%d EDGE_COUNT=%lld%s\n", name.c_str(), g.n, g.m, cached ? "(CACHED)" : "" );
+
+	ChIndex idx;
+	TIME_TICK_START
+	ch_build( idx, g.n, &g.offset[0], &g.target[0], &g.weight[0], threads );
+	TIME_TICK_END
+	TIME_TICK_PRINT("CH_BUILD")
+	printf("UPWARD ARCS=%lld(%.2f PER VERTEX)\n", (long long) idx.target.size(), (double) idx.target.size() / g.n );
+	if ( ! ch_save( idx, ( name + ".ch" ).c_str() ) ){
+		printf("CANNOT WRITE %s.ch\n", name.c_str() );
+		exit(1);
+	}
+	return 0;
+}
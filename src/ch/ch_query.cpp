@@ -0,0 +1,117 @@
+// kNN and point to point queries over a contraction hierarchies index(ch_build), through the
+// common Engine interface(../common/engine.h)
+//
+// options: -n name = data set name.cnode/.cedge/.ch(default cal)
+//          -o file = objects, "vid oid" lines(default name.object)
+//          -w file = kNN queries, "locid K" lines; output per query "ID=vid DIS=d" nearest first, then the
+//                    time line, the same as gtree_query, so ../bench/bench.sh reads every engine alike
+//          -p file = point to point queries, "s t" lines, "DIS=d" per line
+//          -s file = query stats as JSON(../common/query_stats.h), -t N = query threads(one engine each)
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<string>
+#include<vector>
+#include<thread>
+#include "../common/graph_csr.h"
+#include "../common/ch.h"
+#include "../common/query_stats.h"
+using namespace std;
+
+#define WEIGHT_INFLATE_FACTOR 100000
+
+const char* const stats_phase_names[1] = { "total" };
+
+// "a b" pairs of a text file
+bool read_pairs( const char* file, vector< pair<int,int> > &out ){
+	FILE* fin = fopen( file, "r" );
+	if ( fin == NULL ) return false;
+	int a, b;
+	while ( fscanf( fin, "%d %d", &a, &b ) == 2 ) out.push_back( make_pair( a, b ) );
+	fclose(fin);
+	return true;
+}
+
+int main( int argc, char* argv[] ){
+	string name = "cal", object_file;
+	const char *knn_file = NULL, *p2p_file = NULL, *stats_file = NULL;
+	int threads = 1;
+	for ( int i = 1; i < argc; i++ ){
+		if ( strcmp( argv[i], "-n" ) == 0 && i + 1 < argc ) name = argv[++i];
+		else if ( strcmp( argv[i], "-o" ) == 0 && i + 1 < argc ) object_file = argv[++i];
+		else if ( strcmp( argv[i], "-w" ) == 0 && i + 1 < argc ) knn_file = argv[++i];
+		else if ( strcmp( argv[i], "-p" ) == 0 && i + 1 < argc ) p2p_file = argv[++i];
+		else if ( strcmp( argv[i], "-s" ) == 0 && i + 1 < argc ) stats_file = argv[++i];
+		else if ( strcmp( argv[i], "-t" ) == 0 && i + 1 < argc ) threads = atoi( argv[++i] );
+	}
+	if ( threads < 1 ) threads = 1;
+	if ( object_file.size() == 0 ) object_file = name + ".object";
+
+	CsrGraph g;
+	bool cached;
+	if ( ! csr_load( g, ( name + ".cnode" ).c_str(), ( name + ".cedge" ).c_str(), WEIGHT_INFLATE_FACTOR, thread::hardware_concurrency(), false, cached ) ){
+		printf("CANNOT LOAD %s.cnode/.cedge\n", name.c_str() );
+		exit(1);
+	}
+	ChIndex idx;
+	if ( ! ch_load( idx, ( name + ".ch" ).c_str(), g.n ) ){
+		printf("CANNOT LOAD %s.ch(RUN ch_build -n %s)\n", name.c_str(), name.c_str() );
+		exit(1);
+	}
+	vector<ChEngine*> engines;
+	for ( int t = 0; t < threads; t++ ) engines.push_back( new ChEngine( idx, thread::hardware_concurrency() ) );
+	vector<QueryStats> stats( stats_file != NULL ? threads : 0 );
+	for ( int i = 0; i < stats.size(); i++ ) stats_init( stats[i] );
+
+	vector< pair<int,int> > query;
+	vector<long long> cost;
+	if ( knn_file != NULL ){
+		vector< pair<int,int> > objs;
+		if ( ! read_pairs( object_file.c_str(), objs ) || ! read_pairs( knn_file, query ) ){
+			printf("CANNOT OPEN %s OR %s\n", object_file.c_str(), knn_file );
+			exit(1);
+		}
+		vector<int> vid;
+		for ( int i = 0; i < objs.size(); i++ ) vid.push_back( objs[i].first );
+		engines[0]->set_objects( vid );
+		for ( int t = 1; t < threads; t++ ) engines[t]->share_objects( *engines[0] );
+		vector< vector< pair<int,int> > > ans( query.size() );
+		cost.resize( query.size() );
+		parallel_for( threads, query.size(), [&]( int worker, int q ){
+			QueryStats* st = stats.size() > 0 ? &stats[worker] : NULL;
+			Engine* e = engines[worker];
+			stats_begin( st );
+			long long t0 = stats_now();
+			e->knn( query[q].first, query[q].second, ans[q] );
+			cost[q] = stats_now() - t0;
+			stats_add( st, 0, cost[q] );
+			stats_end( st, 1 );
+		} );
+		for ( int q = 0; q < query.size(); q++ ){
+			for ( int i = 0; i < ans[q].size(); i++ ) printf("ID=%d DIS=%d\n", vid[ans[q][i].first], ans[q][i].second );
+			printf("\"KNN_SEARCH\" RESULT: %lld (0.01MS)\r\n", cost[q] / 10000 );
+		}
+	}
+	if ( p2p_file != NULL ){
+		query.clear();
+		if ( ! read_pairs( p2p_file, query ) ){
+			printf("CANNOT OPEN %s\n", p2p_file );
+			exit(1);
+		}
+		vector<int> dis( query.size() );
+		parallel_for( threads, query.size(), [&]( int worker, int q ){
+			QueryStats* st = stats.size() > 0 ? &stats[worker] : NULL;
+			stats_begin( st );
+			long long t0 = stats_now();
+			dis[q] = engines[worker]->distance( query[q].first, query[q].second );
+			stats_add( st, 0, stats_now() - t0 );
+			stats_end( st, 1 );
+		} );
+		for ( int q = 0; q < query.size(); q++ ) printf("DIS=%d\n", dis[q] );
+	}
+	if ( stats_file != NULL ){
+		for ( int i = 1; i < threads; i++ ) stats_merge( stats[0], stats[i] );
+		if ( ! stats_json_save( stats_file, stats[0], stats_phase_names, 1, NULL, 0 ) ) printf("CANNOT WRITE %s\n", stats_file );
+	}
+	return 0;
+}
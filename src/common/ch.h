@@ -0,0 +1,439 @@
+// contraction hierarchies over an undirected graph, an Engine(engine.h) for p2p, path, one-to-many and kNN
+//
+// build: vertices are contracted in rounds. a round takes every vertex whose priority
+// (shortcuts - degree + contracted neighbours) is lower than that of all its uncontracted neighbours:
+// an independent set, contracted at once on all threads. the witness searches of a round avoid the whole
+// set(its members are not adjacent, so every shortcut path left out has a witness outside the set), then
+// the arc changes are applied per vertex in parallel and the neighbours get new priorities.
+// the rounds do not depend on the thread count, so neither does the index.
+// witness searches stop after CH_WITNESS_SETTLE vertices, a missed witness only costs a shortcut.
+// index: upward arcs(to higher rank) of each vertex, mid = the contracted vertex of a shortcut(-1 = edge).
+// query: bidirectional upward dijkstra. one-to-many/kNN: buckets, each target's upward search space
+// leaves (target, distance) at the vertices it settles, a query scans the buckets of its own upward space.
+#ifndef CH_H
+#define CH_H
+
+#include<stdio.h>
+#include<vector>
+#include<string>
+#include<algorithm>
+#include "dheap.h"
+#include "task_pool.h"
+#include "engine.h"
+
+#define CH_MAGIC 0x58494843 // "CHIX"
+#define CH_VERSION 1
+#define CH_INF ENGINE_INF
+#define CH_WITNESS_SETTLE 500
+
+typedef struct{
+	int n;
+	std::vector<int> rank; // [n], contraction order
+	std::vector<long long> offset; // [n + 1], upward arcs of v at [offset[v], offset[v+1])
+	std::vector<int> target, weight, mid;
+}ChIndex;
+
+typedef struct{
+	int to, w, mid;
+}ChArc;
+
+// shortcuts needed when v is contracted: (x, y, w) over pairs of uncontracted neighbours,
+// witness paths avoid v and the vertices with avoid[u] == stamp(the round's set when contracting)
+inline void ch_shortcuts( const std::vector< std::vector<ChArc> > &adj, int v, DHeap &h, const std::vector<int> &avoid, int stamp, std::vector<ChArc> &out, std::vector<int> &from ){
+	out.clear();
+	from.clear();
+	const std::vector<ChArc> &a = adj[v];
+	for ( int i = 0; i + 1 < a.size(); i++ ){
+		int x = a[i].to, bound = 0;
+		for ( int j = i + 1; j < a.size(); j++ ) bound = std::max( bound, a[i].w + a[j].w );
+		dheap_reset( h );
+		dheap_push( h, x, 0 );
+		int settled = 0;
+		while ( h.size > 0 && settled < CH_WITNESS_SETTLE ){
+			int u = dheap_pop( h );
+			int d = h.key[u];
+			if ( d > bound ) break;
+			settled++;
+			for ( int e = 0; e < adj[u].size(); e++ ){
+				int y = adj[u][e].to;
+				if ( y == v || avoid[y] == stamp ) continue;
+				dheap_push( h, y, d + adj[u][e].w );
+			}
+		}
+		for ( int j = i + 1; j < a.size(); j++ ){
+			int y = a[j].to, w = a[i].w + a[j].w;
+			if ( dheap_touched( h, y ) && h.key[y] <= w ) continue; // a tentative key is a witness path too
+			ChArc s = { y, w, v };
+			out.push_back( s );
+			from.push_back( x );
+		}
+	}
+}
+
+// graph in CSR form(neighbours of v at [offset[v], offset[v+1]), both directions)
+inline void ch_build( ChIndex &idx, int n, const long long* offset, const int* target, const int* weight, int nthreads ){
+	if ( nthreads < 1 ) nthreads = 1;
+	std::vector< std::vector<ChArc> > adj( n );
+	for ( int v = 0; v < n; v++ ){
+		for ( long long e = offset[v]; e < offset[v+1]; e++ ){
+			int u = target[e];
+			if ( u == v ) continue;
+			int k = 0;
+			while ( k < adj[v].size() && adj[v][k].to != u ) k++;
+			if ( k == adj[v].size() ){
+				ChArc a = { u, weight[e], -1 };
+				adj[v].push_back( a );
+			}
+			else if ( weight[e] < adj[v][k].w ) adj[v][k].w = weight[e];
+		}
+	}
+	std::vector<DHeap> heaps( nthreads );
+	for ( int t = 0; t < nthreads; t++ ) dheap_init( heaps[t], n );
+	std::vector< std::vector<ChArc> > sc( nthreads );
+	std::vector< std::vector<int> > scfrom( nthreads );
+	std::vector<int> prio( n ), dn( n, 0 ), avoid( n, 0 ), todo, left;
+	std::vector< std::vector<ChArc> > up( n );
+	idx.rank.assign( n, -1 );
+	for ( int v = 0; v < n; v++ ) todo.push_back( v );
+	left = todo;
+	int round = 0, next = 0;
+	while ( left.size() > 0 ){
+		// priorities of the changed vertices(all in the first round)
+		parallel_for( nthreads, todo.size(), [&]( int worker, int i ){
+			int v = todo[i];
+			ch_shortcuts( adj, v, heaps[worker], avoid, -1, sc[worker], scfrom[worker] );
+			prio[v] = (int) sc[worker].size() - (int) adj[v].size() + dn[v];
+		} );
+		// independent set: lower(priority, id) than every neighbour
+		std::vector<int> set;
+		for ( int i = 0; i < left.size(); i++ ){
+			int v = left[i];
+			bool low = true;
+			for ( int e = 0; e < adj[v].size() && low; e++ ){
+				int u = adj[v][e].to;
+				low = prio[v] < prio[u] || ( prio[v] == prio[u] && v < u );
+			}
+			if ( low ) set.push_back( v );
+		}
+		round++;
+		for ( int i = 0; i < set.size(); i++ ) avoid[set[i]] = round;
+		std::vector< std::vector<ChArc> > add( set.size() );
+		std::vector< std::vector<int> > addfrom( set.size() );
+		parallel_for( nthreads, set.size(), [&]( int worker, int i ){
+			ch_shortcuts( adj, set[i], heaps[worker], avoid, round, add[i], addfrom[i] );
+		} );
+		// arc changes grouped by the vertex they touch, in set order: drop the arc to v, then the shortcuts
+		std::vector< std::pair<int, ChArc> > ops;
+		for ( int i = 0; i < set.size(); i++ ){
+			int v = set[i];
+			idx.rank[v] = next++;
+			up[v] = adj[v];
+			for ( int e = 0; e < adj[v].size(); e++ ){
+				ChArc drop = { v, -1, -1 };
+				ops.push_back( std::make_pair( adj[v][e].to, drop ) );
+			}
+			for ( int k = 0; k < add[i].size(); k++ ){
+				ChArc a = add[i][k], b = { addfrom[i][k], add[i][k].w, v };
+				ops.push_back( std::make_pair( addfrom[i][k], a ) );
+				ops.push_back( std::make_pair( a.to, b ) );
+			}
+		}
+		std::vector<long long> start( n + 1, 0 );
+		for ( int i = 0; i < ops.size(); i++ ) start[ops[i].first + 1]++;
+		for ( int v = 0; v < n; v++ ) start[v+1] += start[v];
+		std::vector<ChArc> byv( ops.size() );
+		std::vector<long long> fill( start.begin(), start.end() - 1 );
+		for ( int i = 0; i < ops.size(); i++ ) byv[fill[ops[i].first]++] = ops[i].second;
+		todo.clear();
+		for ( int v = 0; v < n; v++ ){
+			if ( start[v+1] > start[v] ) todo.push_back( v );
+		}
+		parallel_for( nthreads, todo.size(), [&]( int worker, int i ){
+			int u = todo[i];
+			std::vector<ChArc> &a = adj[u];
+			for ( long long o = start[u]; o < start[u+1]; o++ ){
+				const ChArc &c = byv[o];
+				if ( c.w < 0 ){
+					for ( int e = 0; e < a.size(); e++ ){
+						if ( a[e].to == c.to ){ a[e] = a.back(); a.pop_back(); break; }
+					}
+					dn[u]++;
+					continue;
+				}
+				int e = 0;
+				while ( e < a.size() && a[e].to != c.to ) e++;
+				if ( e == a.size() ) a.push_back( c );
+				else if ( c.w < a[e].w ) a[e] = c;
+			}
+		} );
+		for ( int i = 0; i < set.size(); i++ ) std::vector<ChArc>().swap( adj[set[i]] );
+		std::vector<int> rest;
+		for ( int i = 0; i < left.size(); i++ ){
+			if ( idx.rank[left[i]] < 0 ) rest.push_back( left[i] );
+		}
+		left.swap( rest );
+	}
+	idx.n = n;
+	idx.offset.assign( n + 1, 0 );
+	for ( int v = 0; v < n; v++ ) idx.offset[v+1] = idx.offset[v] + up[v].size();
+	idx.target.resize( idx.offset[n] );
+	idx.weight.resize( idx.offset[n] );
+	idx.mid.resize( idx.offset[n] );
+	for ( int v = 0; v < n; v++ ){
+		for ( int e = 0; e < up[v].size(); e++ ){
+			idx.target[idx.offset[v] + e] = up[v][e].to;
+			idx.weight[idx.offset[v] + e] = up[v][e].w;
+			idx.mid[idx.offset[v] + e] = up[v][e].mid;
+		}
+	}
+}
+
+// per thread query scratch
+typedef struct{
+	DHeap f, b;
+	std::vector<int> fby, bby; // vertex whose arc set the key
+	std::vector<int> dist, stamp, touched; // one-to-many: per target, valid when stamp == f.stamp
+}ChQuery;
+
+inline void ch_query_init( ChQuery &q, int n ){
+	dheap_init( q.f, n );
+	dheap_init( q.b, n );
+	q.fby.assign( n, -1 );
+	q.bby.assign( n, -1 );
+}
+
+inline void ch_relax( const ChIndex &idx, DHeap &h, std::vector<int> &by, int v, int d ){
+	for ( long long e = idx.offset[v]; e < idx.offset[v+1]; e++ ){
+		int u = idx.target[e], k = d + idx.weight[e];
+		if ( ! dheap_touched( h, u ) || ( h.pos[u] >= 0 && k < h.key[u] ) ){
+			by[u] = v;
+			dheap_push( h, u, k );
+		}
+	}
+}
+
+// distance, meet = top vertex of the shortest path(-1 if none)
+inline int ch_search( const ChIndex &idx, ChQuery &q, int s, int t, int &meet ){
+	dheap_reset( q.f );
+	dheap_reset( q.b );
+	meet = s == t ? s : -1;
+	if ( s == t ) return 0;
+	dheap_push( q.f, s, 0 );
+	dheap_push( q.b, t, 0 );
+	int best = CH_INF;
+	while ( q.f.size > 0 || q.b.size > 0 ){
+		int fk = q.f.size > 0 ? q.f.key[q.f.heap[0]] : CH_INF, bk = q.b.size > 0 ? q.b.key[q.b.heap[0]] : CH_INF;
+		if ( std::min( fk, bk ) >= best ) break;
+		bool fwd = fk <= bk;
+		DHeap &h = fwd ? q.f : q.b, &o = fwd ? q.b : q.f;
+		int v = dheap_pop( h );
+		int d = h.key[v];
+		if ( dheap_touched( o, v ) && d + o.key[v] < best ){
+			best = d + o.key[v];
+			meet = v;
+		}
+		ch_relax( idx, h, fwd ? q.fby : q.bby, v, d );
+	}
+	return best;
+}
+
+inline int ch_distance( const ChIndex &idx, ChQuery &q, int s, int t ){
+	int meet;
+	return ch_search( idx, q, s, t, meet );
+}
+
+// original edges of the arc between u and v(adjacent in the hierarchy), appends the vertices after u up to v
+inline void ch_unpack( const ChIndex &idx, int u, int v, std::vector<int> &route ){
+	int lo = idx.rank[u] < idx.rank[v] ? u : v, hi = lo == u ? v : u;
+	long long e = idx.offset[lo];
+	while ( idx.target[e] != hi ) e++;
+	int m = idx.mid[e];
+	if ( m < 0 ){
+		route.push_back( v );
+		return;
+	}
+	ch_unpack( idx, u, m, route );
+	ch_unpack( idx, m, v, route );
+}
+
+inline int ch_path( const ChIndex &idx, ChQuery &q, int s, int t, std::vector<int> &route ){
+	route.clear();
+	int meet, d = ch_search( idx, q, s, t, meet );
+	if ( meet < 0 ) return d;
+	// s .. meet by the forward parents, meet .. t by the backward ones
+	std::vector<int> up;
+	for ( int v = meet; v != s; v = q.fby[v] ) up.push_back( v );
+	up.push_back( s );
+	route.push_back( s );
+	for ( int i = (int) up.size() - 1; i > 0; i-- ) ch_unpack( idx, up[i], up[i-1], route );
+	for ( int v = meet; v != t; v = q.bby[v] ) ch_unpack( idx, v, q.bby[v], route );
+	return d;
+}
+
+// target buckets of a vertex set: entries (target index, distance target -> v) at each v of its upward space
+typedef struct{
+	int targets;
+	std::vector<long long> offset; // [n + 1]
+	std::vector<int> target, dist;
+}ChBuckets;
+
+// full upward search from s, calls fn(v, d) on every settled vertex
+template<class F>
+void ch_upward( const ChIndex &idx, DHeap &h, int s, F fn ){
+	dheap_reset( h );
+	dheap_push( h, s, 0 );
+	while ( h.size > 0 ){
+		int v = dheap_pop( h );
+		int d = h.key[v];
+		fn( v, d );
+		for ( long long e = idx.offset[v]; e < idx.offset[v+1]; e++ ) dheap_push( h, idx.target[e], d + idx.weight[e] );
+	}
+}
+
+inline void ch_buckets( const ChIndex &idx, const std::vector<int> &targets, int nthreads, ChBuckets &b ){
+	if ( nthreads < 1 ) nthreads = 1;
+	std::vector< std::vector< std::pair<int,int> > > space( targets.size() );
+	std::vector<DHeap> heaps( nthreads < (int) targets.size() ? nthreads : 1 );
+	for ( int t = 0; t < heaps.size(); t++ ) dheap_init( heaps[t], idx.n );
+	parallel_for( heaps.size(), targets.size(), [&]( int worker, int i ){
+		ch_upward( idx, heaps[worker], targets[i], [&]( int v, int d ){
+			space[i].push_back( std::make_pair( v, d ) );
+		} );
+	} );
+	b.targets = targets.size();
+	b.offset.assign( idx.n + 1, 0 );
+	for ( int i = 0; i < space.size(); i++ ){
+		for ( int j = 0; j < space[i].size(); j++ ) b.offset[space[i][j].first + 1]++;
+	}
+	for ( int v = 0; v < idx.n; v++ ) b.offset[v+1] += b.offset[v];
+	b.target.resize( b.offset[idx.n] );
+	b.dist.resize( b.offset[idx.n] );
+	std::vector<long long> fill( b.offset.begin(), b.offset.end() - 1 );
+	for ( int i = 0; i < space.size(); i++ ){
+		for ( int j = 0; j < space[i].size(); j++ ){
+			long long p = fill[space[i][j].first]++;
+			b.target[p] = i;
+			b.dist[p] = space[i][j].second;
+		}
+	}
+}
+
+// distances from s to the bucket targets it reaches: q.touched lists them, q.dist[i] the distance
+inline void ch_one_to_many( const ChIndex &idx, ChQuery &q, const ChBuckets &b, int s ){
+	if ( q.dist.size() < b.targets ){
+		q.dist.assign( b.targets, CH_INF );
+		q.stamp.assign( b.targets, 0 );
+	}
+	q.touched.clear();
+	ch_upward( idx, q.f, s, [&]( int v, int d ){
+		for ( long long p = b.offset[v]; p < b.offset[v+1]; p++ ){
+			int i = b.target[p], k = d + b.dist[p];
+			if ( q.stamp[i] != q.f.stamp ){
+				q.stamp[i] = q.f.stamp;
+				q.dist[i] = k;
+				q.touched.push_back( i );
+			}
+			else if ( k < q.dist[i] ) q.dist[i] = k;
+		}
+	} );
+}
+
+template<class V>
+bool ch_fwrite( FILE* fout, const V &v ){
+	return v.size() == 0 || fwrite( &v[0], sizeof(v[0]), v.size(), fout ) == v.size();
+}
+
+template<class V>
+bool ch_fread( FILE* fin, V &v, long long count ){
+	v.resize( count );
+	return count == 0 || fread( &v[0], sizeof(v[0]), count, fin ) == (size_t) count;
+}
+
+// header: magic, version, n, then arcs(long long), rank, offset, target, weight, mid
+inline bool ch_save( const ChIndex &idx, const char* file ){
+	std::string tmp = std::string( file ) + ".tmp";
+	FILE* fout = fopen( tmp.c_str(), "wb" );
+	if ( fout == NULL ) return false;
+	int h[3] = { CH_MAGIC, CH_VERSION, idx.n };
+	long long arcs = idx.target.size();
+	bool ok = fwrite( h, sizeof(h), 1, fout ) == 1 && fwrite( &arcs, sizeof(arcs), 1, fout ) == 1
+		&& ch_fwrite( fout, idx.rank ) && ch_fwrite( fout, idx.offset )
+		&& ch_fwrite( fout, idx.target ) && ch_fwrite( fout, idx.weight ) && ch_fwrite( fout, idx.mid );
+	ok = fclose(fout) == 0 && ok;
+	if ( ok ) ok = rename( tmp.c_str(), file ) == 0;
+	if ( ! ok ) remove( tmp.c_str() );
+	return ok;
+}
+
+// false if missing, another version or not over n vertices
+inline bool ch_load( ChIndex &idx, const char* file, int n ){
+	FILE* fin = fopen( file, "rb" );
+	if ( fin == NULL ) return false;
+	int h[3];
+	long long arcs;
+	bool ok = fread( h, sizeof(h), 1, fin ) == 1 && h[0] == CH_MAGIC && h[1] == CH_VERSION && h[2] == n
+		&& fread( &arcs, sizeof(arcs), 1, fin ) == 1 && arcs >= 0;
+	if ( ok ){
+		idx.n = n;
+		ok = ch_fread( fin, idx.rank, n ) && ch_fread( fin, idx.offset, (long long) n + 1 )
+			&& ch_fread( fin, idx.target, arcs ) && ch_fread( fin, idx.weight, arcs ) && ch_fread( fin, idx.mid, arcs )
+			&& idx.offset[0] == 0 && idx.offset[n] == arcs;
+		for ( int v = 0; ok && v < n; v++ ) ok = idx.offset[v] <= idx.offset[v+1];
+		for ( long long e = 0; ok && e < arcs; e++ ) ok = idx.target[e] >= 0 && idx.target[e] < n && idx.mid[e] < n;
+	}
+	fclose(fin);
+	return ok;
+}
+
+// the Engine over one index; knn/range scan the buckets of the object set,
+// engines of other threads can share the buckets of one(share_objects)
+struct ChEngine : Engine{
+	const ChIndex &idx;
+	ChQuery q;
+	ChBuckets own, many;
+	const ChBuckets* objs;
+	int threads; // bucket builds(set_objects, one_to_many)
+
+	ChEngine( const ChIndex &i, int nthreads = 1 ) : idx( i ), objs( &own ), threads( nthreads ){
+		ch_query_init( q, idx.n );
+		own.targets = 0;
+	}
+	const char* name(){ return "ch"; }
+	int distance( int s, int t ){ return ch_distance( idx, q, s, t ); }
+	bool path( int s, int t, std::vector<int> &route, int &dist ){
+		dist = ch_path( idx, q, s, t, route );
+		return true;
+	}
+	void one_to_many( int s, const std::vector<int> &targets, std::vector<int> &out ){
+		ch_buckets( idx, targets, threads, many );
+		ch_one_to_many( idx, q, many, s );
+		out.assign( targets.size(), CH_INF );
+		for ( int i = 0; i < q.touched.size(); i++ ) out[q.touched[i]] = q.dist[q.touched[i]];
+	}
+	void set_objects( const std::vector<int> &o ){
+		objects = o;
+		ch_buckets( idx, objects, threads, own );
+		objs = &own;
+	}
+	void share_objects( const ChEngine &e ){
+		objects = e.objects;
+		objs = e.objs;
+	}
+	void knn( int s, int k, std::vector< std::pair<int,int> > &out ){
+		select( s, k, CH_INF, out );
+	}
+	void range( int s, int r, std::vector< std::pair<int,int> > &out ){
+		select( s, objs->targets, r, out );
+	}
+	void select( int s, int k, int bound, std::vector< std::pair<int,int> > &out ){
+		ch_one_to_many( idx, q, *objs, s );
+		out.clear();
+		for ( int i = 0; i < q.touched.size(); i++ ){
+			int o = q.touched[i];
+			if ( q.dist[o] < bound ) out.push_back( std::make_pair( o, q.dist[o] ) );
+		}
+		engine_sort( out, k );
+	}
+};
+
+#endif
@@ -0,0 +1,122 @@
+// 4-ary min heap with decrease-key over dense vertex ids [0,n)
+//
+// all per vertex arrays are allocated once(dheap_init) and cleared by a stamp:
+// a vertex is untouched in the current run unless mark[v] == stamp, so dheap_reset is O(1)
+// and a search allocates nothing.
+#ifndef DHEAP_H
+#define DHEAP_H
+
+#include<vector>
+
+typedef struct{
+	int stamp;
+	int size;
+	std::vector<int> mark; // mark[v] == stamp: key[v], pos[v] valid in this run
+	std::vector<int> key; // tentative distance
+	std::vector<int> pos; // position in heap, -1 once popped(settled)
+	std::vector<int> heap; // vertex ids
+	std::vector<int> tag; // caller's per vertex flag, set in this run when tag[v] == stamp
+}DHeap;
+
+inline void dheap_init( DHeap &h, int n ){
+	h.stamp = 1;
+	h.size = 0;
+	h.mark.assign( n, 0 );
+	h.key.assign( n, 0 );
+	h.pos.assign( n, -1 );
+	h.heap.assign( n, 0 );
+	h.tag.assign( n, 0 );
+}
+
+// start a new run
+inline void dheap_reset( DHeap &h ){
+	h.size = 0;
+	if ( ++h.stamp == 0x7fffffff ){
+		h.mark.assign( h.mark.size(), 0 );
+		h.tag.assign( h.tag.size(), 0 );
+		h.stamp = 1;
+	}
+}
+
+inline bool dheap_touched( DHeap &h, int v ){
+	return h.mark[v] == h.stamp;
+}
+
+inline bool dheap_settled( DHeap &h, int v ){
+	return h.mark[v] == h.stamp && h.pos[v] < 0;
+}
+
+inline void dheap_tag( DHeap &h, int v ){
+	h.tag[v] = h.stamp;
+}
+
+inline bool dheap_tagged( DHeap &h, int v ){
+	return h.tag[v] == h.stamp;
+}
+
+inline void dheap_untag( DHeap &h, int v ){
+	h.tag[v] = 0;
+}
+
+inline void dheap_up( DHeap &h, int i ){
+	int v = h.heap[i], k = h.key[v];
+	while ( i > 0 ){
+		int p = ( i - 1 ) >> 2;
+		int u = h.heap[p];
+		if ( h.key[u] <= k ) break;
+		h.heap[i] = u;
+		h.pos[u] = i;
+		i = p;
+	}
+	h.heap[i] = v;
+	h.pos[v] = i;
+}
+
+inline void dheap_down( DHeap &h, int i ){
+	int v = h.heap[i], k = h.key[v];
+	while ( true ){
+		int c = ( i << 2 ) + 1;
+		if ( c >= h.size ) break;
+		int end = c + 4 < h.size ? c + 4 : h.size;
+		int best = c;
+		for ( int j = c + 1; j < end; j++ ){
+			if ( h.key[h.heap[j]] < h.key[h.heap[best]] ) best = j;
+		}
+		if ( h.key[h.heap[best]] >= k ) break;
+		h.heap[i] = h.heap[best];
+		h.pos[h.heap[i]] = i;
+		i = best;
+	}
+	h.heap[i] = v;
+	h.pos[v] = i;
+}
+
+// insert v with key k, or decrease its key; settled vertices are left alone
+inline void dheap_push( DHeap &h, int v, int k ){
+	if ( h.mark[v] != h.stamp ){
+		h.mark[v] = h.stamp;
+		h.key[v] = k;
+		h.heap[h.size] = v;
+		h.size ++;
+		dheap_up( h, h.size - 1 );
+	}
+	else if ( h.pos[v] >= 0 && k < h.key[v] ){
+		h.key[v] = k;
+		dheap_up( h, h.pos[v] );
+	}
+}
+
+// pop the vertex with min key, it becomes settled, its distance stays in key[v]
+inline int dheap_pop( DHeap &h ){
+	int v = h.heap[0];
+	h.size --;
+	if ( h.size > 0 ){
+		h.heap[0] = h.heap[h.size];
+		h.pos[h.heap[0]] = 0;
+		dheap_down( h, 0 );
+	}
+	h.pos[v] = -1;
+	return v;
+}
+
+#endif
@@ -0,0 +1,73 @@
+// common query interface of the distance engines, so one caller can swap them(per region, A/B runs)
+//
+// vertices are dense ids [0,n), distances int, ENGINE_INF when not reachable.
+// objects: set_objects once, then knn/range answer over that set as (object index, distance) pairs,
+// nearest first, equal distances by index. the defaults build everything from distance(), an engine
+// overrides what it has a faster way for. path() is false if the engine keeps no routes.
+// an engine object is used by one thread at a time(it owns its query scratch), run one per thread.
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include<vector>
+#include<algorithm>
+
+#define ENGINE_INF 0x3fffffff
+
+struct Engine{
+	virtual ~Engine(){}
+	virtual const char* name() = 0;
+	virtual int distance( int s, int t ) = 0;
+	// route s .. t(both included) and its length
+	virtual bool path( int s, int t, std::vector<int> &route, int &dist ){
+		route.clear();
+		dist = distance( s, t );
+		return false;
+	}
+	// out[i] = distance( s, targets[i] )
+	virtual void one_to_many( int s, const std::vector<int> &targets, std::vector<int> &out ){
+		out.resize( targets.size() );
+		for ( int i = 0; i < targets.size(); i++ ) out[i] = distance( s, targets[i] );
+	}
+	virtual void set_objects( const std::vector<int> &o ){
+		objects = o;
+	}
+	// k nearest objects
+	virtual void knn( int s, int k, std::vector< std::pair<int,int> > &out ){
+		one_to_many( s, objects, scratch );
+		engine_select( scratch, k, ENGINE_INF, out );
+	}
+	// objects with distance < r
+	virtual void range( int s, int r, std::vector< std::pair<int,int> > &out ){
+		one_to_many( s, objects, scratch );
+		engine_select( scratch, (int) scratch.size(), r, out );
+	}
+
+	// the k smallest of d[] below bound as (index, distance), nearest first
+	static void engine_select( const std::vector<int> &d, int k, int bound, std::vector< std::pair<int,int> > &out ){
+		out.clear();
+		for ( int i = 0; i < d.size(); i++ ){
+			if ( d[i] < bound ) out.push_back( std::make_pair( i, d[i] ) );
+		}
+		engine_sort( out, k );
+	}
+	// nearest first(equal distances by index), cut to k
+	static void engine_sort( std::vector< std::pair<int,int> > &out, int k ){
+		if ( k < 0 ) k = 0;
+		struct By_Dist{
+			bool operator()( const std::pair<int,int> &a, const std::pair<int,int> &b ) const {
+				return a.second != b.second ? a.second < b.second : a.first < b.first;
+			}
+		};
+		if ( k < (int) out.size() ){
+			std::nth_element( out.begin(), out.begin() + k, out.end(), By_Dist() );
+			out.resize( k );
+		}
+		std::sort( out.begin(), out.end(), By_Dist() );
+	}
+
+protected:
+	std::vector<int> objects;
+	std::vector<int> scratch;
+};
+
+#endif
@@ -0,0 +1,330 @@
+// road network loader shared by the engines: .cnode/.cedge text -> CSR graph
+//
+// node file: "nid x y" per line, vertex ids are the line order
+// edge file: "eid snid enid weight" per line, weight * inflate kept as int.
+//            undirected: both directions, directed: snid -> enid only
+//
+// the text is read in one go and parsed in chunks(one per thread, split at line breaks),
+// then adjacency is laid out serially in file order, so the neighbour order of each vertex is
+// the same as pushing both directions edge after edge.
+// csr_load keeps a binary copy next to the edge file(edge file + ".csr", ".dcsr" when directed) and uses it as long as
+// both text files keep their size and mtime, later runs skip the text entirely.
+#ifndef GRAPH_CSR_H
+#define GRAPH_CSR_H
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<sys/stat.h>
+#include<vector>
+#include<string>
+#include "task_pool.h"
+
+#define CSR_MAGIC 0x52534347 // "GCSR"
+#define CSR_VERSION 1
+#define CSR_ENDIAN 0x01020304
+
+typedef struct{
+	int n; // |vertices|
+	long long m; // |edges| in the edge file
+	std::vector<double> x, y; // [n]
+	std::vector<long long> offset; // [n + 1], neighbours of v at [offset[v], offset[v+1])
+	std::vector<int> target;
+	std::vector<int> weight;
+}CsrGraph;
+
+typedef struct{
+	int magic;
+	int version;
+	int endian;
+	int inflate; // weight factor the cache was built with
+	int n;
+	int directed;
+	long long m;
+	long long nadj; // |target|
+	long long node_bytes, node_mtime; // stamp of the text files
+	long long edge_bytes, edge_mtime;
+}CsrHeader;
+
+#define CSR_DEGREE(g,v) ((int)((g).offset[(v)+1] - (g).offset[v]))
+
+// whole file into buf, '\0' terminated
+inline bool csr_read_file( const char* file, std::vector<char> &buf ){
+	FILE* fin = fopen( file, "rb" );
+	if ( fin == NULL ) return false;
+	fseeko( fin, 0, SEEK_END );
+	long long bytes = ftello( fin );
+	fseeko( fin, 0, SEEK_SET );
+	buf.resize( bytes + 1 );
+	bool ok = bytes == 0 || fread( &buf[0], 1, bytes, fin ) == (size_t) bytes;
+	buf[bytes] = '\0';
+	fclose(fin);
+	return ok;
+}
+
+// split [0,bytes) into parts chunks starting at line beginnings, begin[parts] = bytes
+inline void csr_chunks( const std::vector<char> &buf, int parts, std::vector<long long> &begin ){
+	long long bytes = buf.size() - 1;
+	begin.assign( parts + 1, bytes );
+	begin[0] = 0;
+	for ( int i = 1; i < parts; i++ ){
+		long long p = bytes * i / parts;
+		if ( p < begin[i-1] ) p = begin[i-1];
+		while ( p > 0 && p < bytes && buf[p-1] != '\n' ) p++;
+		begin[i] = p;
+	}
+}
+
+inline bool csr_blank( char c ){
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+// parse one int field at p, false if there is none on this line
+inline bool csr_int( const char* &p, long long &v ){
+	while ( csr_blank(*p) ) p++;
+	bool neg = *p == '-';
+	if ( neg || *p == '+' ) p++;
+	if ( *p < '0' || *p > '9' ) return false;
+	v = 0;
+	while ( *p >= '0' && *p <= '9' ) v = v * 10 + ( *p++ - '0' );
+	if ( neg ) v = -v;
+	return true;
+}
+
+// parse one real field at p, strtod so the value is the one fscanf("%lf") gives
+inline bool csr_real( const char* &p, double &v ){
+	while ( csr_blank(*p) ) p++;
+	if ( *p == '\n' || *p == '\0' ) return false;
+	char* end;
+	v = strtod( p, &end );
+	if ( end == p ) return false;
+	p = end;
+	return true;
+}
+
+inline const char* csr_next_line( const char* p ){
+	while ( *p != '\n' && *p != '\0' ) p++;
+	return *p == '\n' ? p + 1 : p;
+}
+
+// parse both text files with nthreads threads
+inline bool csr_load_text( CsrGraph &g, const char* node_file, const char* edge_file, int inflate, int nthreads, bool directed ){
+	if ( nthreads < 1 ) nthreads = 1;
+	std::vector<char> buf;
+	std::vector<long long> begin;
+
+	// nodes
+	if ( ! csr_read_file( node_file, buf ) ){
+		printf("CANNOT OPEN %s\n", node_file );
+		return false;
+	}
+	csr_chunks( buf, nthreads, begin );
+	std::vector< std::vector<double> > cx( nthreads ), cy( nthreads );
+	parallel_for( nthreads, nthreads, [&]( int worker, int c ){
+		const char* p = &buf[0] + begin[c];
+		const char* end = &buf[0] + begin[c+1];
+		long long nid;
+		double x, y;
+		for ( ; p < end; p = csr_next_line( p ) ){
+			const char* q = p;
+			if ( csr_int( q, nid ) && csr_real( q, x ) && csr_real( q, y ) ){
+				cx[c].push_back( x );
+				cy[c].push_back( y );
+			}
+		}
+	} );
+	g.x.clear();
+	g.y.clear();
+	for ( int c = 0; c < nthreads; c++ ){
+		g.x.insert( g.x.end(), cx[c].begin(), cx[c].end() );
+		g.y.insert( g.y.end(), cy[c].begin(), cy[c].end() );
+		std::vector<double>().swap( cx[c] );
+		std::vector<double>().swap( cy[c] );
+	}
+	g.n = g.x.size();
+
+	// edges, 3 ints per edge per chunk
+	if ( ! csr_read_file( edge_file, buf ) ){
+		printf("CANNOT OPEN %s\n", edge_file );
+		return false;
+	}
+	csr_chunks( buf, nthreads, begin );
+	std::vector< std::vector<int> > ce( nthreads );
+	int n = g.n;
+	parallel_for( nthreads, nthreads, [&]( int worker, int c ){
+		const char* p = &buf[0] + begin[c];
+		const char* end = &buf[0] + begin[c+1];
+		long long eid, s, t;
+		double w;
+		for ( ; p < end; p = csr_next_line( p ) ){
+			const char* q = p;
+			if ( csr_int( q, eid ) && csr_int( q, s ) && csr_int( q, t ) && csr_real( q, w )
+				&& s >= 0 && s < n && t >= 0 && t < n ){
+				ce[c].push_back( s );
+				ce[c].push_back( t );
+				ce[c].push_back( (int) ( w * inflate ) );
+			}
+		}
+	} );
+	std::vector<char>().swap( buf );
+
+	// degrees, then neighbours in file order
+	g.offset.assign( n + 1, 0 );
+	g.m = 0;
+	for ( int c = 0; c < nthreads; c++ ){
+		for ( size_t i = 0; i < ce[c].size(); i += 3 ){
+			g.offset[ ce[c][i] + 1 ] ++;
+			if ( ! directed ) g.offset[ ce[c][i+1] + 1 ] ++;
+		}
+		g.m += ce[c].size() / 3;
+	}
+	for ( int v = 0; v < n; v++ ){
+		g.offset[v+1] += g.offset[v];
+	}
+	g.target.resize( g.offset[n] );
+	g.weight.resize( g.offset[n] );
+	std::vector<long long> fill( g.offset.begin(), g.offset.end() - 1 );
+	for ( int c = 0; c < nthreads; c++ ){
+		for ( size_t i = 0; i < ce[c].size(); i += 3 ){
+			int s = ce[c][i], t = ce[c][i+1], w = ce[c][i+2];
+			g.target[ fill[s] ] = t;
+			g.weight[ fill[s]++ ] = w;
+			if ( directed ) continue;
+			g.target[ fill[t] ] = s;
+			g.weight[ fill[t]++ ] = w;
+		}
+		std::vector<int>().swap( ce[c] );
+	}
+	return true;
+}
+
+// size & mtime of a file, false if missing
+inline bool csr_stamp( const char* file, long long &bytes, long long &mtime ){
+	struct stat st;
+	if ( stat( file, &st ) != 0 ) return false;
+	bytes = st.st_size;
+	mtime = st.st_mtime;
+	return true;
+}
+
+template<class V>
+bool csr_fwrite( FILE* fout, const V &v ){
+	return v.size() == 0 || fwrite( &v[0], sizeof(v[0]), v.size(), fout ) == v.size();
+}
+
+template<class V>
+bool csr_fread( FILE* fin, V &v, long long count ){
+	v.resize( count );
+	return count == 0 || fread( &v[0], sizeof(v[0]), count, fin ) == (size_t) count;
+}
+
+// binary copy of g, stamped with the text files it came from
+inline bool csr_save( const CsrGraph &g, const char* file, const char* node_file, const char* edge_file, int inflate, bool directed ){
+	CsrHeader h;
+	memset( &h, 0, sizeof(h) );
+	h.magic = CSR_MAGIC;
+	h.version = CSR_VERSION;
+	h.endian = CSR_ENDIAN;
+	h.inflate = inflate;
+	h.n = g.n;
+	h.directed = directed ? 1 : 0;
+	h.m = g.m;
+	h.nadj = g.target.size();
+	if ( ! csr_stamp( node_file, h.node_bytes, h.node_mtime ) || ! csr_stamp( edge_file, h.edge_bytes, h.edge_mtime ) ) return false;
+
+	// write aside, then rename, a reader never sees half a file
+	std::string tmp = std::string( file ) + ".tmp";
+	FILE* fout = fopen( tmp.c_str(), "wb" );
+	if ( fout == NULL ) return false;
+	bool ok = fwrite( &h, sizeof(h), 1, fout ) == 1
+		&& csr_fwrite( fout, g.x ) && csr_fwrite( fout, g.y ) && csr_fwrite( fout, g.offset )
+		&& csr_fwrite( fout, g.target ) && csr_fwrite( fout, g.weight );
+	ok = fclose(fout) == 0 && ok;
+	if ( ok ) ok = rename( tmp.c_str(), file ) == 0;
+	if ( ! ok ) remove( tmp.c_str() );
+	return ok;
+}
+
+// load a binary copy, false if missing or stale(text files changed, other inflate or direction)
+inline bool csr_load_binary( CsrGraph &g, const char* file, const char* node_file, const char* edge_file, int inflate, bool directed ){
+	FILE* fin = fopen( file, "rb" );
+	if ( fin == NULL ) return false;
+	CsrHeader h;
+	long long nb, nm, eb, em;
+	bool ok = fread( &h, sizeof(h), 1, fin ) == 1
+		&& h.magic == CSR_MAGIC && h.version == CSR_VERSION && h.endian == CSR_ENDIAN && h.inflate == inflate && h.directed == ( directed ? 1 : 0 )
+		&& csr_stamp( node_file, nb, nm ) && csr_stamp( edge_file, eb, em )
+		&& h.node_bytes == nb && h.node_mtime == nm && h.edge_bytes == eb && h.edge_mtime == em;
+	if ( ok ){
+		g.n = h.n;
+		g.m = h.m;
+		ok = csr_fread( fin, g.x, h.n ) && csr_fread( fin, g.y, h.n ) && csr_fread( fin, g.offset, (long long) h.n + 1 )
+			&& csr_fread( fin, g.target, h.nadj ) && csr_fread( fin, g.weight, h.nadj )
+			&& g.offset[h.n] == h.nadj;
+	}
+	fclose(fin);
+	return ok;
+}
+
+// binary copy if up to date, text otherwise(then the copy is refreshed)
+// edge table for locations on edges("edge id, offset from snid"): s[eid] -> t[eid], weight w[eid] * inflate,
+// s[eid] = -1 for an id without a valid line. read from the text(the CSR keeps no edge ids), on use only
+typedef struct{
+	std::vector<int> s, t, w;
+}CsrEdges;
+
+inline bool csr_edges_load( CsrEdges &e, const char* edge_file, int n, int inflate, int nthreads ){
+	if ( nthreads < 1 ) nthreads = 1;
+	std::vector<char> buf;
+	std::vector<long long> begin;
+	if ( ! csr_read_file( edge_file, buf ) ){
+		printf("CANNOT OPEN %s\n", edge_file );
+		return false;
+	}
+	csr_chunks( buf, nthreads, begin );
+	std::vector< std::vector<int> > ce( nthreads );
+	parallel_for( nthreads, nthreads, [&]( int worker, int c ){
+		const char* p = &buf[0] + begin[c];
+		const char* end = &buf[0] + begin[c+1];
+		long long eid, s, t;
+		double w;
+		for ( ; p < end; p = csr_next_line( p ) ){
+			const char* q = p;
+			if ( csr_int( q, eid ) && csr_int( q, s ) && csr_int( q, t ) && csr_real( q, w )
+				&& eid >= 0 && eid < 0x7fffffff && s >= 0 && s < n && t >= 0 && t < n ){
+				ce[c].push_back( eid );
+				ce[c].push_back( s );
+				ce[c].push_back( t );
+				ce[c].push_back( (int) ( w * inflate ) );
+			}
+		}
+	} );
+	std::vector<char>().swap( buf );
+	int m = 0;
+	for ( int c = 0; c < nthreads; c++ ){
+		for ( size_t i = 0; i < ce[c].size(); i += 4 ) m = ce[c][i] + 1 > m ? ce[c][i] + 1 : m;
+	}
+	e.s.assign( m, -1 );
+	e.t.assign( m, -1 );
+	e.w.assign( m, 0 );
+	for ( int c = 0; c < nthreads; c++ ){
+		for ( size_t i = 0; i < ce[c].size(); i += 4 ){
+			e.s[ ce[c][i] ] = ce[c][i+1];
+			e.t[ ce[c][i] ] = ce[c][i+2];
+			e.w[ ce[c][i] ] = ce[c][i+3];
+		}
+	}
+	return true;
+}
+
+// cached = true if the binary copy was used
+inline bool csr_load( CsrGraph &g, const char* node_file, const char* edge_file, int inflate, int nthreads, bool directed, bool &cached ){
+	std::string cache = std::string( edge_file ) + ( directed ? ".dcsr" : ".csr" );
+	cached = csr_load_binary( g, cache.c_str(), node_file, edge_file, inflate, directed );
+	if ( cached ) return true;
+	if ( ! csr_load_text( g, node_file, edge_file, inflate, nthreads, directed ) ) return false;
+	csr_save( g, cache.c_str(), node_file, edge_file, inflate, directed );
+	return true;
+}
+
+#endif
@@ -0,0 +1,204 @@
+// 2-hop(hub) labels for point to point distance queries, pruned landmark labeling
+//
+// every vertex v keeps a label: (hub rank, distance to the hub) pairs, sorted by rank.
+// dist(s, t) = min over common hubs h of d(s, h) + d(h, t), one merge-join of two labels.
+// the hubs are taken in the given vertex order(most important first); the dijkstra from each hub
+// is pruned at every vertex that the labels so far already answer within the same distance.
+// build parallelism: the hubs of a batch(one per thread) run at once, pruned by the labels of the earlier
+// batches. appending the batch in rank order, an entry(v, d) of a hub is dropped again if an earlier hub
+// of the same batch covers it: d(s, h) + d(h, v) <= d. what is left is what the serial build keeps.
+// the label store is CSR(offset / hub / dist), hubs and distances in separate arrays so the
+// AVX2 join compares 8 hubs at a time(-mavx2 or -march=native, scalar merge otherwise).
+#ifndef HUB_LABEL_H
+#define HUB_LABEL_H
+
+#include<stdio.h>
+#include<string.h>
+#include<vector>
+#include<string>
+#include "dheap.h"
+#include "task_pool.h"
+#include "engine.h"
+#if defined(__AVX2__)
+#include<immintrin.h>
+#endif
+
+#define HUB_MAGIC 0x4c425548 // "HUBL"
+#define HUB_VERSION 1
+#define HUB_INF ENGINE_INF // HUB_INF + HUB_INF still fits in int
+
+typedef struct{
+	int n;
+	std::vector<long long> offset; // [n + 1], label of v at [offset[v], offset[v+1])
+	std::vector<int> hub; // hub rank
+	std::vector<int> dist;
+	std::vector<int> order; // [n], vertex of each rank
+}HubLabel;
+
+// merge-join of two sorted labels, HUB_INF when no common hub
+inline int hub_join( const int* ha, const int* da, int na, const int* hb, const int* db, int nb ){
+	int i = 0, j = 0, m = HUB_INF;
+#if defined(__AVX2__)
+	// 8 x 8 block compare: b rotated through all lanes, matching lanes give da + db; hubs are unique in a label
+	if ( na >= 8 && nb >= 8 ){
+		const __m256i rot = _mm256_setr_epi32( 1, 2, 3, 4, 5, 6, 7, 0 );
+		const __m256i inf = _mm256_set1_epi32( HUB_INF );
+		__m256i vm = inf;
+		while ( i + 8 <= na && j + 8 <= nb ){
+			__m256i vha = _mm256_loadu_si256( (const __m256i*)( ha + i ) );
+			__m256i vda = _mm256_loadu_si256( (const __m256i*)( da + i ) );
+			__m256i vhb = _mm256_loadu_si256( (const __m256i*)( hb + j ) );
+			__m256i vdb = _mm256_loadu_si256( (const __m256i*)( db + j ) );
+			for ( int r = 0; r < 8; r++ ){
+				__m256i eq = _mm256_cmpeq_epi32( vha, vhb );
+				vm = _mm256_min_epi32( vm, _mm256_blendv_epi8( inf, _mm256_add_epi32( vda, vdb ), eq ) );
+				vhb = _mm256_permutevar8x32_epi32( vhb, rot );
+				vdb = _mm256_permutevar8x32_epi32( vdb, rot );
+			}
+			int a7 = ha[i+7], b7 = hb[j+7];
+			if ( a7 <= b7 ) i += 8;
+			if ( b7 <= a7 ) j += 8;
+		}
+		__m128i v = _mm_min_epi32( _mm256_castsi256_si128( vm ), _mm256_extracti128_si256( vm, 1 ) );
+		v = _mm_min_epi32( v, _mm_shuffle_epi32( v, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+		v = _mm_min_epi32( v, _mm_shuffle_epi32( v, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+		m = _mm_cvtsi128_si32( v );
+	}
+#endif
+	while ( i < na && j < nb ){
+		if ( ha[i] < hb[j] ) i++;
+		else if ( ha[i] > hb[j] ) j++;
+		else{
+			if ( da[i] + db[j] < m ) m = da[i] + db[j];
+			i++;
+			j++;
+		}
+	}
+	return m;
+}
+
+inline int hub_query( const HubLabel &L, int s, int t ){
+	if ( s == t ) return 0;
+	long long a = L.offset[s], b = L.offset[t];
+	return hub_join( &L.hub[0] + a, &L.dist[0] + a, (int)( L.offset[s+1] - a ), &L.hub[0] + b, &L.dist[0] + b, (int)( L.offset[t+1] - b ) );
+}
+
+// labels over an undirected graph in CSR form(neighbours of v at [offset[v], offset[v+1])), order = vertices by importance
+inline void hub_build( HubLabel &L, int n, const long long* offset, const int* target, const int* weight, const std::vector<int> &order, int nthreads ){
+	if ( nthreads < 1 ) nthreads = 1;
+	std::vector< std::vector< std::pair<int,int> > > lab( n ); // (rank, dist) during the build
+	std::vector<DHeap> heaps( nthreads );
+	std::vector< std::vector<int> > hubdist( nthreads, std::vector<int>( n, HUB_INF ) ); // label of the current hub by rank
+	std::vector< std::vector<int> > batchdist( nthreads, std::vector<int>( n, HUB_INF ) ); // kept entries of each hub of the batch by vertex
+	for ( int t = 0; t < nthreads; t++ ) dheap_init( heaps[t], n );
+	std::vector< std::vector< std::pair<int,int> > > out;
+	for ( int r = 0; r < n; ){
+		int batch = nthreads < n - r ? nthreads : n - r;
+		out.assign( batch, std::vector< std::pair<int,int> >() );
+		parallel_for( nthreads, batch, [&]( int worker, int k ){
+			int s = order[r+k];
+			DHeap &h = heaps[worker];
+			std::vector<int> &hd = hubdist[worker];
+			for ( int i = 0; i < lab[s].size(); i++ ) hd[lab[s][i].first] = lab[s][i].second;
+			dheap_reset( h );
+			dheap_push( h, s, 0 );
+			while ( h.size > 0 ){
+				int v = dheap_pop( h );
+				int d = h.key[v];
+				bool covered = false;
+				for ( int i = 0; i < lab[v].size() && ! covered; i++ ){
+					covered = hd[lab[v][i].first] + lab[v][i].second <= d;
+				}
+				if ( covered ) continue;
+				out[k].push_back( std::make_pair( v, d ) );
+				for ( long long e = offset[v]; e < offset[v+1]; e++ ){
+					dheap_push( h, target[e], d + weight[e] );
+				}
+			}
+			for ( int i = 0; i < lab[s].size(); i++ ) hd[lab[s][i].first] = HUB_INF;
+		} );
+		for ( int k = 0; k < batch; k++ ){
+			int s = order[r+k];
+			for ( int i = 0; i < out[k].size(); i++ ){
+				int v = out[k][i].first, d = out[k][i].second;
+				bool covered = false;
+				for ( int j = 0; j < k && ! covered; j++ ) covered = batchdist[j][s] + batchdist[j][v] <= d;
+				if ( covered ) continue;
+				batchdist[k][v] = d;
+				lab[v].push_back( std::make_pair( r + k, d ) );
+			}
+		}
+		for ( int k = 0; k < batch; k++ ){
+			for ( int i = 0; i < out[k].size(); i++ ) batchdist[k][out[k][i].first] = HUB_INF;
+		}
+		r += batch;
+	}
+	L.n = n;
+	L.order = order;
+	L.offset.assign( n + 1, 0 );
+	for ( int v = 0; v < n; v++ ) L.offset[v+1] = L.offset[v] + lab[v].size();
+	L.hub.resize( L.offset[n] );
+	L.dist.resize( L.offset[n] );
+	parallel_for( nthreads, n, [&]( int worker, int v ){
+		for ( int i = 0; i < lab[v].size(); i++ ){
+			L.hub[L.offset[v] + i] = lab[v][i].first;
+			L.dist[L.offset[v] + i] = lab[v][i].second;
+		}
+		std::vector< std::pair<int,int> >().swap( lab[v] );
+	} );
+}
+
+template<class V>
+bool hub_fwrite( FILE* fout, const V &v ){
+	return v.size() == 0 || fwrite( &v[0], sizeof(v[0]), v.size(), fout ) == v.size();
+}
+
+template<class V>
+bool hub_fread( FILE* fin, V &v, long long count ){
+	v.resize( count );
+	return count == 0 || fread( &v[0], sizeof(v[0]), count, fin ) == (size_t) count;
+}
+
+// header: magic, version, n, then entries(long long), offset, hub, dist, order
+inline bool hub_save( const HubLabel &L, const char* file ){
+	std::string tmp = std::string( file ) + ".tmp";
+	FILE* fout = fopen( tmp.c_str(), "wb" );
+	if ( fout == NULL ) return false;
+	int h[3] = { HUB_MAGIC, HUB_VERSION, L.n };
+	long long entries = L.hub.size();
+	bool ok = fwrite( h, sizeof(h), 1, fout ) == 1 && fwrite( &entries, sizeof(entries), 1, fout ) == 1
+		&& hub_fwrite( fout, L.offset ) && hub_fwrite( fout, L.hub ) && hub_fwrite( fout, L.dist ) && hub_fwrite( fout, L.order );
+	ok = fclose(fout) == 0 && ok;
+	if ( ok ) ok = rename( tmp.c_str(), file ) == 0;
+	if ( ! ok ) remove( tmp.c_str() );
+	return ok;
+}
+
+// false if missing, another version or not over n vertices
+inline bool hub_load( HubLabel &L, const char* file, int n ){
+	FILE* fin = fopen( file, "rb" );
+	if ( fin == NULL ) return false;
+	int h[3];
+	long long entries;
+	bool ok = fread( h, sizeof(h), 1, fin ) == 1 && h[0] == HUB_MAGIC && h[1] == HUB_VERSION && h[2] == n
+		&& fread( &entries, sizeof(entries), 1, fin ) == 1 && entries >= 0;
+	if ( ok ){
+		L.n = n;
+		ok = hub_fread( fin, L.offset, (long long) n + 1 ) && hub_fread( fin, L.hub, entries ) && hub_fread( fin, L.dist, entries )
+			&& hub_fread( fin, L.order, n ) && L.offset[0] == 0 && L.offset[n] == entries;
+		for ( int v = 0; ok && v < n; v++ ) ok = L.offset[v] <= L.offset[v+1];
+	}
+	fclose(fin);
+	return ok;
+}
+
+// the Engine over labels: distances only, the rest falls back to distance()
+struct HubEngine : Engine{
+	const HubLabel &L;
+
+	HubEngine( const HubLabel &l ) : L( l ){}
+	const char* name(){ return "hub"; }
+	int distance( int s, int t ){ return hub_query( L, s, t ); }
+};
+
+#endif
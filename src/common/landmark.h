@@ -0,0 +1,166 @@
+// landmark(ALT) lower bounds on network distance
+//
+// k landmarks L, chosen farthest-point: the first is the vertex farthest from vertex 0, every next one the
+// vertex farthest from all chosen so far. with d(L, v) and d(v, L) known for every v, the triangle inequality gives
+//	d(s, t) >= d(L, t) - d(L, s)  and  d(s, t) >= d(s, L) - d(t, L)
+// and the bound is the max over the landmarks. a set of vertices(tree node) gets one bound for all of them
+// from the min of d(L, v) and the max of d(v, L) over the set(landmark_group_*).
+// the tables are vertex major(the k distances of v side by side, one cache line per vertex). on a symmetric
+// graph(every edge has its reverse with the same weight) d(v, L) = d(L, v) and only one table is kept.
+// the choice is sequential(each pick needs the distances of the previous ones), the reverse tables of a
+// directed graph are computed on nthreads.
+#ifndef LANDMARK_H
+#define LANDMARK_H
+
+#include<vector>
+#include<algorithm>
+#include "dheap.h"
+#include "task_pool.h"
+
+#define LANDMARK_INF 0x3fffffff
+
+typedef struct{
+	int n, k;
+	std::vector<int> id; // landmark vertices
+	std::vector<int> from; // [v * k + i] = d(id[i], v)
+	std::vector<int> to; // [v * k + i] = d(v, id[i]), empty when the graph is symmetric
+}Landmarks;
+
+// d(s, v) for all v into out[v * stride], LANDMARK_INF if not reachable
+inline void landmark_dijkstra( DHeap &h, int n, const long long* offset, const int* target, const int* weight, int s, int* out, int stride ){
+	for ( int v = 0; v < n; v++ ) out[(long long) v * stride] = LANDMARK_INF;
+	dheap_reset( h );
+	dheap_push( h, s, 0 );
+	while ( h.size > 0 ){
+		int v = dheap_pop( h );
+		int d = h.key[v];
+		out[(long long) v * stride] = d;
+		for ( long long e = offset[v]; e < offset[v+1]; e++ ) dheap_push( h, target[e], d + weight[e] );
+	}
+}
+
+// every edge u -> v has an edge v -> u of the same weight
+inline bool landmark_symmetric( int n, const long long* offset, const int* target, const int* weight ){
+	std::vector< std::vector< std::pair<int,int> > > adj( n );
+	for ( int u = 0; u < n; u++ ){
+		for ( long long e = offset[u]; e < offset[u+1]; e++ ) adj[u].push_back( std::make_pair( target[e], weight[e] ) );
+		std::sort( adj[u].begin(), adj[u].end() );
+	}
+	for ( int u = 0; u < n; u++ ){
+		for ( int i = 0; i < adj[u].size(); i++ ){
+			const std::vector< std::pair<int,int> > &b = adj[adj[u][i].first];
+			if ( ! std::binary_search( b.begin(), b.end(), std::make_pair( u, adj[u][i].second ) ) ) return false;
+		}
+	}
+	return true;
+}
+
+// k landmarks over a graph in CSR form(edges of v at [offset[v], offset[v+1]))
+inline void landmark_build( Landmarks &M, int n, const long long* offset, const int* target, const int* weight, int k, int nthreads ){
+	if ( nthreads < 1 ) nthreads = 1;
+	if ( k > n ) k = n;
+	if ( k < 0 ) k = 0;
+	M.n = n;
+	M.k = k;
+	M.id.clear();
+	M.from.assign( (long long) n * k, LANDMARK_INF );
+	M.to.clear();
+	if ( k == 0 ) return;
+	DHeap h;
+	dheap_init( h, n );
+	std::vector<int> near( n ), d0( n );
+	landmark_dijkstra( h, n, offset, target, weight, 0, &d0[0], 1 );
+	for ( int i = 0; i < k; i++ ){
+		// farthest reachable vertex from what is chosen(from vertex 0 for the first one)
+		const std::vector<int> &d = i == 0 ? d0 : near;
+		int best = -1;
+		for ( int v = 0; v < n; v++ ){
+			if ( d[v] < LANDMARK_INF && d[v] > 0 && ( best == -1 || d[v] > d[best] ) ) best = v;
+		}
+		if ( best == -1 ) break; // nothing left to spread over
+		M.id.push_back( best );
+		landmark_dijkstra( h, n, offset, target, weight, best, &M.from[i], k );
+		for ( int v = 0; v < n; v++ ){
+			int x = M.from[(long long) v * k + i];
+			near[v] = i == 0 || x < near[v] ? x : near[v];
+		}
+	}
+	if ( M.id.size() < k ){
+		// fewer than k vertices to pick: shrink the table to the landmarks found
+		int k2 = M.id.size();
+		for ( long long v = 0; v < n; v++ ){
+			for ( int i = 0; i < k2; i++ ) M.from[v * k2 + i] = M.from[v * k + i];
+		}
+		M.k = k = k2;
+		M.from.resize( (long long) n * k );
+	}
+	if ( k == 0 || landmark_symmetric( n, offset, target, weight ) ) return;
+	// reverse graph for d(v, L)
+	std::vector<long long> roff( n + 1, 0 );
+	std::vector<int> rt( offset[n] ), rw( offset[n] );
+	for ( long long e = 0; e < offset[n]; e++ ) roff[target[e] + 1]++;
+	for ( int v = 0; v < n; v++ ) roff[v+1] += roff[v];
+	std::vector<long long> pos( roff.begin(), roff.end() - 1 );
+	for ( int u = 0; u < n; u++ ){
+		for ( long long e = offset[u]; e < offset[u+1]; e++ ){
+			rt[pos[target[e]]] = u;
+			rw[pos[target[e]]++] = weight[e];
+		}
+	}
+	M.to.assign( (long long) n * k, LANDMARK_INF );
+	std::vector<DHeap> heaps( nthreads );
+	for ( int t = 0; t < nthreads && t < k; t++ ) dheap_init( heaps[t], n );
+	parallel_for( nthreads, k, [&]( int worker, int i ){
+		landmark_dijkstra( heaps[worker], n, &roff[0], &rt[0], &rw[0], M.id[i], &M.to[i], k );
+	} );
+}
+
+// the bound between two rows(a = source, b = target) of distances from the landmarks(af, bf), to them(at, bt)
+inline int landmark_rows( const int* af, const int* at, const int* bf, const int* bt, int k ){
+	int m = 0;
+	for ( int i = 0; i < k; i++ ){
+		// d(L, s) finite: d(L, t) <= d(L, s) + d(s, t); d(t, L) finite: d(s, L) <= d(s, t) + d(t, L)
+		if ( af[i] < LANDMARK_INF && bf[i] - af[i] > m ) m = bf[i] - af[i];
+		if ( bt[i] < LANDMARK_INF && at[i] - bt[i] > m ) m = at[i] - bt[i];
+	}
+	return m;
+}
+
+// <= d(s, t), 0 without landmarks
+inline int landmark_bound( const Landmarks &M, int s, int t ){
+	if ( M.k == 0 ) return 0;
+	const std::vector<int> &to = M.to.empty() ? M.from : M.to;
+	long long a = (long long) s * M.k, b = (long long) t * M.k;
+	return landmark_rows( &M.from[a], &to[a], &M.from[b], &to[b], M.k );
+}
+
+// group rows: min over the group of d(L, v), max of d(v, L); start with landmark_group_init
+inline void landmark_group_init( int k, int* gf, int* gt ){
+	for ( int i = 0; i < k; i++ ){
+		gf[i] = LANDMARK_INF;
+		gt[i] = -1;
+	}
+}
+
+inline void landmark_group_add( int k, int* gf, int* gt, const int* f, const int* t ){
+	for ( int i = 0; i < k; i++ ){
+		gf[i] = f[i] < gf[i] ? f[i] : gf[i];
+		gt[i] = t[i] > gt[i] ? t[i] : gt[i];
+	}
+}
+
+// <= d(s, v) for every v of the group(gf, gt)
+inline int landmark_group_bound( const Landmarks &M, int s, const int* gf, const int* gt ){
+	if ( M.k == 0 ) return 0;
+	const std::vector<int> &to = M.to.empty() ? M.from : M.to;
+	long long a = (long long) s * M.k;
+	int m = 0;
+	for ( int i = 0; i < M.k; i++ ){
+		// a group with an unreachable member(gt = INF) has no bound through d(v, L)
+		if ( M.from[a+i] < LANDMARK_INF && gf[i] - M.from[a+i] > m ) m = gf[i] - M.from[a+i];
+		if ( gt[i] < LANDMARK_INF && to[a+i] - gt[i] > m ) m = to[a+i] - gt[i];
+	}
+	return m;
+}
+
+#endif
@@ -0,0 +1,296 @@
+// min-plus(tropical) vector kernel for border distance propagation
+// shared by gtree(knn_query) and gtree_new_p2p(push_borders_*_catch)
+//
+// distances are int, unreachable = MINPLUS_INF. MINPLUS_INF + MINPLUS_INF still fits in int,
+// so no sentinel test is needed in the inner loops.
+// the AVX-512/AVX2 paths are chosen at compile time(-mavx2, -mavx512f or -march=native),
+// otherwise the scalar loop is used.
+#ifndef MINPLUS_H
+#define MINPLUS_H
+
+#include<string.h>
+#include<vector>
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include<immintrin.h>
+#endif
+
+#define MINPLUS_INF 0x3fffffff
+
+// packed rows(minplus_pack): cells in chunks of MINPLUS_CHUNK, each chunk is a header int then its cells
+// as offsets to the chunk base, little endian, the narrowest width the range of the chunk fits:
+//	header in [0, MINPLUS_PACK24): base, 16 bit cells(2 per int);
+//	header >= MINPLUS_PACK24:      base = header - MINPLUS_PACK24, 24 bit cells(4 per 3 ints);
+//	header < 0:                    plain int cells(too wide, or unreachable cells).
+// the last chunk of a row may be short, its cells are padded to a whole int(24 bit: at least one byte, so
+// every cell can be read as 4 bytes).
+// lossless, so the kernel gives the same results as on the plain row.
+#define MINPLUS_CHUNK 16
+#define MINPLUS_PACK24 0x40000000
+
+#if defined(__AVX2__)
+// horizontal min of 8 lanes
+inline int minplus_hmin256( __m256i vm ){
+	__m128i v = _mm_min_epi32( _mm256_castsi256_si128( vm ), _mm256_extracti128_si256( vm, 1 ) );
+	v = _mm_min_epi32( v, _mm_shuffle_epi32( v, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	v = _mm_min_epi32( v, _mm_shuffle_epi32( v, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+	return _mm_cvtsi128_si32( v );
+}
+#endif
+
+// min_k( a[k] + b[k] ), k in [0,n), MINPLUS_INF when n = 0
+inline int minplus_min( const int* a, const int* b, int n ){
+	int k = 0;
+	int m = MINPLUS_INF;
+#if defined(__AVX512F__)
+	if ( n >= 16 ){
+		__m512i vm = _mm512_set1_epi32( MINPLUS_INF );
+		for ( ; k + 16 <= n; k += 16 ){
+			__m512i va = _mm512_loadu_si512( (const void*)( a + k ) );
+			__m512i vb = _mm512_loadu_si512( (const void*)( b + k ) );
+			vm = _mm512_min_epi32( vm, _mm512_add_epi32( va, vb ) );
+		}
+		m = minplus_hmin256( _mm256_min_epi32( _mm512_castsi512_si256( vm ), _mm512_extracti64x4_epi64( vm, 1 ) ) );
+	}
+#endif
+#if defined(__AVX2__)
+	if ( n - k >= 8 ){
+		__m256i vm = _mm256_set1_epi32( m );
+		for ( ; k + 8 <= n; k += 8 ){
+			__m256i va = _mm256_loadu_si256( (const __m256i*)( a + k ) );
+			__m256i vb = _mm256_loadu_si256( (const __m256i*)( b + k ) );
+			vm = _mm256_min_epi32( vm, _mm256_add_epi32( va, vb ) );
+		}
+		m = minplus_hmin256( vm );
+	}
+#endif
+	for ( ; k < n; k++ ){
+		int d = a[k] + b[k];
+		m = d < m ? d : m;
+	}
+	return m;
+}
+
+// ints of a chunk of len cells after its header h
+inline int minplus_chunk_ints( int h, int len ){
+	if ( h < 0 ) return len;
+	if ( h < MINPLUS_PACK24 ) return ( len * 2 + 3 ) / 4;
+	return len == MINPLUS_CHUNK ? MINPLUS_CHUNK * 3 / 4 : ( len * 3 + 4 ) / 4;
+}
+
+// append row[0,n) packed
+inline void minplus_pack( const int* row, int n, std::vector<int> &out ){
+	unsigned char bytes[MINPLUS_CHUNK * 3 + 4];
+	for ( int k = 0; k < n; k += MINPLUS_CHUNK ){
+		int len = n - k < MINPLUS_CHUNK ? n - k : MINPLUS_CHUNK;
+		int lo = row[k], hi = row[k];
+		for ( int i = 1; i < len; i++ ){
+			lo = row[k + i] < lo ? row[k + i] : lo;
+			hi = row[k + i] > hi ? row[k + i] : hi;
+		}
+		int width = lo < 0 || hi >= MINPLUS_INF ? 4 : hi - lo <= 0xffff ? 2 : hi - lo <= 0xffffff ? 3 : 4;
+		if ( width == 4 ){
+			out.push_back( -1 );
+			out.insert( out.end(), row + k, row + k + len );
+			continue;
+		}
+		int h = width == 2 ? lo : lo + MINPLUS_PACK24;
+		memset( bytes, 0, sizeof(bytes) );
+		for ( int i = 0; i < len; i++ ){
+			unsigned int d = row[k + i] - lo;
+			for ( int b = 0; b < width; b++ ) bytes[ i * width + b ] = ( d >> ( 8 * b ) ) & 0xff;
+		}
+		out.push_back( h );
+		size_t pos = out.size();
+		out.resize( pos + minplus_chunk_ints( h, len ) );
+		memcpy( &out[pos], bytes, minplus_chunk_ints( h, len ) * sizeof(int) );
+	}
+}
+
+// cell i of a chunk with header h, cells at p
+inline int minplus_chunk_cell( int h, const int* p, int i ){
+	if ( h < 0 ) return p[i];
+	if ( h < MINPLUS_PACK24 ) return h + ( (const unsigned short*) p )[i];
+	const unsigned char* c = (const unsigned char*) p + i * 3;
+	return h - MINPLUS_PACK24 + ( c[0] | ( c[1] << 8 ) | ( c[2] << 16 ) );
+}
+
+// out[0,n) = packed row p
+inline void minplus_unpack( const int* p, int n, int* out ){
+	for ( int k = 0; k < n; k += MINPLUS_CHUNK ){
+		int len = n - k < MINPLUS_CHUNK ? n - k : MINPLUS_CHUNK;
+		int h = *p++;
+		for ( int i = 0; i < len; i++ ) out[k + i] = minplus_chunk_cell( h, p, i );
+		p += minplus_chunk_ints( h, len );
+	}
+}
+
+#if defined(__AVX2__)
+// 8 cells of a full chunk as ints, half = 0 or 1. cells are base + offset, base added by the caller
+inline __m256i minplus_chunk_load( int h, const int* p, int half ){
+	if ( h < 0 ) return _mm256_loadu_si256( (const __m256i*)( p + half * 8 ) );
+	if ( h < MINPLUS_PACK24 ) return _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i*)( p + half * 4 ) ) );
+	// 24 bit: the 12 ints of the chunk read as [0,8) and [4,12), 3 byte cells spread to one per lane
+	const __m256i perm = half == 0 ? _mm256_setr_epi32( 0, 1, 2, 0, 3, 4, 5, 0 ) : _mm256_setr_epi32( 2, 3, 4, 0, 5, 6, 7, 0 );
+	const __m256i shuf = _mm256_setr_epi8( 0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128, 9, 10, 11, -128,
+		0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128, 9, 10, 11, -128 );
+	__m256i v = _mm256_permutevar8x32_epi32( _mm256_loadu_si256( (const __m256i*)( p + half * 4 ) ), perm );
+	return _mm256_shuffle_epi8( v, shuf );
+}
+#endif
+
+// min_k( a[k] + row[k] ), k in [0,n), row packed at p. cells are decoded in registers, full chunks
+// MINPLUS_CHUNK wide(two AVX2 halves, one AVX-512 vector, one byte permute for 24 bit with AVX-512 VBMI),
+// only the last short chunk is scalar.
+inline int minplus_min_packed( const int* a, const int* p, int n ){
+	int k = 0;
+	int m = MINPLUS_INF;
+#if defined(__AVX2__)
+	if ( n >= MINPLUS_CHUNK ){
+#if defined(__AVX512F__)
+		__m512i vm = _mm512_set1_epi32( MINPLUS_INF );
+#else
+		__m256i vm = _mm256_set1_epi32( MINPLUS_INF );
+#endif
+		for ( ; k + MINPLUS_CHUNK <= n; k += MINPLUS_CHUNK ){
+			int h = *p++;
+			int base = h < 0 ? 0 : h < MINPLUS_PACK24 ? h : h - MINPLUS_PACK24;
+#if defined(__AVX512VBMI__) && defined(__AVX512BW__)
+			// 24 bit: the 48 bytes of the chunk, byte 3i..3i+2 to lane i in one permute
+			__m512i vr;
+			if ( h >= MINPLUS_PACK24 ){
+				const __m512i idx = _mm512_set_epi8( 0, 47, 46, 45, 0, 44, 43, 42, 0, 41, 40, 39, 0, 38, 37, 36,
+					0, 35, 34, 33, 0, 32, 31, 30, 0, 29, 28, 27, 0, 26, 25, 24,
+					0, 23, 22, 21, 0, 20, 19, 18, 0, 17, 16, 15, 0, 14, 13, 12,
+					0, 11, 10, 9, 0, 8, 7, 6, 0, 5, 4, 3, 0, 2, 1, 0 );
+				vr = _mm512_maskz_permutexvar_epi8( 0x7777777777777777ULL, idx, _mm512_maskz_loadu_epi8( 0xffffffffffffULL, p ) );
+			}
+			else if ( h >= 0 ) vr = _mm512_cvtepu16_epi32( _mm256_loadu_si256( (const __m256i*) p ) );
+			else vr = _mm512_loadu_si512( (const void*) p );
+			vr = _mm512_add_epi32( vr, _mm512_set1_epi32( base ) );
+			vm = _mm512_min_epi32( vm, _mm512_add_epi32( _mm512_loadu_si512( (const void*)( a + k ) ), vr ) );
+#elif defined(__AVX512F__)
+			__m256i vb = _mm256_set1_epi32( base );
+			__m256i v0 = _mm256_add_epi32( minplus_chunk_load( h, p, 0 ), vb );
+			__m256i v1 = _mm256_add_epi32( minplus_chunk_load( h, p, 1 ), vb );
+			__m512i vr = _mm512_inserti64x4( _mm512_castsi256_si512( v0 ), v1, 1 );
+			vm = _mm512_min_epi32( vm, _mm512_add_epi32( _mm512_loadu_si512( (const void*)( a + k ) ), vr ) );
+#else
+			__m256i vb = _mm256_set1_epi32( base );
+			__m256i v0 = _mm256_add_epi32( minplus_chunk_load( h, p, 0 ), vb );
+			__m256i v1 = _mm256_add_epi32( minplus_chunk_load( h, p, 1 ), vb );
+			vm = _mm256_min_epi32( vm, _mm256_add_epi32( _mm256_loadu_si256( (const __m256i*)( a + k ) ), v0 ) );
+			vm = _mm256_min_epi32( vm, _mm256_add_epi32( _mm256_loadu_si256( (const __m256i*)( a + k + 8 ) ), v1 ) );
+#endif
+			p += minplus_chunk_ints( h, MINPLUS_CHUNK );
+		}
+#if defined(__AVX512F__)
+		m = minplus_hmin256( _mm256_min_epi32( _mm512_castsi512_si256( vm ), _mm512_extracti64x4_epi64( vm, 1 ) ) );
+#else
+		m = minplus_hmin256( vm );
+#endif
+	}
+#endif
+	for ( ; k < n; k += MINPLUS_CHUNK ){
+		int len = n - k < MINPLUS_CHUNK ? n - k : MINPLUS_CHUNK;
+		int h = *p++;
+		const int* ak = a + k;
+		int mc = MINPLUS_INF;
+		if ( h < 0 ){
+			mc = minplus_min( ak, p, len );
+			m = mc < m ? mc : m;
+		}
+		else if ( h < MINPLUS_PACK24 ){
+			const unsigned short* d = (const unsigned short*) p;
+			int i = 0;
+#if defined(__AVX2__)
+			if ( len >= 8 ){
+				mc = minplus_hmin256( _mm256_add_epi32( _mm256_loadu_si256( (const __m256i*) ak ), minplus_chunk_load( h, p, 0 ) ) );
+				i = 8;
+			}
+#endif
+			for ( ; i < len; i++ ) mc = ak[i] + d[i] < mc ? ak[i] + d[i] : mc;
+			m = h + mc < m ? h + mc : m;
+		}
+		else{
+			const unsigned char* c = (const unsigned char*) p;
+			unsigned int d;
+			for ( int i = 0; i < len; i++, c += 3 ){
+				memcpy( &d, c, sizeof(d) );
+				int v = ak[i] + (int)( d & 0xffffff );
+				mc = v < mc ? v : mc;
+			}
+			m = h - MINPLUS_PACK24 + mc < m ? h - MINPLUS_PACK24 + mc : m;
+		}
+		p += minplus_chunk_ints( h, len );
+	}
+	return m;
+}
+
+// clamp a kernel result back to MINPLUS_INF, so an unreachable distance(directed graphs) can take part in
+// the next min-plus round without overflow
+inline int minplus_cap( int d ){
+	return d < MINPLUS_INF ? d : MINPLUS_INF;
+}
+
+// acc[k] = min( acc[k], base + row[k] ), k in [0,n)
+inline void minplus_relax( int* acc, int base, const int* row, int n ){
+	int k = 0;
+#if defined(__AVX512F__)
+	__m512i vbase16 = _mm512_set1_epi32( base );
+	for ( ; k + 16 <= n; k += 16 ){
+		__m512i vr = _mm512_loadu_si512( (const void*)( row + k ) );
+		__m512i vc = _mm512_loadu_si512( (const void*)( acc + k ) );
+		_mm512_storeu_si512( (void*)( acc + k ), _mm512_min_epi32( vc, _mm512_add_epi32( vr, vbase16 ) ) );
+	}
+#endif
+#if defined(__AVX2__)
+	__m256i vbase8 = _mm256_set1_epi32( base );
+	for ( ; k + 8 <= n; k += 8 ){
+		__m256i vr = _mm256_loadu_si256( (const __m256i*)( row + k ) );
+		__m256i vc = _mm256_loadu_si256( (const __m256i*)( acc + k ) );
+		_mm256_storeu_si256( (__m256i*)( acc + k ), _mm256_min_epi32( vc, _mm256_add_epi32( vr, vbase8 ) ) );
+	}
+#endif
+	for ( ; k < n; k++ ){
+		int d = base + row[k];
+		acc[k] = d < acc[k] ? d : acc[k];
+	}
+}
+
+// minplus_relax, then improved(k) for every k whose acc came down, in increasing k(e.g. to record the
+// intermediate vertex of a floyd step). a vector without any improvement costs a compare only.
+template<class F>
+inline void minplus_relax_each( int* acc, int base, const int* row, int n, F improved ){
+	int k = 0;
+#if defined(__AVX512F__)
+	__m512i vbase16 = _mm512_set1_epi32( base );
+	for ( ; k + 16 <= n; k += 16 ){
+		__m512i vd = _mm512_add_epi32( _mm512_loadu_si512( (const void*)( row + k ) ), vbase16 );
+		__m512i vc = _mm512_loadu_si512( (const void*)( acc + k ) );
+		unsigned m = _mm512_cmpgt_epi32_mask( vc, vd );
+		if ( m == 0 ) continue;
+		_mm512_storeu_si512( (void*)( acc + k ), _mm512_min_epi32( vc, vd ) );
+		for ( ; m != 0; m &= m - 1 ) improved( k + __builtin_ctz( m ) );
+	}
+#endif
+#if defined(__AVX2__)
+	__m256i vbase8 = _mm256_set1_epi32( base );
+	for ( ; k + 8 <= n; k += 8 ){
+		__m256i vd = _mm256_add_epi32( _mm256_loadu_si256( (const __m256i*)( row + k ) ), vbase8 );
+		__m256i vc = _mm256_loadu_si256( (const __m256i*)( acc + k ) );
+		unsigned m = _mm256_movemask_ps( _mm256_castsi256_ps( _mm256_cmpgt_epi32( vc, vd ) ) );
+		if ( m == 0 ) continue;
+		_mm256_storeu_si256( (__m256i*)( acc + k ), _mm256_min_epi32( vc, vd ) );
+		for ( ; m != 0; m &= m - 1 ) improved( k + __builtin_ctz( m ) );
+	}
+#endif
+	for ( ; k < n; k++ ){
+		int d = base + row[k];
+		if ( acc[k] > d ){
+			acc[k] = d;
+			improved( k );
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,73 @@
+// NUMA placement shared by the engines: the cpus of each node and pinning threads to a node
+//
+// no libnuma: numa_topology reads /sys/devices/system/node/node*/cpulist(one node of all cpus where
+// that is missing). memory is placed by the kernel's first touch policy, so a buffer written first by
+// a thread pinned with numa_pin(a replica it copies) lives on that node, local to the threads pinned
+// there after it.
+#ifndef NUMA_H
+#define NUMA_H
+
+#include<stdio.h>
+#include<pthread.h>
+#include<sched.h>
+#include<vector>
+#include<thread>
+
+// "0-3,8,10-11" into cpus
+inline void numa_cpulist( const char* s, std::vector<int> &cpus ){
+	int a, b, n;
+	while( sscanf( s, "%d%n", &a, &n ) == 1 ){
+		s += n;
+		b = a;
+		if ( *s == '-' && sscanf( s + 1, "%d%n", &b, &n ) == 1 ) s += 1 + n;
+		for ( int c = a; c <= b; c++ ) cpus.push_back( c );
+		if ( *s != ',' ) break;
+		s++;
+	}
+}
+
+// cpus of every node with cpus, in node order
+inline std::vector< std::vector<int> > numa_topology(){
+	std::vector< std::vector<int> > nodes;
+	for ( int node = 0, missing = 0; missing < 64; node++ ){
+		char file[96], buf[4096];
+		snprintf( file, sizeof(file), "/sys/devices/system/node/node%d/cpulist", node );
+		FILE* fin = fopen( file, "r" );
+		if ( fin == NULL ){
+			missing++;
+			continue;
+		}
+		std::vector<int> cpus;
+		if ( fgets( buf, sizeof(buf), fin ) != NULL ) numa_cpulist( buf, cpus );
+		fclose(fin);
+		if ( cpus.size() > 0 ) nodes.push_back( cpus );
+	}
+	if ( nodes.empty() ){
+		nodes.resize( 1 );
+		int n = std::thread::hardware_concurrency();
+		for ( int c = 0; c < ( n > 0 ? n : 1 ); c++ ) nodes[0].push_back( c );
+	}
+	return nodes;
+}
+
+// the calling thread onto cpus
+inline bool numa_pin( const std::vector<int> &cpus ){
+	cpu_set_t set;
+	CPU_ZERO( &set );
+	for ( int i = 0; i < cpus.size(); i++ ){
+		if ( cpus[i] < CPU_SETSIZE ) CPU_SET( cpus[i], &set );
+	}
+	return pthread_setaffinity_np( pthread_self(), sizeof(set), &set ) == 0;
+}
+
+// fn() on a thread pinned to cpus, returns when it is done
+template<class F>
+void numa_run_on( const std::vector<int> &cpus, F fn ){
+	std::thread t( [&](){
+		numa_pin( cpus );
+		fn();
+	} );
+	t.join();
+}
+
+#endif
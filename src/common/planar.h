@@ -0,0 +1,208 @@
+// straight-line lower bounds on network distance from vertex coordinates(longitude, latitude in degrees)
+//
+// the coordinates are projected once(equirectangular about the centre of the box) and scaled by
+// k = min over edges of weight / projected length, so every edge is at least as long as its segment and,
+// by the triangle inequality, every path s .. t is at least k * |p(s) - p(t)|. the bound is admissible for
+// whatever unit the weights are in, no trig per query. an edge of weight 0 between two distinct points
+// makes k = 0(bound 0, nothing is cut).
+// the scaled points are kept as float in two arrays(x[], y[]); the float rounding is paid for by a relative
+// and an absolute slack taken off every bound. planar_bounds does a batch of targets, 8 at a time
+// with AVX2(-mavx2 or -march=native), scalar otherwise.
+// PlanarGrid buckets a set of vertices(objects, vehicles) into square cells of the scaled plane; a PlanarCursor
+// walks it from a source in non-decreasing planar_bound, ring of cells by ring, so a kNN can pull candidates
+// lazily and stop once the k-th network distance is below the next bound.
+#ifndef PLANAR_H
+#define PLANAR_H
+
+#include<math.h>
+#include<vector>
+#if defined(__AVX2__)
+#include<immintrin.h>
+#endif
+
+#define PLANAR_SHRINK ( 1.0f - 1.0f / ( 1 << 20 ) )
+
+typedef struct{
+	int n;
+	double scale; // k, weight per metre
+	float slack; // absolute error of a float bound
+	std::vector<float> x, y; // k * projected metres
+}Planar;
+
+// n vertices, m edges u[e] -> v[e] of weight w[e]; false if there is nothing to scale by(no edge of length > 0)
+inline bool planar_build( Planar &P, int n, const double* lon, const double* lat, long long m, const int* u, const int* v, const int* w ){
+	const double R = 6371000.0, rad = acos( -1.0 ) / 180;
+	P.n = 0;
+	P.scale = 0;
+	P.slack = 0;
+	P.x.clear();
+	P.y.clear();
+	if ( n <= 0 ) return false;
+	double lon0 = lon[0], lon1 = lon[0], lat0 = lat[0], lat1 = lat[0];
+	for ( int i = 1; i < n; i++ ){
+		lon0 = lon[i] < lon0 ? lon[i] : lon0;
+		lon1 = lon[i] > lon1 ? lon[i] : lon1;
+		lat0 = lat[i] < lat0 ? lat[i] : lat0;
+		lat1 = lat[i] > lat1 ? lat[i] : lat1;
+	}
+	double cx = ( lon0 + lon1 ) / 2, cy = ( lat0 + lat1 ) / 2, c = cos( cy * rad );
+	std::vector<double> px( n ), py( n );
+	for ( int i = 0; i < n; i++ ){
+		px[i] = ( lon[i] - cx ) * rad * R * c;
+		py[i] = ( lat[i] - cy ) * rad * R;
+	}
+	double k = -1;
+	for ( long long e = 0; e < m; e++ ){
+		double dx = px[u[e]] - px[v[e]], dy = py[u[e]] - py[v[e]], len = sqrt( dx * dx + dy * dy );
+		if ( len <= 0 ) continue;
+		double r = w[e] > 0 ? w[e] / len : 0;
+		if ( k < 0 || r < k ) k = r;
+	}
+	if ( k < 0 ) return false;
+	k *= 1 - 1e-9; // the double edge lengths above
+	float M = 0;
+	P.x.resize( n );
+	P.y.resize( n );
+	for ( int i = 0; i < n; i++ ){
+		P.x[i] = (float)( px[i] * k );
+		P.y[i] = (float)( py[i] * k );
+		M = fabsf( P.x[i] ) > M ? fabsf( P.x[i] ) : M;
+		M = fabsf( P.y[i] ) > M ? fabsf( P.y[i] ) : M;
+	}
+	// each stored coordinate is off by up to M * 2^-24, a difference by twice that plus its own rounding
+	P.slack = M / ( 1 << 20 );
+	P.scale = k;
+	P.n = n;
+	return true;
+}
+
+// <= network distance s .. t, 0 without coordinates
+inline float planar_bound( const Planar &P, int s, int t ){
+	if ( P.n == 0 ) return 0;
+	float dx = P.x[s] - P.x[t], dy = P.y[s] - P.y[t];
+	float d = sqrtf( dx * dx + dy * dy ) * PLANAR_SHRINK - P.slack;
+	return d > 0 ? d : 0;
+}
+
+// out[i] = planar_bound( P, s, t[i] ), i in [0,n)
+inline void planar_bounds( const Planar &P, int s, const int* t, int n, float* out ){
+	int i = 0;
+	if ( P.n == 0 ){
+		for ( ; i < n; i++ ) out[i] = 0;
+		return;
+	}
+#if defined(__AVX2__)
+	const __m256 sx = _mm256_set1_ps( P.x[s] ), sy = _mm256_set1_ps( P.y[s] );
+	const __m256 shrink = _mm256_set1_ps( PLANAR_SHRINK ), slack = _mm256_set1_ps( P.slack ), zero = _mm256_setzero_ps();
+	for ( ; i + 8 <= n; i += 8 ){
+		__m256i id = _mm256_loadu_si256( (const __m256i*)( t + i ) );
+		__m256 dx = _mm256_sub_ps( sx, _mm256_i32gather_ps( &P.x[0], id, 4 ) );
+		__m256 dy = _mm256_sub_ps( sy, _mm256_i32gather_ps( &P.y[0], id, 4 ) );
+		__m256 d = _mm256_sqrt_ps( _mm256_add_ps( _mm256_mul_ps( dx, dx ), _mm256_mul_ps( dy, dy ) ) );
+		d = _mm256_sub_ps( _mm256_mul_ps( d, shrink ), slack );
+		_mm256_storeu_ps( out + i, _mm256_max_ps( d, zero ) );
+	}
+#endif
+	for ( ; i < n; i++ ) out[i] = planar_bound( P, s, t[i] );
+}
+
+typedef struct{
+	float x0, y0, cell; // lower left corner and side of the cells
+	int nx, ny;
+	std::vector<int> start; // cell c = ( cy * nx + cx ) holds item[start[c] .. start[c+1])
+	std::vector<int> item; // positions in the vertex list the grid was built from
+	std::vector<int> vertex; // vertex of each position
+}PlanarGrid;
+
+// v[0..n) into cells of about per_cell items each; one cell for all without coordinates
+inline void planar_grid_build( PlanarGrid &G, const Planar &P, const int* v, int n, int per_cell = 4 ){
+	G.vertex.assign( v, v + n );
+	float x1 = 0, y1 = 0;
+	G.x0 = G.y0 = 0;
+	for ( int i = 0; i < n && P.n > 0; i++ ){
+		float x = P.x[v[i]], y = P.y[v[i]];
+		if ( i == 0 || x < G.x0 ) G.x0 = x;
+		if ( i == 0 || y < G.y0 ) G.y0 = y;
+		if ( i == 0 || x > x1 ) x1 = x;
+		if ( i == 0 || y > y1 ) y1 = y;
+	}
+	float w = x1 - G.x0, h = y1 - G.y0, side = w > h ? w : h;
+	double cells = n > per_cell ? (double)n / per_cell : 1;
+	G.cell = w > 0 && h > 0 ? (float)sqrt( (double)w * h / cells ) : side / cells;
+	if ( ! ( G.cell > 0 ) || G.cell < side / 4096 ) G.cell = side > 0 ? side / 4096 : 1;
+	G.nx = (int)( w / G.cell ) + 1;
+	G.ny = (int)( h / G.cell ) + 1;
+	G.start.assign( (long long)G.nx * G.ny + 1, 0 );
+	std::vector<int> c( n );
+	for ( int i = 0; i < n; i++ ){
+		int cx = P.n > 0 ? std::min( G.nx - 1, (int)( ( P.x[v[i]] - G.x0 ) / G.cell ) ) : 0;
+		int cy = P.n > 0 ? std::min( G.ny - 1, (int)( ( P.y[v[i]] - G.y0 ) / G.cell ) ) : 0;
+		c[i] = cy * G.nx + cx;
+		G.start[c[i] + 1]++;
+	}
+	for ( int i = 0; i < G.nx * G.ny; i++ ) G.start[i + 1] += G.start[i];
+	G.item.resize( n );
+	std::vector<int> pos( G.start.begin(), G.start.end() - 1 );
+	for ( int i = 0; i < n; i++ ) G.item[pos[c[i]]++] = i;
+}
+
+typedef struct{
+	const PlanarGrid* G;
+	const Planar* P;
+	int s, cx, cy; // the source and its cell(clamped into the grid)
+	int ring, rings; // next ring of cells to open, rings in all
+	std::vector< std::pair<float,int> > heap; // <bound, position> of the opened cells, min first
+}PlanarCursor;
+
+inline void planar_cursor_init( PlanarCursor &C, const PlanarGrid &G, const Planar &P, int s ){
+	C.G = &G;
+	C.P = &P;
+	C.s = s;
+	C.cx = P.n > 0 ? (int)floorf( ( P.x[s] - G.x0 ) / G.cell ) : 0;
+	C.cy = P.n > 0 ? (int)floorf( ( P.y[s] - G.y0 ) / G.cell ) : 0;
+	C.cx = C.cx < 0 ? 0 : ( C.cx >= G.nx ? G.nx - 1 : C.cx );
+	C.cy = C.cy < 0 ? 0 : ( C.cy >= G.ny ? G.ny - 1 : C.cy );
+	C.ring = 0;
+	C.rings = std::max( std::max( C.cx, G.nx - 1 - C.cx ), std::max( C.cy, G.ny - 1 - C.cy ) ) + 1;
+	C.heap.clear();
+}
+
+inline void planar_cursor_open( PlanarCursor &C, int cx, int cy ){
+	const PlanarGrid &G = *C.G;
+	if ( cx < 0 || cx >= G.nx || cy < 0 || cy >= G.ny ) return;
+	int c = cy * G.nx + cx;
+	for ( int i = G.start[c]; i < G.start[c + 1]; i++ ){
+		C.heap.push_back( std::make_pair( planar_bound( *C.P, C.s, G.vertex[G.item[i]] ), G.item[i] ) );
+		std::push_heap( C.heap.begin(), C.heap.end(), std::greater< std::pair<float,int> >() );
+	}
+}
+
+// the next position of the grid's vertex list, nearest first, and its planar_bound; false when all are out.
+// a cell r rings off is at least ( r - 1 ) cells away on one axis, so rings open until that passes the heap top
+inline bool planar_cursor_next( PlanarCursor &C, int &index, float &bound ){
+	while ( C.ring < C.rings ){
+		float near = C.ring > 0 ? ( C.ring - 1 ) * C.G->cell * PLANAR_SHRINK - C.P->slack : 0;
+		if ( ! C.heap.empty() && C.heap[0].first <= near ) break;
+		int r = C.ring++;
+		if ( r == 0 ){
+			planar_cursor_open( C, C.cx, C.cy );
+			continue;
+		}
+		for ( int x = C.cx - r; x <= C.cx + r; x++ ){
+			planar_cursor_open( C, x, C.cy - r );
+			planar_cursor_open( C, x, C.cy + r );
+		}
+		for ( int y = C.cy - r + 1; y < C.cy + r; y++ ){
+			planar_cursor_open( C, C.cx - r, y );
+			planar_cursor_open( C, C.cx + r, y );
+		}
+	}
+	if ( C.heap.empty() ) return false;
+	std::pop_heap( C.heap.begin(), C.heap.end(), std::greater< std::pair<float,int> >() );
+	bound = C.heap.back().first;
+	index = C.heap.back().second;
+	C.heap.pop_back();
+	return true;
+}
+
+#endif
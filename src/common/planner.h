@@ -0,0 +1,280 @@
+// density-aware routing of kNN/range between engines(engine.h) answering over the same objects
+//
+// no engine wins everywhere: a local network expansion(ROAD style, ExpandEngine here) settles few vertices
+// when objects are dense around the query and K small, a tree index(G*-Tree) pays a fixed cost per query but
+// does not grow with the sparsity of the objects. the planner keeps object counts per node of a vertex
+// hierarchy(the engine's partition tree: leaf of every vertex, parent of every node) and predicts the cost of
+// a query on each engine from where the objects are:
+//	knn:   x1 = vertices of the lowest node around s with >= k objects * k / its objects(vertices an expansion
+//	       settles before it has k), x2 = k
+//	range: x1 = r, x2 = r * objects / vertices of the leaf's parent(objects an expansion meets per unit of r)
+// cost = c0 + c1 * x1 + c2 * x2 per engine and kind, c fitted by least squares to timed sample queries
+// (planner_calibrate, the benchmark's query files) and kept in a text file(planner_save/planner_load).
+// distance/path/one_to_many go to the first engine.
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include<stdio.h>
+#include<string.h>
+#include<vector>
+#include<algorithm>
+#include "engine.h"
+#include "dheap.h"
+#include "query_stats.h"
+
+#define PLANNER_KNN 0
+#define PLANNER_RANGE 1
+#define PLANNER_RIDGE 1e-6 // on the diagonal of the normal equations, a feature without spread gets ~0
+
+// dijkstra from s that stops once the answer is settled, over a CSR graph(v's arcs in [offset[v],offset[v+1]))
+struct ExpandEngine : Engine{
+	int n;
+	const long long* offset;
+	const int* target;
+	const int* weight;
+	DHeap h;
+	std::vector<int> first, at; // objects on v: at[first[v]..first[v+1])
+
+	ExpandEngine( int nv, const long long* o, const int* t, const int* w ) : n( nv ), offset( o ), target( t ), weight( w ){
+		dheap_init( h, n );
+		first.assign( n + 1, 0 );
+	}
+	const char* name(){ return "expand"; }
+	int distance( int s, int t ){
+		dheap_reset( h );
+		dheap_push( h, s, 0 );
+		while ( h.size > 0 ){
+			int v = dheap_pop( h );
+			if ( v == t ) return h.key[v];
+			relax( v );
+		}
+		return ENGINE_INF;
+	}
+	void set_objects( const std::vector<int> &o ){
+		objects = o;
+		first.assign( n + 1, 0 );
+		for ( int i = 0; i < objects.size(); i++ ) first[objects[i]+1]++;
+		for ( int v = 0; v < n; v++ ) first[v+1] += first[v];
+		at.resize( objects.size() );
+		std::vector<int> fill( first.begin(), first.end() - 1 );
+		for ( int i = 0; i < objects.size(); i++ ) at[fill[objects[i]]++] = i;
+	}
+	// settles every vertex at the k-th distance too, so ties are cut by index as engine_sort does
+	void knn( int s, int k, std::vector< std::pair<int,int> > &out ){
+		out.clear();
+		int bound = ENGINE_INF;
+		dheap_reset( h );
+		dheap_push( h, s, 0 );
+		while ( h.size > 0 && h.key[h.heap[0]] <= bound && k > 0 ){
+			int v = dheap_pop( h );
+			for ( int i = first[v]; i < first[v+1]; i++ ) out.push_back( std::make_pair( at[i], h.key[v] ) );
+			if ( out.size() >= k ) bound = h.key[v];
+			relax( v );
+		}
+		engine_sort( out, k );
+	}
+	void range( int s, int r, std::vector< std::pair<int,int> > &out ){
+		out.clear();
+		dheap_reset( h );
+		dheap_push( h, s, 0 );
+		while ( h.size > 0 && h.key[h.heap[0]] < r ){
+			int v = dheap_pop( h );
+			for ( int i = first[v]; i < first[v+1]; i++ ) out.push_back( std::make_pair( at[i], h.key[v] ) );
+			relax( v );
+		}
+		engine_sort( out, out.size() );
+	}
+	void relax( int v ){
+		int d = h.key[v];
+		for ( long long e = offset[v]; e < offset[v+1]; e++ ) dheap_push( h, target[e], d + weight[e] );
+	}
+};
+
+// object counts over a vertex hierarchy, nodes [0,parent.size()), parent[root] = -1
+typedef struct{
+	std::vector<int> leaf; // node of vertex v
+	std::vector<int> parent;
+	std::vector<int> depth;
+	std::vector<long long> vertices, objects; // in the node's subtree
+}DensityTree;
+
+inline void density_init( DensityTree &t, const std::vector<int> &leaf, const std::vector<int> &parent ){
+	t.leaf = leaf;
+	t.parent = parent;
+	int m = parent.size();
+	t.depth.assign( m, -1 );
+	for ( int x = 0; x < m; x++ ){
+		t.depth[x] = 0;
+		for ( int y = parent[x]; y >= 0; y = parent[y] ) t.depth[x]++;
+	}
+	t.vertices.assign( m, 0 );
+	for ( int v = 0; v < leaf.size(); v++ ){
+		for ( int x = leaf[v]; x >= 0; x = parent[x] ) t.vertices[x]++;
+	}
+	t.objects.assign( m, 0 );
+}
+
+inline void density_objects( DensityTree &t, const std::vector<int> &o ){
+	t.objects.assign( t.parent.size(), 0 );
+	for ( int i = 0; i < o.size(); i++ ){
+		for ( int x = t.leaf[o[i]]; x >= 0; x = t.parent[x] ) t.objects[x]++;
+	}
+}
+
+// per depth: nodes, vertices and objects over all nodes of that depth("layer")
+inline void density_report( FILE* out, const DensityTree &t ){
+	int layers = t.depth.empty() ? 0 : *std::max_element( t.depth.begin(), t.depth.end() ) + 1;
+	std::vector<long long> nodes( layers, 0 ), v( layers, 0 ), o( layers, 0 ), empty( layers, 0 );
+	for ( int x = 0; x < t.parent.size(); x++ ){
+		if ( t.vertices[x] == 0 ) continue; // unused node id
+		int d = t.depth[x];
+		nodes[d]++;
+		v[d] += t.vertices[x];
+		o[d] += t.objects[x];
+		empty[d] += t.objects[x] == 0;
+	}
+	for ( int d = 0; d < layers; d++ )
+		fprintf( out, "DENSITY LAYER %d: NODES=%lld OBJECTS/VERTEX=%.4f EMPTY_NODES=%lld\n", d, nodes[d], v[d] > 0 ? (double) o[d] / v[d] : 0.0, empty[d] );
+}
+
+inline void density_features( const DensityTree &t, int kind, int s, int k, double &x1, double &x2 ){
+	int x = t.leaf[s];
+	if ( kind == PLANNER_KNN ){
+		while ( t.parent[x] >= 0 && t.objects[x] < k ) x = t.parent[x];
+		x1 = t.objects[x] > 0 ? (double) t.vertices[x] * std::min( (long long) k, t.objects[x] ) / t.objects[x] : (double) t.vertices[x];
+		x2 = k;
+	}
+	else{
+		if ( t.parent[x] >= 0 ) x = t.parent[x];
+		x1 = k;
+		x2 = (double) k * t.objects[x] / t.vertices[x];
+	}
+}
+
+typedef struct{
+	double c[2][3]; // [kind] cost(ns) = c0 + c1 * x1 + c2 * x2
+}PlannerModel;
+
+// least squares over samples (x1, x2, ns)
+inline void planner_fit( const std::vector<double> &x1, const std::vector<double> &x2, const std::vector<double> &ns, double* c ){
+	double a[3][4] = {};
+	for ( int i = 0; i < ns.size(); i++ ){
+		double f[3] = { 1, x1[i], x2[i] };
+		for ( int r = 0; r < 3; r++ ){
+			for ( int j = 0; j < 3; j++ ) a[r][j] += f[r] * f[j];
+			a[r][3] += f[r] * ns[i];
+		}
+	}
+	for ( int r = 0; r < 3; r++ ) a[r][r] += PLANNER_RIDGE * ( a[r][r] + 1 );
+	// gauss jordan, the matrix is symmetric positive definite(no pivoting)
+	for ( int p = 0; p < 3; p++ ){
+		for ( int r = 0; r < 3; r++ ){
+			if ( r == p ) continue;
+			double m = a[r][p] / a[p][p];
+			for ( int j = p; j < 4; j++ ) a[r][j] -= m * a[p][j];
+		}
+	}
+	for ( int r = 0; r < 3; r++ ) c[r] = a[r][3] / a[r][r];
+}
+
+struct PlannerEngine : Engine{
+	std::vector<Engine*> engines;
+	std::vector<PlannerModel> model;
+	std::vector<long long> routed; // queries sent to each engine
+	DensityTree tree;
+
+	PlannerEngine( const std::vector<Engine*> &e, const DensityTree &t ) : engines( e ), model( e.size() ), routed( e.size(), 0 ), tree( t ){
+		memset( model.data(), 0, model.size() * sizeof(PlannerModel) );
+	}
+	const char* name(){ return "planner"; }
+	int distance( int s, int t ){ return engines[0]->distance( s, t ); }
+	bool path( int s, int t, std::vector<int> &route, int &dist ){ return engines[0]->path( s, t, route, dist ); }
+	void one_to_many( int s, const std::vector<int> &targets, std::vector<int> &out ){ engines[0]->one_to_many( s, targets, out ); }
+	void set_objects( const std::vector<int> &o ){
+		objects = o;
+		for ( int i = 0; i < engines.size(); i++ ) engines[i]->set_objects( o );
+		density_objects( tree, o );
+	}
+	// the engine with the least predicted cost
+	int choose( int kind, int s, int k ){
+		double x1, x2, best = 0;
+		density_features( tree, kind, s, k, x1, x2 );
+		int e = 0;
+		for ( int i = 0; i < engines.size(); i++ ){
+			const double* c = model[i].c[kind];
+			double cost = c[0] + c[1] * x1 + c[2] * x2;
+			if ( i == 0 || cost < best ){
+				best = cost;
+				e = i;
+			}
+		}
+		routed[e]++;
+		return e;
+	}
+	void knn( int s, int k, std::vector< std::pair<int,int> > &out ){
+		engines[choose( PLANNER_KNN, s, k )]->knn( s, k, out );
+	}
+	void range( int s, int r, std::vector< std::pair<int,int> > &out ){
+		engines[choose( PLANNER_RANGE, s, r )]->range( s, r, out );
+	}
+};
+
+// times every engine on the sample kNN queries (s, k) and on ranges with r = the k-th distance found,
+// one warm up pass first; fits the models of p
+inline void planner_calibrate( PlannerEngine &p, const std::vector< std::pair<int,int> > &sample ){
+	std::vector< std::pair<int,int> > out;
+	std::vector<int> r( sample.size(), 0 );
+	for ( int q = 0; q < sample.size(); q++ ){
+		p.engines[0]->knn( sample[q].first, sample[q].second, out );
+		r[q] = out.empty() ? 1 : out.back().second + 1;
+	}
+	for ( int kind = 0; kind < 2; kind++ ){
+		std::vector<double> x1( sample.size() ), x2( sample.size() );
+		for ( int q = 0; q < sample.size(); q++ )
+			density_features( p.tree, kind, sample[q].first, kind == PLANNER_KNN ? sample[q].second : r[q], x1[q], x2[q] );
+		for ( int e = 0; e < p.engines.size(); e++ ){
+			std::vector<double> ns( sample.size() );
+			for ( int pass = 0; pass < 2; pass++ ){
+				for ( int q = 0; q < sample.size(); q++ ){
+					long long t0 = stats_now();
+					if ( kind == PLANNER_KNN ) p.engines[e]->knn( sample[q].first, sample[q].second, out );
+					else p.engines[e]->range( sample[q].first, r[q], out );
+					ns[q] = stats_now() - t0;
+				}
+			}
+			planner_fit( x1, x2, ns, p.model[e].c[kind] );
+		}
+	}
+}
+
+// "engine kind c0 c1 c2" per line, in the order of p.engines
+inline bool planner_save( const char* file, const PlannerEngine &p ){
+	FILE* out = fopen( file, "w" );
+	if ( out == NULL ) return false;
+	for ( int e = 0; e < p.engines.size(); e++ ){
+		for ( int kind = 0; kind < 2; kind++ ){
+			const double* c = p.model[e].c[kind];
+			fprintf( out, "%s %s %.9g %.9g %.9g\n", p.engines[e]->name(), kind == PLANNER_KNN ? "knn" : "range", c[0], c[1], c[2] );
+		}
+	}
+	return fclose( out ) == 0;
+}
+
+// false if the file is missing or was written for other engines
+inline bool planner_load( const char* file, PlannerEngine &p ){
+	FILE* in = fopen( file, "r" );
+	if ( in == NULL ) return false;
+	bool ok = true;
+	for ( int e = 0; ok && e < p.engines.size(); e++ ){
+		for ( int kind = 0; ok && kind < 2; kind++ ){
+			char name[64], k[16];
+			double* c = p.model[e].c[kind];
+			ok = fscanf( in, "%63s %15s %lf %lf %lf", name, k, &c[0], &c[1], &c[2] ) == 5
+				&& strcmp( name, p.engines[e]->name() ) == 0 && strcmp( k, kind == PLANNER_KNN ? "knn" : "range" ) == 0;
+		}
+	}
+	fclose( in );
+	return ok;
+}
+
+#endif
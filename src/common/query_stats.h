@@ -0,0 +1,145 @@
+// query statistics shared by the engines: per phase latency histograms and event counters
+//
+// latency histograms are HDR style(log-linear) over nanoseconds: values below 2 * STATS_SUB are
+// exact, above that every power of 2 is split into STATS_SUB buckets, so a reported percentile is
+// at most 1 / STATS_SUB(6.25%) above the true value, for any value up to 2^63 ns in fixed memory.
+//
+// one QueryStats per thread(no locking on the query path), phases and counters are numbered by the
+// caller, stats_merge adds them up and stats_json writes the sum with the caller's names.
+// a query opens with stats_begin, adds phase time with stats_add / counters with stats_count,
+// and stats_end records every phase of the query in its histogram.
+#ifndef QUERY_STATS_H
+#define QUERY_STATS_H
+
+#include<stdio.h>
+#include<string.h>
+#include<time.h>
+#include<string>
+
+#define STATS_SUB_BITS 4
+#define STATS_SUB ( 1 << STATS_SUB_BITS )
+#define STATS_BUCKETS ( ( 65 - STATS_SUB_BITS ) * STATS_SUB )
+#define STATS_MAX_PHASES 8
+#define STATS_MAX_COUNTERS 8
+
+typedef struct{
+	long long count;
+	long long sum; // ns
+	long long max;
+	long long bucket[STATS_BUCKETS];
+}StatsHist;
+
+typedef struct{
+	long long queries;
+	StatsHist hist[STATS_MAX_PHASES];
+	long long counter[STATS_MAX_COUNTERS];
+	long long phase[STATS_MAX_PHASES]; // ns of the open query
+}QueryStats;
+
+inline long long stats_now(){
+	struct timespec t;
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+inline int stats_bucket( long long v ){
+	if ( v < 2 * STATS_SUB ) return v < 0 ? 0 : (int) v;
+	int e = 63 - __builtin_clzll( v ) - STATS_SUB_BITS;
+	return e * STATS_SUB + (int) ( v >> e );
+}
+
+// largest value of bucket b
+inline long long stats_bucket_high( int b ){
+	if ( b < 2 * STATS_SUB ) return b;
+	int e = b / STATS_SUB - 1;
+	long long m = b % STATS_SUB + STATS_SUB;
+	return ( ( m + 1 ) << e ) - 1;
+}
+
+inline void stats_hist_add( StatsHist &h, long long v ){
+	h.count ++;
+	h.sum += v;
+	if ( v > h.max ) h.max = v;
+	h.bucket[ stats_bucket( v ) ] ++;
+}
+
+// value at quantile p(0..1], 0 if empty
+inline long long stats_hist_percentile( const StatsHist &h, double p ){
+	if ( h.count == 0 ) return 0;
+	long long rank = (long long)( p * h.count + 0.999999 );
+	if ( rank < 1 ) rank = 1;
+	long long seen = 0;
+	for ( int b = 0; b < STATS_BUCKETS; b++ ){
+		seen += h.bucket[b];
+		if ( seen >= rank ) return stats_bucket_high( b ) < h.max ? stats_bucket_high( b ) : h.max;
+	}
+	return h.max;
+}
+
+inline void stats_init( QueryStats &s ){
+	memset( &s, 0, sizeof(s) );
+}
+
+inline void stats_begin( QueryStats* s ){
+	if ( s == NULL ) return;
+	for ( int i = 0; i < STATS_MAX_PHASES; i++ ) s->phase[i] = 0;
+}
+
+inline void stats_add( QueryStats* s, int phase, long long ns ){
+	if ( s != NULL ) s->phase[phase] += ns;
+}
+
+inline void stats_count( QueryStats* s, int counter, long long n ){
+	if ( s != NULL ) s->counter[counter] += n;
+}
+
+// close the query, the first nphases phases go to their histograms
+inline void stats_end( QueryStats* s, int nphases ){
+	if ( s == NULL ) return;
+	s->queries ++;
+	for ( int i = 0; i < nphases; i++ ) stats_hist_add( s->hist[i], s->phase[i] );
+}
+
+inline void stats_merge( QueryStats &to, const QueryStats &from ){
+	to.queries += from.queries;
+	for ( int i = 0; i < STATS_MAX_PHASES; i++ ){
+		StatsHist &t = to.hist[i];
+		const StatsHist &f = from.hist[i];
+		t.count += f.count;
+		t.sum += f.sum;
+		if ( f.max > t.max ) t.max = f.max;
+		for ( int b = 0; b < STATS_BUCKETS; b++ ) t.bucket[b] += f.bucket[b];
+	}
+	for ( int i = 0; i < STATS_MAX_COUNTERS; i++ ) to.counter[i] += from.counter[i];
+}
+
+// s as one JSON object, times in us
+inline void stats_json( FILE* out, const QueryStats &s, const char* const* phases, int nphases, const char* const* counters, int ncounters ){
+	fprintf( out, "{\n  \"queries\": %lld,\n  \"phases\": {", s.queries );
+	for ( int i = 0; i < nphases; i++ ){
+		const StatsHist &h = s.hist[i];
+		fprintf( out, "%s\n    \"%s\": { \"count\": %lld, \"sum_us\": %.3f, \"mean_us\": %.3f, \"p50_us\": %.3f, \"p99_us\": %.3f, \"p999_us\": %.3f, \"max_us\": %.3f }",
+			i > 0 ? "," : "", phases[i], h.count, h.sum / 1e3, h.count > 0 ? h.sum / 1e3 / h.count : 0.0,
+			stats_hist_percentile( h, 0.5 ) / 1e3, stats_hist_percentile( h, 0.99 ) / 1e3, stats_hist_percentile( h, 0.999 ) / 1e3, h.max / 1e3 );
+	}
+	fprintf( out, "\n  },\n  \"counters\": {" );
+	for ( int i = 0; i < ncounters; i++ ){
+		fprintf( out, "%s\n    \"%s\": { \"total\": %lld, \"per_query\": %.3f }", i > 0 ? "," : "", counters[i],
+			s.counter[i], s.queries > 0 ? (double) s.counter[i] / s.queries : 0.0 );
+	}
+	fprintf( out, "\n  }\n}\n" );
+}
+
+// stats_json into file, written aside then renamed, a reader never sees half a dump
+inline bool stats_json_save( const char* file, const QueryStats &s, const char* const* phases, int nphases, const char* const* counters, int ncounters ){
+	std::string tmp = std::string( file ) + ".tmp";
+	FILE* fout = fopen( tmp.c_str(), "w" );
+	if ( fout == NULL ) return false;
+	stats_json( fout, s, phases, nphases, counters, ncounters );
+	bool ok = fclose(fout) == 0;
+	if ( ok ) ok = rename( tmp.c_str(), file ) == 0;
+	if ( ! ok ) remove( tmp.c_str() );
+	return ok;
+}
+
+#endif
@@ -0,0 +1,102 @@
+// monotone radix heap: a min priority queue over unsigned int keys with a value per entry
+//
+// monotone: every key pushed is >= the key last popped(dijkstra style searches: a vertex is pushed at
+// its popped distance plus a non-negative edge). a key k lives in bucket b = bits of (k xor last): bucket 0
+// holds keys == last, bucket b the keys that first differ from last at bit b - 1. popping an empty bucket 0
+// takes the first non-empty bucket, makes its min the new last and spreads the rest over the lower buckets,
+// every entry moves down at most 32 times in all: pushes O(1), pops O(log C) amortized for C = key range.
+// radix_top may be called without popping and the heap can still take keys below that top(but >= last),
+// the min of the bucket is remembered until a push goes below it or a pop takes it.
+#ifndef RADIX_HEAP_H
+#define RADIX_HEAP_H
+
+#include<vector>
+#include<utility>
+
+#define RADIX_BUCKETS 33
+
+template<class T>
+struct RadixHeap{
+	unsigned last; // key of the last pop
+	long long size;
+	int top_b; // bucket of the min, -1 unknown
+	long long top_i; // its index in the bucket
+	std::vector< std::pair<unsigned,T> > b[RADIX_BUCKETS];
+};
+
+inline int radix_bucket( unsigned x ){
+	return x == 0 ? 0 : 32 - __builtin_clz( x );
+}
+
+template<class T>
+inline void radix_clear( RadixHeap<T> &h ){
+	h.last = 0;
+	h.size = 0;
+	h.top_b = -1;
+	for ( int i = 0; i < RADIX_BUCKETS; i++ ) h.b[i].clear();
+}
+
+template<class T>
+inline bool radix_empty( const RadixHeap<T> &h ){
+	return h.size == 0;
+}
+
+// key >= the last popped key
+template<class T>
+inline void radix_push( RadixHeap<T> &h, unsigned key, const T &v ){
+	int i = radix_bucket( key ^ h.last );
+	h.b[i].push_back( std::make_pair( key, v ) );
+	h.size++;
+	if ( h.top_b != -1 && key < h.b[h.top_b][h.top_i].first ){
+		h.top_b = i;
+		h.top_i = h.b[i].size() - 1;
+	}
+}
+
+// finds the min(heap not empty): any entry of bucket 0(all == last), else the min of the first non-empty bucket
+template<class T>
+inline void radix_find( RadixHeap<T> &h ){
+	if ( h.top_b != -1 ) return;
+	if ( ! h.b[0].empty() ){
+		h.top_b = 0;
+		h.top_i = h.b[0].size() - 1;
+		return;
+	}
+	int i = 1;
+	while ( h.b[i].empty() ) i++;
+	const std::vector< std::pair<unsigned,T> > &a = h.b[i];
+	long long m = 0;
+	for ( long long j = 1; j < a.size(); j++ ){
+		if ( a[j].first < a[m].first ) m = j;
+	}
+	h.top_b = i;
+	h.top_i = m;
+}
+
+// min entry(heap not empty)
+template<class T>
+inline const std::pair<unsigned,T>& radix_top( RadixHeap<T> &h ){
+	radix_find( h );
+	return h.b[h.top_b][h.top_i];
+}
+
+// removes the min entry(heap not empty)
+template<class T>
+inline std::pair<unsigned,T> radix_pop( RadixHeap<T> &h ){
+	radix_find( h );
+	std::vector< std::pair<unsigned,T> > &a = h.b[h.top_b];
+	std::pair<unsigned,T> re = a[h.top_i];
+	a[h.top_i] = a.back();
+	a.pop_back();
+	h.size--;
+	if ( h.top_b > 0 ){
+		// new last: the rest of the bucket goes to the buckets below
+		h.last = re.first;
+		for ( long long j = 0; j < a.size(); j++ ) h.b[radix_bucket( a[j].first ^ h.last )].push_back( a[j] );
+		a.clear();
+	}
+	h.top_b = -1;
+	return re;
+}
+
+#endif
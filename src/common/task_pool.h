@@ -0,0 +1,33 @@
+// minimal task pool shared by the engines
+//
+// parallel_for runs fn(worker, i) for i in [0,n) on nthreads threads, each thread takes the
+// next task index. worker in [0,nthreads) identifies the thread, so callers can keep one
+// scratch per worker. results must be written to per task slots, then the output does not
+// depend on the schedule.
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include<vector>
+#include<thread>
+#include<atomic>
+
+template<class F>
+void parallel_for( int nthreads, int n, F fn ){
+	if ( nthreads > n ) nthreads = n;
+	if ( nthreads <= 1 ){
+		for ( int i = 0; i < n; i++ ) fn( 0, i );
+		return;
+	}
+	std::atomic<int> next( 0 );
+	std::vector<std::thread> pool;
+	for ( int t = 0; t < nthreads; t++ ){
+		pool.push_back( std::thread( [&, t](){
+			for ( int i = next++; i < n; i = next++ ) fn( t, i );
+		} ) );
+	}
+	for ( int t = 0; t < nthreads; t++ ){
+		pool[t].join();
+	}
+}
+
+#endif
@@ -0,0 +1,50 @@
+#!/bin/bash
+# auto-tune fanout(-f) and leaf capacity(-l, tau) of gtree_build on a sample of a data set
+# usage: ./autotune.sh [name] [sample vertices] [queries] [K]
+#	builds every (fanout, tau) of the grid on the sample name_sN, then reports per candidate
+#	index size, build time and mean knn latency of a random workload(1% of the vertices as objects),
+#	and the Pareto-best candidates(no other one is at least as good in all three and better in one)
+# env: FANOUTS, LEAFCAPS = grid, BUILD/QUERY = binaries, THREADS = build threads
+NAME=${1:-cal}
+SAMPLE=${2:-20000}
+NQ=${3:-2000}
+K=${4:-10}
+FANOUTS=${FANOUTS:-"2 4 8 16"}
+LEAFCAPS=${LEAFCAPS:-"16 32 64 128 256"}
+BUILD=${BUILD:-./gtree_build}
+QUERY=${QUERY:-./gtree_query}
+THREADS=${THREADS:-$(nproc)}
+S=${NAME}_s${SAMPLE}
+
+$BUILD -n $NAME -s $SAMPLE | grep SAMPLE || exit 1
+N=$(wc -l < $S.cnode)
+awk -v n=$N 'BEGIN{ srand(1); for ( i = 0; i < n; i++ ) if ( rand() < 0.01 ) print i, i }' > $S.object
+awk -v n=$N -v q=$NQ -v k=$K 'BEGIN{ srand(2); for ( i = 0; i < q; i++ ) print int( rand() * n ), k }' > $S.queries
+
+RESULT=$S.tune
+: > $RESULT
+printf "%8s %8s %12s %12s %12s\n" FANOUT TAU INDEX_BYTES BUILD_MS KNN_US
+for F in $FANOUTS; do
+	for L in $LEAFCAPS; do
+		[ $L -lt $F ] && continue
+		# BUILD + MIND, in 0.01 ms
+		B=$($BUILD -n $S -f $F -l $L -j $THREADS | awk '/"BUILD" RESULT|"MIND" RESULT/{ s += $3 } END{ print s }')
+		[ -f $S.gidx ] || continue
+		Z=$(stat -c %s $S.gidx)
+		Q=$($QUERY -n $S < $S.queries | awk '/"KNN_SEARCH" RESULT/{ s += $3; c++ } END{ if ( c ) print s / c; else print -1 }')
+		printf "%8d %8d %12d %12.1f %12.1f\n" $F $L $Z $(echo "$B" | awk '{ print $1 / 100 }') $(echo "$Q" | awk '{ print $1 * 10 }') | tee -a $RESULT
+		rm -f $S.gidx
+	done
+done
+
+echo "PARETO(INDEX_BYTES, BUILD_MS, KNN_US):"
+awk '{ f[NR] = $1; l[NR] = $2; z[NR] = $3; b[NR] = $4; q[NR] = $5 }
+END{
+	for ( i = 1; i <= NR; i++ ){
+		dominated = 0
+		for ( j = 1; j <= NR && ! dominated; j++ ){
+			if ( j != i && z[j] <= z[i] && b[j] <= b[i] && q[j] <= q[i] && ( z[j] < z[i] || b[j] < b[i] || q[j] < q[i] ) ) dominated = 1
+		}
+		if ( ! dominated ) printf "%8d %8d %12d %12.1f %12.1f\n", f[i], l[i], z[i], b[i], q[i]
+	}
+}' $RESULT
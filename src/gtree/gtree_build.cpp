@@ -13,6 +13,14 @@
 #include<stack>
 #include<algorithm>
 #include<sys/time.h>
+#include<sys/resource.h>
+#include<malloc.h>
+#include<mutex>
+#include "gtree_index.h"
+#include "../common/dheap.h"
+#include "../common/task_pool.h"
+#include "../common/graph_csr.h"
+#include "../common/minplus.h"
 using namespace std;
 
 // MACRO for timing
@@ -23,25 +31,48 @@ long long ts, te;
 #define TIME_TICK_PRINT(T) printf("%s RESULT: %lld (0.01MS)\r\n", (#T), te - ts );
 // ----------
 
-#define FILE_NODE "cal.cnode"
-#define FILE_EDGE "cal.cedge"
+// data set files, <dataset>.cnode, <dataset>.cedge ...(files_init), dataset = -n name
+string dataset = "cal";
+string file_node, file_edge, file_paths, file_gtree, file_minds, file_via, file_gidx;
+#define FILE_NODE file_node.c_str()
+#define FILE_EDGE file_edge.c_str()
 // set all edge weight to 1(unweighted graph)
 #define ADJWEIGHT_SET_TO_ALL_ONE true
 // we assume edge weight is integer, thus (input edge) * WEIGHT_INFLATE_FACTOR = (our edge weight)
 #define WEIGHT_INFLATE_FACTOR 100000
-// gtree fanout
+// gtree fanout, default of -f
 #define PARTITION_PART 4
-// gtree leaf node capacity = tau(in paper)
+// gtree leaf node capacity = tau(in paper), default of -l
 #define LEAF_CAP 32
+int partition_part = PARTITION_PART;
+int leaf_cap = LEAF_CAP;
 // gtree index disk storage
-#define FILE_NODES_GTREE_PATH "cal.paths"
-#define FILE_GTREE 			  "cal.gtree"
-#define FILE_ONTREE_MIND	  "cal.minds"
+#define FILE_NODES_GTREE_PATH file_paths.c_str()
+#define FILE_GTREE 			  file_gtree.c_str()
+#define FILE_ONTREE_MIND	  file_minds.c_str()
+#define FILE_ONTREE_VIA		  file_via.c_str()
+// single file mmap-able index(see gtree_index.h)
+#define FILE_GTREE_INDEX	  file_gidx.c_str()
+// set to true only if libmetis is built with thread local random state(GKlib GK_THREADLOCAL),
+// otherwise concurrent METIS calls may change the partitioning and METIS runs one call at a time
+#define METIS_THREADSAFE false
+
+void files_init(){
+	file_node = dataset + ".cnode";
+	file_edge = dataset + ".cedge";
+	file_paths = dataset + ".paths";
+	file_gtree = dataset + ".gtree";
+	file_minds = dataset + ".minds";
+	file_via = dataset + ".via";
+	file_gidx = dataset + ".gidx";
+}
 
 typedef struct{
 	double x,y;
 	vector<int> adjnodes;
 	vector<int> adjweight;
+	vector<int> radjnodes; // directed graph only: in edges(reverse graph)
+	vector<int> radjweight;
 	bool isborder;
 	vector<int> gtreepath; // this is used to do sub-graph locating
 }Node;
@@ -55,6 +86,9 @@ typedef struct{
 // ----- min dis -----
 	vector<int> union_borders; // for non leaf node	
 	vector<int> mind; // min dis, row by row of union_borders
+	vector<int> via; // shortest path of each mind entry, same layout(see dijkstra_candidate_via)
+	vector<int> rmind; // directed leaf only: rmind[j][k] = distance from leafnodes[k] to borders[j]
+	vector<int> rvia; // path of each rmind entry
 // ----- for pre query init, OCCURENCE LIST in paper -----
 	vector<int> nonleafinvlist;
 	vector<int> leafinvlist;
@@ -68,16 +102,60 @@ vector<TreeNode> GTree;
 
 // use for metis
 // idx_t = int64_t / real_t = double
-idx_t nvtxs; // |vertices|
-idx_t ncon; // number of weight per vertex
-idx_t* xadj; // array of adjacency of indices
-idx_t* adjncy; // array of adjacency nodes
-idx_t* vwgt; // array of weight of nodes
-idx_t* adjwgt; // array of weight of edges in adjncy
-idx_t nparts; // number of parts to partition
-idx_t objval; // edge cut for partitioning solution
-idx_t* part; // array of partition vector
-idx_t options[METIS_NOPTIONS]; // option array
+// per thread, so that graph_partition can run in parallel
+thread_local idx_t nvtxs; // |vertices|
+thread_local idx_t ncon; // number of weight per vertex
+thread_local idx_t* xadj; // array of adjacency of indices
+thread_local idx_t* adjncy; // array of adjacency nodes
+thread_local idx_t* vwgt; // array of weight of nodes
+thread_local idx_t* adjwgt; // array of weight of edges in adjncy
+thread_local idx_t nparts; // number of parts to partition
+thread_local idx_t objval; // edge cut for partitioning solution
+thread_local idx_t* part; // array of partition vector
+idx_t options[METIS_NOPTIONS]; // option array, shared read only
+
+// ----- BUILD THREADS -----
+// number of build threads(-j N), 1 = serial, tasks run by parallel_for(see ../common/task_pool.h)
+int build_threads = 1;
+mutex metis_lock;
+
+// -d: directed graph, every edge line is one direction
+// the partition & borders use the undirected view, distances follow the edge direction
+bool directed = false;
+
+// -c file: customize, keep the partition(FILE_GTREE & FILE_NODES_GTREE_PATH) and recompute the distance
+// matrices for the edge weights in file, no METIS / build()
+bool customize = false;
+const char* edge_file = NULL; // FILE_EDGE unless -c
+
+// -z: packed kernel matrices in FILE_GTREE_INDEX(see gtree_index.h), smaller index, same answers
+bool packed = false;
+
+// -r: refine every METIS partition for fewer borders(partition_refine)
+bool refine = false;
+#define REFINE_PASSES 4 // passes over the vertices of a node set, stops early when a pass moves none
+
+// ----- NODE BUDGET -----
+// -B MB: the matrices(mind + via) of a non leaf tree node are union borders x union borders, and the union
+// borders of the top nodes grow with their fanout. under a budget a node set is split into the most parts,
+// up to -F(default -f), whose union borders fit in MB(GPTree's partition_root does the same for its root),
+// found by binary search over METIS runs(partition_fanout); 2 parts when none fits. the nodes left over
+// budget that way are listed after BUILD. a larger -F than -f makes the levels that have room flatter.
+// -E: estimate only, partition and print the matrix bytes per level(partition_report) without computing
+// them, for sizing the machine of the build(all levels stay in memory unless -m) and the index
+long long node_budget = 0; // bytes, 0 = every node has partition_part parts
+int fanout_max = 0; // -F, 0 = partition_part
+bool estimate = false;
+
+// ----- MEMORY BUDGET -----
+// -m MB: the distance matrices(mind, via, rmind, rvia) of finished levels stay in memory up to MB, the rest go
+// to a scratch file(FILE_GTREE_INDEX.spill, unlinked) and come back one tree node at a time while the
+// .minds/.via/.gidx files are written. the degenerate graph of the bottom up calculation is Nodes itself,
+// not a copy. the level being computed is in memory as a whole
+long long mem_budget = 0; // bytes, 0 = no budget
+long long mem_resident = 0; // bytes of matrices in memory of finished levels
+FILE* spill_file = NULL;
+vector<long long> spill_pos; // per tree node, offset of its matrices in spill_file, -1 = never spilled
 
 // METIS setting options
 void options_setting(){
@@ -98,44 +176,37 @@ void options_setting(){
 	// options[METIS_OPTION_DBGLVL] = 0;
 }
 
-// input init
+// input init(text parsed on all cores, binary cache edge_file.csr after the first run)
+// the build degenerates adjacency in place, so it is copied out of the CSR into Nodes
 void init_input(){
-	FILE *fin;
-
-	// load node
-	printf("LOADING NODE...");
-	fin = fopen(FILE_NODE,"r");
-	int nid;
-	double x,y;
-	while( fscanf(fin, "%d %lf %lf", &nid, &x, &y ) == 3 ){
-		Node node = { x, y };
-		Nodes.push_back(node);
+	printf("LOADING GRAPH...");
+	CsrGraph g;
+	bool cached;
+	if ( ! csr_load( g, FILE_NODE, edge_file, WEIGHT_INFLATE_FACTOR, thread::hardware_concurrency(), directed, cached ) ){
+		exit(1);
 	}
-	fclose(fin);
-	printf("COMPLETE. NODE_COUNT=%d\n", (int)Nodes.size());
-
-	// load edge
-	printf("LOADING EDGE...");
-	fin = fopen(FILE_EDGE, "r");
-	int eid;
-	int snid, enid;
-	double weight;
-	int iweight;
-	noe = 0;
-	while( fscanf(fin,"%d %d %d %lf", &eid, &snid, &enid, &weight ) == 4 ){
-		noe ++;
-		iweight = (int) (weight * WEIGHT_INFLATE_FACTOR );
-		Nodes[snid].adjnodes.push_back( enid );
-		Nodes[snid].adjweight.push_back( iweight );
-		Nodes[enid].adjnodes.push_back( snid );
-		Nodes[enid].adjweight.push_back( iweight );
+	Nodes.resize( g.n );
+	for ( int i = 0; i < g.n; i++ ){
+		Nodes[i].x = g.x[i];
+		Nodes[i].y = g.y[i];
+		Nodes[i].isborder = false;
+		Nodes[i].adjnodes.assign( g.target.begin() + g.offset[i], g.target.begin() + g.offset[i+1] );
+		Nodes[i].adjweight.assign( g.weight.begin() + g.offset[i], g.weight.begin() + g.offset[i+1] );
 	}
-	fclose(fin);
-	printf("COMPLETE.\n");
+	if ( directed ){
+		for ( int i = 0; i < g.n; i++ ){
+			for ( long long e = g.offset[i]; e < g.offset[i+1]; e++ ){
+				Nodes[ g.target[e] ].radjnodes.push_back( i );
+				Nodes[ g.target[e] ].radjweight.push_back( g.weight[e] );
+			}
+		}
+	}
+	noe = g.m;
+	printf("COMPLETE%s. NODE_COUNT=%d EDGE_COUNT=%d\n", cached ? "(CACHED)" : "", (int)Nodes.size(), noe );
 }
 
 // transform original data format to that suitable for METIS
-void data_transform_init( set<int> &nset ){
+void data_transform_init( set<int> &nset, int parts ){
 	// nvtxs, ncon
 	nvtxs = nset.size();
 	ncon = 1;
@@ -172,6 +243,18 @@ void data_transform_init( set<int> &nset ){
 				adjncy_pos ++;
 			}
 		}
+		// directed, METIS needs the undirected view: in edges without an opposite out edge
+		for ( int j = 0; j < Nodes[nid].radjnodes.size(); j++ ){
+			int enid = Nodes[nid].radjnodes[j];
+			if ( nset.find( enid ) != nset.end()
+				&& find( Nodes[nid].adjnodes.begin(), Nodes[nid].adjnodes.end(), enid ) == Nodes[nid].adjnodes.end() ){
+				xadj_accum ++;
+
+				adjncy[adjncy_pos] = enid;
+				adjwgt[adjncy_pos] = Nodes[nid].radjweight[j];
+				adjncy_pos ++;
+			}
+		}
 		xadj[xadj_pos++] = xadj_accum;
 	}
 
@@ -188,7 +271,7 @@ void data_transform_init( set<int> &nset ){
 	}
 
 	// nparts
-	nparts = PARTITION_PART;
+	nparts = parts;
 
 	// part
 	part = new idx_t[nset.size()];
@@ -199,6 +282,67 @@ void init(){
 	options_setting();
 }
 
+// border moves after METIS(-r): METIS minimizes the edge cut, the index size and the min-plus cost go
+// with the number of border vertices. a vertex on the cut moves to the part of a neighbour when that
+// lowers the count of vertices with a neighbour in another part(itself and its neighbours), greedy FM
+// style passes with only improving moves. parts keep at least one vertex and at most the larger of
+// their biggest size from METIS and 1.5 x average(UFACTOR 500). vertices with a neighbour outside
+// the node set are borders anyway and count as fixed
+void partition_refine( set<int> &nset ){
+	int n = nvtxs, k = nparts;
+	vector<char> outer( n, 0 );
+	int i = 0;
+	for ( set<int>::iterator it = nset.begin(); it != nset.end(); it++, i++ ){
+		const Node &v = Nodes[*it];
+		for ( int j = 0; ! outer[i] && j < v.adjnodes.size(); j++ ) outer[i] = nset.count( v.adjnodes[j] ) == 0;
+		for ( int j = 0; ! outer[i] && j < v.radjnodes.size(); j++ ) outer[i] = nset.count( v.radjnodes[j] ) == 0;
+	}
+	vector<int> size( k, 0 );
+	for ( int v = 0; v < n; v++ ) size[ part[v] ] ++;
+	int cap = max( *max_element( size.begin(), size.end() ), (int)( 1.5 * n / k ) );
+	// border of v if it sat in part p
+	auto border = [&]( int v, int p, int moved, int to ){
+		if ( outer[v] ) return true;
+		for ( idx_t e = xadj[v]; e < xadj[v+1]; e++ ){
+			int u = adjncy[e];
+			if ( ( u == moved ? to : part[u] ) != p ) return true;
+		}
+		return false;
+	};
+	vector<int> targets;
+	for ( int pass = 0; pass < REFINE_PASSES; pass++ ){
+		int moves = 0;
+		for ( int v = 0; v < n; v++ ){
+			int from = part[v];
+			if ( size[from] == 1 ) continue;
+			targets.clear();
+			for ( idx_t e = xadj[v]; e < xadj[v+1]; e++ ){
+				int p = part[ adjncy[e] ];
+				if ( p != from && size[p] < cap && find( targets.begin(), targets.end(), p ) == targets.end() ) targets.push_back( p );
+			}
+			int best = 0, bestp = -1;
+			for ( int t = 0; t < targets.size(); t++ ){
+				int to = targets[t];
+				int gain = (int) border( v, from, -1, 0 ) - (int) border( v, to, v, to );
+				for ( idx_t e = xadj[v]; e < xadj[v+1]; e++ ){
+					int u = adjncy[e];
+					gain += (int) border( u, part[u], -1, 0 ) - (int) border( u, part[u], v, to );
+				}
+				if ( gain > best ){
+					best = gain;
+					bestp = to;
+				}
+			}
+			if ( bestp < 0 ) continue;
+			size[from] --;
+			size[bestp] ++;
+			part[v] = bestp;
+			moves ++;
+		}
+		if ( moves == 0 ) break;
+	}
+}
+
 void finalize(){
     delete xadj;
     delete adjncy;
@@ -207,16 +351,18 @@ void finalize(){
 }
 
 // graph partition
-// input: nset = a set of node id
+// input: nset = a set of node id, parts = number of partitions
 // output: <node, node belong to partition id>
-unordered_map<int,int> graph_partition( set<int> &nset ){
+unordered_map<int,int> graph_partition( set<int> &nset, int parts ){
 	unordered_map<int,int> result;
 
 	// transform data to metis
-	data_transform_init( nset );		
+	data_transform_init( nset, parts );		
 
 	// partition, result -> part
 	// k way partition
+	unique_lock<mutex> guard( metis_lock, defer_lock );
+	if ( ! METIS_THREADSAFE ) guard.lock();
 	METIS_PartGraphKway(
         &nvtxs,
         &ncon,
@@ -232,6 +378,8 @@ unordered_map<int,int> graph_partition( set<int> &nset ){
         &objval,
         part
     );	
+	if ( guard.owns_lock() ) guard.unlock();
+	if ( refine ) partition_refine( nset );
 
 	// push to result
 	result.clear();
@@ -246,14 +394,119 @@ unordered_map<int,int> graph_partition( set<int> &nset ){
 	return result;
 }
 
+// union borders of nset split as result: vertices with a neighbour outside nset or in another part
+long long union_border_count( set<int> &nset, unordered_map<int,int> &result ){
+	long long n = 0;
+	for ( set<int>::iterator it = nset.begin(); it != nset.end(); it++ ){
+		const Node &v = Nodes[*it];
+		int p = result[*it];
+		bool border = false;
+		for ( int j = 0; ! border && j < v.adjnodes.size(); j++ ){
+			unordered_map<int,int>::iterator u = result.find( v.adjnodes[j] );
+			border = u == result.end() || u->second != p;
+		}
+		for ( int j = 0; ! border && j < v.radjnodes.size(); j++ ){
+			unordered_map<int,int>::iterator u = result.find( v.radjnodes[j] );
+			border = u == result.end() || u->second != p;
+		}
+		n += border;
+	}
+	return n;
+}
+
+// matrix bytes of a non leaf node(mind + via, see partition_report)
+long long node_matrix_bytes( long long union_borders ){
+	return 2 * sizeof(int) * union_borders * union_borders;
+}
+
+// split of nset under node_budget(see NODE BUDGET), the number of parts is returned
+int partition_fanout( set<int> &nset, unordered_map<int,int> &result ){
+	int fmax = max( fanout_max, partition_part );
+	if ( fmax > nset.size() ) fmax = nset.size();
+	int parts = min( partition_part, fmax );
+	result = graph_partition( nset, parts );
+	if ( node_budget == 0 ) return parts;
+	int lo = 2, hi = fmax, best = -1;
+	unordered_map<int,int> trial;
+	if ( node_matrix_bytes( union_border_count( nset, result ) ) <= node_budget ){
+		best = parts;
+		lo = parts + 1;
+	}
+	else hi = parts - 1;
+	while( lo <= hi ){
+		int mid = ( lo + hi + 1 ) / 2;
+		trial = graph_partition( nset, mid );
+		if ( node_matrix_bytes( union_border_count( nset, trial ) ) <= node_budget ){
+			best = mid;
+			result.swap( trial );
+			lo = mid + 1;
+		}
+		else hi = mid - 1;
+	}
+	if ( best > 0 ) return best;
+	// none fits, the fewest borders
+	if ( parts > 2 ) result = graph_partition( nset, 2 );
+	return 2;
+}
+
 // init status struct
 typedef struct{
 	int tnid; // tree node id
-	set<int> nset; // node set
+	int pnid; // partition tree node(PartNode) id
 }Status;
 
+// partition tree, the METIS results of every node set, computed before tree node ids are given
+typedef struct{
+	set<int> nset; // node set
+	vector<int> child; // PartNode of each part, empty for leaf
+}PartNode;
+
+// partition level by level, the node sets of one level are partitioned in parallel
+// children are appended in part order, so the partition tree does not depend on build_threads
+void build_partition( vector<PartNode> &ptree ){
+	ptree.clear();
+	ptree.push_back( PartNode() );
+	for ( int i = 0; i < Nodes.size(); i++ ){
+		ptree[0].nset.insert(i);
+	}
+
+	vector<int> level( 1, 0 ), next, pparts;
+	vector< unordered_map<int,int> > presults;
+	while( level.size() > 0 ){
+		presults.assign( level.size(), unordered_map<int,int>() );
+		pparts.assign( level.size(), 0 );
+		parallel_for( build_threads, level.size(), [&]( int worker, int i ){
+			if ( ptree[level[i]].nset.size() > leaf_cap ){
+				pparts[i] = partition_fanout( ptree[level[i]].nset, presults[i] );
+			}
+		} );
+
+		// construct child node set
+		next.clear();
+		for ( int i = 0; i < level.size(); i++ ){
+			int pn = level[i];
+			if ( ptree[pn].nset.size() <= leaf_cap ) continue;
+
+			ptree[pn].child.resize( pparts[i] );
+			for ( int j = 0; j < pparts[i]; j++ ){
+				ptree[pn].child[j] = ptree.size();
+				next.push_back( ptree.size() );
+				ptree.push_back( PartNode() );
+			}
+			for ( set<int>::iterator it = ptree[pn].nset.begin(); it != ptree[pn].nset.end(); it++ ){
+				ptree[ ptree[pn].child[ presults[i][*it] ] ].nset.insert(*it);
+			}
+		}
+		level.swap( next );
+	}
+}
+
 // gtree construction
 void build(){
+	// partition first(parallel), then give tree node ids in the serial stack order
+	vector<PartNode> ptree;
+	build_partition( ptree );
+
 	// init root
 	TreeNode root;
 	root.isleaf = false;
@@ -264,56 +517,37 @@ void build(){
 	stack<Status> buildstack;
 	Status rootstatus;
 	rootstatus.tnid = 0;
-	rootstatus.nset.clear();
-	for ( int i = 0; i < Nodes.size(); i++ ){
-		rootstatus.nset.insert(i);
-	}
+	rootstatus.pnid = 0;
 	buildstack.push( rootstatus );
 
 	// start to build
-	unordered_map<int,int> presult;
-	set<int> childset[PARTITION_PART];
-
-
 	while( buildstack.size() > 0 ){
 		// pop top
 		Status current = buildstack.top();
 		buildstack.pop();
+		set<int> &nset = ptree[current.pnid].nset;
 
 		// update gtreepath
-		for ( set<int>::iterator it = current.nset.begin(); it != current.nset.end(); it++ ){
+		for ( set<int>::iterator it = nset.begin(); it != nset.end(); it++ ){
 			Nodes[*it].gtreepath.push_back( current.tnid );
 		}
 
 		// check cardinality
-		if ( current.nset.size() <= LEAF_CAP ){
+		if ( nset.size() <= leaf_cap ){
 			// build leaf node
 			GTree[current.tnid].isleaf = true;
 			GTree[current.tnid].leafnodes.clear();
-			for ( set<int>::iterator it = current.nset.begin(); it != current.nset.end(); it++ ){
+			for ( set<int>::iterator it = nset.begin(); it != nset.end(); it++ ){
 				GTree[current.tnid].leafnodes.push_back( *it );
 			}
 			continue;
 		}
 
-		// partition
-//		printf("PARTITIONING...NID=%d...SIZE=%d...", current.tnid, (int)current.nset.size() );
-		presult = graph_partition( current.nset );
-//		printf("COMPLETE.\n");
-
-		// construct child node set
-		for ( int i = 0; i < PARTITION_PART; i++ ){
-			childset[i].clear();
-		}
-		int slot;
-		for ( set<int>::iterator it = current.nset.begin(); it != current.nset.end(); it++ ){
-			slot = presult[*it];
-			childset[slot].insert(*it);
-		}
-
+		// child node sets, partitioned by build_partition
 		// generate child tree nodes
 		int childpos;
-		for ( int i = 0; i < PARTITION_PART; i++ ){
+		for ( int i = 0; i < ptree[current.pnid].child.size(); i++ ){
+			set<int> &childset = ptree[ ptree[current.pnid].child[i] ].nset;
 			TreeNode tnode;
 			tnode.isleaf = false;
 			tnode.father = current.tnid;
@@ -325,15 +559,21 @@ void build(){
 
 			// calculate border nodes
 			GTree[childpos].borders.clear();
-			for ( set<int>::iterator it = childset[i].begin(); it != childset[i].end(); it++ ){
+			for ( set<int>::iterator it = childset.begin(); it != childset.end(); it++ ){
 
 				bool isborder = false;
 				for ( int j = 0; j < Nodes[*it].adjnodes.size(); j++ ){
-					if ( childset[i].find( Nodes[*it].adjnodes[j] ) == childset[i].end() ){
+					if ( childset.find( Nodes[*it].adjnodes[j] ) == childset.end() ){
 						isborder = true;
 						break;
 					}
 				}
+				// directed, an edge coming in from outside makes a border too
+				for ( int j = 0; ! isborder && j < Nodes[*it].radjnodes.size(); j++ ){
+					if ( childset.find( Nodes[*it].radjnodes[j] ) == childset.end() ){
+						isborder = true;
+					}
+				}
 				if ( isborder ){
 					GTree[childpos].borders.push_back(*it);
 					// update globally
@@ -344,7 +584,7 @@ void build(){
 			// add to stack
 			Status ongoingstatus;
 			ongoingstatus.tnid = childpos;
-			ongoingstatus.nset = childset[i];
+			ongoingstatus.pnid = ptree[current.pnid].child[i];
 			buildstack.push(ongoingstatus);
 
 		}
@@ -398,6 +638,10 @@ void gtree_save(){
 void gtree_load(){
 	// FILE_GTREE
 	FILE *fin = fopen( FILE_GTREE, "rb" );
+	if ( fin == NULL ){
+		printf("CANNOT OPEN %s\n", FILE_GTREE );
+		exit(1);
+	}
 	int *buf = new int[ Nodes.size() ];
 	int count_borders, count_children, count_leafnodes;
 	bool isleaf;
@@ -440,8 +684,12 @@ void gtree_load(){
 	// FILE_NODES_GTREE_PATH
 	int count;
 	fin = fopen( FILE_NODES_GTREE_PATH, "rb" );
+	if ( fin == NULL ){
+		printf("CANNOT OPEN %s\n", FILE_NODES_GTREE_PATH );
+		exit(1);
+	}
 	int pos = 0;
-	while( fread( &count, sizeof(int), 1, fin ) ){
+	while( pos < Nodes.size() && fread( &count, sizeof(int), 1, fin ) ){
 		fread( buf, sizeof(int), count, fin );
 		// clear gtreepath
 		Nodes[pos].gtreepath.clear();
@@ -455,78 +703,231 @@ void gtree_load(){
 	delete[] buf;
 }
 
+// customize: the loaded tree fits the graph in Nodes if both have the same vertices and every edge
+// crossing a tree node boundary joins borders of the tree nodes on either side(weights are free to change)
+bool customize_check(){
+	if ( GTree.size() == 0 ) return false;
+	for ( int s = 0; s < Nodes.size(); s++ ){
+		if ( Nodes[s].gtreepath.size() == 0 ) return false;
+	}
+	for ( int s = 0; s < Nodes.size(); s++ ){
+		const vector<int> &ps = Nodes[s].gtreepath;
+		for ( int j = 0; j < Nodes[s].adjnodes.size(); j++ ){
+			const vector<int> &pt = Nodes[ Nodes[s].adjnodes[j] ].gtreepath;
+			for ( int l = 1; l < ps.size() || l < pt.size(); l++ ){
+				if ( l < ps.size() && l < pt.size() && ps[l] == pt[l] ) continue;
+				if ( l < ps.size() && ! binary_search( GTree[ps[l]].borders.begin(), GTree[ps[l]].borders.end(), s ) ) return false;
+				if ( l < pt.size() && ! binary_search( GTree[pt[l]].borders.begin(), GTree[pt[l]].borders.end(), Nodes[s].adjnodes[j] ) ) return false;
+			}
+		}
+	}
+	return true;
+}
+
 // dijkstra search, used for single-source shortest path search WITHIN one gtree leaf node!
-// input: s = source node
+// 4-ary heap over dense stamp cleared arrays(see ../common/dheap.h), stops once all cands are settled
+// input: h = scratch heap, sized to graph
+//        s = source node
 //        cands = candidate node list
 //        graph = search graph(this can be set to subgraph)
-vector<int> dijkstra_candidate( int s, vector<int> &cands, vector<Node> &graph ){
+// output: output[i] = shortest path of cands[i], 0 if not reachable
+void dijkstra_candidate( DHeap &h, int s, const int* cands, int ncands, vector<Node> &graph, int* output ){
 	// init
-	set<int> todo;
-	todo.clear();
-	todo.insert(cands.begin(), cands.end());
-	
-	unordered_map<int,int> result;
-	result.clear();
-	set<int> visited;
-	visited.clear();
-	unordered_map<int,int> q;
-	q.clear();
-	q[s] = 0;
+	dheap_reset( h );
+	int todo = 0;
+	for ( int i = 0; i < ncands; i++ ){
+		if ( ! dheap_tagged( h, cands[i] ) ){
+			dheap_tag( h, cands[i] );
+			todo ++;
+		}
+	}
+	dheap_push( h, s, 0 );
 
 	// start
-	int min, minpos, adjnode, weight;
-	while( ! todo.empty() && ! q.empty() ){
-		min = -1;
-		for ( unordered_map<int,int>::iterator it = q.begin(); it != q.end(); it ++ ){
-			if ( min == -1 ){
-				minpos = it -> first;
-				min = it -> second;
-			}
-			else{
-				if ( it -> second < min ){
-					min = it -> second;
-					minpos = it -> first;
-				}
-			}
+	int min, minpos;
+	while( todo > 0 && h.size > 0 ){
+		// settle min
+		minpos = dheap_pop( h );
+		min = h.key[minpos];
+		if ( dheap_tagged( h, minpos ) ){
+			dheap_untag( h, minpos );
+			todo --;
 		}
 
-		// put min to result, add to visited
-		result[minpos] = min;
-		visited.insert( minpos );
-		q.erase(minpos);
+		// expand, settled nodes are skipped by dheap_push
+		const vector<int> &adjnodes = graph[minpos].adjnodes;
+		const vector<int> &adjweight = graph[minpos].adjweight;
+		for ( int i = 0; i < adjnodes.size(); i++ ){
+			dheap_push( h, adjnodes[i], min + adjweight[i] );
+		}
+	}
+
+	// output
+	for ( int i = 0; i < ncands; i++ ){
+		output[i] = dheap_settled( h, cands[i] ) ? h.key[cands[i]] : 0;
+	}
+}
 
-		if ( todo.find( minpos ) != todo.end() ){
-			todo.erase( minpos );
+// convenience version, uses a per thread scratch heap
+vector<int> dijkstra_candidate( int s, vector<int> &cands, vector<Node> &graph ){
+	thread_local DHeap h;
+	if ( h.mark.size() != graph.size() ){
+		dheap_init( h, graph.size() );
+	}
+	vector<int> output( cands.size() );
+	if ( cands.size() > 0 ){
+		dijkstra_candidate( h, s, &cands[0], cands.size(), graph, &output[0] );
+	}
+	return output;
+}
+
+// dijkstra_candidate for row s of the distance matrix of tree node tn(at tree level), recording paths
+// ties are broken towards the path with fewer edges leaving tn, so a pair of borders gets a path
+// inside tn whenever there is one of the same length.
+// cands must be sorted and hold every vertex of tn reachable in graph(leaf: leafnodes, non leaf: union borders).
+// reverse = search the reverse graph(directed only), distances & paths are then from cands[i] to s
+// output: output[i] as dijkstra_candidate
+//         via[i] = position in cands of the vertex before cands[i] on its path,
+//                  or ~position of the border of tn where the path came back into tn if it ends outside tn.
+//         the path to cands[i] is the path to that vertex, then the last hop: an edge, a border to border
+//         shortcut of a child(non leaf, both in one child), or a walk outside tn(the father's mind entry).
+//         reverse: the same with the path read from cands[i], via[i] is the vertex after cands[i].
+void dijkstra_candidate_via( DHeap &h, int s, const int* cands, int ncands, vector<Node> &graph, int tn, int level,
+	bool reverse, vector<int> &pred, vector<int> &out, vector<int> &last, int* output, int* via ){
+	// init
+	dheap_reset( h );
+	int todo = 0;
+	for ( int i = 0; i < ncands; i++ ){
+		if ( ! dheap_tagged( h, cands[i] ) ){
+			dheap_tag( h, cands[i] );
+			todo ++;
 		}
+	}
+	dheap_push( h, s, 0 );
+	pred[s] = s;
+	out[s] = 0;
 
-		// expand
-		for ( int i = 0; i < graph[minpos].adjnodes.size(); i++ ){
-			adjnode = graph[minpos].adjnodes[i];
-			if ( visited.find( adjnode ) != visited.end() ){
-				continue;
-			}
-			weight = graph[minpos].adjweight[i];
+	// start
+	int min, minpos, nid, d, o;
+	bool inside;
+	while( todo > 0 && h.size > 0 ){
+		// settle min, last = latest vertex of tn on its path
+		minpos = dheap_pop( h );
+		min = h.key[minpos];
+		inside = graph[minpos].gtreepath.size() > level && graph[minpos].gtreepath[level] == tn;
+		last[minpos] = inside ? minpos : last[ pred[minpos] ];
+		if ( dheap_tagged( h, minpos ) ){
+			dheap_untag( h, minpos );
+			todo --;
+		}
 
-			if ( q.find(adjnode) != q.end() ){
-				if ( min + weight < q[adjnode] ){
-					q[adjnode] = min + weight;
-				}
+		// expand, equal distance keeps the path with fewer edges out of tn
+		const vector<int> &adjnodes = reverse ? graph[minpos].radjnodes : graph[minpos].adjnodes;
+		const vector<int> &adjweight = reverse ? graph[minpos].radjweight : graph[minpos].adjweight;
+		for ( int i = 0; i < adjnodes.size(); i++ ){
+			nid = adjnodes[i];
+			d = min + adjweight[i];
+			o = out[minpos] + ( inside && graph[nid].gtreepath.size() > level && graph[nid].gtreepath[level] == tn ? 0 : 1 );
+			if ( ! dheap_touched( h, nid ) || ( ! dheap_settled( h, nid ) && ( d < h.key[nid] || ( d == h.key[nid] && o < out[nid] ) ) ) ){
+				dheap_push( h, nid, d );
+				pred[nid] = minpos;
+				out[nid] = o;
 			}
-			else{
-				q[adjnode] = min + weight;
-			}
-		
 		}
 	}
 
 	// output
-	vector<int> output;
-	for ( int i = 0; i < cands.size(); i++ ){
-		output.push_back( result[cands[i]] );
+	int p;
+	for ( int i = 0; i < ncands; i++ ){
+		if ( ! dheap_settled( h, cands[i] ) ){
+			output[i] = directed ? MINPLUS_INF : 0;
+			via[i] = i;
+			continue;
+		}
+		output[i] = h.key[cands[i]];
+		p = cands[i] == s ? s : pred[cands[i]];
+		if ( last[p] == p ){
+			via[i] = lower_bound( cands, cands + ncands, p ) - cands;
+		}
+		else{
+			via[i] = ~( lower_bound( cands, cands + ncands, last[p] ) - cands );
+		}
 	}
+}
 
-	// return
-	return output;
+// true if the recorded path from union border s to cand t of tree node tnode stays inside it
+bool via_inside( TreeNode &tnode, vector<int> &cands, int s, int t ){
+	int k = lower_bound( tnode.union_borders.begin(), tnode.union_borders.end(), s ) - tnode.union_borders.begin();
+	int col = lower_bound( cands.begin(), cands.end(), t ) - cands.begin();
+	int v;
+	while( cands[col] != s ){
+		v = tnode.via[ k * cands.size() + col ];
+		if ( v < 0 ) return false;
+		if ( v == col ) break;
+		col = v;
+	}
+	return true;
+}
+
+// bytes of the distance matrices of a tree node
+long long matrix_bytes( TreeNode &t ){
+	return sizeof(int) * (long long)( t.mind.size() + t.via.size() + t.rmind.size() + t.rvia.size() );
+}
+
+// the matrices of tree node tn to spill_file("count array" each), freed
+bool matrix_spill( int tn ){
+	if ( spill_file == NULL ){
+		string file = file_gidx + ".spill";
+		spill_file = fopen( file.c_str(), "w+b" );
+		if ( spill_file == NULL ) return false;
+		remove( file.c_str() ); // gone with the process
+		spill_pos.assign( GTree.size(), -1 );
+	}
+	TreeNode &t = GTree[tn];
+	vector<int>* m[4] = { &t.mind, &t.via, &t.rmind, &t.rvia };
+	fseeko( spill_file, 0, SEEK_END );
+	spill_pos[tn] = ftello( spill_file );
+	for ( int i = 0; i < 4; i++ ){
+		long long count = m[i]->size();
+		if ( fwrite( &count, sizeof(long long), 1, spill_file ) != 1 ) return false;
+		if ( count > 0 && fwrite( &(*m[i])[0], sizeof(int), count, spill_file ) != count ) return false;
+	}
+	mem_resident -= matrix_bytes( t );
+	for ( int i = 0; i < 4; i++ ) vector<int>().swap( *m[i] );
+	return true;
+}
+
+// the matrices of a spilled tree node back into memory(resident = true) or freed again(false),
+// other tree nodes are untouched. the index writer calls it around each tree node(see GTreeIndexResident)
+void matrix_resident( int tn, bool in ){
+	if ( spill_file == NULL || spill_pos[tn] < 0 ) return;
+	TreeNode &t = GTree[tn];
+	vector<int>* m[4] = { &t.mind, &t.via, &t.rmind, &t.rvia };
+	if ( ! in ){
+		for ( int i = 0; i < 4; i++ ) vector<int>().swap( *m[i] );
+		return;
+	}
+	fseeko( spill_file, spill_pos[tn], SEEK_SET );
+	for ( int i = 0; i < 4; i++ ){
+		long long count = -1;
+		if ( fread( &count, sizeof(long long), 1, spill_file ) == 1 && count >= 0 ) m[i]->resize( count );
+		if ( count < 0 || ( count > 0 && fread( &(*m[i])[0], sizeof(int), count, spill_file ) != count ) ){
+			printf("CANNOT READ BACK THE MATRICES OF TREE NODE %d\n", tn );
+			exit(1);
+		}
+	}
+}
+
+// finished level: spill its tree nodes while the matrices in memory are over the budget
+void matrix_budget( vector<int> &level ){
+	for ( int j = 0; j < level.size(); j++ ) mem_resident += matrix_bytes( GTree[ level[j] ] );
+	for ( int j = 0; j < level.size() && mem_resident > mem_budget; j++ ){
+		if ( ! matrix_spill( level[j] ) ){
+			printf("CANNOT SPILL TO %s.spill\n", FILE_GTREE_INDEX );
+			exit(1);
+		}
+	}
+	malloc_trim( 0 );
 }
 
 // calculate the distance matrix, algorithm shown in section 5.2 of paper
@@ -553,11 +954,12 @@ void hierarchy_shortest_path_calculation(){
 	}
 	
 	// bottom up calculation
-	// temp graph
-	vector<Node> graph;
-	graph = Nodes;
-	vector<int> cands;
-	vector<int> result;
+	// temp graph, under a memory budget Nodes itself(its adjacency is not used after this)
+	vector<Node> copy;
+	if ( mem_budget == 0 ) copy = Nodes;
+	vector<Node> &graph = mem_budget == 0 ? copy : Nodes;
+	vector< vector<int> > levelcands;
+	vector< pair<int,int> > jobs;
 	unordered_map<int, unordered_map<int,int> > vertex_pairs;
 
 	// do dijkstra
@@ -566,10 +968,13 @@ void hierarchy_shortest_path_calculation(){
 	set<int> nset;
 
 	for ( int i = treenodelevel.size() - 1; i >= 0; i-- ){
+		// union borders & candidates of each tree node in this level
+		levelcands.assign( treenodelevel[i].size(), vector<int>() );
+		jobs.clear();
 		for ( int j = 0; j < treenodelevel[i].size(); j++ ){
 			tn = treenodelevel[i][j];
+			vector<int> &cands = levelcands[j];
 
-			cands.clear();
 			if ( GTree[tn].isleaf ){
 				// cands = leafnodes
 				cands = GTree[tn].leafnodes;
@@ -590,22 +995,60 @@ void hierarchy_shortest_path_calculation(){
 				}
 				GTree[tn].union_borders = cands;
 			}
-				
-			// start to do min dis
-			vertex_pairs.clear();
-				
-			// for each border, do min dis
-			int cc = 0;
 
+			GTree[tn].mind.assign( GTree[tn].union_borders.size() * cands.size(), 0 );
+			GTree[tn].via.assign( GTree[tn].union_borders.size() * cands.size(), 0 );
 			for ( int k = 0; k < GTree[tn].union_borders.size(); k++ ){
-				//printf("DIJKSTRA...LEAF=%d BORDER=%d\n", tn, GTree[tn].union_borders[k] );
-				result = dijkstra_candidate( GTree[tn].union_borders[k], cands, graph );
-				//printf("DIJKSTRA...END\n");
-
-				// save to map
-				for ( int p = 0; p < result.size(); p ++ ){
-					GTree[tn].mind.push_back( result[p] );
-					vertex_pairs[GTree[tn].union_borders[k]][cands[p]] = result[p];
+				jobs.push_back( make_pair( j, k ) );
+			}
+			// directed leaf, distances to the borders as well, job k = ~row of rmind
+			// (non leaf mind is square, it has both directions)
+			if ( directed && GTree[tn].isleaf ){
+				GTree[tn].rmind.assign( GTree[tn].borders.size() * cands.size(), 0 );
+				GTree[tn].rvia.assign( GTree[tn].borders.size() * cands.size(), 0 );
+				for ( int k = 0; k < GTree[tn].borders.size(); k++ ){
+					jobs.push_back( make_pair( j, ~k ) );
+				}
+			}
+		}
+
+		// for each border, do min dis, row k of mind
+		// the tree nodes of one level are disjoint and degenerating one of them keeps all
+		// distances outside it, so every dijkstra of this level runs on the graph as it was
+		// after the level below, in any order
+		parallel_for( build_threads, jobs.size(), [&]( int worker, int x ){
+			thread_local DHeap h;
+			thread_local vector<int> pred, out, last;
+			if ( h.mark.size() != graph.size() ){
+				dheap_init( h, graph.size() );
+				pred.assign( graph.size(), 0 );
+				out.assign( graph.size(), 0 );
+				last.assign( graph.size(), 0 );
+			}
+			int j = jobs[x].first, k = jobs[x].second;
+			int tn = treenodelevel[i][j];
+			vector<int> &cands = levelcands[j];
+			if ( cands.size() == 0 ) return;
+			if ( k >= 0 ){
+				dijkstra_candidate_via( h, GTree[tn].union_borders[k], &cands[0], cands.size(), graph, tn, i, false,
+					pred, out, last, &GTree[tn].mind[ k * cands.size() ], &GTree[tn].via[ k * cands.size() ] );
+			}
+			else{
+				k = ~k;
+				dijkstra_candidate_via( h, GTree[tn].borders[k], &cands[0], cands.size(), graph, tn, i, true,
+					pred, out, last, &GTree[tn].rmind[ k * cands.size() ], &GTree[tn].rvia[ k * cands.size() ] );
+			}
+		} );
+
+		for ( int j = 0; j < treenodelevel[i].size(); j++ ){
+			tn = treenodelevel[i][j];
+			vector<int> &cands = levelcands[j];
+
+			// save to map
+			vertex_pairs.clear();
+			for ( int k = 0; k < GTree[tn].union_borders.size(); k++ ){
+				for ( int p = 0; p < cands.size(); p ++ ){
+					vertex_pairs[GTree[tn].union_borders[k]][cands[p]] = GTree[tn].mind[ k * cands.size() + p ];
 				}
 			}
 
@@ -630,18 +1073,41 @@ void hierarchy_shortest_path_calculation(){
 				// cut it
 				graph[s].adjnodes = tnodes;
 				graph[s].adjweight = tweight;
+
+				// directed, in edges from inside as well
+				if ( ! directed ) continue;
+				tnodes.clear();
+				tweight.clear();
+				for ( int p = 0; p < graph[s].radjnodes.size(); p++ ){
+					nid = graph[s].radjnodes[p];
+					if ( graph[nid].gtreepath.size() <= i || graph[nid].gtreepath[i] != tn ){
+						tnodes.push_back(nid);
+						tweight.push_back(graph[s].radjweight[p]);
+					}
+				}
+				graph[s].radjnodes = tnodes;
+				graph[s].radjweight = tweight;
 			}
 			// second, add inter connected edges
+			// a pair whose shortest path leaves tn needs no shortcut, that path is still in the graph.
+			// this keeps every shortcut a path inside tn, so a father's route never points back through it.
 			for ( int k = 0; k < GTree[tn].borders.size(); k++ ){
 				for ( int p = 0; p < GTree[tn].borders.size(); p++ ){
 					if ( k == p ) continue;
 					s = GTree[tn].borders[k];
 					t = GTree[tn].borders[p];
+					if ( ! via_inside( GTree[tn], cands, s, t ) ) continue;
+					if ( vertex_pairs[s][t] >= MINPLUS_INF ) continue; // directed, t unreachable from s
 					graph[s].adjnodes.push_back( t );
 					graph[s].adjweight.push_back( vertex_pairs[s][t] );
+					if ( directed ){
+						graph[t].radjnodes.push_back( s );
+						graph[t].radjweight.push_back( vertex_pairs[s][t] );
+					}
 				}
 			}
 		}
+		if ( mem_budget > 0 ) matrix_budget( treenodelevel[i] );
 	}
 }
 
@@ -651,6 +1117,7 @@ void hierarchy_shortest_path_save(){
 	int* buf;
 	int count;
 	for ( int i = 0; i < GTree.size(); i++ ){
+		matrix_resident( i, true );
 		// union borders
 		count = GTree[i].union_borders.size();
 		fwrite( &count, sizeof(int), 1, fout );
@@ -665,6 +1132,20 @@ void hierarchy_shortest_path_save(){
 		copy( GTree[i].mind.begin(), GTree[i].mind.end(), buf );
 		fwrite( buf, sizeof(int), count, fout );
 		delete[] buf;
+		matrix_resident( i, false );
+	}
+	fclose(fout);
+
+	// paths of mind(FILE_ONTREE_VIA), one array per tree node
+	fout = fopen( FILE_ONTREE_VIA, "wb" );
+	for ( int i = 0; i < GTree.size(); i++ ){
+		matrix_resident( i, true );
+		count = GTree[i].via.size();
+		fwrite( &count, sizeof(int), 1, fout );
+		if ( count > 0 ){
+			fwrite( &GTree[i].via[0], sizeof(int), count, fout );
+		}
+		matrix_resident( i, false );
 	}
 	fclose(fout);
 }
@@ -697,30 +1178,284 @@ void hierarchy_shortest_path_load(){
 	fclose(fin);
 }
 
-int main(){
+// up_pos & current_pos(used for quickly locating parent & child nodes)
+// up_pos: position of each border in father's union_borders
+// current_pos: position of each border in its own union_borders
+void hierarchy_pos_init(){
+	unordered_map<int,int> pos_map;
+	for ( int i = 1; i < GTree.size(); i++ ){
+		GTree[i].current_pos.clear();
+		GTree[i].up_pos.clear();
+
+		// current_pos
+		pos_map.clear();
+		for ( int j = 0; j < GTree[i].union_borders.size(); j++ ){
+			pos_map[GTree[i].union_borders[j]] = j;
+		}
+		for ( int j = 0; j < GTree[i].borders.size(); j++ ){
+			GTree[i].current_pos.push_back(pos_map[GTree[i].borders[j]]);
+		}
+		// up_pos
+		pos_map.clear();
+		for ( int j = 0; j < GTree[GTree[i].father].union_borders.size(); j++ ){
+			pos_map[GTree[GTree[i].father].union_borders[j]] = j;
+		}
+		for ( int j = 0; j < GTree[i].borders.size(); j++ ){
+			GTree[i].up_pos.push_back(pos_map[GTree[i].borders[j]]);
+		}
+	}
+}
+
+// sample for tuning(see autotune.sh): the n vertices nearest(in hops) to the vertex closest to the centroid,
+// written as data set name with their edges, vertex ids renumbered in the original order
+void sample_save( int n, const string &name ){
+	double cx = 0, cy = 0;
+	for ( int i = 0; i < Nodes.size(); i++ ){
+		cx += Nodes[i].x / Nodes.size();
+		cy += Nodes[i].y / Nodes.size();
+	}
+	int s = 0;
+	for ( int i = 1; i < Nodes.size(); i++ ){
+		if ( ( Nodes[i].x - cx ) * ( Nodes[i].x - cx ) + ( Nodes[i].y - cy ) * ( Nodes[i].y - cy )
+			< ( Nodes[s].x - cx ) * ( Nodes[s].x - cx ) + ( Nodes[s].y - cy ) * ( Nodes[s].y - cy ) ) s = i;
+	}
+
+	// bfs on the undirected view
+	vector<int> id( Nodes.size(), -1 ), picked;
+	deque<int> q;
+	q.push_back( s );
+	id[s] = 0;
+	while( q.size() > 0 && picked.size() < n ){
+		int v = q.front();
+		q.pop_front();
+		picked.push_back( v );
+		for ( int k = 0; k < 2; k++ ){
+			const vector<int> &adj = k == 0 ? Nodes[v].adjnodes : Nodes[v].radjnodes;
+			for ( int j = 0; j < adj.size(); j++ ){
+				if ( id[adj[j]] < 0 ){
+					id[adj[j]] = 0;
+					q.push_back( adj[j] );
+				}
+			}
+		}
+	}
+	sort( picked.begin(), picked.end() );
+	id.assign( Nodes.size(), -1 );
+	for ( int i = 0; i < picked.size(); i++ ) id[picked[i]] = i;
+
+	FILE* fout = fopen( ( name + ".cnode" ).c_str(), "w" );
+	for ( int i = 0; i < picked.size(); i++ ){
+		fprintf( fout, "%d %.17g %.17g\n", i, Nodes[picked[i]].x, Nodes[picked[i]].y );
+	}
+	fclose(fout);
+	// weights back to the input unit, half a unit up so inflating gives the same int again
+	fout = fopen( ( name + ".cedge" ).c_str(), "w" );
+	int eid = 0;
+	for ( int i = 0; i < picked.size(); i++ ){
+		const Node &v = Nodes[picked[i]];
+		for ( int j = 0; j < v.adjnodes.size(); j++ ){
+			int t = id[v.adjnodes[j]];
+			if ( t < 0 || ( ! directed && t <= i ) ) continue;
+			fprintf( fout, "%d %d %d %.9f\n", eid++, i, t, ( v.adjweight[j] + 0.5 ) / WEIGHT_INFLATE_FACTOR );
+		}
+	}
+	fclose(fout);
+	printf("SAMPLE %s: NODE_COUNT=%d EDGE_COUNT=%d\n", name.c_str(), (int)picked.size(), eid );
+}
+
+// partition quality per level, after the matrices are sized: tree nodes, borders and union borders
+// (sum, max), bytes of the distance matrices, balance = largest / average vertices of a tree node
+// union borders of every tree node from the borders of its children, as the distance calculation sets them
+void union_borders_init(){
+	for ( int tn = 0; tn < GTree.size(); tn++ ){
+		TreeNode &t = GTree[tn];
+		if ( t.isleaf ){
+			t.union_borders = t.borders;
+			continue;
+		}
+		set<int> ub;
+		for ( int k = 0; k < t.children.size(); k++ ){
+			const vector<int> &b = GTree[ t.children[k] ].borders;
+			ub.insert( b.begin(), b.end() );
+		}
+		t.union_borders.assign( ub.begin(), ub.end() );
+	}
+}
+
+// the non leaf nodes over node_budget(only those with 2 parts can be, see partition_fanout)
+void budget_report(){
+	int over = 0, inner = 0;
+	long long largest = 0;
+	for ( int tn = 0; tn < GTree.size(); tn++ ){
+		if ( GTree[tn].isleaf ) continue;
+		long long bytes = node_matrix_bytes( GTree[tn].union_borders.size() );
+		inner ++;
+		over += bytes > node_budget;
+		largest = max( largest, bytes );
+	}
+	printf("NODE BUDGET %lld BYTES: %d OF %d NON LEAF TREE NODES OVER, LARGEST %lld\n", node_budget, over, inner, largest );
+}
+
+void partition_report(){
+	vector< vector<int> > levels( 1, vector<int>( 1, 0 ) );
+	while( true ){
+		vector<int> next;
+		for ( int i = 0; i < levels.back().size(); i++ ){
+			const vector<int> &c = GTree[ levels.back()[i] ].children;
+			next.insert( next.end(), c.begin(), c.end() );
+		}
+		if ( next.empty() ) break;
+		levels.push_back( next );
+	}
+	vector<int> vertices( GTree.size(), 0 );
+	for ( int d = levels.size() - 1; d >= 0; d-- ){
+		for ( int i = 0; i < levels[d].size(); i++ ){
+			int tn = levels[d][i];
+			vertices[tn] = GTree[tn].leafnodes.size();
+			for ( int k = 0; ! GTree[tn].isleaf && k < GTree[tn].children.size(); k++ ) vertices[tn] += vertices[ GTree[tn].children[k] ];
+		}
+	}
+	long long total = 0;
+	for ( int d = 0; d < levels.size(); d++ ){
+		long long borders = 0, ub = 0, bytes = 0, size = 0;
+		int maxb = 0, maxub = 0, maxv = 0;
+		for ( int i = 0; i < levels[d].size(); i++ ){
+			TreeNode &t = GTree[ levels[d][i] ];
+			long long cands = t.isleaf ? t.leafnodes.size() : t.union_borders.size();
+			borders += t.borders.size();
+			ub += t.union_borders.size();
+			maxb = max( maxb, (int) t.borders.size() );
+			maxub = max( maxub, (int) t.union_borders.size() );
+			bytes += 2 * sizeof(int) * t.union_borders.size() * cands;
+			if ( directed && t.isleaf ) bytes += 2 * sizeof(int) * t.borders.size() * cands;
+			size += vertices[ levels[d][i] ];
+			maxv = max( maxv, vertices[ levels[d][i] ] );
+		}
+		total += bytes;
+		printf("LEVEL %d: TREE_NODES=%d BORDERS=%lld(MAX %d) UNION_BORDERS=%lld(MAX %d) MATRIX_BYTES=%lld BALANCE=%.3f\n",
+			d, (int) levels[d].size(), borders, maxb, ub, maxub, bytes, maxv * (double) levels[d].size() / max( size, 1LL ) );
+	}
+	printf("MATRIX_BYTES: %lld\n", total );
+}
+
+int main( int argc, char* argv[] ){
+	// options: -j N = build with N threads
+	//          -d = directed graph
+	//          -c file = customize for the weights in edge file, partition from the last build
+	//          -z = packed index matrices
+	//          -n name = data set name.cnode, name.cedge, output name.gtree ...(default cal)
+	//          -f N = fanout, -l N = leaf capacity(tau)
+	//          -s N = only write a sample of N vertices as data set name_sN, see sample_save
+	//          -S N = also write N shard files name.gidx.0ofN .. (see gtree_index.h), one per gtree_query -S s/N
+	//          -m MB = memory budget of the distance matrices, the rest spilled to disk(see MEMORY BUDGET)
+	//          -r = refine the METIS partitions for fewer borders(see partition_refine)
+	//          -B MB = matrix budget of one tree node, fanout per node up to -F N(default -f), see NODE BUDGET
+	//          -E = estimate: partition, print the matrix bytes per level and exit(see NODE BUDGET)
+	int sample = 0, shards = 0;
+	for ( int i = 1; i < argc; i++ ){
+		if ( strcmp( argv[i], "-j" ) == 0 && i + 1 < argc ){
+			build_threads = atoi( argv[++i] );
+			if ( build_threads < 1 ) build_threads = 1;
+		}
+		else if ( strcmp( argv[i], "-d" ) == 0 ) directed = true;
+		else if ( strcmp( argv[i], "-z" ) == 0 ) packed = true;
+		else if ( strcmp( argv[i], "-r" ) == 0 ) refine = true;
+		else if ( strcmp( argv[i], "-c" ) == 0 && i + 1 < argc ){
+			customize = true;
+			edge_file = argv[++i];
+		}
+		else if ( strcmp( argv[i], "-n" ) == 0 && i + 1 < argc ) dataset = argv[++i];
+		else if ( strcmp( argv[i], "-f" ) == 0 && i + 1 < argc ) partition_part = atoi( argv[++i] );
+		else if ( strcmp( argv[i], "-l" ) == 0 && i + 1 < argc ) leaf_cap = atoi( argv[++i] );
+		else if ( strcmp( argv[i], "-s" ) == 0 && i + 1 < argc ) sample = atoi( argv[++i] );
+		else if ( strcmp( argv[i], "-S" ) == 0 && i + 1 < argc ) shards = atoi( argv[++i] );
+		else if ( strcmp( argv[i], "-m" ) == 0 && i + 1 < argc ) mem_budget = atoll( argv[++i] ) << 20;
+		else if ( strcmp( argv[i], "-B" ) == 0 && i + 1 < argc ) node_budget = (long long)( atof( argv[++i] ) * ( 1 << 20 ) );
+		else if ( strcmp( argv[i], "-F" ) == 0 && i + 1 < argc ) fanout_max = atoi( argv[++i] );
+		else if ( strcmp( argv[i], "-E" ) == 0 ) estimate = true;
+	}
+	if ( partition_part < 2 || leaf_cap < partition_part ){
+		printf("FANOUT %d / LEAF CAP %d: NEED 2 <= FANOUT <= LEAF CAP\n", partition_part, leaf_cap );
+		exit(1);
+	}
+	files_init();
+	if ( edge_file == NULL ) edge_file = FILE_EDGE;
+
 	// init
 	TIME_TICK_START
 	init();
 	TIME_TICK_END
 	TIME_TICK_PRINT("INIT")
 
-	// gtree_build
-	TIME_TICK_START
-	build();
-	TIME_TICK_END
-	TIME_TICK_PRINT("BUILD")
+	if ( sample > 0 ){
+		char suffix[32];
+		sprintf( suffix, "_s%d", sample );
+		sample_save( sample, dataset + suffix );
+		return 0;
+	}
 
-	// dump gtree
-	gtree_save();
+	if ( customize ){
+		// partition is weight free, load it back
+		TIME_TICK_START
+		gtree_load();
+		if ( ! customize_check() ){
+			printf("%s DOES NOT FIT %s/%s, FULL BUILD NEEDED\n", edge_file, FILE_GTREE, FILE_NODES_GTREE_PATH );
+			exit(1);
+		}
+		TIME_TICK_END
+		TIME_TICK_PRINT("LOAD")
+	}
+	else{
+		// gtree_build
+		TIME_TICK_START
+		build();
+		TIME_TICK_END
+		TIME_TICK_PRINT("BUILD")
+
+		// dump gtree
+		if ( ! estimate ) gtree_save();
+	}
+	if ( estimate || node_budget > 0 ){
+		union_borders_init();
+		if ( node_budget > 0 ) budget_report();
+	}
+	if ( estimate ){
+		partition_report();
+		return 0;
+	}
 	
 	// calculate distance matrix
 	TIME_TICK_START
 	hierarchy_shortest_path_calculation();
 	TIME_TICK_END
 	TIME_TICK_PRINT("MIND")
+	partition_report();
 
 	// dump distance matrix
 	hierarchy_shortest_path_save();
 
+	// dump single file index
+	hierarchy_pos_init();
+	if ( ! gtree_index_write( GTree, Nodes, directed, packed, FILE_GTREE_INDEX, 0, 0, matrix_resident ) ){
+		printf("CANNOT WRITE %s\n", FILE_GTREE_INDEX );
+	}
+	if ( shards > 0 && GTree[0].isleaf ){
+		printf("THE ROOT IS A LEAF, NO SHARDS\n");
+		shards = 0;
+	}
+	for ( int s = 0; s < shards; s++ ){
+		string file = gtree_index_shard_file( FILE_GTREE_INDEX, s, shards );
+		if ( ! gtree_index_write( GTree, Nodes, directed, packed, file.c_str(), s, shards, matrix_resident ) ){
+			printf("CANNOT WRITE %s\n", file.c_str() );
+		}
+	}
+	if ( mem_budget > 0 ){
+		struct rusage ru;
+		getrusage( RUSAGE_SELF, &ru );
+		long long spilled = 0;
+		if ( spill_file != NULL && fseeko( spill_file, 0, SEEK_END ) == 0 ) spilled = ftello( spill_file );
+		printf("PEAK RSS: %ld KB, SPILLED: %lld BYTES\n", ru.ru_maxrss, spilled );
+	}
+
 	return 0;
 }
@@ -0,0 +1,653 @@
+// gtree index, single file binary format shared by gtree_build and gtree_query
+//
+// layout (all integers little-endian, every section starts on a 4096 bytes boundary):
+//	IndexHeader
+//	IndexSection[section_count]
+//	SECTION_TNODES    FrozenTreeNode[tree_size]
+//	SECTION_GTREEPATH long long[node_size + 1], offsets of each vertex gtreepath in pool
+//	SECTION_POOL      int[pool_size]
+//
+// the file is position independent: every variable length field of a tree node is
+// an (offset, count) pair into the pool, so gtree_query maps it read-only and uses it
+// in place, no parsing step. the same layout is used for the in-memory frozen index.
+//
+// besides the tree itself, every node carries its distance matrix pre-permuted for the
+// min-plus kernel(../common/minplus.h), so each inner loop of knn_query reads one contiguous row.
+// mind[a][b] is the distance from a to b(directed graphs are asymmetric), the kernel rows are the
+// targets of the propagation:
+//	non leaf: pmind[a][b] = distance from b to a, union_borders reordered as the children's borders one
+//	          child after another, child c occupies [up_off, up_off + nborders) of its father's order;
+//	          down_mind[u][k] = distance from own border k to union border u(child order);
+//	          pcurrent_pos = current_pos in child order.
+//	leaf:     pmind = mind transposed, nleafnodes * nborders, distance from border to leaf node;
+//	          rpmind = rmind transposed, distance from leaf node to border. directed graphs only,
+//	          otherwise rpmind is pmind.
+// packed = 1: pmind, down_mind and rpmind are stored packed(minplus_pack, lossless 16/24 bit offsets per chunk),
+// each as a table of segment offsets, rows * nseg ints from the array begin, then the segments. a segment is
+// the range of one kernel call: non leaf pmind rows have one per child(nseg = nchildren, child cpos at
+// up_off), the other rows are one segment(nseg = 1).
+// via(path of every mind entry, same layout as mind) is optional, has_via = 0 when the index was
+// compiled without it(legacy files lacking .via). rvia is the path of rmind.
+// shards = n > 0: a shard file of gtree_build -S n, the same layout and offsets as the full index, but the
+// matrices(mind, pmind, down_mind, pcurrent_pos, via, rpmind, rvia) of a tree node are there only if its root child(depth 1
+// ancestor) has cpos % n == shard, the others are holes in the file(read as zeros, no disk). the root, the tree
+// shape(borders, children, leafnodes, union_borders, up_pos, current_pos) and gtreepath are in every shard.
+#ifndef GTREE_INDEX_H
+#define GTREE_INDEX_H
+
+#include<stdio.h>
+#include<string.h>
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<vector>
+#include<string>
+#include "../common/minplus.h"
+
+#define GTREE_INDEX_MAGIC 0x58495447 // "GTIX"
+#define GTREE_INDEX_VERSION 6
+#define GTREE_INDEX_ENDIAN 0x01020304
+#define GTREE_INDEX_ALIGN 4096
+
+enum{
+	SECTION_TNODES = 0,
+	SECTION_GTREEPATH,
+	SECTION_POOL,
+	SECTION_COUNT
+};
+
+typedef struct{
+	int magic;
+	int version;
+	int endian; // GTREE_INDEX_ENDIAN as written by the builder
+	int section_count;
+	int tree_size; // |GTree|
+	int node_size; // |Nodes|
+	long long pool_size; // ints in pool
+	int directed; // 1 if edges have one direction(rmind & rvia of leaves present)
+	int packed; // 1 if the kernel matrices are packed
+	int shard; // this shard of shards, both 0 for a full index
+	int shards;
+}IndexHeader;
+
+typedef struct{
+	int id;
+	int reserved;
+	long long offset; // from file begin
+	long long bytes;
+}IndexSection;
+
+typedef struct{
+	int father;
+	int isleaf;
+	int nborders;
+	int nchildren;
+	int nleafnodes;
+	int nunion_borders;
+	int up_off; // first row of own borders in father's pmind, -1 for root
+	int has_via; // 1 if via is present
+	int cpos; // position in father's children(segment of packed pmind rows), -1 for root
+	int reserved;
+	long long borders;
+	long long children;
+	long long leafnodes;
+	long long union_borders;
+	long long mind; // leaf: nborders * nleafnodes, non leaf: nunion_borders * nunion_borders
+	long long up_pos; // nborders, position of borders in father's union_borders
+	long long current_pos; // nborders, position of borders in own union_borders
+	long long pmind; // leaf: nleafnodes * nborders, non leaf: nunion_borders * nunion_borders
+	long long down_mind; // non leaf: nunion_borders * nborders
+	long long pcurrent_pos; // non leaf: nborders
+	long long via; // same layout as mind, see dijkstra_candidate_via in gtree_build.cpp
+	long long rpmind; // leaf: nleafnodes * nborders
+	long long rvia; // directed leaf: nborders * nleafnodes, path of rmind
+}FrozenTreeNode;
+
+typedef struct{
+	int tree_size;
+	int node_size;
+	int directed;
+	int packed;
+	int shard; // see IndexHeader
+	int shards;
+	long long pool_size;
+	const FrozenTreeNode* tnodes; // [tree_size]
+	const long long* gtreepath; // [node_size + 1]
+	const int* pool;
+	// backing storage
+	char* blob; // heap blob, or NULL when mapped
+	void* map; // mapping, or NULL when on heap
+	size_t map_bytes; // length of the mapping(the index bytes, rounded up to the page size on huge pages)
+	size_t bytes; // index bytes in blob or map
+}FrozenGTree;
+
+// pages of a copy of the index(gtree_index_copy)
+#define GTREE_PAGES_SMALL 0
+#define GTREE_PAGES_THP 1 // anonymous mapping advised for transparent huge pages
+#define GTREE_PAGES_2MB 2 // MAP_HUGETLB, from the reserved pool(/proc/sys/vm/nr_hugepages)
+#define GTREE_PAGES_1GB 3
+
+inline long long gtree_index_align( long long pos ){
+	return ( pos + GTREE_INDEX_ALIGN - 1 ) / GTREE_INDEX_ALIGN * GTREE_INDEX_ALIGN;
+}
+
+// set up frozen tree pointers over a blob in index layout
+// return false on a malformed/incompatible blob
+inline bool gtree_index_attach( FrozenGTree &fg, char* base, size_t bytes ){
+	if ( bytes < sizeof(IndexHeader) ) return false;
+	const IndexHeader* header = (const IndexHeader*) base;
+	if ( header->magic != GTREE_INDEX_MAGIC ){
+		printf("GTREE INDEX: BAD MAGIC\n");
+		return false;
+	}
+	if ( header->version != GTREE_INDEX_VERSION ){
+		printf("GTREE INDEX: VERSION %d NOT SUPPORTED(EXPECT %d)\n", header->version, GTREE_INDEX_VERSION );
+		return false;
+	}
+	if ( header->endian != GTREE_INDEX_ENDIAN ){
+		printf("GTREE INDEX: ENDIANNESS MISMATCH\n");
+		return false;
+	}
+	const IndexSection* sections = (const IndexSection*) ( base + sizeof(IndexHeader) );
+	for ( int i = 0; i < header->section_count; i++ ){
+		if ( sections[i].offset + sections[i].bytes > (long long) bytes ){
+			printf("GTREE INDEX: TRUNCATED SECTION %d\n", sections[i].id );
+			return false;
+		}
+	}
+	fg.tree_size = header->tree_size;
+	fg.node_size = header->node_size;
+	fg.directed = header->directed;
+	fg.packed = header->packed;
+	fg.shard = header->shard;
+	fg.shards = header->shards;
+	fg.pool_size = header->pool_size;
+	for ( int i = 0; i < header->section_count; i++ ){
+		char* p = base + sections[i].offset;
+		switch ( sections[i].id ){
+			case SECTION_TNODES: fg.tnodes = (const FrozenTreeNode*) p; break;
+			case SECTION_GTREEPATH: fg.gtreepath = (const long long*) p; break;
+			case SECTION_POOL: fg.pool = (const int*) p; break;
+			default: break; // unknown sections are skipped, newer writers may add some
+		}
+	}
+	return true;
+}
+
+template<class TreeNodeVec>
+void gtree_index_minplus( TreeNodeVec &tree, int i, bool packed, std::vector<int> &pmind, std::vector<int> &down_mind, std::vector<int> &pcurrent_pos, std::vector<int> &rpmind );
+
+// sizes of the pre-permuted arrays of tree node i
+template<class TreeNodeVec>
+void gtree_index_minplus_size( TreeNodeVec &tree, int i, bool packed, long long &pmind, long long &down_mind, long long &pcurrent_pos, long long &rpmind ){
+	if ( packed ){
+		std::vector<int> pm, dm, pc, rpm;
+		gtree_index_minplus( tree, i, true, pm, dm, pc, rpm );
+		pmind = pm.size();
+		down_mind = dm.size();
+		pcurrent_pos = pc.size();
+		rpmind = rpm.size();
+		return;
+	}
+	long long nb = tree[i].borders.size();
+	rpmind = 0;
+	if ( tree[i].isleaf ){
+		pmind = (long long) tree[i].leafnodes.size() * nb;
+		rpmind = tree[i].rmind.size() > 0 ? pmind : 0;
+		down_mind = 0;
+		pcurrent_pos = 0;
+	}
+	else{
+		long long nub = tree[i].union_borders.size();
+		pmind = nub * nub;
+		down_mind = nub * nb;
+		pcurrent_pos = nb;
+	}
+}
+
+// pack a rows * stride matrix in place, cuts = first column of each segment of a row(see top of file)
+inline void gtree_index_pack( std::vector<int> &m, long long rows, int stride, const std::vector<int> &cuts ){
+	if ( m.size() == 0 ) return;
+	int nseg = cuts.size();
+	std::vector<int> out( rows * nseg, 0 );
+	for ( long long r = 0; r < rows; r++ ){
+		for ( int s = 0; s < nseg; s++ ){
+			int end = s + 1 < nseg ? cuts[s + 1] : stride;
+			out[ r * nseg + s ] = out.size();
+			minplus_pack( &m[ r * stride + cuts[s] ], end - cuts[s], out );
+		}
+	}
+	m.swap( out );
+}
+
+// build the pre-permuted arrays of tree node i(see top of file), packed if asked
+// needs up_pos of the children and current_pos of the node
+template<class TreeNodeVec>
+void gtree_index_minplus( TreeNodeVec &tree, int i, bool packed, std::vector<int> &pmind, std::vector<int> &down_mind, std::vector<int> &pcurrent_pos, std::vector<int> &rpmind ){
+	std::vector<int> whole( 1, 0 );
+	int nb = tree[i].borders.size();
+	pmind.clear();
+	down_mind.clear();
+	pcurrent_pos.clear();
+	rpmind.clear();
+	if ( tree[i].isleaf ){
+		int nl = tree[i].leafnodes.size();
+		pmind.resize( (long long) nl * nb );
+		for ( int j = 0; j < nb; j++ ){
+			for ( int k = 0; k < nl; k++ ){
+				pmind[ (long long) k * nb + j ] = tree[i].mind[ (long long) j * nl + k ];
+			}
+		}
+		if ( tree[i].rmind.size() > 0 ){
+			rpmind.resize( (long long) nl * nb );
+			for ( int j = 0; j < nb; j++ ){
+				for ( int k = 0; k < nl; k++ ){
+					rpmind[ (long long) k * nb + j ] = tree[i].rmind[ (long long) j * nl + k ];
+				}
+			}
+		}
+		if ( packed ){
+			gtree_index_pack( pmind, nl, nb, whole );
+			gtree_index_pack( rpmind, nl, nb, whole );
+		}
+		return;
+	}
+
+	// order[u] = union_borders position of the u-th border in child order
+	int nub = tree[i].union_borders.size();
+	std::vector<int> order, inv( nub, -1 );
+	for ( int c = 0; c < tree[i].children.size(); c++ ){
+		int cid = tree[i].children[c];
+		for ( int k = 0; k < tree[cid].up_pos.size(); k++ ){
+			inv[ tree[cid].up_pos[k] ] = order.size();
+			order.push_back( tree[cid].up_pos[k] );
+		}
+	}
+	pmind.resize( (long long) nub * nub );
+	for ( int a = 0; a < nub; a++ ){
+		for ( int b = 0; b < nub; b++ ){
+			pmind[ (long long) a * nub + b ] = tree[i].mind[ (long long) order[b] * nub + order[a] ];
+		}
+	}
+	down_mind.resize( (long long) nub * nb );
+	for ( int u = 0; u < nub; u++ ){
+		for ( int k = 0; k < nb; k++ ){
+			down_mind[ (long long) u * nb + k ] = tree[i].mind[ (long long) tree[i].current_pos[k] * nub + order[u] ];
+		}
+	}
+	for ( int k = 0; k < nb; k++ ){
+		pcurrent_pos.push_back( inv[ tree[i].current_pos[k] ] );
+	}
+	if ( packed ){
+		std::vector<int> cuts;
+		for ( int c = 0, off = 0; c < tree[i].children.size(); c++ ){
+			cuts.push_back( off );
+			off += tree[ tree[i].children[c] ].borders.size();
+		}
+		gtree_index_pack( pmind, nub, nub, cuts );
+		gtree_index_pack( down_mind, nub, nb, whole );
+	}
+}
+
+// the matrices(mind, via, rmind, rvia) of every tree node are in memory
+// a builder that keeps them elsewhere passes its own: resident( i, true ) before the matrices of tree node i
+// are read, resident( i, false ) after, so only one tree node's matrices need to be in memory at a time
+struct GTreeIndexResident{
+	void operator()( int tn, bool in ) const {}
+};
+
+// compute blob size & section table for a given tree
+template<class TreeNodeVec, class NodeVec, class Resident>
+long long gtree_index_layout( TreeNodeVec &tree, NodeVec &nodes, bool directed, bool packed, IndexHeader &header, IndexSection* sections, Resident &resident ){
+	long long pool_size = 0;
+	long long pm, dm, pc, rpm;
+	for ( int i = 0; i < tree.size(); i++ ){
+		resident( i, true );
+		gtree_index_minplus_size( tree, i, packed, pm, dm, pc, rpm );
+		pool_size += tree[i].borders.size() + tree[i].children.size() + tree[i].leafnodes.size()
+			+ tree[i].union_borders.size() + tree[i].mind.size() + tree[i].up_pos.size()
+			+ tree[i].current_pos.size() + pm + dm + pc + tree[i].via.size() + rpm + tree[i].rvia.size();
+		resident( i, false );
+	}
+	for ( int i = 0; i < nodes.size(); i++ ){
+		pool_size += nodes[i].gtreepath.size();
+	}
+
+	header.magic = GTREE_INDEX_MAGIC;
+	header.version = GTREE_INDEX_VERSION;
+	header.endian = GTREE_INDEX_ENDIAN;
+	header.section_count = SECTION_COUNT;
+	header.tree_size = tree.size();
+	header.node_size = nodes.size();
+	header.pool_size = pool_size;
+	header.directed = directed ? 1 : 0;
+	header.packed = packed ? 1 : 0;
+	header.shard = 0;
+	header.shards = 0;
+
+	long long pos = gtree_index_align( sizeof(IndexHeader) + sizeof(IndexSection) * SECTION_COUNT );
+	long long bytes[SECTION_COUNT] = {
+		(long long) sizeof(FrozenTreeNode) * (long long) tree.size(),
+		(long long) sizeof(long long) * (long long)( nodes.size() + 1 ),
+		(long long) sizeof(int) * pool_size };
+	for ( int i = 0; i < SECTION_COUNT; i++ ){
+		sections[i].id = i;
+		sections[i].reserved = 0;
+		sections[i].offset = pos;
+		sections[i].bytes = bytes[i];
+		pos = gtree_index_align( pos + bytes[i] );
+	}
+	return pos;
+}
+
+template<class TreeNodeVec, class NodeVec>
+long long gtree_index_layout( TreeNodeVec &tree, NodeVec &nodes, bool directed, bool packed, IndexHeader &header, IndexSection* sections ){
+	GTreeIndexResident resident;
+	return gtree_index_layout( tree, nodes, directed, packed, header, sections, resident );
+}
+
+// append one vector to pool, return its offset
+template<class V>
+long long gtree_index_append( int* pool, long long &pos, V &v ){
+	long long off = pos;
+	if ( v.size() > 0 ){
+		memcpy( pool + pos, &v[0], sizeof(int) * v.size() );
+	}
+	pos += v.size();
+	return off;
+}
+
+// fill tree node headers & gtreepath offsets, pool offsets follow the append order
+// borders, children, leafnodes, union_borders, mind, up_pos, current_pos, pmind, down_mind, pcurrent_pos, via,
+// rpmind, rvia per tree node, then gtreepath per vertex
+template<class TreeNodeVec, class NodeVec, class Resident>
+void gtree_index_headers( TreeNodeVec &tree, NodeVec &nodes, bool packed, FrozenTreeNode* tnodes, long long* gtreepath, Resident &resident ){
+	long long pos = 0;
+	long long pm, dm, pc, rpm;
+	for ( int i = 0; i < tree.size(); i++ ){
+		tnodes[i].up_off = -1;
+		tnodes[i].cpos = -1;
+		tnodes[i].reserved = 0;
+	}
+	for ( int i = 0; i < tree.size(); i++ ){
+		int off = 0;
+		for ( int c = 0; c < tree[i].children.size(); c++ ){
+			tnodes[ tree[i].children[c] ].cpos = c;
+			tnodes[ tree[i].children[c] ].up_off = off;
+			off += tree[ tree[i].children[c] ].borders.size();
+		}
+	}
+	for ( int i = 0; i < tree.size(); i++ ){
+		resident( i, true );
+		FrozenTreeNode &fn = tnodes[i];
+		fn.father = tree[i].father;
+		fn.isleaf = tree[i].isleaf ? 1 : 0;
+		fn.nborders = tree[i].borders.size();
+		fn.nchildren = tree[i].children.size();
+		fn.nleafnodes = tree[i].leafnodes.size();
+		fn.nunion_borders = tree[i].union_borders.size();
+		fn.has_via = tree[i].via.size() > 0 ? 1 : 0;
+		fn.borders = pos; pos += tree[i].borders.size();
+		fn.children = pos; pos += tree[i].children.size();
+		fn.leafnodes = pos; pos += tree[i].leafnodes.size();
+		fn.union_borders = pos; pos += tree[i].union_borders.size();
+		fn.mind = pos; pos += tree[i].mind.size();
+		fn.up_pos = pos; pos += tree[i].up_pos.size();
+		fn.current_pos = pos; pos += tree[i].current_pos.size();
+		gtree_index_minplus_size( tree, i, packed, pm, dm, pc, rpm );
+		fn.pmind = pos; pos += pm;
+		fn.down_mind = pos; pos += dm;
+		fn.pcurrent_pos = pos; pos += pc;
+		fn.via = pos; pos += tree[i].via.size();
+		fn.rpmind = rpm > 0 ? pos : fn.pmind; pos += rpm;
+		fn.rvia = pos; pos += tree[i].rvia.size();
+		resident( i, false );
+	}
+	for ( int i = 0; i < nodes.size(); i++ ){
+		gtreepath[i] = pos;
+		pos += nodes[i].gtreepath.size();
+	}
+	gtreepath[nodes.size()] = pos;
+}
+
+template<class TreeNodeVec, class NodeVec>
+void gtree_index_headers( TreeNodeVec &tree, NodeVec &nodes, bool packed, FrozenTreeNode* tnodes, long long* gtreepath ){
+	GTreeIndexResident resident;
+	gtree_index_headers( tree, nodes, packed, tnodes, gtreepath, resident );
+}
+
+// compile tree & per-vertex gtreepath into a heap blob in index layout
+// tree must already have union_borders, mind, up_pos and current_pos, via and rmind/rvia may be empty
+template<class TreeNodeVec, class NodeVec>
+char* gtree_index_compile( TreeNodeVec &tree, NodeVec &nodes, bool directed, bool packed, long long &blob_bytes ){
+	IndexHeader header;
+	IndexSection sections[SECTION_COUNT];
+	blob_bytes = gtree_index_layout( tree, nodes, directed, packed, header, sections );
+
+	char* blob = new char[blob_bytes];
+	memset( blob, 0, blob_bytes );
+	memcpy( blob, &header, sizeof(IndexHeader) );
+	memcpy( blob + sizeof(IndexHeader), sections, sizeof(IndexSection) * SECTION_COUNT );
+
+	FrozenTreeNode* tnodes = (FrozenTreeNode*) ( blob + sections[SECTION_TNODES].offset );
+	long long* gtreepath = (long long*) ( blob + sections[SECTION_GTREEPATH].offset );
+	int* pool = (int*) ( blob + sections[SECTION_POOL].offset );
+	gtree_index_headers( tree, nodes, packed, tnodes, gtreepath );
+
+	long long pos = 0;
+	std::vector<int> pmind, down_mind, pcurrent_pos, rpmind;
+	for ( int i = 0; i < tree.size(); i++ ){
+		gtree_index_minplus( tree, i, packed, pmind, down_mind, pcurrent_pos, rpmind );
+		gtree_index_append( pool, pos, tree[i].borders );
+		gtree_index_append( pool, pos, tree[i].children );
+		gtree_index_append( pool, pos, tree[i].leafnodes );
+		gtree_index_append( pool, pos, tree[i].union_borders );
+		gtree_index_append( pool, pos, tree[i].mind );
+		gtree_index_append( pool, pos, tree[i].up_pos );
+		gtree_index_append( pool, pos, tree[i].current_pos );
+		gtree_index_append( pool, pos, pmind );
+		gtree_index_append( pool, pos, down_mind );
+		gtree_index_append( pool, pos, pcurrent_pos );
+		gtree_index_append( pool, pos, tree[i].via );
+		gtree_index_append( pool, pos, rpmind );
+		gtree_index_append( pool, pos, tree[i].rvia );
+	}
+	for ( int i = 0; i < nodes.size(); i++ ){
+		gtree_index_append( pool, pos, nodes[i].gtreepath );
+	}
+
+	return blob;
+}
+
+// write a vector as int32 array
+template<class V>
+void gtree_index_fwrite( FILE* fout, V &v ){
+	if ( v.size() > 0 ){
+		fwrite( &v[0], sizeof(int), v.size(), fout );
+	}
+}
+
+// zero pad fout up to pos
+inline void gtree_index_pad( FILE* fout, long long pos ){
+	static const char zero[GTREE_INDEX_ALIGN] = { 0 };
+	long long cur = ftello( fout );
+	if ( pos > cur ){
+		fwrite( zero, 1, pos - cur, fout );
+	}
+}
+
+// true if tree node tn is in shard of shards(see IndexHeader), the root is in all
+template<class TreeNodeVec>
+bool gtree_index_in_shard( TreeNodeVec &tree, const FrozenTreeNode* tnodes, int tn, int shard, int shards ){
+	if ( shards == 0 || tree[tn].father < 0 ) return true;
+	while( tree[ tree[tn].father ].father >= 0 ) tn = tree[tn].father;
+	return tnodes[tn].cpos % shards == shard;
+}
+
+// file of shard of shards next to the full index file, "cal.gidx" -> "cal.gidx.1of4"
+inline std::string gtree_index_shard_file( const char* file, int shard, int shards ){
+	char suffix[32];
+	snprintf( suffix, sizeof(suffix), ".%dof%d", shard, shards );
+	return std::string( file ) + suffix;
+}
+
+// stream tree & per-vertex gtreepath to an index file, no intermediate blob
+// shards > 0: shard file shard of shards, the matrices of the other tree nodes are skipped(holes)
+template<class TreeNodeVec, class NodeVec, class Resident>
+bool gtree_index_write( TreeNodeVec &tree, NodeVec &nodes, bool directed, bool packed, const char* file, int shard, int shards, Resident &resident ){
+	IndexHeader header;
+	IndexSection sections[SECTION_COUNT];
+	long long bytes = gtree_index_layout( tree, nodes, directed, packed, header, sections, resident );
+	header.shard = shard;
+	header.shards = shards;
+
+	// written aside then renamed, a gtree_query mapping the old file keeps it intact(index_reload)
+	std::string tmp = std::string( file ) + ".tmp";
+	FILE* fout = fopen( tmp.c_str(), "wb" );
+	if ( fout == NULL ) return false;
+	fwrite( &header, sizeof(IndexHeader), 1, fout );
+	fwrite( sections, sizeof(IndexSection), SECTION_COUNT, fout );
+
+	std::vector<FrozenTreeNode> tnodes( tree.size() );
+	std::vector<long long> gtreepath( nodes.size() + 1 );
+	gtree_index_headers( tree, nodes, packed, tnodes.size() > 0 ? &tnodes[0] : NULL, &gtreepath[0], resident );
+
+	gtree_index_pad( fout, sections[SECTION_TNODES].offset );
+	if ( tnodes.size() > 0 ){
+		fwrite( &tnodes[0], sizeof(FrozenTreeNode), tnodes.size(), fout );
+	}
+	gtree_index_pad( fout, sections[SECTION_GTREEPATH].offset );
+	fwrite( &gtreepath[0], sizeof(long long), gtreepath.size(), fout );
+	gtree_index_pad( fout, sections[SECTION_POOL].offset );
+	std::vector<int> pmind, down_mind, pcurrent_pos, rpmind;
+	for ( int i = 0; i < tree.size(); i++ ){
+		if ( ! gtree_index_in_shard( tree, &tnodes[0], i, shard, shards ) ){
+			const FrozenTreeNode &fn = tnodes[i];
+			gtree_index_fwrite( fout, tree[i].borders );
+			gtree_index_fwrite( fout, tree[i].children );
+			gtree_index_fwrite( fout, tree[i].leafnodes );
+			gtree_index_fwrite( fout, tree[i].union_borders );
+			fseeko( fout, sections[SECTION_POOL].offset + fn.up_pos * (long long) sizeof(int), SEEK_SET );
+			gtree_index_fwrite( fout, tree[i].up_pos );
+			gtree_index_fwrite( fout, tree[i].current_pos );
+			long long next = i + 1 < tree.size() ? tnodes[i+1].borders : gtreepath[0];
+			fseeko( fout, sections[SECTION_POOL].offset + next * (long long) sizeof(int), SEEK_SET );
+			continue;
+		}
+		resident( i, true );
+		gtree_index_minplus( tree, i, packed, pmind, down_mind, pcurrent_pos, rpmind );
+		gtree_index_fwrite( fout, tree[i].borders );
+		gtree_index_fwrite( fout, tree[i].children );
+		gtree_index_fwrite( fout, tree[i].leafnodes );
+		gtree_index_fwrite( fout, tree[i].union_borders );
+		gtree_index_fwrite( fout, tree[i].mind );
+		gtree_index_fwrite( fout, tree[i].up_pos );
+		gtree_index_fwrite( fout, tree[i].current_pos );
+		gtree_index_fwrite( fout, pmind );
+		gtree_index_fwrite( fout, down_mind );
+		gtree_index_fwrite( fout, pcurrent_pos );
+		gtree_index_fwrite( fout, tree[i].via );
+		gtree_index_fwrite( fout, rpmind );
+		gtree_index_fwrite( fout, tree[i].rvia );
+		resident( i, false );
+	}
+	for ( int i = 0; i < nodes.size(); i++ ){
+		gtree_index_fwrite( fout, nodes[i].gtreepath );
+	}
+	gtree_index_pad( fout, bytes );
+	if ( fclose(fout) != 0 || rename( tmp.c_str(), file ) != 0 ){
+		remove( tmp.c_str() );
+		return false;
+	}
+	return true;
+}
+
+template<class TreeNodeVec, class NodeVec>
+bool gtree_index_write( TreeNodeVec &tree, NodeVec &nodes, bool directed, bool packed, const char* file, int shard = 0, int shards = 0 ){
+	GTreeIndexResident resident;
+	return gtree_index_write( tree, nodes, directed, packed, file, shard, shards, resident );
+}
+
+// map an index file read-only
+inline bool gtree_index_mmap( FrozenGTree &fg, const char* file ){
+	int fd = open( file, O_RDONLY );
+	if ( fd < 0 ) return false;
+	struct stat st;
+	if ( fstat( fd, &st ) != 0 ){
+		close(fd);
+		return false;
+	}
+	void* map = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+	close(fd);
+	if ( map == MAP_FAILED ) return false;
+	if ( ! gtree_index_attach( fg, (char*) map, st.st_size ) ){
+		munmap( map, st.st_size );
+		return false;
+	}
+	fg.blob = NULL;
+	fg.map = map;
+	fg.map_bytes = st.st_size;
+	fg.bytes = st.st_size;
+	return true;
+}
+
+// copy the index of src into a private read-only mapping of fg on pages as asked(GTREE_PAGES_*): MAP_HUGETLB
+// falls back to THP when the pool has no room. the pages are placed on the NUMA node of the calling thread
+// (first touch). returns the pages used, -1 on failure(fg untouched)
+inline int gtree_index_copy( FrozenGTree &fg, const FrozenGTree &src, int pages ){
+	const char* base = src.map != NULL ? (const char*) src.map : src.blob;
+	size_t len = src.bytes;
+	void* map = MAP_FAILED;
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+	if ( pages == GTREE_PAGES_2MB || pages == GTREE_PAGES_1GB ){
+		int shift = pages == GTREE_PAGES_1GB ? 30 : 21;
+		len = ( src.bytes + ( (size_t) 1 << shift ) - 1 ) >> shift << shift;
+		map = mmap( NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | ( shift << MAP_HUGE_SHIFT ), -1, 0 );
+	}
+#endif
+	if ( map == MAP_FAILED && pages != GTREE_PAGES_SMALL ) pages = GTREE_PAGES_THP;
+	if ( map == MAP_FAILED ){
+		len = src.bytes;
+		map = mmap( NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+		if ( map == MAP_FAILED ) return -1;
+#ifdef MADV_HUGEPAGE
+		if ( pages == GTREE_PAGES_THP ) madvise( map, len, MADV_HUGEPAGE );
+#endif
+	}
+	memcpy( map, base, src.bytes );
+	mprotect( map, len, PROT_READ );
+	if ( ! gtree_index_attach( fg, (char*) map, src.bytes ) ){
+		munmap( map, len );
+		return -1;
+	}
+	fg.blob = NULL;
+	fg.map = map;
+	fg.map_bytes = len;
+	fg.bytes = src.bytes;
+	return pages;
+}
+
+// end(pool ints) of the arrays of tree node i: the nodes are appended one after another, then the gtreepaths,
+// so node i spans pool[ tnodes[i].borders, gtree_index_node_end(i) )
+inline long long gtree_index_node_end( const FrozenGTree &fg, int i ){
+	return i + 1 < fg.tree_size ? fg.tnodes[i + 1].borders : fg.gtreepath[0];
+}
+
+// read one int per page of pool[from, to), on a mapped file the pages are resident after(page cache)
+inline long long gtree_index_touch( const FrozenGTree &fg, long long from, long long to ){
+	const long long step = GTREE_INDEX_ALIGN / sizeof(int);
+	long long sum = 0;
+	for ( long long i = from; i < to; i += step ) sum += fg.pool[i];
+	if ( to > from ) sum += fg.pool[to - 1];
+	return sum;
+}
+
+inline void gtree_index_release( FrozenGTree &fg ){
+	if ( fg.map != NULL ) munmap( fg.map, fg.map_bytes );
+	if ( fg.blob != NULL ) delete[] fg.blob;
+	fg.map = NULL;
+	fg.blob = NULL;
+}
+
+#endif
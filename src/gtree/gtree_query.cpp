@@ -8,11 +8,33 @@
 #include<memory.h>
 #include<unordered_map>
 #include<map>
+#include<list>
 #include<set>
 #include<deque>
 #include<stack>
 #include<algorithm>
 #include<sys/time.h>
+#include<pthread.h>
+#include<signal.h>
+#include<errno.h>
+#include<unistd.h>
+#include<sys/socket.h>
+#include<sys/un.h>
+#include<netinet/in.h>
+#include<netinet/tcp.h>
+#include<arpa/inet.h>
+#include<thread>
+#include<atomic>
+#include<mutex>
+#include<new>
+#include<memory>
+#include "gtree_index.h"
+#include "../common/dheap.h"
+#include "../common/minplus.h"
+#include "../common/task_pool.h"
+#include "../common/graph_csr.h"
+#include "../common/query_stats.h"
+#include "../common/numa.h"
 using namespace std;
 
 // MACRO for timing
@@ -23,8 +45,32 @@ long long ts, te;
 #define TIME_TICK_PRINT(T) printf("%s RESULT: %lld (0.01MS)\r\n", (#T), te - ts );
 // ----------
 
-#define FILE_NODE "cal.cnode"
-#define FILE_EDGE "cal.cedge"
+// heap allocation counter(per thread), used to check steady state queries do not allocate; only in a build with
+// -DALLOC_COUNT(make gtree_query_allocs), the allocations of each knn query then go to the -s stats("heap_allocations")
+#ifdef ALLOC_COUNT
+thread_local long long alloc_count = 0;
+void* operator new( size_t size ){
+	alloc_count ++;
+	void* p = malloc( size ? size : 1 );
+	if ( p == NULL ) throw bad_alloc();
+	return p;
+}
+void operator delete( void* p ) noexcept{
+	free( p );
+}
+#define ALLOC_NOW alloc_count
+#define STATS_COUNTERS QC_COUNTERS
+#else
+#define ALLOC_NOW 0LL
+#define STATS_COUNTERS QC_ALLOCS // no heap_allocations in the stats without the counter
+#endif
+// ----------
+
+// data set files, <dataset>.cnode, <dataset>.cedge ...(files_init), dataset = -n name
+string dataset = "cal";
+string file_node, file_edge, file_paths, file_gtree, file_minds, file_via, file_gidx, file_object;
+#define FILE_NODE file_node.c_str()
+#define FILE_EDGE file_edge.c_str()
 // set all edge weight to 1(unweighted graph)
 #define ADJWEIGHT_SET_TO_ALL_ONE true
 // we assume edge weight is integer, thus (input edge) * WEIGHT_INFLATE_FACTOR = (our edge weight)
@@ -33,17 +79,32 @@ long long ts, te;
 #define PARTITION_PART 4
 // gtree leaf node capacity = tau(in paper)
 #define LEAF_CAP 32
+
+#define LEAF_STREAM_MIN 16 // objects of a leaf from which it keeps per border sorted lists(leafsorted)
+
+#define RKNN_KMAX 16 // nearest objects kept per border for rknn_query(BorderKnn), a larger K prunes nothing
 // gtree index disk storage
-#define FILE_NODES_GTREE_PATH "cal.paths"
-#define FILE_GTREE 			  "cal.gtree"
-#define FILE_ONTREE_MIND	  "cal.minds"
+#define FILE_NODES_GTREE_PATH file_paths.c_str()
+#define FILE_GTREE 			  file_gtree.c_str()
+#define FILE_ONTREE_MIND	  file_minds.c_str()
+#define FILE_ONTREE_VIA		  file_via.c_str()
+#define FILE_GTREE_INDEX	  file_gidx.c_str()
 // input
-#define FILE_OBJECT "cal.object"
+#define FILE_OBJECT file_object.c_str()
+
+void files_init(){
+	file_node = dataset + ".cnode";
+	file_edge = dataset + ".cedge";
+	file_paths = dataset + ".paths";
+	file_gtree = dataset + ".gtree";
+	file_minds = dataset + ".minds";
+	file_via = dataset + ".via";
+	file_gidx = dataset + ".gidx";
+	file_object = dataset + ".object";
+}
 
 typedef struct{
 	double x,y;
-	vector<int> adjnodes;
-	vector<int> adjweight;
 	bool isborder;
 	vector<int> gtreepath; // this is used to do sub-graph locating
 }Node;
@@ -57,6 +118,9 @@ typedef struct{
 // ----- min dis -----
 	vector<int> union_borders; // for non leaf node	
 	vector<int> mind; // min dis, row by row of union_borders
+	vector<int> via; // shortest path of each mind entry, same layout(see gtree_build.cpp)
+	vector<int> rmind; // directed leaf only, never in the legacy files(see gtree_index.h)
+	vector<int> rvia;
 // ----- for pre query init, OCCURENCE LIST in paper -----
 	vector<int> nonleafinvlist;
 	vector<int> leafinvlist;
@@ -66,6 +130,8 @@ typedef struct{
 
 int noe; // number of edges
 vector<Node> Nodes;
+CsrGraph Graph; // adjacency of Nodes(see ../common/graph_csr.h), moved into the first IndexSnapshot
+bool directed = false; // -d: one direction per edge line, the index must be built with -d too
 vector<TreeNode> GTree;
 
 // use for metis
@@ -100,40 +166,21 @@ void options_setting(){
 	// options[METIS_OPTION_DBGLVL] = 0;
 }
 
-// input init
+// input init, graph into Graph(text parsed on all cores, binary cache FILE_EDGE.csr after the first run)
 void init_input(){
-	FILE *fin;
-
-	// load node
-	printf("LOADING NODE...");
-	fin = fopen(FILE_NODE,"r");
-	int nid;
-	double x,y;
-	while( fscanf(fin, "%d %lf %lf", &nid, &x, &y ) == 3 ){
-		Node node = { x, y };
-		Nodes.push_back(node);
+	printf("LOADING GRAPH...");
+	bool cached;
+	if ( ! csr_load( Graph, FILE_NODE, FILE_EDGE, WEIGHT_INFLATE_FACTOR, thread::hardware_concurrency(), directed, cached ) ){
+		exit(1);
 	}
-	fclose(fin);
-	printf("COMPLETE. NODE_COUNT=%d\n", (int)Nodes.size());
-
-	// load edge
-	printf("LOADING EDGE...");
-	fin = fopen(FILE_EDGE, "r");
-	int eid;
-	int snid, enid;
-	double weight;
-	int iweight;
-	noe = 0;
-	while( fscanf(fin,"%d %d %d %lf", &eid, &snid, &enid, &weight ) == 4 ){
-		noe ++;
-		iweight = (int) (weight * WEIGHT_INFLATE_FACTOR );
-		Nodes[snid].adjnodes.push_back( enid );
-		Nodes[snid].adjweight.push_back( iweight );
-		Nodes[enid].adjnodes.push_back( snid );
-		Nodes[enid].adjweight.push_back( iweight );
+	Nodes.resize( Graph.n );
+	for ( int i = 0; i < Graph.n; i++ ){
+		Nodes[i].x = Graph.x[i];
+		Nodes[i].y = Graph.y[i];
+		Nodes[i].isborder = false;
 	}
-	fclose(fin);
-	printf("COMPLETE.\n");
+	noe = Graph.m;
+	printf("COMPLETE%s. NODE_COUNT=%d EDGE_COUNT=%d\n", cached ? "(CACHED)" : "", (int)Nodes.size(), noe );
 }
 
 void init(){
@@ -210,77 +257,57 @@ void gtree_load(){
 }
 
 // dijkstra search, used for single-source shortest path search WITHIN one gtree leaf node!
-// input: s = source node
+// 4-ary heap over dense stamp cleared arrays(see ../common/dheap.h), stops once all cands are settled
+// input: h = scratch heap, sized to graph
+//        s = source node
 //        cands = candidate node list
-//        graph = search graph(this can be set to subgraph)
-vector<int> dijkstra_candidate( int s, vector<int> &cands, vector<Node> &graph ){
+//        graph = search graph
+//        pred = if not NULL, pred[v] = vertex before v on its path, for every settled v
+//        src = if not empty, the sources(vertex, distance) instead of s at 0
+// output: output[i] = shortest path of cands[i], 0 if not reachable
+void dijkstra_candidate( DHeap &h, int s, const int* cands, int ncands, const CsrGraph &graph, int* output, int* pred = NULL, const vector< pair<int,int> >* src = NULL ){
 	// init
-	set<int> todo;
-	todo.clear();
-	todo.insert(cands.begin(), cands.end());
-	
-	unordered_map<int,int> result;
-	result.clear();
-	set<int> visited;
-	visited.clear();
-	unordered_map<int,int> q;
-	q.clear();
-	q[s] = 0;
-
-	// start
-	int min, minpos, adjnode, weight;
-	while( ! todo.empty() && ! q.empty() ){
-		min = -1;
-		for ( unordered_map<int,int>::iterator it = q.begin(); it != q.end(); it ++ ){
-			if ( min == -1 ){
-				minpos = it -> first;
-				min = it -> second;
-			}
-			else{
-				if ( it -> second < min ){
-					min = it -> second;
-					minpos = it -> first;
-				}
-			}
+	dheap_reset( h );
+	int todo = 0;
+	for ( int i = 0; i < ncands; i++ ){
+		if ( ! dheap_tagged( h, cands[i] ) ){
+			dheap_tag( h, cands[i] );
+			todo ++;
 		}
+	}
+	if ( src != NULL && src->size() > 0 ){
+		for ( int i = 0; i < src->size(); i++ ) dheap_push( h, (*src)[i].first, (*src)[i].second );
+	}
+	else dheap_push( h, s, 0 );
 
-		// put min to result, add to visited
-		result[minpos] = min;
-		visited.insert( minpos );
-		q.erase(minpos);
-
-		if ( todo.find( minpos ) != todo.end() ){
-			todo.erase( minpos );
+	// start
+	int min, minpos;
+	while( todo > 0 && h.size > 0 ){
+		// settle min
+		minpos = dheap_pop( h );
+		min = h.key[minpos];
+		if ( dheap_tagged( h, minpos ) ){
+			dheap_untag( h, minpos );
+			todo --;
 		}
 
-		// expand
-		for ( int i = 0; i < graph[minpos].adjnodes.size(); i++ ){
-			adjnode = graph[minpos].adjnodes[i];
-			if ( visited.find( adjnode ) != visited.end() ){
-				continue;
-			}
-			weight = graph[minpos].adjweight[i];
-
-			if ( q.find(adjnode) != q.end() ){
-				if ( min + weight < q[adjnode] ){
-					q[adjnode] = min + weight;
-				}
-			}
-			else{
-				q[adjnode] = min + weight;
+		// expand, settled nodes are skipped by dheap_push
+		const int* adjnodes = &graph.target[0] + graph.offset[minpos];
+		const int* adjweight = &graph.weight[0] + graph.offset[minpos];
+		int degree = CSR_DEGREE(graph, minpos);
+		for ( int i = 0; i < degree; i++ ){
+			if ( pred != NULL && ( ! dheap_touched( h, adjnodes[i] )
+				|| ( ! dheap_settled( h, adjnodes[i] ) && min + adjweight[i] < h.key[adjnodes[i]] ) ) ){
+				pred[adjnodes[i]] = minpos;
 			}
-		
+			dheap_push( h, adjnodes[i], min + adjweight[i] );
 		}
 	}
 
 	// output
-	vector<int> output;
-	for ( int i = 0; i < cands.size(); i++ ){
-		output.push_back( result[cands[i]] );
+	for ( int i = 0; i < ncands; i++ ){
+		output[i] = dheap_settled( h, cands[i] ) ? h.key[cands[i]] : ( directed ? MINPLUS_INF : 0 );
 	}
-
-	// return
-	return output;
 }
 
 // load distance matrix from file
@@ -309,49 +336,25 @@ void hierarchy_shortest_path_load(){
 		delete[] buf;
 	}
 	fclose(fin);
-}
-
-// before query, we have to set OCCURENCE LIST etc.
-// this is done only ONCE for a given set of objects.
-void pre_query(){
-	// first clear all
-	for ( int i = 0; i < GTree.size(); i++ ){
-		GTree[i].nonleafinvlist.clear();
-		GTree[i].leafinvlist.clear();
-	}
-	
-	// read object list
-	vector<int> o;
-	o.clear();
-
-	char file_object[100];
-	sprintf( file_object, "%s", FILE_OBJECT );
-	FILE *fin = fopen( file_object, "r" );
-	int oid, id;
-	while( fscanf( fin, "%d %d", &oid, &id ) == 2 ){
-		o.push_back(oid);
-	}
-	fclose(fin);
 
-	// set OCCURENCE LIST
-	for ( int i = 0; i < o.size(); i++ ){
-		int current = Nodes[o[i]].gtreepath.back();
-		// add leaf inv list
-		int pos = lower_bound( GTree[current].leafnodes.begin(), GTree[current].leafnodes.end(), o[i] ) - GTree[current].leafnodes.begin();
-		GTree[current].leafinvlist.push_back(pos);		
-		// recursive
-		int child;
-		while( current != -1 ){
-			child = current;
-			current = GTree[current].father;
-			if ( current == -1 ) break;
-			if ( find(GTree[current].nonleafinvlist.begin(), GTree[current].nonleafinvlist.end(), child ) == GTree[current].nonleafinvlist.end() ){
-				GTree[current].nonleafinvlist.push_back(child);
-			}
+	// paths of mind, optional(knn_query_with_paths)
+	fin = fopen( FILE_ONTREE_VIA, "rb" );
+	if ( fin == NULL ) return;
+	pos = 0;
+	while( pos < GTree.size() && fread( &count, sizeof(int), 1, fin ) ){
+		GTree[pos].via.resize( count );
+		if ( count > 0 ){
+			fread( &GTree[pos].via[0], sizeof(int), count, fin );
 		}
+		pos++;
 	}
+	fclose(fin);
+}
 
-	// up_pos & current_pos(used for quickly locating parent & child nodes)
+// up_pos & current_pos(used for quickly locating parent & child nodes)
+// only depend on the tree, gtree_build stores them in FILE_GTREE_INDEX.
+// needed when the index is loaded from the legacy .gtree/.paths/.minds files.
+void hierarchy_pos_init(){
 	unordered_map<int,int> pos_map;
 	for ( int i = 1; i < GTree.size(); i++ ){
 		GTree[i].current_pos.clear();
@@ -376,239 +379,458 @@ void pre_query(){
 	}
 }
 
-// init search node
-typedef struct{
-	int id;
-	bool isvertex;
-	int lca_pos;
-	int dis;
-}Status_query;
-
-struct Status_query_comp{
-	bool operator()( const Status_query& l, const Status_query& r ){
-		return l.dis > r.dis;
-	}
-};
+// ----- FROZEN INDEX -----
+// compiled query layout(see gtree_index.h). either FILE_GTREE_INDEX mapped read-only,
+// or the legacy files compiled into a heap blob of the same layout.
+// the query never touches the vectors in GTree.
+// FGTree is the thread's view of the pinned IndexSnapshot(see INDEX SNAPSHOTS), only valid while pinned,
+// FGGraph the leaf dijkstra graph of the same snapshot.
+thread_local FrozenGTree FGTree;
+thread_local const CsrGraph* FGGraph;
 
+// lower bounds of children pushed before their itm(knn_search), from mind of the father:
+// down[c] = min distance from a border of father(c) to a border of c,
+// cross[cross_off[tn] + a * nchildren + b] = min distance from a border of child a to one of child b(cpos)
 typedef struct{
-	int id;
-	int dis;
-}ResultSet;
-
-// ----- CORE PART -----
-// knn search
-// input: locid = query location, node id
-//        K = top-K
-// output: a vector of ResultSet, each is a tuple (node id, shortest path), ranked by shortest path distance from query location
-vector<ResultSet> knn_query( int locid, int K ){
-	// init priority queue & result set
-	vector<Status_query> pq;
-	pq.clear();
-	vector<ResultSet> rstset;
-	rstset.clear();
-
-	// init upstream
-	unordered_map<int, vector<int> > itm; // intermediate answer, tree node -> array
-	itm.clear();
-	int tn, cid, posa, posb, min, dis;
-	for ( int i = Nodes[locid].gtreepath.size() - 1; i > 0; i-- ){
-		tn = Nodes[locid].gtreepath[i];
-		itm[tn].clear();
+	vector<int> down;
+	vector<long long> cross_off;
+	vector<int> cross;
+}ChildBounds;
 
-		if ( GTree[tn].isleaf ){
-			posa = lower_bound( GTree[tn].leafnodes.begin(), GTree[tn].leafnodes.end(), locid ) - GTree[tn].leafnodes.begin();
+thread_local const ChildBounds* FGBounds;
+thread_local int FGVersion; // version of the pinned snapshot
 
-			for ( int j = 0; j < GTree[tn].borders.size(); j++ ){
-				itm[tn].push_back( GTree[tn].mind[ j * GTree[tn].leafnodes.size() + posa ] );
+void child_bounds_build( const FrozenGTree &t, ChildBounds &cb ){
+	cb.down.assign( t.tree_size, 0 );
+	cb.cross_off.assign( t.tree_size + 1, 0 );
+	for ( int tn = 0; tn < t.tree_size; tn++ ){
+		int nc = t.tnodes[tn].isleaf ? 0 : t.tnodes[tn].nchildren;
+		cb.cross_off[tn+1] = cb.cross_off[tn] + (long long) nc * nc;
+	}
+	cb.cross.assign( cb.cross_off[t.tree_size], MINPLUS_INF );
+	parallel_for( max( 1, (int) thread::hardware_concurrency() ), t.tree_size, [&]( int worker, int tn ){
+		const FrozenTreeNode &f = t.tnodes[tn];
+		if ( f.isleaf ) return;
+		const int* mind = t.pool + f.mind;
+		const int* current_pos = t.pool + f.current_pos;
+		const int* children = t.pool + f.children;
+		long long nub = f.nunion_borders;
+		for ( int b = 0; b < f.nchildren; b++ ){
+			const FrozenTreeNode &bnode = t.tnodes[children[b]];
+			const int* up_pos = t.pool + bnode.up_pos;
+			int down = MINPLUS_INF;
+			for ( int k = 0; k < f.nborders; k++ ){
+				for ( int j = 0; j < bnode.nborders; j++ ){
+					down = min( down, mind[ current_pos[k] * nub + up_pos[j] ] );
+				}
 			}
-		}
-		else{
-			cid = Nodes[locid].gtreepath[i+1];
-			for ( int j = 0; j < GTree[tn].borders.size(); j++ ){
-				min = -1;
-				posa = GTree[tn].current_pos[j];
-				for ( int k = 0; k < GTree[cid].borders.size(); k++ ){
-					posb = GTree[cid].up_pos[k];
-					dis = itm[cid][k] + GTree[tn].mind[ posa * GTree[tn].union_borders.size() + posb ];
-					// get min
-					if ( min == -1 ){
-						min = dis;
-					}
-					else{
-						if ( dis < min ){
-							min = dis;
-						}
+			cb.down[children[b]] = down;
+			for ( int a = 0; a < f.nchildren; a++ ){
+				const FrozenTreeNode &anode = t.tnodes[children[a]];
+				const int* from_pos = t.pool + anode.up_pos;
+				int cross = MINPLUS_INF;
+				for ( int k = 0; k < anode.nborders; k++ ){
+					for ( int j = 0; j < bnode.nborders; j++ ){
+						cross = min( cross, mind[ from_pos[k] * nub + up_pos[j] ] );
 					}
 				}
-				// update
-				itm[tn].push_back( min );
+				cb.cross[ cb.cross_off[tn] + a * f.nchildren + b ] = cross;
 			}
 		}
+	} );
+}
 
-	}
+// accessors
+#define FG_NODE(tn) (FGTree.tnodes[tn])
+#define FG_ARRAY(tn,field) (FGTree.pool + FGTree.tnodes[tn].field)
+#define FG_PATH(v) (FGTree.pool + FGTree.gtreepath[v])
+#define FG_PATH_SIZE(v) ((int)(FGTree.gtreepath[(v)+1] - FGTree.gtreepath[v]))
 
-	// do search
-	Status_query rootstatus = { 0, false, 0, 0 };
-	pq.push_back( rootstatus );
-	make_heap( pq.begin(), pq.end(), Status_query_comp() );
+// kernel matrix m(pmind, down_mind, rpmind) of one tree node, row r, columns [col, col + n) = segment seg of nseg
+// plain: min_k( itm[k] + m[r][col + k] ), packed: the same on the packed segment(see gtree_index.h)
+inline int fg_minplus( const int* itm, const int* m, long long r, long long stride, int col, int nseg, int seg, int n ){
+	if ( FGTree.packed ) return minplus_min_packed( itm, m + m[ r * nseg + seg ], n );
+	return minplus_min( itm, m + r * stride + col, n );
+}
 
-	vector<int> cands, result;
-	int child, son, allmin, vertex;
+// out[0,n) = the same cells of m
+inline void fg_row( const int* m, long long r, long long stride, int col, int nseg, int seg, int n, int* out ){
+	if ( FGTree.packed ) minplus_unpack( m + m[ r * nseg + seg ], n, out );
+	else memcpy( out, m + r * stride + col, n * sizeof(int) );
+}
 
-	while( pq.size() > 0 && rstset.size() < K ){
-		Status_query top = pq[0];
-		pop_heap( pq.begin(), pq.end(), Status_query_comp() );
-		pq.pop_back();
+// compile GTree & Nodes[].gtreepath into FGTree, then release the vector based copy
+void gtree_freeze(){
+	long long bytes;
+	char* blob = gtree_index_compile( GTree, Nodes, false, false, bytes );
+	gtree_index_attach( FGTree, blob, bytes );
+	FGTree.blob = blob;
+	FGTree.map = NULL;
+	FGTree.bytes = bytes;
 
-		if ( top.isvertex ){
-			ResultSet rs = { top.id, top.dis };
-			rstset.push_back(rs);
+	for ( int i = 0; i < Nodes.size(); i++ ){
+		vector<int>().swap( Nodes[i].gtreepath );
+	}
+	vector<TreeNode>().swap( GTree );
+}
+
+// ----- INDEX SNAPSHOTS -----
+// RCU style: index_current is the published snapshot(index + leaf graph), a reader pins it for one
+// query(IndexPin, nested pins share the outer one) by announcing the epoch it started in, then reading
+// index_current. index_reload maps the new FILE_GTREE_INDEX aside, swaps index_current, bumps the epoch
+// and frees the old snapshot once no reader is pinned in an older epoch, queries never wait.
+// a reload keeps the partition(the object layers index into it), as gtree_build -c: only weights change.
+typedef struct{
+	FrozenGTree tree;
+	vector<FrozenGTree> replicas; // index copies per NUMA node(index_place), tree is replicas[0] then
+	CsrGraph graph;
+	ChildBounds bounds;
+	int version;
+}IndexSnapshot;
+
+// ----- INDEX PLACEMENT -----
+// -H 2m|1g|thp copies the index onto huge pages(gtree_index_copy), one TLB entry then covers 2MB/1GB of the
+// mind/pmind rows the min-plus kernel walks instead of 4KB. -N keeps a copy per NUMA node, each written by a
+// thread pinned to its node, and pins the query workers round robin to the nodes(numa_worker_pin): a worker
+// reads the copy of its node(index_pin), no remote memory on the kernel rows. the leaf graph and the child
+// bounds stay single.
+int index_pages = -1; // GTREE_PAGES_*, -1 = the index as loaded(mapped file or heap blob)
+bool index_numa = false;
+vector< vector<int> > numa_nodes; // cpus of each node copies are placed on
+thread_local int numa_node = 0; // copy read by this thread
+
+// copies of snap->tree as asked by -H/-N, the loaded one released
+void index_place( IndexSnapshot* snap ){
+	if ( index_pages < 0 && ! index_numa ) return;
+	if ( numa_nodes.empty() ){
+		numa_nodes = numa_topology();
+		if ( ! index_numa ) numa_nodes.resize( 1 );
+	}
+	int pages = index_pages < 0 ? GTREE_PAGES_SMALL : index_pages, got = pages;
+	snap->replicas.assign( numa_nodes.size(), FrozenGTree() );
+	for ( int n = 0; n < numa_nodes.size(); n++ ){
+		int used = -1;
+		FrozenGTree &copy = snap->replicas[n];
+		if ( index_numa ) numa_run_on( numa_nodes[n], [&](){ used = gtree_index_copy( copy, snap->tree, pages ); } );
+		else used = gtree_index_copy( copy, snap->tree, pages );
+		if ( used < 0 ){
+			printf("CANNOT COPY THE INDEX(%lld BYTES), KEEPING IT AS LOADED\n", (long long) snap->tree.bytes );
+			for ( int i = 0; i < n; i++ ) gtree_index_release( snap->replicas[i] );
+			snap->replicas.clear();
+			return;
 		}
-		else{
-			if ( GTree[top.id].isleaf ){
-				// inner of leaf node, do dijkstra
-				if ( top.id == Nodes[locid].gtreepath[top.lca_pos] ){
-					
-					cands.clear();
-					for ( int i = 0; i < GTree[top.id].leafinvlist.size(); i++ ){
-						cands.push_back( GTree[top.id].leafnodes[GTree[top.id].leafinvlist[i]] );
-					}
-					result = dijkstra_candidate( locid, cands, Nodes );
-					for ( int i = 0; i < cands.size(); i++ ){
-						Status_query status = { cands[i], true, top.lca_pos, result[i] };
-						pq.push_back(status);
-						push_heap( pq.begin(), pq.end(), Status_query_comp() );
-					}
-					
-				}
-	
-				// else do 
-				else{
-					for ( int i = 0; i < GTree[top.id].leafinvlist.size(); i++ ){
-						posa = GTree[top.id].leafinvlist[i];
-						vertex = GTree[top.id].leafnodes[posa];
-						allmin = -1;
-
-						for ( int k = 0; k < GTree[top.id].borders.size(); k++ ){
-							dis = itm[top.id][k] + GTree[top.id].mind[ k * GTree[top.id].leafnodes.size() + posa ];
-							if ( allmin == -1 ){
-								allmin = dis;
-							}
-							else{
-								if ( dis < allmin ){
-									allmin = dis;
-								}
-							}
-
-						}
-						
-						Status_query status = { vertex, true, top.lca_pos, allmin };
-						pq.push_back(status);
-						push_heap( pq.begin(), pq.end(), Status_query_comp() );
+		if ( used != pages ) printf("NO %s HUGE PAGES RESERVED, COPY %d ON TRANSPARENT HUGE PAGES\n", pages == GTREE_PAGES_1GB ? "1GB" : "2MB", n );
+		got = min( got, used );
+	}
+	gtree_index_release( snap->tree );
+	snap->tree = snap->replicas[0];
+	printf("INDEX ON %s PAGES, %d COPIES\n", got == GTREE_PAGES_1GB ? "1GB" : got == GTREE_PAGES_2MB ? "2MB" : got == GTREE_PAGES_THP ? "THP" : "SMALL", (int) snap->replicas.size() );
+}
 
-					}
-				}
-			}
-			else{
-				for ( int i = 0; i < GTree[top.id].nonleafinvlist.size(); i++ ){
-					child = GTree[top.id].nonleafinvlist[i];
-					son = Nodes[locid].gtreepath[ top.lca_pos + 1 ];
-					// on gtreepath
-					if ( child == son ){
-						Status_query status = { child, false, top.lca_pos + 1, 0 };
-						pq.push_back(status);
-						push_heap( pq.begin(), pq.end(), Status_query_comp() );
-					}
-					// brothers
-					else if ( GTree[child].father == GTree[son].father ){
-						itm[child].clear();
-						allmin = -1;
-
-						for ( int j = 0; j < GTree[child].borders.size(); j++ ){
-							min = -1;
-							posa = GTree[child].up_pos[j];
-							for( int k = 0; k < GTree[son].borders.size(); k++ ){
-								posb = GTree[son].up_pos[k];
-								dis = itm[son][k] + GTree[top.id].mind[ posa * GTree[top.id].union_borders.size() + posb ];
-								if ( min == -1 ){
-									min = dis;
-								}
-								else{
-									if ( dis < min ){
-										min = dis;
-									}
-								}
-							}
-							itm[child].push_back(min);	
-							// update all min
-							if ( allmin == -1 ){
-								allmin = min;
-							}
-							else if ( min < allmin ){
-								allmin = min;
-							}
-						}
-						Status_query status = { child, false, top.lca_pos, allmin };
-						pq.push_back(status);
-						push_heap( pq.begin(), pq.end(), Status_query_comp() );
-					}
-					// downstream
-					else{
-						itm[child].clear();
-						allmin = -1;
-						
-						for ( int j = 0; j < GTree[child].borders.size(); j++ ){
-							min = -1;
-							posa = GTree[child].up_pos[j];
-							for ( int k = 0; k < GTree[top.id].borders.size(); k++ ){
-								posb = GTree[top.id].current_pos[k];
-								dis = itm[top.id][k] + GTree[top.id].mind[ posa * GTree[top.id].union_borders.size() + posb ];
-								if ( min == -1 ){
-									min = dis;
-								}
-								else{
-									if ( dis < min ){
-										min = dis;
-									}
-								}
-							}
-							itm[child].push_back(min);
-							// update all min
-							if ( allmin == -1 ){
-								allmin = min;
-							}
-							else if ( min < allmin ){
-								allmin = min;
-							}
-						}
-						Status_query status = { child, false, top.lca_pos, allmin };
-                        pq.push_back(status);
-                        push_heap( pq.begin(), pq.end(), Status_query_comp() );
-					}
-				}
-			}
-			
+// ----- LAZY INDEX -----
+// -L: queries start before the whole mapped index is resident. the loader reads in the tree nodes, the gtreepaths,
+// the shape arrays(borders, leafnodes, positions) of every node and all matrices of the non leaf nodes(the child
+// bounds read their mind anyway); the leaf matrices(mind, pmind, rpmind, via, most of the file) come in by page
+// fault on first touch, the mapping advised MADV_RANDOM so a fault does not read ahead into leaves no query wants.
+// index_warm then touches the leaves in order of their heat of the last run(FILE_GTREE_INDEX.heat, "tn count" per
+// leaf: half the old count plus the leaf expansions of this run, written at exit, with the stats and every
+// HEAT_SAVE_SECONDS), so the hot leaves are resident before the queries ask for them.
+// the index copies of -H/-N are made whole, -L has nothing to do then; the same with the legacy files(heap).
+#define HEAT_SAVE_SECONDS 60
+bool index_lazy = false;
+atomic<int>* leaf_heat = NULL; // [tree_size], leaf expansions of this run, NULL without -L
+vector<int> leaf_heat_old; // [tree_size], of the last run
+volatile long long resident_sink; // sums of the touched pages, the reads are kept
+
+// a query expands leaf tn
+inline void leaf_heat_touch( int tn ){
+	if ( leaf_heat != NULL ) leaf_heat[tn].fetch_add( 1, memory_order_relaxed );
+}
+
+// everything but the leaf matrices of a mapped snapshot, read in by all cores(cold page cache: many reads in flight)
+void index_resident( IndexSnapshot* snap ){
+	const FrozenGTree &t = snap->tree;
+	if ( ! index_lazy || t.map == NULL || ! snap->replicas.empty() ) return;
+	long long t0 = stats_now();
+	madvise( t.map, t.map_bytes, MADV_RANDOM );
+	int nthreads = max( 1, (int) thread::hardware_concurrency() );
+	vector<long long> bytes( nthreads, 0 ), sums( nthreads, 0 );
+	long long ahead = (const char*) t.pool - (const char*) t.map; // header, tree nodes, gtreepath offsets
+	for ( long long i = 0; i < ahead; i += GTREE_INDEX_ALIGN ) sums[0] += ( (const char*) t.map )[i];
+	sums[0] += gtree_index_touch( t, t.gtreepath[0], t.pool_size );
+	bytes[0] = ahead + ( t.pool_size - t.gtreepath[0] ) * sizeof(int);
+	parallel_for( nthreads, t.tree_size, [&]( int worker, int tn ){
+		const FrozenTreeNode &f = t.tnodes[tn];
+		long long end = gtree_index_node_end( t, tn );
+		if ( ! f.isleaf ){
+			sums[worker] += gtree_index_touch( t, f.borders, end );
+			bytes[worker] += ( end - f.borders ) * sizeof(int);
+			return;
 		}
+		sums[worker] += gtree_index_touch( t, f.borders, f.mind ) + gtree_index_touch( t, f.up_pos, f.pmind );
+		bytes[worker] += ( f.mind - f.borders + f.pmind - f.up_pos ) * sizeof(int);
+	} );
+	long long total = 0;
+	for ( int i = 0; i < nthreads; i++ ){
+		total += bytes[i];
+		resident_sink += sums[i];
+	}
+	printf("LAZY INDEX: %lld OF %lld BYTES RESIDENT IN %lld MS, LEAF MATRICES ON FIRST TOUCH\n", total,
+		(long long) t.bytes, ( stats_now() - t0 ) / 1000000 );
+}
+
+// index storage of snap(the copies, or the one as loaded)
+void index_release( IndexSnapshot* snap ){
+	if ( snap->replicas.empty() ) gtree_index_release( snap->tree );
+	for ( int i = 0; i < snap->replicas.size(); i++ ) gtree_index_release( snap->replicas[i] );
+}
+
+// pin the calling query worker to its NUMA node(-N), once per thread
+void numa_worker_pin( int worker ){
+	thread_local bool pinned = false;
+	if ( ! index_numa || pinned || numa_nodes.empty() ) return;
+	numa_node = worker % numa_nodes.size();
+	numa_pin( numa_nodes[numa_node] );
+	pinned = true;
+}
+
+// epoch a thread is pinned in, 0 when not pinned
+struct IndexReader{
+	atomic<long long> epoch;
+	int depth;
+	IndexReader();
+	~IndexReader();
+};
+
+atomic<IndexSnapshot*> index_current( NULL );
+atomic<long long> index_epoch( 1 );
+set<IndexReader*> index_readers;
+mutex index_readers_lock;
+mutex index_reload_lock; // one reload at a time
+thread_local IndexReader index_reader;
+
+IndexReader::IndexReader() : epoch( 0 ), depth( 0 ){
+	lock_guard<mutex> guard( index_readers_lock );
+	index_readers.insert( this );
+}
+
+IndexReader::~IndexReader(){
+	lock_guard<mutex> guard( index_readers_lock );
+	index_readers.erase( this );
+}
+
+void index_pin(){
+	IndexReader &r = index_reader;
+	if ( r.depth ++ > 0 ) return;
+	r.epoch.store( index_epoch.load() );
+	// read after the announcement, a reload that misses it has published its snapshot already
+	IndexSnapshot* snap = index_current.load();
+	FGTree = snap->replicas.empty() ? snap->tree : snap->replicas[numa_node % snap->replicas.size()];
+	FGGraph = &snap->graph;
+	FGBounds = &snap->bounds;
+	FGVersion = snap->version;
+}
+
+void index_unpin(){
+	IndexReader &r = index_reader;
+	if ( -- r.depth == 0 ) r.epoch.store( 0 );
+}
+
+struct IndexPin{
+	IndexPin(){ index_pin(); }
+	~IndexPin(){ index_unpin(); }
+};
+
+// true while a reader is pinned in an epoch before e
+bool index_readers_before( long long e ){
+	lock_guard<mutex> guard( index_readers_lock );
+	for ( set<IndexReader*>::iterator it = index_readers.begin(); it != index_readers.end(); it++ ){
+		long long pinned = (*it)->epoch.load();
+		if ( pinned != 0 && pinned < e ) return true;
 	}
+	return false;
+}
 
-	/* ----- return id list -----
-	vector<int> rst;
-	for ( int i = 0; i < rstset.size(); i++ ){
-		rst.push_back( rstset[i].id) ;
+// same partition: tree shape, borders and leaf vertices(weights and packing may differ)
+bool index_compatible( const FrozenGTree &a, const FrozenGTree &b ){
+	if ( a.tree_size != b.tree_size || a.node_size != b.node_size || a.directed != b.directed
+		|| a.shard != b.shard || a.shards != b.shards ) return false;
+	for ( int i = 0; i < a.tree_size; i++ ){
+		const FrozenTreeNode &x = a.tnodes[i], &y = b.tnodes[i];
+		if ( x.father != y.father || x.isleaf != y.isleaf || x.nborders != y.nborders
+			|| x.nchildren != y.nchildren || x.nleafnodes != y.nleafnodes ) return false;
+		if ( memcmp( a.pool + x.borders, b.pool + y.borders, x.nborders * sizeof(int) ) != 0
+			|| memcmp( a.pool + x.children, b.pool + y.children, x.nchildren * sizeof(int) ) != 0
+			|| memcmp( a.pool + x.leafnodes, b.pool + y.leafnodes, x.nleafnodes * sizeof(int) ) != 0 ) return false;
 	}
-	
-	return rst;
-	*/
+	return true;
+}
 
-	return rstset;
+// publish FGTree & Graph of the first load as snapshot 0
+void index_publish_first(){
+	IndexSnapshot* snap = new IndexSnapshot();
+	snap->tree = FGTree;
+	index_place( snap );
+	index_resident( snap );
+	FGTree = snap->tree;
+	swap( snap->graph, Graph );
+	child_bounds_build( snap->tree, snap->bounds );
+	snap->version = 0;
+	index_current.store( snap );
 }
 
-int main(){
-	// init
-	TIME_TICK_START
-	init();
-	TIME_TICK_END
-	TIME_TICK_PRINT("INIT")
+// map FILE_GTREE_INDEX again(leaf graph from edge_file, FILE_EDGE if NULL) and publish it,
+// the old snapshot is freed after its last query. false if the new one does not fit, nothing changes then
+bool index_reload( const char* edge_file ){
+	lock_guard<mutex> guard( index_reload_lock );
+	if ( edge_file == NULL ) edge_file = FILE_EDGE;
+	IndexSnapshot* old = index_current.load();
+	IndexSnapshot* snap = new IndexSnapshot();
+	if ( ! gtree_index_mmap( snap->tree, FILE_GTREE_INDEX ) ){
+		printf("RELOAD: CANNOT MAP %s\n", FILE_GTREE_INDEX );
+		delete snap;
+		return false;
+	}
+	bool cached;
+	if ( ! index_compatible( snap->tree, old->tree ) ){
+		printf("RELOAD: %s HAS ANOTHER PARTITION, RESTART NEEDED\n", FILE_GTREE_INDEX );
+	}
+	else if ( ! csr_load( snap->graph, FILE_NODE, edge_file, WEIGHT_INFLATE_FACTOR, thread::hardware_concurrency(), directed, cached )
+		|| snap->graph.n != old->graph.n ){
+		printf("RELOAD: %s DOES NOT FIT THE INDEX\n", edge_file );
+	}
+	else{
+		index_place( snap );
+		index_resident( snap );
+		child_bounds_build( snap->tree, snap->bounds );
+		snap->version = old->version + 1;
+		index_current.store( snap );
+		long long e = ++ index_epoch;
+		while( index_readers_before( e ) ) usleep( 1000 );
+		index_release( old );
+		delete old;
+		printf("RELOADED %s (%lld BYTES), VERSION %d\n", FILE_GTREE_INDEX, (long long)snap->tree.bytes, snap->version );
+		fflush( stdout );
+		return true;
+	}
+	index_release( snap );
+	delete snap;
+	fflush( stdout );
+	return false;
+}
+
+// reload on every SIGHUP, SIGHUP must be blocked in all threads(main before any thread starts)
+void index_reload_signal_loop(){
+	sigset_t set;
+	sigemptyset( &set );
+	sigaddset( &set, SIGHUP );
+	int sig;
+	while( sigwait( &set, &sig ) == 0 ){
+		index_reload( NULL );
+	}
+}
+
+// leaf heat of the last run(see LAZY INDEX), nothing if there is no heat file
+void leaf_heat_load( int tree_size ){
+	leaf_heat_old.assign( tree_size, 0 );
+	FILE* fin = fopen( ( string( FILE_GTREE_INDEX ) + ".heat" ).c_str(), "r" );
+	if ( fin == NULL ) return;
+	int tn, count;
+	while( fscanf( fin, "%d %d", &tn, &count ) == 2 ){
+		if ( tn >= 0 && tn < tree_size && count > 0 ) leaf_heat_old[tn] = count;
+	}
+	fclose(fin);
+}
+
+// half the last run's heat plus this run's, written aside then renamed
+void leaf_heat_save(){
+	static mutex lock;
+	if ( leaf_heat == NULL ) return;
+	lock_guard<mutex> guard( lock );
+	string file = string( FILE_GTREE_INDEX ) + ".heat", tmp = file + ".tmp";
+	FILE* fout = fopen( tmp.c_str(), "w" );
+	if ( fout == NULL ){
+		printf("CANNOT WRITE %s\n", tmp.c_str() );
+		return;
+	}
+	for ( int tn = 0; tn < leaf_heat_old.size(); tn++ ){
+		long long count = leaf_heat_old[tn] / 2 + leaf_heat[tn].load( memory_order_relaxed );
+		if ( count > 0 ) fprintf( fout, "%d %lld\n", tn, min( count, 0x7fffffffLL ) );
+	}
+	if ( fclose(fout) != 0 || rename( tmp.c_str(), file.c_str() ) != 0 ) remove( tmp.c_str() );
+}
+
+// background: the leaves with heat of the last run, hottest first, then the heat saved now and then
+void index_warm(){
+	vector< pair<int,int> > order;
+	for ( int tn = 0; tn < leaf_heat_old.size(); tn++ ){
+		if ( leaf_heat_old[tn] > 0 ) order.push_back( make_pair( -leaf_heat_old[tn], tn ) );
+	}
+	sort( order.begin(), order.end() );
+	long long t0 = stats_now(), bytes = 0;
+	for ( int i = 0; i < order.size(); i++ ){
+		// one leaf per pin, a reload meanwhile is not held up
+		IndexPin pin;
+		int tn = order[i].second;
+		if ( ! FG_NODE(tn).isleaf || FGTree.map == NULL ) continue;
+		long long end = gtree_index_node_end( FGTree, tn );
+		resident_sink += gtree_index_touch( FGTree, FG_NODE(tn).borders, end );
+		bytes += ( end - FG_NODE(tn).borders ) * sizeof(int);
+	}
+	printf("WARMED %d LEAVES(%lld BYTES) IN %lld MS\n", (int) order.size(), bytes, ( stats_now() - t0 ) / 1000000 );
+	fflush( stdout );
+	while( true ){
+		sleep( HEAT_SAVE_SECONDS );
+		leaf_heat_save();
+	}
+}
+
+// -L on the first load: heat counters, the warmer
+void index_lazy_start(){
+	IndexSnapshot* snap = index_current.load();
+	if ( ! index_lazy ) return;
+	if ( snap->tree.map == NULL || ! snap->replicas.empty() ){
+		printf("-L NEEDS THE MAPPED %s WITHOUT -H/-N, LOADED WHOLE\n", FILE_GTREE_INDEX );
+		index_lazy = false;
+		return;
+	}
+	leaf_heat_load( snap->tree.tree_size );
+	leaf_heat = new atomic<int>[ snap->tree.tree_size ]();
+	thread( index_warm ).detach();
+}
+
+// -S s/n: this process serves shard s of n, shard_count = 0 when it is no shard(see SHARDS)
+// -C: the coordinator of the shards at these addresses when not empty
+int shard_id = 0, shard_count = 0;
+vector<string> shard_addrs;
+
+// load the gtree index, mapped single file if present, legacy files otherwise
+void gtree_index_load(){
+	if ( gtree_index_mmap( FGTree, FILE_GTREE_INDEX ) ){
+		if ( FGTree.node_size != Nodes.size() ){
+			printf("GTREE INDEX: NODE COUNT %d DOES NOT MATCH GRAPH %d\n", FGTree.node_size, (int)Nodes.size() );
+			exit(1);
+		}
+		if ( FGTree.directed != ( directed ? 1 : 0 ) ){
+			printf("GTREE INDEX: %s GRAPH, RUN %s -d\n", FGTree.directed ? "DIRECTED" : "UNDIRECTED", FGTree.directed ? "WITH" : "WITHOUT" );
+			exit(1);
+		}
+		// a full index serves any shard, a coordinator reads the root only
+		if ( FGTree.shards > 0 && shard_addrs.empty() && ( FGTree.shards != shard_count || FGTree.shard != shard_id ) ){
+			printf("GTREE INDEX: SHARD %d OF %d, RUN WITH -S %d/%d -l addr\n", FGTree.shard, FGTree.shards, FGTree.shard, FGTree.shards );
+			exit(1);
+		}
+		printf("MAPPED %s (%lld BYTES)\n", FILE_GTREE_INDEX, (long long)FGTree.bytes );
+		index_publish_first();
+		index_lazy_start();
+		return;
+	}
+
+	// legacy files hold one direction only
+	if ( directed ){
+		printf("DIRECTED GRAPH NEEDS %s\n", FILE_GTREE_INDEX );
+		exit(1);
+	}
 
 	// load gtree index
 	gtree_load();
@@ -616,25 +838,2761 @@ int main(){
 	// load distance matrix
 	hierarchy_shortest_path_load();
 
-	// pre query init
-	pre_query();
+	hierarchy_pos_init();
+	gtree_freeze();
+	index_publish_first();
+	index_lazy_start();
+}
 
-	// knn search
-	// example
-	printf("KNN Search Started...\n");
-	int locid, K;
-	vector<ResultSet> result;
-	while(scanf("%d %d", &locid, &K) == 2){
-		if (locid >= Nodes.size() || locid < 0 || K < 0 || K > Nodes.size()) continue;
+// distances from the borders of all tree nodes to their nearest objects of a layer, built on first use
+// by rknn_query for snapshot version. adding objects only brings distances down, so a BorderKnn
+// stays an upper bound and valid, a removal drops it.
+// dist[slot[v] * RKNN_KMAX + i] = distance from border vertex v to its i+1-th nearest object, MINPLUS_INF past the last
+typedef struct{
+	int version;
+	vector<int> slot; // -1 for a vertex that is no border
+	vector<int> dist;
+}BorderKnn;
 
-		TIME_TICK_START
-		result = knn_query(locid, K);
-		TIME_TICK_END
-		for ( int i = 0; i < result.size(); i++ ){
-			printf("ID=%d DIS=%d\n", result[i].id, result[i].dis );
+// ----- EDGE LOCATIONS -----
+// a location on an edge(GPS snapped): edge id(as in FILE_EDGE) and offset from the edge's first vertex s,
+// in the unit of the weights. on edge s -> t of weight w a point at off reaches t after w - off and, undirected,
+// s after off; an object there is reached from s(+ off) and, undirected, from t(+ w - off).
+// queries(knn_query_edge): the endpoints are sources seeded with their offsets(QueryContext src), their leaf
+// rows go into the leaf itm as one min(knn_upstream) and the leaf dijkstra starts from both, one search answers.
+// for a cut edge(s and t in different leaves) the gtreepaths part, there one search per endpoint is merged.
+// objects: an EdgeEnd per endpoint it is reached from, in the leaf of that endpoint(see OBJECT LAYERS). a leaf
+// expansion pushes it at the endpoint's distance + delta, the nearer of its ends comes out first and is
+// the answer(QueryContext eseen), id Nodes.size() + its index in edgeobj.
+CsrEdges Edges; // of FILE_EDGE, loaded on first use(edges_ready)
+once_flag edges_once;
+bool edges_ok = false;
+
+bool edges_ready(){
+	call_once( edges_once, [](){
+		edges_ok = csr_edges_load( Edges, FILE_EDGE, Nodes.size(), WEIGHT_INFLATE_FACTOR, thread::hardware_concurrency() );
+	} );
+	return edges_ok;
+}
+
+bool valid_edge( int eid ){
+	return edges_ready() && eid >= 0 && eid < Edges.s.size() && Edges.s[eid] >= 0;
+}
+
+// offset in the unit of the edge file to the weight unit, within the edge
+int edge_offset( int eid, double off ){
+	long long o = (long long) ( off * WEIGHT_INFLATE_FACTOR );
+	return o < 0 ? 0 : o > Edges.w[eid] ? Edges.w[eid] : (int) o;
+}
+
+// (vertex, distance) a point at off on eid gets to first
+void edge_sources( int eid, int off, vector< pair<int,int> > &ends ){
+	ends.clear();
+	ends.push_back( make_pair( Edges.t[eid], Edges.w[eid] - off ) );
+	if ( ! directed ) ends.push_back( make_pair( Edges.s[eid], off ) );
+}
+
+// distance along eid from a point at from to one at to, MINPLUS_INF if only around through the endpoints
+inline int edge_along( int from, int to ){
+	if ( to >= from ) return to - from;
+	return directed ? MINPLUS_INF : from - to;
+}
+
+// leaf of vertex v and v's position in its leafnodes
+inline int vertex_leaf( int v, int &posa ){
+	int leaf = FG_PATH(v)[ FG_PATH_SIZE(v) - 1 ];
+	const int* leafnodes = FG_ARRAY(leaf, leafnodes);
+	posa = lower_bound( leafnodes, leafnodes + FG_NODE(leaf).nleafnodes, v ) - leafnodes;
+	return leaf;
+}
+
+// ----- OBJECT LAYERS -----
+// one ObjectLayer per object category(restaurants, chargers, ...), all over the one
+// read-only FGTree. a layer holds only the OCCURENCE LIST in paper, kept up to date object by object.
+// leafinv[leaf] = sorted positions in leafnodes holding objects,
+// nonleafinv[tn] = children whose subtree holds objects, in children order,
+// count[tn] = objects in the subtree of tn, vcount[v] = objects on vertex v.
+// leafsorted[leaf] = for each border of a leaf with LEAF_STREAM_MIN occupied positions or more,
+// leafinv[leaf] ordered by distance from the border, nborders lists one after another(leaf_stream).
+// a vertex with several objects is one occurrence(returned once by the search).
+// attributes: a bitmask per object(category ids, "open", ...), 0 if it has none.
+// vattr[v] = the nonzero masks of the objects on v, mask[tn] = OR of them over the subtree of tn.
+// a filter want matches an object whose mask has all bits of want, a vertex if one of its objects
+// does, and a subtree can hold a match only if mask[tn] has them all. want = 0 matches everything.
+// kborder = nearest objects of every border vertex(BorderKnn), only for reverse knn against this layer.
+// stamp[tn] = clock when an object change last concerned tn(layer_touch, see RESULT CACHE).
+// queries hold lock for reading, add/remove/move_object for writing.
+// objects on edges(see EDGE LOCATIONS): edgeobj[j], one EdgeEnd per endpoint it is reached from in
+// leafedge[leaf of that endpoint], counted in count[] and mask[] with the vertex objects, onedge[eid] = its j.
+// they are loaded with the layer(object_layer_load) and not changed by add/remove/move_object.
+typedef struct{
+	int eid;
+	int off; // from the edge's first vertex, weight unit(* WEIGHT_INFLATE_FACTOR)
+	unsigned attr;
+}EdgeObject;
+
+typedef struct{
+	int posa; // endpoint, position in leafnodes
+	int delta; // endpoint to the object
+	int obj; // edgeobj index
+}EdgeEnd;
+
+typedef struct{
+	char name[100];
+	vector< vector<int> > leafinv;
+	vector< vector<int> > nonleafinv;
+	vector< vector<int> > leafsorted;
+	vector<int> count;
+	vector<int> vcount;
+	unordered_map< int, vector<unsigned> > vattr;
+	vector<unsigned> mask;
+	int occupied; // vertices holding objects
+	shared_ptr<const BorderKnn> kborder;
+	pthread_mutex_t kborder_lock;
+	vector<unsigned> stamp;
+	unsigned clock;
+	pthread_rwlock_t lock;
+	vector<EdgeObject> edgeobj;
+	vector< vector<EdgeEnd> > leafedge;
+	unordered_map< int, vector<int> > onedge;
+}ObjectLayer;
+
+// Layers[0] = FILE_OBJECT, then one per -o file
+vector<ObjectLayer*> Layers;
+
+#define OCC_LEAF(layer,tn) ((layer).leafinv[tn].data())
+#define OCC_LEAF_SIZE(layer,tn) ((int)(layer).leafinv[tn].size())
+#define OCC_NONLEAF(layer,tn) ((layer).nonleafinv[tn].data())
+#define OCC_NONLEAF_SIZE(layer,tn) ((int)(layer).nonleafinv[tn].size())
+#define OCC_LEAF_SIZE_ALL(layer) ((layer).occupied) // number of result candidates
+
+void object_layer_init( ObjectLayer &occ, const char* name ){
+	snprintf( occ.name, sizeof(occ.name), "%s", name );
+	occ.leafinv.assign( FGTree.tree_size, vector<int>() );
+	occ.nonleafinv.assign( FGTree.tree_size, vector<int>() );
+	occ.leafsorted.assign( FGTree.tree_size, vector<int>() );
+	occ.count.assign( FGTree.tree_size, 0 );
+	occ.vcount.assign( Nodes.size(), 0 );
+	occ.vattr.clear();
+	occ.mask.assign( FGTree.tree_size, 0 );
+	occ.occupied = 0;
+	occ.kborder.reset();
+	occ.stamp.assign( FGTree.tree_size, 0 );
+	occ.clock = 0;
+	occ.edgeobj.clear();
+	occ.leafedge.assign( FGTree.tree_size, vector<EdgeEnd>() );
+	occ.onedge.clear();
+	pthread_mutex_init( &occ.kborder_lock, NULL );
+	pthread_rwlock_init( &occ.lock, NULL );
+}
+
+inline bool attr_match( unsigned attr, unsigned want ){
+	return ( attr & want ) == want;
+}
+
+// true if an object on v matches want
+bool vertex_match( const ObjectLayer &occ, int v, unsigned want ){
+	if ( want == 0 ) return true;
+	unordered_map< int, vector<unsigned> >::const_iterator it = occ.vattr.find( v );
+	if ( it == occ.vattr.end() ) return false;
+	for ( int i = 0; i < it->second.size(); i++ ){
+		if ( attr_match( it->second[i], want ) ) return true;
+	}
+	return false;
+}
+
+// mask of tn from its occurrence list
+unsigned node_mask( const ObjectLayer &occ, int tn ){
+	unsigned m = 0;
+	if ( FG_NODE(tn).isleaf ){
+		const int* leafnodes = FG_ARRAY(tn, leafnodes);
+		for ( int i = 0; i < occ.leafinv[tn].size(); i++ ){
+			unordered_map< int, vector<unsigned> >::const_iterator it = occ.vattr.find( leafnodes[ occ.leafinv[tn][i] ] );
+			if ( it == occ.vattr.end() ) continue;
+			for ( int j = 0; j < it->second.size(); j++ ) m |= it->second[j];
+		}
+		for ( int i = 0; i < occ.leafedge[tn].size(); i++ ) m |= occ.edgeobj[ occ.leafedge[tn][i].obj ].attr;
+	}
+	else{
+		for ( int i = 0; i < occ.nonleafinv[tn].size(); i++ ) m |= occ.mask[ occ.nonleafinv[tn][i] ];
+	}
+	return m;
+}
+
+// tn changed for cached results
+inline void layer_touch( ObjectLayer &occ, int tn ){
+	occ.stamp[tn] = ++ occ.clock;
+}
+
+// rank of child in father's children
+int child_rank( int father, int child ){
+	const int* children = FG_ARRAY(father, children);
+	return find( children, children + FG_NODE(father).nchildren, child ) - children;
+}
+
+// rebuild leafsorted of leaf tn after its leafinv changed, O(nborders * m log m)
+void leaf_sorted_build( ObjectLayer &occ, int tn ){
+	const vector<int> &leaf = occ.leafinv[tn];
+	vector<int> &sorted = occ.leafsorted[tn];
+	int m = leaf.size();
+	if ( m < LEAF_STREAM_MIN ){
+		vector<int>().swap( sorted );
+		return;
+	}
+	const FrozenTreeNode &tnode = FG_NODE(tn);
+	const int* mind = FG_ARRAY(tn, mind);
+	sorted.resize( (long long) tnode.nborders * m );
+	for ( int b = 0; b < tnode.nborders; b++ ){
+		// mind of a leaf: border b to leaf node posa at b * nleafnodes + posa
+		const int* row = mind + (long long) b * tnode.nleafnodes;
+		int* list = &sorted[ (long long) b * m ];
+		copy( leaf.begin(), leaf.end(), list );
+		stable_sort( list, list + m, [row]( int x, int y ){ return row[x] < row[y]; } );
+	}
+}
+
+// insert child into father's nonleafinv, keep children order
+void occurrence_link( ObjectLayer &occ, int father, int child ){
+	vector<int> &list = occ.nonleafinv[father];
+	int rank = child_rank( father, child );
+	int i = 0;
+	while ( i < list.size() && child_rank( father, list[i] ) < rank ) i++;
+	list.insert( list.begin() + i, child );
+}
+
+// add one object with mask attr on vertex v, O(tree depth)
+// caller holds occ.lock for writing
+void add_object_locked( ObjectLayer &occ, int v, unsigned attr = 0 ){
+	int current = FG_PATH(v)[ FG_PATH_SIZE(v) - 1 ];
+	layer_touch( occ, current );
+	if ( attr != 0 ){
+		occ.vattr[v].push_back( attr );
+		for ( int tn = current; tn != -1; tn = FG_NODE(tn).father ){
+			if ( ( occ.mask[tn] | attr ) != occ.mask[tn] ) layer_touch( occ, tn );
+			occ.mask[tn] |= attr;
+		}
+	}
+	if ( occ.vcount[v]++ > 0 ){
+		return;
+	}
+	occ.occupied ++;
+	// add leaf inv list
+	const int* leafnodes = FG_ARRAY(current, leafnodes);
+	int pos = lower_bound( leafnodes, leafnodes + FG_NODE(current).nleafnodes, v ) - leafnodes;
+	vector<int> &leaf = occ.leafinv[current];
+	leaf.insert( lower_bound( leaf.begin(), leaf.end(), pos ), pos );
+	leaf_sorted_build( occ, current );
+	// recursive
+	int child;
+	while( current != -1 ){
+		// no longer empty
+		if ( occ.count[current] ++ == 0 ) layer_touch( occ, current );
+		child = current;
+		current = FG_NODE(current).father;
+		if ( current == -1 ) break;
+		if ( occ.count[child] == 1 ){
+			occurrence_link( occ, current, child );
+		}
+	}
+}
+
+// remove one object with mask attr from vertex v, false if v holds none
+// caller holds occ.lock for writing
+bool remove_object_locked( ObjectLayer &occ, int v, unsigned attr = 0 ){
+	if ( occ.vcount[v] == 0 ){
+		return false;
+	}
+	unordered_map< int, vector<unsigned> >::iterator it = occ.vattr.find( v );
+	int with_attr = it == occ.vattr.end() ? 0 : it->second.size();
+	if ( attr == 0 && occ.vcount[v] == with_attr ){
+		return false;
+	}
+	if ( attr != 0 ){
+		if ( with_attr == 0 ) return false;
+		vector<unsigned>::iterator a = find( it->second.begin(), it->second.end(), attr );
+		if ( a == it->second.end() ) return false;
+		it->second.erase( a );
+		if ( it->second.empty() ) occ.vattr.erase( it );
+	}
+	occ.kborder.reset();
+	int leafnode = FG_PATH(v)[ FG_PATH_SIZE(v) - 1 ];
+	layer_touch( occ, leafnode );
+	if ( --occ.vcount[v] == 0 ){
+		occ.occupied --;
+		int current = leafnode;
+		const int* leafnodes = FG_ARRAY(current, leafnodes);
+		int pos = lower_bound( leafnodes, leafnodes + FG_NODE(current).nleafnodes, v ) - leafnodes;
+		vector<int> &leaf = occ.leafinv[current];
+		leaf.erase( lower_bound( leaf.begin(), leaf.end(), pos ) );
+		leaf_sorted_build( occ, current );
+		int child;
+		while( current != -1 ){
+			occ.count[current] --;
+			child = current;
+			current = FG_NODE(current).father;
+			if ( current == -1 ) break;
+			if ( occ.count[child] == 0 ){
+				vector<int> &list = occ.nonleafinv[current];
+				list.erase( find( list.begin(), list.end(), child ) );
+			}
+		}
+	}
+	// masks on the path, from the leaf up
+	if ( attr != 0 ){
+		for ( int tn = leafnode; tn != -1; tn = FG_NODE(tn).father ) occ.mask[tn] = node_mask( occ, tn );
+	}
+	return true;
+}
+
+bool valid_vertex( int v ){
+	return v >= 0 && v < Nodes.size();
+}
+
+void add_object( ObjectLayer &layer, int v, unsigned attr = 0 ){
+	if ( ! valid_vertex(v) ) return;
+	IndexPin pin;
+	pthread_rwlock_wrlock( &layer.lock );
+	add_object_locked( layer, v, attr );
+	pthread_rwlock_unlock( &layer.lock );
+}
+
+bool remove_object( ObjectLayer &layer, int v, unsigned attr = 0 ){
+	if ( ! valid_vertex(v) ) return false;
+	IndexPin pin;
+	pthread_rwlock_wrlock( &layer.lock );
+	bool done = remove_object_locked( layer, v, attr );
+	pthread_rwlock_unlock( &layer.lock );
+	return done;
+}
+
+// atomic for queries, false(nothing changed) if from holds no object with mask attr
+bool move_object( ObjectLayer &layer, int from, int to, unsigned attr = 0 ){
+	if ( ! valid_vertex(from) || ! valid_vertex(to) ) return false;
+	IndexPin pin;
+	pthread_rwlock_wrlock( &layer.lock );
+	bool done = remove_object_locked( layer, from, attr );
+	if ( done ) add_object_locked( layer, to, attr );
+	pthread_rwlock_unlock( &layer.lock );
+	return done;
+}
+
+// new layer with the objects of file("vertex id [mask]" per line, mask = attributes, 0 if absent,
+// "E edge offset id [mask]" for one on an edge, see EDGE LOCATIONS), NULL if file is missing
+// built in bulk, not object by object: the file is parsed in chunks on all cores, vcount is
+// summed, then every leaf lists its occupied positions(in parallel, leaves are disjoint) and
+// the counts go up the tree children before fathers, so each nonleafinv comes out in children order.
+ObjectLayer* object_layer_load( const char* file ){
+	vector<char> buf;
+	if ( ! csr_read_file( file, buf ) ){
+		printf("CANNOT OPEN OBJECT FILE %s\n", file );
+		return NULL;
+	}
+	IndexPin pin;
+	ObjectLayer* layer = new ObjectLayer;
+	ObjectLayer &occ = *layer;
+	object_layer_init( occ, file );
+	int nthreads = max( 1, (int) thread::hardware_concurrency() );
+
+	// parse
+	vector<long long> begin;
+	csr_chunks( buf, nthreads, begin );
+	vector< vector< pair<int,unsigned> > > found( nthreads );
+	vector< vector< pair<EdgeObject,double> > > found_edge( nthreads );
+	parallel_for( nthreads, nthreads, [&]( int worker, int c ){
+		const char* p = &buf[0] + begin[c];
+		const char* end = &buf[0] + begin[c+1];
+		long long oid, id, attr;
+		double off;
+		for ( ; p < end; p = csr_next_line( p ) ){
+			const char* q = p;
+			while ( csr_blank(*q) ) q++;
+			if ( *q == 'E' ){
+				q++;
+				if ( ! csr_int( q, oid ) || ! csr_real( q, off ) || ! csr_int( q, id ) ) continue;
+				if ( ! csr_int( q, attr ) ) attr = 0;
+				EdgeObject e = { (int) oid, 0, (unsigned) attr };
+				found_edge[c].push_back( make_pair( e, off ) );
+				continue;
+			}
+			if ( ! csr_int( q, oid ) || ! csr_int( q, id ) || ! valid_vertex( oid ) ) continue;
+			if ( ! csr_int( q, attr ) ) attr = 0;
+			found[c].push_back( make_pair( (int) oid, (unsigned) attr ) );
+		}
+	} );
+	vector<char>().swap( buf );
+	for ( int c = 0; c < nthreads; c++ ){
+		for ( int i = 0; i < found[c].size(); i++ ){
+			int v = found[c][i].first;
+			if ( occ.vcount[v]++ == 0 ) occ.occupied ++;
+			if ( found[c][i].second != 0 ) occ.vattr[v].push_back( found[c][i].second );
+		}
+	}
+
+	// objects on edges, an EdgeEnd in the leaf of each endpoint they are reached from
+	for ( int c = 0; c < nthreads; c++ ){
+		for ( int i = 0; i < found_edge[c].size(); i++ ){
+			EdgeObject e = found_edge[c][i].first;
+			if ( ! valid_edge( e.eid ) ) continue;
+			e.off = edge_offset( e.eid, found_edge[c][i].second );
+			int j = occ.edgeobj.size(), posa, leaf;
+			occ.edgeobj.push_back( e );
+			occ.onedge[e.eid].push_back( j );
+			leaf = vertex_leaf( Edges.s[e.eid], posa );
+			EdgeEnd from_s = { posa, e.off, j };
+			occ.leafedge[leaf].push_back( from_s );
+			if ( directed ) continue;
+			leaf = vertex_leaf( Edges.t[e.eid], posa );
+			EdgeEnd from_t = { posa, Edges.w[e.eid] - e.off, j };
+			occ.leafedge[leaf].push_back( from_t );
+		}
+	}
+
+	// fathers before children
+	vector<int> order( 1, 0 );
+	for ( int i = 0; i < order.size(); i++ ){
+		const int* children = FG_ARRAY(order[i], children);
+		order.insert( order.end(), children, children + FG_NODE(order[i]).nchildren );
+	}
+
+	// leaves, the workers see the snapshot pinned here
+	FrozenGTree tree = FGTree;
+	parallel_for( nthreads, order.size(), [&]( int worker, int i ){
+		FGTree = tree;
+		int tn = order[i];
+		if ( ! FG_NODE(tn).isleaf ) return;
+		const int* leafnodes = FG_ARRAY(tn, leafnodes);
+		vector<int> &leaf = occ.leafinv[tn];
+		for ( int posa = 0; posa < FG_NODE(tn).nleafnodes; posa++ ){
+			if ( occ.vcount[leafnodes[posa]] > 0 ) leaf.push_back( posa );
+		}
+		occ.count[tn] = leaf.size() + occ.leafedge[tn].size();
+		occ.mask[tn] = node_mask( occ, tn );
+		leaf_sorted_build( occ, tn );
+	} );
+
+	// non leaves, bottom up
+	for ( int i = order.size() - 1; i >= 0; i-- ){
+		int tn = order[i];
+		if ( FG_NODE(tn).isleaf ) continue;
+		const int* children = FG_ARRAY(tn, children);
+		for ( int j = 0; j < FG_NODE(tn).nchildren; j++ ){
+			if ( occ.count[children[j]] == 0 ) continue;
+			occ.nonleafinv[tn].push_back( children[j] );
+			occ.count[tn] += occ.count[children[j]];
+			occ.mask[tn] |= occ.mask[children[j]];
+		}
+	}
+	return layer;
+}
+
+// before query, we have to set OCCURENCE LIST etc.
+// one layer per object file, FILE_OBJECT first, later changes by add/remove/move_object.
+void pre_query( vector<const char*> &files ){
+	Layers.clear();
+	for ( int i = 0; i < files.size(); i++ ){
+		ObjectLayer* layer = object_layer_load( files[i] );
+		if ( layer == NULL ) exit(1);
+		Layers.push_back( layer );
+		printf("LAYER %d: %s, %d OBJECT VERTICES", i, layer->name, layer->occupied );
+		if ( layer->edgeobj.size() > 0 ) printf(", %d ON EDGES", (int) layer->edgeobj.size() );
+		printf("\n");
+	}
+}
+
+
+// init search node
+typedef struct{
+	int id;
+	bool isvertex;
+	int lca_pos;
+	int dis;
+	int stream; // 1: the objects of leaf id not pushed yet(leaf_stream), dis is the nearest of them
+	int lazy; // 1: itm of tree node id not computed yet(child_itm), dis is a lower bound(ChildBounds)
+	int exact; // vertex: its distance, dis is exact / (1 + eps) in an approximate search(knn_push_vertex)
+}Status_query;
+
+struct Status_query_comp{
+	bool operator()( const Status_query& l, const Status_query& r ){
+		return l.dis > r.dis;
+	}
+};
+
+typedef struct{
+	int id;
+	int dis;
+}ResultSet;
+
+// ----- QUERY CONTEXT -----
+// per thread scratch of knn_query, reused across queries.
+// itm(intermediate answer, tree node -> array) lives in a bump arena, located by itm_off[tn],
+// and is valid only when itm_stamp[tn] equals the current generation, so a reset is O(1).
+// the arena is sized to the sum of borders of all tree nodes, each tree node gets at most one itm per query.
+typedef struct{
+	int generation;
+	vector<int> itm_stamp;
+	vector<int> itm_off;
+	vector<int> arena;
+	int arena_top;
+	// reused containers, clear() keeps the capacity
+	vector<Status_query> pq;
+	vector<ResultSet> rstset;
+	vector<int> cands;
+	// leaf dijkstra scratch
+	DHeap heap;
+	vector<int> dres;
+	// routes(knn_query_with_paths), pred of the leaf dijkstra is recorded when pred is not empty
+	vector<int> pred;
+	vector<int> route; // route of answer i at [route_off[i], route_off[i+1])
+	vector<int> route_off;
+	vector<int> hops; // route_answer scratch
+	vector<int> leafrow; // route_answer and seeded knn_upstream scratch, one vertex-major leaf row(pmind)
+	long long pops, nodes, cells; // knn_search stats
+	unsigned want; // attribute filter of the search(see OBJECT LAYERS), 0 = none
+	double eps; // approximate search(see APPROXIMATE KNN), 0 = exact
+	vector<int> rstlow; // eps > 0: rstlow[i] <= the distance of the true i-th nearest object
+	// leaf streams: next entry of each border list of leaf tn at cursor[cursor_off[tn] + b],
+	// seen[v] == generation once v is pushed
+	vector<int> cursor;
+	vector<int> cursor_off;
+	vector<int> seen;
+	vector<int> kbound; // rknn_query scratch, K-th nearest facility distance per border of a leaf
+	bool track; // the search records the tree nodes its answers depend on in deps(see RESULT CACHE)
+	vector<int> deps;
+	bool routes; // knn_query_with_paths: the search itself is needed, no cached answers
+	QueryStats* stats; // NULL unless stats are on(-s)
+	// query on an edge(see EDGE LOCATIONS): src = (vertex, distance) seeds in the leaf of locid, empty = locid
+	// alone, src_edge/src_off = the location(-1 = none), eseen[j] == generation once edge object j is out
+	vector< pair<int,int> > src;
+	int src_edge, src_off;
+	vector<int> eseen;
+}QueryContext;
+
+// ----- QUERY STATS -----
+// per phase time of every query(histograms) and event counters, one QueryStats per QueryContext,
+// merged and written as JSON(stats_dump) at exit, on SIGUSR1(before the next request) and on a "STATS" line.
+// dijkstra and minplus are the parts of search spent in the leaf dijkstra and in the border min-plus
+// of expanded tree nodes; upstream includes its own min-plus. route expansion of PATH queries is not timed.
+enum{ QS_TOTAL, QS_UPSTREAM, QS_SEARCH, QS_DIJKSTRA, QS_MINPLUS, QS_PHASES };
+enum{ QC_NODES, QC_PUSHES, QC_CELLS, QC_RESULTS, QC_CACHE_HITS, QC_CACHE_STALE, QC_CACHE_EVICTIONS, QC_ALLOCS, QC_COUNTERS };
+const char* const stats_phase_names[QS_PHASES] = { "total", "upstream", "search", "leaf_dijkstra", "border_minplus" };
+const char* const stats_counter_names[QC_COUNTERS] = { "tree_nodes_expanded", "heap_pushes", "matrix_cells", "results", "cache_hits", "cache_stale", "cache_evictions", "heap_allocations" };
+
+const char* stats_file = NULL;
+vector<QueryStats*> stats_all;
+pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+volatile sig_atomic_t stats_requested = 0;
+
+#define STATS_TICK(ctx) ( (ctx).stats != NULL ? stats_now() : 0 )
+
+void stats_signal( int sig ){
+	stats_requested = 1;
+}
+
+// write the sum of all contexts to stats_file, queries must not run meanwhile(and the leaf heat of -L)
+void stats_dump(){
+	stats_requested = 0;
+	leaf_heat_save();
+	if ( stats_file == NULL ) return;
+	QueryStats* sum = new QueryStats;
+	stats_init( *sum );
+	pthread_mutex_lock( &stats_lock );
+	for ( int i = 0; i < stats_all.size(); i++ ){
+		stats_merge( *sum, *stats_all[i] );
+	}
+	pthread_mutex_unlock( &stats_lock );
+	if ( ! stats_json_save( stats_file, *sum, stats_phase_names, QS_PHASES, stats_counter_names, STATS_COUNTERS ) ){
+		printf("CANNOT WRITE %s\n", stats_file );
+	}
+	delete sum;
+}
+
+void query_context_init( QueryContext &ctx ){
+	IndexPin pin;
+	int total = 0;
+	for ( int i = 0; i < FGTree.tree_size; i++ ){
+		total += FG_NODE(i).nborders;
+	}
+	ctx.generation = 0;
+	ctx.itm_stamp.assign( FGTree.tree_size, 0 );
+	ctx.itm_off.assign( FGTree.tree_size, 0 );
+	ctx.arena.assign( total, 0 );
+	ctx.arena_top = 0;
+	ctx.pq.reserve( FGTree.tree_size + Nodes.size() );
+	ctx.rstset.reserve( Nodes.size() );
+	ctx.cands.reserve( LEAF_CAP * 2 );
+	dheap_init( ctx.heap, Nodes.size() );
+	ctx.dres.reserve( LEAF_CAP * 2 );
+	ctx.cursor_off.assign( FGTree.tree_size, 0 );
+	ctx.seen.assign( Nodes.size(), 0 );
+	ctx.eps = 0;
+	ctx.track = false;
+	ctx.routes = false;
+	ctx.src_edge = -1;
+	ctx.src_off = 0;
+	ctx.stats = NULL;
+	if ( stats_file != NULL ){
+		ctx.stats = new QueryStats;
+		stats_init( *ctx.stats );
+		pthread_mutex_lock( &stats_lock );
+		stats_all.push_back( ctx.stats );
+		pthread_mutex_unlock( &stats_lock );
+	}
+}
+
+// start a new query, invalidate all itm
+void query_context_reset( QueryContext &ctx ){
+	ctx.generation ++;
+	ctx.arena_top = 0;
+	ctx.pq.clear();
+	ctx.rstset.clear();
+	ctx.rstlow.clear();
+	ctx.cursor.clear();
+	ctx.route.clear();
+	ctx.route_off.clear();
+}
+
+// itm of tree node tn, allocated from the arena(a second call in the same query reuses the slot)
+int* itm_alloc( QueryContext &ctx, int tn, int size ){
+	if ( ctx.itm_stamp[tn] == ctx.generation ){
+		return &ctx.arena[0] + ctx.itm_off[tn];
+	}
+	if ( ctx.arena_top + size > ctx.arena.size() ){
+		ctx.arena.resize( ctx.arena_top + size );
+	}
+	ctx.itm_stamp[tn] = ctx.generation;
+	ctx.itm_off[tn] = ctx.arena_top;
+	ctx.arena_top += size;
+	return &ctx.arena[0] + ctx.itm_off[tn];
+}
+
+#define ITM(ctx,tn) (&(ctx).arena[0] + (ctx).itm_off[tn])
+
+// ----- CORE PART -----
+// knn search
+// input: locid = query location, node id
+//        K = top-K
+// output: a vector of ResultSet, each is a tuple (node id, shortest path), ranked by shortest path distance from query location
+// init upstream: itm of every tree node on the gtreepath of locid(except root)
+void knn_upstream( QueryContext &ctx, int locid ){
+	const int* locpath = FG_PATH(locid);
+	int locpath_size = FG_PATH_SIZE(locid);
+
+	// intermediate answer, tree node -> array, kept in ctx
+	int tn, cid, posa;
+	int *itm_tn;
+	long long cells = 0;
+	for ( int i = locpath_size - 1; i > 0; i-- ){
+		tn = locpath[i];
+		const FrozenTreeNode &tnode = FG_NODE(tn);
+		const int* pmind = FG_ARRAY(tn, pmind);
+		itm_tn = itm_alloc( ctx, tn, tnode.nborders );
+
+		if ( tnode.isleaf ){
+			// locid to the borders, rpmind is pmind unless directed
+			const int* rpmind = FG_ARRAY(tn, rpmind);
+			const int* leafnodes = FG_ARRAY(tn, leafnodes);
+			if ( ctx.src.size() == 0 ){
+				posa = lower_bound( leafnodes, leafnodes + tnode.nleafnodes, locid ) - leafnodes;
+
+				fg_row( rpmind, posa, tnode.nborders, 0, 1, 0, tnode.nborders, itm_tn );
+				cells += tnode.nborders;
+			}
+			// seeded sources(edge location): min over their rows + offsets, all rows in this one leaf
+			else{
+				vector<int> &row = ctx.leafrow;
+				row.resize( tnode.nborders );
+				for ( int j = 0; j < tnode.nborders; j++ ) itm_tn[j] = MINPLUS_INF;
+				for ( int k = 0; k < ctx.src.size(); k++ ){
+					posa = lower_bound( leafnodes, leafnodes + tnode.nleafnodes, ctx.src[k].first ) - leafnodes;
+					fg_row( rpmind, posa, tnode.nborders, 0, 1, 0, tnode.nborders, &row[0] );
+					for ( int j = 0; j < tnode.nborders; j++ ) itm_tn[j] = min( itm_tn[j], minplus_cap( row[j] + ctx.src[k].second ) );
+				}
+				cells += (long long) ctx.src.size() * tnode.nborders;
+			}
+		}
+		else{
+			cid = locpath[i+1];
+			const FrozenTreeNode &cnode = FG_NODE(cid);
+			const int* pcurrent_pos = FG_ARRAY(tn, pcurrent_pos);
+			const int* itm_cid = ITM(ctx, cid);
+			for ( int j = 0; j < tnode.nborders; j++ ){
+				// row of border j, columns of child cid
+				posa = pcurrent_pos[j];
+				itm_tn[j] = minplus_cap( fg_minplus( itm_cid, pmind, posa, tnode.nunion_borders, cnode.up_off, tnode.nchildren, cnode.cpos, cnode.nborders ) );
+			}
+			cells += (long long) tnode.nborders * cnode.nborders;
+		}
+	}
+	stats_count( ctx.stats, QC_CELLS, cells );
+}
+
+// no distance bound(knn_search maxdist)
+#define NO_DIST_BOUND 0x7fffffff
+
+// push to search heap, entries whose lower bound exceeds maxdist can never be an answer,
+// nor can unreachable ones(directed graphs)
+inline void knn_push( vector<Status_query> &pq, const Status_query &status, int maxdist ){
+	if ( status.dis > maxdist || status.dis >= MINPLUS_INF ) return;
+	pq.push_back(status);
+	push_heap( pq.begin(), pq.end(), Status_query_comp() );
+}
+
+// ----- APPROXIMATE KNN -----
+// knn_query eps > 0: an object goes into the heap at its distance / (1 + eps), node entries at their lower
+// bounds as before, so an object comes out once no entry left can be nearer than distance / (1 + eps).
+// every object not out yet is at least the heap top away, thus the i-th answer is at most 1 + eps times
+// the distance of the true i-th nearest object(rstlow[i] = that bound, answers keep their exact distance)
+// and the search stops on fewer tree nodes. eps = 0 is the exact search
+inline void knn_push_vertex( QueryContext &ctx, Status_query status, int maxdist ){
+	if ( status.dis > maxdist ) return;
+	status.exact = status.dis;
+	if ( ctx.eps > 0 && status.dis < MINPLUS_INF ) status.dis = (int)( status.dis / ( 1 + ctx.eps ) );
+	knn_push( ctx.pq, status, maxdist );
+}
+
+// end e of an object on an edge, the end's vertex at dis(see EDGE LOCATIONS)
+inline void edge_push( QueryContext &ctx, const ObjectLayer &layer, const EdgeEnd &e, int dis, int lca_pos, int maxdist ){
+	if ( dis >= MINPLUS_INF || ! attr_match( layer.edgeobj[e.obj].attr, ctx.want ) ) return;
+	if ( ctx.eseen.size() < layer.edgeobj.size() ) ctx.eseen.resize( layer.edgeobj.size(), 0 );
+	Status_query status = { (int) Nodes.size() + e.obj, true, lca_pos, dis + e.delta };
+	knn_push_vertex( ctx, status, maxdist );
+}
+
+// objects on the edge of the query location, straight along it
+void edge_push_along( QueryContext &ctx, const ObjectLayer &layer, int maxdist ){
+	unordered_map< int, vector<int> >::const_iterator it = layer.onedge.find( ctx.src_edge );
+	if ( it == layer.onedge.end() ) return;
+	for ( int i = 0; i < it->second.size(); i++ ){
+		EdgeEnd e = { 0, 0, it->second[i] };
+		edge_push( ctx, layer, e, edge_along( ctx.src_off, layer.edgeobj[e.obj].off ), 0, maxdist );
+	}
+}
+
+// medium-lazy expansion of a leaf off the gtreepath with leafsorted lists: a merge of its border lists by
+// itm + mind, so objects come up in increasing distance and the first time an object comes up
+// its distance is exact(later ones are skipped). objects are pushed while no other heap entry is
+// nearer and fewer than need are out, then the rest goes back as one entry at the next distance.
+void leaf_stream( QueryContext &ctx, const ObjectLayer &layer, const Status_query &top, int need, int maxdist, long long &cells ){
+	vector<Status_query> &pq = ctx.pq;
+	int tn = top.id;
+	const FrozenTreeNode &tnode = FG_NODE(tn);
+	const int* mind = FG_ARRAY(tn, mind);
+	const int* leafnodes = FG_ARRAY(tn, leafnodes);
+	const int* itm = ITM(ctx, tn);
+	const int* sorted = layer.leafsorted[tn].data();
+	int m = OCC_LEAF_SIZE(layer, tn);
+	if ( ! top.stream ){
+		ctx.cursor_off[tn] = ctx.cursor.size();
+		ctx.cursor.resize( ctx.cursor.size() + tnode.nborders, 0 );
+	}
+	int* cursor = &ctx.cursor[0] + ctx.cursor_off[tn];
+	int limit = pq.size() > 0 ? pq[0].dis : MINPLUS_INF;
+	for ( int pushed = 0; ; pushed++ ){
+		int best = MINPLUS_INF, bestb = -1;
+		for ( int b = 0; b < tnode.nborders; b++ ){
+			const int* list = sorted + (long long) b * m;
+			while ( cursor[b] < m ){
+				int v = leafnodes[ list[cursor[b]] ];
+				if ( ctx.seen[v] != ctx.generation ){
+					if ( vertex_match( layer, v, ctx.want ) ) break;
+					ctx.seen[v] = ctx.generation;
+				}
+				cursor[b] ++;
+			}
+			if ( cursor[b] == m ) continue;
+			int dis = itm[b] + mind[ (long long) b * tnode.nleafnodes + list[cursor[b]] ];
+			if ( dis < best ){
+				best = dis;
+				bestb = b;
+			}
+		}
+		cells += tnode.nborders;
+		if ( bestb == -1 ) return;
+		if ( pushed >= need || best > limit ){
+			Status_query rest = { tn, false, top.lca_pos, best, 1 };
+			knn_push( pq, rest, maxdist );
+			return;
+		}
+		int vertex = leafnodes[ sorted[ (long long) bestb * m + cursor[bestb] ] ];
+		ctx.seen[vertex] = ctx.generation;
+		cursor[bestb] ++;
+		Status_query status = { vertex, true, top.lca_pos, best };
+		knn_push_vertex( ctx, status, maxdist );
+	}
+}
+
+// itm of child, off the gtreepath of locid below the node at lca_pos(son is the next one on the path):
+// from the itm of son for a brother of son, from the itm of the father otherwise. returns the min of it
+int child_itm( QueryContext &ctx, int child, int son, long long &cells ){
+	const FrozenTreeNode &childnode = FG_NODE(child);
+	int father = childnode.father;
+	const FrozenTreeNode &topnode = FG_NODE(father);
+	int* itm_child = itm_alloc( ctx, child, childnode.nborders );
+	int allmin = MINPLUS_INF;
+	int posa, min;
+	// brothers
+	if ( FG_NODE(son).father == father ){
+		const int* pmind = FG_ARRAY(father, pmind);
+		const FrozenTreeNode &sonnode = FG_NODE(son);
+		const int* itm_son = ITM(ctx, son);
+		for ( int j = 0; j < childnode.nborders; j++ ){
+			// row of child border j, columns of son
+			posa = childnode.up_off + j;
+			min = minplus_cap( fg_minplus( itm_son, pmind, posa, topnode.nunion_borders, sonnode.up_off, topnode.nchildren, sonnode.cpos, sonnode.nborders ) );
+			itm_child[j] = min;
+			// update all min
+			allmin = min < allmin ? min : allmin;
+		}
+		cells += (long long) childnode.nborders * sonnode.nborders;
+	}
+	// downstream
+	else{
+		const int* down_mind = FG_ARRAY(father, down_mind);
+		const int* itm_top = ITM(ctx, father);
+		for ( int j = 0; j < childnode.nborders; j++ ){
+			// row of child border j, columns of top borders
+			posa = childnode.up_off + j;
+			min = minplus_cap( fg_minplus( itm_top, down_mind, posa, topnode.nborders, 0, 1, 0, topnode.nborders ) );
+			itm_child[j] = min;
+			// update all min
+			allmin = min < allmin ? min : allmin;
+		}
+		cells += (long long) childnode.nborders * topnode.nborders;
+	}
+	return allmin;
+}
+
+// one step of the best first search from the root(knn_search): pop the nearest heap entry and expand it,
+// false once the search is over. needs itm of the gtreepath of locid(knn_upstream) and knn_search_begin
+bool knn_search_step( QueryContext &ctx, const ObjectLayer &layer, int locid, int K, int maxdist ){
+	vector<Status_query> &pq = ctx.pq;
+	vector<ResultSet> &rstset = ctx.rstset;
+	const int* locpath = FG_PATH(locid);
+	vector<int> &cands = ctx.cands;
+	vector<int> &result = ctx.dres;
+	int posa, child, son, allmin, vertex;
+	long long t0;
+
+	if ( pq.size() == 0 || rstset.size() >= K ) return false;
+	Status_query top = pq[0];
+	pop_heap( pq.begin(), pq.end(), Status_query_comp() );
+	pq.pop_back();
+	ctx.pops ++;
+
+	// exact itm of a child pushed at its lower bound, back at its distance
+	if ( top.lazy ){
+		t0 = STATS_TICK(ctx);
+		Status_query status = { top.id, false, top.lca_pos, child_itm( ctx, top.id, locpath[ top.lca_pos + 1 ], ctx.cells ) };
+		stats_add( ctx.stats, QS_MINPLUS, STATS_TICK(ctx) - t0 );
+		knn_push( pq, status, maxdist );
+		return true;
+	}
+
+	if ( top.isvertex ){
+		// an object on an edge comes up once per end, the first is its distance
+		if ( top.id >= (int) Nodes.size() ){
+			int j = top.id - Nodes.size();
+			if ( ctx.eseen[j] == ctx.generation ) return true;
+			ctx.eseen[j] = ctx.generation;
+		}
+		ResultSet rs = { top.id, top.exact };
+		rstset.push_back(rs);
+		if ( ctx.eps > 0 ) ctx.rstlow.push_back( pq.size() > 0 && pq[0].dis < top.exact ? pq[0].dis : top.exact );
+	}
+	else{
+		const FrozenTreeNode &topnode = FG_NODE(top.id);
+		const int* pmind = FG_ARRAY(top.id, pmind);
+		const int* itm_top = ITM(ctx, top.id);
+		if ( ! top.stream ) ctx.nodes ++;
+
+		if ( topnode.isleaf ){
+			const int* leafnodes = FG_ARRAY(top.id, leafnodes);
+			const int* leafinvlist = OCC_LEAF(layer, top.id);
+			int nleafinvlist = OCC_LEAF_SIZE(layer, top.id);
+			const vector<EdgeEnd> &ends = layer.leafedge[top.id];
+			if ( ctx.track && ! top.stream ) ctx.deps.push_back( top.id );
+			if ( ! top.stream ) leaf_heat_touch( top.id );
+
+			// objects on edges with an end here, at the first expansion(the leaf of locid below)
+			if ( top.id != locpath[top.lca_pos] && ! top.stream && ends.size() > 0 ){
+				t0 = STATS_TICK(ctx);
+				for ( int i = 0; i < ends.size(); i++ ){
+					int dis = minplus_cap( fg_minplus( itm_top, pmind, ends[i].posa, topnode.nborders, 0, 1, 0, topnode.nborders ) );
+					edge_push( ctx, layer, ends[i], dis, top.lca_pos, maxdist );
+				}
+				stats_add( ctx.stats, QS_MINPLUS, STATS_TICK(ctx) - t0 );
+				ctx.cells += (long long) ends.size() * topnode.nborders;
+			}
+
+			// inner of leaf node, do dijkstra
+			if ( top.id == locpath[top.lca_pos] ){
+				
+				cands.clear();
+				for ( int i = 0; i < nleafinvlist; i++ ){
+					if ( vertex_match( layer, leafnodes[leafinvlist[i]], ctx.want ) ) cands.push_back( leafnodes[leafinvlist[i]] );
+				}
+				int nvertex = cands.size();
+				for ( int i = 0; i < ends.size(); i++ ) cands.push_back( leafnodes[ ends[i].posa ] );
+				result.resize( cands.size() );
+				if ( cands.size() > 0 ){
+					t0 = STATS_TICK(ctx);
+					dijkstra_candidate( ctx.heap, locid, &cands[0], cands.size(), *FGGraph, &result[0], ctx.pred.size() > 0 ? &ctx.pred[0] : NULL, &ctx.src );
+					stats_add( ctx.stats, QS_DIJKSTRA, STATS_TICK(ctx) - t0 );
+				}
+				for ( int i = 0; i < nvertex; i++ ){
+					Status_query status = { cands[i], true, top.lca_pos, result[i] };
+					knn_push_vertex( ctx, status, maxdist );
+				}
+				for ( int i = 0; i < ends.size(); i++ ) edge_push( ctx, layer, ends[i], result[nvertex + i], top.lca_pos, maxdist );
+				
+			}
+
+			// objects in increasing distance, as many as can be answers now
+			else if ( layer.leafsorted[top.id].size() > 0 ){
+				t0 = STATS_TICK(ctx);
+				leaf_stream( ctx, layer, top, K - rstset.size(), maxdist, ctx.cells );
+				stats_add( ctx.stats, QS_MINPLUS, STATS_TICK(ctx) - t0 );
+			}
+
+			// else do 
+			else{
+				t0 = STATS_TICK(ctx);
+				for ( int i = 0; i < nleafinvlist; i++ ){
+					posa = leafinvlist[i];
+					vertex = leafnodes[posa];
+					if ( ! vertex_match( layer, vertex, ctx.want ) ) continue;
+					allmin = fg_minplus( itm_top, pmind, posa, topnode.nborders, 0, 1, 0, topnode.nborders );
+
+					Status_query status = { vertex, true, top.lca_pos, allmin };
+					knn_push_vertex( ctx, status, maxdist );
+
+				}
+				stats_add( ctx.stats, QS_MINPLUS, STATS_TICK(ctx) - t0 );
+				ctx.cells += (long long) nleafinvlist * topnode.nborders;
+			}
+		}
+		else{
+			const int* nonleafinvlist = OCC_NONLEAF(layer, top.id);
+			int nnonleafinvlist = OCC_NONLEAF_SIZE(layer, top.id);
+			son = locpath[ top.lca_pos + 1 ];
+			int sonmin = -1;
+			// children not pushed: an object there could be nearer than any answer
+			if ( ctx.track ){
+				const int* children = FG_ARRAY(top.id, children);
+				for ( int i = 0; i < topnode.nchildren; i++ ){
+					if ( layer.count[ children[i] ] == 0 || ! attr_match( layer.mask[ children[i] ], ctx.want ) ) ctx.deps.push_back( children[i] );
+				}
+			}
+			// children go in at a lower bound, their itm is computed when popped(child_itm)
+			for ( int i = 0; i < nnonleafinvlist; i++ ){
+				child = nonleafinvlist[i];
+				// no object of the filter below
+				if ( ! attr_match( layer.mask[child], ctx.want ) ) continue;
+				const FrozenTreeNode &childnode = FG_NODE(child);
+				// on gtreepath
+				if ( child == son ){
+					Status_query status = { child, false, top.lca_pos + 1, 0 };
+					knn_push( pq, status, maxdist );
+				}
+				// brothers: min of itm of son + nearest border pair
+				else if ( childnode.father == FG_NODE(son).father ){
+					const FrozenTreeNode &sonnode = FG_NODE(son);
+					if ( sonmin < 0 ){
+						const int* itm_son = ITM(ctx, son);
+						sonmin = MINPLUS_INF;
+						for ( int j = 0; j < sonnode.nborders; j++ ) sonmin = itm_son[j] < sonmin ? itm_son[j] : sonmin;
+					}
+					int bound = FGBounds->cross[ FGBounds->cross_off[top.id] + sonnode.cpos * topnode.nchildren + childnode.cpos ];
+					Status_query status = { child, false, top.lca_pos, sonmin + bound, 0, 1 };
+					knn_push( pq, status, maxdist );
+				}
+				// downstream: top.dis is the min of itm of top
+				else{
+					Status_query status = { child, false, top.lca_pos, top.dis + FGBounds->down[child], 0, 1 };
+					knn_push( pq, status, maxdist );
+				}
+			}
+		}
+		
+	}
+	return true;
+}
+
+void knn_search_begin( QueryContext &ctx, unsigned want = 0, double eps = 0 ){
+	Status_query rootstatus = { 0, false, 0, 0 };
+	ctx.pq.push_back( rootstatus );
+	make_heap( ctx.pq.begin(), ctx.pq.end(), Status_query_comp() );
+	ctx.pops = ctx.nodes = ctx.cells = 0;
+	ctx.want = want;
+	ctx.eps = eps;
+}
+
+void knn_search_end( QueryContext &ctx ){
+	// stats: every push is popped or still queued at the end
+	stats_count( ctx.stats, QC_NODES, ctx.nodes );
+	stats_count( ctx.stats, QC_PUSHES, ctx.pops + ctx.pq.size() );
+	stats_count( ctx.stats, QC_CELLS, ctx.cells );
+	stats_count( ctx.stats, QC_RESULTS, ctx.rstset.size() );
+}
+
+// best first search from the root, needs itm of the gtreepath of locid(knn_upstream)
+// answers are the K nearest objects within maxdist matching want(within 1 + eps, see APPROXIMATE KNN)
+const vector<ResultSet>& knn_search( QueryContext &ctx, const ObjectLayer &layer, int locid, int K, int maxdist, unsigned want = 0, double eps = 0 ){
+	knn_search_begin( ctx, want, eps );
+	if ( ctx.src_edge >= 0 ) edge_push_along( ctx, layer, maxdist );
+	while( knn_search_step( ctx, layer, locid, K, maxdist ) );
+	knn_search_end( ctx );
+	return ctx.rstset;
+}
+
+// prefetch for the next step of ctx in two stages, a while apart(knn_batch_interleave):
+// the tree node of the heap top and its occurrence lists, then(node in cache) what the step reads from them
+inline void knn_prefetch_node( const QueryContext &ctx, const ObjectLayer &layer ){
+	if ( ctx.pq.size() == 0 || ctx.pq[0].isvertex ) return;
+	int tn = ctx.pq[0].id;
+	__builtin_prefetch( &FG_NODE(tn) );
+	__builtin_prefetch( &layer.leafinv[tn] );
+	__builtin_prefetch( &layer.nonleafinv[tn] );
+	__builtin_prefetch( &layer.leafsorted[tn] );
+}
+
+inline void knn_prefetch_rows( const QueryContext &ctx, const ObjectLayer &layer ){
+	if ( ctx.pq.size() == 0 || ctx.pq[0].isvertex ) return;
+	const Status_query &top = ctx.pq[0];
+	const FrozenTreeNode &t = FG_NODE(top.id);
+	if ( top.lazy ){
+		// child_itm: the rows of the child in its father's pmind or down_mind
+		const FrozenTreeNode &f = FG_NODE(t.father);
+		__builtin_prefetch( &ctx.arena[0] + ctx.itm_off[t.father] );
+		if ( ! FGTree.packed ){
+			__builtin_prefetch( FG_ARRAY(t.father, pmind) + (long long) t.up_off * f.nunion_borders );
+			__builtin_prefetch( FG_ARRAY(t.father, down_mind) + (long long) t.up_off * f.nborders );
+		}
+		return;
+	}
+	__builtin_prefetch( &ctx.arena[0] + ctx.itm_off[top.id] );
+	if ( t.isleaf ){
+		__builtin_prefetch( OCC_LEAF(layer, top.id) );
+		__builtin_prefetch( layer.leafsorted[top.id].data() );
+		__builtin_prefetch( FG_ARRAY(top.id, leafnodes) );
+		__builtin_prefetch( FG_ARRAY(top.id, pmind) );
+	}
+	else{
+		const int* children = OCC_NONLEAF(layer, top.id);
+		for ( int i = 0; i < OCC_NONLEAF_SIZE(layer, top.id); i++ ) __builtin_prefetch( &FG_NODE(children[i]) );
+	}
+}
+
+// ----- RESULT CACHE -----
+// -R N: the answers of up to N exact knn_query calls, keyed by (locid, K, layer, filter, maxdist), for the
+// few vertices(stations, malls) asked again and again. an entry keeps the stamps of the tree nodes its
+// search depends on(ctx.deps): the leaves it opened, and the children of expanded nodes it did not push as
+// they held no object(of the filter). an object change in a leaf restamps the leaf and the nodes it makes
+// non empty or whose mask it extends(layer_touch), so it stales the entries that opened the leaf or skipped
+// a subtree the object is in. other entries stay exact: a pushed subtree never opened is at least as far
+// as the K-th answer. an entry of an older index snapshot(FGVersion) is stale too.
+// RESULT_CACHE_SHARDS LRU lists by key hash, each under its own mutex, N / RESULT_CACHE_SHARDS entries each
+#define RESULT_CACHE_SHARDS 16
+
+typedef struct{
+	const ObjectLayer* layer;
+	int locid, K, maxdist;
+	unsigned want;
+}CacheKey;
+
+struct CacheKeyHash{
+	size_t operator()( const CacheKey &k ) const{
+		size_t h = (size_t) k.layer;
+		h = h * 1000003 ^ k.locid;
+		h = h * 1000003 ^ k.K;
+		h = h * 1000003 ^ k.maxdist;
+		return h * 1000003 ^ k.want;
+	}
+};
+
+struct CacheKeyEqual{
+	bool operator()( const CacheKey &a, const CacheKey &b ) const{
+		return a.layer == b.layer && a.locid == b.locid && a.K == b.K && a.maxdist == b.maxdist && a.want == b.want;
+	}
+};
+
+typedef struct{
+	CacheKey key;
+	int version;
+	vector< pair<int,unsigned> > deps; // tree node, its stamp when searched
+	vector<ResultSet> result;
+}CacheEntry;
+
+typedef struct{
+	pthread_mutex_t lock;
+	list<CacheEntry> lru; // newest first
+	unordered_map< CacheKey, list<CacheEntry>::iterator, CacheKeyHash, CacheKeyEqual > map;
+}CacheShard;
+
+int result_cache_size = 0; // entries, 0 = no cache
+CacheShard result_cache[RESULT_CACHE_SHARDS];
+
+void result_cache_init( int entries ){
+	result_cache_size = entries;
+	for ( int i = 0; i < RESULT_CACHE_SHARDS; i++ ) pthread_mutex_init( &result_cache[i].lock, NULL );
+}
+
+inline CacheShard& result_cache_shard( const CacheKey &key ){
+	return result_cache[ CacheKeyHash()( key ) % RESULT_CACHE_SHARDS ];
+}
+
+// answers of key into ctx.rstset, false if none or stale. caller holds layer.lock for reading
+bool result_cache_find( QueryContext &ctx, const ObjectLayer &layer, const CacheKey &key ){
+	CacheShard &shard = result_cache_shard( key );
+	pthread_mutex_lock( &shard.lock );
+	auto it = shard.map.find( key );
+	bool hit = it != shard.map.end();
+	if ( hit ){
+		CacheEntry &e = *it->second;
+		hit = e.version == FGVersion;
+		for ( int i = 0; hit && i < e.deps.size(); i++ ) hit = layer.stamp[ e.deps[i].first ] == e.deps[i].second;
+		if ( hit ){
+			ctx.rstset = e.result;
+			shard.lru.splice( shard.lru.begin(), shard.lru, it->second );
+		}
+		else{
+			shard.lru.erase( it->second );
+			shard.map.erase( it );
+			stats_count( ctx.stats, QC_CACHE_STALE, 1 );
+		}
+	}
+	pthread_mutex_unlock( &shard.lock );
+	if ( hit ) stats_count( ctx.stats, QC_CACHE_HITS, 1 );
+	return hit;
+}
+
+// the answers of the search just done on ctx(with ctx.track), caller holds layer.lock for reading
+void result_cache_put( QueryContext &ctx, const ObjectLayer &layer, const CacheKey &key ){
+	sort( ctx.deps.begin(), ctx.deps.end() );
+	ctx.deps.erase( unique( ctx.deps.begin(), ctx.deps.end() ), ctx.deps.end() );
+	CacheEntry e;
+	e.key = key;
+	e.version = FGVersion;
+	e.deps.reserve( ctx.deps.size() );
+	for ( int i = 0; i < ctx.deps.size(); i++ ) e.deps.push_back( make_pair( ctx.deps[i], layer.stamp[ ctx.deps[i] ] ) );
+	e.result = ctx.rstset;
+	CacheShard &shard = result_cache_shard( key );
+	int cap = max( 1, result_cache_size / RESULT_CACHE_SHARDS ), evicted = 0;
+	pthread_mutex_lock( &shard.lock );
+	auto it = shard.map.find( key );
+	if ( it != shard.map.end() ){
+		shard.lru.erase( it->second );
+		shard.map.erase( it );
+	}
+	shard.lru.push_front( CacheEntry() );
+	swap( shard.lru.front(), e );
+	shard.map[key] = shard.lru.begin();
+	while( shard.lru.size() > cap ){
+		shard.map.erase( shard.lru.back().key );
+		shard.lru.pop_back();
+		evicted ++;
+	}
+	pthread_mutex_unlock( &shard.lock );
+	stats_count( ctx.stats, QC_CACHE_EVICTIONS, evicted );
+}
+
+// ctx = per thread scratch(see QueryContext), the returned reference is valid until the next query on ctx
+// layer = object category to search
+// maxdist = distance bound(same unit as edge weight * WEIGHT_INFLATE_FACTOR), answers farther away are dropped
+// want = attribute filter, only objects whose mask has all bits of want are answers(0 = all)
+// eps > 0 = approximate, the i-th answer within 1 + eps of the true i-th nearest(see APPROXIMATE KNN)
+const vector<ResultSet>& knn_query( QueryContext &ctx, ObjectLayer &layer, int locid, int K, int maxdist = NO_DIST_BOUND, unsigned want = 0, double eps = 0 ){
+	// init priority queue & result set
+	IndexPin pin;
+	query_context_reset( ctx );
+	stats_begin( ctx.stats );
+	long long t0 = STATS_TICK(ctx), allocs = ALLOC_NOW;
+	CacheKey key = { &layer, locid, K, maxdist, want };
+	bool cache = result_cache_size > 0 && eps == 0 && ! ctx.routes && ctx.src_edge < 0;
+	if ( cache ){
+		pthread_rwlock_rdlock( &layer.lock );
+		bool hit = result_cache_find( ctx, layer, key );
+		pthread_rwlock_unlock( &layer.lock );
+		if ( hit ){
+			stats_add( ctx.stats, QS_TOTAL, STATS_TICK(ctx) - t0 );
+			stats_count( ctx.stats, QC_ALLOCS, ALLOC_NOW - allocs );
+			stats_end( ctx.stats, QS_PHASES );
+			return ctx.rstset;
+		}
+	}
+	knn_upstream( ctx, locid );
+	long long t1 = STATS_TICK(ctx);
+	pthread_rwlock_rdlock( &layer.lock );
+	ctx.track = cache;
+	ctx.deps.clear();
+	knn_search( ctx, layer, locid, K, maxdist, want, eps );
+	if ( cache ) result_cache_put( ctx, layer, key );
+	ctx.track = false;
+	pthread_rwlock_unlock( &layer.lock );
+	long long t2 = STATS_TICK(ctx);
+	stats_add( ctx.stats, QS_UPSTREAM, t1 - t0 );
+	stats_add( ctx.stats, QS_SEARCH, t2 - t1 );
+	stats_add( ctx.stats, QS_TOTAL, t2 - t0 );
+	stats_count( ctx.stats, QC_ALLOCS, ALLOC_NOW - allocs );
+	stats_end( ctx.stats, QS_PHASES );
+	return ctx.rstset;
+}
+
+// range search: all objects within R of locid, ranked by distance
+const vector<ResultSet>& range_query( QueryContext &ctx, ObjectLayer &layer, int locid, int R ){
+	return knn_query( ctx, layer, locid, NO_DIST_BOUND, R );
+}
+
+// knn_query from a location on an edge, off in the weight unit(see EDGE LOCATIONS, edge_offset), eid valid
+const vector<ResultSet>& knn_query_edge( QueryContext &ctx, ObjectLayer &layer, int eid, int off, int K, int maxdist = NO_DIST_BOUND, unsigned want = 0 ){
+	IndexPin pin; // both ends and the searches in one snapshot
+	vector< pair<int,int> > ends;
+	edge_sources( eid, off, ends );
+	int pa, pb;
+	ctx.src_edge = eid;
+	ctx.src_off = off;
+	if ( ends.size() == 1 || vertex_leaf( ends[0].first, pa ) == vertex_leaf( ends[1].first, pb ) ){
+		ctx.src = ends;
+		knn_query( ctx, layer, ends[0].first, K, maxdist, want );
+	}
+	// cut edge: one search per end, the nearer distance of an object found by both
+	else{
+		vector<ResultSet> both;
+		for ( int k = 0; k < ends.size(); k++ ){
+			ctx.src.assign( 1, ends[k] );
+			const vector<ResultSet> &result = knn_query( ctx, layer, ends[k].first, K, maxdist, want );
+			both.insert( both.end(), result.begin(), result.end() );
+		}
+		sort( both.begin(), both.end(), []( const ResultSet &a, const ResultSet &b ){ return a.id != b.id ? a.id < b.id : a.dis < b.dis; } );
+		ctx.rstset.clear();
+		for ( int i = 0; i < both.size(); i++ ){
+			if ( i == 0 || both[i].id != both[i-1].id ) ctx.rstset.push_back( both[i] );
+		}
+		stable_sort( ctx.rstset.begin(), ctx.rstset.end(), []( const ResultSet &a, const ResultSet &b ){ return a.dis < b.dis; } );
+		if ( ctx.rstset.size() > K ) ctx.rstset.resize( K );
+	}
+	ctx.src.clear();
+	ctx.src_edge = -1;
+	return ctx.rstset;
+}
+
+// "ID=vertex", or "EDGE=edge OFF=offset" for an object on an edge, then " DIS=d"
+void answer_print( const ObjectLayer &layer, const ResultSet &rs ){
+	if ( rs.id < (int) Nodes.size() ) printf("ID=%d", rs.id );
+	else{
+		const EdgeObject &e = layer.edgeobj[ rs.id - Nodes.size() ];
+		printf("EDGE=%d OFF=%g", e.eid, (double) e.off / WEIGHT_INFLATE_FACTOR );
+	}
+	printf(" DIS=%d", rs.dis );
+}
+
+// band_end[b] = end of the answers of result(ranked by distance) within radii[b]
+void band_ends( const vector<ResultSet> &result, const vector<int> &radii, vector<int> &band_end ){
+	band_end.assign( radii.size(), 0 );
+	int i = 0;
+	for ( int b = 0; b < radii.size(); b++ ){
+		while( i < result.size() && result[i].dis <= radii[b] ) i ++;
+		band_end[b] = i;
+	}
+}
+
+// range search over several radii(ascending) in one search up to the largest, answers ranked by
+// distance as range_query, band b = [band_end[b-1], band_end[b])
+const vector<ResultSet>& multi_range_query( QueryContext &ctx, ObjectLayer &layer, int locid, const vector<int> &radii, vector<int> &band_end ){
+	const vector<ResultSet> &result = range_query( ctx, layer, locid, radii.back() );
+	band_ends( result, radii, band_end );
+	return result;
+}
+
+// isochrones: the vertices within each of radii(ascending) of locid as multi_range_query, id = vertex.
+// every vertex inside is an answer, so one dijkstra on the graph of the snapshot up to the largest radius
+// enumerates them, the tree has nothing to prune
+const vector<ResultSet>& isochrone_query( QueryContext &ctx, int locid, const vector<int> &radii, vector<int> &band_end ){
+	IndexPin pin;
+	query_context_reset( ctx );
+	const CsrGraph &graph = *FGGraph;
+	const int maxdist = radii.back();
+	DHeap &h = ctx.heap;
+	dheap_reset( h );
+	dheap_push( h, locid, 0 );
+	while( h.size > 0 ){
+		int v = dheap_pop( h );
+		int dis = h.key[v];
+		ResultSet rs = { v, dis };
+		ctx.rstset.push_back( rs );
+		const int* adjnodes = &graph.target[0] + graph.offset[v];
+		const int* adjweight = &graph.weight[0] + graph.offset[v];
+		int degree = CSR_DEGREE(graph, v);
+		for ( int i = 0; i < degree; i++ ){
+			if ( dis + adjweight[i] <= maxdist ) dheap_push( h, adjnodes[i], dis + adjweight[i] );
+		}
+	}
+	band_ends( ctx.rstset, radii, band_end );
+	return ctx.rstset;
+}
+
+// ----- KNN ITERATOR -----
+// the objects of layer in increasing distance from locid, one per next(), for callers that filter
+// answers and cannot tell K in advance: heap and itm stay in ctx between calls, asking for more
+// continues the search where it stopped. while alive it pins the snapshot and holds layer for reading,
+// dropping it costs nothing beyond that(the next query on ctx starts over).
+struct KnnIterator{
+	IndexPin pin;
+	QueryContext &ctx;
+	ObjectLayer &layer;
+	int locid;
+	int maxdist;
+	int taken; // answers returned so far
+	KnnIterator( QueryContext &c, ObjectLayer &l, int v, int md = NO_DIST_BOUND, unsigned want = 0 );
+	KnnIterator( const KnnIterator& ) = delete;
+	~KnnIterator();
+	bool next( ResultSet &rs );
+};
+
+KnnIterator::KnnIterator( QueryContext &c, ObjectLayer &l, int v, int md, unsigned want ) : ctx( c ), layer( l ), locid( v ), maxdist( md ), taken( 0 ){
+	query_context_reset( ctx );
+	stats_begin( ctx.stats );
+	long long t0 = STATS_TICK(ctx);
+	knn_upstream( ctx, locid );
+	stats_add( ctx.stats, QS_UPSTREAM, STATS_TICK(ctx) - t0 );
+	pthread_rwlock_rdlock( &layer.lock );
+	knn_search_begin( ctx, want );
+}
+
+KnnIterator::~KnnIterator(){
+	knn_search_end( ctx );
+	pthread_rwlock_unlock( &layer.lock );
+	stats_end( ctx.stats, QS_PHASES );
+}
+
+// next nearest object, false when there is none(within maxdist)
+bool KnnIterator::next( ResultSet &rs ){
+	long long t0 = STATS_TICK(ctx);
+	while( ctx.rstset.size() == taken && knn_search_step( ctx, layer, locid, taken + 1, maxdist ) );
+	stats_add( ctx.stats, QS_SEARCH, STATS_TICK(ctx) - t0 );
+	if ( ctx.rstset.size() == taken ) return false;
+	rs = ctx.rstset[ taken ++ ];
+	return true;
+}
+
+// ----- ROUTES -----
+// the path of mind entry (a, b) of tree node tn is the path to the vertex before b(via), then the last hop:
+// an edge, the shortcut of the child holding both, or a walk outside tn that is the father's entry.
+// tn at depth of the tree(root = 0), a in the rows and b in the columns of mind:
+// non leaf: both union borders, leaf: a border and b a leaf node. rows and columns are sorted.
+// append the vertices after a up to b to route
+void route_expand( int tn, int depth, int a, int b, vector<int> &route ){
+	if ( a == b ) return;
+	const FrozenTreeNode &node = FG_NODE(tn);
+	const int* rows = node.isleaf ? FG_ARRAY(tn, borders) : FG_ARRAY(tn, union_borders);
+	const int* cols = node.isleaf ? FG_ARRAY(tn, leafnodes) : FG_ARRAY(tn, union_borders);
+	int nrows = node.isleaf ? node.nborders : node.nunion_borders;
+	int ncols = node.isleaf ? node.nleafnodes : node.nunion_borders;
+	int row = lower_bound( rows, rows + nrows, a ) - rows;
+	int col = lower_bound( cols, cols + ncols, b ) - cols;
+	int v = FG_ARRAY(tn, via)[ (long long) row * ncols + col ];
+	int p = cols[ v < 0 ? ~v : v ];
+
+	if ( p != b ) route_expand( tn, depth, a, p, route );
+	if ( v < 0 ){
+		route_expand( node.father, depth - 1, p, b, route );
+	}
+	else if ( ! node.isleaf && p != b && FG_PATH(p)[depth + 1] == FG_PATH(b)[depth + 1] ){
+		route_expand( FG_PATH(p)[depth + 1], depth + 1, p, b, route );
+	}
+	else{
+		route.push_back( b );
+	}
+}
+
+// path from leaf node a to border b of leaf tn(directed, the rmind entry), append the vertices after a up to b.
+// rvia is the vertex after a, or ~border where the path comes back into tn after a walk outside(father's entry)
+void route_expand_back( int tn, int depth, int b, int a, vector<int> &route ){
+	const FrozenTreeNode &node = FG_NODE(tn);
+	const int* borders = FG_ARRAY(tn, borders);
+	const int* leafnodes = FG_ARRAY(tn, leafnodes);
+	const int* rvia = FG_ARRAY(tn, rvia) + (long long)( lower_bound( borders, borders + node.nborders, b ) - borders ) * node.nleafnodes;
+	while( a != b ){
+		int w = rvia[ lower_bound( leafnodes, leafnodes + node.nleafnodes, a ) - leafnodes ];
+		int p = leafnodes[ w < 0 ? ~w : w ];
+		if ( p == a ) break; // unreachable
+		if ( w < 0 ) route_expand( node.father, depth - 1, a, p, route );
+		else route.push_back( p );
+		a = p;
+	}
+}
+
+// position j of border with itm[j] + mind(border j, target) == dis
+// mind(border j, target) = mind[ rowpos[j] * stride + col ], rowpos = NULL for rows 0..n-1
+int route_argmin( const int* itm, int n, const int* mind, const int* rowpos, long long stride, int col, int dis ){
+	for ( int j = 0; j < n; j++ ){
+		if ( itm[j] + mind[ (long long)( rowpos != NULL ? rowpos[j] : j ) * stride + col ] == dis ) return j;
+	}
+	return 0;
+}
+
+// route from locid to answer rs of the last knn_search on ctx, appended to ctx.route.
+// walks the min-plus choices of the search back from the answer, they are still in the itm of ctx:
+// leaf of answer, up to the child of the lca, across the lca to the gtreepath of locid, down to locid.
+void route_answer( QueryContext &ctx, int locid, const ResultSet &rs ){
+	vector<int> &route = ctx.route;
+	const int* locpath = FG_PATH(locid);
+	const int* opath = FG_PATH(rs.id);
+	int depth = FG_PATH_SIZE(rs.id) - 1;
+	int leaf = opath[depth], lq = locpath[ FG_PATH_SIZE(locid) - 1 ];
+
+	// same leaf: the leaf dijkstra of knn_search
+	if ( leaf == lq ){
+		int start = route.size();
+		for ( int v = rs.id; v != locid; v = ctx.pred[v] ){
+			route.push_back( v );
+		}
+		route.push_back( locid );
+		reverse( route.begin() + start, route.end() );
+		return;
+	}
+
+	// hops(tn, depth, from, to) from the answer back to locid
+	int c = 1;
+	while( locpath[c] == opath[c] ) c++;
+	vector<int> &hops = ctx.hops;
+	hops.clear();
+
+	// leaf of answer
+	const FrozenTreeNode &lnode = FG_NODE(leaf);
+	const int* leafnodes = FG_ARRAY(leaf, leafnodes);
+	int col = lower_bound( leafnodes, leafnodes + lnode.nleafnodes, rs.id ) - leafnodes;
+	// the row of the answer in pmind(vertex-major), not the column of mind
+	ctx.leafrow.resize( lnode.nborders );
+	fg_row( FG_ARRAY(leaf, pmind), col, lnode.nborders, 0, 1, 0, lnode.nborders, &ctx.leafrow[0] );
+	int j = route_argmin( ITM(ctx, leaf), lnode.nborders, &ctx.leafrow[0], NULL, 1, 0, rs.dis );
+	int t = ITM(ctx, leaf)[j];
+	int x = leaf, k;
+	hops.push_back( leaf ); hops.push_back( depth ); hops.push_back( FG_ARRAY(leaf, borders)[j] ); hops.push_back( rs.id );
+
+	// downstream part, father's borders to x's borders
+	while( depth > c ){
+		int f = opath[depth - 1];
+		const FrozenTreeNode &fnode = FG_NODE(f);
+		k = route_argmin( ITM(ctx, f), fnode.nborders, FG_ARRAY(f, mind), FG_ARRAY(f, current_pos), fnode.nunion_borders, FG_ARRAY(x, up_pos)[j], t );
+		hops.push_back( f ); hops.push_back( depth - 1 ); hops.push_back( FG_ARRAY(f, borders)[k] ); hops.push_back( FG_ARRAY(x, borders)[j] );
+		t = ITM(ctx, f)[k];
+		x = f;
+		j = k;
+		depth --;
+	}
+
+	// across the lca, son's borders to the brother's borders
+	int lca = opath[c - 1], son = locpath[c];
+	const FrozenTreeNode &sonnode = FG_NODE(son);
+	k = route_argmin( ITM(ctx, son), sonnode.nborders, FG_ARRAY(lca, mind), FG_ARRAY(son, up_pos), FG_NODE(lca).nunion_borders, FG_ARRAY(x, up_pos)[j], t );
+	hops.push_back( lca ); hops.push_back( c - 1 ); hops.push_back( FG_ARRAY(son, borders)[k] ); hops.push_back( FG_ARRAY(x, borders)[j] );
+	t = ITM(ctx, son)[k];
+	x = son;
+	j = k;
+
+	// upstream part, child's borders to x's borders
+	while( ! FG_NODE(x).isleaf ){
+		int cid = locpath[depth + 1];
+		const FrozenTreeNode &xnode = FG_NODE(x);
+		const FrozenTreeNode &cnode = FG_NODE(cid);
+		k = route_argmin( ITM(ctx, cid), cnode.nborders, FG_ARRAY(x, mind), FG_ARRAY(cid, up_pos), xnode.nunion_borders, FG_ARRAY(x, current_pos)[j], t );
+		hops.push_back( x ); hops.push_back( depth ); hops.push_back( FG_ARRAY(cid, borders)[k] ); hops.push_back( FG_ARRAY(x, borders)[j] );
+		t = ITM(ctx, cid)[k];
+		x = cid;
+		j = k;
+		depth ++;
+	}
+
+	// leaf of locid, its mind rows are borders: directed, rvia holds locid -> border,
+	// otherwise expand border -> locid and reverse
+	int start = route.size();
+	if ( FGTree.directed ){
+		route.push_back( locid );
+		route_expand_back( lq, depth, FG_ARRAY(lq, borders)[j], locid, route );
+	}
+	else{
+		route.push_back( FG_ARRAY(lq, borders)[j] );
+		route_expand( lq, depth, FG_ARRAY(lq, borders)[j], locid, route );
+		reverse( route.begin() + start, route.end() );
+	}
+
+	for ( int i = hops.size() - 4; i >= 0; i -= 4 ){
+		route_expand( hops[i], hops[i + 1], hops[i + 2], hops[i + 3], route );
+	}
+}
+
+// true if the index holds the paths of mind(built with the .via file)
+bool route_ready(){
+	IndexPin pin;
+	return FGTree.tree_size > 0 && FG_NODE(0).has_via;
+}
+
+// knn_query and the shortest path of every answer, expanded only for the answers returned.
+// route of answer i = ctx.route[ctx.route_off[i], ctx.route_off[i+1]), locid first, answer last.
+// without route_ready() all routes are empty.
+const vector<ResultSet>& knn_query_with_paths( QueryContext &ctx, ObjectLayer &layer, int locid, int K, int maxdist = NO_DIST_BOUND ){
+	if ( ctx.pred.size() != Nodes.size() ){
+		ctx.pred.assign( Nodes.size(), 0 );
+	}
+	IndexPin pin; // the routes come from the snapshot of the query
+	ctx.routes = true;
+	const vector<ResultSet> &result = knn_query( ctx, layer, locid, K, maxdist );
+	ctx.routes = false;
+	ctx.route_off.push_back( 0 );
+	for ( int i = 0; i < result.size(); i++ ){
+		// objects on edges get no route
+		if ( route_ready() && result[i].id < Nodes.size() ) route_answer( ctx, locid, result[i] );
+		ctx.route_off.push_back( ctx.route.size() );
+	}
+	return result;
+}
+
+// convenience version, uses a per thread QueryContext
+vector<ResultSet> knn_query( ObjectLayer &layer, int locid, int K, int maxdist = NO_DIST_BOUND ){
+	thread_local QueryContext ctx;
+	thread_local bool ready = false;
+	if ( !ready ){
+		query_context_init( ctx );
+		ready = true;
+	}
+	return knn_query( ctx, layer, locid, K, maxdist );
+}
+
+// ----- REVERSE KNN -----
+// rknn_query: the objects c of layer custs that have locid among their K nearest objects of layer facs,
+// d(c, locid) <= dk(c) = distance from c to its K-th nearest object of facs(undirected graphs only).
+// a path from c in subtree T to locid outside T leaves T by a border b, and dk(c) <= d(c, b) + dk(b),
+// so if d(locid, b) > dk(b) for every border b of T, no c in T is an answer and T is skipped.
+// d(locid, b) is the itm of T(child_itm), dk(b) comes from the BorderKnn of facs.
+// an object c of a leaf reached is dropped when d(locid, c) > min_b( d(c, b) + dk(b) ), otherwise
+// a knn of c in facs bounded by d(locid, c) decides. a layer as both custs and facs counts c itself.
+
+// knn_query for a caller that holds layer.lock for reading, no phase stats
+const vector<ResultSet>& knn_query_locked( QueryContext &ctx, const ObjectLayer &layer, int locid, int K, int maxdist = NO_DIST_BOUND ){
+	query_context_reset( ctx );
+	knn_upstream( ctx, locid );
+	return knn_search( ctx, layer, locid, K, maxdist );
+}
+
+// BorderKnn of facs for the pinned snapshot, built on ctx if missing or older
+// caller holds facs.lock for reading
+shared_ptr<const BorderKnn> border_knn( QueryContext &ctx, ObjectLayer &facs ){
+	pthread_mutex_lock( &facs.kborder_lock );
+	shared_ptr<const BorderKnn> kb = facs.kborder;
+	if ( kb == NULL || kb->version != FGVersion ){
+		BorderKnn* b = new BorderKnn;
+		b->version = FGVersion;
+		b->slot.assign( Nodes.size(), -1 );
+		for ( int tn = 0; tn < FGTree.tree_size; tn++ ){
+			const int* borders = FG_ARRAY(tn, borders);
+			for ( int j = 0; j < FG_NODE(tn).nborders; j++ ){
+				int v = borders[j];
+				if ( b->slot[v] != -1 ) continue;
+				b->slot[v] = b->dist.size() / RKNN_KMAX;
+				const vector<ResultSet> &rs = knn_query_locked( ctx, facs, v, RKNN_KMAX );
+				for ( int i = 0; i < RKNN_KMAX; i++ ) b->dist.push_back( i < rs.size() ? rs[i].dis : MINPLUS_INF );
+			}
+		}
+		kb.reset( b );
+		facs.kborder = kb;
+	}
+	pthread_mutex_unlock( &facs.kborder_lock );
+	return kb;
+}
+
+// dk of border vertex v, MINPLUS_INF if not known(K > RKNN_KMAX)
+inline int border_kth( const BorderKnn &kb, int v, int K ){
+	return K <= RKNN_KMAX ? kb.dist[ (long long) kb.slot[v] * RKNN_KMAX + K - 1 ] : MINPLUS_INF;
+}
+
+// objects of custs whose K nearest objects of facs include locid, ranked by distance from locid(ResultSet)
+// ctx = per thread scratch as knn_query, check = a second one for the knn of the candidates
+const vector<ResultSet>& rknn_query( QueryContext &ctx, QueryContext &check, ObjectLayer &custs, ObjectLayer &facs, int locid, int K ){
+	IndexPin pin;
+	query_context_reset( ctx );
+	if ( FGTree.directed || K <= 0 ) return ctx.rstset;
+	stats_begin( ctx.stats );
+	long long t0 = STATS_TICK(ctx);
+	knn_upstream( ctx, locid );
+	long long t1 = STATS_TICK(ctx);
+	pthread_rwlock_rdlock( &custs.lock );
+	if ( &facs != &custs ) pthread_rwlock_rdlock( &facs.lock );
+	shared_ptr<const BorderKnn> kb = border_knn( check, facs );
+
+	const int* locpath = FG_PATH(locid);
+	vector<Status_query> &stk = ctx.pq; // depth first, lca_pos as in knn_search
+	vector<ResultSet> &rstset = ctx.rstset;
+	vector<int> &cands = ctx.cands;
+	vector<int> &result = ctx.dres;
+	vector<int> &kbound = ctx.kbound;
+	long long cells = 0, nodes = 0;
+	Status_query rootstatus = { 0, false, 0, 0 };
+	stk.push_back( rootstatus );
+	while( stk.size() > 0 ){
+		Status_query top = stk.back();
+		stk.pop_back();
+		nodes ++;
+		const FrozenTreeNode &topnode = FG_NODE(top.id);
+		if ( topnode.isleaf ){
+			const int* leafnodes = FG_ARRAY(top.id, leafnodes);
+			const int* pmind = FG_ARRAY(top.id, pmind);
+			const int* borders = FG_ARRAY(top.id, borders);
+			const int* leafinvlist = OCC_LEAF(custs, top.id);
+			int nleafinvlist = OCC_LEAF_SIZE(custs, top.id);
+			kbound.resize( topnode.nborders );
+			for ( int j = 0; j < topnode.nborders; j++ ) kbound[j] = border_kth( *kb, borders[j], K );
+			// distance from locid, by dijkstra in the leaf of locid
+			bool inner = top.id == locpath[top.lca_pos];
+			if ( inner ){
+				cands.clear();
+				for ( int i = 0; i < nleafinvlist; i++ ) cands.push_back( leafnodes[leafinvlist[i]] );
+				result.resize( cands.size() );
+				if ( cands.size() > 0 ) dijkstra_candidate( ctx.heap, locid, &cands[0], cands.size(), *FGGraph, &result[0] );
+			}
+			for ( int i = 0; i < nleafinvlist; i++ ){
+				int posa = leafinvlist[i];
+				int dis = inner ? result[i] : fg_minplus( ITM(ctx, top.id), pmind, posa, topnode.nborders, 0, 1, 0, topnode.nborders );
+				if ( dis >= MINPLUS_INF || dis > fg_minplus( &kbound[0], pmind, posa, topnode.nborders, 0, 1, 0, topnode.nborders ) ) continue;
+				const vector<ResultSet> &near = knn_query_locked( check, facs, leafnodes[posa], K, dis );
+				if ( near.size() < K || near[K - 1].dis >= dis ){
+					ResultSet rs = { leafnodes[posa], dis };
+					rstset.push_back( rs );
+				}
+			}
+			cells += (long long) nleafinvlist * topnode.nborders * ( inner ? 1 : 2 );
+			continue;
+		}
+		const int* nonleafinvlist = OCC_NONLEAF(custs, top.id);
+		int son = locpath[ top.lca_pos + 1 ];
+		for ( int i = 0; i < OCC_NONLEAF_SIZE(custs, top.id); i++ ){
+			int child = nonleafinvlist[i];
+			if ( child == son ){
+				Status_query status = { child, false, top.lca_pos + 1, 0 };
+				stk.push_back( status );
+				continue;
+			}
+			child_itm( ctx, child, son, cells );
+			// kept if locid may be among the K nearest beyond one border
+			const int* itm = ITM(ctx, child);
+			const int* borders = FG_ARRAY(child, borders);
+			int j = 0;
+			while ( j < FG_NODE(child).nborders && itm[j] > border_kth( *kb, borders[j], K ) ) j++;
+			if ( j < FG_NODE(child).nborders ){
+				Status_query status = { child, false, top.lca_pos, 0 };
+				stk.push_back( status );
+			}
+		}
+	}
+	if ( &facs != &custs ) pthread_rwlock_unlock( &facs.lock );
+	pthread_rwlock_unlock( &custs.lock );
+	sort( rstset.begin(), rstset.end(), []( const ResultSet &a, const ResultSet &b ){ return a.dis < b.dis || ( a.dis == b.dis && a.id < b.id ); } );
+	long long t2 = STATS_TICK(ctx);
+	stats_count( ctx.stats, QC_NODES, nodes );
+	stats_count( ctx.stats, QC_CELLS, cells );
+	stats_count( ctx.stats, QC_RESULTS, rstset.size() );
+	stats_add( ctx.stats, QS_UPSTREAM, t1 - t0 );
+	stats_add( ctx.stats, QS_SEARCH, t2 - t1 );
+	stats_add( ctx.stats, QS_TOTAL, t2 - t0 );
+	stats_end( ctx.stats, QS_PHASES );
+	return rstset;
+}
+
+// ----- GROUP KNN -----
+// group_knn: the K objects with the least aggregate(sum or max) of the distances from all sources,
+// e.g. a meeting point for a group. one best first search over the tree for the whole group:
+// each source has its own itm(upstream once, then child_itm as in knn_search) in its own context,
+// a tree node goes in at the aggregate of the per source lower bounds(min of its itm, 0 if it holds
+// the source) and an object at the aggregate of its exact distances, so the K first objects out of
+// the heap are the answer. lca_pos of an entry is the depth of the tree node.
+enum{ GROUP_SUM, GROUP_MAX };
+
+// src[i] = context of source i, src[0] also has the heap and the answers. grows to the largest group
+// and keeps its contexts(as QueryContext, one GroupContext per thread)
+typedef struct{
+	deque<QueryContext> src;
+}GroupContext;
+
+// aggregate a so far(from 0) with distance b, NO_DIST_BOUND once a source cannot reach, sums capped below it
+inline int group_agg( int agg, int a, int b ){
+	if ( a == NO_DIST_BOUND || b >= MINPLUS_INF ) return NO_DIST_BOUND;
+	if ( agg == GROUP_MAX ) return a > b ? a : b;
+	long long sum = (long long) a + b;
+	return sum < NO_DIST_BOUND ? (int) sum : NO_DIST_BOUND - 1;
+}
+
+inline bool group_on_path( int locid, int depth, int tn ){
+	return depth < FG_PATH_SIZE(locid) && FG_PATH(locid)[depth] == tn;
+}
+
+inline void group_push( vector<Status_query> &pq, const Status_query &status ){
+	if ( status.dis == NO_DIST_BOUND ) return;
+	pq.push_back( status );
+	push_heap( pq.begin(), pq.end(), Status_query_comp() );
+}
+
+// ranked by aggregate distance(ResultSet.dis), agg = GROUP_SUM or GROUP_MAX
+const vector<ResultSet>& group_knn( GroupContext &g, ObjectLayer &layer, const vector<int> &sources, int K, int agg ){
+	IndexPin pin;
+	int m = sources.size();
+	while ( g.src.size() < max( m, 1 ) ){
+		g.src.push_back( QueryContext() );
+		query_context_init( g.src.back() );
+	}
+	QueryContext &ctx = g.src[0];
+	query_context_reset( ctx );
+	if ( m == 0 ) return ctx.rstset;
+	stats_begin( ctx.stats );
+	long long t0 = STATS_TICK(ctx);
+	for ( int i = 0; i < m; i++ ){
+		if ( i > 0 ) query_context_reset( g.src[i] );
+		knn_upstream( g.src[i], sources[i] );
+	}
+	long long t1 = STATS_TICK(ctx);
+	pthread_rwlock_rdlock( &layer.lock );
+
+	vector<Status_query> &pq = ctx.pq;
+	vector<ResultSet> &rstset = ctx.rstset;
+	vector<int> &cands = ctx.cands;
+	vector<int> &result = ctx.dres;
+	vector<int> &dis = ctx.kbound; // aggregate so far per object of a leaf
+	long long cells = 0, nodes = 0, pops = 0;
+	Status_query rootstatus = { 0, false, 0, 0 };
+	pq.push_back( rootstatus );
+	while( pq.size() > 0 && rstset.size() < K ){
+		Status_query top = pq[0];
+		pop_heap( pq.begin(), pq.end(), Status_query_comp() );
+		pq.pop_back();
+		pops ++;
+		if ( top.isvertex ){
+			ResultSet rs = { top.id, top.dis };
+			rstset.push_back( rs );
+			continue;
+		}
+		nodes ++;
+		const FrozenTreeNode &topnode = FG_NODE(top.id);
+		if ( topnode.isleaf ){
+			const int* leafnodes = FG_ARRAY(top.id, leafnodes);
+			const int* pmind = FG_ARRAY(top.id, pmind);
+			const int* leafinvlist = OCC_LEAF(layer, top.id);
+			int nleafinvlist = OCC_LEAF_SIZE(layer, top.id);
+			dis.assign( nleafinvlist, 0 );
+			cands.clear();
+			for ( int i = 0; i < m; i++ ){
+				// the leaf of source i: dijkstra, else itm + mind
+				if ( group_on_path( sources[i], top.lca_pos, top.id ) ){
+					if ( cands.size() == 0 ){
+						for ( int j = 0; j < nleafinvlist; j++ ) cands.push_back( leafnodes[leafinvlist[j]] );
+					}
+					result.resize( cands.size() );
+					if ( cands.size() > 0 ) dijkstra_candidate( ctx.heap, sources[i], &cands[0], cands.size(), *FGGraph, &result[0] );
+					for ( int j = 0; j < nleafinvlist; j++ ) dis[j] = group_agg( agg, dis[j], result[j] );
+				}
+				else{
+					const int* itm = ITM(g.src[i], top.id);
+					for ( int j = 0; j < nleafinvlist; j++ ){
+						int d = fg_minplus( itm, pmind, leafinvlist[j], topnode.nborders, 0, 1, 0, topnode.nborders );
+						dis[j] = group_agg( agg, dis[j], d );
+					}
+					cells += (long long) nleafinvlist * topnode.nborders;
+				}
+			}
+			for ( int j = 0; j < nleafinvlist; j++ ){
+				Status_query status = { leafnodes[leafinvlist[j]], true, top.lca_pos, dis[j] };
+				group_push( pq, status );
+			}
+			continue;
+		}
+		const int* nonleafinvlist = OCC_NONLEAF(layer, top.id);
+		for ( int c = 0; c < OCC_NONLEAF_SIZE(layer, top.id); c++ ){
+			int child = nonleafinvlist[c];
+			int bound = 0;
+			for ( int i = 0; i < m; i++ ){
+				int lb = 0;
+				// off the gtreepath of source i: from the itm of its son here(brothers) or of top(downstream)
+				if ( ! group_on_path( sources[i], top.lca_pos + 1, child ) ){
+					int son = group_on_path( sources[i], top.lca_pos, top.id ) ? FG_PATH(sources[i])[ top.lca_pos + 1 ] : top.id;
+					lb = child_itm( g.src[i], child, son, cells );
+				}
+				bound = group_agg( agg, bound, lb );
+			}
+			Status_query status = { child, false, top.lca_pos + 1, bound };
+			group_push( pq, status );
+		}
+	}
+	pthread_rwlock_unlock( &layer.lock );
+	long long t2 = STATS_TICK(ctx);
+	stats_count( ctx.stats, QC_NODES, nodes );
+	stats_count( ctx.stats, QC_PUSHES, pops + pq.size() );
+	stats_count( ctx.stats, QC_CELLS, cells );
+	stats_count( ctx.stats, QC_RESULTS, rstset.size() );
+	stats_add( ctx.stats, QS_UPSTREAM, t1 - t0 );
+	stats_add( ctx.stats, QS_SEARCH, t2 - t1 );
+	stats_add( ctx.stats, QS_TOTAL, t2 - t0 );
+	stats_end( ctx.stats, QS_PHASES );
+	return rstset;
+}
+
+// ----- BATCH QUERY -----
+// queries of one leaf share the upstream: for every ancestor A on the gtreepath,
+// UpT_A[j][b] = distance from border b of the leaf to border j of A is composed once per group,
+// then itm_A(locid) = min_b( itm_leaf(locid)[b] + UpT_A[j][b] ), exactly the value of knn_upstream.
+#define BATCH_GROUP_CAP 256 // max queries of one task, larger leaf groups are split
+
+// results of query q at rs[offset[q], offset[q] + count[q])
+// reuse one BatchResult across batches, the buffers keep their capacity
+typedef struct{
+	vector<long long> offset; // [n + 1], prefix sums of min(K, number of objects)
+	vector<int> count;
+	vector<ResultSet> rs;
+}BatchResult;
+
+// per worker scratch of knn_query_batch
+typedef struct{
+	QueryContext ctx;
+	vector<QueryContext> lanes; // batch_lanes - 1 more contexts for interleaved queries, lane 0 is ctx
+	vector<int> lane_q; // query of each lane, -1 when idle
+	vector<long long> lane_busy; // time the query of each lane has run
+	vector<long long> upoff; // gtreepath position -> offset of UpT in up
+	vector<int> up;
+	vector<int> acc;
+	vector<int> row; // one pmind row segment, unpacked
+}BatchWorker;
+
+int query_threads = 1;
+int batch_lanes = 1; // queries interleaved by a batch worker(knn_batch_interleave)
+vector<BatchWorker> batch_workers;
+
+#define LANE(w,l) ( (l) == 0 ? (w).ctx : (w).lanes[(l) - 1] )
+
+void knn_batch_init( int nthreads, int lanes = 1 ){
+	query_threads = nthreads < 1 ? 1 : nthreads;
+	batch_lanes = lanes < 1 ? 1 : lanes;
+	batch_workers.resize( query_threads );
+	for ( int i = 0; i < query_threads; i++ ){
+		query_context_init( batch_workers[i].ctx );
+		batch_workers[i].lanes.resize( batch_lanes - 1 );
+		for ( int l = 0; l < batch_lanes - 1; l++ ){
+			query_context_init( batch_workers[i].lanes[l] );
+		}
+	}
+}
+
+// compose UpT of every ancestor of leaf path[path_size - 1]
+void knn_batch_compose( BatchWorker &w, const int* path, int path_size ){
+	int leaf = path[path_size - 1];
+	int nbl = FG_NODE(leaf).nborders;
+	w.upoff.assign( path_size, 0 );
+	w.up.clear();
+	w.acc.resize( nbl );
+	for ( int i = path_size - 2; i > 0; i-- ){
+		int tn = path[i], cid = path[i+1];
+		const FrozenTreeNode &tnode = FG_NODE(tn);
+		const FrozenTreeNode &cnode = FG_NODE(cid);
+		const int* pmind = FG_ARRAY(tn, pmind);
+		const int* pcurrent_pos = FG_ARRAY(tn, pcurrent_pos);
+		w.upoff[i] = w.up.size();
+		w.row.resize( cnode.nborders );
+		const int* row = &w.row[0];
+		for ( int j = 0; j < tnode.nborders; j++ ){
+			fg_row( pmind, pcurrent_pos[j], tnode.nunion_borders, cnode.up_off, tnode.nchildren, cnode.cpos, cnode.nborders, &w.row[0] );
+			if ( cid == leaf ){
+				w.up.insert( w.up.end(), row, row + nbl );
+				continue;
+			}
+			// acc[b] = min_k( row[k] + UpT_child[k][b] )
+			const int* upc = &w.up[0] + w.upoff[i+1];
+			for ( int b = 0; b < nbl; b++ ) w.acc[b] = MINPLUS_INF;
+			for ( int k = 0; k < cnode.nborders; k++ ){
+				minplus_relax( &w.acc[0], row[k], upc + (long long) k * nbl, nbl );
+			}
+			for ( int b = 0; b < nbl; b++ ) w.acc[b] = minplus_cap( w.acc[b] );
+			w.up.insert( w.up.end(), w.acc.begin(), w.acc.end() );
+		}
+		stats_count( w.ctx.stats, QC_CELLS, (long long) tnode.nborders * cnode.nborders * ( cid == leaf ? 1 : nbl ) );
+	}
+}
+
+// knn_upstream through the composed UpT of the leaf group into ctx
+void knn_batch_upstream( BatchWorker &w, QueryContext &ctx, int locid ){
+	const int* locpath = FG_PATH(locid);
+	int locpath_size = FG_PATH_SIZE(locid);
+	int leaf = locpath[locpath_size - 1];
+	const FrozenTreeNode &lnode = FG_NODE(leaf);
+	const int* leafnodes = FG_ARRAY(leaf, leafnodes);
+	int posa = lower_bound( leafnodes, leafnodes + lnode.nleafnodes, locid ) - leafnodes;
+	int* itm_leaf = itm_alloc( ctx, leaf, lnode.nborders );
+	fg_row( FG_ARRAY(leaf, rpmind), posa, lnode.nborders, 0, 1, 0, lnode.nborders, itm_leaf );
+	for ( int i = locpath_size - 2; i > 0; i-- ){
+		int tn = locpath[i];
+		int nb = FG_NODE(tn).nborders;
+		int* itm_tn = itm_alloc( ctx, tn, nb );
+		const int* up = &w.up[0] + w.upoff[i];
+		for ( int j = 0; j < nb; j++ ){
+			itm_tn[j] = minplus_cap( minplus_min( itm_leaf, up + (long long) j * lnode.nborders, lnode.nborders ) );
+		}
+		stats_count( ctx.stats, QC_CELLS, (long long) nb * lnode.nborders );
+	}
+	stats_count( ctx.stats, QC_CELLS, lnode.nborders );
+}
+
+// queries order[from, to) of one leaf group, interleaved on the lanes of w: each lane runs one query a
+// step(knn_search_step) at a time, round robin, so the cache misses of a step overlap the work of the
+// other lanes. after its step a lane prefetches its next tree node, half a round later the rows the
+// step will read(knn_prefetch_node / knn_prefetch_rows), the lane finds both in cache when it comes up.
+// compose = time of knn_batch_compose, upstream time of the first query
+void knn_batch_interleave( BatchWorker &w, const ObjectLayer &layer, const pair<int,int>* queries, const vector< pair<int,int> > &order,
+	int from, int to, bool shared, long long compose, BatchResult &out ){
+	int L = min( batch_lanes, to - from );
+	w.lane_q.assign( L, -1 );
+	w.lane_busy.assign( L, 0 );
+	int next = from, active = 0;
+	while( next < to || active > 0 ){
+		for ( int l = 0; l < L; l++ ){
+			QueryContext &ctx = LANE(w, l);
+			int q = w.lane_q[l];
+			long long t0 = STATS_TICK(ctx);
+			// idle lane: next query
+			if ( q < 0 ){
+				if ( next == to ) continue;
+				q = order[next++].second;
+				w.lane_q[l] = q;
+				active ++;
+				query_context_reset( ctx );
+				stats_begin( ctx.stats );
+				if ( shared ) knn_batch_upstream( w, ctx, queries[q].first );
+				else knn_upstream( ctx, queries[q].first );
+				knn_search_begin( ctx );
+				long long up = STATS_TICK(ctx) - t0 + compose;
+				compose = 0;
+				stats_add( ctx.stats, QS_UPSTREAM, up );
+				w.lane_busy[l] = up;
+			}
+			else if ( knn_search_step( ctx, layer, queries[q].first, queries[q].second, NO_DIST_BOUND ) ){
+				long long t = STATS_TICK(ctx) - t0;
+				stats_add( ctx.stats, QS_SEARCH, t );
+				w.lane_busy[l] += t;
+			}
+			else{
+				knn_search_end( ctx );
+				stats_add( ctx.stats, QS_TOTAL, w.lane_busy[l] + STATS_TICK(ctx) - t0 );
+				stats_end( ctx.stats, QS_PHASES );
+				out.count[q] = ctx.rstset.size();
+				copy( ctx.rstset.begin(), ctx.rstset.end(), out.rs.begin() + out.offset[q] );
+				w.lane_q[l] = -1;
+				active --;
+				continue;
+			}
+			knn_prefetch_node( ctx, layer );
+			int h = ( l + L / 2 ) % L;
+			if ( h != l && w.lane_q[h] >= 0 ) knn_prefetch_rows( LANE(w, h), layer );
+		}
+	}
+}
+
+// answer n (locid, K) queries into out, on query_threads workers(knn_batch_init)
+// invalid queries get no result, the whole batch sees one object snapshot
+void knn_query_batch( ObjectLayer &layer, const pair<int,int>* queries, int n, BatchResult &out ){
+	IndexPin pin;
+	pthread_rwlock_rdlock( &layer.lock );
+	int objects = OCC_LEAF_SIZE_ALL(layer);
+	out.offset.resize( n + 1 );
+	out.count.assign( n, 0 );
+	out.offset[0] = 0;
+	for ( int q = 0; q < n; q++ ){
+		int K = queries[q].second;
+		bool valid = queries[q].first >= 0 && queries[q].first < Nodes.size() && K >= 0;
+		out.offset[q+1] = out.offset[q] + ( valid ? ( K < objects ? K : objects ) : 0 );
+	}
+	out.rs.resize( out.offset[n] );
+
+	// group by leaf, (leaf, query) sorted
+	vector< pair<int,int> > order;
+	order.reserve( n );
+	for ( int q = 0; q < n; q++ ){
+		if ( out.offset[q+1] == out.offset[q] ) continue;
+		int locid = queries[q].first;
+		order.push_back( make_pair( FG_PATH(locid)[ FG_PATH_SIZE(locid) - 1 ], q ) );
+	}
+	sort( order.begin(), order.end() );
+	vector<int> groups;
+	for ( int i = 0; i < order.size(); i++ ){
+		if ( i == 0 || order[i].first != order[i-1].first || i - groups.back() >= BATCH_GROUP_CAP ){
+			groups.push_back(i);
+		}
+	}
+	groups.push_back( order.size() );
+
+	// tasks: one leaf group large enough to compose its upstream(knn_batch_compose costs about
+	// nborders(leaf) single upstreams), or consecutive small groups, up to BATCH_GROUP_CAP queries
+	// with an upstream each. the queries of a task run interleaved(knn_batch_interleave)
+	vector<int> tasks;
+	vector<char> shared;
+	for ( int g = 0; g + 1 < groups.size(); g++ ){
+		bool compose = groups[g+1] - groups[g] > FG_NODE( order[groups[g]].first ).nborders;
+		if ( compose || tasks.empty() || shared.back() || groups[g+1] - tasks.back() > BATCH_GROUP_CAP ){
+			tasks.push_back( groups[g] );
+			shared.push_back( compose );
+		}
+	}
+	tasks.push_back( order.size() );
+
+	parallel_for( query_threads, tasks.size() - 1, [&]( int worker, int t ){
+		numa_worker_pin( worker );
+		IndexPin pin; // a batch may span a reload, every task is on one snapshot
+		BatchWorker &w = batch_workers[worker];
+		// stats: composing is upstream time of the first query of the group
+		long long t0 = STATS_TICK(w.ctx);
+		if ( shared[t] ){
+			int locid = queries[ order[tasks[t]].second ].first;
+			knn_batch_compose( w, FG_PATH(locid), FG_PATH_SIZE(locid) );
+		}
+		knn_batch_interleave( w, layer, queries, order, tasks[t], tasks[t+1], shared[t], STATS_TICK(w.ctx) - t0, out );
+	} );
+	pthread_rwlock_unlock( &layer.lock );
+}
+
+// binary protocol on in/out, native endian int32:
+//	request:  n, layer, then n * (locid, K)
+//	response: n, then per query count, then count * (id, dis)
+// until end of input
+void knn_serve_binary( FILE* in, FILE* out ){
+	vector< pair<int,int> > queries;
+	BatchResult result;
+	int n, layer;
+	while( fread( &n, sizeof(int), 1, in ) == 1 && n >= 0 && fread( &layer, sizeof(int), 1, in ) == 1 ){
+		queries.resize( n );
+		for ( int i = 0; i < n; i++ ){
+			int q[2];
+			if ( fread( q, sizeof(int), 2, in ) != 2 ) return;
+			queries[i] = make_pair( q[0], q[1] );
+		}
+		// unknown layer, no result
+		if ( layer < 0 || layer >= Layers.size() ){
+			result.count.assign( n, 0 );
+		}
+		else{
+			knn_query_batch( *Layers[layer], n > 0 ? &queries[0] : NULL, n, result );
+		}
+		fwrite( &n, sizeof(int), 1, out );
+		for ( int i = 0; i < n; i++ ){
+			fwrite( &result.count[i], sizeof(int), 1, out );
+			if ( result.count[i] > 0 ){
+				fwrite( &result.rs[ result.offset[i] ], sizeof(ResultSet), result.count[i], out );
+			}
+		}
+		fflush( out );
+		if ( stats_requested ) stats_dump();
+	}
+}
+
+// ----- SHARDS -----
+// an index too large for one machine is split by the subtrees of the root children(gtree_build -S n):
+// shard s of n holds the tree shape, the root and the gtreepath of every vertex, the matrices only of the
+// subtrees of root children c with cpos % n == s(shard_owns). -S s/n serves that shard(with -l), -C addr0,addr1,..
+// coordinates n of them(shard s at addr s) and answers a knn in two rounds(sharded_knn):
+//	1. the shard of son, the root child holding locid, runs knn_upstream and the search below son, and
+//	   returns its K nearest with the itm of son
+//	2. the coordinator computes the itm of every other root child over the root matrix(child_itm), takes the
+//	   K-th distance of round 1 as bound(maxdist while fewer than K), and sends each root child whose itm
+//	   min is within it to its shard. all shards search their root children from the given itm in parallel,
+//	   then the K nearest of both rounds are the answer.
+// shard requests go next to the plain ones of the server(see SERVER):
+//	request:  tag, -2 - layer, locid, K, maxdist, n, then n ints: per root child c, c and its itm(nborders of c)
+//	response: tag, count, count * (id, dis), m, then m ints: the itm of son in round 1(n = 0), m = 0 otherwise
+// count = -1 for a request the shard cannot answer(a root child it does not own). the leaf dijkstra of the
+// source needs the graph, so every shard and the coordinator keep all of it, as well as the object layers.
+#define SHARD_HEAD_INTS 6 // tag, -2 - layer, locid, K, maxdist, n
+#define SHARD_MAX_INTS ( 1 << 24 ) // payload cap of a shard request
+
+thread_local vector<int> shard_fds; // connections of a coordinator thread to the shards, -1 until used
+
+// true if root child c is in this shard
+bool shard_owns( int c ){
+	return shard_count == 0 || FG_NODE(c).cpos % shard_count == shard_id;
+}
+
+// round 1(n = 0) or 2 of sharded_knn on this shard, answers in ctx.rstset, itm of son in upstream(round 1).
+// false if it cannot answer
+bool shard_query( QueryContext &ctx, ObjectLayer &layer, int locid, int K, int maxdist, const int* entries, int n, vector<int> &upstream ){
+	IndexPin pin;
+	if ( FG_NODE(0).isleaf ) return false;
+	int son = FG_PATH(locid)[1];
+	if ( n == 0 && ! shard_owns( son ) ) return false;
+	for ( int i = 0; i < n; i += 1 + FG_NODE(entries[i]).nborders ){
+		int c = entries[i];
+		if ( c <= 0 || c >= FGTree.tree_size || FG_NODE(c).father != 0 || c == son || ! shard_owns( c )
+			|| i + 1 + FG_NODE(c).nborders > n ) return false;
+	}
+	query_context_reset( ctx );
+	knn_search_begin( ctx );
+	ctx.pq.clear(); // the root is the coordinator's
+	upstream.clear();
+	if ( n == 0 ){
+		knn_upstream( ctx, locid );
+		const int* itm = ITM(ctx, son);
+		upstream.assign( itm, itm + FG_NODE(son).nborders );
+		Status_query status = { son, false, 1, 0 };
+		knn_push( ctx.pq, status, maxdist );
+	}
+	// brothers of son with their itm, lca_pos 0 as below the root in knn_search_step
+	for ( int i = 0; i < n; ){
+		int c = entries[i++];
+		int* itm = itm_alloc( ctx, c, FG_NODE(c).nborders );
+		int allmin = MINPLUS_INF;
+		for ( int j = 0; j < FG_NODE(c).nborders; j++ ){
+			itm[j] = entries[i++];
+			allmin = itm[j] < allmin ? itm[j] : allmin;
+		}
+		Status_query status = { c, false, 0, allmin };
+		knn_push( ctx.pq, status, maxdist );
+	}
+	pthread_rwlock_rdlock( &layer.lock );
+	while( knn_search_step( ctx, layer, locid, K, maxdist ) );
+	pthread_rwlock_unlock( &layer.lock );
+	knn_search_end( ctx );
+	return true;
+}
+
+bool send_full( int fd, const char* p, long long size ){
+	while( size > 0 ){
+		ssize_t sent = send( fd, p, size, MSG_NOSIGNAL );
+		if ( sent < 0 && errno == EINTR ) continue;
+		if ( sent <= 0 ) return false;
+		p += sent;
+		size -= sent;
+	}
+	return true;
+}
+
+bool recv_full( int fd, char* p, long long size ){
+	while( size > 0 ){
+		ssize_t got = recv( fd, p, size, 0 );
+		if ( got < 0 && errno == EINTR ) continue;
+		if ( got <= 0 ) return false;
+		p += got;
+		size -= got;
+	}
+	return true;
+}
+
+// connected socket to addr("unix:path" or "[host:]port", host 127.0.0.1 if absent), -1 on error
+int shard_connect( const char* addr ){
+	int fd;
+	if ( strncmp( addr, "unix:", 5 ) == 0 ){
+		struct sockaddr_un sa;
+		memset( &sa, 0, sizeof(sa) );
+		sa.sun_family = AF_UNIX;
+		if ( strlen( addr + 5 ) >= sizeof(sa.sun_path) ) return -1;
+		strcpy( sa.sun_path, addr + 5 );
+		fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+		if ( fd < 0 ) return -1;
+		if ( connect( fd, (struct sockaddr*) &sa, sizeof(sa) ) != 0 ){
+			close( fd );
+			return -1;
+		}
+		return fd;
+	}
+	struct sockaddr_in sa;
+	memset( &sa, 0, sizeof(sa) );
+	sa.sin_family = AF_INET;
+	sa.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+	const char* port = strrchr( addr, ':' );
+	if ( port != NULL ){
+		string host( addr, port - addr );
+		if ( inet_pton( AF_INET, host.c_str(), &sa.sin_addr ) != 1 ) return -1;
+		port ++;
+	}
+	else port = addr;
+	sa.sin_port = htons( atoi( port ) );
+	fd = socket( AF_INET, SOCK_STREAM, 0 );
+	if ( fd < 0 ) return -1;
+	if ( connect( fd, (struct sockaddr*) &sa, sizeof(sa) ) != 0 ){
+		close( fd );
+		return -1;
+	}
+	int on = 1;
+	setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on) );
+	return fd;
+}
+
+// drop the connections of this thread, a failed exchange may have left responses behind
+void shard_disconnect(){
+	for ( int s = 0; s < shard_fds.size(); s++ ){
+		if ( shard_fds[s] >= 0 ) close( shard_fds[s] );
+		shard_fds[s] = -1;
+	}
+}
+
+bool shard_send( int s, const vector<int> &req ){
+	if ( shard_fds[s] < 0 ) shard_fds[s] = shard_connect( shard_addrs[s].c_str() );
+	return shard_fds[s] >= 0 && send_full( shard_fds[s], (const char*) &req[0], (long long) req.size() * sizeof(int) );
+}
+
+// response of shard s, answers appended to result
+bool shard_recv( int s, vector<ResultSet> &result, vector<int> &upstream ){
+	int head[2], m;
+	if ( ! recv_full( shard_fds[s], (char*) head, sizeof(head) ) || head[1] < 0 ) return false;
+	int from = result.size();
+	result.resize( from + head[1] );
+	if ( head[1] > 0 && ! recv_full( shard_fds[s], (char*) &result[from], (long long) head[1] * sizeof(ResultSet) ) ) return false;
+	if ( ! recv_full( shard_fds[s], (char*) &m, sizeof(int) ) || m < 0 || m > SHARD_MAX_INTS ) return false;
+	upstream.resize( m );
+	return m == 0 || recv_full( shard_fds[s], (char*) &upstream[0], (long long) m * sizeof(int) );
+}
+
+// K nearest objects of layer from locid within maxdist over the shards of -C(see above), ranked by distance.
+// false if a shard fails. ctx = scratch for the root step
+bool sharded_knn( QueryContext &ctx, int layer, int locid, int K, int maxdist, vector<ResultSet> &result ){
+	IndexPin pin;
+	int n = shard_addrs.size();
+	if ( shard_fds.size() != n ) shard_fds.assign( n, -1 );
+	result.clear();
+	if ( FG_NODE(0).isleaf ) return false;
+	if ( K == 0 ) return true;
+	int son = FG_PATH(locid)[1];
+	const FrozenTreeNode &sonnode = FG_NODE(son);
+	int home = sonnode.cpos % n;
+	int head[SHARD_HEAD_INTS] = { 0, -2 - layer, locid, K, maxdist == NO_DIST_BOUND ? -1 : maxdist, 0 };
+	vector<int> req( head, head + SHARD_HEAD_INTS ), upstream;
+	if ( ! shard_send( home, req ) || ! shard_recv( home, result, upstream ) || upstream.size() != sonnode.nborders ){
+		shard_disconnect();
+		result.clear();
+		return false;
+	}
+	int bound = result.size() >= K ? result[K - 1].dis : maxdist;
+
+	// root step: itm of the brothers of son from its itm, one request per shard
+	query_context_reset( ctx );
+	int* itm_son = itm_alloc( ctx, son, sonnode.nborders );
+	copy( upstream.begin(), upstream.end(), itm_son );
+	vector< vector<int> > reqs( n );
+	const int* children = FG_ARRAY(0, children);
+	long long cells = 0;
+	for ( int i = 0; i < FG_NODE(0).nchildren; i++ ){
+		int c = children[i];
+		if ( c == son ) continue;
+		int allmin = child_itm( ctx, c, son, cells );
+		if ( allmin >= MINPLUS_INF || allmin > bound ) continue;
+		vector<int> &r = reqs[ FG_NODE(c).cpos % n ];
+		if ( r.empty() ){
+			int head[SHARD_HEAD_INTS] = { 0, -2 - layer, locid, K, bound == NO_DIST_BOUND ? -1 : bound, 0 };
+			r.assign( head, head + SHARD_HEAD_INTS );
+		}
+		r.push_back( c );
+		r.insert( r.end(), ITM(ctx, c), ITM(ctx, c) + FG_NODE(c).nborders );
+		r[SHARD_HEAD_INTS - 1] = r.size() - SHARD_HEAD_INTS;
+	}
+	stats_count( ctx.stats, QC_CELLS, cells );
+	// scatter, then gather: the shards search at the same time
+	for ( int s = 0; s < n; s++ ){
+		if ( reqs[s].size() > 0 && ! shard_send( s, reqs[s] ) ){
+			shard_disconnect();
+			result.clear();
+			return false;
+		}
+	}
+	for ( int s = 0; s < n; s++ ){
+		if ( reqs[s].size() > 0 && ! shard_recv( s, result, upstream ) ){
+			shard_disconnect();
+			result.clear();
+			return false;
+		}
+	}
+	sort( result.begin(), result.end(), []( const ResultSet &a, const ResultSet &b ){ return a.dis < b.dis || ( a.dis == b.dis && a.id < b.id ); } );
+	if ( result.size() > K ) result.resize( K );
+	return true;
+}
+
+// ----- SERVER -----
+// -l addr: long running server over one loaded index, addr = "unix:path" or "[host:]port"(TCP)
+// framing, native endian int32, any number of requests in flight per connection(pipelining):
+//	request:  tag, layer, locid, K, maxdist(< 0 = no bound, a range query is K = vertex count with maxdist)
+//	response: tag, count, then count * (id, dis), count = -1 for an invalid request
+// layer <= -2 marks a shard request, longer(see SHARDS). a shard(-S) answers only those, a coordinator(-C)
+// answers the plain ones over its shards.
+// a response is sent as soon as it is answered, so responses may come in another order than
+// the requests, the tag(any value of the client) pairs them.
+// one reader thread per connection queues its requests, query_threads workers answer them, each with
+// its own QueryContext(batch_workers), the index is shared read only.
+// stats(-s) on SIGUSR1 are written by the next worker done, queries running meanwhile may be partly in.
+#define SERVER_REQUEST_INTS 5
+#define SERVER_QUEUE_CAP 4096 // queued requests of all connections, readers wait beyond
+
+typedef struct{
+	int fd;
+	int refs; // reader + queued or running requests, guarded by server_lock
+	bool broken; // a send failed, drop later responses, guarded by write_lock
+	pthread_mutex_t write_lock;
+}ServerConn;
+
+typedef struct{
+	ServerConn* conn;
+	int req[SERVER_REQUEST_INTS];
+	vector<int> payload; // the n ints of a shard request
+}ServerJob;
+
+deque<ServerJob> server_queue;
+pthread_mutex_t server_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t server_nonempty = PTHREAD_COND_INITIALIZER;
+pthread_cond_t server_nonfull = PTHREAD_COND_INITIALIZER;
+
+// caller holds server_lock, the last reference closes the connection
+void server_conn_release( ServerConn* conn ){
+	if ( -- conn->refs > 0 ) return;
+	close( conn->fd );
+	pthread_mutex_destroy( &conn->write_lock );
+	delete conn;
+}
+
+void server_worker( int worker ){
+	numa_worker_pin( worker );
+	QueryContext &ctx = batch_workers[worker].ctx;
+	vector<int> out, upstream;
+	vector<ResultSet> merged;
+	while( true ){
+		pthread_mutex_lock( &server_lock );
+		while( server_queue.empty() ) pthread_cond_wait( &server_nonempty, &server_lock );
+		ServerJob job = move( server_queue.front() );
+		server_queue.pop_front();
+		pthread_cond_signal( &server_nonfull );
+		pthread_mutex_unlock( &server_lock );
+
+		bool shard = job.req[1] <= -2;
+		int layer = shard ? -2 - job.req[1] : job.req[1], locid = job.req[2], K = job.req[3];
+		int maxdist = job.req[4] < 0 ? NO_DIST_BOUND : job.req[4];
+		out.clear();
+		out.push_back( job.req[0] );
+		// a shard answers shard requests only, all others plain ones
+		bool valid = layer >= 0 && layer < Layers.size() && valid_vertex( locid ) && K >= 0 && shard == ( shard_count > 0 );
+		if ( K > Nodes.size() ) K = Nodes.size();
+		const vector<ResultSet>* result = NULL;
+		if ( valid && shard ){
+			if ( shard_query( ctx, *Layers[layer], locid, K, maxdist, job.payload.data(), job.payload.size(), upstream ) ) result = &ctx.rstset;
+		}
+		else if ( valid && shard_addrs.size() > 0 ){
+			if ( sharded_knn( ctx, layer, locid, K, maxdist, merged ) ) result = &merged;
+		}
+		else if ( valid ) result = &knn_query( ctx, *Layers[layer], locid, K, maxdist );
+		if ( result == NULL ) out.push_back( -1 );
+		else{
+			out.push_back( result->size() );
+			for ( int i = 0; i < result->size(); i++ ){
+				out.push_back( (*result)[i].id );
+				out.push_back( (*result)[i].dis );
+			}
+			if ( shard ){
+				out.push_back( upstream.size() );
+				out.insert( out.end(), upstream.begin(), upstream.end() );
+			}
+		}
+
+		ServerConn* conn = job.conn;
+		pthread_mutex_lock( &conn->write_lock );
+		if ( ! conn->broken && ! send_full( conn->fd, (const char*) &out[0], (long long) out.size() * sizeof(int) ) ){
+			// wake the reader, it ends the connection
+			conn->broken = true;
+			shutdown( conn->fd, SHUT_RDWR );
+		}
+		pthread_mutex_unlock( &conn->write_lock );
+		pthread_mutex_lock( &server_lock );
+		server_conn_release( conn );
+		pthread_mutex_unlock( &server_lock );
+		if ( stats_requested ) stats_dump();
+	}
+}
+
+// requests of one connection into server_queue, until the client closes(responses still in flight are sent)
+void server_reader( ServerConn* conn ){
+	const int frame = SERVER_REQUEST_INTS * sizeof(int);
+	vector<char> buf( 1 << 16 ); // a pipelining client sends many requests per read
+	int have = 0;
+	bool bad = false;
+	while( ! bad ){
+		ssize_t got = recv( conn->fd, &buf[0] + have, buf.size() - have, 0 );
+		if ( got < 0 && errno == EINTR ) continue;
+		if ( got <= 0 ) break;
+		have += got;
+		int used = 0;
+		pthread_mutex_lock( &server_lock );
+		while( have - used >= frame ){
+			// a shard request is complete with its n ints
+			const int* req = (const int*) &buf[used];
+			int size = frame, n = 0;
+			if ( req[1] <= -2 ){
+				if ( have - used < frame + (int) sizeof(int) ) break;
+				n = req[SERVER_REQUEST_INTS];
+				if ( n < 0 || n > SHARD_MAX_INTS ){
+					bad = true;
+					break;
+				}
+				size = frame + ( n + 1 ) * sizeof(int);
+				if ( have - used < size ) break;
+			}
+			while( server_queue.size() >= SERVER_QUEUE_CAP ) pthread_cond_wait( &server_nonfull, &server_lock );
+			ServerJob job;
+			job.conn = conn;
+			memcpy( job.req, req, frame );
+			if ( n > 0 ) job.payload.assign( req + SERVER_REQUEST_INTS + 1, req + SERVER_REQUEST_INTS + 1 + n );
+			conn->refs ++;
+			server_queue.push_back( move( job ) );
+			pthread_cond_signal( &server_nonempty );
+			used += size;
+		}
+		pthread_mutex_unlock( &server_lock );
+		memmove( &buf[0], &buf[used], have - used );
+		have -= used;
+		if ( have == buf.size() ) buf.resize( buf.size() * 2 );
+	}
+	pthread_mutex_lock( &server_lock );
+	server_conn_release( conn );
+	pthread_mutex_unlock( &server_lock );
+}
+
+// listening socket of addr, -1 on error
+int server_listen( const char* addr ){
+	int fd;
+	if ( strncmp( addr, "unix:", 5 ) == 0 ){
+		struct sockaddr_un sa;
+		memset( &sa, 0, sizeof(sa) );
+		sa.sun_family = AF_UNIX;
+		if ( strlen( addr + 5 ) >= sizeof(sa.sun_path) ) return -1;
+		strcpy( sa.sun_path, addr + 5 );
+		unlink( sa.sun_path );
+		fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+		if ( fd < 0 ) return -1;
+		if ( bind( fd, (struct sockaddr*) &sa, sizeof(sa) ) != 0 ){
+			close( fd );
+			return -1;
+		}
+	}
+	else{
+		struct sockaddr_in sa;
+		memset( &sa, 0, sizeof(sa) );
+		sa.sin_family = AF_INET;
+		sa.sin_addr.s_addr = htonl( INADDR_ANY );
+		const char* port = strrchr( addr, ':' );
+		if ( port != NULL ){
+			string host( addr, port - addr );
+			if ( inet_pton( AF_INET, host.c_str(), &sa.sin_addr ) != 1 ) return -1;
+			port ++;
+		}
+		else port = addr;
+		sa.sin_port = htons( atoi( port ) );
+		fd = socket( AF_INET, SOCK_STREAM, 0 );
+		if ( fd < 0 ) return -1;
+		int on = 1;
+		setsockopt( fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on) );
+		if ( bind( fd, (struct sockaddr*) &sa, sizeof(sa) ) != 0 ){
+			close( fd );
+			return -1;
+		}
+	}
+	if ( listen( fd, 64 ) != 0 ){
+		close( fd );
+		return -1;
+	}
+	return fd;
+}
+
+// serve addr forever on query_threads workers(knn_batch_init first)
+void knn_serve_socket( const char* addr ){
+	int lfd = server_listen( addr );
+	if ( lfd < 0 ){
+		printf("CANNOT LISTEN ON %s\n", addr );
+		exit(1);
+	}
+	for ( int i = 0; i < query_threads; i++ ){
+		thread( server_worker, i ).detach();
+	}
+	printf("LISTENING ON %s, %d WORKERS\n", addr, query_threads );
+	fflush( stdout );
+	while( true ){
+		int fd = accept( lfd, NULL, NULL );
+		if ( fd < 0 ){
+			if ( errno == EINTR || errno == ECONNABORTED ) continue;
+			printf("ACCEPT FAILED ON %s\n", addr );
+			exit(1);
+		}
+		// small responses go out at once(fails harmlessly on unix sockets)
+		int on = 1;
+		setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on) );
+		ServerConn* conn = new ServerConn;
+		conn->fd = fd;
+		conn->refs = 1;
+		conn->broken = false;
+		pthread_mutex_init( &conn->write_lock, NULL );
+		thread( server_reader, conn ).detach();
+	}
+}
+
+int main( int argc, char* argv[] ){
+	// options: -b = binary batch protocol on stdin/stdout(see knn_serve_binary)
+	//          -t N = batch query threads
+	//          -i N = queries interleaved by each batch thread(see knn_batch_interleave), default 1
+	//          -o file = one more object layer(FILE_OBJECT is layer 0)
+	//          -d = directed graph(index built with gtree_build -d)
+	//          -n name = data set name.cnode, name.gidx, name.object ...(default cal)
+	//          -s file = query stats as JSON into file(see stats_dump), at exit and on SIGUSR1
+	//          -l addr = server on a socket, "unix:path" or "[host:]port"(see knn_serve_socket), -t workers
+	//          -H 2m|1g|thp = the index on huge pages, -N = a copy per NUMA node, workers pinned(see INDEX PLACEMENT)
+	//          -S s/n = serve shard s of n(name.gidx.<s>of<n> of gtree_build -S n, else name.gidx) with -l
+	//          -C addr0,addr1,.. = knn queries over shards 0, 1, ..(see SHARDS)
+	//          -R N = cache the answers of up to N knn queries(see RESULT CACHE)
+	//          -L = leaf matrices of the mapped index read on first touch, warmed by last run's heat(see LAZY INDEX)
+	bool binary = false;
+	const char* server = NULL;
+	int threads = 1, lanes = 1;
+	vector<const char*> object_files;
+	for ( int i = 1; i < argc; i++ ){
+		if ( strcmp( argv[i], "-b" ) == 0 ) binary = true;
+		else if ( strcmp( argv[i], "-t" ) == 0 && i + 1 < argc ) threads = atoi( argv[++i] );
+		else if ( strcmp( argv[i], "-i" ) == 0 && i + 1 < argc ) lanes = atoi( argv[++i] );
+		else if ( strcmp( argv[i], "-o" ) == 0 && i + 1 < argc ) object_files.push_back( argv[++i] );
+		else if ( strcmp( argv[i], "-d" ) == 0 ) directed = true;
+		else if ( strcmp( argv[i], "-n" ) == 0 && i + 1 < argc ) dataset = argv[++i];
+		else if ( strcmp( argv[i], "-s" ) == 0 && i + 1 < argc ) stats_file = argv[++i];
+		else if ( strcmp( argv[i], "-l" ) == 0 && i + 1 < argc ) server = argv[++i];
+		else if ( strcmp( argv[i], "-H" ) == 0 && i + 1 < argc ){
+			i++;
+			index_pages = strcmp( argv[i], "1g" ) == 0 ? GTREE_PAGES_1GB : strcmp( argv[i], "2m" ) == 0 ? GTREE_PAGES_2MB : GTREE_PAGES_THP;
+		}
+		else if ( strcmp( argv[i], "-N" ) == 0 ) index_numa = true;
+		else if ( strcmp( argv[i], "-L" ) == 0 ) index_lazy = true;
+		else if ( strcmp( argv[i], "-R" ) == 0 && i + 1 < argc ) result_cache_init( atoi( argv[++i] ) );
+		else if ( strcmp( argv[i], "-S" ) == 0 && i + 1 < argc ){
+			if ( sscanf( argv[++i], "%d/%d", &shard_id, &shard_count ) != 2 || shard_count < 1 || shard_id < 0 || shard_id >= shard_count ){
+				printf("-S %s: NEED s/n WITH 0 <= s < n\n", argv[i] );
+				exit(1);
+			}
+		}
+		else if ( strcmp( argv[i], "-C" ) == 0 && i + 1 < argc ){
+			for ( const char* p = argv[++i]; *p != '\0'; ){
+				const char* end = strchr( p, ',' );
+				if ( end == NULL ) end = p + strlen( p );
+				if ( end > p ) shard_addrs.push_back( string( p, end - p ) );
+				p = *end == ',' ? end + 1 : end;
+			}
+		}
+	}
+	if ( shard_count > 0 && ( server == NULL || shard_addrs.size() > 0 ) ){
+		printf("A SHARD(-S) ONLY SERVES A COORDINATOR(-C) OVER -l\n");
+		exit(1);
+	}
+	files_init();
+	if ( shard_count > 0 ){
+		string file = gtree_index_shard_file( FILE_GTREE_INDEX, shard_id, shard_count );
+		if ( access( file.c_str(), R_OK ) == 0 ) file_gidx = file;
+	}
+	object_files.insert( object_files.begin(), FILE_OBJECT );
+	if ( stats_file != NULL ){
+		struct sigaction sa;
+		memset( &sa, 0, sizeof(sa) );
+		sa.sa_handler = stats_signal;
+		sa.sa_flags = SA_RESTART;
+		sigaction( SIGUSR1, &sa, NULL );
+	}
+	// SIGHUP = index_reload, handled by one thread, blocked in all others(they inherit the mask)
+	sigset_t hup;
+	sigemptyset( &hup );
+	sigaddset( &hup, SIGHUP );
+	pthread_sigmask( SIG_BLOCK, &hup, NULL );
+	// keep stdout for the protocol, logs go to stderr
+	FILE* bout = NULL;
+	if ( binary ){
+		bout = fdopen( dup(1), "wb" );
+		dup2( 2, 1 );
+	}
+
+	// init
+	TIME_TICK_START
+	init();
+	TIME_TICK_END
+	TIME_TICK_PRINT("INIT")
+
+	// load gtree index & distance matrix
+	gtree_index_load();
+
+	// pre query init
+	pre_query( object_files );
+	thread( index_reload_signal_loop ).detach();
+
+	if ( server != NULL ){
+		knn_batch_init( threads, lanes );
+		knn_serve_socket( server );
+	}
+	if ( binary ){
+		knn_batch_init( threads, lanes );
+		knn_serve_binary( stdin, bout );
+		fclose( bout );
+		stats_dump();
+		return 0;
+	}
+
+	// knn search
+	// example
+	printf("KNN Search Started...\n");
+	QueryContext ctx, check;
+	query_context_init( ctx );
+	query_context_init( check );
+	GroupContext group;
+	vector<int> sources;
+	vector<int> radii, band_end;
+	vector<ResultSet> merged; // answers of sharded_knn(-C)
+	// each line: "locid K [layer]" = knn query, "KNN locid K maxdist [layer]" = distance bounded knn,
+	// "RANGE locid R [layer]" = range query, "PATH locid K [layer]" = knn query with routes,
+	// "FILTER locid K mask [layer]" = knn query over the objects with all bits of mask,
+	// "APPROX locid K eps [layer]" = approximate knn query, LOW= after each answer bounds the true i-th nearest,
+	// "RKNN locid K [layer [facility layer]]" = objects of layer with locid among their K nearest of facility layer(rknn_query),
+	// "BANDS locid layer r1 r2 .." = range query per band of radii(ascending) in one search(multi_range_query), layer -1 = vertices(isochrone_query),
+	// "GROUP SUM|MAX K layer v1 v2 ..." = K objects of least sum / max of distances from v1, v2, ..(group_knn),
+	// "EDGE edge offset K [layer]" = knn query from offset along edge(knn_query_edge), answers on edges as "EDGE=e OFF=o",
+	// or an object update "ADD v [layer [mask]]", "REMOVE v [layer [mask]]", "MOVE from to [layer [mask]]", layer 0 by default,
+	// "STATS" writes the stats now(-s), "RELOAD [edge file]" publishes FILE_GTREE_INDEX again(as SIGHUP, see index_reload)
+	if ( ! route_ready() ){
+		printf("NO %s, PATH QUERIES RETURN NO ROUTE\n", FILE_ONTREE_VIA );
+	}
+	int locid, K, maxdist, from, to, l, f;
+	unsigned want;
+	bool routes;
+	double eps;
+	char line[256];
+	while( fgets( line, sizeof(line), stdin ) != NULL ){
+		if ( stats_requested ) stats_dump();
+		if ( strncmp( line, "STATS", 5 ) == 0 ){
+			stats_dump();
+			continue;
+		}
+		// reload aside, the queries go on meanwhile
+		if ( strncmp( line, "RELOAD", 6 ) == 0 ){
+			char edge_file[256];
+			string file = sscanf( line + 6, "%255s", edge_file ) == 1 ? edge_file : FILE_EDGE;
+			thread( [file](){ index_reload( file.c_str() ); } ).detach();
+			continue;
+		}
+		// the objects live in the shards, a coordinator only answers knn and range queries over them
+		if ( shard_addrs.size() > 0 && sscanf( line, "%d %d", &locid, &K ) < 2 && strncmp( line, "KNN", 3 ) != 0 && strncmp( line, "RANGE", 5 ) != 0 ){
+			printf("ONLY KNN AND RANGE QUERIES WITH -C\n");
+			continue;
+		}
+		l = 0;
+		maxdist = NO_DIST_BOUND;
+		routes = false;
+		want = 0;
+		eps = 0;
+		if ( sscanf( line, "ADD %d %d %u", &to, &l, &want ) >= 1 ){
+			if ( l >= 0 && l < Layers.size() ) add_object( *Layers[l], to, want );
+			continue;
+		}
+		if ( sscanf( line, "REMOVE %d %d %u", &from, &l, &want ) >= 1 ){
+			if ( l < 0 || l >= Layers.size() || ! remove_object( *Layers[l], from, want ) ) printf("NO OBJECT ON %d\n", from );
+			continue;
+		}
+		if ( sscanf( line, "MOVE %d %d %d %u", &from, &to, &l, &want ) >= 2 ){
+			if ( l < 0 || l >= Layers.size() || ! move_object( *Layers[l], from, to, want ) ) printf("NO OBJECT ON %d\n", from );
+			continue;
+		}
+		char agg[8];
+		int off;
+		if ( sscanf( line, "GROUP %7s %d %d%n", agg, &K, &l, &off ) == 3 ){
+			sources.clear();
+			for ( int n; sscanf( line + off, "%d%n", &locid, &n ) == 1; off += n ){
+				if ( locid >= 0 && locid < Nodes.size() ) sources.push_back( locid );
+			}
+			if ( l < 0 || l >= Layers.size() || K < 0 || sources.size() == 0 ) continue;
+			TIME_TICK_START
+			const vector<ResultSet> &result = group_knn( group, *Layers[l], sources, K, strcmp( agg, "MAX" ) == 0 ? GROUP_MAX : GROUP_SUM );
+			TIME_TICK_END
+			for ( int i = 0; i < result.size(); i++ ) printf("ID=%d DIS=%d\n", result[i].id, result[i].dis );
+			TIME_TICK_PRINT("GROUP_SEARCH")
+			continue;
+		}
+		if ( sscanf( line, "BANDS %d %d%n", &locid, &l, &off ) == 2 ){
+			radii.clear();
+			for ( int n; sscanf( line + off, "%d%n", &maxdist, &n ) == 1; off += n ){
+				if ( maxdist >= 0 && ( radii.size() == 0 || maxdist > radii.back() ) ) radii.push_back( maxdist );
+			}
+			if ( locid < 0 || locid >= Nodes.size() || l < -1 || l >= (int) Layers.size() || radii.size() == 0 ) continue;
+			TIME_TICK_START
+			const vector<ResultSet> &result = l < 0 ? isochrone_query( ctx, locid, radii, band_end )
+				: multi_range_query( ctx, *Layers[l], locid, radii, band_end );
+			TIME_TICK_END
+			for ( int b = 0, i = 0; b < radii.size(); b++ ){
+				printf("BAND=%d COUNT=%d\n", radii[b], band_end[b] - i );
+				for ( ; i < band_end[b]; i++ ){
+					if ( l < 0 ) printf("ID=%d DIS=%d", result[i].id, result[i].dis );
+					else answer_print( *Layers[l], result[i] );
+					printf("\n");
+				}
+			}
+			TIME_TICK_PRINT("BANDS_SEARCH")
+			continue;
+		}
+		double at;
+		if ( sscanf( line, "EDGE %d %lf %d %d", &from, &at, &K, &l ) >= 3 ){
+			if ( ! valid_edge( from ) || K < 0 || l < 0 || l >= Layers.size() ){
+				printf("NO EDGE %d\n", from );
+				continue;
+			}
+			TIME_TICK_START
+			const vector<ResultSet> &result = knn_query_edge( ctx, *Layers[l], from, edge_offset( from, at ), K );
+			TIME_TICK_END
+			for ( int i = 0; i < result.size(); i++ ){
+				answer_print( *Layers[l], result[i] );
+				printf("\n");
+			}
+			TIME_TICK_PRINT("KNN_SEARCH")
+			continue;
+		}
+		f = 0;
+		if ( sscanf( line, "RKNN %d %d %d %d", &locid, &K, &l, &f ) >= 2 ){
+			if ( directed ){
+				printf("RKNN NEEDS AN UNDIRECTED GRAPH\n");
+				continue;
+			}
+			if ( locid < 0 || locid >= Nodes.size() || l < 0 || l >= Layers.size() || f < 0 || f >= Layers.size() ) continue;
+			TIME_TICK_START
+			const vector<ResultSet> &result = rknn_query( ctx, check, *Layers[l], *Layers[f], locid, K );
+			TIME_TICK_END
+			for ( int i = 0; i < result.size(); i++ ) printf("ID=%d DIS=%d\n", result[i].id, result[i].dis );
+			TIME_TICK_PRINT("RKNN_SEARCH")
+			continue;
+		}
+		if ( sscanf( line, "RANGE %d %d %d", &locid, &maxdist, &l ) >= 2 ){
+			K = Nodes.size();
+		}
+		else if ( sscanf( line, "PATH %d %d %d", &locid, &K, &l ) >= 2 ){
+			routes = true;
+		}
+		else if ( sscanf( line, "APPROX %d %d %lf %d", &locid, &K, &eps, &l ) >= 3 ){
+			if ( eps < 0 ) continue;
+		}
+		else if ( sscanf( line, "FILTER %d %d %u %d", &locid, &K, &want, &l ) < 3
+			&& sscanf( line, "KNN %d %d %d %d", &locid, &K, &maxdist, &l ) < 3
+			&& sscanf( line, "%d %d %d", &locid, &K, &l ) < 2 ) continue;
+		if (locid >= Nodes.size() || locid < 0 || K < 0 || K > Nodes.size() || maxdist < 0) continue;
+		if ( l < 0 || l >= Layers.size() ) continue;
+
+		TIME_TICK_START
+		if ( shard_addrs.size() > 0 && ! sharded_knn( ctx, l, locid, K, maxdist, merged ) ) printf("A SHARD FAILED\n");
+		const vector<ResultSet> &result = shard_addrs.size() > 0 ? merged : routes ? knn_query_with_paths(ctx, *Layers[l], locid, K, maxdist)
+			: knn_query(ctx, *Layers[l], locid, K, maxdist, want, eps);
+		TIME_TICK_END
+		for ( int i = 0; i < result.size(); i++ ){
+			if ( shard_addrs.size() > 0 ) printf("ID=%d DIS=%d", result[i].id, result[i].dis );
+			else answer_print( *Layers[l], result[i] );
+			if ( eps > 0 ) printf(" LOW=%d", ctx.rstlow[i] );
+			if ( routes ){
+				printf(" PATH=");
+				for ( int j = ctx.route_off[i]; j < ctx.route_off[i + 1]; j++ ){
+					printf( j > ctx.route_off[i] ? ",%d" : "%d", ctx.route[j] );
+				}
+			}
+			printf("\n");
 		}
 		TIME_TICK_PRINT("KNN_SEARCH")
 	}
 
+	stats_dump();
 	return 0;
 }
@@ -3,35 +3,137 @@
 #include<cstdlib>
 #include<cstring>
 #include<vector>
+#include<string>
 #include<ctime>
 #include<fstream>
 #include<algorithm>
 #include<map>
+#include<set>
 #include<cmath>
 #include<queue>
 #include<sys/time.h>
 #include<metis.h>
-int times[10];//辅助计时变量；
-int cnt_type0,cnt_type1;
+#include<unistd.h>
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include "../common/minplus.h"
+#include "../common/query_stats.h"
+#include "../common/task_pool.h"
+#include "../common/hub_label.h"
+#include "../common/engine.h"
+#include "../common/planner.h"
+#include "../common/planar.h"
+#include "../common/landmark.h"
+#include "../common/radix_heap.h"
+#include<atomic>
+#include<mutex>
+#include<list>
+#include<unordered_map>
 
 using namespace std;
 const bool DEBUG_=false;
 const bool Optimization_G_tree_Search=true;//是否开启全连接加速算法
 const bool Optimization_KNN_Cut=true;//是否开启KNN剪枝查询算法
-const bool Optimization_Euclidean_Cut=false;//是否开启Catch查询中基于欧几里得距离剪枝算法
-const char Edge_File[]="COL.edge";//第一行两个整数n,m表示点数和边数，接下来m行每行三个整数U,V,C表示U->V有一条长度为C的边
-const char Node_File[]="NY_.co";//共N行每行一个整数两个实数id,x,y表示id结点的经纬度(但输入不考虑id，只顺序从0读到n-1，整数N在Edge文件里)
+bool Optimization_Euclidean_Cut=true;//是否开启Catch查询中基于欧几里得距离剪枝算法(读不到Node_File时关闭)
+const char* Edge_File="COL.edge";//第一行两个整数n,m表示点数和边数，接下来m行每行三个整数U,V,C表示U->V有一条长度为C的边
+const char* Node_File="NY_.co";//共N行每行一个整数两个实数id,x,y表示id结点的经纬度(但输入不考虑id，只顺序从0读到n-1，整数N在Edge文件里)
 const int Global_Scheduling_Cars_Per_Request=30000000;//每次规划精确计算前至多保留的车辆数目(时间开销)
-const double Unit=0.1;//路网文件的单位长度/m
-const double R_earth=6371000.0;//地球半径，用于输入经纬度转化为x,y坐标
-const double PI=acos(-1.0);
+const int Scheduling_Exact_Points=10;//车的路线需停靠的点不超过此数时精确规划(状压DP，2^n*n^2)，否则插入法(n^2)
 const int Partition_Part=4;//K叉树
 long long Additional_Memory=0;//用于构建辅助矩阵的额外空间(int)
 const int Naive_Split_Limit=33;//子图规模小于该数值全划分
 const int INF=0x3fffffff;//无穷大常量
 const bool RevE=false;//false代表有向图，true代表无向图读入边复制反向一条边
 const bool Distance_Offset=false;//KNN是否考虑车辆距离结点的修正距离
+bool Keep_Order=true;//是否保存border的floyd方案(路径查询需要)，-d仅距离时为false，索引更小
+int Build_Threads=1;//构建时floyd、车辆批量更新重算min_car_dist的线程数(-j)
+int Catch_Ways=1;//Query_Cache每个树结点保存catch的起点数(LRU，见G_Tree::catch_way)，1为只保存最近的起点(-a)
+int Path_Cache_Pairs=0;//每个Query_Cache缓存的已展开border对路径数(LRU，见G_Tree::unpack_hop)，0不缓存(-u)
+int Result_Cache_Size=0;//KNN_min_dist_car结果缓存的条数(各线程共享，见G_Tree::result_find)，0不缓存(-R)
 const bool DEBUG1=false;
+//性能计数(-p 文件)：构建各阶段与查询内部的墙钟耗时(ns，多线程阶段为各线程之和)与事件计数
+//每线程一块(无锁)，线程结束时并入perf_retired，perf_json_save合并所有块写成JSON；未开-p时只多一次判断
+enum Perf_Timer{PT_SPLIT,PT_MAKE_BORDER,PT_BUILD_DIST1,PT_BUILD_DIST2,PT_FLOYD,PT_PUSH_UP,PT_PATH_LCA,PT_PATH_UP,PT_PATH_TRIM,PT_PATH_JOIN,PT_TIMERS};
+enum Perf_Counter{PC_QUERIES,PC_LCA_DEPTH,PC_BORDER_PUSHES,PC_RELAX_CELLS,PC_CATCH_HITS,PC_CATCH_MISSES,PC_KNN_TARGETS,PC_KNN_LANDMARK_CUTS,PC_KNN_SEARCH_CUTS,PC_HOP_HITS,PC_HOP_MISSES,PC_CATCH_WAY_HITS,PC_CATCH_WAY_MISSES,PC_RESULT_HITS,PC_RESULT_STALE,PC_RESULT_EVICTIONS,PC_COUNTERS};
+const char* const Perf_Timer_Names[PT_TIMERS]={"split","make_border","build_dist1","build_dist2","floyd","push_borders_up","find_path_lca","find_path_up","find_path_trim","find_path_join"};
+const char* const Perf_Counter_Names[PC_COUNTERS]={"queries","lca_depth","border_pushes","relax_cells","catch_hits","catch_misses","knn_targets","knn_landmark_cuts","knn_search_cuts","hop_cache_hits","hop_cache_misses","catch_way_hits","catch_way_misses","result_cache_hits","result_cache_stale","result_cache_evictions"};
+bool Perf_On=false;
+struct Perf_Block
+{
+	long long ns[PT_TIMERS],calls[PT_TIMERS],count[PC_COUNTERS];
+	Perf_Block(){memset(this,0,sizeof(*this));}
+	void add(const Perf_Block &b)
+	{
+		for(int i=0;i<PT_TIMERS;i++)ns[i]+=b.ns[i],calls[i]+=b.calls[i];
+		for(int i=0;i<PC_COUNTERS;i++)count[i]+=b.count[i];
+	}
+};
+mutex perf_lock;
+vector<Perf_Block*> perf_live;//在世线程的块
+Perf_Block perf_retired;//已结束线程之和
+struct Perf_Local
+{
+	Perf_Block b;
+	Perf_Local(){lock_guard<mutex> g(perf_lock);perf_live.push_back(&b);}
+	~Perf_Local()
+	{
+		lock_guard<mutex> g(perf_lock);
+		perf_retired.add(b);
+		perf_live.erase(find(perf_live.begin(),perf_live.end(),&b));
+	}
+};
+inline Perf_Block& perf_local(){thread_local Perf_Local l;return l.b;}
+inline void perf_count(int c,long long n=1){if(Perf_On)perf_local().count[c]+=n;}
+struct Perf_Scope//作用域计时：构造(或next)到析构(或下一个next)的墙钟时间记入计时器t
+{
+	int t;
+	long long t0;
+	Perf_Scope(int t_):t(t_),t0(Perf_On?stats_now():0){}
+	~Perf_Scope(){stop();}
+	void stop()
+	{
+		if(!Perf_On||t<0)return;
+		Perf_Block &b=perf_local();
+		b.ns[t]+=stats_now()-t0;
+		b.calls[t]++;
+		t=-1;
+	}
+	void next(int t_)//结束当前阶段，开始阶段t_
+	{
+		stop();
+		t=t_;
+		if(Perf_On)t0=stats_now();
+	}
+};
+bool perf_json_save(const char* file)//合并各线程的块写入file(先写.tmp再改名)，另附由计数求出的比率
+{
+	Perf_Block sum;
+	{
+		lock_guard<mutex> g(perf_lock);
+		sum=perf_retired;
+		for(int i=0;i<(int)perf_live.size();i++)sum.add(*perf_live[i]);
+	}
+	string tmp=string(file)+".tmp";
+	FILE* out=fopen(tmp.c_str(),"w");
+	if(out==NULL)return false;
+	fprintf(out,"{\n  \"timers\": {");
+	for(int i=0;i<PT_TIMERS;i++)
+		fprintf(out,"%s\n    \"%s\": { \"calls\": %lld, \"total_ms\": %.3f, \"mean_us\": %.3f }",i>0?",":"",Perf_Timer_Names[i],
+			sum.calls[i],sum.ns[i]/1e6,sum.calls[i]>0?sum.ns[i]/1e3/sum.calls[i]:0.0);
+	fprintf(out,"\n  },\n  \"counters\": {");
+	for(int i=0;i<PC_COUNTERS;i++)fprintf(out,"%s\n    \"%s\": %lld",i>0?",":"",Perf_Counter_Names[i],sum.count[i]);
+	long long *c=sum.count;
+	fprintf(out,"\n  },\n  \"ratios\": {\n    \"catch_hit_rate\": %.4f,\n    \"catch_way_hit_rate\": %.4f,\n    \"lca_depth_mean\": %.3f,\n    \"knn_cut_rate\": %.4f\n  }\n}\n",
+		c[PC_CATCH_HITS]+c[PC_CATCH_MISSES]>0?(double)c[PC_CATCH_HITS]/(c[PC_CATCH_HITS]+c[PC_CATCH_MISSES]):0.0,
+		c[PC_CATCH_WAY_HITS]+c[PC_CATCH_WAY_MISSES]>0?(double)c[PC_CATCH_WAY_HITS]/(c[PC_CATCH_WAY_HITS]+c[PC_CATCH_WAY_MISSES]):0.0,
+		c[PC_QUERIES]>0?(double)c[PC_LCA_DEPTH]/c[PC_QUERIES]:0.0,
+		c[PC_KNN_TARGETS]>0?(double)(c[PC_KNN_LANDMARK_CUTS]+c[PC_KNN_SEARCH_CUTS])/c[PC_KNN_TARGETS]:0.0);
+	bool ok=fclose(out)==0;
+	if(ok)ok=rename(tmp.c_str(),file)==0;
+	if(!ok)remove(tmp.c_str());
+	return ok;
+}
 #define TIME_TICK_START gettimeofday( &tv, NULL ); ts = tv.tv_sec * 100000 + tv.tv_usec / 10;
 #define TIME_TICK_END gettimeofday( &tv, NULL ); te = tv.tv_sec * 100000 + tv.tv_usec / 10;
 #define TIME_TICK_PRINT(T) printf("%s RESULT: %lld (0.01MS)\r\n", (#T), te - ts );
@@ -110,183 +212,179 @@ struct Heap//双指针大根堆
 		printf("draw_end\n");
 	}
 };
-void save_vector(const vector<int> &v)
-{
-	printf("%d ",(int)v.size());
-	for(int i=0;i<(int)v.size();i++)printf("%d ",v[i]);
-	printf("\n");
-}
-void load_vector(vector<int> &v)
+//索引文件的二进制读写(见save/load)：整数按本机字节序原样写入，vector写为(long long长度,数据)
+//读取时整个文件mmap，Bin_Reader按游标memcpy到各结构，不做任何文本解析；越界(截断的文件)时ok=false
+struct Bin_Writer
 {
-	v.clear();
-	int n,i,j;
-	scanf("%d",&n);
-	for(i=0;i<n;i++)
+	FILE *out;
+	long long pos;//已写字节数
+	bool ok;
+	void put(const void *p,long long bytes)
 	{
-		scanf("%d",&j);
-		v.push_back(j);
+		if(bytes>0&&fwrite(p,1,bytes,out)!=(size_t)bytes)ok=false;
+		pos+=bytes;
 	}
-}
-void save_vector_vector(const vector<vector<int> > &v)
-{
-	printf("%d\n",(int)v.size());
-	for(int i=0;i<(int)v.size();i++)save_vector(v[i]);
-	printf("\n");
-}
-void load_vector_vector(vector<vector<int> > &v)
+	void put_int(int x){put(&x,sizeof(int));}
+	void put_count(long long x){put(&x,sizeof(long long));}
+};
+struct Bin_Reader
 {
-	v.clear();
-	int n,i,j;
-	scanf("%d",&n);
-	vector<int>ls;
-	for(i=0;i<n;i++)
+	const char *p,*end;
+	bool ok;
+	void get(void *q,long long bytes)
 	{
-		load_vector(ls);
-		v.push_back(ls);
+		if(!ok||bytes<0||end-p<bytes){ok=false;return;}
+		memcpy(q,p,bytes);
+		p+=bytes;
 	}
-}
-void save_vector_pair(const vector<pair<int,int> > &v)
-{
-	printf("%d ",(int)v.size());
-	for(int i=0;i<(int)v.size();i++)printf("%d %d ",v[i].first,v[i].second);
-	printf("\n");
-}
-void load_vector_pair(vector<pair<int,int> > &v)
-{
-	v.clear();
-	int n,i,j,k;
-	scanf("%d",&n);
-	for(i=0;i<n;i++)
+	int get_int(){int x=0;get(&x,sizeof(int));return x;}
+	long long get_count(long long item)//元素个数，放不下剩余字节时置错
 	{
-		scanf("%d%d",&j,&k);
-		v.push_back(make_pair(j,k));
+		long long n=-1;
+		get(&n,sizeof(long long));
+		if(!ok||n<0||n>(end-p)/item){ok=false;return 0;}
+		return n;
 	}
+};
+template<class T>void save_vector(Bin_Writer &w,const vector<T> &v)//T为int/unsigned等定长类型
+{
+	w.put_count(v.size());
+	if(v.size()>0)w.put(&v[0],(long long)v.size()*sizeof(T));
 }
-void save_map_int_pair(map<int,pair<int,int> > &h)
+template<class T>void load_vector(Bin_Reader &r,vector<T> &v)
 {
-	printf("%d\n",h.size());
-	map<int,pair<int,int> >::iterator iter;
-	for(iter=h.begin();iter!=h.end();iter++)
-		printf("%d %d %d\n",iter->first,iter->second.first,iter->second.second);
+	v.resize(r.get_count(sizeof(T)));
+	if(v.size()>0)r.get(&v[0],(long long)v.size()*sizeof(T));
 }
-void load_map_int_pair(map<int,pair<int,int> > &h)
+void save_vector_vector(Bin_Writer &w,const vector<vector<int> > &v)
 {
-	int n,i,j,k,l;
-	scanf("%d",&n);
-	for(i=0;i<n;i++)
-	{
-		scanf("%d%d%d",&j,&k,&l);
-		h[j]=make_pair(k,l);
-	}
+	w.put_count(v.size());
+	for(int i=0;i<(int)v.size();i++)save_vector(w,v[i]);
 }
-void save_map_int_int(map<int,int> &h)
+void load_vector_vector(Bin_Reader &r,vector<vector<int> > &v)
 {
-	printf("%d\n",h.size());
-	map<int,int>::iterator iter;
-	for(iter=h.begin();iter!=h.end();iter++)
-		printf("%d %d\n",iter->first,iter->second);
+	v.resize(r.get_count(sizeof(long long)));
+	for(int i=0;i<(int)v.size();i++)load_vector(r,v[i]);
 }
-void load_map_int_int(map<int,int> &h)
+void save_vector_pair(Bin_Writer &w,const vector<pair<int,int> > &v)
 {
-	int n,i,j,k;
-	scanf("%d",&n);
-	for(i=0;i<n;i++)
-	{
-		scanf("%d%d",&j,&k);
-		h[j]=k;
-	}
+	w.put_count(v.size());
+	for(int i=0;i<(int)v.size();i++){w.put_int(v[i].first);w.put_int(v[i].second);}
 }
-struct coor{coor(double a=0.0,double b=0.0):x(a),y(b){}double x,y;};
-vector<coor>coordinate;
-double coor_dist(const coor &a,const coor &b)
+void load_vector_pair(Bin_Reader &r,vector<pair<int,int> > &v)
 {
-	return sqrt((a.x-b.x)*(a.x-b.x)+(a.y-b.y)*(a.y-b.y));
+	v.resize(r.get_count(2*sizeof(int)));
+	for(int i=0;i<(int)v.size();i++){v[i].first=r.get_int();v[i].second=r.get_int();}
 }
-double Distance_(double a1,double b1,double a2,double b2 )
+void save_map_int_pair(Bin_Writer &w,map<int,pair<int,int> > &h)
 {
-	double x,y,z,AB,A_B;
-	if(b1 < 0)
+	w.put_count(h.size());
+	map<int,pair<int,int> >::iterator iter;
+	for(iter=h.begin();iter!=h.end();iter++)
 	{
-		b1 = abs(b1) + 180;
+		w.put_int(iter->first);
+		w.put_int(iter->second.first);
+		w.put_int(iter->second.second);
 	}
-	if(b2 < 0)
+}
+void load_map_int_pair(Bin_Reader &r,map<int,pair<int,int> > &h)
+{
+	h.clear();
+	long long n=r.get_count(3*sizeof(int));
+	for(long long i=0;i<n;i++)
 	{
-		b2 = abs(b2) + 180;
+		int j=r.get_int(),k=r.get_int(),l=r.get_int();
+		h.insert(h.end(),make_pair(j,make_pair(k,l)));//按键升序写入，在末尾插入为O(1)
 	}
-	a1 = a1 * PI /180;
-	b1 = b1 * PI/180;
-	a2 = a2 * PI /180;
-	b2 = b2 * PI /180;
-	x = R_earth * cos(b1)*cos(a1) - R_earth * cos(b2)*cos(a2);
-	y = R_earth * cos(b1)*sin(a1) - R_earth * cos(b2)*sin(a2);
-	z = R_earth * sin(b1) - R_earth * sin(b2);
-	AB = sqrt(x*x + y*y + z*z);
-	A_B= 2 * asin(AB /(2*R_earth)) * R_earth;
-	return A_B;
 }
-double Euclidean_Dist(int S,int T)//计算节点S,T的欧几里得距离在路网数据中的长度
+Planar Coordinate;//结点的投影坐标(经纬度文件Node_File读入，按边长标定为路网距离的下界)
+Landmarks Landmark;//可选的地标(-L k)，landmark_bound(Landmark,S,T)为路网距离的下界，k=0时为0
+double Euclidean_Dist(int S,int T)//节点S,T的直线距离(不超过路网距离)，无坐标时为0
 {
-	return Distance_(coordinate[S].x,coordinate[S].y,coordinate[T].x,coordinate[T].y)/Unit;
+	return planar_bound(Coordinate,S,T);
 }
+#define KNN_LOCKS 4096//Graph::KNN_init多线程时保护结点行的锁数(按结点编号取模)
 struct Graph//无向图结构 
 {
 	int n,m;//n个点m条边 点从0编号到n-1
-	int tot;
 	vector<int>id;//id[i]为子图中i点在原图中的真实编号
-	vector<int>head,list,next,cost;//邻接表
+	vector<int>head,list,cost;//CSR邻接表：点i的出边为[head[i],head[i+1])，终点list、权值cost连续存放
+	vector<int>from;//建图中add_D加入的边的起点，build_csr后清空
 	Graph(){clear();}
 	~Graph(){clear();}
-	void save()//保存结构信息(stdout输出)
+	void save(Bin_Writer &w)//保存结构信息
 	{
-		printf("%d %d %d\n",n,m,tot);
-		save_vector(id);
-		save_vector(head);
-		save_vector(list);
-		save_vector(next);
-		save_vector(cost);
+		w.put_int(n);w.put_int(m);
+		save_vector(w,id);
+		save_vector(w,head);
+		save_vector(w,list);
+		save_vector(w,cost);
 	}
-	void load()//读取结构信息(stdout输出)
+	void load(Bin_Reader &r)//读取结构信息
 	{
-		scanf("%d%d%d",&n,&m,&tot);
-		load_vector(id);
-		load_vector(head);
-		load_vector(list);
-		load_vector(next);
-		load_vector(cost);
+		n=r.get_int();m=r.get_int();
+		load_vector(r,id);
+		load_vector(r,head);
+		load_vector(r,list);
+		load_vector(r,cost);
+		if(r.ok&&(head.size()!=n+1||head[n]!=list.size()||cost.size()!=list.size()))r.ok=false;
 	}
-	void add_D(int a,int b,int c)//加入一条a->b权值为c的有向边
+	int edges()const{return list.size();}
+	void add_D(int a,int b,int c)//加入一条a->b权值为c的有向边(加完后build_csr)
 	{
-		tot++;
-		list[tot]=b;
-		cost[tot]=c;
-		next[tot]=head[a];
-		head[a]=tot;
+		from.push_back(a);
+		list.push_back(b);
+		cost.push_back(c);
 	}
 	void add(int a,int b,int c)//加入一条a<->b权值为c的无向边
 	{
 		add_D(a,b,c);
 		add_D(b,a,c);
 	}
-	void init(int N,int M,int t=1)
+	void build_csr()//按起点分组成CSR，每个点的出边为加入的逆序(同原链式前向星的遍历顺序，划分与搜索结果不变)
+	{
+		head.assign(n+1,0);
+		for(int e=0;e<(int)from.size();e++)head[from[e]+1]++;
+		for(int v=0;v<n;v++)head[v+1]+=head[v];
+		vector<int>pos(head.begin()+1,head.end()),l(list.size()),c(cost.size());
+		for(int e=0;e<(int)from.size();e++)
+		{
+			int k=--pos[from[e]];
+			l[k]=list[e];
+			c[k]=cost[e];
+		}
+		list.swap(l);
+		cost.swap(c);
+		vector<int>().swap(from);
+	}
+	void init(int N,int M)//N个点M条边(按双向预留)
 	{
 		clear();
 		n=N;m=M;
-		tot=t;
-		head=vector<int>(N);
+		head.assign(N+1,0);
 		id=vector<int>(N);
-		list=vector<int>(M*2+2);
-		next=vector<int>(M*2+2);
-		cost=vector<int>(M*2+2);
+		from.reserve(M*2);
+		list.reserve(M*2);
+		cost.reserve(M*2);
 	}
 	void clear()
 	{
-		n=m=tot=0;
+		n=m=0;
 		head.clear();
 		list.clear();
-		next.clear();
 		cost.clear();
+		from.clear();
 		id.clear();
 	}
+	void release()//清空并释放邻接表内存(clear不释放容量)
+	{
+		n=m=0;
+		vector<int>().swap(head);
+		vector<int>().swap(list);
+		vector<int>().swap(cost);
+		vector<int>().swap(from);
+		vector<int>().swap(id);
+	}
 	void draw()//输出图结构
 	{	
 		printf("Graph:%d n=%d m=%d\n",this,n,m);
@@ -294,7 +392,7 @@ struct Graph//无向图结构
 		for(int i=0;i<n;i++)
 		{
 			printf("%d:",i);
-			for(int j=head[i];j;j=next[j])printf(" %d",list[j]);
+			for(int j=head[i];j<head[i+1];j++)printf(" %d",list[j]);
 			cout<<endl;
 		}
 		printf("Graph_draw_end\n");
@@ -302,7 +400,7 @@ struct Graph//无向图结构
 	//图划分算法
 	vector<int>color;//01染色数组
 	vector<int>con;//连通性
-	vector<int> Split(Graph *G[],int nparts)//将子图一分为二返回color数组，并将两部分分别存至G1，G2 METIS algorithm,npart表示划分块数
+	vector<int> Split(Graph *G[],int nparts)const//将子图一分为二返回color数组，并将两部分分别存至G1，G2 METIS algorithm,npart表示划分块数
 	{
 		
 		vector<int>color(n);
@@ -343,8 +441,8 @@ struct Graph//无向图结构
 			//transform
 			int *xadj = new idx_t[n + 1];
 			int *adj=new idx_t[n+1];
-			int *adjncy = new idx_t[tot-1];
-			int *adjwgt = new idx_t[tot-1];
+			int *adjncy = new idx_t[edges()];
+			int *adjwgt = new idx_t[edges()];
 			int *part = new idx_t[n];
 
 
@@ -371,7 +469,7 @@ struct Graph//无向图结构
 					}
 				}
 				xadj[xadj_pos++] = xadj_accum;*/
-				for(int j=head[i];j;j=next[j])
+				for(int j=head[i];j<head[i+1];j++)
 				{
 					int enid = list[j];
 					xadj_accum ++;
@@ -422,7 +520,7 @@ struct Graph//无向图结构
 		for(i=0;i<n;i++)
 			new_id.push_back(tot[color[i]]++);
 		for(i=0;i<n;i++)
-			for(j=head[i];j;j=next[j])
+			for(j=head[i];j<head[i+1];j++)
 				if(color[list[j]]==color[i])
 					m[color[i]]++;
 		for(int t=0;t<nparts;t++)
@@ -430,9 +528,10 @@ struct Graph//无向图结构
 			(*G[t]).init(tot[t],m[t]);
 			for(i=0;i<n;i++)
 				if(color[i]==t)
-					for(j=head[i];j;j=next[j])
+					for(j=head[i];j<head[i+1];j++)
 						if(color[list[j]]==color[i])
 							(*G[t]).add_D(new_id[i],new_id[list[j]],cost[j]);
+			(*G[t]).build_csr();
 		}
 		for(i=0;i<tot.size();i++)tot[i]=0;
 		for(i=0;i<n;i++)
@@ -456,7 +555,7 @@ struct Graph//无向图结构
 		for(i=0;i<n;i++)
 		{
 			k=0;
-			for(j=head[i];j;j=next[j])
+			for(j=head[i];j<head[i+1];j++)
 				if(color[list[j]]^color[i])k++;
 			con.push_back(k);
 		}
@@ -467,7 +566,7 @@ struct Graph//无向图结构
 		for(i=0;i<n;i++)
 		{
 			k=0;
-			for(j=head[i];j;j=next[j])
+			for(j=head[i];j<head[i+1];j++)
 				if(color[list[j]]^color[i])ans++,k++;
 				else k--;
 			q[color[i]].push(k);
@@ -484,7 +583,7 @@ struct Graph//无向图结构
 			{
 				i=q[l].top_id();
 				k=0;
-				for(j=head[i];j;j=next[j])
+				for(j=head[i];j<head[i+1];j++)
 				{
 					if(color[list[j]]^color[i])k--;
 					else k++;
@@ -504,7 +603,7 @@ struct Graph//无向图结构
 		{
 			int border_num=0;
 			for(i=0;i<n;i++)
-				for(j=head[i];j;j=next[j])
+				for(j=head[i];j<head[i+1];j++)
 					if(color[i]!=color[list[j]]){border_num++;break;}
 					printf("边连通度ans=%d border_number=%d\n",ans,border_num);
 		}
@@ -520,7 +619,7 @@ struct Graph//无向图结构
 			else new_id.push_back(tot1++);
 		}
 		for(i=0;i<n;i++)
-				for(j=head[i];j;j=next[j])
+				for(j=head[i];j<head[i+1];j++)
 					if(1^color[list[j]]^color[i])
 					{
 						if(color[i]==0)m0++;
@@ -529,15 +628,17 @@ struct Graph//无向图结构
 		G1.init(tot0,m0);
 		for(i=0;i<n;i++)
 			if(color[i]==0)
-				for(j=head[i];j;j=next[j])
+				for(j=head[i];j<head[i+1];j++)
 					if(color[list[j]]==color[i])
 						G1.add_D(new_id[i],new_id[list[j]],cost[j]);
+		G1.build_csr();
 		G2.init(tot1,m1);
 		for(i=0;i<n;i++)
 			if(color[i]==1)
-				for(j=head[i];j;j=next[j])
+				for(j=head[i];j<head[i+1];j++)
 					if(color[list[j]]==color[i])
 						G2.add_D(new_id[i],new_id[list[j]],cost[j]);
+		G2.build_csr();
 		tot0=tot1=0;
 		for(i=0;i<n;i++)
 		{
@@ -547,7 +648,7 @@ struct Graph//无向图结构
 		if(DEBUG1)printf("Split_over\n");
 		return color;
 	}
-	int Split_Borders(int nparts)//将该图划分为nparts块后会产生的border数
+	int Split_Borders(int nparts)const//将该图划分为nparts块后会产生的border数
 	{
 		if(n<Naive_Split_Limit)
 		{
@@ -577,8 +678,8 @@ struct Graph//无向图结构
 		vector<int>color(n);
 		int *xadj = new idx_t[n + 1];
 		int *adj=new idx_t[n+1];
-		int *adjncy = new idx_t[tot-1];
-		int *adjwgt = new idx_t[tot-1];
+		int *adjncy = new idx_t[edges()];
+		int *adjwgt = new idx_t[edges()];
 		int *part = new idx_t[n];
 
 
@@ -590,7 +691,7 @@ struct Graph//无向图结构
 		xadj[0] = 0;
 		int i = 0;
 		for (int i=0;i<n;i++){
-			for(int j=head[i];j;j=next[j])
+			for(int j=head[i];j<head[i+1];j++)
 			{
 				int enid = list[j];
 				xadj_accum ++;
@@ -623,7 +724,7 @@ struct Graph//无向图结构
 		//划分
 		int j,re=0;
 		for(i=0;i<n;i++)
-			for(j=head[i];j;j=next[j])
+			for(j=head[i];j<head[i+1];j++)
 				if(color[i]!=color[list[j]])
 				{
 					re++;
@@ -636,25 +737,21 @@ struct Graph//无向图结构
 		delete [] part;
 		return re;
 	}
-	struct state{state(int a=0,int b=0,int c=0):id(a),len(b),index(c){}int id,len,index;};//用于dijkstra的二元组
-	struct cmp{bool operator()(const state &a,const state &b){return a.len>b.len;}};//重载priority_queue的比较函数
 	void dijkstra(int S,vector<int> &dist)//依据本图计算以S为起点的全局最短路将结果存入dist
 	{
-		priority_queue<state,vector<state>,cmp>q;
-		state now;
+		RadixHeap<int>q;//<len,id>
 		int i;
-		dist.clear();
-		while((int)dist.size()<n)dist.push_back(INF);
-		q.push(state(S,0));
-		while(q.size())
+		dist.assign(n,INF);
+		radix_clear(q);
+		radix_push(q,0,S);
+		while(!radix_empty(q))
 		{
-			now=q.top();
-			q.pop();
-			if(dist[now.id]==INF)
+			pair<unsigned,int>now=radix_pop(q);
+			if(dist[now.second]==INF)
 			{
-				dist[now.id]=now.len;
-				for(i=head[now.id];i;i=next[i])
-					if(dist[list[i]]==INF)q.push(state(list[i],dist[now.id]+cost[i]));
+				dist[now.second]=now.first;
+				for(i=head[now.second];i<head[now.second+1];i++)
+					if(dist[list[i]]==INF)radix_push(q,dist[now.second]+cost[i],list[i]);
 			}
 		}
 	}
@@ -663,21 +760,20 @@ struct Graph//无向图结构
 		int i;
 		vector<int>dist(n,INF),Cnt(n,0);
 		for(i=0;i<T.size();i++)Cnt[T[i]]++;
-		priority_queue<state,vector<state>,cmp>q;
-		state now;
-		q.push(state(S,0));
-		int bound,cnt=0;
-		while(q.size()&&cnt<K)
+		RadixHeap<int>q;//<len,id>
+		radix_clear(q);
+		radix_push(q,0,S);
+		int bound=INF,cnt=0;
+		while(!radix_empty(q)&&cnt<K)
 		{
-			now=q.top();
-			q.pop();
-			if(dist[now.id]==INF)
+			pair<unsigned,int>now=radix_pop(q);
+			if(dist[now.second]==INF)
 			{
-				dist[now.id]=now.len;
-				cnt+=Cnt[now.id];
-				if(cnt>=K)bound=now.len;
-				for(i=head[now.id];i;i=next[i])
-					if(dist[list[i]]==INF)q.push(state(list[i],dist[now.id]+cost[i]));
+				dist[now.second]=now.first;
+				cnt+=Cnt[now.second];
+				if(cnt>=K)bound=now.first;
+				for(i=head[now.second];i<head[now.second+1];i++)
+					if(dist[list[i]]==INF)radix_push(q,dist[now.second]+cost[i],list[i]);
 			}
 		}
 		vector<int>re;
@@ -688,30 +784,21 @@ struct Graph//无向图结构
 	}
 	vector<int> find_path(int S,int T)//依据本图计算以S为起点的全局最短路将结果存入dist
 	{
-		vector<int>dist,re,last;
-		priority_queue<state,vector<state>,cmp>q;
-		state now;
+		vector<int>dist(n,INF),re,last(n,0);
+		RadixHeap<int>q;//<len,id>
 		int i;
-		dist.clear();
-		last.clear();
-		re.clear();
-		while((int)dist.size()<n)
+		radix_clear(q);
+		radix_push(q,0,S);
+		while(!radix_empty(q))
 		{
-			dist.push_back(INF);
-			last.push_back(0);
-		}
-		q.push(state(S,0));
-		while(q.size())
-		{
-			now=q.top();
-			q.pop();
-			if(dist[now.id]==INF)
+			pair<unsigned,int>now=radix_pop(q);
+			if(dist[now.second]==INF)
 			{
-				dist[now.id]=now.len;
-				for(i=head[now.id];i;i=next[i])
+				dist[now.second]=now.first;
+				for(i=head[now.second];i<head[now.second+1];i++)
 				{
-					if(dist[list[i]]==INF)q.push(state(list[i],dist[now.id]+cost[i]));
-					if(dist[list[i]]+cost[i]==dist[now.id])last[now.id]=list[i];
+					if(dist[list[i]]==INF)radix_push(q,dist[now.second]+cost[i],list[i]);
+					if(dist[list[i]]+cost[i]==dist[now.second])last[now.second]=list[i];
 				}
 			}
 		}
@@ -730,68 +817,261 @@ struct Graph//无向图结构
 		for(int i=0;i<n;i++)
 		{
 			int k=0;
-			for(int j=head[i];j;j=next[j])k++;
+			for(int j=head[i];j<head[i+1];j++)k++;
 			if(k!=2)ans++;
 		}
 		return ans;
 	}
 
-	//给定起点集合S，处理到每个结点的前K短路长度以及起点编号在list中的编号
-	vector<vector<int> >K_Near_Dist,K_Near_Order;
-	void KNN_init(const vector<int> &S , int K)
+	//给定起点集合S，处理到每个结点的前K近起点(不同起点)的距离以及起点在S中的编号
+	//结果为n*K的平铺表：结点v的第i近在[v*K+i]，按距离从小到大，不足K个的后面为INF/-1
+	//多源dijkstra每个结点只接受最先到达的K个不同起点，只有被接受的才继续扩张(起点s在v的前K中，则在s到v最短路的每个点的前K中)
+	vector<int>K_Near_Dist,K_Near_Order,K_Near_Cnt;
+	vector<int>K_Near_Source;//编号i的起点所在结点，删去的为-1
+	int K_Near_K;
+	vector<int>rev_head,rev_from,rev_cost;//反向边CSR，增量删除时找入边
+	//行内按(距离,起点编号)排序：距离相同时也有唯一的前K，增量维护与合并才与整体重算一致
+	bool knn_accept(int *dist,int *order,int &cnt,int K,int d,int index)//结点行(dist,order,cnt)中按序插入(d,index)(行满时挤掉最后一个)，已有该起点或行满且不更近时返回false
 	{
-		priority_queue<state,vector<state>,cmp>q;
-		state now;
-		int i;
-		vector<int>empty;
-		K_Near_Dist.clear();
-		K_Near_Order.clear();
-		while((int)K_Near_Dist.size()<n)
+		for(int j=0;j<cnt;j++)if(order[j]==index)return false;
+		if(cnt==K&&(d>dist[K-1]||(d==dist[K-1]&&index>order[K-1])))return false;
+		int j=cnt<K?cnt++:K-1;
+		for(;j>0&&(dist[j-1]>d||(dist[j-1]==d&&order[j-1]>index));j--)
+		{
+			dist[j]=dist[j-1];
+			order[j]=order[j-1];
+		}
+		dist[j]=d;
+		order[j]=index;
+		return true;
+	}
+	void knn_search(RadixHeap<pair<int,int> >&q,int *dist,int *order,int *cnt,int K,const vector<char>*region,mutex *lock=NULL)//从q中已有的<len,<结点,起点编号>>出发扩张，region非空时只改其中的结点
+	{//lock非空时表为多个搜索共用：结点v的行由lock[v%KNN_LOCKS]保护，入队前不看邻居的行
+		while(!radix_empty(q))
+		{
+			pair<unsigned,pair<int,int> >now=radix_pop(q);
+			int v=now.second.first;
+			long long r=(long long)v*K;
+			if(lock!=NULL)
+			{
+				lock_guard<mutex> g(lock[v%KNN_LOCKS]);
+				if(!knn_accept(dist+r,order+r,cnt[v],K,now.first,now.second.second))continue;
+			}
+			else if(!knn_accept(dist+r,order+r,cnt[v],K,now.first,now.second.second))continue;
+			for(int i=head[v];i<head[v+1];i++)
+			{
+				int u=list[i];
+				if(region!=NULL&&!(*region)[u])continue;
+				if(lock!=NULL||cnt[u]<K||now.first+cost[i]<=dist[(long long)u*K+K-1])radix_push(q,now.first+cost[i],make_pair(u,now.second.second));
+			}
+		}
+	}
+	void KNN_init(const vector<int> &S , int K, int threads = 1)//起点分成threads组同时扩张，共用一张表：
+	{//每组只扩张在表中仍排得进前K的，被挤掉的都有K个更近的真实起点在前，结果与单个多源dijkstra相同
+		K_Near_K=K;
+		K_Near_Source=S;
+		K_Near_Dist.assign((long long)n*K,INF);
+		K_Near_Order.assign((long long)n*K,-1);
+		K_Near_Cnt.assign(n,0);
+		rev_head.assign(n+1,0);
+		for(int v=0;v<n;v++)for(int i=head[v];i<head[v+1];i++)rev_head[list[i]+1]++;
+		for(int v=0;v<n;v++)rev_head[v+1]+=rev_head[v];
+		rev_from.resize(rev_head[n]);
+		rev_cost.resize(rev_head[n]);
+		vector<int>pos(rev_head.begin(),rev_head.end()-1);
+		for(int v=0;v<n;v++)for(int i=head[v];i<head[v+1];i++)
+		{
+			rev_from[pos[list[i]]]=v;
+			rev_cost[pos[list[i]]++]=cost[i];
+		}
+		if(K<=0)return;
+		if(threads>(int)S.size())threads=S.size();
+		vector<mutex>lock(threads>1?KNN_LOCKS:0);
+		parallel_for(threads,threads,[&](int worker,int t){
+			RadixHeap<pair<int,int> >q;
+			radix_clear(q);
+			for(int i=t;i<S.size();i+=threads)radix_push(q,0,make_pair(S[i],i));
+			knn_search(q,&K_Near_Dist[0],&K_Near_Order[0],&K_Near_Cnt[0],K,NULL,threads>1?&lock[0]:NULL);
+		});
+	}
+	int KNN_insert(int s)//增加一个起点(结点s)并返回其编号：只从s出发，到不了某结点的前K就不再扩张
+	{
+		int index=K_Near_Source.size();
+		K_Near_Source.push_back(s);
+		if(K_Near_K<=0)return index;
+		RadixHeap<pair<int,int> >q;
+		radix_clear(q);
+		radix_push(q,0,make_pair(s,index));
+		knn_search(q,&K_Near_Dist[0],&K_Near_Order[0],&K_Near_Cnt[0],K_Near_K,NULL);
+		return index;
+	}
+	void KNN_remove(int index)//删去编号index的起点：受影响的只有前K含它的结点(从它出发沿含它的结点可达)，
+	{//去掉后由这些结点的入边邻居的前K重新多源扩张补齐，只改受影响的结点
+		if(index<0||index>=K_Near_Source.size()||K_Near_Source[index]==-1)return;
+		int K=K_Near_K,s=K_Near_Source[index];
+		K_Near_Source[index]=-1;
+		if(K<=0)return;
+		vector<char>region(n,0);
+		vector<int>area;
+		area.push_back(s);
+		region[s]=1;
+		for(int h=0;h<area.size();h++)
+		{
+			int v=area[h];
+			for(int i=head[v];i<head[v+1];i++)
+			{
+				int u=list[i];
+				if(region[u])continue;
+				for(int j=0;j<K_Near_Cnt[u];j++)
+					if(K_Near_Order[(long long)u*K+j]==index)
+					{
+						region[u]=1;
+						area.push_back(u);
+						break;
+					}
+			}
+		}
+		RadixHeap<pair<int,int> >q;
+		radix_clear(q);
+		for(int h=0;h<area.size();h++)
 		{
-			K_Near_Dist.push_back(empty);
-			K_Near_Order.push_back(empty);
+			int v=area[h];
+			long long r=(long long)v*K;
+			int c=0;
+			for(int j=0;j<K_Near_Cnt[v];j++)
+				if(K_Near_Order[r+j]!=index)
+				{
+					K_Near_Dist[r+c]=K_Near_Dist[r+j];
+					K_Near_Order[r+c++]=K_Near_Order[r+j];
+				}
+			for(int j=c;j<K_Near_Cnt[v];j++)
+			{
+				K_Near_Dist[r+j]=INF;
+				K_Near_Order[r+j]=-1;
+			}
+			K_Near_Cnt[v]=c;
 		}
-		for(int i=0;i<S.size();i++)
-		q.push(state(S[i],0,i));
-		while(q.size())
+		for(int h=0;h<area.size();h++)
 		{
-			now=q.top();
-			q.pop();
-			if(K_Near_Dist[now.id].size()<K)
+			int v=area[h];
+			for(int e=rev_head[v];e<rev_head[v+1];e++)
 			{
-				K_Near_Dist[now.id].push_back(now.len);
-				K_Near_Order[now.id].push_back(now.index);
-				for(i=head[now.id];i;i=next[i])
-					if(K_Near_Dist[list[i]].size()<K)q.push(state(list[i],now.len+cost[i]));
+				int u=rev_from[e];
+				long long r=(long long)u*K;
+				for(int j=0;j<K_Near_Cnt[u];j++)radix_push(q,K_Near_Dist[r+j]+rev_cost[e],make_pair(v,K_Near_Order[r+j]));
 			}
 		}
+		for(int i=0;i<K_Near_Source.size();i++)//受影响结点上的其他起点(如与删去的同在一个结点)
+			if(K_Near_Source[i]!=-1&&region[K_Near_Source[i]])radix_push(q,0,make_pair(K_Near_Source[i],i));
+		knn_search(q,&K_Near_Dist[0],&K_Near_Order[0],&K_Near_Cnt[0],K,&region);
 	}
-	vector<int>* KNN_Dijkstra(int S){return &K_Near_Order[S];}
+	const int* KNN_Dijkstra(int S){return &K_Near_Order[(long long)S*K_Near_K];}//S的前K近起点编号(K_Near_Cnt[S]个，之后为-1)
 }G;
-struct Matrix//矩阵
+//border的floyd方案矩阵(G_Tree::Node::order)：取值只有中间点k(0~n-1)与-1,-2,-3,-INF，
+//按n每格存1/2/4字节(-INF存为-4)；Keep_Order=false(-d 仅距离)时不分配也不保存，set无效，get恒为-INF
+struct Order_Matrix
+{
+	Order_Matrix():n(0),width(0),data(NULL){}
+	~Order_Matrix(){clear();}
+	int n;
+	int width;//每格字节数，0表示没有方案
+	char *data;
+	void clear()
+	{
+		delete [] data;
+		data=NULL;
+		n=width=0;
+	}
+	static int width_of(int N){return N<=128?1:(N<=32768?2:4);}
+	void init(int N)//全部置为-INF(无方案)
+	{
+		clear();
+		n=N;
+		if(!Keep_Order)return;
+		width=width_of(N);
+		data=new char[(long long)N*N*width];
+		for(long long i=0;i<(long long)N*N;i++)put(i,-INF);
+	}
+	void put(long long p,int v)
+	{
+		if(v==-INF)v=-4;
+		if(width==1)((signed char*)data)[p]=v;
+		else if(width==2)((short*)data)[p]=v;
+		else ((int*)data)[p]=v;
+	}
+	void set(int i,int j,int v){if(width>0)put((long long)i*n+j,v);}
+	int get(int i,int j)const
+	{
+		if(width==0)return -INF;
+		long long p=(long long)i*n+j;
+		int v=width==1?((const signed char*)data)[p]:(width==2?((const short*)data)[p]:((const int*)data)[p]);
+		return v==-4?-INF:v;
+	}
+	void save(Bin_Writer &w)
+	{
+		w.put_int(n);
+		w.put_int(width);
+		if(width>0)w.put(data,(long long)n*n*width);
+	}
+	void load(Bin_Reader &r)
+	{
+		clear();
+		int N=r.get_int(),W=r.get_int();
+		if(!r.ok||N<0||(W!=0&&W!=width_of(N))||(long long)N*N*W>r.end-r.p){r.ok=false;return;}
+		n=N;
+		width=W;
+		if(width==0)return;
+		data=new char[(long long)n*n*width];
+		r.get(data,(long long)n*n*width);
+	}
+	void write()
+	{
+		printf("n=%d\n",n);
+		for(int i=0;i<n;i++,cout<<endl)
+			for(int j=0;j<n;j++)printf("%d ",get(i,j));
+	}
+};
+#define MATRIX_ALIGN 64//行首按cache line对齐
+#define FLOYD_TILE 64//分块floyd的块边长(stride的倍数对齐，一块16KB)
+#define FLOYD_PARALLEL 256//矩阵至少这么大才多线程
+struct Matrix//矩阵，n行存放在一块按MATRIX_ALIGN对齐的内存中，行距stride(n补齐到16个int，补齐部分为0)
 {
-	Matrix():n(0),a(NULL){}
+	Matrix():n(0),stride(0),a(NULL){}
 	~Matrix(){clear();}
 	int n;//矩阵长宽
-	int **a;
-	void save()
+	int stride;//相邻两行首地址相差的int数
+	int **a;//行指针，a[i]=a[0]+i*stride(读写整块)
+	void save(Bin_Writer &w)
 	{
-		printf("%d\n",n);
-		for(int i=0;i<n;i++)
-		{
-			for(int j=0;j<n;j++)
-				printf("%d ",a[i][j]);
-			printf("\n");
-		}
+		w.put_int(n);
+		w.put_int(stride);
+		if(n>0)w.put(a[0],(long long)n*stride*sizeof(int));
+	}
+	void load(Bin_Reader &r)
+	{
+		int N=r.get_int(),S=r.get_int();
+		if(!r.ok||N<0||S!=(N+15)/16*16||(long long)N*S>(r.end-r.p)/(long long)sizeof(int)){r.ok=false;clear();return;}
+		alloc(N);
+		if(n>0)r.get(a[0],(long long)n*stride*sizeof(int));
 	}
-	void load()
+	void alloc(int N)//分配N*N，除补齐部分外不初始化
 	{
-		scanf("%d",&n);
+		clear();
+		n=N;
+		stride=(N+15)/16*16;
 		a=new int*[n];
-		for(int i=0;i<n;i++)a[i]=new int[n];
+		if(n==0)return;
+		void *block=NULL;
+		if(posix_memalign(&block,MATRIX_ALIGN,(size_t)n*stride*sizeof(int))!=0)
+		{
+			printf("OUT OF MEMORY(MATRIX %d)\n",n);
+			exit(1);
+		}
 		for(int i=0;i<n;i++)
-			for(int j=0;j<n;j++)
-				scanf("%d",&a[i][j]);
+		{
+			a[i]=(int*)block+(long long)i*stride;
+			memset(a[i]+n,0,(stride-n)*sizeof(int));
+		}
 	}
 	void cover(int x)
 	{
@@ -801,10 +1081,7 @@ struct Matrix//矩阵
 	}
 	void init(int N)
 	{
-		clear();
-		n=N;
-		a=new int*[n];
-		for(int i=0;i<n;i++)a[i]=new int[n];
+		alloc(N);
 		for(int i=0;i<n;i++)
 			for(int j=0;j<n;j++)
 				a[i][j]=INF;
@@ -812,28 +1089,57 @@ struct Matrix//矩阵
 	}
 	void clear()
 	{
-		for(int i=0;i<n;i++)delete [] a[i];
+		if(a!=NULL&&n>0)free(a[0]);
 		delete [] a;
+		n=stride=0;
+		a=NULL;
+	}
+	template<class O>
+	void floyd_tile(int bi,int bj,int bk,O &order)//用中间点块bk松弛块(bi,bj)，k在外层，块内可与bi或bj重合
+	{
+		int i0=bi*FLOYD_TILE,i1=min(n,i0+FLOYD_TILE);
+		int j0=bj*FLOYD_TILE,j1=min(n,j0+FLOYD_TILE);
+		int k0=bk*FLOYD_TILE,k1=min(n,k0+FLOYD_TILE);
+		for(int k=k0;k<k1;k++)
+		{
+			const int *ak=a[k];
+			for(int i=i0;i<i1;i++)
+			{
+				int *ai=a[i],base=ai[k];
+				if(base>=INF)continue;
+				if(order.width==0){minplus_relax(ai+j0,base,ak+j0,j1-j0);continue;}
+				minplus_relax_each(ai+j0,base,ak+j0,j1-j0,[&](int j){order.set(i,j0+j,k);});//向量比较，只对变小的格记方案
+			}
+		}
 	}
 	void floyd()//对矩阵a进行floyd
 	{
-		int i,j,k;
-		for(k=0;k<n;k++)
-			for(i=0;i<n;i++)
-				for(j=0;j<n;j++)
-					if(a[i][j]>a[i][k]+a[k][j])a[i][j]=a[i][k]+a[k][j];
+		Order_Matrix none;
+		floyd(none);
 	}
-	void floyd(Matrix &order)//对矩阵a进行floyd,将方案记录到order中
+	template<class O>
+	void floyd(O &order,int threads=0)//对矩阵a进行floyd,将方案记录到order中(order.width==0不记录),threads=0时按矩阵大小决定线程数
 	{
-		int i,j,k;
-		for(k=0;k<n;k++)
-			for(i=0;i<n;i++)
-				for(j=0;j<n;j++)
-					if(a[i][j]>a[i][k]+a[k][j])
-					{
-						a[i][j]=a[i][k]+a[k][j];
-						order.a[i][j]=k;
-					}
+		//分块floyd：每轮中间点块kb先算对角块，再算kb行列上的块，最后其余块互不依赖，各块由一个线程算
+		//块内仍是k在外层的floyd，结果与逐点floyd的距离相同，order可能取另一个同长的中间点
+		Perf_Scope perf(PT_FLOYD);
+		int tiles=(n+FLOYD_TILE-1)/FLOYD_TILE;
+		if(threads<=0)threads=n>=FLOYD_PARALLEL?Build_Threads:1;
+		for(int kb=0;kb<tiles;kb++)
+		{
+			floyd_tile(kb,kb,kb,order);
+			parallel_for(threads,2*(tiles-1),[&](int worker,int t){
+				int b=t/2<kb?t/2:t/2+1;
+				if(t%2==0)floyd_tile(kb,b,kb,order);
+				else floyd_tile(b,kb,kb,order);
+			});
+			parallel_for(threads,(tiles-1)*(tiles-1),[&](int worker,int t){
+				int bi=t/(tiles-1),bj=t%(tiles-1);
+				if(bi>=kb)bi++;
+				if(bj>=kb)bj++;
+				floyd_tile(bi,bj,kb,order);
+			});
+		}
 	}
 	void write()
 	{
@@ -845,80 +1151,231 @@ struct Matrix//矩阵
 	{
 		if(this!=(&m))
 		{
-			init(m.n);
-			for(int i=0;i<n;i++)
-				for(int j=0;j<n;j++)
-					a[i][j]=m.a[i][j];
+			alloc(m.n);
+			if(n>0)memcpy(a[0],m.a[0],(size_t)n*stride*sizeof(int));
 		}
 		return *this;
 	}
 };
+struct Car_State//车辆集合的一份完整状态
+{
+	vector<vector<int> >car_in_node;//用于挂border法KNN，记录每个节点上车的编号
+	vector<int>car_offset;//用于记录车id距离车所在的node的距离
+	vector<unsigned>car_type;//车的类型位(CAR_ADD的dist)，0为无类型
+	vector<unsigned>type_mask;//按树结点：子树中车的类型位之或，过滤KNN(car_nearest的want)跳过不含所需类型的子树
+	vector<vector<pair<int,int> > >min_car_dist;//按树结点：车辆集合中距离每个border最近的<car_dist,node_id>
+	const vector<pair<int,int> >& get(int x)const{return min_car_dist[x];}
+	vector<pair<int,int> >& set(int x){return min_car_dist[x];}
+	long long epoch;//已写入的更新批数，两份状态相同说明内容相同
+	int offset(int car_id)const{return car_id<(int)car_offset.size()?car_offset[car_id]:0;}
+	unsigned type(int car_id)const{return car_id<(int)car_type.size()?car_type[car_id]:0;}
+};
+inline bool type_match(unsigned type,unsigned want){return (type&want)==want;}//类型位含want的全部位，want=0时都符合
+#define CAR_ADD 0
+#define CAR_DEL 1
+#define CAR_OFFSET 2
+#define CAR_REPAIR_BATCH 8//一批中有车/无车变化的结点不超过此数时逐个沿树上修，否则所有祖先去重后自底向上各重算一次
+#define CAR_REPAIR_PARALLEL 64//同一深度待重算的结点数达到此数才并行
+struct Car_Hit//一辆查询到的车：车的编号，所在结点，距离
+{
+	int car_id,node_id,dist;
+};
+struct Car_Update//一次车辆更新：CAR_ADD/CAR_DEL车car_id于结点node_id(CAR_ADD的dist为车的类型位)，CAR_OFFSET车car_id到所在结点的距离为dist
+{
+	int type,node_id,car_id,dist;
+};
+struct Query_Cache//一个查询线程的缓存：查询时G_Tree只读，可变的catch都在这里，每个线程一个Query_Cache即可共享同一棵树
+{
+	struct Catch_Way//换出的一个起点的catch，字段同Node_Cache
+	{
+		int catch_id,catch_bound,min_border_dist;
+		vector<int>catch_dist;
+	};
+	struct Node_Cache
+	{
+		int catch_id,catch_bound;//当前catch所保存的起点编号，当前catch所保存的已更新的catch的bound(<bound的begin已更新end)
+		vector<int>catch_dist;//当前catch_dist保存的是从图G中结点catch_id到每个border的距离，其中只有值小于等于catch_bound的部分值是正确的
+		int min_border_dist;//当前结点随catch缓存的边界点最小的距离(用于KNN剪枝)
+		vector<int>path_record;//路径查询辅助数组，无意义
+		vector<Catch_Way>ways;//其余起点的catch，最近用的在前(至多Catch_Ways-1路，用到时才分配)
+		void swap_way(Catch_Way &w)
+		{
+			swap(catch_id,w.catch_id);
+			swap(catch_bound,w.catch_bound);
+			swap(min_border_dist,w.min_border_dist);
+			catch_dist.swap(w.catch_dist);
+		}
+	};
+	vector<Node_Cache>node;//按树结点编号，由G_Tree::cache_fit分配
+	vector<int>minplus_acc;//min-plus松弛的整行缓存(见minplus_relax_rows)
+	vector<float>euclid;//起点到当前结点各border的直线距离下界(见euclid_bounds)
+	vector<pair<int,int> >query;//KNN/Range的目标查询顺序(见select_targets)
+	vector<int>K_Value,ans;//KNN的K小值堆，每个目标的距离
+	vector<vector<pair<int,int> > >car_dist;//KNN_min_dist_car对min_car_dist的私有修改(写时复制，见Car_View)
+	vector<char>car_dist_copied;
+	vector<int>car_dist_touched;
+	map<int,int>car_taken;//KNN_min_dist_car已取走的每个结点上的车数
+	RadixHeap<pair<int,int> >car_queue;//车辆KNN的<dist,<node_id,border_id>>队列(单调：新加入的不小于已取出的)
+	struct Hop{int x,S,T;};//树结点x中编号S到T的border对
+	struct Hop_Hash{size_t operator()(const Hop &h)const{return ((size_t)h.x*0x9E3779B1u)^((size_t)h.S<<20)^(size_t)h.T;}};
+	struct Hop_Eq{bool operator()(const Hop &a,const Hop &b)const{return a.x==b.x&&a.S==b.S&&a.T==b.T;}};
+	typedef list<pair<Hop,vector<int> > > Hop_List;
+	Hop_List hop_lru;//展开过的border对路径，最近用的在前(容量Path_Cache_Pairs)
+	unordered_map<Hop,Hop_List::iterator,Hop_Hash,Hop_Eq>hop_index;
+	vector<Hop>path_hops;//find_path待展开的border对
+	vector<int>path_buf,path_off;//各border对展开后的结点，第i对为path_buf[path_off[i],path_off[i+1])
+	vector<Hop>unpack_stack;//find_path_border的显式栈
+};
+struct Car_View//查询中的车辆集合：读共享的Car_State，取走车辆的修改写到查询缓存，其他线程看不到
+{
+	const Car_State &s;
+	Query_Cache &c;
+	Car_View(const Car_State &s_,Query_Cache &c_):s(s_),c(c_){}
+	~Car_View()
+	{
+		for(int i=0;i<(int)c.car_dist_touched.size();i++)c.car_dist_copied[c.car_dist_touched[i]]=0;
+		c.car_dist_touched.clear();
+		c.car_taken.clear();
+	}
+	const vector<pair<int,int> >& get(int x)const{return c.car_dist_copied[x]?c.car_dist[x]:s.min_car_dist[x];}
+	vector<pair<int,int> >& set(int x)
+	{
+		if(!c.car_dist_copied[x])
+		{
+			c.car_dist_copied[x]=1;
+			c.car_dist[x]=s.min_car_dist[x];
+			c.car_dist_touched.push_back(x);
+		}
+		return c.car_dist[x];
+	}
+};
+struct Knn_Session//连续KNN：同一个移动的查询点反复查K近车辆(见knn_session_move)
+{
+	int K,B;//K近，多留的候选车数
+	int anchor;//上次完整计算时的查询点，-1为尚未计算
+	int bound;//anchor处候选外的车到anchor(所在结点)的距离都不小于bound
+	int gap;//anchor处第K+1近(或bound)与第K近的距离差
+	long long epoch;//候选对应的车辆集合版本(Car_State::epoch)
+	vector<int>node,offset;//候选车所在结点与offset
+	vector<int>car;
+	vector<Car_Hit>result;//最近一次的K近车辆，按距离从小到大
+	Query_Cache c;
+	long long full,fast;//完整计算与仅复核候选的次数
+};
+//KNN_min_dist_car的结果缓存：按键的哈希分RESULT_CACHE_SHARDS段，每段一把锁一个LRU(容量Result_Cache_Size/段数)
+//结果只取决于scope子树中的车(见result_scope)：car_apply把一批更新涉及的叶子到根路径上的结点版本记为该批的epoch，
+//scope的版本不超过条目算出时所读车辆集合的epoch则条目仍有效
+#define RESULT_CACHE_SHARDS 16
+struct Result_Key//S出发类型含want的前K近车
+{
+	int S,K;
+	unsigned want;
+};
+struct Result_Key_Hash{size_t operator()(const Result_Key &k)const{return ((size_t)k.S*0x9E3779B1u)^((size_t)k.K<<20)^((size_t)k.want*0x85EBCA6Bu);}};
+struct Result_Key_Eq{bool operator()(const Result_Key &a,const Result_Key &b)const{return a.S==b.S&&a.K==b.K&&a.want==b.want;}};
+struct Result_Entry
+{
+	Result_Key key;
+	int scope;//结果只取决于此树结点子树中的车
+	long long epoch;//算出时所读车辆集合的版本(Car_State::epoch)
+	vector<int>ans;//车的编号
+};
+typedef list<Result_Entry> Result_List;
+struct Result_Shard
+{
+	mutex lock;
+	Result_List lru;//最近用的在前
+	unordered_map<Result_Key,Result_List::iterator,Result_Key_Hash,Result_Key_Eq>index;
+};
+struct Range_Watch//常驻范围查询(见G_Tree::watch_add)：S出发距离小于R的车，R<0为已撤销
+{
+	int S,R;
+	set<int>inside;//当前在范围内的车
+};
+struct Watch_Event//常驻范围查询的一次进出：车car_id进入(enter=1)或离开(enter=0)查询watch_id的范围
+{
+	int watch_id,car_id,enter;
+};
 struct G_Tree
 {
 	int root;
 	vector<int>id_in_node;//真实结点所在的叶子结点编号
-	vector<vector<int> >car_in_node;//用于挂border法KNN，记录每个节点上车的编号
-	vector<int>car_offset;//用于记录车id距离车所在的node的距离
+	vector<int>euler_first,node_deep;//树结点在欧拉序中首次出现的位置，树结点的深度(node[].deep的紧凑副本)
+	vector<vector<int> >euler_rmq;//欧拉序的稀疏表：euler_rmq[k][i]=欧拉序第i~i+2^k-1位中最浅的树结点
+	vector<int>lm_from,lm_to;//[x*k+i]：结点x子树内各点min d(地标i,v)与max d(v,地标i)(见landmark_fit)
+	Car_State cars[2];//车辆集合的前后台两份状态(左右双缓冲，见car_apply)，查询读cars[car_front]
+	atomic<int> car_front;//前台状态的下标
+	atomic<int> car_readers[2];//正在读每份状态的查询数
+	mutex car_write_lock;//car_apply串行
+	mutex car_post_lock;//保护car_pending
+	vector<Car_Update> car_pending;//已提交未生效的车辆更新
+	vector<Range_Watch> watches;//常驻范围查询，编号即下标(见watch_add)
+	vector<vector<int> > watch_in_leaf;//按树结点：范围触及该叶子的常驻查询编号
+	vector<int> watch_car_node;//车所在的图结点(-1为不在)，CAR_OFFSET时据此找受影响的查询
+	vector<Watch_Event> watch_pending;//未取走的进出事件(见watch_poll)
+	Query_Cache watch_cache;//car_watch复核距离用
+	atomic<long long> *car_stamp;//按树结点：子树中的车最后一次变化的批(epoch)，Result_Cache_Size>0时由result_cache_fit分配
+	Result_Shard result_shard[RESULT_CACHE_SHARDS];
 	struct Node
 	{
-		Node(){clear();}
+		Node():son(NULL){clear();}
 		int part;//结点的儿子个数
 		int n,father,*son,deep;//n:子图结点数,father父节点编号,son[2]左右儿子编号,deep结点所在树深度
+		int son_inline[Partition_Part];//part<=Partition_Part时son指向这里，儿子编号与结点放在一起不另分配
 		Graph G;//子图
 		vector<int>color;//结点分别在那个儿子中
-		Matrix dist,order;//border距离,以及border做floyd的中间点k方案,order=(-1:直接相连)|(-2:在父节点中相连)|(-3:在子结点中相连)|(-INF:无方案)
+		Matrix dist;//border距离
+		Order_Matrix order;//以及border做floyd的中间点k方案,order=(-1:直接相连)|(-2:在父节点中相连)|(-3:在子结点中相连)|(-INF:无方案)
 		map<int,pair<int,int> >borders;//first:真实border编号;second:<border序列的编号,对应子图中的编号(0~n-1)>
 		vector<int>border_in_father,border_in_son,border_id,border_id_innode;//borders在父亲与儿子borders列表中的编号,border在原图中的编号,border在结点中的编号
-		vector<int>path_record;//路径查询辅助数组，无意义
-		int catch_id,catch_bound;//当前catch所保存的起点编号，当前catch所保存的已更新的catch的bound(<bound的begin已更新end)
-		vector<int>catch_dist;//当前catch_dist保存的是从图G中结点catch_id到每个border的距离，其中只有值小于等于catch_bound的部分值是正确的
-		vector<int>border_son_id;//当前border所在的儿子结点的编号
-		int min_border_dist;//当前结点随catch缓存的边界点最小的距离(用于KNN剪枝)
-		vector<pair<int,int> >min_car_dist;//车辆集合中距离每个border最近的<car_dist,node_id>
-		void save()
-		{
-			printf("%d %d %d %d %d %d %d\n",n,father,part,deep,catch_id,catch_bound,min_border_dist);
-			for(int i=0;i<part;i++)printf("%d ",son[i]);cout<<endl;
-			save_vector(color);
-			dist.save();
-			order.save();
-			save_map_int_pair(borders);
-			save_vector(border_in_father);
-			save_vector(border_in_son);
-			save_vector(border_id);
-			save_vector(border_id_innode);
-			save_vector(path_record);
-			save_vector(catch_dist);
-			save_vector_pair(min_car_dist);
-		}
-		void load()
-		{
-			scanf("%d%d%d%d%d%d%d",&n,&father,&part,&deep,&catch_id,&catch_bound,&min_border_dist);
-			if(son!=NULL)delete[] son;
-			son=new int[part];
-			for(int i=0;i<part;i++)scanf("%d",&son[i]);
-			load_vector(color);
-			dist.load();
-			order.load();
-			load_map_int_pair(borders);
-			load_vector(border_in_father);
-			load_vector(border_in_son);
-			load_vector(border_id);
-			load_vector(border_id_innode);
-			load_vector(path_record);
-			load_vector(catch_dist);
-			load_vector_pair(min_car_dist);
+		vector<pair<pair<int,int>,int> >border_edge;//建树用:不同儿子的border之间直接相连的边<<border序列编号,border序列编号>,边权>,划分时由G算出,G随即释放
+		void save(Bin_Writer &w)
+		{
+			int head[4]={n,father,part,deep};
+			w.put(head,sizeof(head));
+			w.put(son,(long long)part*sizeof(int));
+			save_vector(w,color);
+			dist.save(w);
+			order.save(w);
+			save_map_int_pair(w,borders);
+			save_vector(w,border_in_father);
+			save_vector(w,border_in_son);
+			save_vector(w,border_id);
+			save_vector(w,border_id_innode);
+		}
+		void load(Bin_Reader &r)
+		{
+			int head[4];
+			r.get(head,sizeof(head));
+			if(!r.ok||head[2]<0||head[2]>(r.end-r.p)/(long long)sizeof(int)){r.ok=false;return;}
+			n=head[0];father=head[1];part=head[2];deep=head[3];
+			son_alloc(part);
+			r.get(son,(long long)part*sizeof(int));
+			load_vector(r,color);
+			dist.load(r);
+			order.load(r);
+			load_map_int_pair(r,borders);
+			load_vector(r,border_in_father);
+			load_vector(r,border_in_son);
+			load_vector(r,border_id);
+			load_vector(r,border_id_innode);
+		}
+		void son_alloc(int n)//son指向n个儿子编号的空间(不超过Partition_Part时为son_inline)
+		{
+			if(son!=son_inline)delete[] son;
+			son=n<=Partition_Part?son_inline:new int[n];
 		}
 		void init(int n)
 		{
 			part=n;
-			son=new int[n];
+			son_alloc(n);
 			for(int i=0;i<n;i++)son[i]=0;
 		}
 		void clear()
 		{
 			part=n=father=deep=0;
-			delete [] son;
+			if(son!=son_inline)delete [] son;
+			son=NULL;
 			dist.clear();
 			order.clear();
 			G.clear();
@@ -928,29 +1385,43 @@ struct G_Tree
 			border_in_son.clear();
 			border_id.clear();
 			border_id_innode.clear();
-			catch_dist.clear();
-			catch_id=-1;
+			border_edge.clear();
 		}
-		void make_border_edge()//将border之间直接相连的边更新至dist(build_dist1)
+		void find_border_edge(const Graph &G)//由子图G记录border之间直接相连的边(划分后G即释放)
 		{
 			int i,j;
 			map<int,pair<int,int> >::iterator iter;
 			for(iter=borders.begin();iter!=borders.end();iter++)
 			{
 				i=iter->second.second;
-				for(j=G.head[i];j;j=G.next[j])
+				for(j=G.head[i];j<G.head[i+1];j++)
 					if(color[i]!=color[G.list[j]])
-					{
-						int id1,id2;
-						id1=iter->second.first;
-						id2=borders[G.id[G.list[j]]].first;
-						if(dist.a[id1][id2]>G.cost[j])
-						{
-							dist.a[id1][id2]=G.cost[j];
-							order.a[id1][id2]=-1;
-						}
-					}
+						border_edge.push_back(make_pair(make_pair(iter->second.first,borders[G.id[G.list[j]]].first),G.cost[j]));
+			}
+		}
+		void make_border_edge()//将border之间直接相连的边更新至dist(build_dist1)
+		{
+			for(int i=0;i<border_edge.size();i++)
+			{
+				int id1=border_edge[i].first.first,id2=border_edge[i].first.second;
+				if(dist.a[id1][id2]>border_edge[i].second)
+				{
+					dist.a[id1][id2]=border_edge[i].second;
+					order.set(id1,id2,-1);
+				}
 			}
+			vector<pair<pair<int,int>,int> >().swap(border_edge);
+		}
+		void take(Node &o)//建树划分阶段重新标号时搬移结点(此时dist等尚未建立)
+		{
+			bool a=son==son_inline,b=o.son==o.son_inline;
+			swap(part,o.part);swap(n,o.n);swap(father,o.father);swap(son,o.son);swap(deep,o.deep);
+			for(int i=0;i<Partition_Part;i++)swap(son_inline[i],o.son_inline[i]);
+			if(b)son=son_inline;//换到本结点的son_inline
+			if(a)o.son=o.son_inline;
+			color.swap(o.color);
+			borders.swap(o.borders);
+			border_edge.swap(o.border_edge);
 		}
 		void write()
 		{
@@ -967,37 +1438,59 @@ struct G_Tree
 			printf("border_id");for(int i=0;i<borders.size();i++)printf("(%d,%d)",i,border_id[i]);printf("\n");
 			printf("border_in_father");for(int i=0;i<borders.size();i++)printf("(%d,%d)",i,border_in_father[i]);printf("\n");
 			printf("border_in_son");for(int i=0;i<borders.size();i++)printf("(%d,%d)",i,border_in_son[i]);printf("\n");
-			printf("catch_dist ");for(int i=0;i<catch_dist.size();i++)printf("(%d,%d)",i,catch_dist[i]);printf("\n");
-			printf("min_car_dist ");for(int i=0;i<min_car_dist.size();i++)printf("(i:%d,D:%d,id:%d)",i,min_car_dist[i].first,min_car_dist[i].second);printf("\n");
 		}
 	};
 	int node_tot,node_size;
 	Node *node;
-	void save()
+	void save(Bin_Writer &w)//树的全局信息(G已另存为一节)
 	{
-		G.save();
-		printf("%d %d %d\n",root,node_tot,node_size);
-		save_vector(id_in_node);
-		save_vector_vector(car_in_node);
-		save_vector(car_offset);
-		for(int i=0;i<node_size;i++)
-		{
-			printf("\n");
-			node[i].save();
-		}
+		w.put_int(root);w.put_int(node_tot);w.put_int(node_size);
+		save_vector(w,id_in_node);
+		const Car_State &st=cars[car_front.load()];
+		save_vector_vector(w,st.car_in_node);
+		save_vector(w,st.car_offset);
+		save_vector(w,st.car_type);
+		w.put_count(st.min_car_dist.size());
+		for(int i=0;i<(int)st.min_car_dist.size();i++)save_vector_pair(w,st.min_car_dist[i]);
+		save_vector(w,euler_first);
+		save_vector(w,node_deep);
+		save_vector_vector(w,euler_rmq);
+	}
+	void save_nodes(Bin_Writer &w)
+	{
+		for(int i=0;i<node_size;i++)node[i].save(w);
+	}
+	void load(Bin_Reader &r)//G需已读入(结点数组按G.n分配)
+	{
+		root=r.get_int();node_tot=r.get_int();node_size=r.get_int();
+		load_vector(r,id_in_node);
+		load_vector_vector(r,cars[0].car_in_node);
+		load_vector(r,cars[0].car_offset);
+		load_vector(r,cars[0].car_type);
+		cars[0].min_car_dist.resize(r.get_count(sizeof(long long)));
+		for(int i=0;i<(int)cars[0].min_car_dist.size();i++)load_vector_pair(r,cars[0].min_car_dist[i]);
+		load_vector(r,euler_first);
+		load_vector(r,node_deep);
+		cars[0].epoch=0;
+		cars[1]=cars[0];
+		car_front=0;car_readers[0]=car_readers[1]=0;
+		result_cache_fit();
+		load_vector_vector(r,euler_rmq);
+		if(node_size<0||node_size>G.n*2+2)r.ok=false;
+		if(euler_first.size()!=node_tot+1||node_deep.size()!=node_tot+1||euler_rmq.size()==0)r.ok=false;
 	}
-	void load()
+	void load_nodes(Bin_Reader &r)
 	{
-		printf("load_begin\n");
-		G.load();
-		scanf("%d%d%d",&root,&node_tot,&node_size);
-		load_vector(id_in_node);
-		load_vector_vector(car_in_node);
-		load_vector(car_offset);
 		node=new Node[G.n*2+2];
-		for(int i=0;i<node_size;i++)
+		for(int i=0;i<node_size&&r.ok;i++)
+		{
+			node[i].load(r);
+			if(node[i].order.n>0&&node[i].order.width==0)Keep_Order=false;//仅距离的索引
+		}
+		if(r.ok&&node_deep.size()==node_tot+1&&cars[0].car_in_node.size()==id_in_node.size())//type_mask按father汇总，需结点已读入
 		{
-			node[i].load();
+			car_type_build(cars[0]);
+			cars[1].type_mask=cars[0].type_mask;
 		}
 	}
 	void write()
@@ -1020,187 +1513,231 @@ struct G_Tree
 			node[x].borders[id]=second;
 		}
 	}
-	void make_border(int x,const vector<int> &color)//计算点x的border集合，二部图之间的边集为E
+	void make_border(int x,const Graph &g,const vector<int> &color)//计算点x(子图g)的border集合，二部图之间的边集为E
 	{
-		for(int i=0;i<node[x].G.n;i++)
+		for(int i=0;i<g.n;i++)
 		{
-			int id=node[x].G.id[i];
-			for(int j=node[x].G.head[i];j;j=node[x].G.next[j])
-				if(color[i]!=color[node[x].G.list[j]])
+			int id=g.id[i];
+			for(int j=g.head[i];j<g.head[i+1];j++)
+				if(color[i]!=color[g.list[j]])
 				{
 					add_border(x,id,i);
 					break;
 				}
 		}
 	}
-	int partition_root(int x=1)//返回该结点在不超过Additional_Memory限制下最多可以划分为多少块
+	int partition_root(const Graph &g)//返回子图g在不超过Additional_Memory限制下最多可以划分为多少块
 	{
-		if((long long)node[x].G.n*node[x].G.n<=Additional_Memory)return node[x].G.n;
-		int l=2,r=max(2,(int)sqrt(Additional_Memory)),mid;//二分块数
+		if((long long)g.n*g.n<=Additional_Memory)return g.n;
+		//多路二分块数：每轮并行试探T个块数，T=1时即二分
+		int l=2,r=max(2,(int)sqrt(Additional_Memory)),T=Build_Threads;
+		vector<int>mid(T),num(T);
 		while(l<r)
 		{
-			mid=(l+r+1)>>1;
-			int num=node[x].G.Split_Borders(mid);
-			if(num*num>Additional_Memory)r=mid-1;
-			else l=mid;
+			for(int i=0;i<T;i++)mid[i]=l+((long long)(r-l)*(i+1)+T)/(T+1);
+			parallel_for(min(T,r-l),T,[&](int worker,int i){
+				num[i]=g.Split_Borders(mid[i]);
+			});
+			int nl=l;
+			for(int i=0;i<T;i++)
+				if((long long)num[i]*num[i]>Additional_Memory){r=mid[i]-1;break;}
+				else nl=mid[i];
+			l=nl;
 		}
 		return l;
 	}
-	void build(int x=1,int f=1,const Graph &g=G)//递归建树，当前结点x,叶子规模f,当前结点的子图g
+	void build_split(int x,int f,const Graph &g,atomic<int> &top,vector<int> &real_border)//划分结点x(子图g)：儿子标号取自top，儿子子图存入其G
 	{
-		if(x==1)//x为根
-		{
-			node=new Node[G.n*2+2];
-			node_size=G.n*2;
-			node_tot=2;
-			root=1;
-			node[x].deep=1;
-			node[1].G=g;
-		}
-		else//x非根
-		{
-			node[x].deep=node[node[x].father].deep+1;
-		}
-		node[x].n=node[x].G.n;
+		node[x].n=g.n;
 		//决策根节点的儿子数
 		if(x==root&&Optimization_G_tree_Search)
 		{
-			node[x].init(partition_root(x));
+			node[x].init(partition_root(g));
 			printf("root's part:%d\n",node[x].part);
 			rootp = node[x].part;
 		}
-		else if(node[x].G.n<Naive_Split_Limit)node[x].init(node[x].n);
+		else if(g.n<Naive_Split_Limit)node[x].init(node[x].n);
 		else node[x].init(Partition_Part);
-		if(node[x].n>50)printf("x=%d deep=%d n=%d ",x,node[x].deep,node[x].G.n);
+		if(node[x].n>50)real_border[x]=real_border_number(g);
+		if(g.n==1)id_in_node[g.id[0]]=x;
 		if(node[x].n>f)
 		{
 			//子结点标号
-			int top=node_tot;
+			int s=top.fetch_add(node[x].part);
 			for(int i=0;i<node[x].part;i++)
 			{
-				node[x].son[i]=top+i;
-				node[top+i].father=x;
+				node[x].son[i]=s+i;
+				node[s+i].father=x;
+				node[s+i].deep=node[x].deep+1;
 			}
-			node_tot+=node[x].part;
 			//添加介于两块之间的border
 			Graph **graph;
 			graph=new Graph*[node[x].part];
 			for(int i=0;i<node[x].part;i++)graph[i]=&node[node[x].son[i]].G;
-			node[x].color=node[x].G.Split(graph,node[x].part);
+			Perf_Scope perf(PT_SPLIT);
+			node[x].color=g.Split(graph,node[x].part);
 			delete [] graph;
-			make_border(x,node[x].color);
-			if(node[x].n>50)printf("border=%d\n",node[x].borders.size());
+			perf.next(PT_MAKE_BORDER);
+			make_border(x,g,node[x].color);
+			perf.stop();
 			//传递border至子结点
 			map<int,pair<int,int> >::iterator iter;
 			for(iter=node[x].borders.begin();iter!=node[x].borders.end();iter++)
-			{
-				//printf("(%d,%d,%d)",iter->first,iter->second.first,iter->second.second);
 				node[x].color[iter->second.second]=-node[x].color[iter->second.second]-1;
-			}
-			//cout<<endl;
 			vector<int>tot(node[x].part,0);
 			for(int i=0;i<node[x].n;i++)
 			{
 				if(node[x].color[i]<0)
 				{
 					node[x].color[i]=-node[x].color[i]-1;
-					add_border(node[x].son[node[x].color[i]],node[x].G.id[i],tot[node[x].color[i]]);
+					add_border(node[x].son[node[x].color[i]],g.id[i],tot[node[x].color[i]]);
 				}
 				tot[node[x].color[i]]++;
 			}
-			//递归子结点
-			for(int i=0;i<node[x].part;i++)
-				build(node[x].son[i]);
+			node[x].find_border_edge(g);
 		}
-		else if(node[x].n>50)cout<<endl;
-		node[x].dist.init(node[x].borders.size());
-		node[x].order.init(node[x].borders.size());
-		node[x].order.cover(-INF);
-		if(x==1)//x为根建立dist
+	}
+	void build_renumber(int x,vector<int> &id,int &tot)//按先序递归建树的顺序给x的儿子标号
+	{
+		if(!node[x].son[0])return;
+		for(int i=0;i<node[x].part;i++)id[node[x].son[i]]=tot++;
+		for(int i=0;i<node[x].part;i++)build_renumber(node[x].son[i],id,tot);
+	}
+	void build(int f=1,const Graph &g=G)//建树,根的叶子规模f,原图g
+	{
+		node=new Node[G.n*2+2];
+		node_size=G.n*2;
+		root=1;
+		node[root].deep=1;
+		id_in_node.assign(G.n,-1);
+		//逐层划分：同层结点只写自己与自己的儿子，互不相关，并行；每层划分完即释放该层子图，只保留相邻两层
+		atomic<int> top(2);
+		vector<int>real_border(node_size+2,0),now(1,root),next;
+		build_split(root,f,g,top,real_border);
+		while(now.size())
 		{
-			for(int i=1;i<min(1000,node_tot-1);i++)
-				if(node[i].n>50)
-				{
-					printf("x=%d deep=%d n=%d ",i,node[i].deep,node[i].G.n);
-					printf("border=%d real_border=%d\n",node[i].borders.size(),real_border_number(i));
-				}
-			printf("begin_build_border_in_father_son\n");
-			build_border_in_father_son();
-			printf("begin_build_dist\n");
-			build_dist1(root);
-			printf("begin_build_dist2\n");
-			build_dist2(root);
-			//计算查询每个结点所在的叶子编号
-			id_in_node.clear();
-			for(int i=0;i<node[root].G.n;i++)id_in_node.push_back(-1);
-			for(int i=1;i<node_tot;i++)
-				if(node[i].G.n==1)
-					id_in_node[node[i].G.id[0]]=i;
-			//建立catch
-			for(int i=1;i<=node_tot;i++)
-			{
-				node[i].catch_id=-1;
-				for(int j=0;j<node[i].borders.size();j++)
-				{
-					node[i].catch_dist.push_back(0);
-					node[i].min_car_dist.push_back(make_pair(INF,-1));
-				}
-			}
+			next.clear();
+			for(int i=0;i<now.size();i++)
 			{
-				//建立car_in_node;
-				vector<int>empty_vector;
-				empty_vector.clear();
-				car_in_node.clear();
-				for(int i=0;i<G.n;i++)car_in_node.push_back(empty_vector);
+				node[now[i]].G.release();
+				if(node[now[i]].son[0])
+					for(int j=0;j<node[now[i]].part;j++)next.push_back(node[now[i]].son[j]);
 			}
+			parallel_for(Build_Threads,next.size(),[&](int worker,int i){
+				build_split(next[i],1,node[next[i]].G,top,real_border);
+			});
+			now.swap(next);
 		}
-		
+		node_tot=top;
+		//儿子标号取决于线程调度，改为与递归建树相同的先序标号，索引不随线程数变化
+		vector<int>id(node_tot,0);
+		int tot=2;
+		id[root]=root;
+		build_renumber(root,id,tot);
+		Node *p=new Node[node_size+2];
+		vector<int>border_real(node_tot,0);
+		for(int i=1;i<node_tot;i++)
+		{
+			border_real[id[i]]=real_border[i];
+			p[id[i]].take(node[i]);
+			p[id[i]].father=id[p[id[i]].father];
+			if(p[id[i]].son[0])
+				for(int j=0;j<p[id[i]].part;j++)p[id[i]].son[j]=id[p[id[i]].son[j]];
+		}
+		delete [] node;
+		node=p;
+		for(int i=0;i<id_in_node.size();i++)
+			if(id_in_node[i]!=-1)id_in_node[i]=id[id_in_node[i]];
+		for(int i=1;i<min(1000,node_tot-1);i++)
+			if(node[i].n>50)
+				printf("x=%d deep=%d n=%d border=%d real_border=%d\n",i,node[i].deep,node[i].n,node[i].borders.size(),border_real[i]);
+		parallel_for(Build_Threads,node_tot-1,[&](int worker,int i){
+			node[i+1].dist.init(node[i+1].borders.size());
+			node[i+1].order.init(node[i+1].borders.size());
+		});
+		printf("begin_build_border_in_father_son\n");
+		build_border_in_father_son();
+		printf("begin_build_dist\n");
+		build_dist1();
+		printf("begin_build_dist2\n");
+		build_dist2();
+		build_lca();
+		//建立车辆集合(空)：min_car_dist与car_in_node(catch在Query_Cache中)
+		cars[0].min_car_dist.assign(node_tot+1,vector<pair<int,int> >());
+		for(int i=1;i<=node_tot;i++)cars[0].min_car_dist[i].assign(node[i].borders.size(),make_pair(INF,-1));
+		cars[0].car_in_node.assign(G.n,vector<int>());
+		cars[0].car_offset.clear();
+		cars[0].car_type.clear();
+		cars[0].type_mask.assign(node_tot+1,0);
+		cars[0].epoch=0;
+		cars[1]=cars[0];
+		car_front=0;car_readers[0]=car_readers[1]=0;
+		result_cache_fit();
 	}
-	void build_dist1(int x=1)//自下而上归并子图内部dist
+	template<class F>
+	void build_levels(bool up,F fn)//按深度逐层处理(up:自下而上)，同层结点互不相关：大矩阵逐个用多线程floyd，其余并行各用单线程
 	{
-		//计算子结点内部dist并传递给x
-		for(int i=0;i<node[x].part;i++)if(node[x].son[i])build_dist1(node[x].son[i]);
-		if(node[x].son[0])//非叶子
+		vector<vector<int> >level;
+		for(int x=1;x<node_tot;x++)
 		{
+			if(level.size()<=node[x].deep)level.resize(node[x].deep+1);
+			level[node[x].deep].push_back(x);
+		}
+		for(int k=0;k<level.size();k++)
+		{
+			vector<int> &v=level[up?level.size()-1-k:k];
+			vector<int>small;
+			for(int i=0;i<v.size();i++)
+				if(node[v[i]].borders.size()>=FLOYD_PARALLEL)fn(v[i],Build_Threads);
+				else small.push_back(v[i]);
+			parallel_for(Build_Threads,small.size(),[&](int worker,int i){
+				fn(small[i],1);
+			});
+		}
+	}
+	void build_dist1()//自下而上归并子图内部dist
+	{
+		Perf_Scope perf(PT_BUILD_DIST1);
+		build_levels(true,[&](int x,int threads){
+			if(!node[x].son[0])return;//叶子
+			//子结点内部dist已算好，依次传递给x
+			for(int k=0;k<node[x].part;k++)
+			{
+				int y=node[x].son[k],i,j;
+				map<int,pair<int,int> >::iterator y_iter1,x_iter1;
+				vector<int>id_in_fa(node[y].borders.size());
+				//计算子图border在父节点border序列中的编号,不存在为-1
+				for(y_iter1=node[y].borders.begin();y_iter1!=node[y].borders.end();y_iter1++)
+				{
+					x_iter1=node[x].borders.find(y_iter1->first);
+					if(x_iter1==node[x].borders.end())id_in_fa[y_iter1->second.first]=-1;
+					else id_in_fa[y_iter1->second.first]=x_iter1->second.first;
+				}
+				//将子图内部的全连接边权传递给父亲
+				for(i=0;i<(int)node[y].borders.size();i++)
+					for(j=0;j<(int)node[y].borders.size();j++)
+						if(id_in_fa[i]!=-1&&id_in_fa[j]!=-1)
+						{
+							int *p=&node[x].dist.a[id_in_fa[i]][id_in_fa[j]];
+							if((*p)>node[y].dist.a[i][j])
+							{
+								(*p)=node[y].dist.a[i][j];
+								node[x].order.set(id_in_fa[i],id_in_fa[j],-3);
+							}
+						}
+			}
 			//建立x子结点之间的边
 			node[x].make_border_edge();
 			//计算内部真实dist矩阵
-			node[x].dist.floyd(node[x].order);
-		}
-		else ;//叶子
-		//向父节点传递内部边权
-		if(node[x].father)
-		{
-			int y=node[x].father,i,j;
-			map<int,pair<int,int> >::iterator x_iter1,y_iter1;
-			vector<int>id_in_fa(node[x].borders.size());
-			//计算子图border在父节点border序列中的编号,不存在为-1
-			for(x_iter1=node[x].borders.begin();x_iter1!=node[x].borders.end();x_iter1++)
-			{
-				y_iter1=node[y].borders.find(x_iter1->first);
-				if(y_iter1==node[y].borders.end())id_in_fa[x_iter1->second.first]=-1;
-				else id_in_fa[x_iter1->second.first]=y_iter1->second.first;
-			}
-			//将子图内部的全连接边权传递给父亲
-			for(i=0;i<(int)node[x].borders.size();i++)
-				for(j=0;j<(int)node[x].borders.size();j++)
-					if(id_in_fa[i]!=-1&&id_in_fa[j]!=-1)
-					{
-						int *p=&node[y].dist.a[id_in_fa[i]][id_in_fa[j]];
-						if((*p)>node[x].dist.a[i][j])
-						{
-							(*p)=node[x].dist.a[i][j];
-							node[y].order.a[id_in_fa[i]][id_in_fa[j]]=-3;
-						}
-					}
-		}
-		return;
+			node[x].dist.floyd(node[x].order,threads);
+		});
 	}
-	void build_dist2(int x=1)//自上而下修正子图外部dist
+	void build_dist2()//自上而下修正子图外部dist
 	{
-		if(x!=root)node[x].dist.floyd(node[x].order);
-		if(node[x].son[0])
-		{
+		Perf_Scope perf(PT_BUILD_DIST2);
+		build_levels(false,[&](int x,int threads){
+			if(x!=root)node[x].dist.floyd(node[x].order,threads);
+			if(!node[x].son[0])return;
 			//计算此节点border编号在子图中border序列的编号
 			vector<int>id_(node[x].borders.size());
 			vector<int>color_(node[x].borders.size());
@@ -1222,13 +1759,10 @@ struct G_Tree
 						if((*p)>node[x].dist.a[i][j])
 						{
 							(*p)=node[x].dist.a[i][j];
-							node[y].order.a[id_[i]][id_[j]]=-2;
+							node[y].order.set(id_[i],id_[j],-2);
 						}
 					}
-			//递归子节点
-			for(int i=0;i<node[x].part;i++)
-				if(node[x].son[i])build_dist2(node[x].son[i]);
-		}
+		});
 	}
 	void build_border_in_father_son()//计算每个结点border在父亲/儿子borders数组中的编号
 	{
@@ -1272,8 +1806,6 @@ struct G_Tree
 					if(iter2!=node[y].borders.end())
 						node[x].border_in_son[iter->second.first]=iter2->second.first;
 				}
-				for (int i = 0; i<node[x].borders.size(); i++)
-					node[x].border_son_id.push_back(node[x].son[node[x].color[node[x].border_id_innode[i]]]);
 			}
 		}
 	}
@@ -1284,7 +1816,6 @@ struct G_Tree
 			dist2=dist1;
 			return;
 		}
-		times[5]-=clock();
 		dist2.clear();
 		int y=node[x].father;
 		while(dist2.size()<node[y].borders.size())dist2.push_back(INF);
@@ -1294,15 +1825,11 @@ struct G_Tree
 		//printf("dist2:");save_vector(dist2);
 		int **dist=node[y].dist.a;
 		vector<int>begin,end;//已算出的序列编号,未算出的序列编号
-		times[5]+=clock();
-		times[6]-=clock();
 		for(int i=0;i<dist2.size();i++)
 		{
 			if(dist2[i]<INF)begin.push_back(i);
 			else if(node[y].border_in_father[i]!=-1)end.push_back(i);
 		}
-		times[6]+=clock();
-		times[7]-=clock();
 		for(int i=0;i<(int)begin.size();i++)
 		{
 			int i_=begin[i];
@@ -1312,12 +1839,12 @@ struct G_Tree
 				dist2[end[j]]=dist2[i_]+dist[i_][end[j]];
 			}
 		}
-		times[7]+=clock();
 	}*/
 	void push_borders_up(int x, vector<int> &dist1, int type)//将S到结点x边界点的最短路长度记录在dist1中，计算S到x.father真实border的距离更新dist1 type==0上推,type==1下推
 	{
 		if (node[x].father == 0)return;
-		times[5] -= clock();
+		Perf_Scope perf(PT_PUSH_UP);
+		perf_count(PC_BORDER_PUSHES);
 		int y = node[x].father;
 		vector<int>dist2(node[y].borders.size(), INF);
 		for (int i = 0; i<node[x].borders.size(); i++)
@@ -1330,15 +1857,12 @@ struct G_Tree
 		begin = new int[node[x].borders.size()];
 		end = new int[node[y].borders.size()];
 		int tot0 = 0, tot1 = 0;
-		times[5] += clock();
-		times[6] -= clock();
 		for (int i = 0; i<dist2.size(); i++)
 		{
 			if (dist2[i]<INF)begin[tot0++] = i;
 			else if (node[y].border_in_father[i] != -1)end[tot1++] = i;
 		}
-		times[6] += clock();
-		times[7] -= clock();
+		perf_count(PC_RELAX_CELLS, (long long)tot0*tot1);
 		if (type == 0)
 		{
 			for (int i = 0; i<tot0; i++)
@@ -1379,69 +1903,115 @@ struct G_Tree
 		}
 		}
 		*/
-		times[7] += clock();
 		dist1 = dist2;
 		delete[] begin;
 		delete[] end;
 	}
-	void push_borders_up_catch(int x, int bound = INF)//将S到结点x边界点缓存在x.catch_dist的最短路长度，计算S到x.father真实border的距离更新x.father.catch
+	void minplus_relax_rows(Query_Cache &c, vector<int> &dist2, int **dist, int *begin, int tot0, int *end, int tot1)//用dist2中begin的值经dist松弛end的值；begin每行整行连续做min-plus，再只取end的位置，begin的值不变
 	{
-		if (node[x].father == 0)return;
-		int y = node[x].father;
-		if (node[x].catch_id == node[y].catch_id&&bound <= node[y].catch_bound)return;
-		node[y].catch_id = node[x].catch_id;
-		node[y].catch_bound = bound;
-		vector<int> *dist1 = &node[x].catch_dist, *dist2 = &node[y].catch_dist;
-		for (int i = 0; i<(*dist2).size(); i++)(*dist2)[i] = INF;
-		for (int i = 0; i<node[x].borders.size(); i++)
-			if (node[x].border_in_father[i] != -1)
-			{
-				if (node[x].catch_dist[i]<bound)//bound界内的begin
-					(*dist2)[node[x].border_in_father[i]] = (*dist1)[i];
-				else (*dist2)[node[x].border_in_father[i]] = -1;//bound界外的begin
-			}
-		int **dist = node[y].dist.a;
+		if (tot0 == 0 || tot1 == 0)return;
+		perf_count(PC_RELAX_CELLS, (long long)tot0*tot1);
+		int n = dist2.size();
+		c.minplus_acc.assign(n, INF);
+		for (int i = 0; i<tot0; i++)
+			minplus_relax(&c.minplus_acc[0], dist2[begin[i]], dist[begin[i]], n);
+		for (int j = 0; j<tot1; j++)
+			if (c.minplus_acc[end[j]]<dist2[end[j]])dist2[end[j]] = c.minplus_acc[end[j]];
+	}
+	void euclid_bounds(Query_Cache &c, int S, int y, int bound)//c.euclid[i]为S到结点y第i个border的直线距离下界，Euclidean Cut关闭或bound为INF(无可剪)时不计算
+	{
+		if (Optimization_Euclidean_Cut == false || bound == INF)return;
+		c.euclid.resize(node[y].border_id.size());
+		planar_bounds(Coordinate, S, node[y].border_id.data(), node[y].border_id.size(), c.euclid.data());
+	}
+	void catch_way(Query_Cache &c, int y, int S)//使结点y当前的catch为起点S的：S在其余路中则换入，否则当前catch让出最久未用的一路，自身置为待算(catch_id=-1)
+	{
+		Query_Cache::Node_Cache &n = c.node[y];
+		if (Catch_Ways <= 1 || n.catch_id == S)return;
+		int k = 0;
+		while (k<(int)n.ways.size() && n.ways[k].catch_id != S)k++;
+		if (k<(int)n.ways.size())perf_count(PC_CATCH_WAY_HITS);
+		else
+		{
+			perf_count(PC_CATCH_WAY_MISSES);
+			if (n.catch_id == -1)return;//当前的未用过，直接重算
+			if ((int)n.ways.size()<Catch_Ways - 1)n.ways.push_back(Query_Cache::Catch_Way());
+			k = n.ways.size() - 1;
+		}
+		n.swap_way(n.ways[k]);
+		rotate(n.ways.begin(), n.ways.begin() + k, n.ways.begin() + k + 1);//换出的放到最前
+		if (n.catch_id != S)
+		{
+			n.catch_id = n.catch_bound = -1;
+			n.min_border_dist = INF;
+			n.catch_dist.resize(node[y].borders.size());
+		}
+	}
+	void push_borders_up_catch(Query_Cache &c, int x, int bound = INF)//将S到结点x边界点缓存在x.catch_dist的最短路长度，计算S到x.father真实border的距离更新x.father.catch
+	{
+		if (node[x].father == 0)return;
+		int y = node[x].father;
+		catch_way(c, y, c.node[x].catch_id);
+		if (c.node[x].catch_id == c.node[y].catch_id&&bound <= c.node[y].catch_bound)
+		{
+			perf_count(PC_CATCH_HITS);
+			return;
+		}
+		perf_count(PC_CATCH_MISSES);
+		perf_count(PC_BORDER_PUSHES);
+		c.node[y].catch_id = c.node[x].catch_id;
+		c.node[y].catch_bound = bound;
+		vector<int> *dist1 = &c.node[x].catch_dist, *dist2 = &c.node[y].catch_dist;
+		for (int i = 0; i<(*dist2).size(); i++)(*dist2)[i] = INF;
+		for (int i = 0; i<node[x].borders.size(); i++)
+			if (node[x].border_in_father[i] != -1)
+			{
+				if (c.node[x].catch_dist[i]<bound)//bound界内的begin
+					(*dist2)[node[x].border_in_father[i]] = (*dist1)[i];
+				else (*dist2)[node[x].border_in_father[i]] = -1;//bound界外的begin
+			}
+		int **dist = node[y].dist.a;
 		int *begin, *end;//已算出的序列编号,未算出的序列编号
 		begin = new int[node[x].borders.size()];
 		end = new int[node[y].borders.size()];
 		int tot0 = 0, tot1 = 0;
+		euclid_bounds(c, c.node[x].catch_id, y, bound);
 		for (int i = 0; i<(*dist2).size(); i++)
 		{
 			if ((*dist2)[i] == -1)(*dist2)[i] = INF;
 			else if ((*dist2)[i]<INF)begin[tot0++] = i;
 			else if (node[y].border_in_father[i] != -1)
 			{
-				if (Optimization_Euclidean_Cut == false || Euclidean_Dist(node[x].catch_id, node[y].border_id[i])<bound)
+				if (Optimization_Euclidean_Cut == false || bound == INF || c.euclid[i]<bound)
 					end[tot1++] = i;
 			}
 		}
-		for (int i = 0; i<tot0; i++)
-		{
-			int i_ = begin[i];
-			for (int j = 0; j<tot1; j++)
-			{
-				if ((*dist2)[end[j]]>(*dist2)[i_] + dist[i_][end[j]])
-					(*dist2)[end[j]] = (*dist2)[i_] + dist[i_][end[j]];
-			}
-		}
+		minplus_relax_rows(c, *dist2, dist, begin, tot0, end, tot1);
 		delete[] begin;
 		delete[] end;
-		node[y].min_border_dist = INF;
-		for (int i = 0; i<node[y].catch_dist.size(); i++)
+		c.node[y].min_border_dist = INF;
+		for (int i = 0; i<c.node[y].catch_dist.size(); i++)
 			if (node[y].border_in_father[i] != -1)
-				node[y].min_border_dist = min(node[y].min_border_dist, node[y].catch_dist[i]);
+				c.node[y].min_border_dist = min(c.node[y].min_border_dist, c.node[y].catch_dist[i]);
 	}
-	void push_borders_down_catch(int x, int y, int bound = INF)//将S到结点x边界点缓存在x.catch_dist的最短路长度，计算S到x的儿子y真实border的距离更新y.catch
+	void push_borders_down_catch(Query_Cache &c, int x, int y, int bound = INF)//将S到结点x边界点缓存在x.catch_dist的最短路长度，计算S到x的儿子y真实border的距离更新y.catch
 	{
-		if (node[x].catch_id == node[y].catch_id&&bound <= node[y].catch_bound)return;
-		node[y].catch_id = node[x].catch_id;
-		node[y].catch_bound = bound;
-		vector<int> *dist1 = &node[x].catch_dist, *dist2 = &node[y].catch_dist;
+		catch_way(c, y, c.node[x].catch_id);
+		if (c.node[x].catch_id == c.node[y].catch_id&&bound <= c.node[y].catch_bound)
+		{
+			perf_count(PC_CATCH_HITS);
+			return;
+		}
+		perf_count(PC_CATCH_MISSES);
+		perf_count(PC_BORDER_PUSHES);
+		c.node[y].catch_id = c.node[x].catch_id;
+		c.node[y].catch_bound = bound;
+		vector<int> *dist1 = &c.node[x].catch_dist, *dist2 = &c.node[y].catch_dist;
 		for (int i = 0; i<(*dist2).size(); i++)(*dist2)[i] = INF;
 		for (int i = 0; i<node[x].borders.size(); i++)
 			if (node[x].son[node[x].color[node[x].border_id_innode[i]]] == y)
 			{
-				if (node[x].catch_dist[i]<bound)//bound界内的begin
+				if (c.node[x].catch_dist[i]<bound)//bound界内的begin
 					(*dist2)[node[x].border_in_son[i]] = (*dist1)[i];
 				else (*dist2)[node[x].border_in_son[i]] = -1;//bound界外的begin
 			}
@@ -1450,97 +2020,93 @@ struct G_Tree
 		begin = new int[node[y].borders.size()];
 		end = new int[node[y].borders.size()];
 		int tot0 = 0, tot1 = 0;
+		euclid_bounds(c, c.node[x].catch_id, y, bound);
 		for (int i = 0; i<(*dist2).size(); i++)
 		{
 			if ((*dist2)[i] == -1)(*dist2)[i] = INF;
 			else if ((*dist2)[i]<INF)begin[tot0++] = i;
 			else
 			{
-				if (Optimization_Euclidean_Cut == false || Euclidean_Dist(node[x].catch_id, node[y].border_id[i])<bound)
+				if (Optimization_Euclidean_Cut == false || bound == INF || c.euclid[i]<bound)
 					end[tot1++] = i;
 			}
 		}
-		for (int i = 0; i<tot0; i++)
-		{
-			int i_ = begin[i];
-			for (int j = 0; j<tot1; j++)
-			{
-				if ((*dist2)[end[j]]>(*dist2)[i_] + dist[i_][end[j]])
-					(*dist2)[end[j]] = (*dist2)[i_] + dist[i_][end[j]];
-			}
-		}
+		minplus_relax_rows(c, *dist2, dist, begin, tot0, end, tot1);
 		delete[] begin;
 		delete[] end;
-		node[y].min_border_dist = INF;
-		for (int i = 0; i<node[y].catch_dist.size(); i++)
+		c.node[y].min_border_dist = INF;
+		for (int i = 0; i<c.node[y].catch_dist.size(); i++)
 			if (node[y].border_in_father[i] != -1)
-				node[y].min_border_dist = min(node[y].min_border_dist, node[y].catch_dist[i]);
+				c.node[y].min_border_dist = min(c.node[y].min_border_dist, c.node[y].catch_dist[i]);
 	}
-	void push_borders_brother_catch(int x, int y, int bound = INF)//将S到结点x边界点缓存在x.catch_dist的最短路长度，计算S到x的兄弟结点y真实border的距离更新y.catch
+	void push_borders_brother_catch(Query_Cache &c, int x, int y, int bound = INF)//将S到结点x边界点缓存在x.catch_dist的最短路长度，计算S到x的兄弟结点y真实border的距离更新y.catch
 	{
-		int S = node[x].catch_id, LCA = node[x].father, i, j;
-		if (node[y].catch_id == S&&node[y].catch_bound >= bound)return;
+		int S = c.node[x].catch_id, LCA = node[x].father, i, j;
+		catch_way(c, y, S);
+		if (c.node[y].catch_id == S&&c.node[y].catch_bound >= bound)
+		{
+			perf_count(PC_CATCH_HITS);
+			return;
+		}
+		perf_count(PC_CATCH_MISSES);
+		perf_count(PC_BORDER_PUSHES);
 		int p;
-		node[y].catch_id = S;
-		node[y].catch_bound = bound;
+		c.node[y].catch_id = S;
+		c.node[y].catch_bound = bound;
 		vector<int>id_LCA[2], id_now[2];//子结点候选border在LCA中的border序列编号,子结点候选border在内部的border序列的编号
+		euclid_bounds(c, S, y, bound);
 		for (int t = 0; t<2; t++)
 		{
 			if (t == 0)p = x;
 			else p = y;
 			for (i = j = 0; i<(int)node[p].borders.size(); i++)
 				if (node[p].border_in_father[i] != -1)
-					if ((t == 1 && (Optimization_Euclidean_Cut == false || Euclidean_Dist(node[x].catch_id, node[p].border_id[i])<bound)) || (t == 0 && node[p].catch_dist[i]<bound))
+					if ((t == 1 && (Optimization_Euclidean_Cut == false || bound == INF || c.euclid[i]<bound)) || (t == 0 && c.node[p].catch_dist[i]<bound))
 					{
 						id_LCA[t].push_back(node[p].border_in_father[i]);
 						id_now[t].push_back(i);
 					}
 		}
-		for (int i = 0; i<node[y].catch_dist.size(); i++)node[y].catch_dist[i] = INF;
-		for (int i = 0; i<id_LCA[0].size(); i++)
+		for (int i = 0; i<c.node[y].catch_dist.size(); i++)c.node[y].catch_dist[i] = INF;
+		if (id_LCA[0].size() > 0 && id_LCA[1].size() > 0)
+		{
+			//x的border在LCA中的行整行min-plus松弛，再取y的border所在的列
+			c.minplus_acc.assign(node[LCA].dist.n, INF);
+			for (int i = 0; i<id_LCA[0].size(); i++)
+				minplus_relax(&c.minplus_acc[0], c.node[x].catch_dist[id_now[0][i]], node[LCA].dist.a[id_LCA[0][i]], node[LCA].dist.n);
 			for (int j = 0; j<id_LCA[1].size(); j++)
-			{
-				int k = node[x].catch_dist[id_now[0][i]] + node[LCA].dist.a[id_LCA[0][i]][id_LCA[1][j]];
-				if (k<node[y].catch_dist[id_now[1][j]])node[y].catch_dist[id_now[1][j]] = k;
-			}
+				if (c.minplus_acc[id_LCA[1][j]]<c.node[y].catch_dist[id_now[1][j]])c.node[y].catch_dist[id_now[1][j]] = c.minplus_acc[id_LCA[1][j]];
+		}
 		int **dist = node[y].dist.a;
 		//vector<int>begin,end;//已算出的序列编号,未算出的序列编号
 		int *begin, *end;
 		begin = new int[node[y].borders.size()];
 		end = new int[node[y].borders.size()];
 		int tot0 = 0, tot1 = 0;
-		for (int i = 0; i<node[y].catch_dist.size(); i++)
+		for (int i = 0; i<c.node[y].catch_dist.size(); i++)
 		{
-			if (node[y].catch_dist[i]<bound)begin[tot0++] = i;
-			else if (node[y].catch_dist[i] == INF)
+			if (c.node[y].catch_dist[i]<bound)begin[tot0++] = i;
+			else if (c.node[y].catch_dist[i] == INF)
 			{
-				if (Optimization_Euclidean_Cut == false || Euclidean_Dist(node[x].catch_id, node[y].border_id[i])<bound)
+				if (Optimization_Euclidean_Cut == false || bound == INF || c.euclid[i]<bound)
 					end[tot1++] = i;
 			}
 		}
-		for (int i = 0; i<tot0; i++)
-		{
-			int i_ = begin[i];
-			for (int j = 0; j<tot1; j++)
-			{
-				if (node[y].catch_dist[end[j]]>node[y].catch_dist[i_] + dist[i_][end[j]])
-					node[y].catch_dist[end[j]] = node[y].catch_dist[i_] + dist[i_][end[j]];
-			}
-		}
+		minplus_relax_rows(c, c.node[y].catch_dist, dist, begin, tot0, end, tot1);
 		delete[] begin;
 		delete[] end;
-		node[y].min_border_dist = INF;
-		for (int i = 0; i<node[y].catch_dist.size(); i++)
+		c.node[y].min_border_dist = INF;
+		for (int i = 0; i<c.node[y].catch_dist.size(); i++)
 			if (node[y].border_in_father[i] != -1)
-				node[y].min_border_dist = min(node[y].min_border_dist, node[y].catch_dist[i]);
+				c.node[y].min_border_dist = min(c.node[y].min_border_dist, c.node[y].catch_dist[i]);
 	}
-	void push_borders_up_path(int x, vector<int> &dist1)//将S到结点x边界点的最短路长度记录在dist1中，计算S到x.father真实border的距离更新dist1,并将到x.father的方案记录到x.father.path_record中(>=0表示结点，<0表示传递于那个结点儿子,-INF表示无前驱)
+	void push_borders_up_path(Query_Cache &c, int x, vector<int> &dist1)//将S到结点x边界点的最短路长度记录在dist1中，计算S到x.father真实border的距离更新dist1,并将到x.father的方案记录到x.father.path_record中(>=0表示结点，<0表示传递于那个结点儿子,-INF表示无前驱)
 	{
 		if (node[x].father == 0)return;
-		times[5] -= clock();
+		perf_count(PC_BORDER_PUSHES);
 		int y = node[x].father;
 		vector<int>dist3(node[y].borders.size(), INF);
-		vector<int> *order = &node[y].path_record;
+		vector<int> *order = &c.node[y].path_record;
 		(*order).clear();
 		for (int i = 0; i<node[y].borders.size(); i++)(*order).push_back(-INF);
 		for (int i = 0; i<node[x].borders.size(); i++)
@@ -1556,15 +2122,12 @@ struct G_Tree
 		begin = new int[node[x].borders.size()];
 		end = new int[node[y].borders.size()];
 		int tot0 = 0, tot1 = 0;
-		times[5] += clock();
-		times[6] -= clock();
 		for (int i = 0; i<dist3.size(); i++)
 		{
 			if (dist3[i]<INF)begin[tot0++] = i;
 			else if (node[y].border_in_father[i] != -1)end[tot1++] = i;
 		}
-		times[6] += clock();
-		times[7] -= clock();
+		perf_count(PC_RELAX_CELLS, (long long)tot0*tot1);
 		for (int i = 0; i<tot0; i++)
 		{
 			int i_ = begin[i];
@@ -1577,17 +2140,107 @@ struct G_Tree
 				}
 			}
 		}
-		times[7] += clock();
 		dist1 = dist3;
 		delete[] begin;
 		delete[] end;
 	}
-	int find_LCA(int x, int y)//计算树上两节点xy的LCA
+	void landmark_fit()//按Landmark为每个树结点汇总子树的地标距离，叶子取其结点的行，父亲合并儿子(儿子编号大于父亲)
+	{
+		int k = Landmark.k;
+		lm_from.assign((long long)node_tot*k, LANDMARK_INF);
+		lm_to.assign((long long)node_tot*k, -1);
+		if (k == 0)return;
+		const vector<int> &to = Landmark.to.empty() ? Landmark.from : Landmark.to;
+		for (int v = 0; v<G.n; v++)
+			landmark_group_add(k, &lm_from[(long long)id_in_node[v] * k], &lm_to[(long long)id_in_node[v] * k], &Landmark.from[(long long)v*k], &to[(long long)v*k]);
+		for (int x = node_tot - 1; x>1; x--)
+			landmark_group_add(k, &lm_from[(long long)node[x].father*k], &lm_to[(long long)node[x].father*k], &lm_from[(long long)x*k], &lm_to[(long long)x*k]);
+	}
+	int landmark_node_bound(int S, int x)//S到结点x子树内任一点距离的下界，无地标时为0
 	{
-		if (node[x].deep<node[y].deep)swap(x, y);
-		while (node[x].deep>node[y].deep)x = node[x].father;
-		while (x != y){ x = node[x].father; y = node[y].father; }
-		return x;
+		if (Landmark.k == 0)return 0;
+		return landmark_group_bound(Landmark, S, &lm_from[(long long)x*Landmark.k], &lm_to[(long long)x*Landmark.k]);
+	}
+	void cache_fit(Query_Cache &c)//按本树分配c(首次使用或树的结点数变了)，catch全部失效
+	{
+		if (c.node.size() == node_tot + 1)return;
+		c.node.assign(node_tot + 1, Query_Cache::Node_Cache());
+		c.car_dist.assign(node_tot + 1, vector<pair<int, int> >());
+		c.car_dist_copied.assign(node_tot + 1, 0);
+		c.car_dist_touched.clear();
+		for (int i = 1; i <= node_tot; i++)
+		{
+			c.node[i].catch_id = -1;
+			c.node[i].catch_bound = -1;
+			c.node[i].min_border_dist = INF;
+			c.node[i].catch_dist.assign(node[i].borders.size(), 0);
+		}
+	}
+	void build_lca()//建树后计算欧拉序及其稀疏表，find_LCA/lca_deep为O(1)
+	{
+		vector<int> euler;
+		euler_first.assign(node_tot + 1, -1);
+		node_deep.assign(node_tot + 1, 0);
+		vector<pair<int, int> > st(1, make_pair(root, 0));//<结点,下一个要访问的儿子>
+		while (st.size())
+		{
+			int x = st.back().first, &i = st.back().second;
+			if (i == 0)
+			{
+				euler_first[x] = euler.size();
+				node_deep[x] = node[x].deep;
+			}
+			euler.push_back(x);
+			while (i<node[x].part && node[x].son[i] == 0)i++;
+			if (i<node[x].part)
+			{
+				int y = node[x].son[i++];
+				st.push_back(make_pair(y, 0));//i此后失效
+			}
+			else st.pop_back();
+		}
+		euler_rmq.assign(1, euler);
+		for (int k = 1; (1 << k) <= euler.size(); k++)
+		{
+			const vector<int> &a = euler_rmq[k - 1];
+			vector<int> b(euler.size() - (1 << k) + 1);
+			for (int i = 0; i<b.size(); i++)
+			{
+				int u = a[i], v = a[i + (1 << (k - 1))];
+				b[i] = node_deep[u] <= node_deep[v] ? u : v;
+			}
+			euler_rmq.push_back(b);
+		}
+	}
+	int find_LCA(int x, int y)//计算树上两节点xy的LCA(欧拉序区间最浅的结点)
+	{
+		int l = euler_first[x], r = euler_first[y];
+		if (l>r)swap(l, r);
+		int k = 31 - __builtin_clz(r - l + 1);
+		int u = euler_rmq[k][l], v = euler_rmq[k][r - (1 << k) + 1];
+		return node_deep[u] <= node_deep[v] ? u : v;
+	}
+	vector<int> hub_order()//hub labeling的点序：作为border出现的结点越浅越靠前(根的border即最顶层的分割点)，同层度数大者靠前
+	{
+		vector<int> level(G.n, INF), deg(G.n, 0), order(G.n);
+		for (int x = 1; x<node_tot; x++)
+			for (map<int, pair<int, int> >::iterator it = node[x].borders.begin(); it != node[x].borders.end(); it++)
+				level[it->first] = min(level[it->first], node[x].deep);
+		for (int i = 0; i<G.n; i++)
+		{
+			order[i] = i;
+			for (int j = G.head[i]; j<G.head[i+1]; j++)deg[i]++;
+		}
+		sort(order.begin(), order.end(), [&](int a, int b){
+			if (level[a] != level[b])return level[a]<level[b];
+			if (deg[a] != deg[b])return deg[a]>deg[b];
+			return a<b;
+		});
+		return order;
+	}
+	int lca_deep(int x, int y)//树上两节点xy的LCA的深度
+	{
+		return node_deep[find_LCA(x, y)];
 	}
 	int search(int S, int T)//查询S-T最短路长度
 	{
@@ -1595,10 +2248,12 @@ struct G_Tree
 		//计算LCA
 		int i, j, k, p;
 		int LCA, x = id_in_node[S], y = id_in_node[T];
-		if (node[x].deep<node[y].deep)swap(x, y);
-		while (node[x].deep>node[y].deep)x = node[x].father;
-		while (x != y){ x = node[x].father; y = node[y].father; }
-		LCA = x;
+		//同一底层结点：叶子只含一个点且即为其border，底层结点的dist就是其所有点之间的全局距离表，直接查表
+		if (node[x].father == node[y].father && node[x].borders.size() == 1 && node[y].borders.size() == 1)
+			return node[node[x].father].dist.a[node[x].border_in_father[0]][node[y].border_in_father[0]];
+		LCA = find_LCA(x, y);
+		perf_count(PC_QUERIES);
+		perf_count(PC_LCA_DEPTH, node_deep[LCA]);
 		vector<int>dist[2], dist_;
 		dist[0].push_back(0);
 		dist[1].push_back(0);
@@ -1643,14 +2298,22 @@ struct G_Tree
 		}
 		return MIN;
 	}
-	int search_catch(int S, int T, int bound = INF)//查询S-T最短路长度,并将沿途结点的catch处理为S的结果，其中不计算权值>=bound的部分，若没有则剪枝返回INF
+	int search_cut()//search_catch因bound剪枝而放弃
+	{
+		perf_count(PC_KNN_SEARCH_CUTS);
+		return INF;
+	}
+	int search_catch(Query_Cache &c, int S, int T, int bound = INF)//查询S-T最短路长度,并将沿途结点的catch处理为S的结果，其中不计算权值>=bound的部分，若没有则剪枝返回INF
 	{
 		//朴素G-Tree计算,维护catch
 		if (S == T)return 0;
+		cache_fit(c);
 		//计算LCA
 		int i, j, k, p;
 		int x = id_in_node[S], y = id_in_node[T];
 		int LCA = find_LCA(x, y);
+		perf_count(PC_QUERIES);
+		perf_count(PC_LCA_DEPTH, node_deep[LCA]);
 
 		//计算两个叶子到LCA沿途结点编号
 		vector<int>node_path[2];//点x/y到LCA之前依次会经过的树结点编号
@@ -1669,69 +2332,72 @@ struct G_Tree
 		}
 
 		//将S从叶子push到LCA下层
-		node[id_in_node[S]].catch_id = S;
-		node[id_in_node[S]].catch_bound = bound;
-		node[id_in_node[S]].min_border_dist = 0;
-		node[id_in_node[S]].catch_dist[0] = 0;
+		c.node[id_in_node[S]].catch_id = S;
+		c.node[id_in_node[S]].catch_bound = bound;
+		c.node[id_in_node[S]].min_border_dist = 0;
+		c.node[id_in_node[S]].catch_dist[0] = 0;
 		for (i = 0; i + 1<node_path[0].size(); i++)
 		{
-			if (node[node_path[0][i]].min_border_dist >= bound)return INF;
-			push_borders_up_catch(node_path[0][i]);
+			if (c.node[node_path[0][i]].min_border_dist >= bound)return search_cut();
+			push_borders_up_catch(c, node_path[0][i]);
 		}
 
 		//计算T在LCA下层结点的catch
-		if (node[x].min_border_dist >= bound)return INF;
-		push_borders_brother_catch(x, y);
+		if (c.node[x].min_border_dist >= bound)return search_cut();
+		push_borders_brother_catch(c, x, y);
 		//将T在LCA下层的数据push到底层结点T
 		for (int i = node_path[1].size() - 1; i>0; i--)
 		{
-			if (node[node_path[1][i]].min_border_dist >= bound)return INF;
-			push_borders_down_catch(node_path[1][i], node_path[1][i - 1]);
+			if (c.node[node_path[1][i]].min_border_dist >= bound)return search_cut();
+			push_borders_down_catch(c, node_path[1][i], node_path[1][i - 1]);
 		}
 
 		//最终答案
-		return node[id_in_node[T]].catch_dist[0];
+		return c.node[id_in_node[T]].catch_dist[0];
 	}
-	int find_path(int S, int T, vector<int> &order)//返回S-T最短路长度，并将沿途经过的结点方案存储到order数组中
+	int find_path(Query_Cache &c, int S, int T, vector<int> &order)//返回S-T最短路长度，并将沿途经过的结点方案存储到order数组中
 	{
 		order.clear();
+		if (!Keep_Order)//仅距离的索引没有方案，order为空
+		{
+			static bool warned = false;
+			if (!warned)printf("NO ORDER MATRICES(DISTANCE ONLY INDEX), NO PATH\n");
+			warned = true;
+			return search(S, T);
+		}
 		if (S == T)
 		{
 			order.push_back(S);
 			return 0;
 		}
+		cache_fit(c);
 		//计算LCA
-		times[0] -= clock();
-		times[4] -= clock();
+		Perf_Scope perf(PT_PATH_LCA);
 		int i, j, k, p;
 		int LCA, x = id_in_node[S], y = id_in_node[T];
-		if (node[x].deep<node[y].deep)swap(x, y);
-		while (node[x].deep>node[y].deep)x = node[x].father;
-		while (x != y){ x = node[x].father; y = node[y].father; }
-		LCA = x;
+		LCA = find_LCA(x, y);
+		perf_count(PC_QUERIES);
+		perf_count(PC_LCA_DEPTH, node_deep[LCA]);
 		vector<int>dist[2], dist_;
 		dist[0].push_back(0);
 		dist[1].push_back(0);
 		x = id_in_node[S], y = id_in_node[T];
 		//朴素G-Tree计算
-		cnt_type1++;
 		//printf("LCA=%d x=%d y=%d\n",LCA,x,y);
-		times[4] += clock();
-		times[2] -= clock();
+		perf.next(PT_PATH_UP);
 		for (int t = 0; t<2; t++)
 		{
 			if (t == 0)p = x;
 			else p = y;
 			while (node[p].father != LCA)
 			{
-				push_borders_up_path(p, dist[t]);
+				push_borders_up_path(c, p, dist[t]);
 				p = node[p].father;
 			}
 			if (t == 0)x = p;
 			else y = p;
 		}
-		times[2] += clock();
-		times[3] -= clock();
+		perf.next(PT_PATH_TRIM);
 		vector<int>id[2];//子结点border在LCA中的border序列编号
 		for (int t = 0; t<2; t++)
 		{
@@ -1746,9 +2412,8 @@ struct G_Tree
 				}
 			while (dist[t].size()>id[t].size()){ dist[t].pop_back(); }
 		}
-		times[3] += clock();
 		//最终配对
-		times[1] -= clock();
+		perf.next(PT_PATH_JOIN);
 		int MIN = INF;
 		int S_ = -1, T_ = -1;//最优路径在LCA中borders连接的编号
 		for (i = 0; i<(int)dist[0].size(); i++)
@@ -1762,8 +2427,11 @@ struct G_Tree
 					T_ = id[1][j];
 				}
 			}
-		if (MIN<INF)//存在路径，恢复路径
+		if (MIN<INF)//存在路径，恢复路径：先列出所有border对，逐对展开(可命中缓存)后按总长一次reserve拼接
 		{
+			vector<Query_Cache::Hop> &hops = c.path_hops;
+			hops.clear();
+			int n0 = 0;//x一侧的border对数，这些对的结点整体翻转
 			for (int t = 0; t<2; t++)
 			{
 				int p, now;
@@ -1771,42 +2439,51 @@ struct G_Tree
 				else p = y, now = node[LCA].border_in_son[T_];
 				while (node[p].n>1)
 				{
-					//printf("t=%d p=%d now=%d node[p].path_record[now]=%d\n",t,p,now,node[p].path_record[now]);
-					if (node[p].path_record[now] >= 0)
+					if (c.node[p].path_record[now] >= 0)
 					{
-						find_path_border(p, now, node[p].path_record[now], order, 0);
-						now = node[p].path_record[now];
+						Query_Cache::Hop h = { p, now, c.node[p].path_record[now] };
+						hops.push_back(h);
+						now = c.node[p].path_record[now];
 					}
-					else if (node[p].path_record[now]>-INF)
+					else if (c.node[p].path_record[now]>-INF)
 					{
 						int temp = now;
 						now = node[p].border_in_son[now];
-						p = -node[p].path_record[temp];
+						p = -c.node[p].path_record[temp];
 					}
 					else break;
 				}
-				if (t == 0)//翻转，补充连接路径
+				if (t == 0)//LCA中连接两侧的border对
 				{
-					reverse(order.begin(), order.end());
-					order.push_back(node[LCA].border_id[S_]);
-					find_path_border(LCA, S_, T_, order, 0);
+					n0 = hops.size();
+					Query_Cache::Hop h = { LCA, S_, T_ };
+					hops.push_back(h);
 				}
 			}
+			c.path_buf.clear();
+			c.path_off.assign(1, 0);
+			for (int i = 0; i<(int)hops.size(); i++)
+			{
+				unpack_hop(c, hops[i], c.path_buf);
+				c.path_off.push_back(c.path_buf.size());
+			}
+			order.reserve(c.path_buf.size() + 1);
+			for (int i = c.path_off[n0] - 1; i >= 0; i--)order.push_back(c.path_buf[i]);
+			order.push_back(node[LCA].border_id[S_]);
+			order.insert(order.end(), c.path_buf.begin() + c.path_off[n0], c.path_buf.end());
 		}
-		times[1] += clock();
-		times[0] += clock();
 		return MIN;
 		//cout<<"QY5";
 	}
-	int real_border_number(int x)//计算x真实的border数(忽略内部子图之间的border)
+	int real_border_number(const Graph &g)//计算子图g真实的border数(忽略内部子图之间的border)
 	{
 		int i, j, re = 0, id;
 		map<int, int>vis;
-		for (i = 0; i<node[x].G.n; i++)vis[node[x].G.id[i]] = 1;
-		for (i = 0; i<node[x].G.n; i++)
+		for (i = 0; i<g.n; i++)vis[g.id[i]] = 1;
+		for (i = 0; i<g.n; i++)
 		{
-			id = node[x].G.id[i];
-			for (j = G.head[id]; j; j = G.next[j])
+			id = g.id[i];
+			for (j = G.head[id]; j<G.head[id+1]; j++)
 				if (vis[G.list[j]] == 0)
 				{
 					re++;
@@ -1817,208 +2494,501 @@ struct G_Tree
 	}
 	void find_path_border(int x, int S, int T, vector<int> &v, int rev)//返回结点x中编号为S到T的border的结点路径，存储在vector<int>中，将除了起点S以外的部分S+1~T，push到v尾部,rev=0表示正序，rev=1表示逆序
 	{
-		/*printf("find:x=%d S=%d T=%d\n",x,S,T);
-		printf("node:%d\n",x);
-		node[x].write();
-		printf("\n\n\n\n");*/
-		if (node[x].order.a[S][T] == -1)
+		vector<Query_Cache::Hop> stk;
+		find_path_border(stk, x, S, T, v, rev);
+	}
+	void find_path_border(vector<Query_Cache::Hop> &stk, int x, int S, int T, vector<int> &v, int rev)//同上，显式栈stk代替递归(栈顶为下一段)
+	{
+		Query_Cache::Hop h = { x, S, T };
+		stk.assign(1, h);
+		while (!stk.empty())
 		{
-			if (rev == 0)v.push_back(node[x].border_id[T]);
-			else v.push_back(node[x].border_id[S]);
+			h = stk.back();
+			stk.pop_back();
+			int o = node[h.x].order.get(h.S, h.T);
+			if (o == -1)v.push_back(node[h.x].border_id[rev == 0 ? h.T : h.S]);
+			else if (o == -2)
+			{
+				Query_Cache::Hop f = { node[h.x].father, node[h.x].border_in_father[h.S], node[h.x].border_in_father[h.T] };
+				stk.push_back(f);
+			}
+			else if (o == -3)
+			{
+				Query_Cache::Hop f = { node[h.x].son[node[h.x].color[node[h.x].border_id_innode[h.S]]], node[h.x].border_in_son[h.S], node[h.x].border_in_son[h.T] };
+				stk.push_back(f);
+			}
+			else if (o >= 0)//S-k与k-T两段，先输出的一段后入栈
+			{
+				Query_Cache::Hop a = { h.x, h.S, o }, b = { h.x, o, h.T };
+				if (rev == 0)stk.push_back(b), stk.push_back(a);
+				else stk.push_back(a), stk.push_back(b);
+			}
 		}
-		else if (node[x].order.a[S][T] == -2)
+	}
+	int path_border_length(Query_Cache &c, int x, int S, int T)//find_path_border(x,S,T)会输出的结点数，已缓存的取缓存长度，否则不写结点只数
+	{
+		Query_Cache::Hop h = { x, S, T };
+		unordered_map<Query_Cache::Hop, Query_Cache::Hop_List::iterator, Query_Cache::Hop_Hash, Query_Cache::Hop_Eq>::iterator it = c.hop_index.find(h);
+		if (it != c.hop_index.end())return it->second->second.size();
+		int len = 0;
+		vector<Query_Cache::Hop> &stk = c.unpack_stack;
+		stk.assign(1, h);
+		while (!stk.empty())
 		{
-			find_path_border(node[x].father, node[x].border_in_father[S], node[x].border_in_father[T], v, rev);
+			h = stk.back();
+			stk.pop_back();
+			int o = node[h.x].order.get(h.S, h.T);
+			if (o == -1)len++;
+			else if (o == -2)
+			{
+				Query_Cache::Hop f = { node[h.x].father, node[h.x].border_in_father[h.S], node[h.x].border_in_father[h.T] };
+				stk.push_back(f);
+			}
+			else if (o == -3)
+			{
+				Query_Cache::Hop f = { node[h.x].son[node[h.x].color[node[h.x].border_id_innode[h.S]]], node[h.x].border_in_son[h.S], node[h.x].border_in_son[h.T] };
+				stk.push_back(f);
+			}
+			else if (o >= 0)
+			{
+				Query_Cache::Hop a = { h.x, h.S, o }, b = { h.x, o, h.T };
+				stk.push_back(b);
+				stk.push_back(a);
+			}
+		}
+		return len;
+	}
+	void unpack_hop(Query_Cache &c, const Query_Cache::Hop &h, vector<int> &v)//border对h正序展开到v尾部：命中c的LRU则复制，否则展开并(Path_Cache_Pairs>0时)存入LRU
+	{
+		if (Path_Cache_Pairs <= 0)
+		{
+			find_path_border(c.unpack_stack, h.x, h.S, h.T, v, 0);
+			return;
 		}
-		else if (node[x].order.a[S][T] == -3)
+		unordered_map<Query_Cache::Hop, Query_Cache::Hop_List::iterator, Query_Cache::Hop_Hash, Query_Cache::Hop_Eq>::iterator it = c.hop_index.find(h);
+		if (it != c.hop_index.end())
 		{
-			find_path_border(node[x].son[node[x].color[node[x].border_id_innode[S]]], node[x].border_in_son[S], node[x].border_in_son[T], v, rev);
+			perf_count(PC_HOP_HITS);
+			c.hop_lru.splice(c.hop_lru.begin(), c.hop_lru, it->second);
+			const vector<int> &p = it->second->second;
+			v.insert(v.end(), p.begin(), p.end());
+			return;
 		}
-		else if (node[x].order.a[S][T] >= 0)
+		perf_count(PC_HOP_MISSES);
+		int from = v.size();
+		find_path_border(c.unpack_stack, h.x, h.S, h.T, v, 0);
+		if ((int)c.hop_lru.size() >= Path_Cache_Pairs)
 		{
-			int k = node[x].order.a[S][T];
-			if (rev == 0)
+			c.hop_index.erase(c.hop_lru.back().first);
+			c.hop_lru.pop_back();
+		}
+		c.hop_lru.push_front(make_pair(h, vector<int>(v.begin() + from, v.end())));
+		c.hop_index[h] = c.hop_lru.begin();
+	}
+	struct No_Offset{ int operator()(int i)const{ return 0; } };//目标无距离偏移
+	struct Array_Offset{ const int *p; int operator()(int i)const{ return p[i]; } };//目标i的偏移p[i](车到结点的距离)
+	template<bool Cut, bool Is_Range, class Offset>
+	void select_targets(Query_Cache &c, int S, int K, const int *T, int n, int bound, Offset offset, vector<pair<int, int> > &out, double eps = 0)//KNN/KNN_bound/Range的统一实现，out=<T中的下标,距离>按下标升序
+	{
+		//目标按与S的LCA由深到浅查询，catch复用最多；KNN时用当前第K小(与bound取小)剪枝，Range时用bound(=R)剪枝
+		//Cut=false时不剪枝(Optimization_KNN_Cut)；Is_Range时取距离<bound的全部目标，否则取距离<=min(bound,第K小)的前K个
+		//eps>0(近似KNN)时用第K小/(1+eps)剪枝：被剪掉的目标距离不小于它，返回的距离仍是精确值，第i个不超过真实第i近的(1+eps)倍
+		out.clear();
+		if (n == 0 || (!Is_Range && K <= 0))return;
+		vector<pair<int, int> > &query = c.query;//first:该查询的优先级(越低越靠前)，second该查询在原序列T中的id
+		vector<int> &K_Value = c.K_Value, &ans = c.ans;//K_Value:保存K小值的大根堆
+		query.clear();
+		K_Value.clear();
+		ans.resize(n);
+		int x = id_in_node[S];
+		for (int i = 0; i<n; i++)query.push_back(make_pair(-lca_deep(x, id_in_node[T[i]]), i));
+		sort(query.begin(), query.end());
+		for (int i = 0; i<n; i++)
+		{
+			int b = Is_Range || K_Value.size()<K ? bound : min(bound, eps>0 && K_Value[0]<INF ? (int)ceil(K_Value[0] / (1 + eps)) : K_Value[0]);
+			int j = query[i].second;
+			perf_count(PC_KNN_TARGETS);
+			if (Cut && b<INF && landmark_bound(Landmark, S, T[j]) + offset(j)>b)
 			{
-				find_path_border(x, S, k, v, rev);
-				find_path_border(x, k, T, v, rev);
+				perf_count(PC_KNN_LANDMARK_CUTS);
+				ans[i] = INF + offset(j);//地标下界已超过b，同search_catch的剪枝
 			}
-			else
+			else ans[i] = search_catch(c, S, T[j], Cut ? b : INF) + offset(j);
+			if (Is_Range)continue;
+			if (K_Value.size()<K)
 			{
-				find_path_border(x, k, T, v, rev);
-				find_path_border(x, S, k, v, rev);
+				K_Value.push_back(ans[i]);
+				push_heap(K_Value.begin(), K_Value.end());
 			}
+			else if (ans[i]<K_Value[0])
+			{
+				pop_heap(K_Value.begin(), K_Value.end());
+				K_Value.back() = ans[i];
+				push_heap(K_Value.begin(), K_Value.end());
+			}
+		}
+		if (Is_Range)
+		{
+			for (int i = 0; i<n; i++)
+				if (ans[i]<bound)out.push_back(make_pair(query[i].second, ans[i]));
 		}
+		else
+		{
+			int thr = n <= K ? bound : min(bound, K_Value[0]);
+			for (int i = 0; i<n; i++)//先取严格小于第K小的，与第K小相等的补足K个
+				if (ans[i]<thr)out.push_back(make_pair(query[i].second, ans[i]));
+			for (int i = 0; i<n && out.size()<K; i++)
+				if (ans[i] == thr)out.push_back(make_pair(query[i].second, ans[i]));
+		}
+		sort(out.begin(), out.end());
 	}
-	vector<int> KNN(int S, int K, vector<int>T)//计算S到T数组中的前K小并返回其在T数组中的下标
+	void KNN(Query_Cache &c, int S, int K, const int *T, int n, vector<pair<int, int> > &out, const int *offset = NULL, int bound = INF, double eps = 0)//T[0..n)中离S最近的K个(距离<=bound)，offset为每个目标的距离偏移(可空)，out=<下标,距离>，eps>0为近似KNN(见select_targets)
 	{
-		priority_queue<int>K_Value;//保存K小值
-		vector<pair<int, int> >query;//first:该查询的优先级(越低越靠前)，second该查询在原序列T中的id
-		for (int i = 0; i<T.size(); i++)query.push_back(make_pair(-node[find_LCA(id_in_node[S], id_in_node[T[i]])].deep, i));
-		sort(query.begin(), query.end());
-		vector<int>re, ans;
-		if (K <= 0)return re;
-		for (int i = 0; i<T.size(); i++)
-		{
-			int bound = K_Value.size()<K ? INF : K_Value.top();
-			//if(bound==INF)printf("- ");else printf("%d ",bound);
-			if (Optimization_KNN_Cut)ans.push_back(search_catch(S, T[query[i].second], bound));
-			else ans.push_back(search_catch(S, T[query[i].second]));
-			if (K_Value.size()<K)K_Value.push(ans[i]);
-			else if (ans[i]<K_Value.top())
-			{
-				K_Value.pop();
-				K_Value.push(ans[i]);
-			}
-		}
-		int bound = (ans.size() <= K) ? INF : K_Value.top();
-		for (int i = 0; i<T.size() && re.size()<K; i++)
-			if (ans[i] <= bound)
-				re.push_back(query[i].second);
-		sort(re.begin(), re.end());
-		return re;
+		if (offset == NULL)select_targets<Optimization_KNN_Cut, false>(c, S, K, T, n, bound, No_Offset(), out, eps);
+		else
+		{
+			Array_Offset o = { offset };
+			select_targets<Optimization_KNN_Cut, false>(c, S, K, T, n, bound, o, out, eps);
+		}
 	}
-	vector<int> KNN(int S, int K, vector<int>T, vector<int>offset)//计算S到T数组中的前K小并返回其在T数组中的下标,考虑车到结点距离offset
+	void Range(Query_Cache &c, int S, int R, const int *T, int n, vector<pair<int, int> > &out, const int *offset = NULL)//T[0..n)中距离S小于R的目标，out=<下标,距离>
 	{
-		priority_queue<int>K_Value;//保存K小值
-		vector<pair<int, int> >query;//first:该查询的优先级(越低越靠前)，second该查询在原序列T中的id
-		for (int i = 0; i<T.size(); i++)query.push_back(make_pair(-node[find_LCA(id_in_node[S], id_in_node[T[i]])].deep, i));
-		sort(query.begin(), query.end());
-		vector<int>re, ans;
-		if (K <= 0)return re;
-		for (int i = 0; i<T.size(); i++)
-		{
-			int bound = K_Value.size()<K ? INF : K_Value.top();
-			//if(bound==INF)printf("- ");else printf("%d ",bound);
-			if (Optimization_KNN_Cut)ans.push_back(search_catch(S, T[query[i].second], bound) + offset[query[i].second]);
-			else ans.push_back(search_catch(S, T[query[i].second]) + offset[query[i].second]);
-			if (K_Value.size()<K)K_Value.push(ans[i]);
-			else if (ans[i]<K_Value.top())
-			{
-				K_Value.pop();
-				K_Value.push(ans[i]);
-			}
-		}
-		int bound = (ans.size() <= K) ? INF : K_Value.top();
-		for (int i = 0; i<T.size() && re.size()<K; i++)
-			if (ans[i] <= bound)
-				re.push_back(query[i].second);
-		sort(re.begin(), re.end());
+		if (offset == NULL)select_targets<Optimization_KNN_Cut, true>(c, S, 0, T, n, R, No_Offset(), out);
+		else
+		{
+			Array_Offset o = { offset };
+			select_targets<Optimization_KNN_Cut, true>(c, S, 0, T, n, R, o, out);
+		}
+	}
+	vector<int> target_index(const vector<pair<int, int> > &out)//<下标,距离>中的下标
+	{
+		vector<int> re;
+		for (int i = 0; i<out.size(); i++)re.push_back(out[i].first);
 		return re;
 	}
-	vector<int> KNN_bound(int S, int K, vector<int>T, int bound)//计算S到T数组中的前K小并返回其在T数组中的下标
+	//以下为返回下标数组的旧接口
+	vector<int> KNN(Query_Cache &c, int S, int K, const vector<int> &T)//计算S到T数组中的前K小并返回其在T数组中的下标
 	{
-		priority_queue<int>K_Value;//保存K小值
-		vector<pair<int, int> >query;//first:该查询的优先级(越低越靠前)，second该查询在原序列T中的id
-		for (int i = 0; i<T.size(); i++)query.push_back(make_pair(-node[find_LCA(id_in_node[S], id_in_node[T[i]])].deep, i));
-		sort(query.begin(), query.end());
-		vector<int>re, ans;
-		if (K <= 0)return re;
-		for (int i = 0; i<T.size(); i++)
-		{
-			if (Optimization_KNN_Cut)ans.push_back(search_catch(S, T[query[i].second], bound));
-			else ans.push_back(search_catch(S, T[query[i].second]));
-			if (K_Value.size()<K)K_Value.push(ans[i]);
-			else if (ans[i]<K_Value.top())
+		vector<pair<int, int> > out;
+		KNN(c, S, K, T.data(), T.size(), out);
+		return target_index(out);
+	}
+	vector<int> KNN(Query_Cache &c, int S, int K, const vector<int> &T, const vector<int> &offset)//计算S到T数组中的前K小并返回其在T数组中的下标,考虑车到结点距离offset
+	{
+		vector<pair<int, int> > out;
+		KNN(c, S, K, T.data(), T.size(), out, offset.data());
+		return target_index(out);
+	}
+	vector<int> KNN_bound(Query_Cache &c, int S, int K, const vector<int> &T, int bound)//计算S到T数组中距离不超过bound的前K小并返回其在T数组中的下标
+	{
+		vector<pair<int, int> > out;
+		KNN(c, S, K, T.data(), T.size(), out, NULL, bound);
+		return target_index(out);
+	}
+	vector<int> KNN_bound(Query_Cache &c, int S, int K, const vector<int> &T, int bound, const vector<int> &offset)//计算S到T数组中距离不超过bound的前K小并返回其在T数组中的下标,考虑车到结点距离offset
+	{
+		vector<pair<int, int> > out;
+		KNN(c, S, K, T.data(), T.size(), out, offset.data(), bound);
+		return target_index(out);
+	}
+	vector<int> Range(Query_Cache &c, int S, int R, const vector<int> &T)//计算S到T数组中距离小于R的终点T并返回其在T数组中的下标
+	{
+		vector<pair<int, int> > out;
+		Range(c, S, R, T.data(), T.size(), out);
+		return target_index(out);
+	}
+	vector<int> Range(Query_Cache &c, int S, int R, const vector<int> &T, const vector<int> &offset)//计算S到T数组中距离小于R的终点T并返回其在T数组中的下标,考虑车到结点距离offset
+	{
+		vector<pair<int, int> > out;
+		Range(c, S, R, T.data(), T.size(), out, offset.data());
+		return target_index(out);
+	}
+	vector<vector<int> > distance_matrix(const vector<int> &S, const vector<int> &T, int threads = 1)//计算S×T的距离表re[i][j]=dist(S[i],T[j])，目标与源点分别分给threads个线程
+	{
+		//目标一侧：每个目标从叶子逆向上推一次(同search的dist[1])，to[j][d]=path[j][d]的border到T[j]的距离，与源点无关
+		//源点一侧：catch向上只推一次，LCA下目标所在的儿子y的catch由brother_catch算出并被y下的所有目标共用，
+		//每对(S,T)只剩在y的border上配对一次，不再对每个目标向下push到叶子
+		vector<vector<int> > re(S.size(), vector<int>(T.size(), INF));
+		vector<vector<int> > path(T.size());//目标所在叶子到根的儿子依次经过的结点
+		vector<vector<vector<int> > > to(T.size());
+		if (threads<1)threads = 1;
+		parallel_for(threads, T.size(), [&](int worker, int j){
+			vector<int> dist(1, 0);
+			for (int p = id_in_node[T[j]]; p != root; p = node[p].father)
 			{
-				K_Value.pop();
-				K_Value.push(ans[i]);
+				path[j].push_back(p);
+				to[j].push_back(dist);
+				if (node[p].father != root)push_borders_up(p, dist, 1);
 			}
-		}
-		for (int i = 0; i<T.size() && re.size()<K; i++)
-			if (ans[i] <= bound)
-				re.push_back(query[i].second);
-		sort(re.begin(), re.end());
+		});
+		vector<Query_Cache> caches(threads);
+		parallel_for(threads, S.size(), [&](int worker, int i){
+			Query_Cache &c = caches[worker];
+			cache_fit(c);
+			int x = id_in_node[S[i]];
+			c.node[x].catch_id = S[i];
+			c.node[x].catch_bound = INF;
+			c.node[x].min_border_dist = 0;
+			c.node[x].catch_dist[0] = 0;
+			vector<int> spath;//源点叶子到根的儿子依次经过的结点
+			for (int p = x; p != root; p = node[p].father)
+			{
+				spath.push_back(p);
+				if (node[p].father != root)push_borders_up_catch(c, p);
+			}
+			for (int j = 0; j<T.size(); j++)
+			{
+				if (path[j][0] == x){ re[i][j] = 0; continue; }
+				int d = lca_deep(x, path[j][0]) + 1;
+				int xs = spath[node[x].deep - d], y = path[j][node[path[j][0]].deep - d];
+				push_borders_brother_catch(c, xs, y);
+				const vector<int> &cy = c.node[y].catch_dist, &ty = to[j][node[path[j][0]].deep - d];
+				int MIN = INF;
+				for (int b = 0; b<cy.size(); b++)
+					if (cy[b] + ty[b]<MIN)MIN = cy[b] + ty[b];
+				re[i][j] = MIN;
+			}
+		});
 		return re;
 	}
-	vector<int> KNN_bound(int S, int K, vector<int>T, int bound, vector<int>offset)//计算S到T数组中的前K小并返回其在T数组中的下标,考虑车到结点距离offset
+	//车辆集合的并发：cars[0/1]左右双缓冲。查询用car_pin固定前台那份只读；更新先car_post排队，
+	//car_apply把一批更新写到后台、切换前台、等旧前台上的查询读完后再写一遍旧前台，查询看不到写了一半的DP
+	int car_pin()//固定前台车辆状态，返回其下标，用完car_unpin
 	{
-		priority_queue<int>K_Value;//保存K小值
-		vector<pair<int, int> >query;//first:该查询的优先级(越低越靠前)，second该查询在原序列T中的id
-		for (int i = 0; i<T.size(); i++)query.push_back(make_pair(-node[find_LCA(id_in_node[S], id_in_node[T[i]])].deep, i));
-		sort(query.begin(), query.end());
-		vector<int>re, ans;
-		if (K <= 0)return re;
-		for (int i = 0; i<T.size(); i++)
+		for (;;)
 		{
-			if (Optimization_KNN_Cut)ans.push_back(search_catch(S, T[query[i].second], bound) + offset[query[i].second]);
-			else ans.push_back(search_catch(S, T[query[i].second]) + offset[query[i].second]);
-			if (K_Value.size()<K)K_Value.push(ans[i]);
-			else if (ans[i]<K_Value.top())
-			{
-				K_Value.pop();
-				K_Value.push(ans[i]);
-			}
+			int s = car_front.load();
+			car_readers[s]++;
+			if (car_front.load() == s)return s;
+			car_readers[s]--;
 		}
-		for (int i = 0; i<T.size() && re.size()<K; i++)
-			if (ans[i] <= bound)
-				re.push_back(query[i].second);
-		sort(re.begin(), re.end());
-		return re;
 	}
-	vector<int> Range(int S, int R, vector<int>T)//计算S到T数组中距离小于R的终点T并返回其在T数组中的下标
+	void car_unpin(int s)
 	{
-		vector<int>re;
-		for (int i = 0; i<T.size(); i++)
+		car_readers[s]--;
+	}
+	void car_post(int type, int node_id, int car_id, int dist = 0)//提交一次车辆更新，下次car_apply生效(多个线程可同时提交)
+	{
+		Car_Update u = { type, node_id, car_id, dist };
+		lock_guard<mutex> lock(car_post_lock);
+		car_pending.push_back(u);
+	}
+	void car_apply()//使已提交的车辆更新成批生效(可由一个更新线程定期调用，查询不被阻塞)
+	{
+		lock_guard<mutex> lock(car_write_lock);
+		vector<Car_Update> batch;
 		{
-			if (search_catch(S, T[i], Optimization_KNN_Cut ? R : INF)<R)re.push_back(i);
+			lock_guard<mutex> lock2(car_post_lock);
+			batch.swap(car_pending);
 		}
-		return re;
+		if (batch.size() == 0)return;
+		int back = 1 - car_front.load();
+		car_update(cars[back], batch);
+		cars[back].epoch++;
+		car_front.store(back);
+		while (car_readers[1 - back].load() != 0)this_thread::yield();
+		car_update(cars[1 - back], batch);
+		cars[1 - back].epoch++;
+		car_watch(cars[back], batch);
+		result_stamp(batch, cars[back].epoch);
 	}
-	vector<int> Range(int S, int R, vector<int>T, vector<int>offset)//计算S到T数组中距离小于R的终点T并返回其在T数组中的下标,考虑车到结点距离offset
+	void apply_car_updates(const vector<Car_Update> &u)//一批车辆更新一起生效，min_car_dist每个受影响的结点只修一次
 	{
-		vector<int>re;
-		for (int i = 0; i<T.size(); i++)
 		{
-			if (offset[i] + search_catch(S, T[i], Optimization_KNN_Cut ? R : INF)<R)re.push_back(i);
+			lock_guard<mutex> lock(car_post_lock);
+			car_pending.insert(car_pending.end(), u.begin(), u.end());
 		}
-		return re;
+		car_apply();
+	}
+	void car_update(Car_State &st, const vector<Car_Update> &batch)//把一批更新写到st：先改车辆表，再修有车/无车状态变了的结点的min_car_dist
+	{
+		map<int, bool> had;//批中涉及的结点原来是否有车
+		for (int k = 0; k<batch.size(); k++)
+		{
+			const Car_Update &u = batch[k];
+			if (u.type == CAR_OFFSET)
+			{
+				if (st.car_offset.size() <= u.car_id)st.car_offset.resize(u.car_id + 1, 0);
+				st.car_offset[u.car_id] = u.dist;
+				continue;
+			}
+			vector<int> &v = st.car_in_node[u.node_id];
+			if (had.find(u.node_id) == had.end())had[u.node_id] = v.size()>0;
+			if (u.type == CAR_ADD)
+			{
+				v.push_back(u.car_id);
+				if (st.car_type.size() <= u.car_id)st.car_type.resize(u.car_id + 1, 0);
+				st.car_type[u.car_id] = u.dist;
+			}
+			else
+			{
+				int i;
+				for (i = 0; i<v.size(); i++)
+					if (v[i] == u.car_id)break;
+				if (i == v.size()){ printf("Error: del_car find none car!"); continue; }
+				v.erase(v.begin() + i);
+			}
+		}
+		vector<int> flip, touched;
+		for (map<int, bool>::iterator it = had.begin(); it != had.end(); it++)
+		{
+			touched.push_back(it->first);
+			if (it->second != (st.car_in_node[it->first].size()>0))flip.push_back(it->first);
+		}
+		car_type_repair(st, touched);
+		if (flip.size() <= CAR_REPAIR_BATCH)
+		{
+			for (int i = 0; i<flip.size(); i++)
+				if (st.car_in_node[flip[i]].size()>0)car_dist_add(st, flip[i]);
+				else car_dist_del(st, flip[i]);
+			return;
+		}
+		//标记所有变化结点的祖先(去重)，按深度从下往上每层重算一次，同层结点互不相关，并行
+		vector<char> dirty(node_tot + 1, 0);
+		vector<vector<int> > level;
+		for (int i = 0; i<flip.size(); i++)
+		{
+			int S = id_in_node[flip[i]];
+			st.min_car_dist[S][0] = st.car_in_node[flip[i]].size()>0 ? make_pair(0, flip[i]) : make_pair(INF, -1);
+			for (int p = node[S].father; p && !dirty[p]; p = node[p].father)
+			{
+				dirty[p] = 1;
+				if (level.size() <= node_deep[p])level.resize(node_deep[p] + 1);
+				level[node_deep[p]].push_back(p);
+			}
+		}
+		for (int d = (int)level.size() - 1; d >= 0; d--)
+		{
+			int threads = level[d].size() >= CAR_REPAIR_PARALLEL ? Build_Threads : 1;
+			parallel_for(threads, level[d].size(), [&](int worker, int k){
+				car_dist_repair(st, level[d][k]);
+			});
+		}
+	}
+	unsigned car_type_leaf(const Car_State &st, int node_id)//结点node_id上车的类型位之或
+	{
+		unsigned m = 0;
+		const vector<int> &v = st.car_in_node[node_id];
+		for (int i = 0; i<v.size(); i++)m |= st.type(v[i]);
+		return m;
 	}
-	void add_car(int node_id, int car_id)//向车辆集合中增加一辆位于结点编号：node_id的车，车的编号为car_id
+	void car_type_build(Car_State &st)//由car_in_node整体建立type_mask：各图结点所在叶子，再按深度自下而上或到父亲
 	{
-		car_in_node[node_id].push_back(car_id);
-		if (car_in_node[node_id].size() == 1)
+		st.type_mask.assign(node_tot + 1, 0);
+		for (int i = 0; i<(int)st.car_in_node.size(); i++)
+			if (id_in_node[i] != -1)st.type_mask[id_in_node[i]] = car_type_leaf(st, i);
+		vector<int> order;
+		for (int x = 1; x <= node_tot; x++)order.push_back(x);
+		sort(order.begin(), order.end(), [&](int a, int b){ return node_deep[a]>node_deep[b]; });
+		for (int i = 0; i<order.size(); i++)
+			if (node[order[i]].father)st.type_mask[node[order[i]].father] |= st.type_mask[order[i]];
+	}
+	void car_type_repair(Car_State &st, const vector<int> &touched)//车辆有变化的图结点：叶子重算，祖先去重后按深度自下而上由儿子重算
+	{
+		if (st.type_mask.size() != node_tot + 1)st.type_mask.assign(node_tot + 1, 0);
+		vector<char> dirty(node_tot + 1, 0);
+		vector<int> up;
+		for (int i = 0; i<touched.size(); i++)
 		{
-			//增加node_id更新距离border最小距离
-			int S = id_in_node[node_id];
-			node[S].min_car_dist[0] = make_pair(0, node_id);
-			for (int p = S; push_borders_up_add_min_car_dist(p, node_id); p = node[p].father);
+			int S = id_in_node[touched[i]];
+			st.type_mask[S] = car_type_leaf(st, touched[i]);
+			for (int p = node[S].father; p && !dirty[p]; p = node[p].father)
+			{
+				dirty[p] = 1;
+				up.push_back(p);
+			}
+		}
+		sort(up.begin(), up.end(), [&](int a, int b){ return node_deep[a]>node_deep[b]; });
+		for (int i = 0; i<up.size(); i++)
+		{
+			unsigned m = 0;
+			for (int k = 0; k<node[up[i]].part; k++)m |= st.type_mask[node[up[i]].son[k]];
+			st.type_mask[up[i]] = m;
 		}
 	}
-	void del_car(int node_id, int car_id)//从车辆集合中删除一辆位于结点编号：node_id的车，车的编号为car_id
+	void car_dist_repair(Car_State &st, int y)//由儿子的min_car_dist整体重算y的
 	{
-		int i;
-		for (i = 0; i<car_in_node[node_id].size(); i++)
-			if (car_in_node[node_id][i] == car_id)break;
-		if (i == car_in_node[node_id].size())printf("Error: del_car find none car!");
-		while (i + 1<car_in_node[node_id].size()){ swap(car_in_node[node_id][i], car_in_node[node_id][i + 1]); i++; }
-		car_in_node[node_id].pop_back();
-		if (car_in_node[node_id].size() == 0)
+		vector<pair<int, int> > &d = st.min_car_dist[y];
+		if (y == root)
+		{
+			for (int i = 0; i<d.size(); i++)d[i] = make_pair(INF, -1);
+			for (int k = 0; k<node[y].part; k++)
+			{
+				int x = node[y].son[k];
+				const vector<pair<int, int> > &s = st.min_car_dist[x];
+				for (int i = 0; i<node[x].borders.size(); i++)
+					if (node[x].border_in_father[i] != -1 && d[node[x].border_in_father[i]].first>s[i].first)
+						d[node[x].border_in_father[i]] = s[i];
+			}
+			return;
+		}
+		int SIZE = node[y].borders.size();
+		vector<pair<int, int> > v(SIZE);//每个border在其所在儿子中的值
+		for (int i = 0; i<SIZE; i++)
+			v[i] = st.min_car_dist[node[y].son[node[y].color[node[y].border_id_innode[i]]]][node[y].border_in_son[i]];
+		int **dist = node[y].dist.a;
+		for (int i = 0; i<SIZE; i++)
 		{
-			//删除node_id更新距border最小距离
-			int S = id_in_node[node_id];
-			node[S].min_car_dist[0] = make_pair(INF, -1);
-			for (int p = S; push_borders_up_del_min_car_dist(p, node_id); p = node[p].father);
+			d[i] = v[i];
+			for (int j = 0; j<SIZE; j++)
+				if (v[j].first<INF && d[i].first>v[j].first + dist[i][j])
+					d[i] = make_pair(v[j].first + dist[i][j], v[j].second);
 		}
 	}
-	void change_car_offset(int car_id, int dist)//修改车car_id到其所在结点的距离dist
+	template<class V>
+	void car_dist_add(V &v, int node_id)//结点node_id上有了车，更新距离border最小距离
 	{
-		while (car_offset.size() <= car_id)car_offset.push_back(0);
-		car_offset[car_id] = dist;
+		int S = id_in_node[node_id];
+		v.set(S)[0] = make_pair(0, node_id);
+		for (int p = S; push_borders_up_add_min_car_dist(v, p, node_id); p = node[p].father);
+	}
+	template<class V>
+	void car_dist_del(V &v, int node_id)//结点node_id上没有车了，更新距border最小距离
+	{
+		int S = id_in_node[node_id];
+		v.set(S)[0] = make_pair(INF, -1);
+		for (int p = S; push_borders_up_del_min_car_dist(v, p, node_id); p = node[p].father);
+	}
+	void add_car(int node_id, int car_id, unsigned type = 0)//向车辆集合中增加一辆位于结点编号：node_id的车，车的编号为car_id，类型位type(立即生效)
+	{
+		car_post(CAR_ADD, node_id, car_id, type);
+		car_apply();
+	}
+	void del_car(int node_id, int car_id)//从车辆集合中删除一辆位于结点编号：node_id的车，车的编号为car_id(立即生效)
+	{
+		car_post(CAR_DEL, node_id, car_id);
+		car_apply();
+	}
+	void change_car_offset(int car_id, int dist)//修改车car_id到其所在结点的距离dist(立即生效)
+	{
+		car_post(CAR_OFFSET, -1, car_id, dist);
+		car_apply();
+	}
+	long long car_epoch()//当前车辆集合的版本
+	{
+		int s = car_pin();
+		long long re = cars[s].epoch;
+		car_unpin(s);
+		return re;
 	}
 	int get_car_offset(int car_id)//查询车car_id的距离偏移量
 	{
-		while (car_offset.size() <= car_id)car_offset.push_back(0);
-		return car_offset[car_id];
+		int s = car_pin();
+		int re = cars[s].offset(car_id);
+		car_unpin(s);
+		return re;
 	}
-	int begin[10000], end[10000];//已算出的序列编号,未算出的序列编号
-	bool push_borders_up_add_min_car_dist(int x, int start_id)//用结点x的min_car_dist更新x.father的，其中只更新node_id=start_id的部分，若不存在则返回false，否则返回true
+	template<class V>
+	bool push_borders_up_add_min_car_dist(V &v, int x, int start_id)//用结点x的min_car_dist更新x.father的，其中只更新node_id=start_id的部分，若不存在则返回false，否则返回true
 	{
 		int re = false;
 		if (node[x].father == 0)return re;
 		int y = node[x].father;
-		vector<pair<int, int> > *dist1 = &node[x].min_car_dist, *dist2 = &node[y].min_car_dist;
+		const vector<pair<int, int> > *dist1 = &v.get(x);
+		vector<pair<int, int> > *dist2 = &v.set(y);
+		vector<int> begin(dist2->size()), end(dist2->size());//已算出的序列编号,未算出的序列编号
 		for (int i = 0; i<node[x].borders.size(); i++)
-			if (node[x].min_car_dist[i].second == start_id)
+			if ((*dist1)[i].second == start_id)
 			{
 				re = true;
 				if (node[x].border_in_father[i] != -1)
@@ -2051,15 +3021,17 @@ struct G_Tree
 		}
 		return re;
 	}
-	bool push_borders_up_del_min_car_dist(int x, int start_id)//删除x.father中node_id=start_id的min_car_dist,并用其他值更新,若不存在返回false，否则返回true
+	template<class V>
+	bool push_borders_up_del_min_car_dist(V &v, int x, int start_id)//删除x.father中node_id=start_id的min_car_dist,并用其他值更新,若不存在返回false，否则返回true
 	{
 		if (DEBUG_)printf("push_borders_up_del_min_car_dist x=%d id=%d \n", x, start_id);
 		int re = false;
 		if (node[x].father == 0)return false;
 		int y = node[x].father;
-		//printf("min_car_dist ");for(int i=0;i<node[y].min_car_dist.size();i++)printf("(i:%d,D:%d,id:%d)",i,node[y].min_car_dist[i].first,node[y].min_car_dist[i].second);printf("\n");
-		vector<pair<int, int> > *dist1 = &node[x].min_car_dist, *dist2 = &node[y].min_car_dist;
-		if (DEBUG_)for (int i = 0; i<node[x].borders.size(); i++)if (node[x].min_car_dist[i].second == start_id){ printf("WRong!!!!%d %d\n", x, start_id); while (1); }
+		const vector<pair<int, int> > *dist1 = &v.get(x);
+		vector<pair<int, int> > *dist2 = &v.set(y);
+		vector<int> begin(dist2->size()), end(dist2->size());//已算出的序列编号,未算出的序列编号
+		if (DEBUG_)for (int i = 0; i<node[x].borders.size(); i++)if ((*dist1)[i].second == start_id){ printf("WRong!!!!%d %d\n", x, start_id); while (1); }
 		int tot0 = 0, tot1 = 0;
 		if (y == root)//删除x.father中关于node_id的数据
 		{
@@ -2088,7 +3060,7 @@ struct G_Tree
 			{
 				if ((*dist2)[i].second == start_id)
 				{
-					(*dist2)[i] = node[node[y].border_son_id[i]].min_car_dist[node[y].border_in_son[i]];
+					(*dist2)[i] = v.get(node[y].son[node[y].color[node[y].border_id_innode[i]]])[node[y].border_in_son[i]];
 					end[tot1++] = i;
 					re = true;
 				}
@@ -2134,14 +3106,15 @@ struct G_Tree
 		//if(DEBUG_)printf("re=%d\n",re);
 		return re;
 	}
-	int push_borders_up_catch_KNN_min_dist_car(int x)//将S到结点x边界点缓存在x.catch_dist的最短路长度，计算S到x.father真实border的距离更新x.father.catch，并返回父亲结点border中最远距离(用于KNN扩张剪枝)
+	int push_borders_up_catch_KNN_min_dist_car(Query_Cache &c, int x)//将S到结点x边界点缓存在x.catch_dist的最短路长度，计算S到x.father真实border的距离更新x.father.catch，并返回父亲结点border中最远距离(用于KNN扩张剪枝)
 	{
 		if (node[x].father == 0)return INF;
 		int re = INF + 1;
 		int y = node[x].father;
-		node[y].catch_id = node[x].catch_id;
-		node[y].catch_bound = -1;
-		vector<int> *dist1 = &node[x].catch_dist, *dist2 = &node[y].catch_dist;
+		catch_way(c, y, c.node[x].catch_id);
+		c.node[y].catch_id = c.node[x].catch_id;
+		c.node[y].catch_bound = -1;
+		vector<int> *dist1 = &c.node[x].catch_dist, *dist2 = &c.node[y].catch_dist;
 		for (int i = 0; i<(*dist2).size(); i++)(*dist2)[i] = INF;
 		for (int i = 0; i<node[x].borders.size(); i++)
 			if (node[x].border_in_father[i] != -1)
@@ -2156,15 +3129,7 @@ struct G_Tree
 			if ((*dist2)[i]<INF)begin[tot0++] = i;
 			else end[tot1++] = i;
 		}
-		for (int i = 0; i<tot0; i++)
-		{
-			int i_ = begin[i];
-			for (int j = 0; j<tot1; j++)
-			{
-				if ((*dist2)[end[j]]>(*dist2)[i_] + dist[i_][end[j]])
-					(*dist2)[end[j]] = (*dist2)[i_] + dist[i_][end[j]];
-			}
-		}
+		minplus_relax_rows(c, *dist2, dist, begin, tot0, end, tot1);
 		if (y == root)re = INF + 1;
 		else
 			for (int i = 0; i<node[y].borders.size(); i++)
@@ -2174,113 +3139,458 @@ struct G_Tree
 		delete[] end;
 		return re;
 	}
-	vector<int> KNN_min_dist_car(int S, int K)//计算S到car集合中的前K小并返回其车辆编号
+	int car_out_bound(Car_View &v, int S, int x, unsigned want = 0)//S到结点x子树之外的车的距离下界，x到根路径上各结点的兄弟结点b取小：
+	{//进入b须经b的border，故不小于(S到b的地标下界)+(b的border到b内最近车的距离)，b内无车(或无want类型的车)时为INF
+		int re = INF;
+		for (; x != root; x = node[x].father)
+		{
+			int f = node[x].father;
+			for (int i = 0; i<node[f].part; i++)
+			{
+				int b = node[f].son[i], m = INF;
+				if (b == x || !type_match(v.s.type_mask[b], want))continue;
+				const vector<pair<int, int> > &d = v.get(b);
+				for (int j = 0; j<d.size(); j++)m = min(m, d[j].first);
+				if (m<INF)re = min(re, landmark_node_bound(S, b) + m);
+			}
+		}
+		return re;
+	}
+	int car_take(Car_View &v, int node_id)//查询中取走结点node_id上的下一辆车，该结点的车取完后在v中删去该结点
 	{
+		int &t = v.c.car_taken[node_id];
+		int car_id = v.s.car_in_node[node_id][t++];
+		if (t == v.s.car_in_node[node_id].size())car_dist_del(v, node_id);
+		return car_id;
+	}
+	long long car_nearest(Query_Cache &c, int S, int M, vector<Car_Hit> &out, unsigned want = 0, int *scope = NULL)//S最近的M辆类型含want的车(按到车所在结点的距离，不计offset)，按距离从小到大，返回所读车辆集合的版本，scope非NULL时写入结果的范围(见result_scope)
+	{//want非0时不含want类型车的结点不入队，队中取到的不符合的车跳过；min_car_dist不分类型，只能剪去整棵无符合车的子树
+		out.clear();
 		//动态扩张优化：catch计算到某一层，只有K距离超过当前层最远点，或当前层无车时扩张
 		int Now_Catch_P = id_in_node[S], Now_Catch_Dist = 0;//现在的S的catch做到那个结点，动态扩张
-		priority_queue<pair<int, pair<int, int> > >q;//保存K小值<-dist,<node_id,border_id>>
+		int Now_Catch_Out = -1;//S到Now_Catch_P子树之外的车的下界(-1为未算，见car_out_bound)，不超过它的车不必扩张
+		RadixHeap<pair<int, int> > &q = c.car_queue;//<dist,<node_id,border_id>>
+		radix_clear(q);
+		cache_fit(c);
+		int s = car_pin();//整个查询读同一份车辆状态，取走的车只记在c中
+		Car_View v(cars[s], c);
 		{//构建S的catch
-			node[id_in_node[S]].catch_id = S;
-			node[id_in_node[S]].catch_bound = INF;
-			node[id_in_node[S]].min_border_dist = 0;
-			node[id_in_node[S]].catch_dist[0] = 0;
+			c.node[id_in_node[S]].catch_id = S;
+			c.node[id_in_node[S]].catch_bound = INF;
+			c.node[id_in_node[S]].min_border_dist = 0;
+			c.node[id_in_node[S]].catch_dist[0] = 0;
 			/*for(int p=id_in_node[S];p!=root;p=node[p].father)
-			push_borders_up_catch_KNN_min_dist_car(p);*/
+			push_borders_up_catch_KNN_min_dist_car(c, p);*/
 		}
 		//建立PQ
-		for (int i = 0; i<node[Now_Catch_P].borders.size(); i++)
-			q.push(make_pair(-(node[Now_Catch_P].catch_dist[i] + node[Now_Catch_P].min_car_dist[i].first), make_pair(Now_Catch_P, i)));
-		vector<int>ans, ans2;//车的编号及其所在结点
+		auto catch_push = [&](){
+			if (!type_match(v.s.type_mask[Now_Catch_P], want))return;
+			for (int i = 0; i<node[Now_Catch_P].borders.size(); i++)
+				radix_push(q, c.node[Now_Catch_P].catch_dist[i] + v.get(Now_Catch_P)[i].first, make_pair(Now_Catch_P, i));
+		};
+		auto catch_up = [&](){
+			Now_Catch_Dist = push_borders_up_catch_KNN_min_dist_car(c, Now_Catch_P);
+			Now_Catch_P = node[Now_Catch_P].father;
+			Now_Catch_Out = -1;
+			catch_push();
+		};
+		catch_push();
+		while (M && type_match(v.s.type_mask[root], want))
+		{
+			if (radix_empty(q))//所在子树无符合的车
+			{
+				if (Now_Catch_P == root)break;
+				catch_up();
+				continue;
+			}
+			int Dist = -(int)radix_top(q).first;
+			int node_id = radix_top(q).second.first;
+			int border_id = radix_top(q).second.second;
+			if (-Dist>Now_Catch_Dist && Now_Catch_P != root && Now_Catch_Out<0)Now_Catch_Out = car_out_bound(v, S, Now_Catch_P, want);
+			if (-Dist>Now_Catch_Dist && -Dist>Now_Catch_Out && Now_Catch_P != root)
+			{
+				catch_up();
+				continue;
+			}
+			int real_Dist = -(c.node[node_id].catch_dist[border_id] + v.get(node_id)[border_id].first);
+			if (Dist != real_Dist)//该border最近的车已被取走，按下一辆的距离重新入队(只会变大)；先判扩张再出队，队列才单调(出队的不超过扩张界)
+			{
+				radix_pop(q);
+				radix_push(q, -real_Dist, make_pair(node_id, border_id));
+				continue;
+			}
+			int real_node_id = v.get(node_id)[border_id].second;
+
+			if (real_node_id == -1)break;
+			int car_id = car_take(v, real_node_id);
+			radix_pop(q);
+			radix_push(q, c.node[node_id].catch_dist[border_id] + v.get(node_id)[border_id].first, make_pair(node_id, border_id));
+			if (!type_match(v.s.type(car_id), want))continue;
+			Car_Hit h = { car_id, real_node_id, -real_Dist };
+			out.push_back(h);
+			M--;
+		}
+		if (scope != NULL)*scope = result_scope(S, Now_Catch_P, Now_Catch_Dist, M>0 ? INF : out.size()>0 ? out.back().dist : -1);
+		long long epoch = cars[s].epoch;
+		car_unpin(s);
+		return epoch;
+	}
+	vector<int> KNN_min_dist_car(Query_Cache &c, int S, int K, unsigned want = 0)//计算S到car集合中类型含want的车的前K小并返回其车辆编号(Result_Cache_Size>0时先查结果缓存)
+	{
+		vector<int>ans;//车的编号
+		Result_Key key = { S, K, want };
+		if (car_stamp != NULL && result_find(key, ans))return ans;
+		int scope;
+		long long epoch = knn_car_search(c, S, K, want, ans, scope);
+		if (car_stamp != NULL)result_put(key, scope, epoch, ans);
+		return ans;
+	}
+	long long knn_car_search(Query_Cache &c, int S, int K, unsigned want, vector<int> &ans, int &scope)//KNN_min_dist_car的计算：前K小的车编号写入ans，结果的范围写入scope，返回所读车辆集合的版本
+	{
 		if (Distance_Offset == false)
 		{
-			while (K)
+			vector<Car_Hit> hit;
+			long long epoch = car_nearest(c, S, K, hit, want, &scope);
+			for (int i = 0; i<hit.size(); i++)ans.push_back(hit[i].car_id);
+			return epoch;
+		}
+		//动态扩张优化：catch计算到某一层，只有K距离超过当前层最远点，或当前层无车时扩张
+		int Now_Catch_P = id_in_node[S], Now_Catch_Dist = 0;//现在的S的catch做到那个结点，动态扩张
+		int Now_Catch_Out = -1;//S到Now_Catch_P子树之外的车的下界(-1为未算，见car_out_bound)，不超过它的车不必扩张
+		RadixHeap<pair<int, int> > &q = c.car_queue;//<dist,<node_id,border_id>>
+		radix_clear(q);
+		cache_fit(c);
+		int s = car_pin();//整个查询读同一份车辆状态，取走的车只记在c中
+		Car_View v(cars[s], c);
+		{//构建S的catch
+			c.node[id_in_node[S]].catch_id = S;
+			c.node[id_in_node[S]].catch_bound = INF;
+			c.node[id_in_node[S]].min_border_dist = 0;
+			c.node[id_in_node[S]].catch_dist[0] = 0;
+			/*for(int p=id_in_node[S];p!=root;p=node[p].father)
+			push_borders_up_catch_KNN_min_dist_car(c, p);*/
+		}
+		//建立PQ
+		auto catch_push = [&](){
+			if (!type_match(v.s.type_mask[Now_Catch_P], want))return;
+			for (int i = 0; i<node[Now_Catch_P].borders.size(); i++)
+				radix_push(q, c.node[Now_Catch_P].catch_dist[i] + v.get(Now_Catch_P)[i].first, make_pair(Now_Catch_P, i));
+		};
+		auto catch_up = [&](){
+			Now_Catch_Dist = push_borders_up_catch_KNN_min_dist_car(c, Now_Catch_P);
+			Now_Catch_P = node[Now_Catch_P].father;
+			Now_Catch_Out = -1;
+			catch_push();
+		};
+		catch_push();
+		priority_queue<int>KNN_Dist;
+		vector<int>ans3;
+		while (type_match(v.s.type_mask[root], want))
+		{
+			if (radix_empty(q))//所在子树无符合的车
 			{
-				int Dist = q.top().first;
-				int node_id = q.top().second.first;
-				int border_id = q.top().second.second;
-				int real_Dist = -(node[node_id].catch_dist[border_id] + node[node_id].min_car_dist[border_id].first);
-				if (Dist != real_Dist)
-				{
-					q.pop();
-					q.push(make_pair(real_Dist, make_pair(node_id, border_id)));
-					continue;
-				}
-				if (-Dist>Now_Catch_Dist && Now_Catch_P != root)
-				{
-					Now_Catch_Dist = push_borders_up_catch_KNN_min_dist_car(Now_Catch_P);
-					Now_Catch_P = node[Now_Catch_P].father;
-					for (int i = 0; i<node[Now_Catch_P].borders.size(); i++)
-					{
-						q.push(make_pair(-(node[Now_Catch_P].catch_dist[i] + node[Now_Catch_P].min_car_dist[i].first), make_pair(Now_Catch_P, i)));
-					}
-					continue;
-				}
-				int real_node_id = node[node_id].min_car_dist[border_id].second;
+				if (Now_Catch_P == root)break;
+				catch_up();
+				continue;
+			}
+			if (KNN_Dist.size() >= K && KNN_Dist.top()<(int)radix_top(q).first)break;
+			int Dist = -(int)radix_top(q).first;
+			int node_id = radix_top(q).second.first;
+			int border_id = radix_top(q).second.second;
+			if (-Dist>Now_Catch_Dist && Now_Catch_P != root && Now_Catch_Out<0)Now_Catch_Out = car_out_bound(v, S, Now_Catch_P, want);
+			if (-Dist>Now_Catch_Dist && -Dist>Now_Catch_Out && Now_Catch_P != root)
+			{
+				catch_up();
+				continue;
+			}
+			int real_Dist = -(c.node[node_id].catch_dist[border_id] + v.get(node_id)[border_id].first);
+			if (Dist != real_Dist)//该border最近的车已被取走，按下一辆的距离重新入队(只会变大)；先判扩张再出队，队列才单调(出队的不超过扩张界)
+			{
+				radix_pop(q);
+				radix_push(q, -real_Dist, make_pair(node_id, border_id));
+				continue;
+			}
+			int real_node_id = v.get(node_id)[border_id].second;
 
-				if (real_node_id == -1)break;
-				int car_id = car_in_node[real_node_id][0];
-				q.pop();
-				ans.push_back(car_id);
-				ans2.push_back(real_node_id);
-				del_car(real_node_id, car_id);
-				q.push(make_pair(-(node[node_id].catch_dist[border_id] + node[node_id].min_car_dist[border_id].first), make_pair(node_id, border_id)));
-				K--;
+			if (real_node_id == -1)break;
+			int car_id = car_take(v, real_node_id);
+			radix_pop(q);
+			radix_push(q, c.node[node_id].catch_dist[border_id] + v.get(node_id)[border_id].first, make_pair(node_id, border_id));
+			if (!type_match(v.s.type(car_id), want))continue;
+			int car_dist = v.s.offset(car_id) - real_Dist;
+			if (KNN_Dist.size()<K)KNN_Dist.push(car_dist);
+			else if (KNN_Dist.top()>car_dist)
+			{
+				KNN_Dist.pop();
+				KNN_Dist.push(car_dist);
 			}
-			for (int i = 0; i<ans.size(); i++)add_car(ans2[i], ans[i]);
+			ans.push_back(car_id);
+			ans3.push_back(car_dist);
 		}
-		else
+		int j = 0;
+		for (int i = 0; i<ans.size(); i++)
+			if (ans3[i] <= KNN_Dist.top())
+				ans[j++] = ans[i];
+		while (ans.size()>K)ans.pop_back();
+		scope = result_scope(S, Now_Catch_P, Now_Catch_Dist, KNN_Dist.size() >= K ? (KNN_Dist.empty() ? -1 : KNN_Dist.top()) : INF);
+		long long epoch = cars[s].epoch;
+		car_unpin(s);
+		return epoch;
+	}
+	int landmark_out_bound(int S, int x)//S到结点x子树之外任一点距离的下界：x到根路径上各结点的兄弟结点取小，无地标时为0
+	{
+		int re = INF;
+		for (; x != root; x = node[x].father)
+		{
+			int f = node[x].father;
+			for (int i = 0; i<node[f].part; i++)
+				if (node[f].son[i] != x)re = min(re, landmark_node_bound(S, node[f].son[i]));
+		}
+		return re;
+	}
+	int result_scope(int S, int P, int P_Dist, int kth)//车辆KNN的结果只取决于哪棵子树中的车：S到子树外不小于kth(第K近的距离，不足K辆为INF)时，
+	{//子树外的车加入、删除、移动都不进前K。查询做到P，S到P子树外不小于P_Dist；P以下的祖先只有地标下界可用
+		if (Landmark.k>0)
+			for (int x = id_in_node[S]; x != P; x = node[x].father)
+				if (kth<landmark_out_bound(S, x))return x;
+		return kth<P_Dist ? P : root;
+	}
+	void result_cache_fit()//按本树分配结果缓存的结点版本并清空缓存(建树、载入后)，Result_Cache_Size为0时不缓存
+	{
+		delete[] car_stamp;
+		car_stamp = Result_Cache_Size>0 ? new atomic<long long>[node_tot + 1]() : NULL;
+		for (int i = 0; i<RESULT_CACHE_SHARDS; i++)
 		{
-			priority_queue<int>KNN_Dist;
-			vector<int>ans3;
-			while (KNN_Dist.size()<K || KNN_Dist.top() <= -q.top().first)
+			lock_guard<mutex> lock(result_shard[i].lock);
+			result_shard[i].lru.clear();
+			result_shard[i].index.clear();
+		}
+	}
+	void result_stamp(const vector<Car_Update> &batch, long long epoch)//car_apply：一批更新涉及的车所在叶子到根路径上的结点版本记为epoch(car_watch之后，CAR_OFFSET据watch_car_node找车)
+	{
+		if (car_stamp == NULL)return;
+		for (int k = 0; k<batch.size(); k++)
+		{
+			const Car_Update &u = batch[k];
+			int node_id = u.type == CAR_OFFSET ? (Distance_Offset ? watch_car_node[u.car_id] : -1) : u.node_id;
+			if (node_id<0)continue;
+			for (int x = id_in_node[node_id]; car_stamp[x].load() != epoch; x = node[x].father)//已记过的结点其祖先也已记过
 			{
-				int Dist = q.top().first;
-				int node_id = q.top().second.first;
-				int border_id = q.top().second.second;
-				int real_Dist = -(node[node_id].catch_dist[border_id] + node[node_id].min_car_dist[border_id].first);
-				if (Dist != real_Dist)
-				{
-					q.pop();
-					q.push(make_pair(real_Dist, make_pair(node_id, border_id)));
-					continue;
-				}
-				if (-Dist>Now_Catch_Dist && Now_Catch_P != root)
+				car_stamp[x].store(epoch);
+				if (x == root)break;
+			}
+		}
+	}
+	bool result_find(const Result_Key &key, vector<int> &ans)//结果缓存中key的有效条目复制到ans，失效的删去
+	{
+		Result_Shard &sh = result_shard[Result_Key_Hash()(key) % RESULT_CACHE_SHARDS];
+		lock_guard<mutex> lock(sh.lock);
+		unordered_map<Result_Key, Result_List::iterator, Result_Key_Hash, Result_Key_Eq>::iterator it = sh.index.find(key);
+		if (it == sh.index.end())return false;
+		Result_List::iterator e = it->second;
+		if (car_stamp[e->scope].load()>e->epoch)
+		{
+			perf_count(PC_RESULT_STALE);
+			sh.index.erase(it);
+			sh.lru.erase(e);
+			return false;
+		}
+		perf_count(PC_RESULT_HITS);
+		sh.lru.splice(sh.lru.begin(), sh.lru, e);
+		ans = e->ans;
+		return true;
+	}
+	void result_put(const Result_Key &key, int scope, long long epoch, const vector<int> &ans)//存入结果缓存(同键已有则取较新的)，段满时去掉最久未用的
+	{
+		Result_Shard &sh = result_shard[Result_Key_Hash()(key) % RESULT_CACHE_SHARDS];
+		lock_guard<mutex> lock(sh.lock);
+		unordered_map<Result_Key, Result_List::iterator, Result_Key_Hash, Result_Key_Eq>::iterator it = sh.index.find(key);
+		if (it != sh.index.end())
+		{
+			if (it->second->epoch>epoch)return;
+			sh.lru.erase(it->second);
+			sh.index.erase(it);
+		}
+		Result_Entry e = { key, scope, epoch, ans };
+		sh.lru.push_front(e);
+		sh.index[key] = sh.lru.begin();
+		int cap = max(1, Result_Cache_Size / RESULT_CACHE_SHARDS);
+		while ((int)sh.lru.size()>cap)
+		{
+			perf_count(PC_RESULT_EVICTIONS);
+			sh.index.erase(sh.lru.back().key);
+			sh.lru.pop_back();
+		}
+	}
+	void knn_session_begin(Knn_Session &ss, int K, int B = -1)//开始一个连续KNN，B为多算的候选车数(默认K)
+	{
+		ss.K = K;
+		ss.B = B<0 ? K : B;
+		ss.anchor = -1;
+		ss.full = ss.fast = 0;
+		ss.result.clear();
+	}
+	//查询点移到S后的K近车辆。anchor处算过K+B个候选(按anchor处距离排好)，候选外的车到anchor都不小于bound，
+	//S离anchor为delta时各车到S的距离与到anchor相差不超过delta(三角不等式)：
+	//2*delta<=gap时前K个候选仍是K近，只需算S到这K个的距离；否则算S到全部候选，第K近不超过bound-delta即可；
+	//都不成立(或车辆集合已变)时在S重新完整计算
+	const vector<Car_Hit>& knn_session_move(Knn_Session &ss, int S)
+	{
+		if (ss.anchor != -1 && car_epoch() == ss.epoch)
+		{
+			cache_fit(ss.c);
+			int delta = search_catch(ss.c, S, ss.anchor);
+			if (delta<ss.bound)
+			{
+				int n = (long long)2 * delta <= ss.gap ? min(ss.K, (int)ss.node.size()) : ss.node.size();
+				if (knn_session_check(ss, S, n, ss.bound - delta)){ ss.fast++; return ss.result; }
+			}
+		}
+		vector<Car_Hit> hit;
+		ss.epoch = car_nearest(ss.c, S, ss.K + ss.B + 1, hit);
+		ss.full++;
+		ss.anchor = S;
+		ss.bound = INF;
+		if (hit.size() == ss.K + ss.B + 1){ ss.bound = hit.back().dist; hit.pop_back(); }
+		for (int i = 0; i<hit.size(); i++)
+			if (Distance_Offset)hit[i].dist += get_car_offset(hit[i].car_id);
+		sort(hit.begin(), hit.end(), [](const Car_Hit &a, const Car_Hit &b){ return a.dist<b.dist; });
+		ss.car.clear(); ss.node.clear(); ss.offset.clear();
+		for (int i = 0; i<hit.size(); i++)
+		{
+			ss.car.push_back(hit[i].car_id);
+			ss.node.push_back(hit[i].node_id);
+			ss.offset.push_back(Distance_Offset ? get_car_offset(hit[i].car_id) : 0);
+		}
+		ss.gap = INF;
+		if (hit.size()>ss.K)ss.gap = min(hit[ss.K].dist, ss.bound) - hit[ss.K - 1].dist;
+		else if (hit.size() == ss.K && ss.bound<INF)ss.gap = ss.bound - hit[ss.K - 1].dist;
+		if (hit.size()>ss.K)hit.resize(ss.K);
+		ss.result = hit;
+		return ss.result;
+	}
+	bool knn_session_check(Knn_Session &ss, int S, int n, int bound)//在前n个候选中求S的K近写入ss.result，第K近不超过bound(候选不足K时bound须为INF)则返回true
+	{
+		vector<pair<int, int> > out;
+		KNN(ss.c, S, ss.K, ss.node.data(), n, out, Distance_Offset ? ss.offset.data() : NULL);
+		if (bound<INF)
+		{
+			if (out.size()<ss.K)return false;
+			for (int i = 0; i<out.size(); i++)
+				if (out[i].second>bound)return false;
+		}
+		ss.result.clear();
+		for (int i = 0; i<out.size(); i++)
+		{
+			Car_Hit h = { ss.car[out[i].first], ss.node[out[i].first], out[i].second };
+			ss.result.push_back(h);
+		}
+		sort(ss.result.begin(), ss.result.end(), [](const Car_Hit &a, const Car_Hit &b){ return a.dist<b.dist; });
+		return true;
+	}
+	//常驻范围查询：watch_add时从S做半径R的Dijkstra，把查询挂到范围内各图结点所在的叶子(watch_in_leaf)，
+	//一批车辆更新只复核挂在更新所在叶子上的查询(search_catch以R剪枝)，一批内先进后出等抵消掉，事件由watch_poll成批取走
+	void watch_ball(int S, int R, vector<pair<int, int> > &out)//S出发距离小于R的图结点<结点,距离>
+	{
+		RadixHeap<int> q;
+		unordered_map<int, int> dist;
+		out.clear();
+		radix_clear(q);
+		radix_push(q, 0, S);
+		while (!radix_empty(q))
+		{
+			pair<unsigned, int> now = radix_pop(q);
+			if (dist.count(now.second))continue;
+			dist[now.second] = now.first;
+			out.push_back(make_pair(now.second, (int)now.first));
+			for (int i = G.head[now.second]; i<G.head[now.second + 1]; i++)
+				if ((long long)now.first + G.cost[i]<R && !dist.count(G.list[i]))radix_push(q, now.first + G.cost[i], G.list[i]);
+		}
+	}
+	int watch_add(int S, int R)//登记常驻范围查询，返回编号；此时已在范围内的车各产生一个进入事件
+	{
+		lock_guard<mutex> lock(car_write_lock);
+		if (watch_in_leaf.size() != node_tot + 1)watch_in_leaf.resize(node_tot + 1);
+		Range_Watch w;
+		w.S = S; w.R = R;
+		int id = watches.size();
+		vector<pair<int, int> > ball;
+		if (R>0)watch_ball(S, R, ball);
+		vector<int> leaves;
+		const Car_State &st = cars[car_front.load()];
+		for (int i = 0; i<ball.size(); i++)
+		{
+			leaves.push_back(id_in_node[ball[i].first]);
+			const vector<int> &v = st.car_in_node[ball[i].first];
+			for (int j = 0; j<v.size(); j++)
+				if (ball[i].second + (Distance_Offset ? st.offset(v[j]) : 0)<R)
 				{
-					Now_Catch_Dist = push_borders_up_catch_KNN_min_dist_car(Now_Catch_P);
-					Now_Catch_P = node[Now_Catch_P].father;
-					for (int i = 0; i<node[Now_Catch_P].borders.size(); i++)
-						q.push(make_pair(-(node[Now_Catch_P].catch_dist[i] + node[Now_Catch_P].min_car_dist[i].first), make_pair(Now_Catch_P, i)));
-					continue;
+					w.inside.insert(v[j]);
+					Watch_Event e = { id, v[j], 1 };
+					watch_pending.push_back(e);
 				}
-				int real_node_id = node[node_id].min_car_dist[border_id].second;
-
-				if (real_node_id == -1)break;
-				int car_id = car_in_node[real_node_id][0];
-				q.pop();
-				del_car(real_node_id, car_id);
-				q.push(make_pair(-(node[node_id].catch_dist[border_id] + node[node_id].min_car_dist[border_id].first), make_pair(node_id, border_id)));
-				int car_dist = get_car_offset(car_id) - real_Dist;
-				if (KNN_Dist.size()<K)KNN_Dist.push(car_dist);
-				else if (KNN_Dist.top()>car_dist)
+		}
+		sort(leaves.begin(), leaves.end());
+		leaves.erase(unique(leaves.begin(), leaves.end()), leaves.end());
+		for (int i = 0; i<leaves.size(); i++)watch_in_leaf[leaves[i]].push_back(id);
+		watches.push_back(w);
+		return id;
+	}
+	void watch_del(int id)//撤销常驻范围查询id(不产生事件)
+	{
+		lock_guard<mutex> lock(car_write_lock);
+		if (id<0 || id >= watches.size() || watches[id].R<0)return;
+		for (int x = 0; x<watch_in_leaf.size(); x++)
+		{
+			vector<int> &l = watch_in_leaf[x];
+			l.erase(remove(l.begin(), l.end(), id), l.end());
+		}
+		watches[id].R = -1;
+		watches[id].inside.clear();
+	}
+	void watch_poll(vector<Watch_Event> &out)//取走至今的进出事件，按车辆更新批的先后
+	{
+		lock_guard<mutex> lock(car_write_lock);
+		out.clear();
+		out.swap(watch_pending);
+	}
+	void car_watch(const Car_State &st, const vector<Car_Update> &batch)//一批更新后复核受影响的常驻查询(car_apply调用)
+	{
+		map<pair<int, int>, bool> was;//批中复核过的<查询,车>原来是否在范围内
+		for (int k = 0; k<batch.size(); k++)
+		{
+			const Car_Update &u = batch[k];
+			if (watch_car_node.size() <= u.car_id)watch_car_node.resize(u.car_id + 1, -1);
+			int node_id = u.type == CAR_OFFSET ? watch_car_node[u.car_id] : u.node_id;
+			if (u.type == CAR_ADD)watch_car_node[u.car_id] = u.node_id;
+			if (u.type == CAR_DEL)watch_car_node[u.car_id] = -1;
+			if (node_id<0 || watch_in_leaf.size() == 0)continue;
+			const vector<int> &l = watch_in_leaf[id_in_node[node_id]];
+			for (int i = 0; i<l.size(); i++)
+			{
+				Range_Watch &w = watches[l[i]];
+				bool in = w.inside.count(u.car_id)>0, now = false;
+				was.insert(make_pair(make_pair(l[i], u.car_id), in));
+				if (u.type != CAR_DEL)
 				{
-					KNN_Dist.pop();
-					KNN_Dist.push(car_dist);
+					int d = search_catch(watch_cache, w.S, node_id, w.R);
+					now = d<INF && d + (Distance_Offset ? st.offset(u.car_id) : 0)<w.R;
 				}
-				ans.push_back(car_id);
-				ans2.push_back(real_node_id);
-				ans3.push_back(car_dist);
+				if (now)w.inside.insert(u.car_id);
+				else w.inside.erase(u.car_id);
 			}
-			for (int i = 0; i<ans.size(); i++)add_car(ans2[i], ans[i]);
-			int j = 0;
-			for (int i = 0; i<ans.size(); i++)
-				if (ans3[i] <= KNN_Dist.top())
-					ans[j++] = ans[i];
-			while (ans.size()>K)ans.pop_back();
 		}
-		return ans;
+		for (map<pair<int, int>, bool>::iterator it = was.begin(); it != was.end(); it++)
+		{
+			int now = watches[it->first.first].inside.count(it->first.second)>0;
+			if (now == it->second)continue;
+			Watch_Event e = { it->first.first, it->first.second, now };
+			watch_pending.push_back(e);
+		}
 	}
 	bool check_min_car_dist(int x_ = -1)//检查x的min_car_dist是否DP成立
 	{
+		const Car_State &st = cars[car_front.load()];
 		for (int x = (x_ == -1 ? node_tot : x_ + 1) - 1; x >= (x_ == -1 ? root : x_); x--)
 		{
 			if (x == root)continue;
@@ -2289,26 +3599,26 @@ struct G_Tree
 			for (i = 0; i<node[x].borders.size(); i++)
 			{
 				ans = INF; int ans_id = -1, order = -1;
-				if (ans>node[node[x].son[node[x].color[node[x].border_id_innode[i]]]].min_car_dist[node[x].border_in_son[i]].first)
+				if (ans>st.min_car_dist[node[x].son[node[x].color[node[x].border_id_innode[i]]]][node[x].border_in_son[i]].first)
 				{
-					ans = node[node[x].son[node[x].color[node[x].border_id_innode[i]]]].min_car_dist[node[x].border_in_son[i]].first;
-					ans_id = node[node[x].son[node[x].color[node[x].border_id_innode[i]]]].min_car_dist[node[x].border_in_son[i]].second;
+					ans = st.min_car_dist[node[x].son[node[x].color[node[x].border_id_innode[i]]]][node[x].border_in_son[i]].first;
+					ans_id = st.min_car_dist[node[x].son[node[x].color[node[x].border_id_innode[i]]]][node[x].border_in_son[i]].second;
 					order = -2;
 				}
 				for (j = 0; j<node[x].borders.size(); j++)
 					if (j != i)
 					{
-						if (ans>node[x].min_car_dist[j].first + node[x].dist.a[i][j])
+						if (ans>st.min_car_dist[x][j].first + node[x].dist.a[i][j])
 						{
-							ans = node[x].min_car_dist[j].first + node[x].dist.a[i][j];
-							ans_id = node[x].min_car_dist[j].second;
+							ans = st.min_car_dist[x][j].first + node[x].dist.a[i][j];
+							ans_id = st.min_car_dist[x][j].second;
 							order = j;
 						}
 					}
 
-				if (ans != node[x].min_car_dist[i].first/*||ans_id!=node[x].min_car_dist[i].second*/)
+				if (ans != st.min_car_dist[x][i].first/*||ans_id!=st.min_car_dist[x][i].second*/)
 				{
-					printf("x=%d i=%d ans=%d ans_id=%d min=%d min_id=%d order=%d\n", x, i, ans, ans_id, node[x].min_car_dist[i].first, node[x].min_car_dist[i].second, order);
+					printf("x=%d i=%d ans=%d ans_id=%d min=%d min_id=%d order=%d\n", x, i, ans, ans_id, st.min_car_dist[x][i].first, st.min_car_dist[x][i].second, order);
 					printf("node[x].son[node[x].color[node[x].border_id_innode[i]]]=%d node[x].border_in_son[i]=%d\n", node[x].son[node[x].color[node[x].border_id_innode[i]]], node[x].border_in_son[i]);
 					return false;
 				}
@@ -2317,7 +3627,33 @@ struct G_Tree
 		return true;
 	}
 }tree;
-struct Wide_KNN_//增量法计算KNN，返回最近邻的K个点在增量序列中的编号，查询前通过init(S,K)初始化，增量时调用update(vector<pair<double,int> > a)传入欧几里得距离/编号二元组，若增量成功返回true，此时可用result()得到结果
+Query_Cache Cache;//单线程调用者(Wide_KNN、车辆调度)共用的查询缓存
+struct G_Tree_Engine:Engine//tree的通用引擎接口(../common/engine.h)，每个线程一个，各用自己的Query_Cache
+{
+	Query_Cache c;
+	const char* name(){return "gptree";}
+	int distance(int s,int t){return tree.search(s,t);}
+	bool path(int s,int t,vector<int> &route,int &dist)
+	{
+		dist=tree.find_path(c,s,t,route);
+		return Keep_Order;
+	}
+	void one_to_many(int s,const vector<int> &targets,vector<int> &out)
+	{
+		out=tree.distance_matrix(vector<int>(1,s),targets)[0];
+	}
+	void knn(int s,int k,vector<pair<int,int> > &out)
+	{
+		tree.KNN(c,s,k,objects.data(),objects.size(),out);
+		engine_sort(out,k);
+	}
+	void range(int s,int r,vector<pair<int,int> > &out)
+	{
+		tree.Range(c,s,r,objects.data(),objects.size(),out);
+		engine_sort(out,out.size());
+	}
+};
+struct Wide_KNN_//增量法计算KNN，返回最近邻的K个点在增量序列中的编号，查询前通过init(S,K)初始化，增量时调用update(vector<pair<double,int> > a)传入欧几里得距离/编号二元组，若增量成功返回true，此时可用result()得到结果；或由update(PlanarGrid)从空间索引按需取候选，一次完成
 {
 	int S,K,bound,dist_now,tot;
 	priority_queue<pair<int,int> >KNN;
@@ -2330,20 +3666,22 @@ struct Wide_KNN_//增量法计算KNN，返回最近邻的K个点在增量序列
 		while(KNN.size())KNN.pop();
 		re.clear();
 	}
-	bool update(vector<pair<double,pair<int,int> > > a)//<欧几里得距离,<结点编号，结点距离偏移>>
+	bool update(vector<pair<double,pair<int,int> > > a)//<欧几里得距离,<结点编号，结点距离偏移>>，按欧几里得距离从小到大计算，结果编号为a在增量序列中原来的位置
 	{
-		sort(a.begin(),a.end());
-		for(int i=0;i<a.size();i++)
+		vector<pair<double,int> >p(a.size());
+		for(int i=0;i<a.size();i++)p[i]=make_pair(a[i].first,i);
+		sort(p.begin(),p.end());
+		for(int j=0;j<p.size();j++)
 		{
+			int i=p[j].second;
 			bound=KNN.size()<K?INF:KNN.top().first;
-			dist_now=tree.search_catch(S,a[i].second.first,bound)+a[i].second.second;
-			if(KNN.size()<K)KNN.push(make_pair(dist_now,tot));
+			dist_now=tree.search_catch(Cache,S,a[i].second.first,bound)+a[i].second.second;
+			if(KNN.size()<K)KNN.push(make_pair(dist_now,tot+i));
 				else if(dist_now<KNN.top().first)
 				{
 					KNN.pop();
-					KNN.push(make_pair(dist_now,tot));
+					KNN.push(make_pair(dist_now,tot+i));
 				}
-			tot++;
 			Real_Dist=bound;
 			Euclid=a[i].first;
 			if(Real_Dist<Euclid)
@@ -2352,8 +3690,42 @@ struct Wide_KNN_//增量法计算KNN，返回最近邻的K个点在增量序列
 				return true; 
 			}
 		}
+		tot+=a.size();
 		return false;
 	}
+	bool update(const vector<pair<int,int> > &a)//<结点编号，结点距离偏移>，欧几里得距离由Coordinate成批算出(无坐标时为0，即不剪枝)
+	{
+		vector<int>id(a.size());
+		vector<float>e(a.size());
+		for(int i=0;i<a.size();i++)id[i]=a[i].first;
+		planar_bounds(Coordinate,S,id.data(),id.size(),e.data());
+		vector<pair<double,pair<int,int> > >b(a.size());
+		for(int i=0;i<a.size();i++)b[i]=make_pair((double)e[i]+a[i].second,a[i]);
+		return update(b);
+	}
+	bool update(const PlanarGrid &g, const int *offset = NULL)//从空间索引g(planar_grid_build)按直线距离从小到大逐个取候选，offset为各候选的距离偏移(可空)，每个的search_catch以当前第K小为界，第K小不超过下一个的直线下界或取完即止；结果为g建立时的编号，返回是否找够K个
+	{
+		PlanarCursor cur;
+		planar_cursor_init(cur, g, Coordinate, S);
+		int i;
+		float e;
+		while (planar_cursor_next(cur, i, e))
+		{
+			if (KNN.size() == K && KNN.top().first <= e)break;
+			bound = KNN.size()<K ? INF : KNN.top().first;
+			dist_now = tree.search_catch(Cache, S, g.vertex[i], bound);
+			if (dist_now<INF && offset != NULL)dist_now += offset[i];
+			if (KNN.size()<K)KNN.push(make_pair(dist_now, i));
+			else if (dist_now<KNN.top().first)
+			{
+				KNN.pop();
+				KNN.push(make_pair(dist_now, i));
+			}
+		}
+		bool full = KNN.size() == K;
+		while (KNN.size()){ re.push_back(KNN.top().second); KNN.pop(); }
+		return full;
+	}
 	vector<int> result()
 	{
 		return re;
@@ -2383,103 +3755,214 @@ void read()
 		if(RevE==false)G.add_D(j-1,k-1,l);//单向边
 		else G.add(j-1,k-1,l);//双向边
 	}
+	G.build_csr();
 	cout<<"correct4"<<endl;
 	fclose(in);
 	if(Optimization_Euclidean_Cut)
 	{
 		in=fopen(Node_File,"r");
-		cout<<"correct1"<<endl;
-		cout<<"correct2"<<endl;
-		cout<<"correct3"<<endl;
-		double d1,d2;
-		for(i=0;i<G.n;i++)//读取边
+		vector<double>lon(G.n),lat(G.n);
+		for(i=0;in!=NULL&&i<G.n;i++)
+			if(fscanf(in,"%d %lf %lf\n",&j,&lon[i],&lat[i])!=3)break;
+		if(in!=NULL)fclose(in);
+		//按G的每条边标定投影坐标的比例
+		vector<int>u,v,w;
+		for(j=0;j<G.n;j++)
+			for(k=G.head[j];k<G.head[j+1];k++){u.push_back(j);v.push_back(G.list[k]);w.push_back(G.cost[k]);}
+		if(i<G.n||!planar_build(Coordinate,G.n,&lon[0],&lat[0],u.size(),u.data(),v.data(),w.data()))
 		{
-			//int temp;
-			fscanf(in,"%d %lf %lf\n",&j,&d1,&d2);
-			coordinate.push_back(coor(d1,d2));
+			printf("NO COORDINATES IN %s, EUCLIDEAN CUT OFF\n",Node_File);
+			Optimization_Euclidean_Cut=false;
 		}
-		cout<<"correct4"<<endl;
-		fclose(in);
-		printf("read over\n");
+		else printf("read coordinates, scale %g\n",Coordinate.scale);
 	}
 }
-void save()
+const char* Tree_File="GP_Tree.data";//索引文件
+//索引文件格式：文件头Tree_File_Header，之后依次为三节(图G、树的全局信息、全部结点)，
+//每节从Tree_File_Header.offset[i]开始共bytes[i]字节，读取时各节独立校验边界
+#define TREE_FILE_MAGIC 0x42545047 //"GPTB"
+#define TREE_FILE_VERSION 7
+#define TREE_FILE_ENDIAN 0x01020304
+enum{TREE_SECTION_GRAPH=0,TREE_SECTION_TREE,TREE_SECTION_NODES,TREE_SECTION_COUNT};
+struct Tree_File_Header
+{
+	int magic,version,endian,section_count;
+	long long offset[TREE_SECTION_COUNT],bytes[TREE_SECTION_COUNT];
+};
+bool save()//先写到Tree_File.tmp再改名，中途失败不会破坏已有索引
 {
 	printf("begin save\n");
-	freopen("GP_Tree.data","w",stdout);
-	tree.save();
-	freopen("/dev/tty","w",stdout);
+	string tmp=string(Tree_File)+".tmp";
+	Bin_Writer w;
+	w.out=fopen(tmp.c_str(),"wb");
+	if(w.out==NULL){printf("CANNOT WRITE %s\n",tmp.c_str());return false;}
+	w.pos=0;w.ok=true;
+	Tree_File_Header h;
+	memset(&h,0,sizeof(h));
+	h.magic=TREE_FILE_MAGIC;h.version=TREE_FILE_VERSION;h.endian=TREE_FILE_ENDIAN;h.section_count=TREE_SECTION_COUNT;
+	w.put(&h,sizeof(h));//占位，各节写完后回填
+	for(int i=0;i<TREE_SECTION_COUNT;i++)
+	{
+		h.offset[i]=w.pos;
+		if(i==TREE_SECTION_GRAPH)G.save(w);
+		else if(i==TREE_SECTION_TREE)tree.save(w);
+		else tree.save_nodes(w);
+		h.bytes[i]=w.pos-h.offset[i];
+	}
+	if(fseek(w.out,0,SEEK_SET)!=0||fwrite(&h,sizeof(h),1,w.out)!=1)w.ok=false;
+	if(fclose(w.out)!=0)w.ok=false;
+	if(!w.ok||rename(tmp.c_str(),Tree_File)!=0)
+	{
+		printf("CANNOT WRITE %s\n",Tree_File);
+		remove(tmp.c_str());
+		return false;
+	}
 	printf("save_over\n");
+	return true;
 }
-void load()
+bool load()//mmap整个文件，各节按游标直接拷贝
 {
-	freopen("GP_Tree.data","r",stdin);
-	tree.load();
-	freopen("/dev/tty","r",stdin);
-} 
+	int fd=open(Tree_File,O_RDONLY);
+	if(fd<0){printf("CANNOT OPEN %s\n",Tree_File);return false;}
+	struct stat st;
+	if(fstat(fd,&st)!=0||st.st_size<(off_t)sizeof(Tree_File_Header)){close(fd);printf("BAD INDEX FILE %s\n",Tree_File);return false;}
+	void *map=mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+	close(fd);
+	if(map==MAP_FAILED){printf("CANNOT MAP %s\n",Tree_File);return false;}
+	madvise(map,st.st_size,MADV_SEQUENTIAL);
+	const char *base=(const char*)map;
+	const Tree_File_Header *h=(const Tree_File_Header*)base;
+	bool ok=h->magic==TREE_FILE_MAGIC&&h->version==TREE_FILE_VERSION&&h->endian==TREE_FILE_ENDIAN&&h->section_count==TREE_SECTION_COUNT;
+	for(int i=0;ok&&i<TREE_SECTION_COUNT;i++)
+	{
+		if(h->offset[i]<0||h->bytes[i]<0||h->offset[i]+h->bytes[i]>st.st_size){ok=false;break;}
+		Bin_Reader r;
+		r.p=base+h->offset[i];r.end=r.p+h->bytes[i];r.ok=true;
+		if(i==TREE_SECTION_GRAPH)G.load(r);
+		else if(i==TREE_SECTION_TREE)tree.load(r);
+		else tree.load_nodes(r);
+		ok=r.ok;
+	}
+	munmap(map,st.st_size);
+	if(!ok)printf("BAD INDEX FILE %s(TRUNCATED, OR NOT WRITTEN BY THIS VERSION)\n",Tree_File);
+	return ok;
+}
 
 class Global_Scheduling//依托于G_Tree的全局调度算法，主要处理拼车的哈密顿路径规划
 {
 	public:
-		void init(int n,double (*ED)(int,int))//初始化车辆集合0~n-1，传入一个计算(node_id1,node_id2)欧几里得距离的函数
+		void init(int n,double (*ED)(int,int)=Euclidean_Dist,int threads_=1)//初始化车辆集合0~n-1，传入一个计算(node_id1,node_id2)欧几里得距离的函数(须不超过路网距离)，threads_为规划线程数
 		{
 			vehicle empty;
 			for(int i=0;i<n;i++)cars.push_back(empty);
 			Euclidean_Distance=ED;
+			threads=threads_<1?1:threads_;
+			caches.resize(threads);
 		}
 		void set(int car_id,int pos,int offset=0)//设置第id辆车新的结点位置和偏移距离
 		{
 			cars[car_id].set(pos,offset);
 		}
-		int request(pair<int,int> OD,vector<int> car_set)//规划新的OD请求应归于哪辆集合car_set中的车比较合适，并将其规划如车的路线中，并返回车的ID
+		int request(pair<int,int> OD,vector<int> car_set)//规划新的OD请求应归于哪辆集合car_set中的车比较合适，并将其规划如车的路线中，并返回车的ID(car_set为空返回-1)
 		{
-			int i,best_car_id=-1,n=car_set.size();
+			int best_car_id=-1,n=car_set.size();
 			long long value=(long long)INF*INF;
-			//欧几里得规划裁剪
-			{
-				vector<pair<int,int> >ans;//<欧几里得规划函数评估值,在car_set中的下标>
-				for(int i=0;i<n;i++)cars[car_set[i]].push(OD.first,1);
-				for(int i=0;i<n;i++)cars[car_set[i]].push(OD.second,1);
-				for(int i=0;i<n;i++)
+			//欧几里得下界裁剪：新OD点到各点用直线距离(不超过路网距离)精确规划得到路线长度的下界，
+			//按下界从小到大成批真实规划，下界达到当前最优即停止(插入法规划的车不是下界，取0)
+			vector<pair<long long,int> >ans(n);//<路线长度下界,car_id>
+			parallel_for(threads,n,[&](int worker,int i){
+				vehicle &car=cars[car_set[i]];
+				long long lower=0;
+				int m=2;
+				for(int j=0;j<car.ODlist.size();j++)m+=car.ODlist[j]!=-1;
+				if(Optimization_Euclidean_Cut&&Euclidean_Distance!=NULL&&m<=Scheduling_Exact_Points)
 				{
+					car.push(OD.first,1);
+					car.push(OD.second,1);
 					vector<int>order;
-					ans.push_back(make_pair(cars[car_set[i]].solve_value(order),car_set[i]));
-
+					lower=car.solve_exact(order);
+					car.pop(car.ODlist.size()-1);
+					car.pop(car.ODlist.size()-1);
 				}
-				for(int i=0;i<n;i++)
+				ans[i]=make_pair(lower,car_set[i]);
+			});
+			sort(ans.begin(),ans.end());
+			if(ans.size()>Global_Scheduling_Cars_Per_Request)ans.resize(Global_Scheduling_Cars_Per_Request);
+
+			//真实规划：各车互不相关，每个线程用自己的查询缓存
+			vector<int>tried;//已加入OD并规划过的车
+			vector<int>best_order;
+			for(int done=0;done<ans.size()&&ans[done].first<value;)
+			{
+				vector<int>now_set;
+				for(;done<ans.size()&&now_set.size()<threads&&ans[done].first<value;done++)now_set.push_back(ans[done].second);
+				vector<long long>now(now_set.size());
+				vector<vector<int> >order(now_set.size());
+				parallel_for(threads,now_set.size(),[&](int worker,int i){
+					vehicle &car=cars[now_set[i]];
+					car.push(OD.first,0,caches[worker]);
+					car.push(OD.second,0,caches[worker]);
+					now[i]=car.solve_value(order[i]);
+				});
+				for(int i=0;i<now_set.size();i++)
 				{
-					cars[car_set[i]].pop(cars[car_set[i]].ODlist.size()-1);
-					cars[car_set[i]].pop(cars[car_set[i]].ODlist.size()-1);
+					tried.push_back(now_set[i]);
+					if(now[i]<value){value=now[i];best_car_id=now_set[i];best_order=order[i];}
 				}
-				sort(ans.begin(),ans.end());
-				//根据距离保留前K个
-				vector<int> new_set;
-				for(int i=0;i<Global_Scheduling_Cars_Per_Request&&i<ans.size();i++)
-					new_set.push_back(ans[i].second);
-				car_set=new_set;
 			}
-
-			//真实规划
-			for(int i=0;i<n;i++)cars[car_set[i]].push(OD.first);
-			for(int i=0;i<n;i++)cars[car_set[i]].push(OD.second);
-			for(int i=0;i<n;i++)
-			{
-				vector<int>order;
-				long long now=cars[car_set[i]].solve_value(order);
-				if(now<value)
+			for(int i=0;i<tried.size();i++)
+				if(tried[i]!=best_car_id)
+				{
+					cars[tried[i]].pop(cars[tried[i]].ODlist.size()-1);
+					cars[tried[i]].pop(cars[tried[i]].ODlist.size()-1);
+				}
+			if(best_car_id!=-1)cars[best_car_id].LastOrderList=best_order;
+			return best_car_id;
+		}
+		int request(pair<int,int> OD)//同request，候选车取自G_Tree的车辆集合(车须已用tree.add_car(位置,车编号)登记，编号即cars下标)，无车返回-1
+		{
+			//车c的新路线先到O再到D，长度不小于d(c,O)+d(O,D)：按d(c,O)从小到大成批取车(car_nearest)，
+			//只规划下界小于当前最优的车，下界达到当前最优即停止，不再扫描整个车队
+			long long value=(long long)INF*INF;
+			int best_car_id=-1,od=tree.search(OD.first,OD.second);
+			vector<int>tried;//已加入OD并规划过的车
+			std::set<int>seen;
+			vector<int>best_order;
+			vector<Car_Hit>hit;
+			for(int M=8,done=0;;M*=2)
+			{
+				tree.car_nearest(caches[0],OD.first,M,hit);
+				vector<int>now_set;
+				bool stop=false;
+				for(int i=done;i<hit.size();i++)
 				{
-					value=now;
-					best_car_id=i;
+					if((long long)hit[i].dist+od>=value){stop=true;break;}
+					if(hit[i].car_id<cars.size()&&seen.insert(hit[i].car_id).second)now_set.push_back(hit[i].car_id);
 				}
+				vector<long long>now(now_set.size());
+				vector<vector<int> >order(now_set.size());
+				parallel_for(threads,now_set.size(),[&](int worker,int i){
+					vehicle &car=cars[now_set[i]];
+					car.push(OD.first,0,caches[worker]);
+					car.push(OD.second,0,caches[worker]);
+					now[i]=car.solve_value(order[i]);
+				});
+				for(int i=0;i<now_set.size();i++)
+				{
+					tried.push_back(now_set[i]);
+					if(now[i]<value){value=now[i];best_car_id=now_set[i];best_order=order[i];}
+				}
+				if(stop||hit.size()<M)break;
+				done=hit.size();
 			}
-			for(int i=0;i<n;i++)
-				if(i!=best_car_id)
+			for(int i=0;i<tried.size();i++)
+				if(tried[i]!=best_car_id)
 				{
-					cars[car_set[i]].pop(cars[car_set[i]].ODlist.size()-1);
-					cars[car_set[i]].pop(cars[car_set[i]].ODlist.size()-1);
+					cars[tried[i]].pop(cars[tried[i]].ODlist.size()-1);
+					cars[tried[i]].pop(cars[tried[i]].ODlist.size()-1);
 				}
-				else cars[car_set[i]].solve_value(cars[car_set[i]].LastOrderList);
-			return car_set[best_car_id];
+			if(best_car_id!=-1)cars[best_car_id].LastOrderList=best_order;
+			return best_car_id;
 		}
 		void del(int car_id,int node_id)
 		{
@@ -2524,7 +4007,7 @@ class Global_Scheduling//依托于G_Tree的全局调度算法，主要处理拼
 			for(int i=0;i<Point.size();i++)
 			{
 				vector<int>path_now;
-				tree.find_path(Point[i],Point[i+1],path_now);
+				tree.find_path(Cache,Point[i],Point[i+1],path_now);
 				re+=tree.search(Point[i],Point[i+1]);
 				for(int j=1;j<path_now.size();j++)
 					path.push_back(path_now[j]);
@@ -2567,7 +4050,7 @@ class Global_Scheduling//依托于G_Tree的全局调度算法，主要处理拼
 			int position,offset;//车所在结点编号，车距离结点的偏移距离
 			vector<int>pos_to_ODlist;//车当前所在节点距离ODlist中每个结点的距离
 			vector<int>LastOrderList;//上一次路径规划的最优路线方案在ODlist中的下标
-			void push(int id,int type=0)//向ODlist后加入一个新点id并重做dist;type==0表示使用路网距离，type=1表示使用欧几里得距离Euclidean_Distance
+			void push(int id,int type=0,Query_Cache &c=Cache)//向ODlist后加入一个新点id并重做dist;type==0表示使用路网距离，type=1表示使用欧几里得距离Euclidean_Distance
 			{
 				ODlist.push_back(id);
 				Matrix re;
@@ -2576,14 +4059,18 @@ class Global_Scheduling//依托于G_Tree的全局调度算法，主要处理拼
 					for(int j=0;j<re.n-1;j++)
 						re.a[i][j]=dist.a[i][j];
 				for(int i=0;i<re.n;i++)
-					if(type==0)re.a[i][re.n-1]=re.a[re.n-1][i]=tree.search_catch(id,ODlist[i]);
+					if(type==0)re.a[i][re.n-1]=re.a[re.n-1][i]=tree.search_catch(c,id,ODlist[i]);
 					else re.a[i][re.n-1]=re.a[re.n-1][i]=Euclidean_Distance(id,ODlist[i]);
-				if(type==0)pos_to_ODlist.push_back(tree.search_catch(id,position));
+				if(type==0)pos_to_ODlist.push_back(tree.search_catch(c,id,position));
 				else pos_to_ODlist.push_back(Euclidean_Distance(id,position));
 				dist=re;
 			}
-			void pop(int id=0)//删除ODlist中第id号元素
+			void pop(int id=0)//删除ODlist中第id号元素(LastOrderList中去掉它，其后的下标前移)
 			{
+				int k=0;
+				for(int i=0;i<LastOrderList.size();i++)
+					if(LastOrderList[i]!=id)LastOrderList[k++]=LastOrderList[i]-(LastOrderList[i]>id);
+				LastOrderList.resize(k);
 				Matrix re;
 				re.init(dist.n-1);
 				for(int i=0;i<re.n-1;i++)
@@ -2604,7 +4091,7 @@ class Global_Scheduling//依托于G_Tree的全局调度算法，主要处理拼
 				position=pos;
 				offset=offset_;
 				for(int i=0;i<ODlist.size();i++)
-					pos_to_ODlist[i]=tree.search_catch(position,ODlist[i],INF);
+					pos_to_ODlist[i]=tree.search_catch(Cache,position,ODlist[i],INF);
 			}
 			int evaluation(int n,int *p)
 			{
@@ -2616,49 +4103,328 @@ class Global_Scheduling//依托于G_Tree的全局调度算法，主要处理拼
 			}
 			long long solve_value(vector<int> &order)//根据现有的ODlist规划方案，并返回行车路线长度，并将结果向量记录到&order里
 			{
-				long long ans=1000000000LL*1000000000LL,now;
-				int n=ODlist.size(),i,j;
-				int *p;//permutation
-				p=new int[n];
-				vector<int>re;
-				for(i=0;i<n;i++)p[i]=i;
-				while(1)
-				{
-					bool pd=true;
-					for(i=0;pd&&i<n;i++)
-						if(p[i]&1)
-						{
-							pd=false;
-							for(j=0;!pd&&j<i;j++)
-								if(p[j]==p[i]-1)pd=true;
-						}
-					if(pd)
+				//需停靠的点(O点已到达的为-1，不停靠)不超过Scheduling_Exact_Points个时状压DP精确求解，
+				//否则在LastOrderList(上次的方案)中按最小增量逐对插入新的OD点
+				int n=ODlist.size(),m=0;
+				for(int i=0;i<n;i++)m+=ODlist[i]!=-1;
+				if(m<=Scheduling_Exact_Points)return solve_exact(order);
+				return solve_insert(order);
+			}
+			long long route_value(const vector<int> &stop)//按stop顺序停靠的路线长度
+			{
+				if(stop.size()==0)return 0;
+				long long re=pos_to_ODlist[stop[0]]+offset;
+				for(int i=0;i+1<stop.size();i++)re+=dist.a[stop[i]][stop[i+1]];
+				return re;
+			}
+			void route_order(const vector<int> &stop,vector<int> &order)//停靠顺序补上不停靠的点(放在最前)即为方案
+			{
+				order.clear();
+				for(int i=0;i<ODlist.size();i++)
+					if(ODlist[i]==-1)order.push_back(i);
+				order.insert(order.end(),stop.begin(),stop.end());
+			}
+			long long solve_exact(vector<int> &order)//状压DP：f[S][i]为停靠完集合S且最后在i的最短路线，D点须在其O点之后(O点为-1时已上车)
+			{
+				vector<int>id;//第k个需停靠的点在ODlist中的下标
+				vector<int>bit(ODlist.size(),-1);
+				for(int i=0;i<ODlist.size();i++)
+					if(ODlist[i]!=-1){bit[i]=id.size();id.push_back(i);}
+				int m=id.size(),full=(1<<m)-1;
+				vector<int>stop;
+				if(m==0){route_order(stop,order);return 0;}
+				const long long NONE=(long long)INF*INF;
+				vector<long long>f((long long)(full+1)*m,NONE);
+				vector<int>from((long long)(full+1)*m,-1);
+				for(int k=0;k<m;k++)
+					if(!(id[k]&1)||bit[id[k]-1]==-1)f[(long long)(1<<k)*m+k]=pos_to_ODlist[id[k]]+offset;
+				for(int S=1;S<=full;S++)
+					for(int k=0;k<m;k++)
 					{
-						for(i=0;ODlist[p[i]]==-1;i++);
-						now=pos_to_ODlist[p[i]]+offset;
-						for(;i<n-1;i=j)
-						{
-							for(j=i+1;j<n&&ODlist[p[j]]==-1;j++);
-							if(j<n)now+=dist.a[p[i]][p[j]];
-						}
-						if(now<ans)
+						long long now=f[(long long)S*m+k];
+						if(now==NONE)continue;
+						for(int t=0;t<m;t++)
 						{
-							ans=now;
-							re.clear();
-							for(i=0;i<n;i++)re.push_back(p[i]);
+							if(S>>t&1)continue;
+							if((id[t]&1)&&bit[id[t]-1]!=-1&&!(S>>bit[id[t]-1]&1))continue;
+							long long &g=f[(long long)(S|1<<t)*m+t];
+							if(g>now+dist.a[id[k]][id[t]]){g=now+dist.a[id[k]][id[t]];from[(long long)(S|1<<t)*m+t]=k;}
 						}
 					}
-					if(next_permutation(p,p+n)==0)break;
+				int last=0;
+				for(int k=1;k<m;k++)
+					if(f[(long long)full*m+k]<f[(long long)full*m+last])last=k;
+				long long ans=f[(long long)full*m+last];
+				for(int S=full,k=last;k!=-1;)
+				{
+					stop.push_back(id[k]);
+					int p=from[(long long)S*m+k];
+					S^=1<<k;
+					k=p;
 				}
-				order=re;
+				reverse(stop.begin(),stop.end());
+				route_order(stop,order);
 				return ans;
 			}
+			long long solve_insert(vector<int> &order)//LastOrderList中仍需停靠的点保持原顺序，其余的OD点逐对插到增量最小的位置(O在D前)
+			{
+				vector<char>in(ODlist.size(),0);
+				vector<int>stop;
+				for(int i=0;i<LastOrderList.size();i++)
+				{
+					int x=LastOrderList[i];
+					if(x<ODlist.size()&&ODlist[x]!=-1&&!in[x]){in[x]=1;stop.push_back(x);}
+				}
+				for(int i=0;i<ODlist.size();i+=2)
+				{
+					bool need_o=ODlist[i]!=-1;
+					if(in[i+1]&&(!need_o||in[i]))continue;
+					for(int k=i;k<=i+1;k++)//只排入了一半的OD对整对重插
+						if(in[k]){stop.erase(find(stop.begin(),stop.end(),k));in[k]=0;}
+					insert_pair(stop,need_o?i:-1,i+1);
+					in[i]=need_o;in[i+1]=1;
+				}
+				route_order(stop,order);
+				return route_value(stop);
+			}
+			long long leg(int x,int y)//stop中x到y的路段长度，x==-1为车的位置，y==-1为终点
+			{
+				if(y==-1)return 0;
+				return x==-1?pos_to_ODlist[y]+offset:dist.a[x][y];
+			}
+			void insert_pair(vector<int> &stop,int o,int d)//把o(可为-1，O点已上车)与d插入stop中增量最小的位置，o在d前：O(stop^2)
+			{
+				int L=stop.size(),bi=0,bj=0;
+				long long best=(long long)INF*INF;
+				//在第i个空隙插入x的增量(空隙i在stop[i-1]与stop[i]之间)
+				auto gap=[&](int i,int x){int a=i?stop[i-1]:-1,b=i<L?stop[i]:-1;return leg(a,x)+leg(x,b)-leg(a,b);};
+				vector<long long>cost_o(L+1);
+				for(int i=0;i<=L;i++)cost_o[i]=o==-1?0:gap(i,o);
+				long long best_o=(long long)INF*INF;int arg_o=0;//空隙i之前插o的最小增量(o可在d之前任意空隙)
+				for(int j=0;j<=L;j++)
+				{
+					if(o!=-1)//o与d同在空隙j
+					{
+						int a=j?stop[j-1]:-1,b=j<L?stop[j]:-1;
+						long long now=leg(a,o)+dist.a[o][d]+leg(d,b)-leg(a,b);
+						if(now<best){best=now;bi=bj=j;}
+					}
+					if(o==-1||j>0)//o在更前的空隙(或已上车)，d在空隙j
+					{
+						long long now=(o==-1?0:best_o)+gap(j,d);
+						if(now<best){best=now;bi=o==-1?-1:arg_o;bj=j;}
+					}
+					if(o!=-1&&cost_o[j]<best_o){best_o=cost_o[j];arg_o=j;}
+				}
+				stop.insert(stop.begin()+bj,d);
+				if(o!=-1)stop.insert(stop.begin()+bi,o);
+			}
 		};
 		vector<vehicle>cars;
+		int threads;//request中各候选车并行规划的线程数
+		vector<Query_Cache>caches;//每个线程的查询缓存
 }scheduling;
+double (*Global_Scheduling::Euclidean_Distance)(int,int)=NULL;
 
-int main()
+void graph_csr(vector<long long> &offset,vector<int> &target,vector<int> &weight)//G的CSR形式(v的边在[offset[v],offset[v+1]))，供common/下的引擎
 {
+	offset.assign(G.head.begin(),G.head.end());
+	target=G.list;
+	weight=G.cost;
+}
+void density_tree(DensityTree &t)//tree的结点层次(结点x记为x-1，根的父亲-1)，供planner统计各结点的object密度
+{
+	vector<int> leaf(G.n),parent(tree.node_tot);
+	for(int x=1;x<=tree.node_tot;x++)parent[x-1]=x==tree.root?-1:tree.node[x].father-1;
+	for(int v=0;v<G.n;v++)leaf[v]=(tree.id_in_node[v]>0?tree.id_in_node[v]:tree.root)-1;
+	density_init(t,leaf,parent);
+}
+HubLabel Hub;//可选的2-hop标签(-H)，与tree.search接口相同：hub_query(Hub,S,T)
+bool hub_labels(const char* file)//读取file中的标签，不存在或不匹配则按tree的border层次定序构建并保存
+{
+	if(hub_load(Hub,file,G.n))
+	{
+		printf("hub labels loaded: %lld entries\n",(long long)Hub.hub.size());
+		return true;
+	}
+	vector<long long> offset;
+	vector<int> target,weight;
+	graph_csr(offset,target,weight);
+	TIME_TICK_START
+	hub_build(Hub,G.n,offset.data(),target.data(),weight.data(),tree.hub_order(),Build_Threads);
+	TIME_TICK_END
+	TIME_TICK_PRINT("hub_build")
+	printf("hub labels: %lld entries(%.1f per vertex)\n",(long long)Hub.hub.size(),(double)Hub.hub.size()/G.n);
+	if(!hub_save(Hub,file))
+	{
+		printf("CANNOT WRITE %s\n",file);
+		return false;
+	}
+	return true;
+}
+
+void landmarks(int k)//选k个地标并算出距离表(Build_Threads个线程)，再汇总到tree的各结点
+{
+	vector<long long> offset;
+	vector<int> target,weight;
+	graph_csr(offset,target,weight);
+	TIME_TICK_START
+	landmark_build(Landmark,G.n,offset.data(),target.data(),weight.data(),k,Build_Threads);
+	tree.landmark_fit();
+	TIME_TICK_END
+	TIME_TICK_PRINT("landmark_build")
+	printf("landmarks: %d(%s)\n",Landmark.k,Landmark.to.empty()?"symmetric":"directed");
+}
+
+//基准测试(../bench/bench.sh)：object文件每行"vid oid"，query文件每行"locid K"
+//每个查询输出"ID=vid DIS=距离"(按距离排序)和计时行，格式同gtree_query；距离在计时之外用search求出
+//plan_file非空时每个线程的查询经PlannerEngine(../common/planner.h)在G_Tree_Engine与ExpandEngine(局部网络扩展)间按object密度选择，
+//代价模型从plan_file读取，不存在或不匹配则用查询文件中的样本校准后写入
+#define PLANNER_SAMPLE 200 //校准用的查询数(均匀取自查询文件)
+void knn_bench(const char* object_file,const char* query_file,const char* stats_file,int threads,const char* plan_file=NULL)//threads个线程共享tree，每个线程一个G_Tree_Engine(各有Query_Cache)，按查询顺序输出
+{
+	vector<int> T;
+	FILE *in=fopen(object_file,"r");
+	if(in==NULL){printf("CANNOT OPEN %s\n",object_file);exit(1);}
+	int v,oid,S,K;
+	while(fscanf(in,"%d %d",&v,&oid)==2)T.push_back(v);
+	fclose(in);
+	in=fopen(query_file,"r");
+	if(in==NULL){printf("CANNOT OPEN %s\n",query_file);exit(1);}
+	vector<pair<int,int> > query;
+	while(fscanf(in,"%d %d",&S,&K)==2)query.push_back(make_pair(S,K));
+	fclose(in);
+	const char* const phase_names[1]={"total"};
+	if(threads<1)threads=1;
+	vector<G_Tree_Engine> engines(threads);
+	vector<Engine*> run(threads);
+	vector<long long> offset;
+	vector<int> target,weight;
+	vector<ExpandEngine> expand;
+	vector<PlannerEngine> planners;
+	if(plan_file!=NULL)
+	{
+		graph_csr(offset,target,weight);
+		DensityTree dt;
+		density_tree(dt);
+		expand.assign(threads,ExpandEngine(G.n,offset.data(),target.data(),weight.data()));
+		for(int i=0;i<threads;i++)
+		{
+			vector<Engine*> e(1,&engines[i]);
+			e.push_back(&expand[i]);
+			planners.push_back(PlannerEngine(e,dt));
+		}
+		for(int i=0;i<threads;i++)planners[i].set_objects(T);
+		if(!planner_load(plan_file,planners[0]))
+		{
+			vector<pair<int,int> > sample;
+			int step=max(1,(int)query.size()/PLANNER_SAMPLE);
+			for(int q=0;q<(int)query.size();q+=step)sample.push_back(query[q]);
+			TIME_TICK_START
+			planner_calibrate(planners[0],sample);
+			TIME_TICK_END
+			TIME_TICK_PRINT("planner_calibrate")
+			if(!planner_save(plan_file,planners[0]))printf("CANNOT WRITE %s\n",plan_file);
+		}
+		for(int i=0;i<threads;i++)
+		{
+			planners[i].model=planners[0].model;
+			run[i]=&planners[i];
+		}
+	}
+	else for(int i=0;i<threads;i++)
+	{
+		engines[i].set_objects(T);
+		run[i]=&engines[i];
+	}
+	vector<QueryStats> stats(stats_file!=NULL?threads:0);
+	for(int i=0;i<(int)stats.size();i++)stats_init(stats[i]);
+	vector<vector<pair<int,int> > > ans(query.size());
+	vector<long long> cost(query.size());
+	parallel_for(threads,query.size(),[&](int worker,int q){
+		QueryStats* st=stats.size()>0?&stats[worker]:NULL;
+		int S=query[q].first;
+		stats_begin(st);
+		long long t0=stats_now();
+		run[worker]->knn(S,query[q].second,ans[q]);
+		cost[q]=stats_now()-t0;
+		stats_add(st,0,cost[q]);
+		stats_end(st,1);
+		for(int i=0;i<ans[q].size();i++)ans[q][i]=make_pair(ans[q][i].second,T[ans[q][i].first]);
+		sort(ans[q].begin(),ans[q].end());
+	});
+	for(int q=0;q<(int)query.size();q++)
+	{
+		for(int i=0;i<ans[q].size();i++)printf("ID=%d DIS=%d\n",ans[q][i].second,ans[q][i].first);
+		printf("\"KNN_SEARCH\" RESULT: %lld (0.01MS)\r\n",cost[q]/10000);
+	}
+	if(plan_file!=NULL)
+	{
+		density_report(stdout,planners[0].tree);
+		for(int e=0;e<(int)planners[0].engines.size();e++)
+		{
+			long long routed=0;
+			for(int i=0;i<threads;i++)routed+=planners[i].routed[e];
+			printf("PLANNER %s: %lld queries\n",planners[0].engines[e]->name(),routed);
+		}
+	}
+	if(stats_file!=NULL)
+	{
+		for(int i=1;i<threads;i++)stats_merge(stats[0],stats[i]);
+		if(!stats_json_save(stats_file,stats[0],phase_names,1,NULL,0))printf("CANNOT WRITE %s\n",stats_file);
+	}
+}
+int main(int argc,char* argv[])
+{
+	//参数：-e 边文件(默认Edge_File)，-i 索引文件(默认Tree_File)，-l 读取索引文件而不构建
+	//      -d 仅距离：构建时不保存floyd方案(Keep_Order)，索引更小，不支持路径查询
+	//      -j 构建floyd的线程数(默认CPU核数)
+	//      -o object文件 -w query文件 = kNN基准测试(knn_bench)，-s 查询统计JSON，-t 查询线程数(默认1，共享同一棵树)
+	//      -H 标签文件 = 2-hop标签(不存在则构建)，p2p测试同时用标签查询并与tree.search对比
+	//      -c 结点经纬度文件(默认Node_File)，用于Euclidean Cut，读不到则不剪枝
+	//      -L 地标数 = 载入/构建后选地标(ALT下界)，用于KNN与车辆KNN的剪枝(默认0，不用)
+	//      -a 路数 = 每个查询缓存在每个树结点保存catch的起点数(LRU，多个起点交替查询时不互相冲掉，默认1)
+	//      -u 对数 = 每个查询缓存保存的已展开border对路径数(LRU，路径查询反复经过的border对直接复制，默认0不缓存)
+	//      -R 条数 = KNN_min_dist_car的结果缓存(各线程共享，车辆更新只使受影响子树上的条目失效，默认0不缓存)
+	//      -P 文件 = kNN基准测试经planner在G*-Tree与局部网络扩展间按object密度选择，文件为校准的代价模型(不存在则校准并写入)
+	//      -p 文件 = 性能计数JSON(构建各阶段、查询内部的耗时与计数，见perf_json_save)，退出前写出
+	const char *object_file=NULL,*query_file=NULL,*stats_file=NULL,*hub_file=NULL,*perf_file=NULL,*plan_file=NULL;
+	bool load_tree=false;
+	int query_threads=1,landmark_count=0;
+	Build_Threads=thread::hardware_concurrency();
+	for(int i=1;i<argc;i++)
+	{
+		if(strcmp(argv[i],"-e")==0&&i+1<argc)Edge_File=argv[++i];
+		else if(strcmp(argv[i],"-l")==0)load_tree=true;
+		else if(strcmp(argv[i],"-d")==0)Keep_Order=false;
+		else if(strcmp(argv[i],"-i")==0&&i+1<argc)Tree_File=argv[++i];
+		else if(strcmp(argv[i],"-o")==0&&i+1<argc)object_file=argv[++i];
+		else if(strcmp(argv[i],"-w")==0&&i+1<argc)query_file=argv[++i];
+		else if(strcmp(argv[i],"-s")==0&&i+1<argc)stats_file=argv[++i];
+		else if(strcmp(argv[i],"-j")==0&&i+1<argc)Build_Threads=atoi(argv[++i]);
+		else if(strcmp(argv[i],"-t")==0&&i+1<argc)query_threads=atoi(argv[++i]);
+		else if(strcmp(argv[i],"-H")==0&&i+1<argc)hub_file=argv[++i];
+		else if(strcmp(argv[i],"-c")==0&&i+1<argc)Node_File=argv[++i];
+		else if(strcmp(argv[i],"-L")==0&&i+1<argc)landmark_count=atoi(argv[++i]);
+		else if(strcmp(argv[i],"-p")==0&&i+1<argc)perf_file=argv[++i];
+		else if(strcmp(argv[i],"-P")==0&&i+1<argc)plan_file=argv[++i];
+		else if(strcmp(argv[i],"-u")==0&&i+1<argc)Path_Cache_Pairs=atoi(argv[++i]);
+		else if(strcmp(argv[i],"-a")==0&&i+1<argc)Catch_Ways=atoi(argv[++i]);
+		else if(strcmp(argv[i],"-R")==0&&i+1<argc)Result_Cache_Size=atoi(argv[++i]);
+	}
+	Perf_On=perf_file!=NULL;
+	if(Build_Threads<1)Build_Threads=1;
+	if(load_tree)
+	{
+		init();
+		read();
+		TIME_TICK_START
+		if(!load())exit(1);
+		TIME_TICK_END
+		TIME_TICK_PRINT("load")
+	}
+	else
+	{
 	TIME_TICK_START
 	init();
 	read();
@@ -2670,19 +4436,50 @@ int main()
 		//load();
 		save();
 	//	cout << "root-part=" << rootp << endl;
+	}
+	if(hub_file!=NULL&&!hub_labels(hub_file))exit(1);
+	if(landmark_count>0)landmarks(landmark_count);
+	if(object_file!=NULL&&query_file!=NULL)
+	{
+		knn_bench(object_file,query_file,stats_file,query_threads,plan_file);
+		if(perf_file!=NULL&&!perf_json_save(perf_file))printf("CANNOT WRITE %s\n",perf_file);
+		return 0;
+	}
 	
 	{
-		TIME_TICK_START
+		vector<int> S(10000),T(10000),dis(10000);
 		for(int i=0;i<10000;i++)
 		{
-			int S=rand()%G.n;
-			int T=rand()%G.n;
-     		int dis=tree.search(S,T);
+			S[i]=rand()%G.n;
+			T[i]=rand()%G.n;
 		}
+		TIME_TICK_START
+		for(int i=0;i<10000;i++)
+     		dis[i]=tree.search(S[i],T[i]);
      	TIME_TICK_END
     	TIME_TICK_PRINT("p2p-SEARCH:")
+		if(hub_file!=NULL)
+		{
+			int bad=0;
+			TIME_TICK_START
+			for(int i=0;i<10000;i++)
+				bad+=hub_query(Hub,S[i],T[i])!=dis[i];
+			TIME_TICK_END
+			TIME_TICK_PRINT("p2p-SEARCH(hub):")
+			printf("hub mismatches: %d\n",bad);
+		}
+	}
+	{
+		vector<int> S,T;
+		for(int i=0;i<200;i++)S.push_back(rand()%G.n);
+		for(int i=0;i<2000;i++)T.push_back(rand()%G.n);
+		TIME_TICK_START
+		vector<vector<int> > table=tree.distance_matrix(S,T,Build_Threads);
+		TIME_TICK_END
+		TIME_TICK_PRINT("distance_matrix(200x2000):")
 	}
 	vector<int> ans;
+	if(perf_file!=NULL&&!perf_json_save(perf_file))printf("CANNOT WRITE %s\n",perf_file);
 
     return 0;
 }
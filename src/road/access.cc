@@ -6,37 +6,137 @@
 ---------------------------------------------------------------------------- */
 
 #include "access.h"
+#include <string.h>
 
 // constructor/destructor
-Access::Access()
-{}
+Access::Access(const int a_pagesize, const int a_lrumax):
+m_pagesize(a_pagesize),
+m_lrumax(a_lrumax),
+m_count(0),
+m_bytes(0),
+m_pages(0),
+m_distinct(0),
+m_depth(a_lrumax, 0),
+m_refs(0)
+{
+    m_stack.reserve(a_lrumax + 1);
+}
 
 Access::~Access()
+{}
+
+int Access::length() const
 {
-    clean();
+    return m_count;
 }
 
-int Access::length() const
+int Access::pagesize() const
 {
-    return m_start.size();
+    return m_pagesize;
 }
 
-void Access::get(const int i, int& a_start, int& a_end) const
+long Access::bytes() const
 {
-    if (i >= m_start.size())
-        a_start = a_end = -1;
-    a_start = (long)m_start.get(i);
-    a_end = (long)m_end.get(i);
+    return m_bytes;
+}
+
+long Access::pages() const
+{
+    return m_pages;
+}
+
+int Access::distinct() const
+{
+    return m_distinct;
+}
+
+long Access::lrumiss(const int a_cachesize) const
+{
+    if (a_cachesize > m_lrumax) return -1;
+    long miss = m_refs;
+    for (int d=0; d<a_cachesize; d++)
+        miss -= m_depth[d];
+    return miss;
 }
 
 void Access::append(const int a_start, const int a_end)
 {
-    m_start.append((void*)a_start);
-    m_end.append((void*)a_end);
+    m_count++;
+    m_bytes += a_end - a_start;
+    const int spage = a_start / m_pagesize;
+    const int epage = a_end / m_pagesize;
+    m_pages += epage - spage + 1;
+    for (int p=spage; p<=epage; p++)
+    {
+        // --------------------------------------------------------------------
+        // working set: a bit per page
+        // --------------------------------------------------------------------
+        const int w = p / 64;
+        if (w >= (int)m_seen.size())
+            m_seen.resize(w + 1 > 2*(int)m_seen.size() ? w + 1 : 2*m_seen.size(), 0);
+        const unsigned long long bit = 1ULL << (p % 64);
+        if ((m_seen[w] & bit) == 0)
+        {
+            if (m_seen[w] == 0) m_seenword.push_back(w);
+            m_seen[w] |= bit;
+            m_distinct++;
+        }
+
+        // --------------------------------------------------------------------
+        // LRU stack: the depth the page is found at(at most m_lrumax steps),
+        // the page moves to the top, the deepest falls off
+        // --------------------------------------------------------------------
+        m_refs++;
+        int d = 0;
+        while (d < (int)m_stack.size() && m_stack[d] != p) d++;
+        if (d < (int)m_stack.size())
+            m_depth[d]++;
+        else if ((int)m_stack.size() < m_lrumax)
+            m_stack.push_back(p);
+        else if (m_lrumax == 0)
+            continue;
+        else
+            d = m_lrumax - 1;
+        memmove(&m_stack[1], &m_stack[0], sizeof(int)*d);
+        m_stack[0] = p;
+    }
+}
+
+void Access::append(const Access& a_access)
+{
+    // ------------------------------------------------------------------------
+    // another thread's reads: its counts are added, pages read by both
+    // count once, its LRU references as simulated on its own stack
+    // ------------------------------------------------------------------------
+    m_count += a_access.m_count;
+    m_bytes += a_access.m_bytes;
+    m_pages += a_access.m_pages;
+    for (int i=0; i<(int)a_access.m_seenword.size(); i++)
+    {
+        const int w = a_access.m_seenword[i];
+        if (w >= (int)m_seen.size())
+            m_seen.resize(a_access.m_seen.size(), 0);
+        const unsigned long long add = a_access.m_seen[w] & ~m_seen[w];
+        if (add == 0) continue;
+        if (m_seen[w] == 0) m_seenword.push_back(w);
+        m_seen[w] |= add;
+        m_distinct += __builtin_popcountll(add);
+    }
+    m_refs += a_access.m_refs;
+    for (int d=0; d<m_lrumax && d<a_access.m_lrumax; d++)
+        m_depth[d] += a_access.m_depth[d];
 }
 
 void Access::clean()
 {
-    m_start.clean();
-    m_end.clean();
-};
+    m_count = 0;
+    m_bytes = 0;
+    m_pages = 0;
+    m_distinct = 0;
+    for (int i=0; i<(int)m_seenword.size(); i++)
+        m_seen[m_seenword[i]] = 0;
+    m_seenword.clear();
+    m_stack.clear();
+    m_depth.assign(m_lrumax, 0);
+    m_refs = 0;
+}
@@ -6,27 +6,53 @@
 
     This library contains an Access class declaration.
     It provides facility to keep track memory access
+
+    The accesses are not kept, each one updates counters as it happens, so
+    the memory is bound by the file size(a bit per page) and the cache
+    simulated, not by the number of reads:
+    - bytes and pages read, pages counted once(working set)
+    - LRU caches of up to m_lrumax pages: the depth of each page in an LRU
+      stack of that many pages, a cache of c pages misses the references
+      not found in its top c(IOMeasure::pagelru)
+    clean() starts over, e.g. per query.
 ---------------------------------------------------------------------------- */
 #ifndef access_defined
 #define access_defined
 
-#include "collection.h"
+#include <vector>
+
+#define ACCESS_PAGESIZE 4096    // default page size pages are counted in
+#define ACCESS_LRUMAX   50      // default largest LRU cache(pages) simulated
 
 class Access
 {
 protected:
-    Array   m_start;    // start addresses
-    Array   m_end;      // end addresses
+    int     m_pagesize; // pages counted in
+    int     m_lrumax;   // largest LRU cache simulated
+    int     m_count;    // accesses
+    long    m_bytes;    // bytes read
+    long    m_pages;    // pages read(a page per access it spans)
+    int     m_distinct; // pages read at least once
+    std::vector<unsigned long long> m_seen;     // a bit per page read
+    std::vector<int>                m_seenword; // words of m_seen not 0
+    std::vector<int>    m_stack;    // LRU stack of pages, latest first
+    std::vector<long>   m_depth;    // references found at each stack depth
+    long    m_refs;     // page references simulated
 public:
     // constructor/destructor
-    Access();
+    Access(const int a_pagesize=ACCESS_PAGESIZE,
+           const int a_lrumax=ACCESS_LRUMAX);
     virtual ~Access();
     //
     int length() const;
-    void get(const int i, int& a_start, int& a_end) const;
+    int pagesize() const;
+    long bytes() const;
+    long pages() const;
+    int distinct() const;
+    long lrumiss(const int a_cachesize) const;  // -1 beyond m_lrumax
     void append(const int a_start, const int a_end);
+    void append(const Access& a_access);    // counts of another history
     void clean();
 };
 
 #endif
-
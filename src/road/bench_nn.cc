@@ -0,0 +1,299 @@
+/* ----------------------------------------------------------------------------
+    kNN object search of ROAD and DistIdx on the shared benchmark workload
+    (../bench/workload.cpp, run by ../bench/bench.sh).
+
+    Suggested arguments:
+    > (prog name) -h hiergraph.idx -o object -w query -s stats.json
+    > (prog name) -i graph.idx -d dist.idx -w query -s stats.json
+    explanations:
+    -h: hiergraph index file(ROAD, hiergraphloader), needs -o
+    -i: graph index file(DistIdx, graphobjloader), with -d
+    -d: distance index file(distidxloader), the objects are in it
+    -o: object file, "vid oid" lines
+    -w: query file, "locid K" lines
+    -s: query stats as JSON(../common/query_stats.h)
+    -c: decoded node cache in bytes(nodecache.h), one per index file,
+        default 0(no cache: every node access reads and decodes)
+    -m: map the index files read-only(segmapmem.h) with an access advice:
+        random, sequential, normal, willneed or preload, default buffered reads
+    -b: read each index file through a page pool(pagepool.h) of this many
+        pages, default 0(none); -B page size(4096), -e eviction lru or
+        clock(clock), -a pages read ahead on a miss(0), -D O_DIRECT
+    -t: worker threads for the queries, default 1(the output is in query
+        order whatever the number)
+
+    output per query: "ID=vid DIS=cost" per answer, then the time line,
+    the same as gtree_query, so bench.sh reads every engine alike.
+    the cache hits, misses and evictions and the pool page hits, misses
+    and bytes read go to stderr at the end, with the bytes of the records
+    read(the access histories of the workers merged).
+---------------------------------------------------------------------------- */
+
+#include "hiergraph.h"
+#include "bordernode.h"
+#include "shortcuttreenode.h"
+#include "graph.h"
+#include "segmapmem.h"
+#include "segfmem.h"
+#include "pagepool.h"
+#include "param.h"
+#include "collection.h"
+#include "nodemap.h"
+#include "graphmap.h"
+#include "graphsearch.h"
+#include "hierobjsearch.h"
+#include "objectsearch.h"
+#include "distidx.h"
+#include "distidxsearch.h"
+#include "nodecache.h"
+#include "iomeasure.h"
+#include <sys/time.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <vector>
+#include "../common/query_stats.h"
+#include "../common/task_pool.h"
+
+using namespace std;
+
+//Stopwatch for 0.01ms, as gtree_query(per query, the workers share none)
+long long time_tick()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 100000 + tv.tv_usec / 10;
+}
+#define TIME_TICK_PRINT(T, D) printf("%s RESULT: %lld (0.01MS)\r\n", (#T), (D) );
+#define PAGESIZE 409600000
+
+const char* const stats_phase_names[1] = { "total" };
+const char* const stats_counter_names[2] = { "node_access", "edge_access" };
+
+void helpmsg(const char* pgm)
+{
+    cerr << "Suggested arguments:" << endl;
+    cerr << "> " << pgm << " -h hiergraph.idx -o object -w query [-s stats.json] [-c bytes] [-m advice] [-b pages] [-t threads]" << endl;
+    cerr << "> " << pgm << " -i graph.idx -d dist.idx -w query [-s stats.json] [-c bytes] [-m advice] [-b pages] [-t threads]" << endl;
+}
+
+int main(const int a_argc, const char** a_argv)
+{
+    if (a_argc == 1)
+    {
+        helpmsg(a_argv[0]);
+        return -1;
+    }
+
+    const char* hidxflname = Param::read(a_argc, a_argv, "-h", "");
+    const char* idxflname = Param::read(a_argc, a_argv, "-i", "");
+    const char* didxflname = Param::read(a_argc, a_argv, "-d", "");
+    const char* objflname = Param::read(a_argc, a_argv, "-o", "");
+    const char* qflname = Param::read(a_argc, a_argv, "-w", "");
+    const char* statsflname = Param::read(a_argc, a_argv, "-s", "");
+    const long cachesize = atol(Param::read(a_argc, a_argv, "-c", "0"));
+    const char* cmap = Param::read(a_argc, a_argv, "-m", "");
+    const int frames = atoi(Param::read(a_argc, a_argv, "-b", "0"));
+    const int pagesize = atoi(Param::read(a_argc, a_argv, "-B", "4096"));
+    const int policy = PagePool::policy(Param::read(a_argc, a_argv, "-e", "clock"));
+    const int readahead = atoi(Param::read(a_argc, a_argv, "-a", "0"));
+    const bool direct = strcmp(Param::read(a_argc, a_argv, "-D", "null"), "null") != 0;
+    int threads = atoi(Param::read(a_argc, a_argv, "-t", "1"));
+    if (threads < 1) threads = 1;
+    bool road = strlen(hidxflname) > 0;
+    if (road ? strlen(objflname) == 0 : strlen(idxflname) == 0 || strlen(didxflname) == 0)
+    {
+        helpmsg(a_argv[0]);
+        return -1;
+    }
+
+    //-------------------------------------------------------------------------
+    // access index files
+    //-------------------------------------------------------------------------
+    cerr << "loading index ... ";
+    SegMemory* segmem = SegMapMemory::open(road ? hidxflname : idxflname, cmap, PAGESIZE, PAGESIZE, 32);
+    SegMemory* segdmem = 0;
+    HierGraph* hiergraph = 0;
+    Graph* graph = 0;
+    DistIndex* didx = 0;
+    if (road)
+        hiergraph = new HierGraph(*segmem);
+    else
+    {
+        graph = new Graph(*segmem);
+        segdmem = SegMapMemory::open(didxflname, cmap, PAGESIZE, PAGESIZE, 32);
+        didx = new DistIndex(*segdmem);
+    }
+    PagePool* pool = 0;
+    PagePool* dpool = 0;
+    if (frames > 0 && dynamic_cast<SegFMemory*>(segmem) != 0)
+    {
+        const int pol = policy == -1 ? PagePool::CLOCK : policy;
+        pool = new PagePool(road ? hidxflname : idxflname, pagesize, frames, pol, direct, readahead);
+        ((SegFMemory*)segmem)->setPool(pool);
+        if (segdmem)
+        {
+            dpool = new PagePool(didxflname, pagesize, frames, pol, direct, readahead);
+            ((SegFMemory*)segdmem)->setPool(dpool);
+        }
+    }
+    NodeCache* cache = 0;
+    NodeCache* dcache = 0;
+    if (cachesize > 0)
+    {
+        cache = new NodeCache(cachesize);
+        if (road)
+            hiergraph->setCache(cache);
+        else
+        {
+            dcache = new NodeCache(cachesize);
+            graph->setCache(cache);
+            didx->setCache(dcache);
+        }
+    }
+    cerr << "[DONE]" << endl;
+
+    //-------------------------------------------------------------------------
+    // objects(ROAD), node and subnet mapping as hiernn_gtree
+    //-------------------------------------------------------------------------
+    NodeMapping nmap;
+    GraphMapping gmap;
+    if (road)
+    {
+        FILE* fobj = fopen(objflname, "r");
+        if (fobj == NULL)
+        {
+            cerr << "CANNOT OPEN " << objflname << endl;
+            return -1;
+        }
+        int nodeid, oid, objid = 0;
+        while (fscanf(fobj, "%d %d", &nodeid, &oid) == 2)
+        {
+            nmap.addObject(nodeid, objid);
+            std::shared_ptr<const BorderNode> bnode = hiergraph->getSharedBorderNode(nodeid);
+            const Array* a = &bnode->m_shortcuttree;
+            while (a->size() > 0)
+            {
+                const ShortcutTreeNode* s = (const ShortcutTreeNode*)a->get(0);
+                if (s->m_subnetid == 0) break;
+                gmap.addObject(s->m_subnetid, objid);
+                a = &s->m_child;
+            }
+            objid++;
+        }
+        nmap.build();
+        fclose(fobj);
+        gmap.computeBounds(*hiergraph, nmap);
+    }
+
+    //-------------------------------------------------------------------------
+    // search
+    //-------------------------------------------------------------------------
+    FILE* fq = fopen(qflname, "r");
+    if (fq == NULL)
+    {
+        cerr << "CANNOT OPEN " << qflname << endl;
+        return -1;
+    }
+    vector<int> qloc, qk;
+    int locid, k;
+    while (fscanf(fq, "%d %d", &locid, &k) == 2)
+    {
+        qloc.push_back(locid);
+        qk.push_back(k);
+    }
+    fclose(fq);
+
+    //-------------------------------------------------------------------------
+    // the queries on the workers: each has its own stats and access
+    // histories, the answers and times go to per query slots
+    //-------------------------------------------------------------------------
+    const int nq = qloc.size();
+    vector< vector< pair<int,float> > > answers(nq);
+    vector<long long> ticks(nq);
+    vector<QueryStats> wstats(threads);
+    for (int t = 0; t < threads; t++)
+        stats_init(wstats[t]);
+    vector<Access> whistory(threads), wdhistory(threads);
+    vector<long> wbyte(threads, 0), wdbyte(threads, 0);
+    parallel_for(threads, nq, [&](int worker, int q)
+    {
+        segmem->bindHistory(&whistory[worker]);
+        if (segdmem) segdmem->bindHistory(&wdhistory[worker]);
+        whistory[worker].clean();
+        wdhistory[worker].clean();
+        QueryStats* st = &wstats[worker];
+        Array result;
+        int nodeaccess = 0, edgeaccess = 0;
+
+        stats_begin(st);
+        long long t0 = stats_now();
+        long long ts = time_tick();
+        if (road)
+            HierObjectSearch::kNNSearch(*hiergraph, nmap, gmap, qloc[q], qk[q], result, nodeaccess, edgeaccess, false);
+        else
+            DistIndexSearch::kNNSearch(*graph, *didx, qloc[q], qk[q], result, nodeaccess, edgeaccess, false);
+        ticks[q] = time_tick() - ts;
+        wbyte[worker] += IOMeasure::byte(whistory[worker]);
+        wdbyte[worker] += IOMeasure::byte(wdhistory[worker]);
+        stats_add(st, 0, stats_now() - t0);
+        stats_count(st, 0, nodeaccess);
+        stats_count(st, 1, edgeaccess);
+        stats_end(st, 1);
+
+        for (int i = 0; i < result.size(); i++)
+        {
+            ObjectSearchResult* r = (ObjectSearchResult*)result.get(i);
+            answers[q].push_back(make_pair(r->m_nid, r->m_cost));
+            delete r;
+        }
+    });
+    segmem->bindHistory(0);
+    if (segdmem) segdmem->bindHistory(0);
+
+    for (int q = 0; q < nq; q++)
+    {
+        for (int i = 0; i < (int)answers[q].size(); i++)
+            printf("ID=%d DIS=%.9g\n", answers[q][i].first, answers[q][i].second);
+        TIME_TICK_PRINT("KNN_SEARCH", ticks[q])
+    }
+
+    QueryStats* stats = 0;
+    if (strlen(statsflname) > 0)
+    {
+        stats = new QueryStats;
+        stats_init(*stats);
+        for (int t = 0; t < threads; t++)
+            stats_merge(*stats, wstats[t]);
+    }
+    long byte = 0, dbyte = 0;
+    for (int t = 0; t < threads; t++)
+    {
+        byte += wbyte[t];
+        dbyte += wdbyte[t];
+    }
+    cerr << "records read: byte=" << byte;
+    if (segdmem) cerr << " distance byte=" << dbyte;
+    cerr << endl;
+
+    if (stats && ! stats_json_save(statsflname, *stats, stats_phase_names, 1, stats_counter_names, 2))
+        cerr << "CANNOT WRITE " << statsflname << endl;
+    if (cache)
+        cerr << "node cache: hit=" << IOMeasure::cachehit(*cache)
+             << " miss=" << IOMeasure::cachemiss(*cache)
+             << " evict=" << IOMeasure::cacheevict(*cache) << endl;
+    if (dcache)
+        cerr << "distance cache: hit=" << IOMeasure::cachehit(*dcache)
+             << " miss=" << IOMeasure::cachemiss(*dcache)
+             << " evict=" << IOMeasure::cacheevict(*dcache) << endl;
+    if (pool)
+        cerr << "page pool: hit=" << IOMeasure::poolhit(*pool)
+             << " miss=" << IOMeasure::poolmiss(*pool)
+             << " byte=" << IOMeasure::poolbyte(*pool) << endl;
+    if (dpool)
+        cerr << "distance page pool: hit=" << IOMeasure::poolhit(*dpool)
+             << " miss=" << IOMeasure::poolmiss(*dpool)
+             << " byte=" << IOMeasure::poolbyte(*dpool) << endl;
+    return 0;
+}
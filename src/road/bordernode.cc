@@ -8,6 +8,7 @@
 #include "bordernode.h"
 #include "edge.h"
 #include "shortcuttreenode.h"
+#include "shortcutcsr.h"
 
 
 BorderNode::BorderNode(const int a_id, const float a_x, const float a_y):
@@ -85,14 +86,14 @@ void BorderNode::addEdge(const Array& a_subnet, const Edge& a_edge)
     int sz = sc->m_edges.size();
     for (int i=0; i<sz; i++)
     {
-        Edge* e = (Edge*)sc->m_edges.get(i);
+        Edge* e = &sc->m_edges[i];
         if (e->m_neighbor == a_edge.m_neighbor)
         {
             e->m_cost = a_edge.m_cost;
             return;
         }
     }
-    sc->m_edges.append(new Edge(a_edge.m_neighbor, a_edge.m_cost));
+    sc->m_edges.append(Edge(a_edge.m_neighbor, a_edge.m_cost));
     m_numlinks++;
 }
 
@@ -109,10 +110,10 @@ void BorderNode::delEdge(const Array& a_subnet, const Edge& a_edge)
     int sz = sc->m_edges.size();
     for (int i=0; i<sz; i++)
     {
-        Edge* e = (Edge*)sc->m_edges.get(i);
+        Edge* e = &sc->m_edges[i];
         if (e->m_neighbor == a_edge.m_neighbor)
         {
-            sc->m_edges.remove(e);
+            sc->m_edges.removeAt(i);
             m_numlinks--;
             return;
         }
@@ -156,7 +157,7 @@ void BorderNode::toMem(char* a_mem, int& a_len) const
             *(int*)&a_mem[a_len] = numedge;             a_len += sizeof(int);
             for (int j=0; j<numedge; j++)
             {
-                Edge* e = (Edge*)sc->m_edges.get(j);
+                Edge* e = &sc->m_edges[j];
                 *(int*)&a_mem[a_len] = e->m_neighbor;   a_len += sizeof(int);
                 *(float*)&a_mem[a_len] = e->m_cost;     a_len += sizeof(float);
             }
@@ -171,6 +172,13 @@ void BorderNode::toMem(char* a_mem, int& a_len) const
 
 void BorderNode::fromMem(char* a_mem, int& a_len)
 {
+    if (ShortcutCSR::isCompact(&a_mem[a_len]))
+    {
+        ShortcutCSR sc(&a_mem[a_len]);
+        sc.toBorderNode(*this);
+        a_len += sc.length();
+        return;
+    }
     m_id = *(int*)&a_mem[a_len];    a_len += sizeof(m_id);
     m_x = *(float*)&a_mem[a_len];   a_len += sizeof(m_x);
     m_y = *(float*)&a_mem[a_len];   a_len += sizeof(m_y);
@@ -192,10 +200,10 @@ void BorderNode::fromMem(char* a_mem, int& a_len)
             {
                 int n = *(int*)&a_mem[a_len];       a_len += sizeof(int);
                 float c = *(float*)&a_mem[a_len];   a_len += sizeof(float);
-                sc->m_edges.append(new Edge(n,c));
+                sc->m_edges.append(Edge(n,c));
                 m_numlinks++;                       // record the number of links
                 if (subnetid == 0)                  // record the original edges
-                    m_edges.append(new Edge(n,c));
+                    m_edges.append(Edge(n,c));
             }
             int numchild = *(int*)&a_mem[a_len];    a_len += sizeof(int);
             if (numchild > 0)
@@ -246,7 +254,7 @@ void BorderNode::display(std::ostream& out)
                 out << sc->m_subnetid << "-{";
                 for (int j=0; j<sc->m_edges.size(); j++)
                 {
-                    Edge* e = (Edge*)sc->m_edges.get(j);
+                    Edge* e = &sc->m_edges[j];
                     out << e->m_neighbor << "," << e->m_cost;;
                 }
                 out << "};";
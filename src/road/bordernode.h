@@ -35,7 +35,8 @@ public:
     //
     void findSubnet(const Edge& a_edge, Array& a_subnet);
     //
-    // memory operations
+    // memory operations(fromMem reads both the tree and the compact layout,
+    // see ShortcutCSR)
     virtual void toMem(char* a_mem, int& a_len) const;
     virtual void fromMem(char* a_mem, int& a_len);
     virtual int size() const;
@@ -45,10 +45,12 @@ int Array::append(void* a_p)
 {
     if (m_max >= m_lim)
     {
-        void** tmp = new void*[m_lim + m_ext];
+        // doubles(m_ext at least), so n appends copy O(n) items in all
+        int lim = m_lim + (m_lim > m_ext ? m_lim : m_ext);
+        void** tmp = new void*[lim];
         memcpy(tmp, m_p, sizeof(void*)*m_max);
         delete[] m_p;
-        m_lim += m_ext;
+        m_lim = lim;
         m_p = tmp;
     }
     m_p[m_max++] = a_p;
@@ -121,7 +123,7 @@ int Array::reverse()
 
 int Array::trim(const int a_k)
 {
-    memset(m_p[a_k], 0, sizeof(void*)*(m_max - a_k));
+    memset(&m_p[a_k], 0, sizeof(void*)*(m_max - a_k));
     m_max = a_k;
     return m_max;
 }
@@ -325,105 +327,54 @@ bool Queue::isEmpty() const
 //
 // constructor/destuctor
 Hash::Hash(const int a_max):
-m_slot(a_max),
-m_size(0)
-{
-    m_a = new Array*[m_slot];
-    for (int i=0; i<m_slot; i++)
-        m_a[i] = new Array;
-}
+m_map(a_max)
+{}
 
 Hash::Hash(const Hash& a_h):
-m_slot(a_h.m_slot),
-m_size(0)
-{
-    m_a = new Array*[m_slot];
-    for (int i=0; i<m_slot; i++)
-        m_a[i] = new Array(*a_h.m_a[i]);
-}
+m_map(a_h.m_map)
+{}
 
 Hash::~Hash()
-{
-    clean();
-    for (int i=0; i<m_slot; i++)
-        delete m_a[i];
-    delete[] m_a;
-}
+{}
 
 // update
 int Hash::put(const int a_key, void* a_p)
 {
-    HashEntry* e = new HashEntry(a_key,a_p);
-    int pos = a_key % m_slot;
-    if (m_a[pos]->find(e, HashEntry::comparekey) == -1)
-    {
-        m_a[pos]->append(e);
-        return ++m_size;
-    }
-    delete e;
+    if (m_map.put(a_key,a_p))
+        return m_map.size();
     return -1;
 }
 
 int Hash::remove(const int a_key)
 {
-    HashEntry e(a_key,0);
-    int pos = a_key % m_slot;
-    int found = m_a[pos]->find(&e, HashEntry::comparekey);
-    if (found != -1)
-    {
-        HashEntry* t = (HashEntry*)m_a[pos]->get(found);    // get an old entry
-        m_a[pos]->removeAt(found);
-        delete t;                       // delete the old entry
-        return --m_size;
-    }
+    if (m_map.remove(a_key))
+        return m_map.size();
     return -1;
 }
 
 int Hash::replace(const int a_key, void* a_p)
 {
-    HashEntry* e = new HashEntry(a_key,a_p);
-    int pos = a_key % m_slot;
-    int found = m_a[pos]->find(e, HashEntry::comparekey);
-    if (found != -1)
-    {
-        HashEntry* t = (HashEntry*)m_a[pos]->get(found);    // get an old entry
-        m_a[pos]->replaceAt(found,e);   // replace it with a new one
-        delete t;                       // delete the old entry
-        return m_size;
-    }
-    delete e;
+    if (m_map.replace(a_key,a_p))
+        return m_map.size();
     return -1;
 }
 
 int Hash::clean()
 {
-    for (int i=0; i<m_slot; i++)
-    {
-        for (int j=0; j<m_a[i]->size(); j++)
-        {
-            HashEntry* e = (HashEntry*)m_a[i]->get(j);
-            delete e;
-        }
-        m_a[i]->clean();
-    }
-    m_size = 0;
-    return m_size;
+    m_map.clean();
+    return m_map.size();
 }
 
 // search
 int Hash::size() const
 {
-    return m_size;
+    return m_map.size();
 }
 
 void* Hash::get(const int a_key) const
 {
-    HashEntry e(a_key,0);
-    int pos = a_key % m_slot;
-    int found = m_a[pos]->find(&e, HashEntry::comparekey);
-    if (found != -1 && ((HashEntry*)m_a[pos]->get(found))->m_key == a_key)
-        return ((HashEntry*)m_a[pos]->get(found))->m_p;
-    return 0;
+    void* const* p = m_map.find(a_key);
+    return p == 0 ? 0 : *p;
 }
 
 //-----------------------------------------------------------------------------
@@ -432,8 +383,7 @@ void* Hash::get(const int a_key) const
 // constructor/destuctor
 HashReader::HashReader(const Collection::Hash& a_hash):
 m_hash(a_hash),
-m_curarray(0),
-m_curcontent(0)
+m_curslot(0)
 {
     first();
 }
@@ -444,42 +394,32 @@ HashReader::~HashReader()
 // update
 void HashReader::first()
 {
-    m_curarray = 0;
-    m_curcontent= 0;
-    while (m_curarray < m_hash.m_slot && m_hash.m_a[m_curarray]->size() == 0)
-        m_curarray++;
+    m_curslot = 0;
+    while (m_curslot < m_hash.m_map.capacity() && !m_hash.m_map.used(m_curslot))
+        m_curslot++;
 }
 
 void HashReader::next()
 {
-    m_curcontent++;
-    if (m_curcontent < m_hash.m_a[m_curarray]->size())
-        return;
-    m_curcontent = 0;
-    m_curarray++;
-    while (m_curarray < m_hash.m_slot &&
-        m_hash.m_a[m_curarray]->size() == 0)
-        m_curarray++;
+    m_curslot++;
+    while (m_curslot < m_hash.m_map.capacity() && !m_hash.m_map.used(m_curslot))
+        m_curslot++;
 }
 
 // search
 bool HashReader::isEnd() const
 {
-    return m_curarray == m_hash.m_slot;
+    return m_curslot >= m_hash.m_map.capacity();
 }
 
 int HashReader::getKey() const
 {
-    Hash::HashEntry* e =
-        (Hash::HashEntry*)m_hash.m_a[m_curarray]->get(m_curcontent);
-    return e->m_key;
+    return m_hash.m_map.key(m_curslot);
 }
 
 void* HashReader::getVal() const
 {
-    Hash::HashEntry* e =
-        (Hash::HashEntry*)m_hash.m_a[m_curarray]->get(m_curcontent);
-    return e->m_p;
+    return m_hash.m_map.val(m_curslot);
 }
 
 //-----------------------------------------------------------------------------
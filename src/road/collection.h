@@ -13,8 +13,10 @@
 #ifndef COLLECTION_DEFINED
 #define COLLECTION_DEFINED
 
+#include "flathash.h"
+
 #define INITSIZE    10      // default collection size
-#define EXTENSION   10      // default extension size if the collection object overflows
+#define EXTENSION   10      // least extension size if the collection object overflows
 
 namespace Collection
 {
@@ -43,7 +45,7 @@ namespace Collection
         void**  m_p;    // pointer to an array of void*
         int     m_lim;  // the array size (max no. of items)
         int     m_max;  // the max current usage of array space
-        int     m_ext;  // the extension space if the array is overflow
+        int     m_ext;  // the least extension if the array is overflow(it doubles)
     // methods
     public:
         // constructor/destructor
@@ -147,36 +149,13 @@ namespace Collection
     class Hash
     {
         friend class HashReader;
-
-        class HashEntry
-        {
-        public:
-            const int   m_key;
-            void*       m_p;
-        public:
-            HashEntry(const int a_key, void* a_p):
-              m_key(a_key), m_p(a_p) {};
-            virtual ~HashEntry() {};
-            static int comparekey(const void* a_p0, const void* a_p1)
-            {
-                HashEntry* p0 = *(HashEntry**)a_p0;
-                HashEntry* p1 = *(HashEntry**)a_p1;
-                //if (p0->m_key < p1->m_key) return -1;
-                //if (p0->m_key > p1->m_key) return +1;
-                //return 0;
-                if (p0->m_key == p1->m_key) return 0;
-                return -1;
-            };
-        };
     // data member
     protected:
-        const int   m_slot;
-        Array**     m_a;
-        int         m_size;
+        FlatHash<int,void*> m_map;  // open addressing, see flathash.h
     // methods
     public:
         // constructor/destructor
-        Hash(const int a_max=INITSIZE);     // ctor
+        Hash(const int a_max=INITSIZE);     // ctor(a_max: entries expected)
         Hash(const Hash& a_h);              // cp ctor
         virtual ~Hash();                    // dtor
         //
@@ -202,8 +181,7 @@ namespace Collection
     // data members
     protected:
         const Hash& m_hash;
-        int         m_curarray;
-        int         m_curcontent;
+        int         m_curslot;
     // methods
     public:
         // constructor/destructor
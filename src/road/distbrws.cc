@@ -9,9 +9,13 @@
 #include "node.h"
 #include "segmem.h"
 #include "spqdtree.h"
+#include "nodecache.h"
+#include <string.h>
 
-DistBrws::DistBrws(SegMemory& a_nodeMem):
+DistBrws::DistBrws(SegMemory& a_nodeMem, const bool a_morton):
 m_nodeMem(a_nodeMem),
+m_cache(0),
+m_morton(a_morton),
 m_nodes(1000)
 {
     if (m_nodeMem.m_header == -1) return;
@@ -62,10 +66,13 @@ DistBrws::~DistBrws()
 
 int DistBrws::writeNode(const int a_nid, SPQuadtree* a_spqdtree)
 {
+    const bool morton =
+        m_morton && SPMortonList::depth(*a_spqdtree) <= SPMortonList::MAXDEPTH;
+
     // ------------------------------------------------------------------------
     // allocate a memory block
     // ------------------------------------------------------------------------
-    int sz = a_spqdtree->size();
+    int sz = morton ? SPMortonList::size(*a_spqdtree) : a_spqdtree->size();
 	//char* mem = new char[sz];
 	static char* mem = 0;
 	static int maxsize = 0;
@@ -79,7 +86,10 @@ int DistBrws::writeNode(const int a_nid, SPQuadtree* a_spqdtree)
     // ------------------------------------------------------------------------
     // convert a shortest path quadtree into a memory byte string
     // ------------------------------------------------------------------------
-    a_spqdtree->toMem(mem, len);
+    if (morton)
+        SPMortonList::toMem(*a_spqdtree, mem, len);
+    else
+        a_spqdtree->toMem(mem, len);
 
     // ------------------------------------------------------------------------
     // store the byte string
@@ -90,6 +100,11 @@ int DistBrws::writeNode(const int a_nid, SPQuadtree* a_spqdtree)
     return 0;
 }
 
+void DistBrws::setMorton(const bool a_morton)
+{
+    m_morton = a_morton;
+}
+
 SPQuadtree* DistBrws::getNode(const int a_nid, const Bound& a_bound)
 {
     // ------------------------------------------------------------------------
@@ -103,7 +118,60 @@ SPQuadtree* DistBrws::getNode(const int a_nid, const Bound& a_bound)
     // convert a byte string into a shortest path quadtree
     // ------------------------------------------------------------------------
     SPQuadtree* tree = new SPQuadtree(a_nid, a_bound);
-    tree->fromMem(mem, len);
+    if (SPMortonList::isMorton(mem))
+        SPMortonList(mem).toTree(*tree);
+    else
+        tree->fromMem(mem, len);
 
     return tree;
 }
+
+std::shared_ptr<const SPQuadtree> DistBrws::getSharedNode(
+    const int a_nid, const Bound& a_bound)
+{
+    return std::shared_ptr<const SPQuadtree>(getNode(a_nid, a_bound));
+}
+
+SPMortonList DistBrws::getQuadtree(const int a_nid, const Bound& a_bound)
+{
+    if (m_cache != 0)
+    {
+        NodeCache::Handle h = m_cache->find(a_nid);
+        if (h) return SPMortonList((const char*)h.get(), h);
+    }
+    int pos = (long)m_nodes.get(a_nid);
+    char* mem = (char*)m_nodeMem.read(pos);
+    if (SPMortonList::isMorton(mem) && m_cache == 0)
+        return SPMortonList(mem);
+
+    // ------------------------------------------------------------------------
+    // a copy of the record, in the morton layout if in the tree layout
+    // ------------------------------------------------------------------------
+    std::shared_ptr<char> rec;
+    int len = 0;
+    if (SPMortonList::isMorton(mem))
+    {
+        len = SPMortonList(mem).length();
+        rec.reset(new char[len], std::default_delete<char[]>());
+        memcpy(rec.get(), mem, len);
+    }
+    else
+    {
+        std::shared_ptr<SPQuadtree> tree(new SPQuadtree(a_nid, a_bound));
+        tree->fromMem(mem, len);
+        if (SPMortonList::depth(*tree) > SPMortonList::MAXDEPTH)
+            return SPMortonList(std::shared_ptr<const SPQuadtree>(tree));
+        len = 0;
+        rec.reset(new char[SPMortonList::size(*tree)], std::default_delete<char[]>());
+        SPMortonList::toMem(*tree, rec.get(), len);
+    }
+    NodeCache::Handle h = rec;
+    if (m_cache != 0)
+        h = m_cache->insert(a_nid, h, len);
+    return SPMortonList((const char*)h.get(), h);
+}
+
+void DistBrws::setCache(NodeCache* a_cache)
+{
+    m_cache = a_cache;
+}
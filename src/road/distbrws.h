@@ -9,13 +9,18 @@
     This file contains a class DistBrows declaration.
     That captures individual nodes and indexes their paths to other nodes
     based on shortest path quadtrees
+    Quadtrees are written in the tree layout or, if set, the morton layout
+    (SPMortonList) that searches read in place.
 ---------------------------------------------------------------------------- */
 #ifndef distbrws_defined
 #define distbrws_defined
 
 #include "collection.h"
+#include "spmorton.h"
+#include <memory>
 
 class SegMemory;
+class NodeCache;
 class SPQuadtree;
 class Bound;
 
@@ -23,18 +28,35 @@ class DistBrws
 {
 protected:
     SegMemory&  m_nodeMem;  // handle of memory of distance signature
+    NodeCache*  m_cache;    // quadtree records(0: none)
+    bool        m_morton;   // write the morton layout
 public:
     Hash        m_nodes;    // hash of distance signatures in memory
 public:
     // constructor/destructor
-    DistBrws(SegMemory& a_nodeMem);
+    DistBrws(SegMemory& a_nodeMem, const bool a_morton=false);
     virtual ~DistBrws();
     //
     // update
     int writeNode(const int a_nid, SPQuadtree* a_spqdtree);
+    void setMorton(const bool a_morton);    // trees too deep stay in the tree layout
     //
     // search
     virtual SPQuadtree* getNode(const int a_nid, const Bound& a_bound);
+    virtual std::shared_ptr<const SPQuadtree> getSharedNode(
+        const int a_nid, const Bound& a_bound);
+    //
+    // the quadtree of a node in the morton layout: in place in the memory(a
+    // mapped file, or the read buffer of the calling thread until its next
+    // read) if so stored; otherwise, or with a cache, the view holds a copy
+    // of the record(a tree too deep for the layout is decoded instead). the
+    // cache keeps records: a quadtree shared from it is decoded again per
+    // call. a_bound is the area of the tree layout(the morton layout keeps
+    // its own)
+    SPMortonList getQuadtree(const int a_nid, const Bound& a_bound);
+    //
+    // cache of quadtree records(not owned, 0 to stop caching)
+    void setCache(NodeCache* a_cache);
 };
 
 #endif
@@ -16,6 +16,8 @@
     -o: object.dat
     -s: query.dat
     -x: distbrws.idx
+    -f: quadtree layout: morton(sorted cell codes, see SPMortonList) or tree
+        (default: morton)
     -v: turn verbose mode on (default: off)
 ---------------------------------------------------------------------------- */
 
@@ -35,6 +37,7 @@
 #include <string.h>
 #include <iostream>
 #include <fstream>
+#include <vector>
 
 using namespace std;
 
@@ -49,6 +52,7 @@ void helpmsg(const char* pgm)
     cerr << "explanations:" << endl;
     cerr << "-i: graph index file" << endl;
     cerr << "-x: quadtrees" << endl;
+    cerr << "-f: quadtree layout: morton or tree (default: morton)" << endl;
     cerr << "-v: turn verbose mode on (default: off)" << endl;
 }
 
@@ -66,6 +70,7 @@ int main(const int a_argc, const char** a_argv)
     //-------------------------------------------------------------------------
     const char* idxflname = Param::read(a_argc, a_argv, "-i", "");
     const char* dbrwsflname= Param::read(a_argc, a_argv, "-x", "");
+    const char* layout = Param::read(a_argc, a_argv, "-f", "morton");
     const char* vrbs = Param::read(a_argc, a_argv, "-v", "null");
     bool verbose = strcmp(vrbs,"null") != 0;
 
@@ -105,32 +110,44 @@ int main(const int a_argc, const char** a_argv)
 	struct timeb starttime, endtime;	// overall time
 
     SegFMemory segfmem(dbrwsflname, PAGESIZE*10, PAGESIZE, 32, true);
-    DistBrws distbrws(segfmem);
+    segfmem.setAppend(true);            // written once, nothing freed
+    segfmem.setAlign(PAGESIZE);         // a record in as few pages as it can
+    DistBrws distbrws(segfmem, strcmp(layout,"tree") != 0);
 
 	int cnt = 0;
     cerr << "create quadtrees ... ";
     ftime(&starttime);  // time the distance browsing index creation
-    for (HashReader r(graph.m_nodes); !r.isEnd() ; r.next() ) // && cnt < 10; r.next())
+    vector<int> srcs;
+    for (HashReader r(graph.m_nodes); !r.isEnd() ; r.next() )
+        srcs.push_back((int)r.getKey());
+    vector<Array> paths;
+    for (int s=0; s<(int)srcs.size(); s++) // && cnt < 10; s++)
     {
 		cnt++;
 cerr << "1";
-        int src = (int)r.getKey();
+        int src = srcs[s];
         SPQuadtree* tree = new SPQuadtree(src, area);
 
         // --------------------------------------------------------------------
-        // forming the spanning tree to all other nodes
+        // forming the spanning trees to all other nodes, MSLANES sources
+        // at a time
         // --------------------------------------------------------------------
-        Array toAllNodes(graph.m_nodes.size());
-
-	    struct timeb startpathtime, endpathtime;
-		ftime(&startpathtime);
-		//
-        GraphSearch::diffuseSearch(graph, src, toAllNodes);
-		//
-		ftime(&endpathtime);
-		pathtime +=
-			((endpathtime.time*1000 + endpathtime.millitm) -
-			(startpathtime.time*1000 + startpathtime.millitm)) / 1000.0f;
+        if (s % MSLANES == 0)
+        {
+            struct timeb startpathtime, endpathtime;
+            ftime(&startpathtime);
+            //
+            int num = srcs.size() - s < MSLANES ? srcs.size() - s : MSLANES;
+            paths.clear();
+            paths.resize(num, Array(graph.m_nodes.size()));
+            GraphSearch::diffuseSearch(graph, &srcs[s], num, &paths[0]);
+            //
+            ftime(&endpathtime);
+            pathtime +=
+                ((endpathtime.time*1000 + endpathtime.millitm) -
+                (startpathtime.time*1000 + startpathtime.millitm)) / 1000.0f;
+        }
+        Array& toAllNodes = paths[s % MSLANES];
 
 cerr << "2";
 		struct timeb startquadtime, endquadtime;
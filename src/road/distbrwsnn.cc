@@ -18,11 +18,13 @@
     -x: distbrws.idx
     -k: #NNs
     -v: turn verbose mode on (default: off)
+    -m: map index files read-only, advised random, sequential, normal,
+        willneed or preload (default: off, buffered reads)
 ---------------------------------------------------------------------------- */
 
 #include "graph.h"
 #include "node.h"
-#include "segfmem.h"
+#include "segmapmem.h"
 #include "param.h"
 #include "collection.h"
 #include "spqdtree.h"
@@ -38,6 +40,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <iostream>
+#include <memory>
 #include <fstream>
 
 using namespace std;
@@ -57,6 +60,7 @@ void helpmsg(const char* pgm)
     cerr << "-x: quadtrees" << endl;
     cerr << "-k: #NNs" << endl;
     cerr << "-v: turn verbose mode on (default: off)" << endl;
+    cerr << "-m: map index files: random, sequential, normal, willneed or preload (default: off)" << endl;
 }
 
 int main(const int a_argc, const char** a_argv)
@@ -77,13 +81,15 @@ int main(const int a_argc, const char** a_argv)
     const char* dbrwsflname= Param::read(a_argc, a_argv, "-x", "");
     const int k = atol(Param::read(a_argc, a_argv, "-k", ""));
     const char* vrbs = Param::read(a_argc, a_argv, "-v", "null");
+    const char* cmap = Param::read(a_argc, a_argv, "-m", "");
     bool verbose = strcmp(vrbs,"null") != 0;
 
     //-------------------------------------------------------------------------
     // access graph index file
     //-------------------------------------------------------------------------
     cerr << "loading a graph index ... ";
-    SegFMemory segmem(idxflname, PAGESIZE*10, PAGESIZE, 32, false);
+    std::unique_ptr<SegMemory> segmemp(SegMapMemory::open(idxflname, cmap, PAGESIZE*10, PAGESIZE, 32));
+    SegMemory& segmem = *segmemp;
     Graph graph(segmem);
     cerr << "[DONE]" << endl;
 
@@ -128,7 +134,8 @@ int main(const int a_argc, const char** a_argv)
     //-------------------------------------------------------------------------
     // load the distance browsing index
     //-------------------------------------------------------------------------
-    SegFMemory segfmem(dbrwsflname, PAGESIZE*10, PAGESIZE, 32, false);
+    std::unique_ptr<SegMemory> segfmemp(SegMapMemory::open(dbrwsflname, cmap, PAGESIZE*10, PAGESIZE, 32));
+    SegMemory& segfmem = *segfmemp;
     DistBrws distbrws(segfmem);
 
     //-------------------------------------------------------------------------
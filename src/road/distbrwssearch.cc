@@ -12,6 +12,9 @@
 #include "bound.h"
 #include "point.h"
 #include <stdio.h>
+#include <memory>
+#include <vector>
+#include <unordered_map>
 
     class nodeobj
     {
@@ -22,7 +25,10 @@
         float       m_accdist;  // accumulated distance
         float       m_preddist; // predicted distance (remainder part)
         int         m_nextnode; // next node to be visited
-        Array       m_path;     // path towards the objects
+        NodePath    m_path;     // path towards the objects
+        bool        m_pend;     // the lookup at m_nextnode is done:
+        int         m_pendnext; // ... its next node and mindist
+        float       m_pendmin;
     public:
         nodeobj(
             const int a_objid, const int a_nodeid,
@@ -34,7 +40,8 @@
           m_pt(a_pt),
           m_accdist(a_accdist),
           m_preddist(a_preddist),
-          m_nextnode(a_nextnode)
+          m_nextnode(a_nextnode),
+          m_pend(false)
         {};
         ~nodeobj(){};
         static int compare(const void* a0, const void* a1)
@@ -53,6 +60,120 @@
         };
     };
 
+    // ------------------------------------------------------------------------
+    // the hops of a query: the quadtree and the node of a network node are
+    // read once, and the candidates heading to it wait there; when the first
+    // of them is expanded the lookups of all run in one pass of its quadtree
+    // (each still advances in its own turn, so the order is kept)
+    // ------------------------------------------------------------------------
+    class hops
+    {
+    public:
+        class hop
+        {
+        public:
+            SPMortonList                m_tree;
+            std::shared_ptr<const Node> m_node;
+            std::vector<nodeobj*>       m_wait;
+        };
+        Graph&                          m_graph;
+        DistBrws&                       m_distbrws;
+        const Bound&                    m_bound;
+        std::unordered_map<int,hop>     m_hop;
+        std::vector<nodeobj*>           m_all;  // candidates, deleted at the end
+    public:
+        hops(Graph& a_graph, DistBrws& a_distbrws, const Bound& a_bound):
+          m_graph(a_graph), m_distbrws(a_distbrws), m_bound(a_bound)
+        {};
+        ~hops()
+        {
+            for (int i=0; i<(int)m_all.size(); i++)
+                delete m_all[i];
+        };
+        hop& fetch(const int a_nid)
+        {
+            hop& p = m_hop[a_nid];
+            if (!p.m_node)
+            {
+                p.m_node = m_graph.getSharedNode(a_nid);
+                p.m_tree = m_distbrws.getQuadtree(a_nid, m_bound).copy();
+            }
+            return p;
+        };
+        void wait(nodeobj* a_no)
+        {
+            if (a_no->m_nextnode != a_no->m_nodeid)
+                m_hop[a_no->m_nextnode].m_wait.push_back(a_no);
+        };
+        // candidates of the objects on a_nodes, from the source
+        void start(const int a_src, const Array& a_nodes,
+                   std::vector<nodeobj*>& a_cand)
+        {
+            hop& p = fetch(a_src);
+            const int n = a_nodes.size();
+            std::vector<Point> pt;
+            pt.reserve(n);
+            for (int i=0; i<n; i++)
+            {
+                std::shared_ptr<const Node> node = m_graph.getSharedNode((long)a_nodes.get(i));
+                float f[2];
+                f[0] = node->m_x;
+                f[1] = node->m_y;
+                pt.push_back(Point(2,f));
+            }
+            std::vector<const Point*> pp(n);
+            std::vector<int> next(n);
+            std::vector<float> mindist(n);
+            for (int i=0; i<n; i++)
+                pp[i] = &pt[i];
+            p.m_tree.lookup(pp.data(), n, next.data(), mindist.data());
+            for (int i=0; i<n; i++)
+            {
+                nodeobj* no = new nodeobj(
+                    i, (long)a_nodes.get(i), pt[i], 0, mindist[i], next[i]);
+                m_all.push_back(no);
+                wait(no);
+                a_cand.push_back(no);
+            }
+        };
+        // a candidate one hop on, to the next node of the quadtree of its
+        // next node
+        void advance(nodeobj* a_no)
+        {
+            const int nid = a_no->m_nextnode;
+            hop& p = fetch(nid);
+            if (!a_no->m_pend)
+            {
+                std::vector<nodeobj*> w(1, a_no);
+                for (int i=0; i<(int)p.m_wait.size(); i++)
+                {
+                    nodeobj* no = p.m_wait[i];
+                    if (no != a_no && no->m_nextnode == nid && !no->m_pend)
+                        w.push_back(no);
+                }
+                p.m_wait.clear();
+                std::vector<const Point*> pp(w.size());
+                std::vector<int> next(w.size());
+                std::vector<float> mindist(w.size());
+                for (int i=0; i<(int)w.size(); i++)
+                    pp[i] = &w[i]->m_pt;
+                p.m_tree.lookup(pp.data(), w.size(), next.data(), mindist.data());
+                for (int i=0; i<(int)w.size(); i++)
+                {
+                    w[i]->m_pend = true;
+                    w[i]->m_pendnext = next[i];
+                    w[i]->m_pendmin = mindist[i];
+                }
+            }
+            a_no->m_path.append(nid);
+            a_no->m_preddist = a_no->m_pendmin;
+            a_no->m_nextnode = a_no->m_pendnext;
+            a_no->m_pend = false;
+            a_no->m_accdist += p.m_node->cost(a_no->m_nextnode);
+            wait(a_no);
+        };
+    };
+
 void DistBrwsSearch::rangeSearch(Graph &a_graph,
 								 DistBrws &a_distbrws, const Bound& a_bound,
 								 const Array& a_nodes,
@@ -61,22 +182,12 @@ void DistBrwsSearch::rangeSearch(Graph &a_graph,
 								 int &a_nodeaccess, int &a_edgeaccess)
 {
     Queue q;
+    hops w(a_graph, a_distbrws, a_bound);
 
-    SPQuadtree* tree = a_distbrws.getNode(a_src, a_bound);
-    for (int i=0; i<a_nodes.size(); i++)
-    {
-        int nodeid = (long)a_nodes.get(i);
-        Node* node = a_graph.getNode(nodeid);
-        float p[2];
-        p[0] = node->m_x;
-        p[1] = node->m_y;
-        Point pt(2,p);
-        const int nextnode = tree->next(pt);
-        const float preddist = tree->mindist(pt);
-        q.enqueue(new nodeobj(i, nodeid, pt, 0, preddist, nextnode));
-        delete node;
-    }
-    delete tree;
+    std::vector<nodeobj*> cand;
+    w.start(a_src, a_nodes, cand);
+    for (int i=0; i<(int)cand.size(); i++)
+        q.enqueue(cand[i]);
 
     while (!q.isEmpty())
     {
@@ -86,10 +197,7 @@ void DistBrwsSearch::rangeSearch(Graph &a_graph,
         // clean up
         //---------------------------------------------------------------------
 		if (no->m_accdist + no->m_preddist >= a_range)
-        {
-            delete no;
             continue;
-        }
 
 
         //---------------------------------------------------------------------
@@ -102,21 +210,12 @@ void DistBrwsSearch::rangeSearch(Graph &a_graph,
                 new ObjectSearchResult(no->m_nodeid, no->m_path, no->m_accdist);
             res->m_objects.append((void*)no->m_objid);
             a_result.append((void*)res);
-            delete no;
         }
         else
         {
-            Node* node = a_graph.getNode(no->m_nextnode);
-            SPQuadtree* tree = a_distbrws.getNode(no->m_nextnode, a_bound);
-            no->m_path.append((void*)no->m_nextnode);
-            no->m_preddist = tree->mindist(no->m_pt);
-            no->m_nextnode = tree->next(no->m_pt);
-            no->m_accdist += node->cost(no->m_nextnode);
-
+            w.advance(no);
             q.enqueue(no);
 
-            delete node;
-            delete tree;
 
             a_nodeaccess++;
             a_edgeaccess++;
@@ -133,24 +232,12 @@ void DistBrwsSearch::nnSearch(Graph &a_graph,
 {
 
     BinHeap h(nodeobj::compare);
-	
+    hops w(a_graph, a_distbrws, a_bound);
 
-    SPQuadtree* tree = a_distbrws.getNode(a_src, a_bound);
-    for (int i=0; i<nodes.size(); i++)
-    {
-        int nodeid = (long)nodes.get(i);
-        Node* node = a_graph.getNode(nodeid);
-        float p[2];
-        p[0] = node->m_x;
-        p[1] = node->m_y;
-        Point pt(2,p);
-        const int nextnode = tree->next(pt);
-        const float preddist = tree->mindist(pt);
-//		printf("no=%d next=%d\n", i, nextnode );
-        h.insert(new nodeobj(i, nodeid, pt, 0, preddist, nextnode));
-        delete node;
-    }
-    delete tree;
+    std::vector<nodeobj*> cand;
+    w.start(a_src, nodes, cand);
+    for (int i=0; i<(int)cand.size(); i++)
+        h.insert(cand[i]);
 
 
     while (!h.isEmpty())
@@ -159,14 +246,11 @@ void DistBrwsSearch::nnSearch(Graph &a_graph,
 
 		
         //---------------------------------------------------------------------
-        // clean up
+        // clean up(the candidates left are deleted with the hops; an object
+        // with no next node is unreachable)
         //---------------------------------------------------------------------
-        if (a_result.size() >= a_k)
-        {
-            delete no;
+        if (a_result.size() >= a_k || no->m_nextnode == -1)
             continue;
-        }
-		// printf("%d %d %f %f %d\n", no->m_objid, no->m_nodeid, no->m_accdist, no->m_preddist, no->m_nextnode );
         //---------------------------------------------------------------------
         // exploring the path towards the object
         //---------------------------------------------------------------------
@@ -177,21 +261,12 @@ void DistBrwsSearch::nnSearch(Graph &a_graph,
                 new ObjectSearchResult(no->m_nodeid, no->m_path, no->m_accdist);
             res->m_objects.append((void*)no->m_objid);
             a_result.append((void*)res);
-            delete no;
         }
         else
         {
-            Node* node = a_graph.getNode(no->m_nextnode);
-            SPQuadtree* tree = a_distbrws.getNode(no->m_nextnode, a_bound);
-            no->m_path.append((void*)no->m_nextnode);
-            no->m_preddist = tree->mindist(no->m_pt);
-            no->m_nextnode = tree->next(no->m_pt);
-            no->m_accdist += node->cost(no->m_nextnode);
-
+            w.advance(no);
             h.insert(no);
 
-            delete node;
-            delete tree;
 
             a_nodeaccess++;
             a_edgeaccess++;
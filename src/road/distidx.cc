@@ -9,9 +9,16 @@
 #include "node.h"
 #include "segmem.h"
 #include "distsign.h"
+#include "nodecache.h"
+#include "graph.h"
+#include "graphsearch.h"
+#include <string.h>
+#include <algorithm>
 
-DistIndex::DistIndex(SegMemory& a_nodeMem):
+DistIndex::DistIndex(SegMemory& a_nodeMem, const bool a_packed):
 m_nodeMem(a_nodeMem),
+m_cache(0),
+m_packed(a_packed),
 m_nodes(10000)
 {
     if (m_nodeMem.m_header == -1) return;
@@ -22,12 +29,28 @@ m_nodes(10000)
     char* nodepos = (char*)m_nodeMem.read(m_nodeMem.m_header);
     int len=0;
     int sz = *(int*)&nodepos[len];              len+=sizeof(int);
+    const bool tombstones = sz == DISTIDX_TOMBSTONES;
+    if (tombstones)
+    {
+        sz = *(int*)&nodepos[len];              len+=sizeof(int);
+    }
     for (int i=0; i<sz; i++)
     {
         int nodeid = *(int*)&nodepos[len];      len+=sizeof(int);
         int pos = *(int*)&nodepos[len];         len+=sizeof(int);
         m_nodes.put(nodeid,(void*)pos);
     }
+    if (tombstones)
+    {
+        int cnt = *(int*)&nodepos[len];         len+=sizeof(int);
+        for (int i=0; i<cnt; i++)
+        {
+            m_deleted.put(*(int*)&nodepos[len], 1);
+            len+=sizeof(int);
+        }
+        for (HashReader rdr(m_nodes); !rdr.isEnd(); rdr.next())
+            m_stale.push_back(rdr.getKey());    // compact starts over
+    }
 
     // ------------------------------------------------------------------------
     // reset memory access history (which is used to estimate IO cost)
@@ -49,19 +72,48 @@ DistIndex::~DistIndex()
     // write the header (meta data) into memory
     // ------------------------------------------------------------------------
     int len=0;
-    char* mem = new char[sz*sizeof(int)*2 + sizeof(int)];
+    const int cnt = m_deleted.size();
+    char* mem = new char[sz*sizeof(int)*2 + sizeof(int)*(cnt > 0 ? cnt+3 : 1)];
+    if (cnt > 0)
+    {
+        *(int*)&mem[len] = DISTIDX_TOMBSTONES;  len += sizeof(int);
+    }
     *(int*)&mem[len] = sz;                      len += sizeof(int);
     for (HashReader rdr(m_nodes); !rdr.isEnd(); rdr.next())
     {
         *(int*)&mem[len] = (int)rdr.getKey();   len += sizeof(int);
         *(int*)&mem[len] = (long)rdr.getVal();   len += sizeof(int);
     }
+    if (cnt > 0)
+    {
+        *(int*)&mem[len] = cnt;                 len += sizeof(int);
+        for (int s=0; s<m_deleted.capacity(); s++)
+            if (m_deleted.used(s))
+            {
+                *(int*)&mem[len] = m_deleted.key(s);    len += sizeof(int);
+            }
+    }
     m_nodeMem.m_header = m_nodeMem.allocate(mem,len);
     delete[] mem;
 }
 
 int DistIndex::writeNode(const int a_nid, Array& a)
 {
+    return writeNode(a_nid, a, m_packed);
+}
+
+int DistIndex::writeNode(const int a_nid, Array& a, const bool a_packed)
+{
+    if (a_packed)
+    {
+        char* mem = new char[PackedSignatures::size(a.size())];
+        int len = 0;
+        PackedSignatures::toMem(a, mem, len);
+        store(a_nid, mem, len);
+        delete[] mem;
+        return 0;
+    }
+
     // ------------------------------------------------------------------------
     // ordering objects by non-decreasing cost
     // ------------------------------------------------------------------------
@@ -70,7 +122,7 @@ int DistIndex::writeNode(const int a_nid, Array& a)
     // ------------------------------------------------------------------------
     // write a node into memory
     // ------------------------------------------------------------------------
-    int n = a.size() * 20;
+    int n = a.size() * sizeof(int)*3 + sizeof(int);
     char* mem = new char[n];
     int len=0;
     *(int*)&mem[len] = a.size();        len += sizeof(int);
@@ -81,29 +133,209 @@ int DistIndex::writeNode(const int a_nid, Array& a)
         *(float*)&mem[len] = s->m_cost; len += sizeof(int);
         *(int*)&mem[len] = s->m_prev;   len += sizeof(int);
     }
-    int pos = m_nodeMem.allocate(mem,len);
-    m_nodes.put(a_nid, (void*)pos);
+    store(a_nid, mem, len);
     delete[] mem;
     return 0;
 }
 
+// a record of a node: in place of the one it has if it fits
+void DistIndex::store(const int a_nid, char* a_mem, const int a_len)
+{
+    int pos = (long)m_nodes.get(a_nid);
+    if (pos != 0)
+        m_nodes.replace(a_nid, (void*)m_nodeMem.reallocate(pos, a_mem, a_len));
+    else
+        m_nodes.put(a_nid, (void*)m_nodeMem.allocate(a_mem, a_len));
+}
+
+void DistIndex::setPacked(const bool a_packed)
+{
+    m_packed = a_packed;
+}
+
+void DistIndex::rewriteNode(const int a_nid, Array& a)
+{
+    int pos = (long)m_nodes.get(a_nid);
+    bool packed = pos == 0 ? m_packed :
+        PackedSignatures::isPacked((char*)m_nodeMem.read(pos));
+    writeNode(a_nid, a, packed);
+    if (m_cache != 0)
+        m_cache->remove(a_nid);
+}
+
+// ----------------------------------------------------------------------------
+// update: objects
+// ----------------------------------------------------------------------------
+int DistIndex::insertObject(Graph& a_graph, const int a_oid, const int a_nid)
+{
+    return insertObjects(a_graph, &a_oid, &a_nid, 1) == 1 ? 0 : -1;
+}
+
+int DistIndex::insertObjects(Graph& a_graph, const int* a_oid, const int* a_nid,
+                             const int a_cnt)
+{
+    // ------------------------------------------------------------------------
+    // the distance from every node to each object: its new signatures
+    // ------------------------------------------------------------------------
+    FlatHash<int, std::vector<PackedSignatures::Sign> > sign;
+    FlatHash<int,int> added;
+    std::vector<int> oid, nid;
+    for (int i=0; i<a_cnt; i++)
+    {
+        if (isDeleted(a_oid[i]) || added.in(a_oid[i]) ||
+            (m_nodes.get(a_nid[i]) != 0 && getSignatures(a_nid[i]).find(a_oid[i]) != 0))
+            continue;
+        added.put(a_oid[i], 1);
+        oid.push_back(a_oid[i]);
+        nid.push_back(a_nid[i]);
+    }
+
+    for (int from=0; from<(int)oid.size(); from+=MSLANES)
+    {
+        const int num = std::min(MSLANES, (int)oid.size() - from);
+        std::vector<Array> toAllNodes(num, Array(a_graph.m_nodes.size()));
+        GraphSearch::spanSearch(a_graph, &nid[from], num, &toAllNodes[0]);
+        for (int i=0; i<num; i++)
+            for (int j=0; j<toAllNodes[i].size(); j++)
+            {
+                GraphSearchResult* res =
+                    (GraphSearchResult*)toAllNodes[i].get(j);
+                PackedSignatures::Sign s;
+                s.m_oid = oid[from+i];
+                s.m_cost = res->m_cost;
+                s.m_prev = (long)res->m_path.get(0);
+                std::vector<PackedSignatures::Sign>* v = sign.find(res->m_nid);
+                if (v == 0)
+                {
+                    sign.put(res->m_nid, std::vector<PackedSignatures::Sign>());
+                    v = sign.find(res->m_nid);
+                }
+                v->push_back(s);
+                delete res;
+            }
+    }
+
+    // ------------------------------------------------------------------------
+    // the nodes patched: a rewrite each
+    // ------------------------------------------------------------------------
+    for (int slot=0; slot<sign.capacity(); slot++)
+    {
+        if (!sign.used(slot)) continue;
+        const int nid = sign.key(slot);
+        const std::vector<PackedSignatures::Sign>& v = sign.val(slot);
+        Array a;
+        if (m_nodes.get(nid) != 0)
+            getSignatures(nid).toArray(a);
+        for (int j=0; j<(int)v.size(); j++)
+            a.append(new DistSignature(v[j].m_oid, v[j].m_cost, v[j].m_prev));
+        rewriteNode(nid, a);
+        for (int j=0; j<a.size(); j++)
+            delete (DistSignature*)a.get(j);
+    }
+    return added.size();
+}
+
+int DistIndex::deleteObject(const int a_oid)
+{
+    if (!m_deleted.put(a_oid, 1))
+        return -1;
+
+    // ------------------------------------------------------------------------
+    // every node holds a signature of it: compact goes over all(again)
+    // ------------------------------------------------------------------------
+    m_stale.clear();
+    for (HashReader rdr(m_nodes); !rdr.isEnd(); rdr.next())
+        m_stale.push_back(rdr.getKey());
+    return 0;
+}
+
+int DistIndex::compact(const int a_nodes)
+{
+    for (int n=0; !m_stale.empty() && (a_nodes < 0 || n < a_nodes); n++)
+    {
+        int nid = m_stale.back();
+        m_stale.pop_back();
+
+        PackedSignatures s = getSignatures(nid);
+        Array a;
+        bool changed = false;
+        for (int j=0; j<s.size(); j++)
+        {
+            const PackedSignatures::Sign* d = s.byID(j);
+            if (isDeleted(d->m_oid))
+                changed = true;
+            else
+                a.append(new DistSignature(d->m_oid, d->m_cost, d->m_prev));
+        }
+        if (changed)
+            rewriteNode(nid, a);
+        for (int j=0; j<a.size(); j++)
+            delete (DistSignature*)a.get(j);
+    }
+    if (m_stale.empty())
+        m_deleted.clean();
+    return m_stale.size();
+}
+
 Array* DistIndex::getNode(const int a_nid)
 {
     // ------------------------------------------------------------------------
     // retrieve the distance signature of a node from memory
     // ------------------------------------------------------------------------
+    Array* a = new Array;
+    getSignatures(a_nid).toArray(*a);
+    return a;
+}
+
+static void deleteSignatures(const Array* a)
+{
+    for (int i=0; i<a->size(); i++)
+        delete (DistSignature*)a->get(i);
+    delete a;
+}
+
+std::shared_ptr<const Array> DistIndex::getSharedNode(const int a_nid)
+{
+    return std::shared_ptr<const Array>(getNode(a_nid), deleteSignatures);
+}
+
+PackedSignatures DistIndex::getSignatures(const int a_nid)
+{
+    if (m_cache != 0)
+    {
+        NodeCache::Handle h = m_cache->find(a_nid);
+        if (h) return PackedSignatures((const char*)h.get(), h);
+    }
     int pos = (long)m_nodes.get(a_nid);
+    if (pos == 0) return PackedSignatures();               // not indexed
     char* mem = (char*)m_nodeMem.read(pos);
-    int len=0;
+    if (PackedSignatures::isPacked(mem) && m_cache == 0)
+        return PackedSignatures(mem);
 
-    Array* a = new Array;
-    int sz = *(int*)&mem[len];              len += sizeof(int);
-    for (int i=0; i<sz; i++)
+    // ------------------------------------------------------------------------
+    // a copy of the record, packed if in the id layout
+    // ------------------------------------------------------------------------
+    std::shared_ptr<char> rec;
+    int len = 0;
+    if (PackedSignatures::isPacked(mem))
     {
-        int oid = *(int*)&mem[len];         len += sizeof(int);
-        float cost = *(float*)&mem[len];    len += sizeof(float);
-        int prev = *(int*)&mem[len];        len += sizeof(int);
-        a->append(new DistSignature(oid, cost, prev));
+        len = PackedSignatures(mem).length();
+        rec.reset(new char[len], std::default_delete<char[]>());
+        memcpy(rec.get(), mem, len);
     }
-    return a;
+    else
+    {
+        rec.reset(new char[PackedSignatures::size(*(int*)mem)],
+            std::default_delete<char[]>());
+        PackedSignatures::fromIDLayout(mem, rec.get(), len);
+    }
+    NodeCache::Handle h = rec;
+    if (m_cache != 0)
+        h = m_cache->insert(a_nid, h, len);
+    return PackedSignatures((const char*)h.get(), h);
+}
+
+void DistIndex::setCache(NodeCache* a_cache)
+{
+    m_cache = a_cache;
 }
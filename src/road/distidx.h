@@ -9,30 +9,80 @@
     This file contains a class DistIndex declaration.
     That maps objects to individual nodes and indexes their distance using
     a distance signature
+    Signatures are written in the id layout or, if set, the packed layout
+    (PackedSignatures) that searches read in place.
+    Objects are inserted with one expansion that patches the signatures of
+    the nodes it reaches; deleted objects are tombstones(kept in the header,
+    skipped by the searches) until compact rewrites the nodes without them.
 ---------------------------------------------------------------------------- */
 #ifndef distidx_defined
 #define distidx_defined
 
 #include "collection.h"
+#include "flathash.h"
+#include "packedsign.h"
+#include <memory>
+#include <vector>
+
+#define DISTIDX_TOMBSTONES  -1      // header tag: tombstones follow the nodes
 
 class SegMemory;
+class NodeCache;
+class Graph;
 
 class DistIndex
 {
 protected:
     SegMemory&  m_nodeMem;  // handle of memory of distance signature
+    NodeCache*  m_cache;    // signature records(0: none)
+    bool        m_packed;   // write the packed layout
+    FlatHash<int,int>   m_deleted;  // tombstones: objects deleted
+    std::vector<int>    m_stale;    // nodes compact has yet to rewrite
+
+    int writeNode(const int a_nid, Array& a, const bool a_packed);
+    void store(const int a_nid, char* a_mem, const int a_len);
+    void rewriteNode(const int a_nid, Array& a);    // in the layout it has
 public:
     Hash        m_nodes;    // hash of distance signatures in memory
 public:
     // constructor/destructor
-    DistIndex(SegMemory& a_nodeMem);
+    DistIndex(SegMemory& a_nodeMem, const bool a_packed=false);
     virtual ~DistIndex();
     //
     // update
     int writeNode(const int a_nid, Array& a);   // array of distance signatures
+    void setPacked(const bool a_packed);
+    //
+    // update: objects. insertObject -1 if the object is in the index
+    // (deleted objects too, until compacted); insertObjects rewrites each
+    // node once for a_cnt objects(their signatures are kept until then)
+    // and returns the objects inserted; compact rewrites at most a_nodes
+    // (-1: all) nodes and returns the nodes left, so it can run a slice at
+    // a time in idle time
+    int insertObject(Graph& a_graph, const int a_oid, const int a_nid);
+    int insertObjects(Graph& a_graph, const int* a_oid, const int* a_nid,
+                      const int a_cnt);
+    int deleteObject(const int a_oid);
+    int compact(const int a_nodes=-1);
+    bool isDeleted(const int a_oid) const
+    {
+        return m_deleted.size() > 0 && m_deleted.in(a_oid);
+    };
     //
     // search
-    virtual Array* getNode(const int a_nid);
+    virtual Array* getNode(const int a_nid);    // new signatures, deleted by the caller
+    virtual std::shared_ptr<const Array> getSharedNode(const int a_nid);
+    SegMemory& memory() const { return m_nodeMem; };    // of the signatures
+    //
+    // signatures of a node in the packed layout: in place in the memory(a
+    // mapped file, or the read buffer of the calling thread until its next
+    // read) if so stored; otherwise, or with a cache, the view holds a copy
+    // of the record. the cache keeps records: an Array shared from it is
+    // decoded again per call
+    PackedSignatures getSignatures(const int a_nid);
+    //
+    // cache of signature records(not owned, 0 to stop caching)
+    void setCache(NodeCache* a_cache);
 };
 
 #endif
@@ -18,10 +18,14 @@
     -s: #sources
     -k: #NNs
     -v: turn verbose mode on (default: off)
+    -t: threads for the query points of a group (default: 1)
+    -a: aggregate cost, max or sum (default: max)
+    -m: map index files read-only, advised random, sequential, normal,
+        willneed or preload (default: off, buffered reads)
 ---------------------------------------------------------------------------- */
 
 #include "graph.h"
-#include "segfmem.h"
+#include "segmapmem.h"
 #include "param.h"
 #include "collection.h"
 #include "distidx.h"
@@ -35,6 +39,8 @@
 #include <stdlib.h>
 #include <math.h>
 #include <iostream>
+#include <vector>
+#include <memory>
 #include <fstream>
 
 using namespace std;
@@ -53,6 +59,9 @@ void helpmsg(const char* pgm)
     cerr << "-s: #sources" << endl;
     cerr << "-k: #NNs" << endl;
     cerr << "-v: turn verbose mode on (default: off)" << endl;
+    cerr << "-t: threads for the query points of a group (default: 1)" << endl;
+    cerr << "-a: aggregate cost, max or sum (default: max)" << endl;
+    cerr << "-m: map index files: random, sequential, normal, willneed or preload (default: off)" << endl;
 }
 
 int main(const int a_argc, const char** a_argv)
@@ -73,13 +82,19 @@ int main(const int a_argc, const char** a_argv)
     const char* cnumsrc = Param::read(a_argc, a_argv, "-s", "");
     const char* ck = Param::read(a_argc, a_argv, "-k", "");
     const char* vrbs = Param::read(a_argc, a_argv, "-v", "null");
+    const char* cmap = Param::read(a_argc, a_argv, "-m", "");
     bool verbose = strcmp(vrbs,"null") != 0;
+    int threads = atoi(Param::read(a_argc, a_argv, "-t", "1"));
+    if (threads < 1) threads = 1;
+    const int agg = strcmp(Param::read(a_argc, a_argv, "-a", "max"), "sum") == 0 ?
+        GROUP_SUM : GROUP_MAX;
 
     //-------------------------------------------------------------------------
     // access graph index file
     //-------------------------------------------------------------------------
     cerr << "loading a graph index ... ";
-    SegFMemory segmem(idxflname, PAGESIZE*10, PAGESIZE, 32, false);
+    std::unique_ptr<SegMemory> segmemp(SegMapMemory::open(idxflname, cmap, PAGESIZE*10, PAGESIZE, 32));
+    SegMemory& segmem = *segmemp;
     Graph graph(segmem);
     int graphsize = segmem.size();
     cerr << "[DONE]" << endl;
@@ -88,7 +103,8 @@ int main(const int a_argc, const char** a_argv)
     // access distance index
     //-------------------------------------------------------------------------
     cerr << "loading distance index ... ";
-    SegFMemory segdmem(didxflname, PAGESIZE*10, PAGESIZE, 32, false);
+    std::unique_ptr<SegMemory> segdmemp(SegMapMemory::open(didxflname, cmap, PAGESIZE*10, PAGESIZE, 32));
+    SegMemory& segdmem = *segdmemp;
     DistIndex didx(segdmem);
     int didxsize = segdmem.size();
     cerr << "[DONE]" << endl;
@@ -131,7 +147,7 @@ int main(const int a_argc, const char** a_argv)
         //----------------------------------------------------------------------
         // find query point
         //----------------------------------------------------------------------
-        int src[MAXQUERY];
+        std::vector<int> src(numsrc);
         for (int j=0; j<numsrc; j++)
             while ((src[j] = (int)((rand()%1000 / 1000.0f)*nodecnt)) > nodecnt);
 
@@ -140,8 +156,8 @@ int main(const int a_argc, const char** a_argv)
         //----------------------------------------------------------------------
         ftime(&starttime);  // time the algorithm
         DistIndexSearch::groupKNNSearch(
-            graph, didx, src, numsrc, k,
-            result, nodeaccess, edgeaccess);
+            graph, didx, src.data(), numsrc, k,
+            result, nodeaccess, edgeaccess, agg, threads);
         ftime(&endtime);
         float qtime = 
             ((endtime.time*1000 + endtime.millitm) -
@@ -15,6 +15,13 @@
     -i: graph index file (input)
     -o: object file
     -d: distance index
+    -f: signature layout: packed(by cost, see PackedSignatures) or id
+        (default: packed). packed is faster to search but larger, about
+        a third on cal with 300 objects; id keeps the smaller index
+    -j: threads for the signatures (default: 1)
+    -b: memory budget of the signatures in MB(default: 256): the objects
+        go in batches whose signatures fit, each batch is a sorted run in
+        a temporary file, the runs are merged into the index
     -v: turn verbose mode on (default: off)
 ---------------------------------------------------------------------------- */
 
@@ -32,12 +39,134 @@
 #include <sys/timeb.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include <iostream>
 #include <fstream>
+#include <vector>
+#include <algorithm>
+#include "../common/task_pool.h"
 
 using namespace std;
 
 #define PAGESIZE    4096
+#define RUNBLOCK    4096    // records read at a time from a run
+#define MAXRUNS     64      // runs merged at a time(open temporary files)
+
+// ----------------------------------------------------------------------------
+// a distance signature on its way to the index, by node then object
+// ----------------------------------------------------------------------------
+class SignRecord
+{
+public:
+    int     m_nid;
+    int     m_oid;
+    float   m_cost;
+    int     m_prev;
+public:
+    bool operator<(const SignRecord& a_r) const
+    {
+        if (m_nid != a_r.m_nid) return m_nid < a_r.m_nid;
+        return m_oid < a_r.m_oid;
+    };
+};
+
+// ----------------------------------------------------------------------------
+// a sorted run: in memory(the only batch) or in a temporary file read back
+// a block at a time
+// ----------------------------------------------------------------------------
+class SignRun
+{
+protected:
+    FILE*               m_fp;
+    vector<SignRecord>  m_buf;
+    int                 m_pos;
+
+    void fill()
+    {
+        m_buf.resize(RUNBLOCK);
+        m_buf.resize(fread(&m_buf[0], sizeof(SignRecord), RUNBLOCK, m_fp));
+        m_pos = 0;
+    };
+public:
+    SignRun(vector<SignRecord>& a_rec, const bool a_spill): m_fp(0), m_pos(0)
+    {
+        if (!a_spill)
+        {
+            m_buf.swap(a_rec);
+            return;
+        }
+        m_fp = create();
+        write(m_fp, a_rec);
+        vector<SignRecord>().swap(a_rec);
+        rewind(m_fp);
+        fill();
+    };
+    SignRun(FILE* a_fp): m_fp(a_fp), m_pos(0)   // a written temporary file
+    {
+        rewind(m_fp);
+        fill();
+    };
+    virtual ~SignRun()
+    {
+        if (m_fp != 0) fclose(m_fp);
+    };
+    static FILE* create()
+    {
+        FILE* fp = tmpfile();
+        if (fp == 0)
+        {
+            cerr << "CANNOT CREATE A RUN" << endl;
+            exit(-1);
+        }
+        return fp;
+    };
+    static void write(FILE* a_fp, const vector<SignRecord>& a_rec)
+    {
+        if (a_rec.size() > 0 &&
+            fwrite(&a_rec[0], sizeof(SignRecord), a_rec.size(), a_fp) != a_rec.size())
+        {
+            cerr << "CANNOT WRITE A RUN" << endl;
+            exit(-1);
+        }
+    };
+    bool isEnd() const              { return m_pos >= (int)m_buf.size(); };
+    const SignRecord& top() const   { return m_buf[m_pos]; };
+    void next()
+    {
+        if (++m_pos >= (int)m_buf.size() && m_fp != 0)
+            fill();
+    };
+};
+
+// ----------------------------------------------------------------------------
+// runs merged into one, a block written at a time
+// ----------------------------------------------------------------------------
+static SignRun* mergeRuns(vector<SignRun*>& a_runs)
+{
+    FILE* fp = SignRun::create();
+    vector<SignRecord> out;
+    while (true)
+    {
+        int m = -1;
+        for (int i=0; i<(int)a_runs.size(); i++)
+            if (!a_runs[i]->isEnd() &&
+                (m == -1 || a_runs[i]->top() < a_runs[m]->top()))
+                m = i;
+        if (m == -1 || (int)out.size() == RUNBLOCK)
+        {
+            SignRun::write(fp, out);
+            out.clear();
+        }
+        if (m == -1)
+            break;
+        out.push_back(a_runs[m]->top());
+        a_runs[m]->next();
+    }
+    for (int i=0; i<(int)a_runs.size(); i++)
+        delete a_runs[i];
+    a_runs.clear();
+    return new SignRun(fp);
+}
 
 void helpmsg(const char* pgm)
 {
@@ -48,6 +177,10 @@ void helpmsg(const char* pgm)
     cerr << "-i: graph index file" << endl;
     cerr << "-o: object file" << endl;
     cerr << "-d: distance index" << endl;
+    cerr << "-f: signature layout: packed or id (default: packed)" << endl;
+    cerr << "    packed is faster to search but about a third larger, id is smaller" << endl;
+    cerr << "-j: threads for the signatures (default: 1)" << endl;
+    cerr << "-b: memory budget of the signatures in MB (default: 256)" << endl;
     cerr << "-v: turn verbose mode on (default: off)" << endl;
 }
 
@@ -67,7 +200,12 @@ int main(const int a_argc, const char** a_argv)
     const char* objflname = Param::read(a_argc, a_argv, "-o", "");
     const char* didxflname= Param::read(a_argc, a_argv, "-d", "");
     const char* vrbs = Param::read(a_argc, a_argv, "-v", "null");
+    const char* layout = Param::read(a_argc, a_argv, "-f", "packed");
     bool verbose = strcmp(vrbs,"null") != 0;
+    bool packed = strcmp(layout,"id") != 0;
+    int threads = atoi(Param::read(a_argc, a_argv, "-j", "1"));
+    long budget = atol(Param::read(a_argc, a_argv, "-b", "256"))*1024*1024;
+    if (threads < 1) threads = 1;
 
     //-------------------------------------------------------------------------
     // access graph index file
@@ -78,52 +216,89 @@ int main(const int a_argc, const char** a_argv)
     cerr << "[DONE]" << endl;
 
     //-------------------------------------------------------------------------
-    // access object file and create distance index
+    // access object file
     //-------------------------------------------------------------------------
     cerr << "loading objects ... ";
-    struct timeb starttime, endtime;
-    float idxtime=0;
-    int numobj=0;
-    int numnodes=0;
-
-    Hash nodedistsign;  // keep distance signatures as an array for each node
-    Array nodes;        // keep node ids
+    vector<int> objnode, objid;
     fstream fobj;
     fobj.open(objflname, ios::in);
-    ftime(&starttime);  // time the the object index creation
-
     while (true)
     {
-        int nodeid, objid;
+        int nodeid, oid;
         fobj >> nodeid;
         if (fobj.eof())
             break;
-        fobj >> objid;
+        fobj >> oid;
+        objnode.push_back(nodeid);
+        objid.push_back(oid);
+    }
+    int numobj = objnode.size();
+    cerr << "[DONE]" << endl;
 
-        // find object distance to every node
-        segmem.m_history.clean();
-        Array toAllNodes(graph.m_nodes.size());
-        GraphSearch::spanSearch(graph, nodeid, toAllNodes);
-        for (int i=0; i<toAllNodes.size(); i++)
+    //-------------------------------------------------------------------------
+    // create distance signatures: a batch of objects at a time, their
+    // distance to every node found on the workers(each with its own buffer
+    // and read history) MSLANES objects per search, each buffer sorted by
+    // node into a run. MAXRUNS
+    // runs of a level are merged into one of the next level
+    //-------------------------------------------------------------------------
+    cerr << "creating signatures ... ";
+    struct timeb starttime, endtime;
+    float idxtime=0;
+    ftime(&starttime);  // time the the object index creation
+
+    const long nodecnt = graph.m_nodes.size() > 0 ? graph.m_nodes.size() : 1;
+    int batch = budget / (nodecnt * sizeof(SignRecord));
+    if (batch < 1) batch = 1;
+    const bool spill = numobj > batch;
+    vector< vector<SignRun*> > runs(1);
+    vector< vector<SignRecord> > wbuf(threads);
+    vector<Access> whistory(threads);
+    for (int first=0; first<numobj; first+=batch)
+    {
+        int cnt = min(batch, numobj - first);
+        const int lanes = (cnt + MSLANES - 1) / MSLANES;
+        parallel_for(threads, lanes, [&](int worker, int b)
         {
-            GraphSearchResult* res = (GraphSearchResult*)toAllNodes.get(i);
-            int nid = res->m_nid;
-            int prev= (long)res->m_path.get(0);
-            float cost = res->m_cost;
+            segmem.bindHistory(&whistory[worker]);
+            whistory[worker].clean();
+            const int from = first + b*MSLANES;
+            const int num = min(MSLANES, first + cnt - from);
+            vector<Array> toAllNodes(num, Array(graph.m_nodes.size()));
+            GraphSearch::spanSearch(graph, &objnode[from], num, &toAllNodes[0]);
+            for (int i=0; i<num; i++)
+                for (int j=0; j<toAllNodes[i].size(); j++)
+                {
+                    GraphSearchResult* res =
+                        (GraphSearchResult*)toAllNodes[i].get(j);
+                    SignRecord r;
+                    r.m_nid = res->m_nid;
+                    r.m_oid = objid[from+i];
+                    r.m_cost = res->m_cost;
+                    r.m_prev = (long)res->m_path.get(0);
+                    wbuf[worker].push_back(r);
+                    delete res; // clean up
+                }
+        });
+        segmem.bindHistory(0);
 
-            Array* a = (Array*)nodedistsign.get(nid);
-            if (a == 0)
+        for (int t=0; t<threads; t++)
+        {
+            if (wbuf[t].empty()) continue;
+            sort(wbuf[t].begin(), wbuf[t].end());
+            runs[0].push_back(new SignRun(wbuf[t], spill));
+        }
+        for (int l=0; l<(int)runs.size(); l++)
+            if ((int)runs[l].size() >= MAXRUNS)
             {
-                nodedistsign.put(nid, a = new Array);
-                nodes.append((void*)nid);
+                if (l+1 == (int)runs.size())
+                    runs.push_back(vector<SignRun*>());
+                runs[l+1].push_back(mergeRuns(runs[l]));
             }
-            a->append(new DistSignature(objid, cost, prev));
-            delete res; // clean up
-        }
-        toAllNodes.clean();
-
-        numobj++;
     }
+    vector<SignRun*> last;
+    for (int l=0; l<(int)runs.size(); l++)
+        last.insert(last.end(), runs[l].begin(), runs[l].end());
     ftime(&endtime);  // time the the object index creation
     idxtime =
         ((endtime.time*1000 + endtime.millitm) -
@@ -131,24 +306,38 @@ int main(const int a_argc, const char** a_argv)
     cerr << "[DONE]" << endl;
 
     //-------------------------------------------------------------------------
-    // write distance index to memory
+    // write distance index to memory: the runs merged, a node at a time
     //-------------------------------------------------------------------------
     SegFMemory segfmem(didxflname, PAGESIZE*10, PAGESIZE, 32, true);
-    DistIndex didx(segfmem);
-    for (int i=0; i<nodes.size(); i++)
+    segfmem.setAppend(true);            // a node at a time, in order
+    segfmem.setAlign(PAGESIZE);         // a record in as few pages as it can
+    DistIndex didx(segfmem, packed);
+    while (true)
     {
-        int nid = (long)nodes.get(i);
-        Array* a = (Array*)nodedistsign.get(nid);
-        didx.writeNode(nid, *a);
+        int nid = -1;
+        for (int i=0; i<(int)last.size(); i++)
+            if (!last[i]->isEnd() && (nid == -1 || last[i]->top().m_nid < nid))
+                nid = last[i]->top().m_nid;
+        if (nid == -1)
+            break;
 
-        delete a;
+        Array a;
+        for (int i=0; i<(int)last.size(); i++)
+            for (; !last[i]->isEnd() && last[i]->top().m_nid == nid; last[i]->next())
+            {
+                const SignRecord& r = last[i]->top();
+                a.append(new DistSignature(r.m_oid, r.m_cost, r.m_prev));
+            }
+        didx.writeNode(nid, a);
+        for (int i=0; i<a.size(); i++)
+            delete (DistSignature*)a.get(i);
     }
 
     //-------------------------------------------------------------------------
     // clean up
     //-------------------------------------------------------------------------
-    nodedistsign.clean();
-    nodes.clean();
+    for (int i=0; i<(int)last.size(); i++)
+        delete last[i];
 
     cout << "#object:," << numobj;
     cout << ",idxtime:," << idxtime << endl;
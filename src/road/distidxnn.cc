@@ -17,10 +17,12 @@
     -q: #queries
     -k: #NNs
     -v: turn verbose mode on (default: off)
+    -m: map index files read-only, advised random, sequential, normal,
+        willneed or preload (default: off, buffered reads)
 ---------------------------------------------------------------------------- */
 
 #include "graph.h"
-#include "segfmem.h"
+#include "segmapmem.h"
 #include "param.h"
 #include "collection.h"
 #include "distidx.h"
@@ -34,6 +36,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <iostream>
+#include <memory>
 #include <fstream>
 
 using namespace std;
@@ -51,6 +54,7 @@ void helpmsg(const char* pgm)
     cerr << "-q: #queries" << endl;
     cerr << "-k: #NNs" << endl;
     cerr << "-v: turn verbose mode on (default: off)" << endl;
+    cerr << "-m: map index files: random, sequential, normal, willneed or preload (default: off)" << endl;
 }
 
 int main(const int a_argc, const char** a_argv)
@@ -70,13 +74,15 @@ int main(const int a_argc, const char** a_argv)
     const char* cnumquery  = Param::read(a_argc, a_argv, "-q", "");
     const char* ck = Param::read(a_argc, a_argv, "-k", "");
     const char* vrbs = Param::read(a_argc, a_argv, "-v", "null");
+    const char* cmap = Param::read(a_argc, a_argv, "-m", "");
     bool verbose = strcmp(vrbs,"null") != 0;
 
     //-------------------------------------------------------------------------
     // access graph index file
     //-------------------------------------------------------------------------
     cerr << "loading a graph index ... ";
-    SegFMemory segmem(idxflname, PAGESIZE*10, PAGESIZE, 32, false);
+    std::unique_ptr<SegMemory> segmemp(SegMapMemory::open(idxflname, cmap, PAGESIZE*10, PAGESIZE, 32));
+    SegMemory& segmem = *segmemp;
     Graph graph(segmem);
     int graphsize = segmem.size();
     cerr << "[DONE]" << endl;
@@ -85,7 +91,8 @@ int main(const int a_argc, const char** a_argv)
     // access distance index
     //-------------------------------------------------------------------------
     cerr << "loading distance index ... ";
-    SegFMemory segdmem(didxflname, PAGESIZE*10, PAGESIZE, 32, false);
+    std::unique_ptr<SegMemory> segdmemp(SegMapMemory::open(didxflname, cmap, PAGESIZE*10, PAGESIZE, 32));
+    SegMemory& segdmem = *segdmemp;
     DistIndex didx(segdmem);
     int didxsize = segdmem.size();
     cerr << "[DONE]" << endl;
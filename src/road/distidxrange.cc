@@ -15,12 +15,14 @@
     -i: graph index file (input)
     -d: distance index file (input)
     -q: number of query
-    -r: range
+    -r: range, or ranges r1,r2,.. ascending (one search, results by band)
     -v: turn verbose mode on (default: off)
+    -m: map index files read-only, advised random, sequential, normal,
+        willneed or preload (default: off, buffered reads)
 ---------------------------------------------------------------------------- */
 
 #include "graph.h"
-#include "segfmem.h"
+#include "segmapmem.h"
 #include "param.h"
 #include "collection.h"
 #include "distidx.h"
@@ -34,11 +36,13 @@
 #include <stdlib.h>
 #include <math.h>
 #include <iostream>
+#include <memory>
 #include <fstream>
 
 using namespace std;
 
 #define PAGESIZE    4096
+#define MAXBANDS    16
 
 void helpmsg(const char* pgm)
 {
@@ -49,8 +53,9 @@ void helpmsg(const char* pgm)
     cerr << "-i: graph index file" << endl;
     cerr << "-d: distance index file" << endl;
     cerr << "-q: #queries" << endl;
-    cerr << "-r: range " << endl;
+    cerr << "-r: range, or ranges r1,r2,.. ascending (results by band)" << endl;
     cerr << "-v: turn verbose mode on (default: off)" << endl;
+    cerr << "-m: map index files: random, sequential, normal, willneed or preload (default: off)" << endl;
 }
 
 int main(const int a_argc, const char** a_argv)
@@ -70,13 +75,15 @@ int main(const int a_argc, const char** a_argv)
     const char* cnumquery  = Param::read(a_argc, a_argv, "-q", "");
     const char* crange = Param::read(a_argc, a_argv, "-r", "");
     const char* vrbs = Param::read(a_argc, a_argv, "-v", "null");
+    const char* cmap = Param::read(a_argc, a_argv, "-m", "");
     bool verbose = strcmp(vrbs,"null") != 0;
 
     //-------------------------------------------------------------------------
     // access graph index file
     //-------------------------------------------------------------------------
     cerr << "loading a graph index ... ";
-    SegFMemory segmem(idxflname, PAGESIZE*10, PAGESIZE, 32, false);
+    std::unique_ptr<SegMemory> segmemp(SegMapMemory::open(idxflname, cmap, PAGESIZE*10, PAGESIZE, 32));
+    SegMemory& segmem = *segmemp;
     Graph graph(segmem);
     int graphsize = segmem.size();
     cerr << "[DONE]" << endl;
@@ -85,7 +92,8 @@ int main(const int a_argc, const char** a_argv)
     // access distance index
     //-------------------------------------------------------------------------
     cerr << "loading distance index ... ";
-    SegFMemory segdmem(didxflname, PAGESIZE*10, PAGESIZE, 32, false);
+    std::unique_ptr<SegMemory> segdmemp(SegMapMemory::open(didxflname, cmap, PAGESIZE*10, PAGESIZE, 32));
+    SegMemory& segdmem = *segdmemp;
     DistIndex didx(segdmem);
     int didxsize = segdmem.size();
     cerr << "[DONE]" << endl;
@@ -112,12 +120,15 @@ int main(const int a_argc, const char** a_argv)
     float diameter = GraphSearch::diameter(graph,0,nodeaccess,edgeaccess);
     int nodecnt = graph.m_nodes.size();
     int numquery = atol(cnumquery);
-    float range = (float)atof(crange);
+    float range[MAXBANDS], radii[MAXBANDS];
+    const int bands = Param::readList(crange, range, MAXBANDS);
+    for (int b=0; b<bands; b++)
+        radii[b] = range[b]*diameter;
 
     for (int i=0; i<numquery; i++)
     {
         int src = 0;
-        Array result;
+        Array result[MAXBANDS];
         int nodeaccess=0;
         int edgeaccess=0;
         int rescnt=0;
@@ -134,8 +145,8 @@ int main(const int a_argc, const char** a_argv)
         // object search here
         //----------------------------------------------------------------------
         ftime(&starttime);  // time the algorithm
-        DistIndexSearch::rangeSearch(
-            graph, didx, src, range*diameter,
+        DistIndexSearch::multiRangeSearch(
+            graph, didx, src, radii, bands,
             result, nodeaccess, edgeaccess);
         ftime(&endtime);
         float qtime = 
@@ -147,25 +158,33 @@ int main(const int a_argc, const char** a_argv)
         //----------------------------------------------------------------------
         if (verbose)
         {
-            for (int i=0; i<result.size(); i++)
+            int ressize = 0;
+            for (int b=0; b<bands; b++)
             {
-                ObjectSearchResult* r = (ObjectSearchResult*)result.get(i);
-                cerr << r->m_nid << "," << r->m_cost << ":" << r->m_objects.size() << endl;
+                for (int i=0; i<result[b].size(); i++)
+                {
+                    ObjectSearchResult* r = (ObjectSearchResult*)result[b].get(i);
+                    cerr << r->m_nid << "," << r->m_cost << ":" << r->m_objects.size() << endl;
+                }
+                if (bands > 1)
+                    cerr << "-- band: " << range[b] << " -- result size: " << result[b].size() << endl;
+                ressize += result[b].size();
             }
             cerr << "---- time: " << qtime;
-            cerr << " -- result size: " << result.size();
+            cerr << " -- result size: " << ressize;
             cerr << " ----" << endl;
         }
 
         //----------------------------------------------------------------------
         // result clean up
         //----------------------------------------------------------------------
-        for (int i=0; i<result.size(); i++)
-        {
-            ObjectSearchResult* r = (ObjectSearchResult*)result.get(i);
-            rescnt += r->m_objects.size();
-            delete r;
-        }
+        for (int b=0; b<bands; b++)
+            for (int i=0; i<result[b].size(); i++)
+            {
+                ObjectSearchResult* r = (ObjectSearchResult*)result[b].get(i);
+                rescnt += r->m_objects.size();
+                delete r;
+            }
 
 
         //----------------------------------------------------------------------
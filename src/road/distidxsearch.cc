@@ -6,10 +6,14 @@
 -----------------------------------------------------------------------------*/
 #include "distidxsearch.h"
 #include "distidx.h"
-#include "distsign.h"
 #include "graph.h"
 #include "node.h"
 #include "edge.h"
+#include "pqueue.h"
+#include "packedsign.h"
+#include <vector>
+
+#define INFTY   1e10
 
 
 // ----------------------------------------------------------------------------
@@ -18,86 +22,65 @@
 void DistIndexSearch::rangeSearch(Graph& a_graph, DistIndex& a_distidx,
                                    const int a_src, const float a_range,
                                    Array& a_result,
-                                   int& a_nodeaccess, int& a_edgeaccess)
+                                   int& a_nodeaccess, int& a_edgeaccess,
+                                   const bool a_path)
 {
-    // ------------------------------------------------------------------------
-    // local carrier for ordered node exploring
-    // ------------------------------------------------------------------------
-    class carrier
-    {
-    public:
-        const int   m_nid;
-        const int   m_oid;
-        const float m_cost;
-        Array       m_path;
-    public:
-        carrier(const int a_nid, const float a_cost, const int a_oid):
-            m_nid(a_nid), m_cost(a_cost), m_oid(a_oid)
-            {
-                m_path.append((void*)a_nid);
-            }
-        carrier(const int a_nid, const float a_cost, Array& a_path, const int a_oid):
-            m_nid(a_nid), m_cost(a_cost), m_path(a_path), m_oid(a_oid)
-            {
-                m_path.append((void*)a_nid);
-            }
-        virtual ~carrier() {};
-        static int compare(const void* a0, const void* a1)
-        {
-            carrier* c0 = *(carrier**)a0;
-            carrier* c1 = *(carrier**)a1;
-            if (c0->m_cost < c1->m_cost) return -1;
-            if (c0->m_cost > c1->m_cost) return +1;
-            if (c0->m_oid < c1->m_oid) return -1;
-            if (c0->m_oid > c1->m_oid) return +1;
-            return 0;
-        };
-    };
+    multiRangeSearch(a_graph, a_distidx, a_src, &a_range, 1, &a_result,
+        a_nodeaccess, a_edgeaccess, a_path);
+}
 
+// ----------------------------------------------------------------------------
+// single point range search over several radii
+// ----------------------------------------------------------------------------
+void DistIndexSearch::multiRangeSearch(Graph& a_graph, DistIndex& a_distidx,
+                                       const int a_src, const float* a_radii,
+                                       const int a_bands, Array* a_result,
+                                       int& a_nodeaccess, int& a_edgeaccess,
+                                       const bool a_path)
+{
     // ------------------------------------------------------------------------
     // initialization
     // ------------------------------------------------------------------------
-    a_result.clean();
+    for (int b=0; b<a_bands; b++)
+        a_result[b].clean();
     a_nodeaccess = 0;
     a_edgeaccess = 0;
+    if (a_bands <= 0) return;
+    const float range = a_radii[a_bands-1];
     Set visited(1000);
 
-    BinHeap heap(carrier::compare);
+    SearchTrail trail(a_path);
+    PQueue<SearchEntry> heap(1000);
 
     // ------------------------------------------------------------------------
     // result candidates
     // ------------------------------------------------------------------------
-    Array* a = a_distidx.getNode(a_src);  // ordered in IDs
-    Array sorta(*a);
-    sorta.sort(DistSignature::compare);
-    for (int i=0; i<sorta.size(); i++)
+    PackedSignatures a = a_distidx.getSignatures(a_src);    // ordered by cost
+    for (int i=0; i<a.size(); i++)
     {
-        DistSignature* distsign = (DistSignature*)sorta.get(i);
-        if (distsign->m_cost > a_range) break;
-        heap.insert(new carrier(a_src, 0, distsign->m_oid));
+        const PackedSignatures::Sign* distsign = a.get(i);
+        if (distsign->m_cost > range) break;
+        if (a_distidx.isDeleted(distsign->m_oid)) continue;
+        heap.insert(SearchEntry(a_src, 0, -1, distsign->m_oid));
     }
-    for (int i=0; i<a->size(); i++)
-        delete (DistSignature*)a->get(i);
-    delete a;
 
     // ------------------------------------------------------------------------
     // network expansion
     // ------------------------------------------------------------------------
     while (!heap.isEmpty())
     {
-        carrier* c = (carrier*)heap.removeTop();
+        SearchEntry c = heap.removeTop();
+        const int t = trail.add(c.m_nid, c.m_prev);
 
         // --------------------------------------------------------------------
         // examine distance signature for next hop
         // --------------------------------------------------------------------
-        const Array* a = a_distidx.getNode(c->m_nid);
-        DistSignature d(c->m_oid,0,0);
-        const int i = a->binSearch(&d, DistSignature::compareID);
-        if (i >= 0)
+        PackedSignatures a = a_distidx.getSignatures(c.m_nid);
+        const PackedSignatures::Sign* distsign = a.find(c.m_oid);
+        if (distsign != 0)
         {
-            DistSignature* distsign = (DistSignature*)a->get(i);
-            if (distsign->m_cost > (a_range - c->m_cost)) break;
-            if (distsign->m_oid == c->m_oid)
+            if (distsign->m_cost > (range - c.m_cost)) break;
+            if (distsign->m_oid == c.m_oid)
             {
                 // ------------------------------------------------------------
                 // terminate the exploring for an object if the object is found
@@ -105,26 +88,30 @@ void DistIndexSearch::rangeSearch(Graph& a_graph, DistIndex& a_distidx,
                 if (distsign->m_cost == 0)
                 {
                     ObjectSearchResult* res =
-                        new ObjectSearchResult(c->m_nid, c->m_path, c->m_cost);
-                    res->m_objects.append((void*)c->m_oid);
-                    a_result.append((void*)res);
+                        new ObjectSearchResult(c.m_nid, trail, t, c.m_cost);
+                    res->m_objects.append((void*)c.m_oid);
+                    // a traced cost a rounding beyond the largest radius
+                    // stays in the last band, as the single range keeps it
+                    int b = ObjectSearch::band(a_radii, a_bands, c.m_cost);
+                    if (b == a_bands) b--;
+                    a_result[b].append((void*)res);
                 }
                 // ------------------------------------------------------------
                 // continue the exploring
                 // ------------------------------------------------------------
                 else
                 {
-                    if (!visited.in((void*)c->m_nid))
+                    if (!visited.in((void*)c.m_nid))
                     {
                         a_nodeaccess++;
-                        visited.insert((void*)c->m_nid);
+                        visited.insert((void*)c.m_nid);
                     }
 
-                    Node* node = (Node*)a_graph.getNode(c->m_nid);
+                    std::shared_ptr<const Node> node = a_graph.getSharedNode(c.m_nid);
                     float cost = 0;
                     for (int i=0; i<node->m_edges.size(); i++)
                     {
-                        Edge* e = (Edge*)node->m_edges.get(i);
+                        const Edge* e = &node->m_edges[i];
                         if (e->m_neighbor == distsign->m_prev)
                         {
                             cost = e->m_cost;
@@ -133,20 +120,11 @@ void DistIndexSearch::rangeSearch(Graph& a_graph, DistIndex& a_distidx,
                         }
                     }
                     heap.insert(
-                        new carrier(distsign->m_prev, c->m_cost + cost,
-                        c->m_path, distsign->m_oid));
-                    delete node;
+                        SearchEntry(distsign->m_prev, c.m_cost + cost, t,
+                        distsign->m_oid));
                 }
             }
         }
-
-        // --------------------------------------------------------------------
-        // clean up
-        // --------------------------------------------------------------------
-        for (int i=0; i<a->size(); i++)
-            delete (DistSignature*)a->get(i);
-        delete a;
-        delete c;
     }
 }
 
@@ -156,42 +134,9 @@ void DistIndexSearch::rangeSearch(Graph& a_graph, DistIndex& a_distidx,
 void DistIndexSearch::kNNSearch(Graph& a_graph, DistIndex& a_distidx,
                                 const int a_src, const int a_k,
                                 Array& a_result,
-                                int& a_nodeaccess, int& a_edgeaccess)
+                                int& a_nodeaccess, int& a_edgeaccess,
+                                const bool a_path)
 {
-    // ------------------------------------------------------------------------
-    // local carrier for ordered node exploring
-    // ------------------------------------------------------------------------
-    class carrier
-    {
-    public:
-        const int   m_nid;
-        const int   m_oid;
-        const float m_cost;
-        Array       m_path;
-    public:
-        carrier(const int a_nid, const float a_cost, const int a_oid):
-            m_nid(a_nid), m_cost(a_cost), m_oid(a_oid)
-            {
-                m_path.append((void*)a_nid);
-            }
-        carrier(const int a_nid, const float a_cost, Array& a_path, const int a_oid):
-            m_nid(a_nid), m_cost(a_cost), m_path(a_path), m_oid(a_oid)
-            {
-                m_path.append((void*)a_nid);
-            }
-        virtual ~carrier() {};
-        static int compare(const void* a0, const void* a1)
-        {
-            carrier* c0 = *(carrier**)a0;
-            carrier* c1 = *(carrier**)a1;
-            if (c0->m_cost < c1->m_cost) return -1;
-            if (c0->m_cost > c1->m_cost) return +1;
-            if (c0->m_oid < c1->m_oid) return -1;
-            if (c0->m_oid > c1->m_oid) return +1;
-            return 0;
-        };
-    };
-
     // ------------------------------------------------------------------------
     // initialization
     // ------------------------------------------------------------------------
@@ -200,41 +145,37 @@ void DistIndexSearch::kNNSearch(Graph& a_graph, DistIndex& a_distidx,
     a_edgeaccess = 0;
     Set visited(1000);
 
-    BinHeap heap(carrier::compare);
+    SearchTrail trail(a_path);
+    PQueue<SearchEntry> heap(1000);
 
     // ------------------------------------------------------------------------
     // result candidates
     // ------------------------------------------------------------------------
-    Array* a = a_distidx.getNode(a_src);
-    Array sorta(*a);
-    sorta.sort(DistSignature::compare);
-    for (int i=0; i<sorta.size(); i++)
+    PackedSignatures a = a_distidx.getSignatures(a_src);    // ordered by cost
+    for (int i=0, cnt=0; i<a.size() && cnt<a_k; i++)
     {
-        if (i == a_k) break;
-        DistSignature* distsign = (DistSignature*)sorta.get(i);
-        heap.insert(new carrier(a_src, 0, distsign->m_oid));
+        const PackedSignatures::Sign* distsign = a.get(i);
+        if (a_distidx.isDeleted(distsign->m_oid)) continue;
+        heap.insert(SearchEntry(a_src, 0, -1, distsign->m_oid));
+        cnt++;
     }
-    for (int i=0; i<a->size(); i++)
-        delete (DistSignature*)a->get(i);
-    delete a;
 
     // ------------------------------------------------------------------------
     // network expansion
     // ------------------------------------------------------------------------
     while (!heap.isEmpty())
     {
-        carrier* c = (carrier*)heap.removeTop();
+        SearchEntry c = heap.removeTop();
+        const int t = trail.add(c.m_nid, c.m_prev);
 
         // --------------------------------------------------------------------
         // examine distance signature for next hop
         // --------------------------------------------------------------------
-        Array* a = a_distidx.getNode(c->m_nid);
-        DistSignature d(c->m_oid,0,0);
-        const int i = a->binSearch(&d, DistSignature::compareID);
-        if (i >= 0)
+        PackedSignatures a = a_distidx.getSignatures(c.m_nid);
+        const PackedSignatures::Sign* distsign = a.find(c.m_oid);
+        if (distsign != 0)
         {
-            DistSignature* distsign = (DistSignature*)a->get(i);
-            if (distsign->m_oid == c->m_oid)
+            if (distsign->m_oid == c.m_oid)
             {
                 // ------------------------------------------------------------
                 // terminate the exploring for an object if the object is found
@@ -242,8 +183,8 @@ void DistIndexSearch::kNNSearch(Graph& a_graph, DistIndex& a_distidx,
                 if (distsign->m_cost == 0)
                 {
                     ObjectSearchResult* res =
-                        new ObjectSearchResult(c->m_nid, c->m_path, c->m_cost);
-                    res->m_objects.append((void*)c->m_oid);
+                        new ObjectSearchResult(c.m_nid, trail, t, c.m_cost);
+                    res->m_objects.append((void*)c.m_oid);
                     a_result.append((void*)res);
                 }
                 // ------------------------------------------------------------
@@ -251,17 +192,17 @@ void DistIndexSearch::kNNSearch(Graph& a_graph, DistIndex& a_distidx,
                 // ------------------------------------------------------------
                 else
                 {
-                    if (!visited.in((void*)c->m_nid))
+                    if (!visited.in((void*)c.m_nid))
                     {
                         a_nodeaccess++;
-                        visited.insert((void*)c->m_nid);
+                        visited.insert((void*)c.m_nid);
                     }
 
-                    Node* node = (Node*)a_graph.getNode(c->m_nid);
+                    std::shared_ptr<const Node> node = a_graph.getSharedNode(c.m_nid);
                     float cost = 0;
                     for (int i=0; i<node->m_edges.size(); i++)
                     {
-                        Edge* e = (Edge*)node->m_edges.get(i);
+                        const Edge* e = &node->m_edges[i];
                         if (e->m_neighbor == distsign->m_prev)
                         {
                             cost = e->m_cost;
@@ -270,20 +211,11 @@ void DistIndexSearch::kNNSearch(Graph& a_graph, DistIndex& a_distidx,
                         }
                     }
                     heap.insert(
-                        new carrier(distsign->m_prev, c->m_cost + cost,
-                        c->m_path, distsign->m_oid));
-                    delete node;
+                        SearchEntry(distsign->m_prev, c.m_cost + cost, t,
+                        distsign->m_oid));
                 }
             }
         }
-
-        // --------------------------------------------------------------------
-        // clean up
-        // --------------------------------------------------------------------
-        for (int i=0; i<a->size(); i++)
-            delete (DistSignature*)a->get(i);
-        delete a;
-        delete c;
     }
 }
 
@@ -297,40 +229,6 @@ void DistIndexSearch::kNNSearch(Graph& a_graph, DistIndex& a_distidx,
                                 int& a_nodeaccess, int& a_edgeaccess,
                                 Array& a_visited)
 {
-    // ------------------------------------------------------------------------
-    // local carrier for ordered node exploring
-    // ------------------------------------------------------------------------
-    class carrier
-    {
-    public:
-        const int   m_nid;
-        const int   m_oid;
-        const float m_cost;
-        Array       m_path;
-    public:
-        carrier(const int a_nid, const float a_cost, const int a_oid):
-            m_nid(a_nid), m_cost(a_cost), m_oid(a_oid)
-            {
-                m_path.append((void*)a_nid);
-            }
-        carrier(const int a_nid, const float a_cost, Array& a_path, const int a_oid):
-            m_nid(a_nid), m_cost(a_cost), m_path(a_path), m_oid(a_oid)
-            {
-                m_path.append((void*)a_nid);
-            }
-        virtual ~carrier() {};
-        static int compare(const void* a0, const void* a1)
-        {
-            carrier* c0 = *(carrier**)a0;
-            carrier* c1 = *(carrier**)a1;
-            if (c0->m_cost < c1->m_cost) return -1;
-            if (c0->m_cost > c1->m_cost) return +1;
-            if (c0->m_oid < c1->m_oid) return -1;
-            if (c0->m_oid > c1->m_oid) return +1;
-            return 0;
-        };
-    };
-
     // ------------------------------------------------------------------------
     // initialization
     // ------------------------------------------------------------------------
@@ -339,41 +237,37 @@ void DistIndexSearch::kNNSearch(Graph& a_graph, DistIndex& a_distidx,
     a_edgeaccess = 0;
     Set visited(1000);
 
-    BinHeap heap(carrier::compare);
+    SearchTrail trail;
+    PQueue<SearchEntry> heap(1000);
 
     // ------------------------------------------------------------------------
     // result candidates
     // ------------------------------------------------------------------------
-    Array* a = a_distidx.getNode(a_src);
-    Array sorta(*a);
-    sorta.sort(DistSignature::compare);
-    for (int i=0; i<sorta.size(); i++)
+    PackedSignatures a = a_distidx.getSignatures(a_src);    // ordered by cost
+    for (int i=0, cnt=0; i<a.size() && cnt<a_k; i++)
     {
-        if (i == a_k) break;
-        DistSignature* distsign = (DistSignature*)sorta.get(i);
-        heap.insert(new carrier(a_src, 0, distsign->m_oid));
+        const PackedSignatures::Sign* distsign = a.get(i);
+        if (a_distidx.isDeleted(distsign->m_oid)) continue;
+        heap.insert(SearchEntry(a_src, 0, -1, distsign->m_oid));
+        cnt++;
     }
-    for (int i=0; i<a->size(); i++)
-        delete (DistSignature*)a->get(i);
-    delete a;
 
     // ------------------------------------------------------------------------
     // network expansion
     // ------------------------------------------------------------------------
     while (!heap.isEmpty())
     {
-        carrier* c = (carrier*)heap.removeTop();
+        SearchEntry c = heap.removeTop();
+        const int t = trail.add(c.m_nid, c.m_prev);
 
         // --------------------------------------------------------------------
         // examine distance signature for next hop
         // --------------------------------------------------------------------
-        Array* a = a_distidx.getNode(c->m_nid);
-        DistSignature d(c->m_oid,0,0);
-        const int i = a->binSearch(&d, DistSignature::compareID);
-        if (i >= 0)
+        PackedSignatures a = a_distidx.getSignatures(c.m_nid);
+        const PackedSignatures::Sign* distsign = a.find(c.m_oid);
+        if (distsign != 0)
         {
-            DistSignature* distsign = (DistSignature*)a->get(i);
-            if (distsign->m_oid == c->m_oid)
+            if (distsign->m_oid == c.m_oid)
             {
                 // ------------------------------------------------------------
                 // terminate the exploring for an object if the object is found
@@ -381,8 +275,8 @@ void DistIndexSearch::kNNSearch(Graph& a_graph, DistIndex& a_distidx,
                 if (distsign->m_cost == 0)
                 {
                     ObjectSearchResult* res =
-                        new ObjectSearchResult(c->m_nid, c->m_path, c->m_cost);
-                    res->m_objects.append((void*)c->m_oid);
+                        new ObjectSearchResult(c.m_nid, trail, t, c.m_cost);
+                    res->m_objects.append((void*)c.m_oid);
                     a_result.append((void*)res);
                 }
                 // ------------------------------------------------------------
@@ -390,18 +284,18 @@ void DistIndexSearch::kNNSearch(Graph& a_graph, DistIndex& a_distidx,
                 // ------------------------------------------------------------
                 else
                 {
-                    if (!visited.in((void*)c->m_nid))
+                    if (!visited.in((void*)c.m_nid))
                     {
                         a_nodeaccess++;
-                        visited.insert((void*)c->m_nid);
-                        a_visited.append((void*)c->m_nid);
+                        visited.insert((void*)c.m_nid);
+                        a_visited.append((void*)c.m_nid);
                     }
 
-                    Node* node = (Node*)a_graph.getNode(c->m_nid);
+                    std::shared_ptr<const Node> node = a_graph.getSharedNode(c.m_nid);
                     float cost = 0;
                     for (int i=0; i<node->m_edges.size(); i++)
                     {
-                        Edge* e = (Edge*)node->m_edges.get(i);
+                        const Edge* e = &node->m_edges[i];
                         if (e->m_neighbor == distsign->m_prev)
                         {
                             cost = e->m_cost;
@@ -410,122 +304,45 @@ void DistIndexSearch::kNNSearch(Graph& a_graph, DistIndex& a_distidx,
                         }
                     }
                     heap.insert(
-                        new carrier(distsign->m_prev, c->m_cost + cost,
-                        c->m_path, distsign->m_oid));
-                    delete node;
+                        SearchEntry(distsign->m_prev, c.m_cost + cost, t,
+                        distsign->m_oid));
                 }
             }
         }
-
-        // --------------------------------------------------------------------
-        // clean up
-        // --------------------------------------------------------------------
-        for (int i=0; i<a->size(); i++)
-            delete (DistSignature*)a->get(i);
-        delete a;
-        delete c;
     }
 }
 
 // ----------------------------------------------------------------------------
-// multi-point range search
+// the paths from the query points to the objects of a_result(by following
+// the next hops in the signatures), a query point per thread unless the
+// nodes are traced in a_visited
 // ----------------------------------------------------------------------------
-void DistIndexSearch::groupRangeSearch(Graph& a_graph, DistIndex& a_distidx,
-                                       const int* a_src, const float* a_range,
-                                       const int a_cnt,
-                                       Array& a_result, int& a_nodeaccess, int& a_edgeaccess)
+static void groupPaths(Graph& a_graph, DistIndex& a_distidx,
+                       const int* a_src, const int a_cnt,
+                       Array& a_result, int& a_nodeaccess, int& a_edgeaccess,
+                       const int a_threads, Array* a_visited=0)
 {
-    // ------------------------------------------------------------------------
-    // local carrier for ordered node exploring
-    // ------------------------------------------------------------------------
-    class carrier
-    {
-    public:
-        const int   m_nid;
-        const int   m_oid;
-        const float m_cost;
-        Array       m_path;
-    public:
-        carrier(const int a_nid, const float a_cost, const int a_oid):
-            m_nid(a_nid), m_cost(a_cost), m_oid(a_oid)
-            {
-                m_path.append((void*)a_nid);
-            }
-        carrier(const int a_nid, const float a_cost, Array& a_path, const int a_oid):
-            m_nid(a_nid), m_cost(a_cost), m_path(a_path), m_oid(a_oid)
-            {
-                m_path.append((void*)a_nid);
-            }
-        virtual ~carrier() {};
-        static int compare(const void* a0, const void* a1)
-        {
-            carrier* c0 = *(carrier**)a0;
-            carrier* c1 = *(carrier**)a1;
-            if (c0->m_cost < c1->m_cost) return -1;
-            if (c0->m_cost > c1->m_cost) return +1;
-            if (c0->m_oid < c1->m_oid) return -1;
-            if (c0->m_oid > c1->m_oid) return +1;
-            return 0;
-        };
-    };
-
-    // ------------------------------------------------------------------------
-    // initialization
-    // ------------------------------------------------------------------------
-    a_result.clean();
-    a_nodeaccess = 0;
-    a_edgeaccess = 0;
-
-    // ------------------------------------------------------------------------
-    // collect result candidates
-    // ------------------------------------------------------------------------
-    Hash cand;
-    for (int i=0; i<a_cnt; i++)
-    {
-        Array* a = a_distidx.getNode(a_src[i]);
-        Array sorta(*a);
-        sorta.sort(DistSignature::compare);
-        for (int j=0; j<sorta.size(); j++)
-        {
-            DistSignature* distsign = (DistSignature*)sorta.get(j);
-            if (distsign->m_cost > a_range[i]) break;
-            GroupObjectSearchResult* r =
-                (GroupObjectSearchResult*)cand.get(distsign->m_oid);
-            if (r == 0)
-                cand.put(distsign->m_oid, r =
-                new GroupObjectSearchResult(-1,distsign->m_oid,a_cnt));
-            r->m_cost[i] = distsign->m_cost;
-        }
-        for (int j=0; j<a->size(); j++)
-            delete (DistSignature*)a->get(j);
-        delete a;
-    }
-
-    // ------------------------------------------------------------------------
-    // filter candidates
-    // ------------------------------------------------------------------------
-    Array falsehit;
-    for (HashReader rdr(cand); !rdr.isEnd(); rdr.next())
+    const int n = a_result.size();
+    Hash cand;                                  // object -> result index
+    for (int j=0; j<n; j++)
     {
-        GroupObjectSearchResult* r = (GroupObjectSearchResult*)rdr.getVal();
-        if (r->allreached(a_cnt))
-            a_result.append(r);
-        else
-            falsehit.append(r);
+        GroupObjectSearchResult* r = (GroupObjectSearchResult*)a_result.get(j);
+        cand.put(r->m_oid, (void*)(long)j);
     }
 
-    // ------------------------------------------------------------------------
-    // network expansion
-    // ------------------------------------------------------------------------
-    for (int i=0; i<a_cnt; i++)
+    std::vector<int> nodeaccess(a_cnt, 0), edgeaccess(a_cnt, 0);
+    std::vector<int> found(a_cnt*n, -1);       // node of an object, by point
+    SegMemory* mem[2] = {&a_graph.memory(), &a_distidx.memory()};
+    forEachQuery(a_visited == 0 ? a_threads : 1, a_cnt, mem, 2, [&](int i)
     {
         Set visited(1000);
-        BinHeap heap(carrier::compare);
-        for (int j=0; j<a_result.size(); j++)
+        SearchTrail trail;
+        PQueue<SearchEntry> heap(1000);
+        for (int j=0; j<n; j++)
         {
             GroupObjectSearchResult* r =
                 (GroupObjectSearchResult*)a_result.get(j);
-            heap.insert(new carrier(a_src[i], r->m_cost[i], r->m_oid));
+            heap.insert(SearchEntry(a_src[i], r->m_cost[i], -1, r->m_oid));
         }
 
         // --------------------------------------------------------------------
@@ -533,117 +350,79 @@ void DistIndexSearch::groupRangeSearch(Graph& a_graph, DistIndex& a_distidx,
         // --------------------------------------------------------------------
         while (!heap.isEmpty())
         {
-            carrier* c = (carrier*)heap.removeTop();
+            SearchEntry c = heap.removeTop();
+            const int t = trail.add(c.m_nid, c.m_prev);
+
+            if (a_visited != 0)
+                a_visited->append((void*)c.m_nid);
 
             // ----------------------------------------------------------------
             // examine distance signature for next hop
             // ----------------------------------------------------------------
-            Array* a = a_distidx.getNode(c->m_nid);
-            DistSignature d(c->m_oid, 0, 0);
-            const int k = a->binSearch(&d, DistSignature::compareID);
-            // for (int k=0; k<a->size(); k++)
-            if (k >= 0)
+            PackedSignatures a = a_distidx.getSignatures(c.m_nid);
+            const PackedSignatures::Sign* distsign = a.find(c.m_oid);
+            if (distsign == 0) continue;
+
+            // ----------------------------------------------------------------
+            // terminate the exploring for an object if it is found
+            // ----------------------------------------------------------------
+            if (distsign->m_cost == 0)
+            {
+                const int j = (long)cand.get(c.m_oid);
+                GroupObjectSearchResult* r =
+                    (GroupObjectSearchResult*)a_result.get(j);
+                found[i*n + j] = c.m_nid;
+                r->m_path[i].clean();                  // record the path
+                trail.path(t, r->m_path[i]);
+            }
+            // ----------------------------------------------------------------
+            // continue the exploring
+            // ----------------------------------------------------------------
+            else
             {
-                DistSignature* distsign = (DistSignature*)a->get(k);
-                if (distsign->m_oid == c->m_oid)
+                if (!visited.in((void*)c.m_nid))
                 {
-                    // --------------------------------------------------------
-                    // terminate the exploring for an object if it is found
-                    // --------------------------------------------------------
-                    if (distsign->m_cost == 0)
-                    {
-                        GroupObjectSearchResult* r =
-                            (GroupObjectSearchResult*)cand.get(c->m_oid);
-                        r->m_nid = c->m_nid;
-                        r->m_path[i].copy(c->m_path);   // record the path
-                    }
-                    // --------------------------------------------------------
-                    // continue the exploring
-                    // --------------------------------------------------------
-                    else
-                    {
-                        if (!visited.in((void*)c->m_nid))
-                        {
-                            a_nodeaccess++;
-                            visited.insert((void*)c->m_nid);
-                        }
+                    nodeaccess[i]++;
+                    visited.insert((void*)c.m_nid);
+                }
 
-                        Node* node = (Node*)a_graph.getNode(c->m_nid);
-                        float cost = 0;
-                        for (int l=0; l<node->m_edges.size(); l++)
-                        {
-                            Edge* e = (Edge*)node->m_edges.get(l);
-                            if (e->m_neighbor == distsign->m_prev)
-                            {
-                                cost = e->m_cost;
-                                a_edgeaccess++;
-                                break;
-                            }
-                        }
-                        heap.insert(
-                            new carrier(distsign->m_prev, c->m_cost + cost,
-                            c->m_path, distsign->m_oid));
-                        delete node;
+                std::shared_ptr<const Node> node = a_graph.getSharedNode(c.m_nid);
+                float cost = 0;
+                for (int l=0; l<node->m_edges.size(); l++)
+                {
+                    const Edge* e = &node->m_edges[l];
+                    if (e->m_neighbor == distsign->m_prev)
+                    {
+                        cost = e->m_cost;
+                        edgeaccess[i]++;
+                        break;
                     }
                 }
+                heap.insert(
+                    SearchEntry(distsign->m_prev, c.m_cost + cost, t,
+                    distsign->m_oid));
             }
-            // ----------------------------------------------------------------
-            // clean up
-            // ----------------------------------------------------------------
-            for (int d=0; d<a->size(); d++)
-                delete (DistSignature*)a->get(d);
-            delete a;
-            delete c;
         }
+    });
+    for (int i=0; i<a_cnt; i++)
+    {
+        a_nodeaccess += nodeaccess[i];
+        a_edgeaccess += edgeaccess[i];
+        for (int j=0; j<n; j++)
+            if (found[i*n + j] != -1)
+                ((GroupObjectSearchResult*)a_result.get(j))->m_nid = found[i*n + j];
     }
-
-    for (int i=0; i<falsehit.size(); i++)
-        delete (GroupObjectSearchResult*)falsehit.get(i);
 }
 
-////
 // ----------------------------------------------------------------------------
-// multi-point kNN search
+// multi-point range search
 // ----------------------------------------------------------------------------
-void DistIndexSearch::groupKNNSearch(Graph& a_graph, DistIndex& a_distidx,
-                                     const int* a_src, const int a_cnt,
-                                     const int a_k,
-                                     Array& a_result, int& a_nodeaccess, int& a_edgeaccess)
+void DistIndexSearch::groupRangeSearch(Graph& a_graph, DistIndex& a_distidx,
+                                       const int* a_src, const float* a_range,
+                                       const int a_cnt,
+                                       Array& a_result, int& a_nodeaccess, int& a_edgeaccess,
+                                       const int a_threads)
 {
-    // ------------------------------------------------------------------------
-    // local carrier for ordered node exploring
-    // ------------------------------------------------------------------------
-    class carrier
-    {
-    public:
-        const int   m_nid;
-        const int   m_oid;
-        const float m_cost;
-        Array       m_path;
-    public:
-        carrier(const int a_nid, const float a_cost, const int a_oid):
-            m_nid(a_nid), m_cost(a_cost), m_oid(a_oid)
-            {
-                m_path.append((void*)a_nid);
-            }
-        carrier(const int a_nid, const float a_cost, Array& a_path, const int a_oid):
-            m_nid(a_nid), m_cost(a_cost), m_path(a_path), m_oid(a_oid)
-            {
-                m_path.append((void*)a_nid);
-            }
-        virtual ~carrier() {};
-        static int compare(const void* a0, const void* a1)
-        {
-            carrier* c0 = *(carrier**)a0;
-            carrier* c1 = *(carrier**)a1;
-            if (c0->m_cost < c1->m_cost) return -1;
-            if (c0->m_cost > c1->m_cost) return +1;
-            if (c0->m_oid < c1->m_oid) return -1;
-            if (c0->m_oid > c1->m_oid) return +1;
-            return 0;
-        };
-    };
-
     // ------------------------------------------------------------------------
     // initialization
     // ------------------------------------------------------------------------
@@ -655,134 +434,126 @@ void DistIndexSearch::groupKNNSearch(Graph& a_graph, DistIndex& a_distidx,
     // collect result candidates
     // ------------------------------------------------------------------------
     Hash cand;
-    Array candlist;
     for (int i=0; i<a_cnt; i++)
     {
-        const Array* a = a_distidx.getNode(a_src[i]);
-        for (int j=0; j<a->size(); j++)
+        PackedSignatures a = a_distidx.getSignatures(a_src[i]);    // ordered by cost
+        for (int j=0; j<a.size(); j++)
         {
-            DistSignature* distsign = (DistSignature*)a->get(j);
+            const PackedSignatures::Sign* distsign = a.get(j);
+            if (distsign->m_cost > a_range[i]) break;
+            if (a_distidx.isDeleted(distsign->m_oid)) continue;
             GroupObjectSearchResult* r =
                 (GroupObjectSearchResult*)cand.get(distsign->m_oid);
             if (r == 0)
-            {
-                r = new GroupObjectSearchResult(-1,distsign->m_oid,a_cnt);
-                cand.put(distsign->m_oid, r);
-                candlist.append(r);
-            }
+                cand.put(distsign->m_oid, r =
+                new GroupObjectSearchResult(-1,distsign->m_oid,a_cnt));
             r->m_cost[i] = distsign->m_cost;
-            delete distsign;
         }
-        delete a;
     }
 
     // ------------------------------------------------------------------------
     // filter candidates
     // ------------------------------------------------------------------------
-    candlist.sort(GroupObjectSearchResult::compare);
-    for (int i=0; i<candlist.size(); i++)
+    for (HashReader rdr(cand); !rdr.isEnd(); rdr.next())
     {
-        GroupObjectSearchResult* r = (GroupObjectSearchResult*)candlist.get(i);
-        if (a_result.size() > a_k)
-        {
-            delete r;
-        }
+        GroupObjectSearchResult* r = (GroupObjectSearchResult*)rdr.getVal();
+        if (r->allreached(a_cnt))
+            a_result.append(r);
         else
-        {
-            if (r->allreached(a_cnt))
-                a_result.append(r);
-            else
-                delete r;
-        }
+            delete r;
     }
 
-    // ------------------------------------------------------------------------
-    // network expansion
-    // ------------------------------------------------------------------------
+    groupPaths(a_graph, a_distidx, a_src, a_cnt, a_result,
+        a_nodeaccess, a_edgeaccess, a_threads);
+}
+
+// ----------------------------------------------------------------------------
+// the k objects of the least aggregate cost, by the threshold algorithm:
+// the signatures of the query points are read by cost in lockstep(sorted
+// access) and an object seen is looked up in all(random access). after depth
+// d no object unseen costs less than the aggregate of the d-th costs.
+// ----------------------------------------------------------------------------
+static void groupCandidates(DistIndex& a_distidx,
+                            const int* a_src, const int a_cnt,
+                            const int a_k, const int a_agg,
+                            Array& a_result)
+{
+    std::vector<PackedSignatures> sign(a_cnt);
     for (int i=0; i<a_cnt; i++)
+        sign[i] = a_distidx.getSignatures(a_src[i]).copy();
+
+    Set seen(1000);
+    Array best;         // the k best so far, by aggregate cost
+    for (int d=0; ; d++)
     {
-        Set visited(1000);
-        BinHeap heap(carrier::compare);
-        for (int j=0; j<a_result.size(); j++)
+        bool exhausted = false;
+        float threshold = 0;
+        for (int i=0; i<a_cnt; i++)
         {
+            if (d >= sign[i].size())
+            {
+                exhausted = true;               // no other object reachable
+                continue;
+            }
+            const PackedSignatures::Sign* s = sign[i].get(d);
+            threshold = a_agg == GROUP_SUM ? threshold + s->m_cost :
+                threshold > s->m_cost ? threshold : s->m_cost;
+            if (seen.in((void*)s->m_oid)) continue;
+            seen.insert((void*)s->m_oid);
+            if (a_distidx.isDeleted(s->m_oid)) continue;
+
             GroupObjectSearchResult* r =
-                (GroupObjectSearchResult*)a_result.get(j);
-            heap.insert(new carrier(a_src[i], r->m_cost[i], r->m_oid));
+                new GroupObjectSearchResult(-1, s->m_oid, a_cnt, a_agg);
+            for (int j=0; j<a_cnt; j++)
+            {
+                const PackedSignatures::Sign* t = sign[j].find(s->m_oid);
+                if (t == 0) break;              // not reachable from j
+                r->m_cost[j] = t->m_cost;
+            }
+            void* kth = best.size() >= a_k ? best.get(a_k-1) : 0;
+            if (!r->allreached(a_cnt) ||
+                (kth != 0 && GroupObjectSearchResult::compare(&r, &kth) >= 0))
+            {
+                delete r;
+                continue;
+            }
+            best.append(r);
+            best.sort(GroupObjectSearchResult::compare);
+            if (best.size() > a_k)
+            {
+                delete (GroupObjectSearchResult*)best.get(a_k);
+                best.removeAt(a_k);
+            }
         }
 
         // --------------------------------------------------------------------
-        // network expansion
+        // if k answer objects are found, terminate
         // --------------------------------------------------------------------
-        while (!heap.isEmpty())
-        {
-            carrier* c = (carrier*)heap.removeTop();
-
-            // ----------------------------------------------------------------
-            // examine distance signature for next hop
-            // ----------------------------------------------------------------
-            const Array* a = a_distidx.getNode(c->m_nid);
-            DistSignature d(c->m_oid,0,0);
-            const int k = a->binSearch(&d, DistSignature::compareID);
-            //for (int k=0; k<a->size(); k++)
-            if (k >= 0)
-            {
-                DistSignature* distsign = (DistSignature*)a->get(k);
-                if (distsign->m_oid == c->m_oid)
-                {
-                    // --------------------------------------------------------
-                    // terminate the exploring for an object if it is found
-                    // --------------------------------------------------------
-                    if (distsign->m_cost == 0)
-                    {
-                        GroupObjectSearchResult* r =
-                            (GroupObjectSearchResult*)cand.get(c->m_oid);
-                        r->m_nid = c->m_nid;
-                        r->m_path[i].copy(c->m_path);   // record the path
-                    }
-                    // --------------------------------------------------------
-                    // continue the exploring
-                    // --------------------------------------------------------
-                    else
-                    {
-                        if (!visited.in((void*)c->m_nid))
-                        {
-                            a_nodeaccess++;
-                            visited.insert((void*)c->m_nid);
-                        }
-
-                        Node* node = (Node*)a_graph.getNode(c->m_nid);
-                        float cost = 0;
-                        for (int l=0; l<node->m_edges.size(); l++)
-                        {
-                            Edge* e = (Edge*)node->m_edges.get(l);
-                            if (e->m_neighbor == distsign->m_prev)
-                            {
-                                cost = e->m_cost;
-                                a_edgeaccess++;
-                                break;
-                            }
-                        }
-                        heap.insert(
-                            new carrier(distsign->m_prev, c->m_cost + cost,
-                            c->m_path, distsign->m_oid));
-                        delete node;
-                    }
-                    //break;
-                }
-            }
-            // ----------------------------------------------------------------
-            // clean up
-            // ----------------------------------------------------------------
-            for (int d=0; d<a->size(); d++)
-                delete (DistSignature*)a->get(d);
-            delete a;
-            delete c;
-        }
+        if (exhausted || (best.size() >= a_k &&
+            ((GroupObjectSearchResult*)best.get(a_k-1))->sumcost() <= threshold))
+            break;
     }
+    for (int i=0; i<best.size(); i++)
+        a_result.append(best.get(i));
 }
 
+// ----------------------------------------------------------------------------
+// multi-point kNN search
+// ----------------------------------------------------------------------------
+void DistIndexSearch::groupKNNSearch(Graph& a_graph, DistIndex& a_distidx,
+                                     const int* a_src, const int a_cnt,
+                                     const int a_k,
+                                     Array& a_result, int& a_nodeaccess, int& a_edgeaccess,
+                                     const int a_agg, const int a_threads)
+{
+    a_result.clean();
+    a_nodeaccess = 0;
+    a_edgeaccess = 0;
+    groupCandidates(a_distidx, a_src, a_cnt, a_k, a_agg, a_result);
+    groupPaths(a_graph, a_distidx, a_src, a_cnt, a_result,
+        a_nodeaccess, a_edgeaccess, a_threads);
+}
 
-///
 void DistIndexSearch::groupKNNSearch(Graph& a_graph, DistIndex& a_distidx,
                                      const int* a_src, const int a_cnt,
                                      const int a_k,
@@ -790,176 +561,10 @@ void DistIndexSearch::groupKNNSearch(Graph& a_graph, DistIndex& a_distidx,
                                      int& a_nodeaccess, int& a_edgeaccess,
                                      Array& a_visited)
 {
-    // ------------------------------------------------------------------------
-    // local carrier for ordered node exploring
-    // ------------------------------------------------------------------------
-    class carrier
-    {
-    public:
-        const int   m_nid;
-        const int   m_oid;
-        const float m_cost;
-        Array       m_path;
-    public:
-        carrier(const int a_nid, const float a_cost, const int a_oid):
-            m_nid(a_nid), m_cost(a_cost), m_oid(a_oid)
-            {
-                m_path.append((void*)a_nid);
-            }
-        carrier(const int a_nid, const float a_cost, Array& a_path, const int a_oid):
-            m_nid(a_nid), m_cost(a_cost), m_path(a_path), m_oid(a_oid)
-            {
-                m_path.append((void*)a_nid);
-            }
-        virtual ~carrier() {};
-        static int compare(const void* a0, const void* a1)
-        {
-            carrier* c0 = *(carrier**)a0;
-            carrier* c1 = *(carrier**)a1;
-            if (c0->m_cost < c1->m_cost) return -1;
-            if (c0->m_cost > c1->m_cost) return +1;
-            if (c0->m_oid < c1->m_oid) return -1;
-            if (c0->m_oid > c1->m_oid) return +1;
-            return 0;
-        };
-    };
-
-    // ------------------------------------------------------------------------
-    // initialization
-    // ------------------------------------------------------------------------
     a_result.clean();
     a_nodeaccess = 0;
     a_edgeaccess = 0;
-
-    // ------------------------------------------------------------------------
-    // collect result candidates
-    // ------------------------------------------------------------------------
-    Hash cand;
-    Array candlist;
-    for (int i=0; i<a_cnt; i++)
-    {
-        const Array* a = a_distidx.getNode(a_src[i]);
-        for (int j=0; j<a->size(); j++)
-        {
-            DistSignature* distsign = (DistSignature*)a->get(j);
-            GroupObjectSearchResult* r =
-                (GroupObjectSearchResult*)cand.get(distsign->m_oid);
-            if (r == 0)
-            {
-                r = new GroupObjectSearchResult(-1,distsign->m_oid,a_cnt);
-                cand.put(distsign->m_oid, r);
-                candlist.append(r);
-            }
-            r->m_cost[i] = distsign->m_cost;
-            delete distsign;
-        }
-        delete a;
-    }
-
-    // ------------------------------------------------------------------------
-    // filter candidates
-    // ------------------------------------------------------------------------
-    candlist.sort(GroupObjectSearchResult::compare);
-    for (int i=0; i<candlist.size(); i++)
-    {
-        GroupObjectSearchResult* r = (GroupObjectSearchResult*)candlist.get(i);
-        if (a_result.size() >= a_k)
-        {
-            delete r;
-        }
-        else
-        {
-            if (r->allreached(a_cnt))
-                a_result.append(r);
-            else
-                delete r;
-        }
-    }
-
-    // ------------------------------------------------------------------------
-    // network expansion
-    // ------------------------------------------------------------------------
-    for (int i=0; i<a_cnt; i++)
-    {
-        Set visited(1000);
-        BinHeap heap(carrier::compare);
-        for (int j=0; j<a_result.size(); j++)
-        {
-            GroupObjectSearchResult* r =
-                (GroupObjectSearchResult*)a_result.get(j);
-            heap.insert(new carrier(a_src[i], r->m_cost[i], r->m_oid));
-        }
-
-        // --------------------------------------------------------------------
-        // network expansion
-        // --------------------------------------------------------------------
-        while (!heap.isEmpty())
-        {
-            carrier* c = (carrier*)heap.removeTop();
-
-            a_visited.append((void*)c->m_nid);
-
-            // ----------------------------------------------------------------
-            // examine distance signature for next hop
-            // ----------------------------------------------------------------
-            const Array* a = a_distidx.getNode(c->m_nid);
-            DistSignature d(c->m_oid,0,0);
-            const int k = a->binSearch(&d, DistSignature::compareID);
-            //for (int k=0; k<a->size(); k++)
-            if (k >= 0)
-            {
-                DistSignature* distsign = (DistSignature*)a->get(k);
-                if (distsign->m_oid == c->m_oid)
-                {
-                    // --------------------------------------------------------
-                    // terminate the exploring for an object if it is found
-                    // --------------------------------------------------------
-                    if (distsign->m_cost == 0)
-                    {
-                        GroupObjectSearchResult* r =
-                            (GroupObjectSearchResult*)cand.get(c->m_oid);
-                        r->m_nid = c->m_nid;
-                        r->m_path[i].copy(c->m_path);   // record the path
-                    }
-                    // --------------------------------------------------------
-                    // continue the exploring
-                    // --------------------------------------------------------
-                    else
-                    {
-                        if (!visited.in((void*)c->m_nid))
-                        {
-                            a_nodeaccess++;
-                            visited.insert((void*)c->m_nid);
-                        }
-
-                        Node* node = (Node*)a_graph.getNode(c->m_nid);
-                        float cost = 0;
-                        for (int l=0; l<node->m_edges.size(); l++)
-                        {
-                            Edge* e = (Edge*)node->m_edges.get(l);
-                            if (e->m_neighbor == distsign->m_prev)
-                            {
-                                cost = e->m_cost;
-                                a_edgeaccess++;
-                                break;
-                            }
-                        }
-                        heap.insert(
-                            new carrier(distsign->m_prev, c->m_cost + cost,
-                            c->m_path, distsign->m_oid));
-                        delete node;
-                    }
-                    //break;
-                }
-            }
-            // ----------------------------------------------------------------
-            // clean up
-            // ----------------------------------------------------------------
-            for (int d=0; d<a->size(); d++)
-                delete (DistSignature*)a->get(d);
-            delete a;
-            delete c;
-        }
-    }
+    groupCandidates(a_distidx, a_src, a_cnt, a_k, GROUP_MAX, a_result);
+    groupPaths(a_graph, a_distidx, a_src, a_cnt, a_result,
+        a_nodeaccess, a_edgeaccess, 1, &a_visited);
 }
-
@@ -23,15 +23,29 @@ public:
     static void rangeSearch(
         Graph& a_graph, DistIndex& a_distidx,
         const int a_src, const float a_range,
-        Array& a_result, int& a_nodeaccess, int& a_edgeaccess);
+        Array& a_result, int& a_nodeaccess, int& a_edgeaccess,
+        const bool a_path=true);
+
+    // ------------------------------------------------------------------------
+    // single-point range search over several radii in one search
+    // (bands as ObjectSearch::multiRangeSearch; objects only: the paths are
+    // traced towards the objects, so there is no isochrone here)
+    // ------------------------------------------------------------------------
+    static void multiRangeSearch(
+        Graph& a_graph, DistIndex& a_distidx,
+        const int a_src, const float* a_radii, const int a_bands,
+        Array* a_result, int& a_nodeaccess, int& a_edgeaccess,
+        const bool a_path=true);
 
     // ------------------------------------------------------------------------
     // single-point kNN search
+    // (a_path false for results with no path: no trail is kept)
     // ------------------------------------------------------------------------
     static void kNNSearch(
         Graph& a_graph, DistIndex& a_distidx,
         const int a_src, const int a_k,
-        Array& a_result, int& a_nodeaccess, int& a_edgeaccess);
+        Array& a_result, int& a_nodeaccess, int& a_edgeaccess,
+        const bool a_path=true);
     static void kNNSearch(
         Graph& a_graph, DistIndex& a_distidx,
         const int a_src, const int a_k,
@@ -40,21 +54,26 @@ public:
 
     // ------------------------------------------------------------------------
     // multi-point range search
+    // (the paths from the query points are traced on a_threads threads)
     // ------------------------------------------------------------------------
     static void groupRangeSearch(
         Graph& a_graph, DistIndex& a_distidx,
         const int* a_src, const float* a_range,
         const int a_cnt,
-        Array& a_result, int& a_nodeaccess, int& a_edgeaccess);
+        Array& a_result, int& a_nodeaccess, int& a_edgeaccess,
+        const int a_threads=1);
 
     // ------------------------------------------------------------------------
-    // multi-point kNN search
+    // multi-point kNN search by aggregate cost a_agg(GROUP_MAX, GROUP_SUM)
+    // (threshold algorithm over the signatures of the query points; the
+    // paths are traced on a_threads threads)
     // ------------------------------------------------------------------------
     static void groupKNNSearch(
         Graph& a_graph, DistIndex& a_distidx,
         const int* a_src, const int a_cnt,
         const int a_k,
-        Array& a_result, int& a_nodeaccess, int& a_edgeaccess);
+        Array& a_result, int& a_nodeaccess, int& a_edgeaccess,
+        const int a_agg=GROUP_MAX, const int a_threads=1);
     static void groupKNNSearch(
         Graph& a_graph, DistIndex& a_distidx,
         const int* a_src, const int a_cnt,
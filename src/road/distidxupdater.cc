@@ -0,0 +1,157 @@
+/* ----------------------------------------------------------------------------
+    This program updates the objects of a distance index in place.
+
+    Suggested arguments:
+    > (prog name) -i graph.idx -d dist.idx -a new.object -r old.object -c all
+    explanations:
+    -i: graph index file (input)
+    -d: distance index (updated)
+    -a: objects to insert (node id, object id per line, as the object file)
+    -r: objects to delete (node id, object id per line, as the object file)
+    -c: nodes to compact after the deletions, or all (default: all)
+    -f: signature layout of nodes new to the index: packed or id
+        (default: packed)
+    -b: memory budget of the new signatures in MB(default: 256): the
+        insertions go in batches whose signatures fit, each node is
+        rewritten once a batch
+---------------------------------------------------------------------------- */
+
+#include "graph.h"
+#include "segfmem.h"
+#include "param.h"
+#include "collection.h"
+#include "distidx.h"
+#include <sys/types.h>
+#include <sys/timeb.h>
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+#define PAGESIZE    4096
+
+void helpmsg(const char* pgm)
+{
+    cerr << "Suggested arguments:" << endl;
+    cerr << "> " << pgm << " ";
+    cerr << "-i graph.idx -d dist.idx -a new.object -r old.object -c all" << endl;
+    cerr << "explanations:" << endl;
+    cerr << "-i: graph index file" << endl;
+    cerr << "-d: distance index" << endl;
+    cerr << "-a: objects to insert" << endl;
+    cerr << "-r: objects to delete" << endl;
+    cerr << "-c: nodes to compact, or all (default: all)" << endl;
+    cerr << "-f: layout of new nodes: packed or id (default: packed)" << endl;
+    cerr << "-b: memory budget of new signatures in MB (default: 256)" << endl;
+}
+
+int main(const int a_argc, const char** a_argv)
+{
+    if (a_argc == 1)
+    {
+        helpmsg(a_argv[0]);
+        return -1;
+    }
+
+    cerr << "update distance index" << endl;
+    //-------------------------------------------------------------------------
+    // initialization
+    //-------------------------------------------------------------------------
+    const char* idxflname = Param::read(a_argc, a_argv, "-i", "");
+    const char* didxflname= Param::read(a_argc, a_argv, "-d", "");
+    const char* insflname = Param::read(a_argc, a_argv, "-a", "");
+    const char* delflname = Param::read(a_argc, a_argv, "-r", "");
+    const char* ccompact  = Param::read(a_argc, a_argv, "-c", "all");
+    const char* layout = Param::read(a_argc, a_argv, "-f", "packed");
+    int compactnodes = strcmp(ccompact,"all") == 0 ? -1 : atoi(ccompact);
+    long budget = atol(Param::read(a_argc, a_argv, "-b", "256"))*1024*1024;
+
+    //-------------------------------------------------------------------------
+    // access graph and distance index files
+    //-------------------------------------------------------------------------
+    cerr << "loading indexes ... ";
+    SegFMemory segmem(idxflname, PAGESIZE*10, PAGESIZE, 32, false);
+    Graph graph(segmem);
+    SegFMemory segdmem(didxflname, PAGESIZE*10, PAGESIZE, 32, false);
+    DistIndex didx(segdmem, strcmp(layout,"id") != 0);
+    cerr << "[DONE]" << endl;
+
+    struct timeb starttime, endtime;
+    ftime(&starttime);
+
+    //-------------------------------------------------------------------------
+    // deletions: tombstones
+    //-------------------------------------------------------------------------
+    int numdel = 0;
+    if (strlen(delflname) > 0)
+    {
+        fstream fobj;
+        fobj.open(delflname, ios::in);
+        while (true)
+        {
+            int nodeid, objid;
+            fobj >> nodeid;
+            if (fobj.eof())
+                break;
+            fobj >> objid;
+            if (didx.deleteObject(objid) == 0)
+                numdel++;
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    // compaction: the deleted objects out of the signatures
+    //-------------------------------------------------------------------------
+    cerr << "compacting ... ";
+    int left = didx.compact(compactnodes);
+    cerr << "[DONE]" << endl;
+
+    //-------------------------------------------------------------------------
+    // insertions: an expansion each(an object id still deleted must wait
+    // for its compaction)
+    //-------------------------------------------------------------------------
+    cerr << "inserting ... ";
+    vector<int> insnode, insid;
+    if (strlen(insflname) > 0)
+    {
+        fstream fobj;
+        fobj.open(insflname, ios::in);
+        while (true)
+        {
+            int nodeid, objid;
+            fobj >> nodeid;
+            if (fobj.eof())
+                break;
+            fobj >> objid;
+            insnode.push_back(nodeid);
+            insid.push_back(objid);
+        }
+    }
+    const long nodecnt = graph.m_nodes.size() > 0 ? graph.m_nodes.size() : 1;
+    int batch = budget / (nodecnt * sizeof(PackedSignatures::Sign));
+    if (batch < 1) batch = 1;
+    int numins = 0;
+    for (int first=0; first<(int)insid.size(); first+=batch)
+    {
+        segmem.m_history.clean();
+        numins += didx.insertObjects(graph, &insid[first], &insnode[first],
+            min(batch, (int)insid.size() - first));
+    }
+    int numfail = insid.size() - numins;
+    cerr << "[DONE]" << endl;
+
+    ftime(&endtime);
+    float updtime =
+        ((endtime.time*1000 + endtime.millitm) -
+        (starttime.time*1000 + starttime.millitm)) / 1000.0f;
+
+    cout << "#insert:," << numins << ",#reject:," << numfail;
+    cout << ",#delete:," << numdel << ",#stale:," << left;
+    cout << ",updtime:," << updtime << endl;
+
+    return 0;
+}
@@ -23,7 +23,7 @@ public:
     // constructor/destructor
     Edge(const int m_id, const float a_cost):
       m_neighbor(m_id), m_cost(a_cost) {};
-    virtual ~Edge() {};
+    ~Edge() {};
     //
     // storage size
     int size() const
@@ -0,0 +1,216 @@
+/* ----------------------------------------------------------------------------
+    This file contains a class template FlatHash declaration.
+    It is an open addressing hash map(robin hood) of keys to values kept
+    by value in one slot array: no allocation per entry, no fixed bucket
+    count.
+
+    - capacity is a power of 2, it doubles when the map is over 7/8 full,
+      reserve(n) sizes it for n entries up front
+    - a key goes to the home slot of its hash and probes forward, an entry
+      farther from its home takes the slot of a nearer one(so lookups stop
+      at the first entry nearer to its home than the key would be), and
+      remove shifts the following entries back(no tombstones)
+    - the hash of a key is FlatHashKey<K>::hash, specialized for int
+      (Fibonacci hashing, node ids are consecutive), any other key type
+      goes through std::hash
+    - the slots can be walked(capacity, used, key, val) for an iterator,
+      the order is the one of the slots
+---------------------------------------------------------------------------- */
+#ifndef flathash_defined
+#define flathash_defined
+
+#include <vector>
+#include <functional>
+#include <utility>
+#include <stddef.h>
+
+template<class K>
+class FlatHashKey
+{
+public:
+    static unsigned hash(const K& a_key)
+    {
+        return (unsigned)std::hash<K>()(a_key) * 2654435761u;
+    };
+};
+
+template<>
+class FlatHashKey<int>
+{
+public:
+    static unsigned hash(const int a_key)
+    {
+        return (unsigned)a_key * 2654435761u;
+    };
+};
+
+template<class K, class V, class H=FlatHashKey<K> >
+class FlatHash
+{
+protected:
+    class Slot
+    {
+    public:
+        K       m_key;
+        V       m_val;
+        int     m_dist;     // 0 if free, else 1 + distance from home
+    };
+    std::vector<Slot>   m_slots;
+    int                 m_bits;     // capacity = 2^bits
+    int                 m_size;
+
+    int home(const K& a_key) const
+    {
+        return m_bits == 0 ? 0 : (int)(H::hash(a_key) >> (32 - m_bits));
+    };
+    int mask() const
+    {
+        return (int)m_slots.size() - 1;
+    };
+    int locate(const K& a_key) const    // slot of a key, -1 if absent
+    {
+        if (m_size == 0) return -1;
+        int i = home(a_key);
+        for (int d=1; ; d++)
+        {
+            const Slot& s = m_slots[i];
+            if (s.m_dist < d) return -1;
+            if (s.m_dist == d && s.m_key == a_key) return i;
+            i = (i + 1) & mask();
+        }
+    };
+    void place(K a_key, V a_val)        // a key known to be absent
+    {
+        int i = home(a_key);
+        int d = 1;
+        while (true)
+        {
+            Slot& s = m_slots[i];
+            if (s.m_dist == 0)
+            {
+                s.m_key = a_key;
+                s.m_val = a_val;
+                s.m_dist = d;
+                return;
+            }
+            if (s.m_dist < d)           // take the slot of a nearer entry
+            {
+                std::swap(s.m_key, a_key);
+                std::swap(s.m_val, a_val);
+                std::swap(s.m_dist, d);
+            }
+            i = (i + 1) & mask();
+            d++;
+        }
+    };
+    void rehash(const int a_bits)
+    {
+        std::vector<Slot> old;
+        old.swap(m_slots);
+        m_bits = a_bits;
+        m_slots.assign((size_t)1 << a_bits, Slot());
+        for (int i=0; i<(int)m_slots.size(); i++)
+            m_slots[i].m_dist = 0;
+        for (int i=0; i<(int)old.size(); i++)
+            if (old[i].m_dist != 0)
+                place(old[i].m_key, old[i].m_val);
+    };
+public:
+    // constructor/destructor
+    FlatHash(const int a_reserve=0): m_bits(0), m_size(0)
+    {
+        reserve(a_reserve);
+    };
+    virtual ~FlatHash() {};
+    //
+    // update
+    void reserve(const int a_n)         // room for a_n entries
+    {
+        int bits = m_bits;
+        while (((size_t)1 << bits) * 7 < (size_t)(a_n < 1 ? 1 : a_n) * 8)
+            bits++;
+        if (bits > m_bits || m_slots.empty())
+            rehash(bits);
+    };
+    bool put(const K& a_key, const V& a_val)    // false if the key is in
+    {
+        if (locate(a_key) != -1) return false;
+        if (((size_t)m_size + 1) * 8 > m_slots.size() * 7)
+            rehash(m_bits + 1);
+        place(a_key, a_val);
+        m_size++;
+        return true;
+    };
+    bool replace(const K& a_key, const V& a_val)    // false if it is not
+    {
+        int i = locate(a_key);
+        if (i == -1) return false;
+        m_slots[i].m_val = a_val;
+        return true;
+    };
+    bool remove(const K& a_key)
+    {
+        int i = locate(a_key);
+        if (i == -1) return false;
+        // ------------------------------------------------------------------------
+        // shift back the entries after it until one is at home or a slot free
+        // ------------------------------------------------------------------------
+        int j = (i + 1) & mask();
+        while (m_slots[j].m_dist > 1)
+        {
+            m_slots[i] = m_slots[j];
+            m_slots[i].m_dist--;
+            i = j;
+            j = (j + 1) & mask();
+        }
+        m_slots[i].m_dist = 0;
+        m_size--;
+        return true;
+    };
+    void clean()
+    {
+        for (int i=0; i<(int)m_slots.size(); i++)
+            m_slots[i].m_dist = 0;
+        m_size = 0;
+    };
+    //
+    // search
+    int size() const
+    {
+        return m_size;
+    };
+    const V* find(const K& a_key) const     // 0 if the key is not in
+    {
+        int i = locate(a_key);
+        return i == -1 ? 0 : &m_slots[i].m_val;
+    };
+    V* find(const K& a_key)
+    {
+        int i = locate(a_key);
+        return i == -1 ? 0 : &m_slots[i].m_val;
+    };
+    bool in(const K& a_key) const
+    {
+        return locate(a_key) != -1;
+    };
+    //
+    // slots
+    int capacity() const
+    {
+        return m_slots.size();
+    };
+    bool used(const int a_slot) const
+    {
+        return m_slots[a_slot].m_dist != 0;
+    };
+    const K& key(const int a_slot) const
+    {
+        return m_slots[a_slot].m_key;
+    };
+    const V& val(const int a_slot) const
+    {
+        return m_slots[a_slot].m_val;
+    };
+};
+
+#endif
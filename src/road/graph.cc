@@ -8,10 +8,12 @@
 #include "graph.h"
 #include "node.h"
 #include "segmem.h"
+#include "nodecache.h"
 
 // constructor/destructor
 Graph::Graph(SegMemory& a_nodeMem):
 m_nodeMem(a_nodeMem),
+m_cache(0),
 m_nodes(10000)
 {
     if (m_nodeMem.m_header == -1) return;
@@ -76,15 +78,46 @@ int Graph::writeNode(const int a_nid, const Node& a_node)
 }
 
 // search
-Node* Graph::getNode(const int a_nid)
+Node* Graph::readNode(const int a_nid, int& a_len)
 {
     // ------------------------------------------------------------------------
     // retrieve a node from memory
     // ------------------------------------------------------------------------
     int pos = (long)m_nodes.get(a_nid);
     char* mem = (char*)m_nodeMem.read(pos);
-    int len=0;
+    a_len=0;
     Node* n = new Node(a_nid);
-    n->fromMem(mem,len);    // content unmarshalling
+    n->fromMem(mem,a_len);    // content unmarshalling
     return n;
 }
+
+Node* Graph::getNode(const int a_nid)
+{
+    int len;
+    return readNode(a_nid, len);
+}
+
+std::shared_ptr<const Node> Graph::getSharedNode(const int a_nid)
+{
+    if (m_cache != 0)
+    {
+        NodeCache::Handle h = m_cache->find(a_nid);
+        if (h) return std::static_pointer_cast<const Node>(h);
+    }
+    int len;
+    std::shared_ptr<const Node> n(readNode(a_nid, len));
+    if (m_cache == 0) return n;
+    return std::static_pointer_cast<const Node>(m_cache->insert(a_nid, n, len));
+}
+
+void Graph::prefetchNode(const int a_nid)
+{
+    int pos = (long)m_nodes.get(a_nid);
+    if (pos != 0)
+        m_nodeMem.prefetch(pos);
+}
+
+void Graph::setCache(NodeCache* a_cache)
+{
+    m_cache = a_cache;
+}
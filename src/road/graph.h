@@ -14,12 +14,17 @@
 
 class Node;
 class SegMemory;
+class NodeCache;
 #include "collection.h"
+#include <memory>
 
 class Graph
 {
 protected:
     SegMemory&  m_nodeMem;  // handle of memory for edges
+    NodeCache*  m_cache;    // decoded nodes(0: none)
+
+    virtual Node* readNode(const int a_nid, int& a_len);    // decode, a_len = bytes
 public:
     Hash        m_nodes;    // hash of node to its content in memory
 public:
@@ -31,7 +36,13 @@ public:
     virtual int writeNode(const int a_nid, const Node& a_node);
     //
     // search
-    virtual Node* getNode(const int a_nid);
+    virtual Node* getNode(const int a_nid);     // a new node, deleted by the caller
+    virtual std::shared_ptr<const Node> getSharedNode(const int a_nid);
+    SegMemory& memory() const { return m_nodeMem; };    // of the nodes
+    void prefetchNode(const int a_nid);     // a hint: the node is read soon
+    //
+    // cache of decoded nodes for getSharedNode(not owned, 0 to stop caching)
+    void setCache(NodeCache* a_cache);
 };
 
 #endif
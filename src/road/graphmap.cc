@@ -1,4 +1,11 @@
 #include "graphmap.h"
+#include "hiergraph.h"
+#include "nodemap.h"
+#include "searchtrail.h"
+#include "pqueue.h"
+#include <vector>
+
+#define BOUNDSLACK  0.99999f    // float sums of other paths may be lower
 
 GraphMapping::GraphMapping()
 {}
@@ -21,6 +28,9 @@ void GraphMapping::addObject(const int a_graphid, const int a_objid)
         m_graph2obj.put(a_graphid, a=new Array());
     a->append((void*)a_objid);
     a->removeDuplicate();
+    if (!m_count.replace(a_graphid, a->size()))
+        m_count.put(a_graphid, a->size());
+    m_exact.remove(a_graphid);
 
     // ------------------------------------------------------------------------
     // associate a graph to an object
@@ -38,7 +48,11 @@ void GraphMapping::delObject(const int a_graphid, const int a_objid)
     // ------------------------------------------------------------------------
     Array* a = (Array*)m_graph2obj.get(a_graphid);
     if (a != 0)
+    {
         a->remove((void*)a_objid);
+        m_count.replace(a_graphid, a->size());
+        m_exact.remove(a_graphid);
+    }
 
     // ------------------------------------------------------------------------
     // delete a node from an object
@@ -53,3 +67,104 @@ const Array* GraphMapping::findObject(const int a_graphid) const
     // ------------------------------------------------------------------------
     return (const Array*)m_graph2obj.get(a_graphid);
 }
+
+int GraphMapping::count(const int a_graphid) const
+{
+    const int* c = m_count.find(a_graphid);
+    return c == 0 ? 0 : *c;
+}
+
+float GraphMapping::bound(const int a_graphid, const int a_border) const
+{
+    if (!m_exact.in(a_graphid))
+        return 0;
+    const float* b = m_bound.find(boundKey(a_graphid, a_border));
+    return b == 0 ? 0 : *b;
+}
+
+// ----------------------------------------------------------------------------
+// bounds
+// ----------------------------------------------------------------------------
+void GraphMapping::computeBounds(HierGraph& a_graph, const NodeMapping& a_nmap)
+{
+    m_bound.clean();
+    m_exact.clean();
+
+    // ------------------------------------------------------------------------
+    // border nodes of the subgraphs with objects: the nodes with shortcuts
+    // of a subgraph
+    // ------------------------------------------------------------------------
+    FlatHash<int, std::vector<int> > borders;
+    FlatHash<int,int> obj2node;
+    for (HashReader rdr(a_nmap.m_node2obj); !rdr.isEnd(); rdr.next())
+    {
+        const Array* objs = (const Array*)rdr.getVal();
+        for (int i=0; i<objs->size(); i++)
+            obj2node.put((long)objs->get(i), rdr.getKey());
+    }
+    for (HashReader rdr(a_graph.m_nodes); !rdr.isEnd(); rdr.next())
+    {
+        ShortcutCSR sc = a_graph.getShortcuts(rdr.getKey());
+        for (int i=0; i<sc.nodes(); i++)
+        {
+            int graphid = sc.subnet(i);
+            if (graphid == 0 || sc.linkEnd(i) == sc.linkBegin(i) ||
+                count(graphid) == 0)
+                continue;
+            std::vector<int>* b = borders.find(graphid);
+            if (b == 0)
+            {
+                borders.put(graphid, std::vector<int>());
+                b = borders.find(graphid);
+            }
+            b->push_back(rdr.getKey());
+        }
+    }
+
+    // ------------------------------------------------------------------------
+    // a Dijkstra's search from the objects of each subgraph until all its
+    // borders are reached
+    // ------------------------------------------------------------------------
+    for (int s=0; s<borders.capacity(); s++)
+    {
+        if (!borders.used(s)) continue;
+        const int graphid = borders.key(s);
+        const std::vector<int>& b = borders.val(s);
+        Set want(b.size());
+        for (int i=0; i<(int)b.size(); i++)
+            want.insert((void*)b[i]);
+        int left = b.size();
+
+        Set visited;
+        PQueue<SearchEntry> h(1000);
+        const Array* objs = findObject(graphid);
+        for (int i=0; i<objs->size(); i++)
+        {
+            const int* nid = obj2node.find((long)objs->get(i));
+            if (nid != 0)
+                h.insert(SearchEntry(*nid,0,-1));
+        }
+        while (!h.isEmpty() && left > 0)
+        {
+            SearchEntry c = h.removeTop();
+            if (visited.in((void*)c.m_nid))
+                continue;
+            visited.insert((void*)c.m_nid);
+            if (want.in((void*)c.m_nid))
+            {
+                m_bound.put(boundKey(graphid, c.m_nid), c.m_cost * BOUNDSLACK);
+                left--;
+            }
+            ShortcutCSR sc = a_graph.getShortcuts(c.m_nid);
+            for (int i=0; i<sc.nodes(); i++)
+            {
+                if (sc.subnet(i) != 0) continue;
+                for (int j=sc.linkBegin(i); j<sc.linkEnd(i); j++)
+                    if (!visited.in((void*)sc.link(j)->m_neighbor))
+                        h.insert(SearchEntry(sc.link(j)->m_neighbor,
+                            c.m_cost + sc.link(j)->m_cost, -1));
+            }
+        }
+        m_exact.put(graphid, 1);
+    }
+}
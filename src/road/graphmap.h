@@ -8,17 +8,34 @@
 
     This file contains a class GraphMapping declaration.
     That maps objects to a subgraph and vice versa
+
+    It also keeps the number of objects in each subgraph and, once computed
+    (computeBounds), a lower bound of the distance from each border node of
+    a subgraph to the objects in it, so a search can pass a subgraph whose
+    objects are out of its reach.
 ---------------------------------------------------------------------------- */
 #ifndef graphmapping_defined
 #define graphmapping_defined
 
 #include "collection.h"
+#include "flathash.h"
+class HierGraph;
+class NodeMapping;
 
 class GraphMapping
 {
 public:
     Hash    m_graph2obj;
     Hash    m_obj2graph;
+protected:
+    FlatHash<int,int>           m_count;    // subgraph -> #objects
+    FlatHash<long long,float>   m_bound;    // (subgraph, border) -> bound
+    FlatHash<int,int>           m_exact;    // subgraphs with bounds computed
+
+    static long long boundKey(const int a_graphid, const int a_border)
+    {
+        return ((long long)a_graphid << 32) | (unsigned)a_border;
+    };
 public:
     GraphMapping();
     virtual ~GraphMapping();
@@ -29,6 +46,15 @@ public:
     //
     // search
     const Array* findObject(const int a_graphid) const;
+    int count(const int a_graphid) const;   // objects in a subgraph
+    float bound(const int a_graphid, const int a_border) const;  // 0 unknown
+    //
+    // bounds: the distance from every border node of a subgraph with objects
+    // to the nearest of them(a search from its objects over the original
+    // edges until its borders are reached). addObject/delObject keep the
+    // counts, the bounds of a subgraph they change fall to 0 until computed
+    // again
+    void computeBounds(HierGraph& a_graph, const NodeMapping& a_nmap);
 };
 
 #endif
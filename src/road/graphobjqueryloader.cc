@@ -228,10 +228,10 @@ int main(const int a_argc, const char** a_argv)
         for (int c1=0; c1<m->m_edges.size(); c1++)
         {
             int found = 0;
-            const Edge* e1 = (const Edge*)m->m_edges.get(c1);
+            const Edge* e1 = &m->m_edges[c1];
             for (int c2=0; c2<node->m_edges.size(); c2++)
             {
-                const Edge* e2 = (const Edge*)node->m_edges.get(c2);
+                const Edge* e2 = &node->m_edges[c2];
                 if (e1->m_neighbor == e2->m_neighbor &&
                     e1->m_cost == e2->m_cost)
                     found = 1;
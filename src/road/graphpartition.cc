@@ -12,9 +12,13 @@
 #include "bordernode.h"
 #include "graphsearch.h"
 #include "hiergraph.h"
+#include "../common/task_pool.h"
 #include <sys/types.h>
 #include <sys/timeb.h>
 #include <iostream>
+#ifdef USE_METIS
+#include <metis.h>
+#endif
 using namespace std;
 
 
@@ -80,7 +84,7 @@ void extractEdge(Hash& a_nodes, Array& a_edges)
         Node* node = (Node*)rdr.getVal();
         for (int i=0; i<node->m_edges.size(); i++)
         {
-            Edge* e = (Edge*)node->m_edges.get(i);
+            Edge* e = &node->m_edges[i];
             if (e->m_neighbor < node->m_id)
                 continue;
             Node* dst = (Node*)a_nodes.get(e->m_neighbor);
@@ -211,6 +215,74 @@ void binPartition(Array& a_edges, Array& a_border,
     // currently this is disabled.
 }
 
+// ----------------------------------------------------------------------------
+// split by a partitioner: the edges of a part keep their order, the borders
+// of a part are the borders of the subgraph on it and the nodes it shares
+// ----------------------------------------------------------------------------
+void kpartition(Array& a_edges, Array& a_borders,
+                Array& a_edgess, Array& a_borderss,
+                const int a_k, GraphPartition::Partitioner& a_partitioner)
+{
+    const int numedges = a_edges.size();
+    std::vector<GraphPartition::PartEdge> pe(numedges);
+    for (int i=0; i<numedges; i++)
+    {
+        NodeEdge* e = (NodeEdge*)a_edges.get(i);
+        pe[i].m_src = e->m_src;
+        pe[i].m_dest = e->m_dest;
+        pe[i].m_srcx = e->m_srcx;
+        pe[i].m_srcy = e->m_srcy;
+        pe[i].m_destx = e->m_destx;
+        pe[i].m_desty = e->m_desty;
+        pe[i].m_cost = e->m_src2dest;
+    }
+    std::vector<int> part(numedges, 0);
+    if (numedges > 0)
+        a_partitioner.split(pe, a_k, part);
+
+    // ------------------------------------------------------------------------
+    // nodes in more than one part
+    // ------------------------------------------------------------------------
+    Hash home(numedges+1);      // node -> its first part + 1
+    Set shared;
+    for (int i=0; i<numedges; i++)
+    {
+        int n[2] = {pe[i].m_src, pe[i].m_dest};
+        for (int j=0; j<2; j++)
+        {
+            int h = (long)home.get(n[j]);
+            if (h == 0)
+                home.put(n[j], (void*)(long)(part[i]+1));
+            else if (h != part[i]+1)
+                shared.insert((void*)n[j]);
+        }
+    }
+
+    a_borders.sort();
+    for (int p=0; p<a_k; p++)
+    {
+        a_edgess.append(new Array(numedges/a_k+1));
+        a_borderss.append(new Array);
+    }
+    for (int i=0; i<numedges; i++)
+    {
+        Array* edges = (Array*)a_edgess.get(part[i]);
+        Array* borders = (Array*)a_borderss.get(part[i]);
+        edges->append(a_edges.get(i));
+        int n[2] = {pe[i].m_src, pe[i].m_dest};
+        for (int j=0; j<2; j++)
+            if (shared.in((void*)n[j]) ||
+                a_borders.binSearch((void*)n[j]) != -1)
+                borders->append((void*)n[j]);
+    }
+    for (int p=0; p<a_k; p++)
+    {
+        Array* borders = (Array*)a_borderss.get(p);
+        if (borders->size() > 0)
+            borders->removeDuplicate();
+    }
+}
+
 void kpartition(Array& a_edges, Array& a_borders,
                 Array& a_edgess, Array& a_borderss,
                 const int a_k)
@@ -262,10 +334,10 @@ class ShortcutPath
 public:
     const int   m_src;
     const int   m_dest;
-    Array       m_path;
+    NodePath    m_path;
     const float m_cost;
 public:
-    ShortcutPath(const int a_src, const int a_dest, Array& a_path, const float a_cost):
+    ShortcutPath(const int a_src, const int a_dest, const NodePath& a_path, const float a_cost):
       m_src(a_src), m_dest(a_dest), m_path(a_path), m_cost(a_cost)
       {};
     ~ShortcutPath() {};
@@ -288,7 +360,8 @@ public:
     ~GraphTree() {};
 };
 
-GraphTree* partition(Hash& a_nodes, const int a_k, const int a_level)
+GraphTree* partition(Hash& a_nodes, const int a_k, const int a_level,
+                     GraphPartition::Partitioner* a_partitioner)
 {
     // ------------------------------------------------------------------------
     // initialization
@@ -309,7 +382,11 @@ GraphTree* partition(Hash& a_nodes, const int a_k, const int a_level)
 
         Array edgess;
         Array borderss;
-        kpartition(t->m_nodeedges, t->m_borders, edgess, borderss, a_k);
+        if (a_partitioner == 0)
+            kpartition(t->m_nodeedges, t->m_borders, edgess, borderss, a_k);
+        else
+            kpartition(t->m_nodeedges, t->m_borders, edgess, borderss, a_k,
+                *a_partitioner);
         for (int i=0; i<a_k; i++)
         {
             Array* edges = (Array*)edgess.get(i);
@@ -342,7 +419,7 @@ void deleteGraphTree(GraphTree* a_root)
     }
 }
 
-void computeShortcut(GraphTree* a_root, const int a_level)
+void computeShortcut(GraphTree* a_root, const int a_level, const int a_threads)
 {
     Array* gtreelevel = new Array[a_level+1];
     Queue q;
@@ -368,37 +445,57 @@ void computeShortcut(GraphTree* a_root, const int a_level)
     for (int i=a_level; i>=0; i--)
     {
 cerr << "create shortcuts at level: " << i << " (#subnets:" << gtreelevel[i].size() << ")" << endl;
+        // --------------------------------------------------------------------
+        // prepare a list of border nodes of each subnet
+        // --------------------------------------------------------------------
+        std::vector<Set*> borders(gtreelevel[i].size());
+        std::vector< std::pair<int,int> > task;     // (subnet, border)
         for (int j=0; j<gtreelevel[i].size(); j++)
         {
             GraphTree* t = (GraphTree*)gtreelevel[i].get(j);
-            
-            // ----------------------------------------------------------------
-            // prepare a list of border nodes
-            // ----------------------------------------------------------------
-            Set borders(t->m_borders.size());
+            borders[j] = new Set(t->m_borders.size());
             for (int k=0; k<t->m_borders.size(); k++)
-                borders.insert(t->m_borders.get(k));
+            {
+                borders[j]->insert(t->m_borders.get(k));
+                task.push_back(std::make_pair(j,k));
+            }
+        }
 
-            for (int k=0; k<t->m_borders.size(); k++)
+        // --------------------------------------------------------------------
+        // one search per border node of a subnet, on a_threads(the nodes of
+        // the level are only read), the shortcuts kept per task
+        // --------------------------------------------------------------------
+        std::vector< std::vector<ShortcutPath*> > found(task.size());
+        parallel_for(a_threads, task.size(), [&](int a_worker, int a_task)
+        {
+            GraphTree* t = (GraphTree*)gtreelevel[i].get(task[a_task].first);
+            int src = (long)t->m_borders.get(task[a_task].second);
+            Hash result(t->m_borders.size());
+            int na=0, ea=0;
+            GraphSearch::shortestPathSearch(nodes, src,
+                *borders[task[a_task].first], result, na, ea);
+            for (HashReader r(result); !r.isEnd(); r.next())
             {
-                int src = (long)t->m_borders.get(k);
-                Hash result(t->m_borders.size());
-                int na=0, ea=0;
-                GraphSearch::shortestPathSearch(nodes, src, borders, result, na, ea);
-
-                // ------------------------------------------------------------
-                // add shortcuts
-                // ------------------------------------------------------------
-                for (HashReader r(result); !r.isEnd(); r.next())
-                {
-                    int dest = r.getKey();
-                    GraphSearchResult* res = (GraphSearchResult*)r.getVal();
-                    if (src != dest || result.size() == 1)
-                        t->m_shortcuts.append(new ShortcutPath(src, dest, res->m_path, res->m_cost));
-                    delete res; // clean the result
-                }
+                int dest = r.getKey();
+                GraphSearchResult* res = (GraphSearchResult*)r.getVal();
+                if (src != dest || result.size() == 1)
+                    found[a_task].push_back(
+                        new ShortcutPath(src, dest, res->m_path, res->m_cost));
+                delete res; // clean the result
             }
+        });
+
+        // --------------------------------------------------------------------
+        // add shortcuts(in the order of a serial run)
+        // --------------------------------------------------------------------
+        for (int x=0; x<(int)task.size(); x++)
+        {
+            GraphTree* t = (GraphTree*)gtreelevel[i].get(task[x].first);
+            for (int y=0; y<(int)found[x].size(); y++)
+                t->m_shortcuts.append(found[x][y]);
         }
+        for (int j=0; j<(int)borders.size(); j++)
+            delete borders[j];
         // --------------------------------------------------------------------
         // clean up the nodes;
         // --------------------------------------------------------------------
@@ -445,6 +542,39 @@ void createBorderNodes(Hash& a_nodes, Hash& a_bnodes)
     }
 }
 
+// ----------------------------------------------------------------------------
+// order the border nodes are written in: the nodes of a leaf subnet in a row,
+// the leaves as a depth first walk of the graph tree meets them(so siblings
+// come next to each other), a node on several leaves with the first one
+// ----------------------------------------------------------------------------
+void layoutOrder(GraphTree* a_root, Hash& a_bnodes, Array& a_order)
+{
+    Hash placed(a_bnodes.size());
+    Stack s;
+    s.push(a_root);
+    while (!s.isEmpty())
+    {
+        GraphTree* t = (GraphTree*)s.pop();
+        for (int i=t->m_children.size()-1; i>=0; i--)   // first child on top
+            s.push(t->m_children.get(i));
+        if (t->m_children.size() > 0) continue;
+        for (int i=0; i<t->m_nodeedges.size(); i++)
+        {
+            NodeEdge* e = (NodeEdge*)t->m_nodeedges.get(i);
+            int n[2] = {e->m_src, e->m_dest};
+            for (int j=0; j<2; j++)
+                if (placed.get(n[j]) == 0)
+                {
+                    placed.put(n[j], (void*)1);
+                    a_order.append((void*)n[j]);
+                }
+        }
+    }
+    for (HashReader rdr(a_bnodes); !rdr.isEnd(); rdr.next())  // no edge
+        if (placed.get(rdr.getKey()) == 0)
+            a_order.append((void*)rdr.getKey());
+}
+
 void createShortcuts(GraphTree* a_root, Hash& a_nodes)
 {
     class carrier
@@ -526,7 +656,9 @@ void createShortcuts(GraphTree* a_root, Hash& a_nodes)
 void GraphPartition::geoPartition(Hash& a_nodes, const int a_k, const int a_level,
                                   HierGraph& a_hiergraph,
                                   float& a_parttime,
-                                  float& a_shorttime)
+                                  float& a_shorttime,
+                                  const int a_threads,
+                                  Partitioner* a_partitioner)
 {
     // ------------------------------------------------------------------------
     // initialization
@@ -545,7 +677,7 @@ void GraphPartition::geoPartition(Hash& a_nodes, const int a_k, const int a_leve
     // ------------------------------------------------------------------------
 cerr << "start creating a hierarchical graph" << endl;
     ftime(&starttime);                  // time the algorithm
-    t = partition(a_nodes, a_k, a_level);    // partitioning
+    t = partition(a_nodes, a_k, a_level, a_partitioner);    // partitioning
     ftime(&endtime);
     a_parttime = 
         ((endtime.time*1000 + endtime.millitm) -
@@ -558,17 +690,19 @@ cerr << "end creating hierarchical graph" << endl;
     // ------------------------------------------------------------------------
 cerr << "start creating shortcuts" << endl;
     ftime(&starttime);                  // time the algorithm
-    computeShortcut(t,a_level);         // determine the shortcuts
+    computeShortcut(t,a_level,a_threads);   // determine the shortcuts
+    Array order;
+    layoutOrder(t,bnodes,order);        // before the leaf edges go
     createShortcuts(t,bnodes);
 cerr << "end creating shortcuts" << endl;
 
     // ------------------------------------------------------------------------
-    // store the border nodes to hiergraph
+    // store the border nodes to hiergraph, subnet by subnet(layoutOrder)
     // ------------------------------------------------------------------------
-    for (HashReader rdr(bnodes); !rdr.isEnd(); rdr.next())
+    for (int i=0; i<order.size(); i++)
     {
-        BorderNode* b = (BorderNode*)rdr.getVal();
-        a_hiergraph.writeNode(rdr.getKey(), *b);
+        int nid = (long)order.get(i);
+        a_hiergraph.writeNode(nid, *(BorderNode*)bnodes.get(nid));
     }
     ftime(&endtime);
     a_shorttime = 
@@ -582,3 +716,67 @@ cerr << "end creating shortcuts" << endl;
     return;
 }
 
+
+#ifdef USE_METIS
+// ----------------------------------------------------------------------------
+// METIS partitioner
+// ----------------------------------------------------------------------------
+void GraphPartition::MetisPartitioner::split(const std::vector<PartEdge>& a_edges,
+                                             const int a_k,
+                                             std::vector<int>& a_part)
+{
+    // ------------------------------------------------------------------------
+    // the nodes of the subgraph(0..n-1) and their adjacency(CSR)
+    // ------------------------------------------------------------------------
+    Hash index(a_edges.size()+1);   // node -> its index + 1
+    std::vector<idx_t> degree;
+    for (int i=0; i<(int)a_edges.size(); i++)
+    {
+        int n[2] = {a_edges[i].m_src, a_edges[i].m_dest};
+        for (int j=0; j<2; j++)
+        {
+            if (index.get(n[j]) == 0)
+            {
+                degree.push_back(0);
+                index.put(n[j], (void*)(long)degree.size());
+            }
+            degree[(long)index.get(n[j])-1]++;
+        }
+    }
+    idx_t nvtxs = degree.size();
+    idx_t ncon = 1;
+    idx_t nparts = a_k;
+    std::vector<idx_t> part(nvtxs, 0);
+    if (a_k > 1 && nvtxs > a_k)
+    {
+        std::vector<idx_t> xadj(nvtxs+1, 0);
+        for (int v=0; v<nvtxs; v++)
+            xadj[v+1] = xadj[v] + degree[v];
+        std::vector<idx_t> adjncy(xadj[nvtxs]);
+        std::vector<idx_t> pos(xadj.begin(), xadj.end()-1);
+        for (int i=0; i<(int)a_edges.size(); i++)
+        {
+            idx_t s = (long)index.get(a_edges[i].m_src)-1;
+            idx_t d = (long)index.get(a_edges[i].m_dest)-1;
+            adjncy[pos[s]++] = d;
+            adjncy[pos[d]++] = s;
+        }
+        idx_t options[METIS_NOPTIONS];
+        METIS_SetDefaultOptions(options);
+        options[METIS_OPTION_NUMBERING] = 0;
+        idx_t objval;
+        if (METIS_PartGraphKway(&nvtxs, &ncon, &xadj[0], &adjncy[0],
+                NULL, NULL, NULL, &nparts, NULL, NULL, options,
+                &objval, &part[0]) != METIS_OK)
+            for (int v=0; v<nvtxs; v++)
+                part[v] = v % a_k;
+    }
+    else
+    {
+        for (int v=0; v<nvtxs; v++)
+            part[v] = v % a_k;
+    }
+    for (int i=0; i<(int)a_edges.size(); i++)
+        a_part[i] = part[(long)index.get(a_edges[i].m_src)-1];
+}
+#endif
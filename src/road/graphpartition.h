@@ -11,16 +11,58 @@
 #define graphpartition_defined
 
 #include "collection.h"
+#include <vector>
 class HierGraph;
 
 class GraphPartition
 {
 public:
+    // ------------------------------------------------------------------------
+    // an edge of a subgraph to be split
+    // ------------------------------------------------------------------------
+    class PartEdge
+    {
+    public:
+        int     m_src, m_dest;
+        float   m_srcx, m_srcy;
+        float   m_destx, m_desty;
+        float   m_cost;
+    };
+
+    // ------------------------------------------------------------------------
+    // partitioner: puts edge i of a subgraph into part a_part[i] of [0, a_k),
+    // a node on the edges of several parts is a border of each of them
+    // (geoPartition bisects by coordinates itself without one)
+    // ------------------------------------------------------------------------
+    class Partitioner
+    {
+    public:
+        virtual ~Partitioner() {};
+        virtual void split(const std::vector<PartEdge>& a_edges, const int a_k,
+                           std::vector<int>& a_part)=0;
+    };
+#ifdef USE_METIS
+    // k-way METIS partition of the nodes(fewest cut edges), an edge goes to
+    // the part of its source
+    class MetisPartitioner: public Partitioner
+    {
+    public:
+        virtual void split(const std::vector<PartEdge>& a_edges, const int a_k,
+                           std::vector<int>& a_part);
+    };
+#endif
+
+    // ------------------------------------------------------------------------
+    // a_threads compute the shortcuts of a level(the subnets of a level are
+    // independent), a_partitioner 0 for the coordinate bisection
+    // ------------------------------------------------------------------------
     static void geoPartition(
         Hash& a_nodes, const int a_k, const int a_level,
         HierGraph& a_hiergraph,
         float& a_parttime,     // partitioning time
-        float& a_shorttime);   // shortcut calculation time.
+        float& a_shorttime,    // shortcut calculation time.
+        const int a_threads=1,
+        Partitioner* a_partitioner=0);
 };
 
 #endif
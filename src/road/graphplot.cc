@@ -60,7 +60,7 @@ void drawgraph(PSDraw& a_draw, Graph& a_graph)
         Node* node = a_graph.getNode(nid);
         for (int i=0; i<node->m_edges.size(); i++)
         {
-            Edge* edge = (Edge*)node->m_edges.get(i);
+            Edge* edge = &node->m_edges[i];
             Node* dest = a_graph.getNode(edge->m_neighbor);
 
             a_draw.line(node->m_x, node->m_y, dest->m_x, dest->m_y, 0.5);
@@ -111,7 +111,7 @@ void GraphPlot::plot(const char* a_filename, Graph** a_graph, const int a_cnt)
             Node* node = a_graph[k]->getNode(nid);
             for (int i=0; i<node->m_edges.size(); i++)
             {
-                Edge* edge = (Edge*)node->m_edges.get(i);
+                Edge* edge = &node->m_edges[i];
                 Node* dest = a_graph[k]->getNode(edge->m_neighbor);
 
                 draw.line(node->m_x, node->m_y, dest->m_x, dest->m_y, (k+1)/10.f);
@@ -140,7 +140,7 @@ void GraphPlot::plot(const char* a_filename,
         Node* node = (Node*)rdr.getVal();
         for (int i=0; i<node->m_edges.size(); i++)
         {
-            Edge* edge = (Edge*)node->m_edges.get(i);
+            Edge* edge = &node->m_edges[i];
             Node* dest = (Node*)a_nodes.get(edge->m_neighbor);
             draw.line(node->m_x, node->m_y, dest->m_x, dest->m_y, 0.7f);
         }
@@ -172,7 +172,7 @@ void GraphPlot::plot(const char* a_filename,
         Node* node = (Node*)rdr.getVal();
         for (int i=0; i<node->m_edges.size(); i++)
         {
-            Edge* edge = (Edge*)node->m_edges.get(i);
+            Edge* edge = &node->m_edges[i];
             Node* dest = (Node*)a_nodes.get(edge->m_neighbor);
             draw.line(node->m_x, node->m_y, dest->m_x, dest->m_y, 0.7f);
         }
@@ -263,7 +263,7 @@ void GraphPlot::plot(const char* a_filename, Graph& a_graph,
         Node* node = a_graph.getNode(nid);
         for (int i=0; i<node->m_edges.size(); i++)
         {
-            Edge* edge = (Edge*)node->m_edges.get(i);
+            Edge* edge = &node->m_edges[i];
             Node* dest = a_graph.getNode(edge->m_neighbor);
             if (found && a_visitednode.binSearch((void*)edge->m_neighbor) != -1)
                 draw.line(node->m_x, node->m_y, dest->m_x, dest->m_y, 0.8f, 0, 0, 3);
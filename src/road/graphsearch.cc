@@ -9,7 +9,11 @@
 #include "graph.h"
 #include "node.h"
 #include "edge.h"
+#include "pqueue.h"
+#include "flathash.h"
 #include <math.h>
+#include <float.h>
+#include <algorithm>
 
 float GraphSearch::diameter(Graph& a_graph, const int a_src,
                             int& a_nodeaccess,
@@ -18,19 +22,15 @@ float GraphSearch::diameter(Graph& a_graph, const int a_src,
     class carrier
     {
     public:
-        const int   m_nodeid;
-        const float m_cost;
+        int     m_nodeid;
+        float   m_cost;
     public:
+        carrier() {};
         carrier(const int a_nodeid, const float a_cost):
             m_nodeid(a_nodeid), m_cost(a_cost) {};
-        ~carrier() {};
-        static int compare(const void* a0, const void* a1)
-        {
-            carrier* c0 = *(carrier**)a0;
-            carrier* c1 = *(carrier**)a1;
-            if (c0->m_cost < c1->m_cost) return -1;
-            if (c0->m_cost > c1->m_cost) return +1;
-            return 0;
+        bool operator<(const carrier& a_c) const
+        {
+            return m_cost < a_c.m_cost;
         };
     };
 
@@ -45,45 +45,35 @@ float GraphSearch::diameter(Graph& a_graph, const int a_src,
     // Dijkstra's shorest path search (best first)
     // ------------------------------------------------------------------------
     Set visited(1000);
-    BinHeap h(carrier::compare);
-    h.insert(new carrier(a_src,0));
+    PQueue<carrier> h(1000);
+    h.insert(carrier(a_src,0));
     while (!h.isEmpty())
     {
-        carrier* c = (carrier*)h.removeTop();
+        carrier c = h.removeTop();
         // --------------------------------------------------------------------
         // check if the node is visited. If so, skip it
         // --------------------------------------------------------------------
-        if (visited.in((void*)c->m_nodeid))
-        {
-            delete c;
+        if (visited.in((void*)c.m_nodeid))
             continue;
-        }
 
-        cost = c->m_cost;
-        visited.insert((void*)c->m_nodeid);
+        cost = c.m_cost;
+        visited.insert((void*)c.m_nodeid);
 
         // --------------------------------------------------------------------
         // expand the current scope
         // --------------------------------------------------------------------
-        Node* node = a_graph.getNode(c->m_nodeid);
+        Node* node = a_graph.getNode(c.m_nodeid);
         for (int e=0; e<node->m_edges.size(); e++)
         {
-            Edge* edge = (Edge*)node->m_edges.get(e);
-            h.insert(new carrier(edge->m_neighbor, c->m_cost + edge->m_cost));
+            Edge* edge = &node->m_edges[e];
+            h.insert(carrier(edge->m_neighbor, c.m_cost + edge->m_cost));
             a_edgeaccess++;
         }
         a_nodeaccess++;
 
         delete node;
-        delete c;
     }
 
-    // ------------------------------------------------------------------------
-    // clean up
-    // ------------------------------------------------------------------------
-    while (!h.isEmpty())
-        delete (carrier*)h.removeTop();
-
     // ------------------------------------------------------------------------
     // all done
     // ------------------------------------------------------------------------
@@ -99,65 +89,52 @@ void GraphSearch::spanSearch(Graph& a_graph, const int a_src,
     class carrier
     {
     public:
-        const int   m_prev;
-        const int   m_nid;
-        const float m_cost;
+        int     m_prev;
+        int     m_nid;
+        float   m_cost;
     public:
+        carrier() {};
         carrier(const int a_prev, const int a_nid, const float a_cost):
             m_prev(a_prev), m_nid(a_nid), m_cost(a_cost) {};
-        virtual ~carrier() {};
-        static int compare(const void* a0, const void* a1)
-        {
-            carrier* c0 = *(carrier**)a0;
-            carrier* c1 = *(carrier**)a1;
-            if (c0->m_cost < c1->m_cost) return -1;
-            if (c0->m_cost > c1->m_cost) return +1;
-            if (c0->m_nid < c1->m_nid) return -1;
-            if (c0->m_nid > c1->m_nid) return +1;
-            return 0;
+        bool operator<(const carrier& a_c) const
+        {
+            if (m_cost != a_c.m_cost) return m_cost < a_c.m_cost;
+            return m_nid < a_c.m_nid;
         };
     };
 
     Set visited(1000);
-    BinHeap h(carrier::compare);
-    h.insert(new carrier(a_src,a_src,0));
+    PQueue<carrier> h(1000);
+    h.insert(carrier(a_src,a_src,0));
     while (!h.isEmpty())
     {
-        carrier* c = (carrier*)h.removeTop();
+        carrier c = h.removeTop();
 
         // --------------------------------------------------------------------
         // filter out visited node
         // --------------------------------------------------------------------
-        if (visited.in((void*)c->m_nid))
-        {
-            delete c;
+        if (visited.in((void*)c.m_nid))
             continue;
-        }
-        visited.insert((void*)c->m_nid);
+        visited.insert((void*)c.m_nid);
 
         // --------------------------------------------------------------------
         // result collection
         // --------------------------------------------------------------------
-        GraphSearchResult* res = new GraphSearchResult(c->m_nid, c->m_cost);
+        GraphSearchResult* res = new GraphSearchResult(c.m_nid, c.m_cost);
         res->m_path.clean();
-        res->m_path.append((void*)c->m_prev);
+        res->m_path.append(c.m_prev);
         a_nodes2src.append(res);
 
         // --------------------------------------------------------------------
         // further expansion
         // --------------------------------------------------------------------
-        Node* n = (Node*)a_graph.getNode(c->m_nid);
+        Node* n = (Node*)a_graph.getNode(c.m_nid);
         for (int i=0; i<n->m_edges.size(); i++)
         {
-            Edge* e = (Edge*)n->m_edges.get(i);
-            h.insert(new carrier(c->m_nid,e->m_neighbor,e->m_cost + c->m_cost));
+            Edge* e = &n->m_edges[i];
+            h.insert(carrier(c.m_nid,e->m_neighbor,e->m_cost + c.m_cost));
         }
         delete n;
-
-        // --------------------------------------------------------------------
-        // clean up
-        // --------------------------------------------------------------------
-        delete c;
     }
 }
 
@@ -171,66 +148,254 @@ void GraphSearch::diffuseSearch(Graph& a_graph, const int a_src,
     class carrier
     {
     public:
-        const int   m_first;
-        const int   m_nid;
-        const float m_cost;
+        int     m_first;
+        int     m_nid;
+        float   m_cost;
     public:
+        carrier() {};
         carrier(const int a_first, const int a_nid, const float a_cost):
             m_first(a_first), m_nid(a_nid), m_cost(a_cost) {};
-        virtual ~carrier() {};
-        static int compare(const void* a0, const void* a1)
-        {
-            carrier* c0 = *(carrier**)a0;
-            carrier* c1 = *(carrier**)a1;
-            if (c0->m_cost < c1->m_cost) return -1;
-            if (c0->m_cost > c1->m_cost) return +1;
-            if (c0->m_nid < c1->m_nid) return -1;
-            if (c0->m_nid > c1->m_nid) return +1;
-            return 0;
+        bool operator<(const carrier& a_c) const
+        {
+            if (m_cost != a_c.m_cost) return m_cost < a_c.m_cost;
+            return m_nid < a_c.m_nid;
         };
     };
 
     Set visited(10000);
-    BinHeap h(carrier::compare);
-    h.insert(new carrier(a_src,a_src,0));
+    PQueue<carrier> h(1000);
+    h.insert(carrier(a_src,a_src,0));
     while (!h.isEmpty())
     {
-        carrier* c = (carrier*)h.removeTop();
+        carrier c = h.removeTop();
 
         // --------------------------------------------------------------------
         // filter out visited node
         // --------------------------------------------------------------------
-        if (visited.in((void*)c->m_nid))
-        {
-            delete c;
+        if (visited.in((void*)c.m_nid))
             continue;
-        }
-        visited.insert((void*)c->m_nid);
+        visited.insert((void*)c.m_nid);
 
         // --------------------------------------------------------------------
         // result collection
         // --------------------------------------------------------------------
-        GraphSearchResult* res = new GraphSearchResult(c->m_nid, c->m_cost);
+        GraphSearchResult* res = new GraphSearchResult(c.m_nid, c.m_cost);
         res->m_path.clean();
-        res->m_path.append((void*)c->m_first);
+        res->m_path.append(c.m_first);
         a_nodes2src.append(res);
 
         // --------------------------------------------------------------------
         // further expansion
         // --------------------------------------------------------------------
-        Node* n = (Node*)a_graph.getNode(c->m_nid);
+        Node* n = (Node*)a_graph.getNode(c.m_nid);
         for (int i=0; i<n->m_edges.size(); i++)
         {
-            Edge* e = (Edge*)n->m_edges.get(i);
-            int firstnode = c->m_first == a_src ? e->m_neighbor : c->m_first;
-            h.insert(new carrier(firstnode,e->m_neighbor,e->m_cost + c->m_cost));
+            Edge* e = &n->m_edges[i];
+            int firstnode = c.m_first == a_src ? e->m_neighbor : c.m_first;
+            h.insert(carrier(firstnode,e->m_neighbor,e->m_cost + c.m_cost));
         }
         delete n;
+    }
+}
 
-        // --------------------------------------------------------------------
-        // clean up
-        // --------------------------------------------------------------------
-        delete c;
+// ----------------------------------------------------------------------------
+// costs from up to MSLANES sources at once: the adjacency is read from the
+// node records once into arrays, every node gets a lane of costs and of
+// predecessors(by node index, -1 if not reached). a node is queued by the
+// least of its improved lanes and relaxes all its lanes at a time, so a
+// node settled for one source may be expanded again for another
+// ----------------------------------------------------------------------------
+static void lanes(Graph& a_graph, const int* a_src, const int a_cnt,
+                  std::vector<int>& a_nid, std::vector<float>& a_cost,
+                  std::vector<int>& a_prev)
+{
+    class carrier
+    {
+    public:
+        int     m_idx;
+        float   m_cost;
+    public:
+        carrier() {};
+        carrier(const int a_idx, const float a_cost):
+            m_idx(a_idx), m_cost(a_cost) {};
+        bool operator<(const carrier& a_c) const
+        {
+            if (m_cost != a_c.m_cost) return m_cost < a_c.m_cost;
+            return m_idx < a_c.m_idx;
+        };
+    };
+
+    //-------------------------------------------------------------------------
+    // adjacency arrays of the whole graph
+    //-------------------------------------------------------------------------
+    FlatHash<int,int> idx;
+    a_nid.clear();
+    for (HashReader r(a_graph.m_nodes); !r.isEnd(); r.next())
+    {
+        idx.put((int)(long)r.getKey(), a_nid.size());
+        a_nid.push_back((int)(long)r.getKey());
+    }
+    const int n = a_nid.size();
+    std::vector<int> first(n+1), adj;
+    std::vector<float> len;
+    for (int v=0; v<n; v++)
+    {
+        first[v] = adj.size();
+        Node* node = a_graph.getNode(a_nid[v]);
+        for (int e=0; e<node->m_edges.size(); e++)
+        {
+            Edge* edge = &node->m_edges[e];
+            const int* u = idx.find(edge->m_neighbor);
+            if (u == 0) continue;
+            adj.push_back(*u);
+            len.push_back(edge->m_cost);
+        }
+        delete node;
+    }
+    first[n] = adj.size();
+
+    //-------------------------------------------------------------------------
+    // label correcting search over the lanes
+    //-------------------------------------------------------------------------
+    a_cost.assign((long)n*MSLANES, FLT_MAX);
+    a_prev.assign((long)n*MSLANES, -1);
+    std::vector<float> queued(n, FLT_MAX);  // key of the live heap entry
+    PQueue<carrier> h(1000);
+    for (int l=0; l<a_cnt; l++)
+    {
+        const int* s = idx.find(a_src[l]);
+        if (s == 0) continue;
+        a_cost[(long)*s*MSLANES+l] = 0;
+        a_prev[(long)*s*MSLANES+l] = *s;
+        if (queued[*s] > 0)
+        {
+            queued[*s] = 0;
+            h.insert(carrier(*s, 0));
+        }
+    }
+    while (!h.isEmpty())
+    {
+        carrier c = h.removeTop();
+        if (c.m_cost != queued[c.m_idx])
+            continue;   // stale entry
+        queued[c.m_idx] = FLT_MAX;
+
+        const float* cu = &a_cost[(long)c.m_idx*MSLANES];
+        for (int e=first[c.m_idx]; e<first[c.m_idx+1]; e++)
+        {
+            float* cv = &a_cost[(long)adj[e]*MSLANES];
+            int* pv = &a_prev[(long)adj[e]*MSLANES];
+            const float w = len[e];
+            float key = FLT_MAX;
+            for (int l=0; l<MSLANES; l++)
+            {
+                const float cost = cu[l] + w;
+                if (cost < cv[l])
+                {
+                    cv[l] = cost;
+                    pv[l] = c.m_idx;
+                    key = cost < key ? cost : key;
+                }
+            }
+            if (key < queued[adj[e]])
+            {
+                queued[adj[e]] = key;
+                h.insert(carrier(adj[e], key));
+            }
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// nodes reached in a lane by increasing cost(node id on ties), the order in
+// which the single source search settles them
+// ----------------------------------------------------------------------------
+static void laneOrder(const std::vector<int>& a_nid,
+                      const std::vector<float>& a_cost, const int a_lane,
+                      std::vector<int>& a_order)
+{
+    a_order.clear();
+    for (int v=0; v<(int)a_nid.size(); v++)
+        if (a_cost[(long)v*MSLANES+a_lane] != FLT_MAX)
+            a_order.push_back(v);
+    std::sort(a_order.begin(), a_order.end(), [&](int a, int b)
+    {
+        const float ca = a_cost[(long)a*MSLANES+a_lane];
+        const float cb = a_cost[(long)b*MSLANES+a_lane];
+        if (ca != cb) return ca < cb;
+        return a_nid[a] < a_nid[b];
+    });
+}
+
+// ----------------------------------------------------------------------------
+// find spanning trees towards up to MSLANES nodes
+// ----------------------------------------------------------------------------
+void GraphSearch::spanSearch(Graph& a_graph, const int* a_dest,
+                             const int a_cnt, Array* a_nodes2dest)
+{
+    std::vector<int> nid, prev, order;
+    std::vector<float> cost;
+    lanes(a_graph, a_dest, a_cnt, nid, cost, prev);
+    for (int l=0; l<a_cnt; l++)
+    {
+        laneOrder(nid, cost, l, order);
+        for (int i=0; i<(int)order.size(); i++)
+        {
+            const long v = (long)order[i]*MSLANES+l;
+            GraphSearchResult* res =
+                new GraphSearchResult(nid[order[i]], cost[v]);
+            res->m_path.clean();
+            res->m_path.append(nid[prev[v]]);
+            a_nodes2dest[l].append(res);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// find spanning trees from up to MSLANES nodes
+// ----------------------------------------------------------------------------
+void GraphSearch::diffuseSearch(Graph& a_graph, const int* a_src,
+                                const int a_cnt, Array* a_nodes2src)
+{
+    std::vector<int> nid, prev, order, firstnode;
+    std::vector<float> cost;
+    lanes(a_graph, a_src, a_cnt, nid, cost, prev);
+    for (int l=0; l<a_cnt; l++)
+    {
+        //---------------------------------------------------------------------
+        // the first node after the source on the path to a node, by walking
+        // the predecessors up to a node already known
+        //---------------------------------------------------------------------
+        laneOrder(nid, cost, l, order);
+        firstnode.assign(nid.size(), -1);
+        std::vector<int> walk;
+        for (int i=0; i<(int)order.size(); i++)
+        {
+            int v = order[i];
+            while (firstnode[v] < 0)
+            {
+                const int p = prev[(long)v*MSLANES+l];
+                if (p == v || p == prev[(long)p*MSLANES+l])
+                {
+                    firstnode[v] = v;   // the source or next to it
+                    break;
+                }
+                walk.push_back(v);
+                v = p;
+            }
+            for (; !walk.empty(); walk.pop_back())
+                firstnode[walk.back()] = firstnode[v];
+        }
+
+        for (int i=0; i<(int)order.size(); i++)
+        {
+            const long v = (long)order[i]*MSLANES+l;
+            GraphSearchResult* res =
+                new GraphSearchResult(nid[order[i]], cost[v]);
+            res->m_path.clean();
+            res->m_path.append(nid[firstnode[order[i]]]);
+            a_nodes2src[l].append(res);
+        }
     }
 }
 
@@ -242,8 +407,18 @@ GraphSearchResult* GraphSearch::shortestPathSearch(Graph& graph,
                                                    const int a_src,
                                                    const int a_dest,
                                                    int& a_nodeaccess,
-                                                   int& a_edgeaccess)
+                                                   int& a_edgeaccess,
+                                                   const int a_algo,
+                                                   const Landmarks* a_landmarks)
 {
+    if (a_algo == SP_BIDIJKSTRA)
+        return biDijkstra(graph, a_src, a_dest, a_nodeaccess, a_edgeaccess);
+    if (a_algo == SP_ALT && a_landmarks != 0 && a_landmarks->size() > 0)
+        return alt(graph, *a_landmarks, a_src, a_dest,
+            a_nodeaccess, a_edgeaccess);
+    if (a_algo == SP_ASTAR || a_algo == SP_ALT)
+        return aStar(graph, a_src, a_dest, a_nodeaccess, a_edgeaccess);
+
     //-------------------------------------------------------------------------
     // initialization
     //-------------------------------------------------------------------------
@@ -255,62 +430,145 @@ GraphSearchResult* GraphSearch::shortestPathSearch(Graph& graph,
     // Dijkstra's shorest path search (best first)
     // ------------------------------------------------------------------------
     Set visited(1000);
-    BinHeap h(GraphSearchResult::compare);
-    h.insert(new GraphSearchResult(a_src,0));
+    SearchTrail trail;
+    PQueue<SearchEntry> h(1000);
+    h.insert(SearchEntry(a_src,0,-1));
     while (!h.isEmpty())
     {
-        GraphSearchResult* c = (GraphSearchResult*)h.removeTop();
+        SearchEntry c = h.removeTop();
         // --------------------------------------------------------------------
         // check if the node is visited. If so, skip it
         // --------------------------------------------------------------------
-        if (visited.in((void*)c->m_nid))
-        {
-            delete c;
+        if (visited.in((void*)c.m_nid))
             continue;
-        }
 
-        visited.insert((void*)c->m_nid);
+        visited.insert((void*)c.m_nid);
+        const int t = trail.add(c.m_nid, c.m_prev);
 
         // --------------------------------------------------------------------
         // check if destination is found
         // --------------------------------------------------------------------
-        if (c->m_nid == a_dest)
+        if (c.m_nid == a_dest)
         {
-            res = c;
+            res = new GraphSearchResult(c.m_nid, trail, c.m_prev, c.m_cost);
             break;
         }
 
         // --------------------------------------------------------------------
         // expand the current scope
         // --------------------------------------------------------------------
-        Node* node = graph.getNode(c->m_nid);
+        Node* node = graph.getNode(c.m_nid);
         for (int e=0; e<node->m_edges.size(); e++)
         {
-            Edge* edge = (Edge*)node->m_edges.get(e);
-            h.insert(
-                new GraphSearchResult(edge->m_neighbor, c->m_path,
-                c->m_cost + edge->m_cost));
+            Edge* edge = &node->m_edges[e];
+            h.insert(SearchEntry(edge->m_neighbor, c.m_cost + edge->m_cost, t));
             a_edgeaccess++;
         }
         a_nodeaccess++;
         delete node;
-
-        // --------------------------------------------------------------------
-        // clean up
-        // --------------------------------------------------------------------
-        delete c;
     }
 
     // ------------------------------------------------------------------------
-    // clean up
+    // all done
     // ------------------------------------------------------------------------
-    while (!h.isEmpty())
-        delete (GraphSearchResult*)h.removeTop();
+    return res;
+}
+
+// ----------------------------------------------------------------------------
+// shortest path search for a single destination
+// based on bidirectional Dijkstra's algorithm: a search from each end, the
+// one behind goes next. a path is found when a node settled on one side is
+// reached from the other, the search stops when the two queues together
+// cost no less than the best path found.
+// ----------------------------------------------------------------------------
+GraphSearchResult* GraphSearch::biDijkstra(Graph& a_graph,
+                                           const int a_src, const int a_dest,
+                                           int& a_nodeaccess,
+                                           int& a_edgeaccess)
+{
+    //-------------------------------------------------------------------------
+    // initialization: side 0 from the source, side 1 from the destination
+    //-------------------------------------------------------------------------
+    a_nodeaccess = 0;
+    a_edgeaccess = 0;
+
+    class settled
+    {
+    public:
+        float   m_cost;
+        int     m_t;        // trail index
+    public:
+        settled() {};
+        settled(const float a_cost, const int a_t): m_cost(a_cost), m_t(a_t) {};
+    };
+    FlatHash<int,settled> done[2];
+    SearchTrail trail[2];
+    PQueue<SearchEntry> h0(1000), h1(1000);
+    PQueue<SearchEntry>* h[2] = {&h0, &h1};
+    h0.insert(SearchEntry(a_src,0,-1));
+    h1.insert(SearchEntry(a_dest,0,-1));
+
+    float best = FLT_MAX;
+    int meet[2] = {-1, -1};     // trail indices of the ends of the best path
+    while (!h0.isEmpty() && !h1.isEmpty())
+    {
+        if (h0.top().m_cost + h1.top().m_cost >= best)
+            break;
+        const int s = h0.top().m_cost <= h1.top().m_cost ? 0 : 1;
+        SearchEntry c = h[s]->removeTop();
+        if (done[s].in(c.m_nid))
+            continue;
+        const int t = trail[s].add(c.m_nid, c.m_prev);
+        done[s].put(c.m_nid, settled(c.m_cost, t));
+        a_nodeaccess++;
+
+        const settled* o = done[1-s].find(c.m_nid);
+        if (o != 0 && c.m_cost + o->m_cost < best)
+        {
+            best = c.m_cost + o->m_cost;
+            meet[s] = t;
+            meet[1-s] = o->m_t;
+        }
+
+        // --------------------------------------------------------------------
+        // expand the current scope
+        // --------------------------------------------------------------------
+        std::shared_ptr<const Node> node = a_graph.getSharedNode(c.m_nid);
+        for (int e=0; e<node->m_edges.size(); e++)
+        {
+            const Edge* edge = &node->m_edges[e];
+            a_edgeaccess++;
+            if (done[s].in(edge->m_neighbor))
+                continue;
+            const float cost = c.m_cost + edge->m_cost;
+            const settled* o = done[1-s].find(edge->m_neighbor);
+            if (o != 0 && cost + o->m_cost < best)
+            {
+                best = cost + o->m_cost;
+                meet[s] = t;
+                meet[1-s] = o->m_t;
+            }
+            h[s]->insert(SearchEntry(edge->m_neighbor, cost, t));
+        }
+    }
+    if (meet[0] == -1)
+        return 0;
 
     // ------------------------------------------------------------------------
-    // all done
+    // the path: source .. meet[0] then meet[1] .. destination
     // ------------------------------------------------------------------------
-    return res;
+    NodePath path0, path1, path;
+    trail[0].path(meet[0], path0);
+    trail[1].path(meet[1], path1);
+    for (int i=path1.size()-1; i>=0; i--)
+    {
+        if (i == path1.size()-1 && path1.get(i) == path0.get(path0.size()-1))
+            continue;                               // met at a node
+        path0.append(path1.get(i));
+    }
+    for (int i=0; i<path0.size()-1; i++)            // the destination last
+        path.append(path0.get(i));
+    return new GraphSearchResult(a_dest, path, best);
 }
 
 // ----------------------------------------------------------------------------
@@ -334,63 +592,76 @@ GraphSearchResult* GraphSearch::aStar(Graph& a_graph,
     const float desty = dest->m_y;
     delete dest;
 
+    // ------------------------------------------------------------------------
+    // queued node ordered by its cost plus the distance to the destination
+    // ------------------------------------------------------------------------
+    class carrier
+    {
+    public:
+        int     m_nid;
+        int     m_prev;     // trail index
+        float   m_cost;
+        float   m_acost;
+    public:
+        carrier() {};
+        carrier(const int a_nid, const float a_cost, const float a_acost,
+                const int a_prev):
+            m_nid(a_nid), m_prev(a_prev), m_cost(a_cost), m_acost(a_acost) {};
+        bool operator<(const carrier& a_c) const
+        {
+            return m_acost < a_c.m_acost;
+        };
+    };
+
     // ------------------------------------------------------------------------
     // Disjkstra's shorest path search (best first)
     // ------------------------------------------------------------------------
     Set visited(1000);
-    BinHeap h(GraphSearchResult::acompare);
-    h.insert(new GraphSearchResult(a_src,0,0));
+    SearchTrail trail;
+    PQueue<carrier> h(1000);
+    h.insert(carrier(a_src,0,0,-1));
     while (!h.isEmpty())
     {
-        GraphSearchResult* c = (GraphSearchResult*)h.removeTop();
+        carrier c = h.removeTop();
         // --------------------------------------------------------------------
         // check if the node is visited. If so, skip it
         // --------------------------------------------------------------------
-        if (visited.in((void*)c->m_nid))
-        {
-            delete c;
+        if (visited.in((void*)c.m_nid))
             continue;
-        }
 
-        visited.insert((void*)c->m_nid);
+        visited.insert((void*)c.m_nid);
+        const int t = trail.add(c.m_nid, c.m_prev);
         // --------------------------------------------------------------------
         // check if destination is found
         // --------------------------------------------------------------------
-        if (a_dest == c->m_nid)
+        if (a_dest == c.m_nid)
         {
-            res = c;
+            res = new GraphSearchResult(c.m_nid, trail, c.m_prev,
+                c.m_cost, c.m_acost);
             break;
         }
 
         // --------------------------------------------------------------------
         // expand the current scope
         // --------------------------------------------------------------------
-        Node* node = a_graph.getNode(c->m_nid);
+        Node* node = a_graph.getNode(c.m_nid);
         for (int e=0; e<node->m_edges.size(); e++)
         {
-            Edge* edge = (Edge*)node->m_edges.get(e);
+            Edge* edge = &node->m_edges[e];
             Node* next = a_graph.getNode(edge->m_neighbor);
             float heu =
                 sqrt((next->m_x - destx)*(next->m_x - destx) +
                 (next->m_y - desty)*(next->m_y - desty));
-            h.insert(
-                new GraphSearchResult(edge->m_neighbor, c->m_path,
-                c->m_cost + edge->m_cost, c->m_cost + edge->m_cost + heu));
+            h.insert(carrier(edge->m_neighbor, c.m_cost + edge->m_cost,
+                c.m_cost + edge->m_cost + heu, t));
             delete next;
             a_edgeaccess++;
         }
         a_nodeaccess++;
 
         delete node;
-        delete c;
     }
 
-    // ------------------------------------------------------------------------
-    // clean up
-    // ------------------------------------------------------------------------
-    while (!h.isEmpty())
-        delete (GraphSearchResult*)h.removeTop();
-
     // ------------------------------------------------------------------------
     // all done
     // ------------------------------------------------------------------------
@@ -419,64 +690,161 @@ GraphSearchResult* GraphSearch::aStar(Graph& a_graph,
     const float desty = dest->m_y;
     delete dest;
 
+    // ------------------------------------------------------------------------
+    // queued node ordered by its cost plus the distance to the destination
+    // ------------------------------------------------------------------------
+    class carrier
+    {
+    public:
+        int     m_nid;
+        int     m_prev;     // trail index
+        float   m_cost;
+        float   m_acost;
+    public:
+        carrier() {};
+        carrier(const int a_nid, const float a_cost, const float a_acost,
+                const int a_prev):
+            m_nid(a_nid), m_prev(a_prev), m_cost(a_cost), m_acost(a_acost) {};
+        bool operator<(const carrier& a_c) const
+        {
+            return m_acost < a_c.m_acost;
+        };
+    };
+
     // ------------------------------------------------------------------------
     // Disjkstra's shorest path search (best first)
     // ------------------------------------------------------------------------
     Set visited(1000);
-    BinHeap h(GraphSearchResult::acompare);
-    h.insert(new GraphSearchResult(a_src,0,0));
+    SearchTrail trail;
+    PQueue<carrier> h(1000);
+    h.insert(carrier(a_src,0,0,-1));
     while (!h.isEmpty())
     {
-        GraphSearchResult* c = (GraphSearchResult*)h.removeTop();
+        carrier c = h.removeTop();
         // --------------------------------------------------------------------
         // check if the node is visited. If so, skip it
         // --------------------------------------------------------------------
-        if (visited.in((void*)c->m_nid))
-        {
-            delete c;
+        if (visited.in((void*)c.m_nid))
             continue;
-        }
 
-        visited.insert((void*)c->m_nid);
-        a_visited.append((void*)c->m_nid);
+        visited.insert((void*)c.m_nid);
+        const int t = trail.add(c.m_nid, c.m_prev);
+        a_visited.append((void*)c.m_nid);
 
         // --------------------------------------------------------------------
         // check if destination is found
         // --------------------------------------------------------------------
-        if (a_dest == c->m_nid)
+        if (a_dest == c.m_nid)
         {
-            res = c;
+            res = new GraphSearchResult(c.m_nid, trail, c.m_prev,
+                c.m_cost, c.m_acost);
             break;
         }
 
         // --------------------------------------------------------------------
         // expand the current scope
         // --------------------------------------------------------------------
-        Node* node = a_graph.getNode(c->m_nid);
+        Node* node = a_graph.getNode(c.m_nid);
         for (int e=0; e<node->m_edges.size(); e++)
         {
-            Edge* edge = (Edge*)node->m_edges.get(e);
+            Edge* edge = &node->m_edges[e];
             Node* next = a_graph.getNode(edge->m_neighbor);
             float heu =
                 sqrt((next->m_x - destx)*(next->m_x - destx) +
                 (next->m_y - desty)*(next->m_y - desty));
-            h.insert(
-                new GraphSearchResult(edge->m_neighbor, c->m_path,
-                c->m_cost + edge->m_cost, c->m_cost + edge->m_cost + heu));
+            h.insert(carrier(edge->m_neighbor, c.m_cost + edge->m_cost,
+                c.m_cost + edge->m_cost + heu, t));
             delete next;
             a_edgeaccess++;
         }
         a_nodeaccess++;
 
         delete node;
-        delete c;
     }
 
     // ------------------------------------------------------------------------
-    // clean up
+    // all done
     // ------------------------------------------------------------------------
+    return res;
+}
+
+// ----------------------------------------------------------------------------
+// shortest path search for a single destination
+// based on A* algorithm with the lower bounds of landmarks(ALT): unlike the
+// Euclidean distance no neighbor is read for its coordinates
+// ----------------------------------------------------------------------------
+GraphSearchResult* GraphSearch::alt(Graph& a_graph,
+                                    const Landmarks& a_landmarks,
+                                    const int a_src, const int a_dest,
+                                    int& a_nodeaccess,
+                                    int& a_edgeaccess)
+{
+    //-------------------------------------------------------------------------
+    // initialization
+    //-------------------------------------------------------------------------
+    GraphSearchResult* res = 0;
+    a_nodeaccess = 0;
+    a_edgeaccess = 0;
+
+    // ------------------------------------------------------------------------
+    // queued node ordered by its cost plus the bound to the destination
+    // ------------------------------------------------------------------------
+    class carrier
+    {
+    public:
+        int     m_nid;
+        int     m_prev;     // trail index
+        float   m_cost;
+        float   m_acost;
+    public:
+        carrier() {};
+        carrier(const int a_nid, const float a_cost, const float a_acost,
+                const int a_prev):
+            m_nid(a_nid), m_prev(a_prev), m_cost(a_cost), m_acost(a_acost) {};
+        bool operator<(const carrier& a_c) const
+        {
+            return m_acost < a_c.m_acost;
+        };
+    };
+
+    Set visited(1000);
+    SearchTrail trail;
+    PQueue<carrier> h(1000);
+    h.insert(carrier(a_src,0,a_landmarks.bound(a_src,a_dest),-1));
     while (!h.isEmpty())
-        delete (GraphSearchResult*)h.removeTop();
+    {
+        carrier c = h.removeTop();
+        if (visited.in((void*)c.m_nid))
+            continue;
+
+        visited.insert((void*)c.m_nid);
+        const int t = trail.add(c.m_nid, c.m_prev);
+        // --------------------------------------------------------------------
+        // check if destination is found
+        // --------------------------------------------------------------------
+        if (a_dest == c.m_nid)
+        {
+            res = new GraphSearchResult(c.m_nid, trail, c.m_prev,
+                c.m_cost, c.m_acost);
+            break;
+        }
+
+        // --------------------------------------------------------------------
+        // expand the current scope
+        // --------------------------------------------------------------------
+        std::shared_ptr<const Node> node = a_graph.getSharedNode(c.m_nid);
+        for (int e=0; e<node->m_edges.size(); e++)
+        {
+            const Edge* edge = &node->m_edges[e];
+            a_edgeaccess++;
+            if (visited.in((void*)edge->m_neighbor))
+                continue;
+            const float cost = c.m_cost + edge->m_cost;
+            h.insert(carrier(edge->m_neighbor, cost,
+                cost + a_landmarks.bound(edge->m_neighbor, a_dest), t));
+        }
+        a_nodeaccess++;
+    }
 
     // ------------------------------------------------------------------------
     // all done
@@ -484,6 +852,72 @@ GraphSearchResult* GraphSearch::aStar(Graph& a_graph,
     return res;
 }
 
+// ----------------------------------------------------------------------------
+// landmarks
+// ----------------------------------------------------------------------------
+// the costs of all nodes from a_src(-1 if not reached)
+static void costs(Graph& a_graph, const int a_src, std::vector<float>& a_cost)
+{
+    std::fill(a_cost.begin(), a_cost.end(), -1);
+    PQueue<SearchEntry> h(1000);
+    h.insert(SearchEntry(a_src,0,-1));
+    while (!h.isEmpty())
+    {
+        SearchEntry c = h.removeTop();
+        if (a_cost[c.m_nid] >= 0)
+            continue;
+        a_cost[c.m_nid] = c.m_cost;
+
+        std::shared_ptr<const Node> node = a_graph.getSharedNode(c.m_nid);
+        for (int e=0; e<node->m_edges.size(); e++)
+        {
+            const Edge* edge = &node->m_edges[e];
+            if (a_cost[edge->m_neighbor] < 0)
+                h.insert(SearchEntry(edge->m_neighbor, c.m_cost + edge->m_cost, -1));
+        }
+    }
+}
+
+// the node of the largest cost
+static int farthest(const std::vector<float>& a_cost)
+{
+    int ret = 0;
+    for (int n=1; n<(int)a_cost.size(); n++)
+        if (a_cost[n] > a_cost[ret]) ret = n;
+    return ret;
+}
+
+void Landmarks::build(Graph& a_graph, const int a_cnt)
+{
+    int nodes = 0;
+    for (HashReader rdr(a_graph.m_nodes); !rdr.isEnd(); rdr.next())
+        nodes = std::max(nodes, rdr.getKey() + 1);
+    m_cnt = nodes > 0 ? a_cnt : 0;
+    m_node.clear();
+    m_cost.assign(nodes*m_cnt, -1);
+    if (m_cnt == 0) return;
+
+    // ------------------------------------------------------------------------
+    // the first is the farthest from any node, the next the farthest from
+    // the nearest landmark
+    // ------------------------------------------------------------------------
+    std::vector<float> cost(nodes), least(nodes, -1);
+    costs(a_graph, HashReader(a_graph.m_nodes).getKey(), cost);
+    int next = farthest(cost);
+    for (int l=0; l<m_cnt; l++)
+    {
+        m_node.push_back(next);
+        costs(a_graph, next, cost);
+        for (int n=0; n<nodes; n++)
+        {
+            m_cost[n*m_cnt + l] = cost[n];
+            if (cost[n] >= 0 && (least[n] < 0 || cost[n] < least[n]))
+                least[n] = cost[n];
+        }
+        next = farthest(least);
+    }
+}
+
 // ----------------------------------------------------------------------------
 // shortest path search for multiple destinations
 // based on Dijsktra's algorithm
@@ -505,61 +939,48 @@ void GraphSearch::shortestPathSearch(Graph& graph,
     // Disjkstra's shorest path search (best first)
     // ------------------------------------------------------------------------
     Set visited(1000);
-    BinHeap h(GraphSearchResult::compare);
-    h.insert(new GraphSearchResult(a_src,0));
+    SearchTrail trail;
+    PQueue<SearchEntry> h(1000);
+    h.insert(SearchEntry(a_src,0,-1));
     while (!h.isEmpty())
     {
-        GraphSearchResult* c = (GraphSearchResult*)h.removeTop();
+        SearchEntry c = h.removeTop();
         // --------------------------------------------------------------------
         // check if the node is visited. If so, skip it
         // --------------------------------------------------------------------
-        if (visited.in((void*)c->m_nid))
-        {
-            delete c;
+        if (visited.in((void*)c.m_nid))
             continue;
-        }
 
-        visited.insert((void*)c->m_nid);
+        visited.insert((void*)c.m_nid);
+        const int t = trail.add(c.m_nid, c.m_prev);
         // --------------------------------------------------------------------
         // check if destination is found
         // --------------------------------------------------------------------
-        if (a_dest.in((void*)c->m_nid))
+        if (a_dest.in((void*)c.m_nid))
         {
-            if (a_result.get(c->m_nid) == 0)
+            if (a_result.get(c.m_nid) == 0)
                 a_result.put(
-                    c->m_nid,
-                    new GraphSearchResult(c->m_nid, c->m_path, c->m_cost));
+                    c.m_nid,
+                    new GraphSearchResult(c.m_nid, trail, t, c.m_cost));
             if (a_result.size() == a_dest.size())
-            {
-                delete c;
                 break;
-            }
         }
 
         // --------------------------------------------------------------------
         // expand the current scope
         // --------------------------------------------------------------------
-        Node* node = graph.getNode(c->m_nid);
+        Node* node = graph.getNode(c.m_nid);
         for (int e=0; e<node->m_edges.size(); e++)
         {
-            Edge* edge = (Edge*)node->m_edges.get(e);
-            h.insert(
-                new GraphSearchResult(edge->m_neighbor, c->m_path,
-                c->m_cost + edge->m_cost));
+            Edge* edge = &node->m_edges[e];
+            h.insert(SearchEntry(edge->m_neighbor, c.m_cost + edge->m_cost, t));
             a_edgeaccess++;
         }
         a_nodeaccess++;
 
         delete node;
-        delete c;
     }
 
-    // ------------------------------------------------------------------------
-    // clean up
-    // ------------------------------------------------------------------------
-    while (!h.isEmpty())
-        delete (GraphSearchResult*)h.removeTop();
-
     // ------------------------------------------------------------------------
     // all done
     // ------------------------------------------------------------------------
@@ -586,59 +1007,46 @@ void GraphSearch::shortestPathSearch(Hash& a_nodes,
     // Disjkstra's shorest path search (best first)
     // ------------------------------------------------------------------------
     Set visited(10000);
-    BinHeap h(GraphSearchResult::compare);
-    h.insert(new GraphSearchResult(a_src,0));
+    SearchTrail trail;
+    PQueue<SearchEntry> h(1000);
+    h.insert(SearchEntry(a_src,0,-1));
     while (!h.isEmpty())
     {
-        GraphSearchResult* c = (GraphSearchResult*)h.removeTop();
+        SearchEntry c = h.removeTop();
         // --------------------------------------------------------------------
         // check if the node is visited. If so, skip it
         // --------------------------------------------------------------------
-        if (visited.in((void*)c->m_nid))
-        {
-            delete c;
+        if (visited.in((void*)c.m_nid))
             continue;
-        }
 
-        visited.insert((void*)c->m_nid);
+        visited.insert((void*)c.m_nid);
+        const int t = trail.add(c.m_nid, c.m_prev);
         // --------------------------------------------------------------------
         // check if destination is found
         // --------------------------------------------------------------------
-        if (a_dest.in((void*)c->m_nid))
+        if (a_dest.in((void*)c.m_nid))
         {
-            if (a_result.get(c->m_nid) == 0)
+            if (a_result.get(c.m_nid) == 0)
                 a_result.put(
-                    c->m_nid,
-                    new GraphSearchResult(c->m_nid, c->m_path, c->m_cost));
+                    c.m_nid,
+                    new GraphSearchResult(c.m_nid, trail, t, c.m_cost));
             if (a_result.size() == a_dest.size())
-            {
-                delete c;
                 break;
-            }
         }
 
         // --------------------------------------------------------------------
         // expand the current scope
         // --------------------------------------------------------------------
-        Node* node = (Node*)a_nodes.get(c->m_nid);
+        Node* node = (Node*)a_nodes.get(c.m_nid);
         for (int e=0; e<node->m_edges.size(); e++)
         {
-            Edge* edge = (Edge*)node->m_edges.get(e);
-            h.insert(
-                new GraphSearchResult(edge->m_neighbor, c->m_path,
-                c->m_cost + edge->m_cost));
+            Edge* edge = &node->m_edges[e];
+            h.insert(SearchEntry(edge->m_neighbor, c.m_cost + edge->m_cost, t));
             a_edgeaccess++;
         }
         a_nodeaccess++;
-        delete c;
     }
 
-    // ------------------------------------------------------------------------
-    // clean up
-    // ------------------------------------------------------------------------
-    while (!h.isEmpty())
-        delete (GraphSearchResult*)h.removeTop();
-
     // ------------------------------------------------------------------------
     // all done
     // ------------------------------------------------------------------------
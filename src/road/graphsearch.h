@@ -11,35 +11,51 @@
 #define graphsearch_defined
 
 #include "collection.h"
+#include "searchtrail.h"
+#include <vector>
 class Graph;
 
+// point-to-point shortest path algorithms(GraphSearch::shortestPathSearch)
+#define SP_DIJKSTRA     0
+#define SP_BIDIJKSTRA   1       // from both ends, meeting in the middle
+#define SP_ASTAR        2       // Euclidean distance(m_x, m_y) to the target
+#define SP_ALT          3       // A* on landmark lower bounds(Landmarks)
+
+// sources searched together by the batch spanSearch/diffuseSearch
+#define MSLANES         64
+
 class GraphSearchResult
 {
 public:
     const int   m_nid;
     const float m_cost;
     const float m_acost;    // used in A* algorithm
-    Array       m_path;      
+    NodePath    m_path;      
 public:
     GraphSearchResult(
         const int a_nid, const float a_cost):
         m_nid(a_nid), m_path(), m_cost(a_cost), m_acost(0)
-        { m_path.append((void*)m_nid); };
+        { m_path.append(m_nid); };
     GraphSearchResult(
         const int a_nid,
-        const Array& a_path, const float a_cost):
+        const NodePath& a_path, const float a_cost):
         m_nid(a_nid), m_path(a_path), m_cost(a_cost), m_acost(0)
-        { m_path.append((void*)m_nid); };
+        { m_path.append(m_nid); };
     GraphSearchResult(
         const int a_nid,
         const float a_cost, const float a_acost):
         m_nid(a_nid), m_path(), m_cost(a_cost), m_acost(a_acost)
-        { m_path.append((void*)m_nid); };
+        { m_path.append(m_nid); };
     GraphSearchResult(
-        const int a_nid, const Array& a_path,
+        const int a_nid, const NodePath& a_path,
         const float a_cost, const float a_acost):
         m_nid(a_nid), m_path(a_path), m_cost(a_cost), m_acost(a_acost)
-        { m_path.append((void*)m_nid); };
+        { m_path.append(m_nid); };
+    GraphSearchResult(
+        const int a_nid, const SearchTrail& a_trail, const int a_prev,
+        const float a_cost, const float a_acost=0):
+        m_nid(a_nid), m_cost(a_cost), m_acost(a_acost)
+        { a_trail.path(a_prev, m_path); m_path.append(m_nid); };
     ~GraphSearchResult() {};
     static int compare(const void* a0, const void* a1)
     {
@@ -59,6 +75,46 @@ public:
     };
 };
 
+// ----------------------------------------------------------------------------
+// landmarks for ALT: the costs of all nodes from a few nodes far apart, so
+// the cost between two nodes is at least the largest difference of their
+// costs from a landmark(the edges go both ways)
+// ----------------------------------------------------------------------------
+class Landmarks
+{
+protected:
+    int                 m_cnt;      // #landmarks
+    std::vector<int>    m_node;     // the landmarks
+    std::vector<float>  m_cost;     // of node n from landmark l at
+                                    // n*m_cnt + l, -1 if not reached
+public:
+    Landmarks(): m_cnt(0) {};
+    //
+    // the landmarks by farthest selection: each is the node farthest from
+    // those before
+    void build(Graph& a_graph, const int a_cnt);
+    int size() const                        { return m_cnt; };
+    int landmark(const int a_l) const       { return m_node[a_l]; };
+    //
+    // a lower bound of the cost between two nodes
+    float bound(const int a_n0, const int a_n1) const
+    {
+        if (a_n0 < 0 || a_n1 < 0 || (a_n0+1)*m_cnt > (int)m_cost.size() ||
+            (a_n1+1)*m_cnt > (int)m_cost.size())
+            return 0;
+        const float* c0 = &m_cost[a_n0*m_cnt];
+        const float* c1 = &m_cost[a_n1*m_cnt];
+        float ret = 0;
+        for (int l=0; l<m_cnt; l++)
+        {
+            if (c0[l] < 0 || c1[l] < 0) continue;
+            const float d = c0[l] > c1[l] ? c0[l] - c1[l] : c1[l] - c0[l];
+            ret = ret > d ? ret : d;
+        }
+        return ret;
+    };
+};
+
 class GraphSearch
 {
 public:
@@ -83,12 +139,42 @@ public:
         Graph& a_graph, const int a_src,
         Array& a_nodes2src);
 
+    // ------------------------------------------------------------------------
+    // spanSearch/diffuseSearch of up to MSLANES nodes in one pass over the
+    // node records, every node keeping a lane of costs per source. the
+    // tree of the i-th node goes to the i-th array, in the order of the
+    // single source search
+    // ------------------------------------------------------------------------
+    static void spanSearch(
+        Graph& a_graph, const int* a_dest, const int a_cnt,
+        Array* a_nodes2dest);
+    static void diffuseSearch(
+        Graph& a_graph, const int* a_src, const int a_cnt,
+        Array* a_nodes2src);
+
 
     // ------------------------------------------------------------------------
-    // shortest path search for a single destination
+    // shortest path search for a single destination by a_algo(SP_DIJKSTRA,
+    // SP_BIDIJKSTRA, SP_ASTAR or SP_ALT on a_landmarks: SP_ASTAR if none)
     // ------------------------------------------------------------------------
     static GraphSearchResult* shortestPathSearch(
         Graph& a_graph, const int a_src, const int a_dest,
+        int& a_nodeaccess, int& a_edgeaccess,
+        const int a_algo=SP_DIJKSTRA, const Landmarks* a_landmarks=0);
+
+    // ------------------------------------------------------------------------
+    // bidirectional Dijkstra for a single destination
+    // ------------------------------------------------------------------------
+    static GraphSearchResult* biDijkstra(
+        Graph& a_graph, const int a_src, const int a_dest,
+        int& a_nodeaccess, int& a_edgeaccess);
+
+    // ------------------------------------------------------------------------
+    // A* on landmark lower bounds(ALT) for a single destination
+    // ------------------------------------------------------------------------
+    static GraphSearchResult* alt(
+        Graph& a_graph, const Landmarks& a_landmarks,
+        const int a_src, const int a_dest,
         int& a_nodeaccess, int& a_edgeaccess);
 
     // ------------------------------------------------------------------------
@@ -18,12 +18,16 @@
     -s: number of sources
     -k: k (# of NNs)
     -v: turn verbose mode on (default: off)
+    -t: threads for the query points of a group (default: 1)
+    -a: aggregate cost, max or sum (default: max)
+    -m: map index files read-only, advised random, sequential, normal,
+        willneed or preload (default: off, buffered reads)
 ---------------------------------------------------------------------------- */
 
 #include "hiergraph.h"
 #include "bordernode.h"
 #include "shortcuttreenode.h"
-#include "segfmem.h"
+#include "segmapmem.h"
 #include "param.h"
 #include "collection.h"
 #include "nodemap.h"
@@ -38,6 +42,8 @@
 #include <stdlib.h>
 #include <math.h>
 #include <iostream>
+#include <vector>
+#include <memory>
 #include <fstream>
 
 using namespace std;
@@ -56,6 +62,9 @@ void helpmsg(const char* pgm)
     cerr << "-s: #sources" << endl;
     cerr << "-k: #NNs " << endl;
     cerr << "-v: turn verbose mode on (default: off)" << endl;
+    cerr << "-t: threads for the query points of a group (default: 1)" << endl;
+    cerr << "-a: aggregate cost, max or sum (default: max)" << endl;
+    cerr << "-m: map index files: random, sequential, normal, willneed or preload (default: off)" << endl;
 }
 
 int main(const int a_argc, const char** a_argv)
@@ -76,13 +85,19 @@ int main(const int a_argc, const char** a_argv)
     const char* cnumsource = Param::read(a_argc, a_argv, "-s", "");
     const char* ck = Param::read(a_argc, a_argv, "-k", "");
     const char* vrbs = Param::read(a_argc, a_argv, "-v", "null");
+    const char* cmap = Param::read(a_argc, a_argv, "-m", "");
     bool verbose = strcmp(vrbs,"null") != 0;
+    int threads = atoi(Param::read(a_argc, a_argv, "-t", "1"));
+    if (threads < 1) threads = 1;
+    const int agg = strcmp(Param::read(a_argc, a_argv, "-a", "max"), "sum") == 0 ?
+        GROUP_SUM : GROUP_MAX;
 
     //-------------------------------------------------------------------------
     // access graph index file
     //-------------------------------------------------------------------------
     cerr << "loading a graph index ... ";
-    SegFMemory segmem(hidxflname, PAGESIZE*10, PAGESIZE, 32, false);
+    std::unique_ptr<SegMemory> segmemp(SegMapMemory::open(hidxflname, cmap, PAGESIZE*10, PAGESIZE, 32));
+    SegMemory& segmem = *segmemp;
     HierGraph hiergraph(segmem);
     int hiergraphsize = segmem.size();
     cerr << "[DONE]" << endl;
@@ -122,6 +137,7 @@ int main(const int a_argc, const char** a_argv)
             objsize += sizeof(int)*2;
         }
     }
+    nmap.build();
     ftime(&endtime);  // time the the object index creation
     idxtime =
         ((endtime.time*1000 + endtime.millitm) -
@@ -164,7 +180,7 @@ int main(const int a_argc, const char** a_argv)
         //----------------------------------------------------------------------
         // find query point
         //----------------------------------------------------------------------
-        int src[MAXQUERY];
+        std::vector<int> src(numsrc);
         for (int j=0; j<numsrc; j++)
             while ((src[j] = (int)((rand()%1000 / 1000.0f)*nodecnt)) > nodecnt);
 
@@ -174,8 +190,8 @@ int main(const int a_argc, const char** a_argv)
         ftime(&starttime);  // time the algorithm
         HierObjectSearch::groupKNNSearch(
             hiergraph, nmap, gmap,
-            src, numsrc, k, 
-            result, nodeaccess, edgeaccess);
+            src.data(), numsrc, k, 
+            result, nodeaccess, edgeaccess, agg, threads);
         ftime(&endtime);
         float qtime = 
             ((endtime.time*1000 + endtime.millitm) -
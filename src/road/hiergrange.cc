@@ -18,12 +18,14 @@
     -s: number of sources
     -r: range
     -v: turn verbose mode on (default: off)
+    -m: map index files read-only, advised random, sequential, normal,
+        willneed or preload (default: off, buffered reads)
 ---------------------------------------------------------------------------- */
 
 #include "hiergraph.h"
 #include "bordernode.h"
 #include "shortcuttreenode.h"
-#include "segfmem.h"
+#include "segmapmem.h"
 #include "param.h"
 #include "collection.h"
 #include "nodemap.h"
@@ -38,6 +40,8 @@
 #include <stdlib.h>
 #include <math.h>
 #include <iostream>
+#include <vector>
+#include <memory>
 #include <fstream>
 
 using namespace std;
@@ -56,6 +60,7 @@ void helpmsg(const char* pgm)
     cerr << "-s: #sources" << endl;
     cerr << "-r: range " << endl;
     cerr << "-v: turn verbose mode on (default: off)" << endl;
+    cerr << "-m: map index files: random, sequential, normal, willneed or preload (default: off)" << endl;
 }
 
 int main(const int a_argc, const char** a_argv)
@@ -76,13 +81,15 @@ int main(const int a_argc, const char** a_argv)
     const char* cnumsource = Param::read(a_argc, a_argv, "-s", "");
     const char* crange = Param::read(a_argc, a_argv, "-r", "");
     const char* vrbs = Param::read(a_argc, a_argv, "-v", "null");
+    const char* cmap = Param::read(a_argc, a_argv, "-m", "");
     bool verbose = strcmp(vrbs,"null") != 0;
 
     //-------------------------------------------------------------------------
     // access graph index file
     //-------------------------------------------------------------------------
     cerr << "loading a graph index ... ";
-    SegFMemory segmem(hidxflname, PAGESIZE*10, PAGESIZE, 32, false);
+    std::unique_ptr<SegMemory> segmemp(SegMapMemory::open(hidxflname, cmap, PAGESIZE*10, PAGESIZE, 32));
+    SegMemory& segmem = *segmemp;
     HierGraph hiergraph(segmem);
     int hiergraphsize = segmem.size();
     cerr << "[DONE]" << endl;
@@ -122,6 +129,7 @@ int main(const int a_argc, const char** a_argv)
             objsize += sizeof(int)*2;
         }
     }
+    nmap.build();
     ftime(&endtime);  // time the the object index creation
     idxtime =
         ((endtime.time*1000 + endtime.millitm) -
@@ -165,8 +173,8 @@ int main(const int a_argc, const char** a_argv)
         //----------------------------------------------------------------------
         // find query point
         //----------------------------------------------------------------------
-        int src[MAXQUERY];
-        float rng[MAXQUERY];
+        std::vector<int> src(numsrc);
+        std::vector<float> rng(numsrc);
         for (int j=0; j<numsrc; j++)
         {
             while ((src[j] = (int)((rand()%1000 / 1000.0f)*nodecnt)) > nodecnt);
@@ -179,7 +187,7 @@ int main(const int a_argc, const char** a_argv)
         ftime(&starttime);  // time the algorithm
         HierObjectSearch::groupRangeSearch(
             hiergraph, nmap, gmap,
-            src, rng,
+            src.data(), rng.data(),
             numsrc,
             result,nodeaccess,edgeaccess);
         ftime(&endtime);
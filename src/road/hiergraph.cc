@@ -8,9 +8,12 @@
 #include "hiergraph.h"
 #include "bordernode.h"
 #include "segmem.h"
+#include "nodecache.h"
+#include <string.h>
 
-HierGraph::HierGraph(SegMemory& a_nodeMem):
-Graph(a_nodeMem)
+HierGraph::HierGraph(SegMemory& a_nodeMem, const bool a_compact):
+Graph(a_nodeMem),
+m_compact(a_compact)
 {};
 
 HierGraph::~HierGraph()
@@ -22,30 +25,97 @@ int HierGraph::writeNode(const int a_nid, const BorderNode& a_bnode)
     // write a node into memory
     // ------------------------------------------------------------------------
     //char mem[4096];
-    int sz = a_bnode.size();
+    int sz = m_compact ? ShortcutCSR::size(a_bnode) : a_bnode.size();
     char* mem = new char[sz*2];
     int len=0;
-    a_bnode.toMem(mem,len);  // content marshalling
+    if (m_compact)
+        ShortcutCSR::toMem(a_bnode,mem,len);
+    else
+        a_bnode.toMem(mem,len);  // content marshalling
     int pos = m_nodeMem.allocate(mem,len);
     m_nodes.put(a_nid, (void*)pos);
     delete[] mem;
     return 0;
 }
 
+void HierGraph::setCompact(const bool a_compact)
+{
+    m_compact = a_compact;
+}
+
 Node* HierGraph::getNode(const int a_nid)
 {
     return getBorderNode(a_nid);
 }
 
-BorderNode* HierGraph::getBorderNode(const int a_nid)
+BorderNode* HierGraph::readBorderNode(const int a_nid, int& a_len)
 {
     // ------------------------------------------------------------------------
     // retrieve a node from memory
     // ------------------------------------------------------------------------
     int pos = (long)m_nodes.get(a_nid);
     char* mem = (char*)m_nodeMem.read(pos);
-    int len=0;
+    a_len=0;
     BorderNode* n = new BorderNode(a_nid);
-    n->fromMem(mem,len);    // content unmarshalling
+    n->fromMem(mem,a_len);    // content unmarshalling
     return n;
 }
+
+BorderNode* HierGraph::getBorderNode(const int a_nid)
+{
+    int len;
+    return readBorderNode(a_nid, len);
+}
+
+std::shared_ptr<const Node> HierGraph::getSharedNode(const int a_nid)
+{
+    return getSharedBorderNode(a_nid);
+}
+
+std::shared_ptr<const BorderNode> HierGraph::getSharedBorderNode(const int a_nid)
+{
+    int len = 0;
+    if (m_cache == 0)
+        return std::shared_ptr<const BorderNode>(readBorderNode(a_nid, len));
+    ShortcutCSR sc = getShortcuts(a_nid);
+    BorderNode* n = new BorderNode(a_nid);
+    n->fromMem((char*)sc.record(), len);
+    return std::shared_ptr<const BorderNode>(n);
+}
+
+ShortcutCSR HierGraph::getShortcuts(const int a_nid)
+{
+    if (m_cache != 0)
+    {
+        NodeCache::Handle h = m_cache->find(a_nid);
+        if (h) return ShortcutCSR((const char*)h.get(), h);
+    }
+    int pos = (long)m_nodes.get(a_nid);
+    char* mem = (char*)m_nodeMem.read(pos);
+    if (ShortcutCSR::isCompact(mem) && m_cache == 0)
+        return ShortcutCSR(mem);
+
+    // ------------------------------------------------------------------------
+    // a copy of the record, converted if in the tree layout
+    // ------------------------------------------------------------------------
+    std::shared_ptr<char> rec;
+    int len = 0;
+    if (ShortcutCSR::isCompact(mem))
+    {
+        len = ShortcutCSR(mem).length();
+        rec.reset(new char[len], std::default_delete<char[]>());
+        memcpy(rec.get(), mem, len);
+    }
+    else
+    {
+        BorderNode n(a_nid);
+        n.fromMem(mem, len);
+        rec.reset(new char[ShortcutCSR::size(n)], std::default_delete<char[]>());
+        len = 0;
+        ShortcutCSR::toMem(n, rec.get(), len);
+    }
+    NodeCache::Handle h = rec;
+    if (m_cache != 0)
+        h = m_cache->insert(a_nid, h, len);
+    return ShortcutCSR((const char*)h.get(), h);
+}
@@ -8,6 +8,8 @@
 
     This file contains a class HierGraph declaration.
     This provide accesses to graph border nodes.
+    Nodes are written in the tree layout(BorderNode::toMem) or, if set, the
+    compact layout(ShortcutCSR) that searches walk in place.
 ---------------------------------------------------------------------------- */
 #ifndef hiergraph_defined
 #define hiergraph_defined
@@ -15,20 +17,35 @@
 class BorderNode;
 #include "collection.h"
 #include "graph.h"
+#include "shortcutcsr.h"
 
 class HierGraph: public Graph
 {
+protected:
+    bool    m_compact;      // write the compact layout
+
+    virtual BorderNode* readBorderNode(const int a_nid, int& a_len);
 public:
     // constructor/destructor
-    HierGraph(SegMemory& a_nodeMem);
+    HierGraph(SegMemory& a_nodeMem, const bool a_compact=false);
     virtual ~HierGraph();
     //
     // update
     virtual int writeNode(const int a_nid, const BorderNode& a_bnode);
+    void setCompact(const bool a_compact);
     //
     // search
     virtual Node* getNode(const int a_nid);     // overload getNode in Graph
     virtual BorderNode* getBorderNode(const int a_nid);
+    virtual std::shared_ptr<const Node> getSharedNode(const int a_nid);
+    virtual std::shared_ptr<const BorderNode> getSharedBorderNode(const int a_nid);
+    //
+    // shortcuts of a node in the compact layout: in place in the memory(a
+    // mapped file, or the read buffer of the calling thread until its next
+    // read) if so stored; otherwise, or with a cache, the view holds a copy
+    // of the record. the cache keeps records: a BorderNode shared from it is
+    // decoded again per call
+    ShortcutCSR getShortcuts(const int a_nid);
 };
 
 #endif
@@ -19,6 +19,10 @@
     -t: division factor
     -l: the number of hierarchical levels
     -h: hiergraph index file (output)
+    -f: node layout: csr(compact, see ShortcutCSR) or tree (default: csr)
+    -j: threads for the shortcuts (default: 1)
+    -p: partitioner: geo(coordinate bisection) or metis(if built with
+        METIS, see Makefile) (default: geo)
     -v: turn verbose mode on (default: off)
 ---------------------------------------------------------------------------- */
 #include "hiergraph.h"
@@ -55,6 +59,9 @@ void helpmsg(const char* pgm)
     cerr << "-t: division factor" << endl;
     cerr << "-l: level (number of hierarchical levels)" << endl;
     cerr << "-h: hiergraph index file (output)" << endl;
+    cerr << "-f: node layout: csr or tree (default: csr)" << endl;
+    cerr << "-j: threads for the shortcuts (default: 1)" << endl;
+    cerr << "-p: partitioner: geo or metis (default: geo)" << endl;
     cerr << "-v: turn verbose mode on (default: off)" << endl;
 }
 
@@ -75,8 +82,28 @@ int main(const int a_argc, const char** a_argv)
     const char* div = Param::read(a_argc, a_argv, "-t", "");
     const char* level = Param::read(a_argc, a_argv, "-l", "");
     const char* idxflname = Param::read(a_argc, a_argv, "-h", "");
+    const char* layout = Param::read(a_argc, a_argv, "-f", "csr");
+    int threads = atoi(Param::read(a_argc, a_argv, "-j", "1"));
+    const char* parter = Param::read(a_argc, a_argv, "-p", "geo");
     const char* vrbs = Param::read(a_argc, a_argv, "-v", "null");
     bool verbose = strcmp(vrbs,"null") != 0;
+    bool compact = strcmp(layout,"tree") != 0;
+    if (compact && atol(level) >= ShortcutCSR::MAXDEPTH)
+    {
+        cerr << "too many levels for the csr layout(at most ";
+        cerr << ShortcutCSR::MAXDEPTH-1 << ")" << endl;
+        return -1;
+    }
+    GraphPartition::Partitioner* partitioner = 0;
+    if (strcmp(parter,"metis") == 0)
+    {
+#ifdef USE_METIS
+        partitioner = new GraphPartition::MetisPartitioner;
+#else
+        cerr << "not built with METIS" << endl;
+        return -1;
+#endif
+    }
     fstream fnode, fedge;
 
     Hash nodes(MAXNODES);
@@ -133,7 +160,9 @@ int main(const int a_argc, const char** a_argv)
     // access graph index file
     //-------------------------------------------------------------------------
     SegFMemory hiergraphmem(idxflname, PAGESIZE*10, PAGESIZE, 24, true);
-    HierGraph hiergraph(hiergraphmem);
+    hiergraphmem.setAppend(true);       // written once, nothing freed
+    hiergraphmem.setAlign(PAGESIZE);    // a record in as few pages as it can
+    HierGraph hiergraph(hiergraphmem, compact);
 
     //-------------------------------------------------------------------------
     // partition the graph and result in hierarchical graph
@@ -145,7 +174,8 @@ int main(const int a_argc, const char** a_argv)
     float totalbuildtime, parttime, shorttime;
     ftime(&starttime);  // time the algorithm
     // graph partitioning
-    GraphPartition::geoPartition(nodes, atol(div), atol(level), hiergraph, parttime, shorttime);
+    GraphPartition::geoPartition(nodes, atol(div), atol(level), hiergraph, parttime, shorttime,
+        threads, partitioner);
 
     ftime(&endtime);
     totalbuildtime = 
@@ -158,6 +188,7 @@ int main(const int a_argc, const char** a_argv)
     // ------------------------------------------------------------------------
     for (HashReader rdr(nodes); !rdr.isEnd(); rdr.next())
         delete (Node*)rdr.getVal();
+    delete partitioner;
 
     cout << "partitiontime:," << parttime;
     cout << ",shortcuttime:," << shorttime;
@@ -17,6 +17,18 @@
     -q: number of query
     -k: k (# of NNs)
     -v: turn verbose mode on (default: off)
+    -m: map index files read-only, advised random, sequential, normal,
+        willneed or preload (default: off, buffered reads)
+    -b: read through a page pool of this many pages (default: off), the
+        real page hits, misses and bytes read are printed per case
+    -B: page size of the pool (default: 4096)
+    -e: pool eviction, lru or clock (default: clock)
+    -a: pages read ahead on a pool miss (default: 0)
+    -D: open the index with O_DIRECT for the pool (default: off)
+    -A: async reads of the pool, this many in flight (default: off): the
+        records of the nodes a search queues are read ahead through io_uring
+    -t: worker threads for the queries of a case (default: 1), the lines
+        are printed in query order
 
 	MY TEST:(ONLY THESE TWO PARAMS)
 	-h: hiergraph index file
@@ -26,7 +38,9 @@
 #include "hiergraph.h"
 #include "bordernode.h"
 #include "shortcuttreenode.h"
+#include "segmapmem.h"
 #include "segfmem.h"
+#include "pagepool.h"
 #include "param.h"
 #include "collection.h"
 #include "nodemap.h"
@@ -42,8 +56,10 @@
 #include <stdlib.h>
 #include <math.h>
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <fstream>
+#include "../common/task_pool.h"
 
 using namespace std;
 
@@ -54,6 +70,14 @@ long ts, te;
 #define TIME_TICK_DIFF te - ts;
 #define TIME_TICK_PRINT(T) printf("%s RESULT: %ld (0.01MS)\r\n", (#T), te - ts );
 
+// the stopwatch of a worker
+long time_tick()
+{
+    struct timeval t;
+    gettimeofday( &t, NULL );
+    return t.tv_sec * 100000 + t.tv_usec / 10;
+}
+
 #define PAGESIZE 409600000
 //#define FILE_QUERY "wa.query.dat"
 
@@ -68,6 +92,14 @@ void helpmsg(const char* pgm)
     cerr << "-q: #queries" << endl;
     cerr << "-k: #NNs " << endl;
     cerr << "-v: turn verbose mode on (default: off)" << endl;
+    cerr << "-m: map index files: random, sequential, normal, willneed or preload (default: off)" << endl;
+    cerr << "-b: page pool size in pages (default: off)" << endl;
+    cerr << "-B: page size of the pool (default: 4096)" << endl;
+    cerr << "-e: pool eviction: lru or clock (default: clock)" << endl;
+    cerr << "-a: pages read ahead on a pool miss (default: 0)" << endl;
+    cerr << "-D: O_DIRECT reads for the pool (default: off)" << endl;
+    cerr << "-A: async pool reads in flight (default: off)" << endl;
+    cerr << "-t: worker threads (default: 1)" << endl;
 }
 
 void test(){
@@ -91,6 +123,15 @@ int main(const int a_argc, const char** a_argv)
     const char* cnumquery  = Param::read(a_argc, a_argv, "-q", "");
     const char* ck = Param::read(a_argc, a_argv, "-k", "");
     const char* vrbs = Param::read(a_argc, a_argv, "-v", "null");
+    const char* cmap = Param::read(a_argc, a_argv, "-m", "");
+    const int frames = atoi(Param::read(a_argc, a_argv, "-b", "0"));
+    const int pagesize = atoi(Param::read(a_argc, a_argv, "-B", "4096"));
+    const int policy = PagePool::policy(Param::read(a_argc, a_argv, "-e", "clock"));
+    const int readahead = atoi(Param::read(a_argc, a_argv, "-a", "0"));
+    const bool direct = strcmp(Param::read(a_argc, a_argv, "-D", "null"), "null") != 0;
+    const int depth = atoi(Param::read(a_argc, a_argv, "-A", "0"));
+    int threads = atoi(Param::read(a_argc, a_argv, "-t", "1"));
+    if (threads < 1) threads = 1;
     const char* FILE_OBJECT = Param::read(a_argc, a_argv, "-x", "");
 	bool verbose = strcmp(vrbs,"null") != 0;
 
@@ -100,7 +141,23 @@ int main(const int a_argc, const char** a_argv)
     //-------------------------------------------------------------------------
     cerr << "loading a graph index ... ";
     // SegFMemory segmem(hidxflname, PAGESIZE*10, PAGESIZE, 32, false);
-	SegFMemory segmem(hidxflname, PAGESIZE, PAGESIZE, 32, false);
+    std::unique_ptr<PagePool> pool;
+	std::unique_ptr<SegMemory> segmemp(SegMapMemory::open(hidxflname, cmap, PAGESIZE, PAGESIZE, 32));
+	SegMemory& segmem = *segmemp;
+    if (frames > 0)
+    {
+        SegFMemory* segfmem = dynamic_cast<SegFMemory*>(&segmem);
+        if (segfmem == 0)
+            cerr << "(no page pool with -m) ";
+        else
+        {
+            pool.reset(new PagePool(hidxflname, pagesize, frames,
+                policy == -1 ? PagePool::CLOCK : policy, direct, readahead));
+            segfmem->setPool(pool.get());
+            if (depth > 0 && !pool->setAsync(depth))
+                cerr << "(no io_uring, sync reads) ";
+        }
+    }
     HierGraph hiergraph(segmem);
     int hiergraphsize = segmem.size();
     cerr << "[DONE]" << endl;
@@ -121,6 +178,7 @@ int main(const int a_argc, const char** a_argv)
 	for (int i = 0; i < cases; i ++){
 		// init time
 		single_time = 0;
+		if (pool) pool->resetCounters();
 		// read obj set
 		int num_obj;
 		fscanf(fin, "%d", &num_obj);
@@ -156,27 +214,34 @@ int main(const int a_argc, const char** a_argv)
 			}
 
 		}
+		nmap.build();
+		gmap.computeBounds(hiergraph, nmap);
 		
 		
 		// read locid and test
-		int num_ql, locid, K;
+		int num_ql, K;
 
 		fscanf(fin, "%d", &K);
 		fscanf(fin, "%d", &num_ql);
 		cout << "K" << K << "NUM_QL:" << num_ql << endl;
 
-		for (int j = 0; j < num_ql; j ++){
-			fscanf(fin, "%d", &locid);
-			cout << "locid" << locid << endl;
+		vector<int> locids(num_ql);
+		vector<long> qtime(num_ql);
+		for (int j = 0; j < num_ql; j ++)
+			fscanf(fin, "%d", &locids[j]);
+
+		// the queries on the workers, each reads with its own history
+		vector<Access> whistory(threads);
+		parallel_for(threads, num_ql, [&](int worker, int j){
+			segmem.bindHistory(&whistory[worker]);
 			Array result;
 	        int nodeaccess=0;
 		    int edgeaccess=0;
-			segmem.m_history.clean();
 
 			// test start!
-			TIME_TICK_START
-			HierObjectSearch::kNNSearch(hiergraph,nmap,gmap, locid, K ,result,nodeaccess,edgeaccess);
-			TIME_TICK_END
+			long t0 = time_tick();
+			HierObjectSearch::kNNSearch(hiergraph,nmap,gmap, locids[j], K ,result,nodeaccess,edgeaccess);
+			qtime[j] = time_tick() - t0;
 
 			//----------------------------------------------------------------------
 			// result clean up
@@ -186,14 +251,28 @@ int main(const int a_argc, const char** a_argv)
 				ObjectSearchResult* r = (ObjectSearchResult*)result.get(i);
 				delete r;
 			}
+		});
+		segmem.bindHistory(0);
+		segmem.m_history.clean();
+		for (int t = 0; t < threads; t ++)
+			segmem.m_history.append(whistory[t]);
 
-			single_time += TIME_TICK_DIFF
+		for (int j = 0; j < num_ql; j ++){
+			cout << "locid" << locids[j] << endl;
+			single_time += qtime[j];
 			all_cases ++;
 
 			printf("    Current: %lld\n", single_time / (j + 1));
 		}
 		all_time += single_time;
 		printf("Cases_%d: %lld\n", i, single_time / num_ql);
+		if (pool)
+			printf("IO_%d: hit=%ld miss=%ld byte=%ld\n", i,
+				IOMeasure::poolhit(*pool), IOMeasure::poolmiss(*pool),
+				IOMeasure::poolbyte(*pool));
+		if (pool && pool->isAsync())
+			printf("ASYNC_%d: prefetched=%ld waits=%ld\n", i,
+				pool->prefetched(), pool->waits());
 	}
 	printf("Overall: %lld\n", all_time / all_cases);
 	fclose(fin);
@@ -17,6 +17,8 @@
     -q: number of query
     -k: k (# of NNs)
     -v: turn verbose mode on (default: off)
+    -m: map index files read-only, advised random, sequential, normal,
+        willneed or preload (default: off, buffered reads)
 
 	MY TEST:(ONLY THESE TWO PARAMS)
 	-h: hiergraph index file
@@ -26,7 +28,7 @@
 #include "hiergraph.h"
 #include "bordernode.h"
 #include "shortcuttreenode.h"
-#include "segfmem.h"
+#include "segmapmem.h"
 #include "param.h"
 #include "collection.h"
 #include "nodemap.h"
@@ -42,6 +44,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <fstream>
 
@@ -75,6 +78,7 @@ void helpmsg(const char* pgm)
     cerr << "-q: #queries" << endl;
     cerr << "-k: #NNs " << endl;
     cerr << "-v: turn verbose mode on (default: off)" << endl;
+    cerr << "-m: map index files: random, sequential, normal, willneed or preload (default: off)" << endl;
 }
 
 void test(){
@@ -98,6 +102,7 @@ int main(const int a_argc, const char** a_argv)
     const char* cnumquery  = Param::read(a_argc, a_argv, "-q", "");
     const char* ck = Param::read(a_argc, a_argv, "-k", "10");
     const char* vrbs = Param::read(a_argc, a_argv, "-v", "null");
+    const char* cmap = Param::read(a_argc, a_argv, "-m", "");
     const char* FILE_OBJECT = Param::read(a_argc, a_argv, "-x", "");
 	bool verbose = strcmp(vrbs,"null") != 0;
 
@@ -107,7 +112,8 @@ int main(const int a_argc, const char** a_argv)
     //-------------------------------------------------------------------------
     cerr << "loading a graph index ... ";
     // SegFMemory segmem(hidxflname, PAGESIZE*10, PAGESIZE, 32, false);
-	SegFMemory segmem(hidxflname, PAGESIZE, PAGESIZE, 32, false);
+	std::unique_ptr<SegMemory> segmemp(SegMapMemory::open(hidxflname, cmap, PAGESIZE, PAGESIZE, 32));
+	SegMemory& segmem = *segmemp;
     HierGraph hiergraph(segmem);
     int hiergraphsize = segmem.size();
     cerr << "[DONE]" << endl;
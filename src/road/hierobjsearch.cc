@@ -1,46 +1,113 @@
 #include "hierobjsearch.h"
 #include "hiergraph.h"
-#include "bordernode.h"
-#include "shortcuttreenode.h"
-#include "edge.h"
+#include "shortcutcsr.h"
 #include "nodemap.h"
 #include "graphmap.h"
 #include "graphplot.h"
+#include "pqueue.h"
 #include <math.h>
+#include <float.h>
+#include <vector>
 
-void findPath(BorderNode* node, GraphMapping& a_gmap, Array& links)
+// ----------------------------------------------------------------------------
+// shortcut tree walks: a stack of the sibling ranges left at each level
+// ----------------------------------------------------------------------------
+static void appendLinks(const ShortcutCSR& a_sc, const int a_i, Array& a_links)
+{
+    for (int j=a_sc.linkBegin(a_i); j<a_sc.linkEnd(a_i); j++)
+        a_links.append((void*)a_sc.link(j));
+}
+
+// a subgraph is passed on its shortcuts if it has no objects or the nearest
+// is beyond a_limit from the node(at a_cost)
+void findPath(const ShortcutCSR& a_sc, GraphMapping& a_gmap,
+              const float a_cost, const float a_limit, Array& links)
 {
-    Stack s;
-    s.push((void*)&node->m_shortcuttree);
-    while (!s.isEmpty())
+    int b[ShortcutCSR::MAXDEPTH], e[ShortcutCSR::MAXDEPTH];
+    int top = 0;
+    b[0] = 0;
+    e[0] = a_sc.roots();
+    while (top >= 0)
     {
-        Array* a = (Array*)s.pop();
-        for (int i=0; i<a->size(); i++)
+        if (b[top] == e[top])
         {
-            ShortcutTreeNode* sc = (ShortcutTreeNode*)a->get(i);
-            if (sc->m_subnetid == 0)
-            {
-                for (int j=0; j<sc->m_edges.size(); j++)
-                    links.append(sc->m_edges.get(j));
-            }
-            else
-            {
-                const Array* obj = a_gmap.findObject(sc->m_subnetid);
-                if (sc->m_edges.size() > 0 && obj == 0)
-                {
-                    for (int j=0; j<sc->m_edges.size(); j++)
-                        links.append(sc->m_edges.get(j));
-                }
-                else
-                {
-                    s.push(&sc->m_child);
-                }
-            }
-
+            top--;
+            continue;
+        }
+        int i = b[top]++;
+        int subnetid = a_sc.subnet(i);
+        if (subnetid == 0)
+        {
+            appendLinks(a_sc, i, links);
+            continue;
+        }
+        if (a_sc.linkEnd(i) > a_sc.linkBegin(i) &&
+            (a_gmap.count(subnetid) == 0 ||
+            a_cost + a_gmap.bound(subnetid, a_sc.id()) > a_limit))
+            appendLinks(a_sc, i, links);
+        else if (a_sc.childEnd(i) > a_sc.childBegin(i))
+        {
+            top++;
+            b[top] = a_sc.childBegin(i);
+            e[top] = a_sc.childEnd(i);
         }
     }
 }
 
+// ----------------------------------------------------------------------------
+// kNN reach: the k-th least cost of the object nodes in the queue so far
+// (no k-th NN is farther), FLT_MAX until k objects are queued
+// ----------------------------------------------------------------------------
+class ObjectBound
+{
+protected:
+    class Cand
+    {
+    public:
+        float   m_cost;
+        int     m_nid;
+        int     m_objs;
+    };
+    const int           m_k;
+    int                 m_cnt;      // objects of m_cand
+    std::vector<Cand>   m_cand;     // by cost
+public:
+    ObjectBound(const int a_k): m_k(a_k), m_cnt(0) {};
+    float limit() const
+    {
+        return m_cnt >= m_k ? m_cand.back().m_cost : FLT_MAX;
+    };
+    void update(const int a_nid, const float a_cost, const int a_objs)
+    {
+        int i = 0;
+        while (i < (int)m_cand.size() && m_cand[i].m_nid != a_nid)
+            i++;
+        if (i < (int)m_cand.size())
+        {
+            if (a_cost >= m_cand[i].m_cost) return;
+            m_cand[i].m_cost = a_cost;
+        }
+        else
+        {
+            if (a_cost >= limit()) return;
+            Cand c;
+            c.m_cost = a_cost;
+            c.m_nid = a_nid;
+            c.m_objs = a_objs;
+            m_cand.push_back(c);
+            m_cnt += a_objs;
+        }
+        for (; i>0 && m_cand[i].m_cost < m_cand[i-1].m_cost; i--)
+            std::swap(m_cand[i], m_cand[i-1]);
+        // the farthest goes while the others hold k objects
+        while (m_cand.size() > 1 && m_cnt - m_cand.back().m_objs >= m_k)
+        {
+            m_cnt -= m_cand.back().m_objs;
+            m_cand.pop_back();
+        }
+    };
+};
+
 //-----------------------------------------------------------------------------
 // single point range search
 //-----------------------------------------------------------------------------
@@ -48,87 +115,95 @@ void HierObjectSearch::rangeSearch(HierGraph& a_graph,
                                    NodeMapping& a_nmap, GraphMapping& a_gmap,
                                    const int a_src, const float a_range,
                                    Array& a_result,
-                                   int& a_nodeaccess, int& a_edgeaccess)
+                                   int& a_nodeaccess, int& a_edgeaccess,
+                                   const bool a_path)
+{
+    multiRangeSearch(a_graph, a_nmap, a_gmap, a_src, &a_range, 1, &a_result,
+        a_nodeaccess, a_edgeaccess, a_path);
+}
+
+//-----------------------------------------------------------------------------
+// single point range search over several radii
+//-----------------------------------------------------------------------------
+void HierObjectSearch::multiRangeSearch(HierGraph& a_graph,
+                                        NodeMapping& a_nmap, GraphMapping& a_gmap,
+                                        const int a_src, const float* a_radii,
+                                        const int a_bands, Array* a_result,
+                                        int& a_nodeaccess, int& a_edgeaccess,
+                                        const bool a_path)
 {
     //-------------------------------------------------------------------------
     // initialization
     //-------------------------------------------------------------------------
-    a_result.clean();
+    for (int b=0; b<a_bands; b++)
+        a_result[b].clean();
     a_nodeaccess = 0;
     a_edgeaccess = 0;
+    if (a_bands <= 0) return;
+    const float range = a_radii[a_bands-1];
+    int b = 0;                              // costs come out non-decreasing
 
     //-------------------------------------------------------------------------
     // Dijkstra's shortest path search (best first)
     //-------------------------------------------------------------------------
     Set visited;
-    Hash pending;
-    BinHeap h(ObjectSearchResult::compare);
-    h.insert(new ObjectSearchResult(a_src,0));
+    SearchTrail trail(a_path);
+    IndexedPQueue<SearchEntry> h(1000);
+    Array links;
+    h.insert(a_src, SearchEntry(a_src,0,-1));
     while (!h.isEmpty())
     {
-        ObjectSearchResult* c = (ObjectSearchResult*)h.removeTop();
+        SearchEntry c;
+        h.removeTop(c);
 
         //---------------------------------------------------------------------
         // Check if the node is beyond the search range. If so, terminate!!!
         //---------------------------------------------------------------------
-        if (c->m_cost > a_range)
-        {
-            delete c;
+        if (c.m_cost > range)
             break;
-        }
 
         //---------------------------------------------------------------------
         // Check if the node is visited. If so, skip it.
         //---------------------------------------------------------------------
-        if (visited.in((void*)c->m_nid))
-        {
-            delete c;
+        if (visited.in((void*)c.m_nid))
             continue;
-        }
         a_nodeaccess++;
 
-        visited.insert((void*)c->m_nid);
+        visited.insert((void*)c.m_nid);
 
-        BorderNode* bnode = a_graph.getBorderNode(c->m_nid);
-        Array links;
-        findPath(bnode, a_gmap, links);
+        const int t = trail.add(c.m_nid, c.m_prev);
+
+        ShortcutCSR sc = a_graph.getShortcuts(c.m_nid);
+        links.clean();
+        findPath(sc, a_gmap, c.m_cost, range, links);
         for (int e=0; e<links.size(); e++)
         {
-            Edge* edge = (Edge*)links.get(e);
+            const ShortcutCSR::Link* edge = (const ShortcutCSR::Link*)links.get(e);
 
-            float cost = c->m_cost + edge->m_cost;
-            int idist = (long)pending.get(edge->m_neighbor);
-            if (idist != 0 && idist < floor(cost * 1000))  // there exists a same node is the queue
+            const float cost = c.m_cost + edge->m_cost;
+            if (visited.in((void*)edge->m_neighbor) || cost > range)
                 continue;
-
-            h.insert(
-                new ObjectSearchResult(edge->m_neighbor, c->m_path,
-                c->m_cost + edge->m_cost));
-            idist = (int)ceil(cost * 1000);
-            pending.put(edge->m_neighbor, (void*)idist);
-            a_edgeaccess++;
+            // a node in the queue keeps its least cost(decrease-key)
+            if (h.insert(edge->m_neighbor,
+                SearchEntry(edge->m_neighbor, cost, t)))
+                a_edgeaccess++;
         }
-        delete bnode;
 
         // --------------------------------------------------------------------
         // check if object is found
         // --------------------------------------------------------------------
-        const Array* objs = a_nmap.findObject(c->m_nid);
-        if (objs != 0)
+        const int* oid;
+        const int cnt = a_nmap.objects(c.m_nid, oid);
+        if (cnt > 0)
         {
-            c->addObjects(*objs);
-            a_result.append(c);
+            ObjectSearchResult* res =
+                new ObjectSearchResult(c.m_nid, trail, c.m_prev, c.m_cost);
+            res->addObjects(oid, cnt);
+            b += ObjectSearch::band(&a_radii[b], a_bands-b, c.m_cost);
+            a_result[b].append(res);
         }
-        else
-            delete c;
     }
 
-    // ------------------------------------------------------------------------
-    // clean up
-    // ------------------------------------------------------------------------
-    while (!h.isEmpty())
-        delete (ObjectSearchResult*)h.removeTop();
-
     // ------------------------------------------------------------------------
     // all done
     // ------------------------------------------------------------------------
@@ -142,7 +217,8 @@ void HierObjectSearch::kNNSearch(HierGraph& a_graph,
                                  NodeMapping& a_nmap, GraphMapping& a_gmap,
                                  const int a_src, const int k,
                                  Array& a_result,
-                                 int& a_nodeaccess, int& a_edgeaccess)
+                                 int& a_nodeaccess, int& a_edgeaccess,
+                                 const bool a_path)
 {
     //-------------------------------------------------------------------------
     // initialization
@@ -156,68 +232,69 @@ void HierObjectSearch::kNNSearch(HierGraph& a_graph,
     // Dijkstra's shortest path search (best first)
     //-------------------------------------------------------------------------
     Set visited;
-    Hash pending;
-    BinHeap h(ObjectSearchResult::compare);
-    h.insert(new ObjectSearchResult(a_src,0));
+    SearchTrail trail(a_path);
+    IndexedPQueue<SearchEntry> h(1000);
+    Array links;
+    ObjectBound reach(k);
+    h.insert(a_src, SearchEntry(a_src,0,-1));
     while (!h.isEmpty())
     {
-        ObjectSearchResult* c = (ObjectSearchResult*)h.removeTop();
+        SearchEntry c;
+        h.removeTop(c);
 
         //---------------------------------------------------------------------
         // Check if the node is visited. If so, skip it.
         //---------------------------------------------------------------------
-        if (visited.in((void*)c->m_nid))
-        {
-            delete c;
+        if (visited.in((void*)c.m_nid))
             continue;
-        }
         a_nodeaccess++;
 
-        visited.insert((void*)c->m_nid);
+        visited.insert((void*)c.m_nid);
 
-        BorderNode* bnode = a_graph.getBorderNode(c->m_nid);
-        Array links;
-        findPath(bnode, a_gmap, links);
+        const int t = trail.add(c.m_nid, c.m_prev);
+
+        ShortcutCSR sc = a_graph.getShortcuts(c.m_nid);
+        links.clean();
+        findPath(sc, a_gmap, c.m_cost, reach.limit(), links);
         for (int e=0; e<links.size(); e++)
         {
-            Edge* edge = (Edge*)links.get(e);
+            const ShortcutCSR::Link* edge = (const ShortcutCSR::Link*)links.get(e);
 
-            float cost = c->m_cost + edge->m_cost;
-            int idist = (long)pending.get(edge->m_neighbor);
-            if (idist != 0 && idist < floor(cost * 1000))  // there exists a same node is the queue
+            const float cost = c.m_cost + edge->m_cost;
+            if (visited.in((void*)edge->m_neighbor) || cost > reach.limit())
                 continue;
-
-            h.insert(
-                new ObjectSearchResult(edge->m_neighbor, c->m_path,
-                c->m_cost + edge->m_cost));
-            idist = (long)ceil(cost * 1000);
-            pending.put(edge->m_neighbor, (void*)idist);
-            a_edgeaccess++;
+            // a node in the queue keeps its least cost(decrease-key)
+            if (h.insert(edge->m_neighbor,
+                SearchEntry(edge->m_neighbor, cost, t)))
+            {
+                a_edgeaccess++;
+                // its record on the way while this node is worked on(disk
+                // pools with async reads, see PagePool::prefetch)
+                a_graph.prefetchNode(edge->m_neighbor);
+                const int* oid;
+                const int cnt = a_nmap.objects(edge->m_neighbor, oid);
+                if (cnt > 0)
+                    reach.update(edge->m_neighbor, cost, cnt);
+            }
         }
-        delete bnode;
 
         // --------------------------------------------------------------------
         // check if object is found
         // --------------------------------------------------------------------
-        const Array* objs = a_nmap.findObject(c->m_nid);
-        if (objs != 0)
+        const int* oid;
+        const int cnt = a_nmap.objects(c.m_nid, oid);
+        if (cnt > 0)
         {
-            c->addObjects(*objs);
-            a_result.append(c);
-            rescnt += objs->size();
+            ObjectSearchResult* res =
+                new ObjectSearchResult(c.m_nid, trail, c.m_prev, c.m_cost);
+            res->addObjects(oid, cnt);
+            a_result.append(res);
+            rescnt += cnt;
             if (rescnt >= k)   // once k objects are found, terminate!
                 break;
         }
-        else
-            delete c;
     }
 
-    // ------------------------------------------------------------------------
-    // clean up
-    // ------------------------------------------------------------------------
-    while (!h.isEmpty())
-        delete (ObjectSearchResult*)h.removeTop();
-
     // ------------------------------------------------------------------------
     // all done
     // ------------------------------------------------------------------------
@@ -246,69 +323,59 @@ void HierObjectSearch::kNNSearch(HierGraph& a_graph,
     // Dijkstra's shortest path search (best first)
     //-------------------------------------------------------------------------
     Set visited;
-    Hash pending;
-    BinHeap h(ObjectSearchResult::compare);
-    h.insert(new ObjectSearchResult(a_src,0));
+    SearchTrail trail;
+    IndexedPQueue<SearchEntry> h(1000);
+    Array links;
+    h.insert(a_src, SearchEntry(a_src,0,-1));
     while (!h.isEmpty())
     {
-        ObjectSearchResult* c = (ObjectSearchResult*)h.removeTop();
+        SearchEntry c;
+        h.removeTop(c);
 
         //---------------------------------------------------------------------
         // Check if the node is visited. If so, skip it.
         //---------------------------------------------------------------------
-        if (visited.in((void*)c->m_nid))
-        {
-            delete c;
+        if (visited.in((void*)c.m_nid))
             continue;
-        }
         a_nodeaccess++;
 
-        visited.insert((void*)c->m_nid);
-        a_visited.append((void*)c->m_nid);
+        visited.insert((void*)c.m_nid);
 
-        BorderNode* bnode = a_graph.getBorderNode(c->m_nid);
-        Array links;
-        findPath(bnode, a_gmap, links);
+        const int t = trail.add(c.m_nid, c.m_prev);
+        a_visited.append((void*)c.m_nid);
+
+        ShortcutCSR sc = a_graph.getShortcuts(c.m_nid);
+        links.clean();
+        findPath(sc, a_gmap, c.m_cost, FLT_MAX, links);
         for (int e=0; e<links.size(); e++)
         {
-            Edge* edge = (Edge*)links.get(e);
+            const ShortcutCSR::Link* edge = (const ShortcutCSR::Link*)links.get(e);
 
-            float cost = c->m_cost + edge->m_cost;
-            int idist = (long)pending.get(edge->m_neighbor);
-            if (idist != 0 && idist < floor(cost * 1000))  // there exists a same node is the queue
+            if (visited.in((void*)edge->m_neighbor))
                 continue;
-
-            h.insert(
-                new ObjectSearchResult(edge->m_neighbor, c->m_path,
-                c->m_cost + edge->m_cost));
-            idist = (int)ceil(cost * 1000);
-            pending.put(edge->m_neighbor, (void*)idist);
-            a_edgeaccess++;
+            // a node in the queue keeps its least cost(decrease-key)
+            if (h.insert(edge->m_neighbor,
+                SearchEntry(edge->m_neighbor, c.m_cost + edge->m_cost, t)))
+                a_edgeaccess++;
         }
-        delete bnode;
 
         // --------------------------------------------------------------------
         // check if object is found
         // --------------------------------------------------------------------
-        const Array* objs = a_nmap.findObject(c->m_nid);
-        if (objs != 0)
+        const int* oid;
+        const int cnt = a_nmap.objects(c.m_nid, oid);
+        if (cnt > 0)
         {
-            c->addObjects(*objs);
-            a_result.append(c);
-            rescnt += objs->size();
+            ObjectSearchResult* res =
+                new ObjectSearchResult(c.m_nid, trail, c.m_prev, c.m_cost);
+            res->addObjects(oid, cnt);
+            a_result.append(res);
+            rescnt += cnt;
             if (rescnt >= k)   // once k objects are found, terminate!
                 break;
         }
-        else
-            delete c;
     }
 
-    // ------------------------------------------------------------------------
-    // clean up
-    // ------------------------------------------------------------------------
-    while (!h.isEmpty())
-        delete (ObjectSearchResult*)h.removeTop();
-
     // ------------------------------------------------------------------------
     // all done
     // ------------------------------------------------------------------------
@@ -316,101 +383,79 @@ void HierObjectSearch::kNNSearch(HierGraph& a_graph,
 }
 
 void updateQueryMap(GraphMapping& a_qmap, GraphMapping& a_gmap,
-                    BorderNode* a_node, const int a_q, const int a_cnt,
+                    const ShortcutCSR& a_sc, const int a_q, const int a_cnt,
                     Array& a_hits)
 {
-    Stack s;
-    s.push(&a_node->m_shortcuttree);
-    while (!s.isEmpty())
+    // every tree node is visited: the walk is its breadth first order
+    for (int i=0; i<a_sc.nodes(); i++)
     {
-        Array* a = (Array*)s.pop();
-        for (int i=0; i<a->size(); i++)
+        int subnetid = a_sc.subnet(i);
+        if (subnetid != 0 && a_gmap.findObject(subnetid) != 0)
         {
-            ShortcutTreeNode* sc = (ShortcutTreeNode*)a->get(i);
-            if (sc->m_subnetid != 0 && a_gmap.findObject(sc->m_subnetid) != 0)
+            Array* query = 0;
+            query = (Array*)a_qmap.findObject(subnetid);
+            int oldcnt = query == 0 ? 0 : query->size();
+            if (oldcnt != a_cnt)
             {
-                Array* query = 0;
-                query = (Array*)a_qmap.findObject(sc->m_subnetid);
-                int oldcnt = query == 0 ? 0 : query->size();
-                if (oldcnt != a_cnt)
-                {
-                    a_qmap.addObject(sc->m_subnetid,a_q);   // associate q to subnet
-                    query = (Array*)a_qmap.findObject(sc->m_subnetid);
-                    int newcnt = query == 0 ? 0 : query->size();
-                    if (newcnt > oldcnt && newcnt == a_cnt)
-                        a_hits.append((void*)sc->m_subnetid);
-                }
+                a_qmap.addObject(subnetid,a_q);     // associate q to subnet
+                query = (Array*)a_qmap.findObject(subnetid);
+                int newcnt = query == 0 ? 0 : query->size();
+                if (newcnt > oldcnt && newcnt == a_cnt)
+                    a_hits.append((void*)subnetid);
             }
-            s.push(&sc->m_child);
         }
     }
 }
 
-void findPath(BorderNode* a_node,
+void findPath(const ShortcutCSR& a_sc,
               GraphMapping& a_gmap, GraphMapping& a_qmap,
               const int a_cnt,
               Array& a_links, Array& a_wait)
 {
-    Stack s;
-    s.push(&a_node->m_shortcuttree);
-    while (!s.isEmpty())
+    int b[ShortcutCSR::MAXDEPTH], e[ShortcutCSR::MAXDEPTH];
+    int top = 0;
+    b[0] = 0;
+    e[0] = a_sc.roots();
+    while (top >= 0)
     {
-        Array* a = (Array*)s.pop();
-        for (int i=0; i<a->size(); i++)
+        if (b[top] == e[top])
+        {
+            top--;
+            continue;
+        }
+        int i = b[top]++;
+        int subnetid = a_sc.subnet(i);
+        if (subnetid == 0)
         {
-            ShortcutTreeNode* sc = (ShortcutTreeNode*)a->get(i);
-            if (sc->m_subnetid == 0)
+            appendLinks(a_sc, i, a_links);
+            continue;
+        }
+        bool down = true;
+        if (a_sc.linkEnd(i) > a_sc.linkBegin(i))
+        {
+            Array* objs = (Array*)a_gmap.findObject(subnetid);
+            if (objs == 0)
             {
-                for (int j=0; j<sc->m_edges.size(); j++)
-                    a_links.append(sc->m_edges.get(j));
+                appendLinks(a_sc, i, a_links);
+                down = false;
             }
             else
             {
-                if (sc->m_edges.size() > 0)
+                Array* query = (Array*)a_qmap.findObject(subnetid);
+                if (query->size() < a_cnt)
                 {
-                    Array* objs = (Array*)a_gmap.findObject(sc->m_subnetid);
-                    if (objs == 0)
-                    {
-                        for (int j=0; j<sc->m_edges.size(); j++)
-                            a_links.append(sc->m_edges.get(j));
-                    }
-                    else
-                    {
-                        Array* query = (Array*)a_qmap.findObject(sc->m_subnetid);
-                        if (query->size() < a_cnt)
-                        {
-                            for (int j=0; j<sc->m_edges.size(); j++)
-                                a_links.append(sc->m_edges.get(j));
-                            a_wait.append((void*)sc->m_subnetid);
-                        }
-                        else
-                        {
-                            s.push(&sc->m_child);
-                        }
-                    }
-                        
-                    /*
-                    Array* objs = (Array*)a_gmap.findObject(sc->m_subnetid);
-                    if (objs != 0)
-                    {   // go down for objects
-                        Array* query = (Array*)a_qmap.findObject(sc->m_subnetid);
-                        if (query->size() == a_cnt)
-                        {
-                            for (int j=0; j<sc->m_edges.size(); j++)
-                                a_links.append(sc->m_edges.get(j));
-                            a_wait.append((void*)sc->m_subnetid);
-                        }
-                        else
-                            s.push(&sc->m_child);
-                    }
-                    else
-                        s.push(&sc->m_child);
-                    */
+                    appendLinks(a_sc, i, a_links);
+                    a_wait.append((void*)subnetid);
+                    down = false;
                 }
-                else
-                    s.push(&sc->m_child);
             }
         }
+        if (down && a_sc.childEnd(i) > a_sc.childBegin(i))
+        {
+            top++;
+            b[top] = a_sc.childBegin(i);
+            e[top] = a_sc.childEnd(i);
+        }
     }
 }
 
@@ -434,18 +479,11 @@ void HierObjectSearch::groupRangeSearch(HierGraph& a_graph,
         const int   m_q;
         const int   m_nid;
         const float m_cost;
-        Array       m_path;
+        const int   m_prev;     // trail index of the node it came from
     public:
-        carrier(const int a_q, const int a_nid, const float a_cost):
-            m_q(a_q), m_nid(a_nid), m_cost(a_cost)
-            {
-                m_path.append((void*)m_nid);
-            };
-        carrier(const int a_q, const int a_nid, const float a_cost, const Array& a_path):
-            m_q(a_q), m_nid(a_nid), m_cost(a_cost), m_path(a_path)
-            {
-                m_path.append((void*)m_nid);
-            };
+        carrier(const int a_q, const int a_nid, const float a_cost,
+            const int a_prev=-1):
+            m_q(a_q), m_nid(a_nid), m_cost(a_cost), m_prev(a_prev) {};
         virtual ~carrier(){};
         static int compare(const void* a0, const void* a1)
         {
@@ -463,14 +501,13 @@ void HierObjectSearch::groupRangeSearch(HierGraph& a_graph,
     GraphMapping qmap;  // associate query in the hierarchical graph
     Hash standby;       // a collection of border nodes that are pending for objects
     Hash foundobjs;     // identified objects
+    SearchTrail trail;
     BinHeap h(carrier::compare);
-    Hash** pending = new Hash*[a_cnt];
+    // least cost a node is queued at, per query point
+    std::vector<FlatHash<int,float> > pending(a_cnt, FlatHash<int,float>(1000));
     Set** visited = new Set*[a_cnt];
     for (int i=0; i<a_cnt; i++)
-    {
         visited[i] = new Set(1000);
-        pending[i] = new Hash(1000);
-    }
 
     // ------------------------------------------------------------------------
     // start the search at individual query points
@@ -504,18 +541,19 @@ void HierObjectSearch::groupRangeSearch(HierGraph& a_graph,
         // mark the node visited
         // --------------------------------------------------------------------
         visited[c->m_q]->insert((void*)c->m_nid);
+        const int t = trail.add(c->m_nid, c->m_prev);
 
         // --------------------------------------------------------------------
         // exploring the node
         // --------------------------------------------------------------------
-        BorderNode* bnode = a_graph.getBorderNode(c->m_nid);
+        ShortcutCSR sc = a_graph.getShortcuts(c->m_nid);
         a_nodeaccess++;
         
         // --------------------------------------------------------------------
         // update query map
         // --------------------------------------------------------------------
         Array hits;
-        updateQueryMap(qmap, a_gmap, bnode, c->m_q, a_cnt, hits);
+        updateQueryMap(qmap, a_gmap, sc, c->m_q, a_cnt, hits);
         
         // --------------------------------------------------------------------
         // fire pending traversal
@@ -543,19 +581,19 @@ void HierObjectSearch::groupRangeSearch(HierGraph& a_graph,
         // --------------------------------------------------------------------
         Array links;
         Array wait;
-        findPath(bnode, a_gmap, qmap, a_cnt, links, wait);
+        findPath(sc, a_gmap, qmap, a_cnt, links, wait);
         for (int i=0; i<links.size(); i++)
         {
-            Edge* edge = (Edge*)links.get(i);
+            const ShortcutCSR::Link* edge = (const ShortcutCSR::Link*)links.get(i);
 
             float cost = c->m_cost + edge->m_cost;
-            int idist = (long)pending[c->m_q]->get(edge->m_neighbor);
-            if (idist != 0 && idist < floor(cost * 1000))  // there exists a same node is the queue
+            float* queued = pending[c->m_q].find(edge->m_neighbor);
+            if (queued != 0 && *queued < cost)  // in the queue at less cost
                 continue;
 
-            h.insert(new carrier(c->m_q, edge->m_neighbor, c->m_cost + edge->m_cost, c->m_path));
-            idist = (int)ceil(cost * 1000);
-            pending[c->m_q]->put(edge->m_neighbor, (void*)idist);
+            h.insert(new carrier(c->m_q, edge->m_neighbor, cost, t));
+            if (queued != 0) *queued = cost;
+            else pending[c->m_q].put(edge->m_neighbor, cost);
             a_edgeaccess++;
         }
 
@@ -568,24 +606,25 @@ void HierObjectSearch::groupRangeSearch(HierGraph& a_graph,
             Array* queued = (Array*)standby.get(subnetid);
             if (queued == 0)
                 standby.put(subnetid, queued = new Array);
-            queued->append(new carrier(c->m_q, c->m_nid, c->m_cost, c->m_path));
+            queued->append(new carrier(c->m_q, c->m_nid, c->m_cost, t));
         }
-        delete bnode;
 
         // --------------------------------------------------------------------
         // keep the asscoiated objects if any
         // --------------------------------------------------------------------
-        const Array* objs = a_nmap.findObject(c->m_nid);
-        for (int j=0; objs!=0 && j<objs->size(); j++)
+        const int* oids;
+        const int cnt = a_nmap.objects(c->m_nid, oids);
+        for (int j=0; j<cnt; j++)
         {
-            int oid = (long)objs->get(j);
+            int oid = oids[j];
             GroupObjectSearchResult* obj =
                 (GroupObjectSearchResult*)foundobjs.get(oid);
             if (obj == 0)
                 foundobjs.put(oid, obj =
                 new GroupObjectSearchResult(c->m_nid, oid, a_cnt));
             obj->m_cost[c->m_q] = c->m_cost;
-            obj->m_path[c->m_q].copy(c->m_path);
+            obj->m_path[c->m_q].clean();
+            trail.path(t, obj->m_path[c->m_q]);
             if (obj->allreached(a_cnt))
             {
                 a_result.append(obj);
@@ -615,220 +654,107 @@ void HierObjectSearch::groupRangeSearch(HierGraph& a_graph,
         delete (GroupObjectSearchResult*)rdr.getVal();
 
     for (int i=0; i<a_cnt; i++)
-    {
         delete visited[i];
-        delete pending[i];
-    }
     delete[] visited;
-    delete[] pending;
 }
 
 // ----------------------------------------------------------------------------
-// multi-point kNN search
+// network expansion from one query point of a group, run a batch at a time
+// (the interface of ObjectSearch's GroupExpansion for groupThreshold): a
+// subnet is passed on its shortcuts if it has no objects or the nearest is
+// beyond m_range
 // ----------------------------------------------------------------------------
-void HierObjectSearch::groupKNNSearch(HierGraph& a_graph,
-                                      NodeMapping& a_nmap, GraphMapping& a_gmap,
-                                      const int* a_src, const int a_cnt,
-                                      const int a_k,
-                                      Array& a_result,
-                                      int& a_nodeaccess, int& a_edgeaccess)
+class HierGroupExpansion
 {
-    // ------------------------------------------------------------------------
-    // data structure for queuing nodes
-    // ------------------------------------------------------------------------
-    class carrier
+public:
+    HierGraph&                  m_graph;
+    NodeMapping&                m_nmap;
+    GraphMapping&               m_gmap;
+    Set                         m_visited;
+    SearchTrail                 m_trail;
+    IndexedPQueue<SearchEntry>  m_heap;
+    Array                       m_links;
+    std::vector<SearchEntry>    m_found;    // objects reached(m_prev: trail index)
+    float                       m_range;    // nodes beyond are not expanded
+    int                         m_nodeaccess;
+    int                         m_edgeaccess;
+public:
+    HierGroupExpansion(HierGraph& a_graph, NodeMapping& a_nmap,
+                       GraphMapping& a_gmap, const int a_src):
+        m_graph(a_graph), m_nmap(a_nmap), m_gmap(a_gmap), m_visited(1000),
+        m_heap(1000), m_range(FLT_MAX), m_nodeaccess(0), m_edgeaccess(0)
     {
-    public:
-        const int   m_q;
-        const int   m_nid;
-        const float m_cost;
-        Array       m_path;
-    public:
-        carrier(const int a_q, const int a_nid, const float a_cost):
-            m_q(a_q), m_nid(a_nid), m_cost(a_cost)
-            {
-                m_path.append((void*)m_nid);
-            };
-        carrier(const int a_q, const int a_nid, const float a_cost, const Array& a_path):
-            m_q(a_q), m_nid(a_nid), m_cost(a_cost), m_path(a_path)
-            {
-                m_path.append((void*)m_nid);
-            };
-        virtual ~carrier(){};
-        static int compare(const void* a0, const void* a1)
-        {
-            carrier* c0 = *(carrier**)a0;
-            carrier* c1 = *(carrier**)a1;
-            if (c0->m_cost < c1->m_cost) return -1;
-            if (c0->m_cost > c1->m_cost) return +1;
-            return 0;
-        }
+        m_heap.insert(a_src, SearchEntry(a_src,0,-1));
     };
-
-    // ------------------------------------------------------------------------
-    // initialization
-    // ------------------------------------------------------------------------
-    GraphMapping qmap;   // associate query in the hierarchical graph
-    Hash standby;
-    Hash foundobjs;
-    BinHeap h(carrier::compare);
-    Hash** pending = new Hash*[a_cnt];
-    Set** visited = new Set*[a_cnt];
-    for (int i=0; i<a_cnt; i++)
+    float frontier() const
     {
-        visited[i] = new Set(1000);
-        pending[i] = new Hash(1000);
-    }
-
-    // ------------------------------------------------------------------------
-    // start the search at individual query points
-    // ------------------------------------------------------------------------
-    for (int i=0; i<a_cnt; i++)
-        h.insert(new carrier(i, a_src[i], 0));
-
-    while (!h.isEmpty())
+        return m_heap.isEmpty() ? FLT_MAX : m_heap.topVal().m_cost;
+    };
+    void expand(const int a_nodes)
     {
-        carrier* c = (carrier*)h.removeTop();
-
-        // --------------------------------------------------------------------
-        // if k answer objects are found, skip it and the rest
-        // --------------------------------------------------------------------
-        if (a_result.size() >= a_k)
+        for (int n=0; !m_heap.isEmpty() && n!=a_nodes; )
         {
-            delete c;
-            continue;
-        }
-
-        // --------------------------------------------------------------------
-        // skip the expansion if the node has been already visited
-        // --------------------------------------------------------------------
-        if (visited[c->m_q]->in((void*)c->m_nid))
-        {
-            delete c;
-            continue;
-        }
-
-        // --------------------------------------------------------------------
-        // mark the node visited
-        // --------------------------------------------------------------------
-        visited[c->m_q]->insert((void*)c->m_nid);
-
-        // --------------------------------------------------------------------
-        // exploring the node
-        // --------------------------------------------------------------------
-        BorderNode* bnode = a_graph.getBorderNode(c->m_nid);
-        a_nodeaccess++;
-        
-        // --------------------------------------------------------------------
-        // update query map
-        // --------------------------------------------------------------------
-        Array hits;
-        updateQueryMap(qmap, a_gmap, bnode, c->m_q, a_cnt, hits);
-        
-        // --------------------------------------------------------------------
-        // fire pending traversal
-        // --------------------------------------------------------------------
-        for (int i=0; i<hits.size(); i++)
-        {
-            int subnetid = (long)hits.get(i);
-            Array* queued = (Array*)standby.get(subnetid);
-            if (queued != 0)
+            SearchEntry c;
+            m_heap.removeTop(c);
+            if (c.m_cost > m_range)
             {
-                for (int j=0; j<queued->size(); j++)
-                {
-                    carrier* newc = (carrier*)queued->get(j);
-                    visited[newc->m_q]->remove((void*)newc->m_nid);
-                    h.insert(newc);
-                }
-                queued->clean();
-                delete queued;
-                standby.remove(subnetid);
+                m_heap.clean();
+                break;
             }
-        }
-
-        // --------------------------------------------------------------------
-        // expanding the search range
-        // --------------------------------------------------------------------
-        Array links;
-        Array wait;
-        findPath(bnode, a_gmap, qmap, a_cnt, links, wait);
-        for (int i=0; i<links.size(); i++)
-        {
-            Edge* edge = (Edge*)links.get(i);
-
-            float cost = c->m_cost + edge->m_cost;
-            int idist = (long)pending[c->m_q]->get(edge->m_neighbor);
-            if (idist != 0 && idist < floor(cost * 1000))  // there exists a same node is the queue
+            if (m_visited.in((void*)c.m_nid))
                 continue;
-
-            h.insert(new carrier(c->m_q, edge->m_neighbor, c->m_cost + edge->m_cost, c->m_path));
-            idist = (int)ceil(cost * 1000);
-            pending[c->m_q]->put(edge->m_neighbor, (void*)idist);
-            a_edgeaccess++;
-        }
-
-        // --------------------------------------------------------------------
-        // expanding the search range
-        // --------------------------------------------------------------------
-        for (int i=0; i<wait.size(); i++)
-        {
-            int subnetid = (long)wait.get(i);
-            Array* queued = (Array*)standby.get(subnetid);
-            if (queued == 0)
-                standby.put(subnetid, queued = new Array);
-            queued->append(new carrier(c->m_q, c->m_nid, c->m_cost, c->m_path));
-        }
-        delete bnode;
-
-        // --------------------------------------------------------------------
-        // keep the asscoiated objects if any
-        // --------------------------------------------------------------------
-        const Array* objs = a_nmap.findObject(c->m_nid);
-        for (int j=0; objs!=0 && j<objs->size(); j++)
-        {
-            int oid = (long)objs->get(j);
-            GroupObjectSearchResult* obj =
-                (GroupObjectSearchResult*)foundobjs.get(oid);
-            if (obj == 0)
-                foundobjs.put(oid, obj =
-                new GroupObjectSearchResult(c->m_nid, oid, a_cnt));
-            obj->m_cost[c->m_q] = c->m_cost;
-            obj->m_path[c->m_q].copy(c->m_path);
-            if (obj->allreached(a_cnt))
+            m_visited.insert((void*)c.m_nid);
+            m_nodeaccess++;
+            n++;
+            const int t = m_trail.add(c.m_nid, c.m_prev);
+
+            ShortcutCSR sc = m_graph.getShortcuts(c.m_nid);
+            m_links.clean();
+            findPath(sc, m_gmap, c.m_cost, m_range, m_links);
+            for (int e=0; e<m_links.size(); e++)
             {
-                a_result.append(obj);
-                foundobjs.remove(oid);
+                const ShortcutCSR::Link* edge =
+                    (const ShortcutCSR::Link*)m_links.get(e);
+                const float cost = c.m_cost + edge->m_cost;
+                if (m_visited.in((void*)edge->m_neighbor) || cost > m_range)
+                    continue;
+                // a node in the queue keeps its least cost(decrease-key)
+                if (m_heap.insert(edge->m_neighbor,
+                    SearchEntry(edge->m_neighbor, cost, t)))
+                    m_edgeaccess++;
             }
-        }
 
-        delete c;
-    }
-
-    // ------------------------------------------------------------------------
-    // clean up
-    // ------------------------------------------------------------------------
-    for (HashReader rdr(standby); !rdr.isEnd(); rdr.next())
-    {
-        Array* queued = (Array*)rdr.getVal();
-        if (queued != 0)
-        {
-            for (int i=0; i<queued->size(); i++)
-                delete (carrier*)queued->get(i);
-            delete queued;
+            const int* oids;
+            const int cnt = m_nmap.objects(c.m_nid, oids);
+            for (int j=0; j<cnt; j++)
+                m_found.push_back(SearchEntry(c.m_nid, c.m_cost, t, oids[j]));
         }
-    }
-    standby.clean();
-    
-    for (HashReader rdr(foundobjs); !rdr.isEnd(); rdr.next())
-        delete (GroupObjectSearchResult*)rdr.getVal();
+    };
+};
+
+// ----------------------------------------------------------------------------
+// multi-point kNN search
+// (a threshold algorithm over the expansions, see groupThreshold)
+// ----------------------------------------------------------------------------
+void HierObjectSearch::groupKNNSearch(HierGraph& a_graph,
+                                      NodeMapping& a_nmap, GraphMapping& a_gmap,
+                                      const int* a_src, const int a_cnt,
+                                      const int a_k,
+                                      Array& a_result,
+                                      int& a_nodeaccess, int& a_edgeaccess,
+                                      const int a_agg, const int a_threads)
+{
+    std::vector<HierGroupExpansion*> exp(a_cnt);
+    for (int i=0; i<a_cnt; i++)
+        exp[i] = new HierGroupExpansion(a_graph, a_nmap, a_gmap, a_src[i]);
+    groupThreshold(exp, a_k, a_agg, a_threads, &a_graph.memory(), a_result);
 
     for (int i=0; i<a_cnt; i++)
     {
-        delete visited[i];
-        delete pending[i];
+        a_nodeaccess += exp[i]->m_nodeaccess;
+        a_edgeaccess += exp[i]->m_edgeaccess;
+        delete exp[i];
     }
-    delete[] visited;
-    delete[] pending;
 }
 
 
@@ -849,18 +775,11 @@ void HierObjectSearch::groupKNNSearch(HierGraph& a_graph,
         const int   m_q;
         const int   m_nid;
         const float m_cost;
-        Array       m_path;
+        const int   m_prev;     // trail index of the node it came from
     public:
-        carrier(const int a_q, const int a_nid, const float a_cost):
-            m_q(a_q), m_nid(a_nid), m_cost(a_cost)
-            {
-                m_path.append((void*)m_nid);
-            };
-        carrier(const int a_q, const int a_nid, const float a_cost, const Array& a_path):
-            m_q(a_q), m_nid(a_nid), m_cost(a_cost), m_path(a_path)
-            {
-                m_path.append((void*)m_nid);
-            };
+        carrier(const int a_q, const int a_nid, const float a_cost,
+            const int a_prev=-1):
+            m_q(a_q), m_nid(a_nid), m_cost(a_cost), m_prev(a_prev) {};
         virtual ~carrier(){};
         static int compare(const void* a0, const void* a1)
         {
@@ -878,14 +797,13 @@ void HierObjectSearch::groupKNNSearch(HierGraph& a_graph,
     GraphMapping qmap;   // associate query in the hierarchical graph
     Hash standby;
     Hash foundobjs;
+    SearchTrail trail;
     BinHeap h(carrier::compare);
-    Hash** pending = new Hash*[a_cnt];
+    // least cost a node is queued at, per query point
+    std::vector<FlatHash<int,float> > pending(a_cnt, FlatHash<int,float>(1000));
     Set** visited = new Set*[a_cnt];
     for (int i=0; i<a_cnt; i++)
-    {
         visited[i] = new Set(1000);
-        pending[i] = new Hash(1000);
-    }
 
     // ------------------------------------------------------------------------
     // start the search at individual query points
@@ -927,19 +845,20 @@ void HierObjectSearch::groupKNNSearch(HierGraph& a_graph,
         if (!inserted) a_visited.append((void*)c->m_nid);
 
         visited[c->m_q]->insert((void*)c->m_nid);
+        const int t = trail.add(c->m_nid, c->m_prev);
 
 
         // --------------------------------------------------------------------
         // exploring the node
         // --------------------------------------------------------------------
-        BorderNode* bnode = a_graph.getBorderNode(c->m_nid);
+        ShortcutCSR sc = a_graph.getShortcuts(c->m_nid);
         a_nodeaccess++;
         
         // --------------------------------------------------------------------
         // update query map
         // --------------------------------------------------------------------
         Array hits;
-        updateQueryMap(qmap, a_gmap, bnode, c->m_q, a_cnt, hits);
+        updateQueryMap(qmap, a_gmap, sc, c->m_q, a_cnt, hits);
         
         // --------------------------------------------------------------------
         // fire pending traversal
@@ -967,19 +886,19 @@ void HierObjectSearch::groupKNNSearch(HierGraph& a_graph,
         // --------------------------------------------------------------------
         Array links;
         Array wait;
-        findPath(bnode, a_gmap, qmap, a_cnt, links, wait);
+        findPath(sc, a_gmap, qmap, a_cnt, links, wait);
         for (int i=0; i<links.size(); i++)
         {
-            Edge* edge = (Edge*)links.get(i);
+            const ShortcutCSR::Link* edge = (const ShortcutCSR::Link*)links.get(i);
 
             float cost = c->m_cost + edge->m_cost;
-            int idist = (long)pending[c->m_q]->get(edge->m_neighbor);
-            if (idist != 0 && idist < floor(cost * 1000))  // there exists a same node is the queue
+            float* queued = pending[c->m_q].find(edge->m_neighbor);
+            if (queued != 0 && *queued < cost)  // in the queue at less cost
                 continue;
 
-            h.insert(new carrier(c->m_q, edge->m_neighbor, c->m_cost + edge->m_cost, c->m_path));
-            idist = (int)ceil(cost * 1000);
-            pending[c->m_q]->put(edge->m_neighbor, (void*)idist);
+            h.insert(new carrier(c->m_q, edge->m_neighbor, cost, t));
+            if (queued != 0) *queued = cost;
+            else pending[c->m_q].put(edge->m_neighbor, cost);
             a_edgeaccess++;
         }
 
@@ -992,27 +911,29 @@ void HierObjectSearch::groupKNNSearch(HierGraph& a_graph,
             Array* queued = (Array*)standby.get(subnetid);
             if (queued == 0)
                 standby.put(subnetid, queued = new Array);
-            queued->append(new carrier(c->m_q, c->m_nid, c->m_cost, c->m_path));
+            queued->append(new carrier(c->m_q, c->m_nid, c->m_cost, t));
         }
-        delete bnode;
 
         // --------------------------------------------------------------------
         // keep the asscoiated objects if any
         // --------------------------------------------------------------------
-        const Array* objs = a_nmap.findObject(c->m_nid);
-        for (int j=0; objs!=0 && j<objs->size(); j++)
+        const int* oids;
+        const int cnt = a_nmap.objects(c->m_nid, oids);
+        for (int j=0; j<cnt; j++)
         {
-            int oid = (long)objs->get(j);
+            int oid = oids[j];
             GroupObjectSearchResult* obj =
                 (GroupObjectSearchResult*)foundobjs.get(oid);
             if (obj == 0)
                 foundobjs.put(oid, obj =
                 new GroupObjectSearchResult(c->m_nid, oid, a_cnt));
             obj->m_cost[c->m_q] = c->m_cost;
-            obj->m_path[c->m_q].copy(c->m_path);
+            obj->m_path[c->m_q].clean();
+            trail.path(t, obj->m_path[c->m_q]);
             if (obj->allreached(a_cnt))
             {
-                a_result.append(obj);
+                if (a_result.size() < a_k) a_result.append(obj);
+                else delete obj;    // ties at the kth are cut
                 foundobjs.remove(oid);
             }
         }
@@ -1039,10 +960,6 @@ void HierObjectSearch::groupKNNSearch(HierGraph& a_graph,
         delete (GroupObjectSearchResult*)rdr.getVal();
 
     for (int i=0; i<a_cnt; i++)
-    {
         delete visited[i];
-        delete pending[i];
-    }
     delete[] visited;
-    delete[] pending;
 }
@@ -23,16 +23,30 @@ public:
     static void rangeSearch(
         HierGraph& a_graph, NodeMapping& a_nmap, GraphMapping& a_gmap,
         const int a_src, const float a_range,
-        Array& a_result, int& a_nodeaccess, int& a_edgeaccess);
+        Array& a_result, int& a_nodeaccess, int& a_edgeaccess,
+        const bool a_path=true);
+
+    // ------------------------------------------------------------------------
+    // single point range search over several radii in one expansion
+    // (bands as ObjectSearch::multiRangeSearch; objects only: the shortcuts
+    // pass over the nodes inside Rnets, so there is no isochrone here)
+    // ------------------------------------------------------------------------
+    static void multiRangeSearch(
+        HierGraph& a_graph, NodeMapping& a_nmap, GraphMapping& a_gmap,
+        const int a_src, const float* a_radii, const int a_bands,
+        Array* a_result, int& a_nodeaccess, int& a_edgeaccess,
+        const bool a_path=true);
 
 
     // ------------------------------------------------------------------------
     // single point kNN search
+    // (a_path false for results with no path: no trail is kept)
     // ------------------------------------------------------------------------
     static void kNNSearch(
         HierGraph& a_graph, NodeMapping& a_map, GraphMapping& a_gmap,
         const int a_src, const int k,
-        Array& a_result,int& nodeaccess, int& edgeaccess);
+        Array& a_result,int& nodeaccess, int& edgeaccess,
+        const bool a_path=true);
     static void kNNSearch(
         HierGraph& a_graph, NodeMapping& a_map, GraphMapping& a_gmap,
         const int a_src, const int k,
@@ -50,13 +64,16 @@ public:
         Array& a_result,int& nodeaccess, int& edgeaccess);
 
     // ------------------------------------------------------------------------
-    // multi-point kNN search
+    // multi-point kNN search by aggregate cost a_agg(GROUP_MAX, GROUP_SUM)
+    // (as ObjectSearch::groupKNNSearch: the expansions from the query points
+    // run on a_threads threads; the trace version is sequential)
     // ------------------------------------------------------------------------
     static void groupKNNSearch(
         HierGraph& a_graph, NodeMapping& a_map, GraphMapping& a_gmap,
         const int* a_src, const int a_cnt,
         const int a_k,
-        Array& a_result,int& nodeaccess, int& edgeaccess);
+        Array& a_result,int& nodeaccess, int& edgeaccess,
+        const int a_agg=GROUP_MAX, const int a_threads=1);
     static void groupKNNSearch(
         HierGraph& a_graph, NodeMapping& a_map, GraphMapping& a_gmap,
         const int* a_src, const int a_cnt,
@@ -15,14 +15,16 @@
     -h: hiergraph index file (input)
     -o: object file
     -q: number of queries
-    -r: range
+    -r: range, or ranges r1,r2,.. ascending (one search, results by band)
     -v: turn verbose mode on (default: off)
+    -m: map index files read-only, advised random, sequential, normal,
+        willneed or preload (default: off, buffered reads)
 ---------------------------------------------------------------------------- */
 
 #include "hiergraph.h"
 #include "bordernode.h"
 #include "shortcuttreenode.h"
-#include "segfmem.h"
+#include "segmapmem.h"
 #include "param.h"
 #include "collection.h"
 #include "nodemap.h"
@@ -37,11 +39,13 @@
 #include <stdlib.h>
 #include <math.h>
 #include <iostream>
+#include <memory>
 #include <fstream>
 
 using namespace std;
 
 #define PAGESIZE    4096
+#define MAXBANDS    16
 
 void helpmsg(const char* pgm)
 {
@@ -52,8 +56,9 @@ void helpmsg(const char* pgm)
     cerr << "-h: hiergraph index file" << endl;
     cerr << "-o: object file" << endl;
     cerr << "-q: #queries" << endl;
-    cerr << "-r: range " << endl;
+    cerr << "-r: range, or ranges r1,r2,.. ascending (results by band)" << endl;
     cerr << "-v: turn verbose mode on (default: off)" << endl;
+    cerr << "-m: map index files: random, sequential, normal, willneed or preload (default: off)" << endl;
 }
 
 int main(const int a_argc, const char** a_argv)
@@ -73,13 +78,15 @@ int main(const int a_argc, const char** a_argv)
     const char* cnumquery  = Param::read(a_argc, a_argv, "-q", "");
     const char* crange = Param::read(a_argc, a_argv, "-r", "");
     const char* vrbs = Param::read(a_argc, a_argv, "-v", "null");
+    const char* cmap = Param::read(a_argc, a_argv, "-m", "");
     bool verbose = strcmp(vrbs,"null") != 0;
 
     //-------------------------------------------------------------------------
     // access graph index file
     //-------------------------------------------------------------------------
     cerr << "loading a graph index ... ";
-    SegFMemory segmem(hidxflname, PAGESIZE*10, PAGESIZE, 32, false);
+    std::unique_ptr<SegMemory> segmemp(SegMapMemory::open(hidxflname, cmap, PAGESIZE*10, PAGESIZE, 32));
+    SegMemory& segmem = *segmemp;
     HierGraph hiergraph(segmem);
     int hiergraphsize = segmem.size();
     cerr << "[DONE]" << endl;
@@ -119,6 +126,8 @@ int main(const int a_argc, const char** a_argv)
             objsize += sizeof(int)*2;
         }
     }
+    nmap.build();
+    gmap.computeBounds(hiergraph, nmap);
     ftime(&endtime);  // time the the object index creation
     idxtime =
         ((endtime.time*1000 + endtime.millitm) -
@@ -147,12 +156,15 @@ int main(const int a_argc, const char** a_argv)
     float diameter = GraphSearch::diameter(hiergraph,0,nodeaccess,edgeaccess);
     int nodecnt = hiergraph.m_nodes.size();
     int numquery = atol(cnumquery);
-    float range = (float)atof(crange);
+    float range[MAXBANDS], radii[MAXBANDS];
+    const int bands = Param::readList(crange, range, MAXBANDS);
+    for (int b=0; b<bands; b++)
+        radii[b] = range[b]*diameter;
 
     for (int i=0; i<numquery; i++)
     {
         int src = 0;
-        Array result;
+        Array result[MAXBANDS];
         int nodeaccess=0;
         int edgeaccess=0;
         int rescnt=0;
@@ -168,7 +180,7 @@ int main(const int a_argc, const char** a_argv)
         // object search here
         //----------------------------------------------------------------------
         ftime(&starttime);  // time the algorithm
-        HierObjectSearch::rangeSearch(hiergraph,nmap,gmap,src,range*diameter,result,nodeaccess,edgeaccess);
+        HierObjectSearch::multiRangeSearch(hiergraph,nmap,gmap,src,radii,bands,result,nodeaccess,edgeaccess);
         ftime(&endtime);
         float qtime = 
             ((endtime.time*1000 + endtime.millitm) -
@@ -179,25 +191,33 @@ int main(const int a_argc, const char** a_argv)
         //----------------------------------------------------------------------
         if (verbose)
         {
-            for (int i=0; i<result.size(); i++)
+            int ressize = 0;
+            for (int b=0; b<bands; b++)
             {
-                ObjectSearchResult* r = (ObjectSearchResult*)result.get(i);
-                cerr << r->m_nid << "," << r->m_cost << ":" << r->m_objects.size() << endl;
+                for (int i=0; i<result[b].size(); i++)
+                {
+                    ObjectSearchResult* r = (ObjectSearchResult*)result[b].get(i);
+                    cerr << r->m_nid << "," << r->m_cost << ":" << r->m_objects.size() << endl;
+                }
+                if (bands > 1)
+                    cerr << "-- band: " << range[b] << " -- result size: " << result[b].size() << endl;
+                ressize += result[b].size();
             }
             cerr << "---- time: " << qtime;
-            cerr << " -- result size: " << result.size();
+            cerr << " -- result size: " << ressize;
             cerr << " ----" << endl;
         }
 
         //----------------------------------------------------------------------
         // result clean up
         //----------------------------------------------------------------------
-        for (int i=0; i<result.size(); i++)
-        {
-            ObjectSearchResult* r = (ObjectSearchResult*)result.get(i);
-            rescnt += r->m_objects.size();
-            delete r;
-        }
+        for (int b=0; b<bands; b++)
+            for (int i=0; i<result[b].size(); i++)
+            {
+                ObjectSearchResult* r = (ObjectSearchResult*)result[b].get(i);
+                rescnt += r->m_objects.size();
+                delete r;
+            }
 
 
         //----------------------------------------------------------------------
@@ -11,6 +11,8 @@
 #define iomeasure_defined
 
 class Access;
+class NodeCache;
+class PagePool;
 
 class IOMeasure
 {
@@ -24,6 +26,22 @@ public:
     static int pagelru(
         const Access& a_access,
         const int a_pagesize, const int a_cachesize);
+    // decoded node cache(nodecache.h): nodes found, nodes read and decoded,
+    // nodes evicted
+    static long cachehit(
+        const NodeCache& a_cache);
+    static long cachemiss(
+        const NodeCache& a_cache);
+    static long cacheevict(
+        const NodeCache& a_cache);
+    // page buffer pool(pagepool.h): the real page hits, misses and bytes
+    // read, where pagelru simulates them from the history
+    static long poolhit(
+        const PagePool& a_pool);
+    static long poolmiss(
+        const PagePool& a_pool);
+    static long poolbyte(
+        const PagePool& a_pool);
 };
 
 #endif
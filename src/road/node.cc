@@ -19,18 +19,15 @@ Node::~Node()
     // ------------------------------------------------------------------------
     // clean up edges (free the memory)
     // ------------------------------------------------------------------------
-    int sz = m_edges.size();
-    for (int i=0; i<sz; i++)
-        delete (Edge*)m_edges.get(i);
     m_edges.clean();
 }
 
 // search
-float Node::cost(const int a_node)
+float Node::cost(const int a_node) const
 {
     for (int i=0; i<m_edges.size(); i++)
     {
-        Edge* e = (Edge*)m_edges.get(i);
+        const Edge* e = &m_edges[i];
         if (e->m_neighbor == a_node)
             return e->m_cost;
     }
@@ -48,14 +45,14 @@ void Node::addEdge(Edge& a_edge)
     int sz = m_edges.size();
     for (int i=0; i<sz; i++)
     {
-        Edge* e = (Edge*)m_edges.get(i);
+        Edge* e = &m_edges[i];
         if (e->m_neighbor == a_edge.m_neighbor)
         {
             e->m_cost = a_edge.m_cost;
             return;
         }
     }
-    m_edges.append(new Edge(a_edge.m_neighbor,a_edge.m_cost));
+    m_edges.append(Edge(a_edge.m_neighbor,a_edge.m_cost));
 }
 
 void Node::delEdge(Edge& a_edge)
@@ -66,10 +63,10 @@ void Node::delEdge(Edge& a_edge)
     int sz = m_edges.size();
     for (int i=0; i<sz; i++)
     {
-        Edge* e = (Edge*)m_edges.get(i);
+        Edge* e = &m_edges[i];
         if (e->m_neighbor == a_edge.m_neighbor)
         {
-            m_edges.remove(e);
+            m_edges.removeAt(i);
             return;
         }
     }
@@ -85,7 +82,7 @@ void Node::toMem(char* a_mem, int& a_len) const
     *(int*)&a_mem[a_len] = numedge; a_len += sizeof(int);
     for (int i=0; i<numedge; i++)
     {
-        Edge* e = (Edge*)m_edges.get(i);
+        const Edge* e = &m_edges[i];
         *(int*)&a_mem[a_len] = e->m_neighbor;   a_len += sizeof(e->m_neighbor);
         *(float*)&a_mem[a_len] = e->m_cost;     a_len += sizeof(e->m_cost);
     }
@@ -104,7 +101,7 @@ void Node::fromMem(char* a_mem, int& a_len)
         float cost;
         nid = *(int*)&a_mem[a_len];     a_len += sizeof(nid);
         cost= *(float*)&a_mem[a_len];   a_len += sizeof(cost);
-        m_edges.append(new Edge(nid,cost));
+        m_edges.append(Edge(nid,cost));
     }
 }
 
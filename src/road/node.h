@@ -13,22 +13,22 @@
 #define node_defined
 
 #include "collection.h"
-
-class Edge;
+#include "smallarray.h"
+#include "edge.h"
 
 class Node
 {
 public:
     int     m_id;       // node id, that should be unique
     float   m_x, m_y;   // the coordinate of the node
-    Array   m_edges;    // a set of edges to neighbors
+    SmallArray<Edge,4>  m_edges;    // a set of edges to neighbors
 public:
     // constructor/destructor
     Node(const int a_id, const float a_x=0, const float a_y=0);
     virtual ~Node();
     //
     // search
-    float cost(const int a_node);
+    float cost(const int a_node) const;
     //
     // edge manipulations
     void addEdge(Edge& a_edge);
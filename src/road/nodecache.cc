@@ -0,0 +1,163 @@
+/* ----------------------------------------------------------------------------
+    NodeCache: sharded, size-bounded cache of decoded nodes(CLOCK eviction).
+---------------------------------------------------------------------------- */
+
+#include "nodecache.h"
+
+// constructor/destructor
+NodeCache::NodeCache(const long a_capacity, const int a_shards):
+m_shardcnt(a_shards < 1 ? 1 : a_shards),
+m_hits(0), m_misses(0), m_evictions(0)
+{
+    m_shards = new Shard[m_shardcnt];
+    m_capacity = a_capacity / m_shardcnt;
+    for (int i=0; i<m_shardcnt; i++)
+    {
+        m_shards[i].m_hand = 0;
+        m_shards[i].m_bytes = 0;
+    }
+}
+
+NodeCache::~NodeCache()
+{
+    delete[] m_shards;
+}
+
+NodeCache::Shard& NodeCache::shard(const int a_nid)
+{
+    unsigned h = (unsigned)a_nid * 2654435761u;     // neighbors apart
+    return m_shards[(h >> 16) % m_shardcnt];
+}
+
+// ----------------------------------------------------------------------------
+// free room for a_size bytes in a shard(its lock held): the hand clears the
+// reference bits it passes and evicts the first unreferenced node
+// ----------------------------------------------------------------------------
+void NodeCache::evict(Shard& a_shard, const int a_size)
+{
+    while (a_shard.m_bytes + a_size > m_capacity && !a_shard.m_slot.empty())
+    {
+        if (a_shard.m_hand >= (int)a_shard.m_entries.size())
+            a_shard.m_hand = 0;
+        Entry& e = a_shard.m_entries[a_shard.m_hand++];
+        if (e.m_nid == -1)
+            continue;
+        if (e.m_ref)
+        {
+            e.m_ref = false;
+            continue;
+        }
+        a_shard.m_slot.erase(e.m_nid);
+        a_shard.m_free.push_back(a_shard.m_hand - 1);
+        a_shard.m_bytes -= e.m_size;
+        e.m_nid = -1;
+        e.m_node.reset();
+        m_evictions++;
+    }
+}
+
+// search
+NodeCache::Handle NodeCache::find(const int a_nid)
+{
+    Shard& s = shard(a_nid);
+    std::lock_guard<std::mutex> lock(s.m_lock);
+    std::unordered_map<int,int>::iterator it = s.m_slot.find(a_nid);
+    if (it == s.m_slot.end())
+    {
+        m_misses++;
+        return Handle();
+    }
+    Entry& e = s.m_entries[it->second];
+    e.m_ref = true;
+    m_hits++;
+    return e.m_node;
+}
+
+// update
+NodeCache::Handle NodeCache::insert(const int a_nid, const Handle& a_node,
+                                    const int a_size)
+{
+    if (a_size > m_capacity)
+        return a_node;
+    Shard& s = shard(a_nid);
+    std::lock_guard<std::mutex> lock(s.m_lock);
+    std::unordered_map<int,int>::iterator it = s.m_slot.find(a_nid);
+    if (it != s.m_slot.end())
+        return s.m_entries[it->second].m_node;
+    evict(s, a_size);
+    int i;
+    if (!s.m_free.empty())
+    {
+        i = s.m_free.back();
+        s.m_free.pop_back();
+    }
+    else
+    {
+        i = s.m_entries.size();
+        s.m_entries.push_back(Entry());
+    }
+    Entry& e = s.m_entries[i];
+    e.m_nid = a_nid;
+    e.m_node = a_node;
+    e.m_size = a_size;
+    e.m_ref = false;        // the first hit marks it
+    s.m_slot[a_nid] = i;
+    s.m_bytes += a_size;
+    return a_node;
+}
+
+void NodeCache::remove(const int a_nid)
+{
+    Shard& s = shard(a_nid);
+    std::lock_guard<std::mutex> lock(s.m_lock);
+    std::unordered_map<int,int>::iterator it = s.m_slot.find(a_nid);
+    if (it == s.m_slot.end())
+        return;
+    Entry& e = s.m_entries[it->second];
+    s.m_free.push_back(it->second);
+    s.m_bytes -= e.m_size;
+    e.m_nid = -1;
+    e.m_node.reset();
+    s.m_slot.erase(it);
+}
+
+void NodeCache::clean()
+{
+    for (int i=0; i<m_shardcnt; i++)
+    {
+        Shard& s = m_shards[i];
+        std::lock_guard<std::mutex> lock(s.m_lock);
+        s.m_slot.clear();
+        s.m_entries.clear();
+        s.m_free.clear();
+        s.m_hand = 0;
+        s.m_bytes = 0;
+    }
+}
+
+// info
+long NodeCache::hits() const
+{
+    return m_hits;
+}
+
+long NodeCache::misses() const
+{
+    return m_misses;
+}
+
+long NodeCache::evictions() const
+{
+    return m_evictions;
+}
+
+long NodeCache::bytes()
+{
+    long b = 0;
+    for (int i=0; i<m_shardcnt; i++)
+    {
+        std::lock_guard<std::mutex> lock(m_shards[i].m_lock);
+        b += m_shards[i].m_bytes;
+    }
+    return b;
+}
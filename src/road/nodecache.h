@@ -0,0 +1,78 @@
+/* ----------------------------------------------------------------------------
+    This file contains a class NodeCache declaration.
+    It keeps decoded nodes(Node, BorderNode, distance signatures, shortest
+    path quadtrees) in memory, so a hot node is read and unmarshalled once
+    instead of on every access.
+
+    - nodes are handed out as shared immutable handles: a handle stays
+      valid after its node is evicted, the node is freed with its last handle
+    - the cache is split into shards by node id, each with its own lock
+    - each shard holds at most capacity/shards bytes(the record length of
+      the node in the index file), eviction is CLOCK: a hit sets the
+      reference bit, the hand clears it and evicts nodes found unreferenced
+    - one cache serves one index(node ids are its keys), a node bigger than
+      a shard is not cached
+---------------------------------------------------------------------------- */
+#ifndef nodecache_defined
+#define nodecache_defined
+
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+
+class NodeCache
+{
+public:
+    typedef std::shared_ptr<const void> Handle;
+protected:
+    class Entry
+    {
+    public:
+        int     m_nid;      // -1 for a free slot
+        Handle  m_node;
+        int     m_size;     // bytes charged
+        bool    m_ref;      // reference bit
+    };
+    class Shard
+    {
+    public:
+        std::mutex                  m_lock;
+        std::unordered_map<int,int> m_slot;     // node id -> entry
+        std::vector<Entry>          m_entries;  // clock ring
+        std::vector<int>            m_free;     // free entries
+        int                         m_hand;
+        long                        m_bytes;
+    };
+    Shard*              m_shards;
+    int                 m_shardcnt;
+    long                m_capacity; // bytes per shard
+    std::atomic<long>   m_hits;
+    std::atomic<long>   m_misses;
+    std::atomic<long>   m_evictions;
+
+    Shard& shard(const int a_nid);
+    void evict(Shard& a_shard, const int a_size);
+public:
+    // constructor/destructor
+    NodeCache(const long a_capacity, const int a_shards=16);
+    virtual ~NodeCache();
+    //
+    // search: the cached node(and a hit) or an empty handle(and a miss)
+    Handle find(const int a_nid);
+    //
+    // update: caches a decoded node of a_size bytes and returns the handle
+    // to use(the one already cached if another caller got there first)
+    Handle insert(const int a_nid, const Handle& a_node, const int a_size);
+    void remove(const int a_nid);       // a node changed in the index
+    void clean();
+    //
+    // info
+    long hits() const;
+    long misses() const;
+    long evictions() const;
+    long bytes();
+};
+
+#endif
@@ -6,13 +6,42 @@
 ---------------------------------------------------------------------------- */
 
 #include "nodemap.h"
+#include <algorithm>
 
 // constructor/destructor
-NodeMapping::NodeMapping()
+NodeMapping::NodeMapping():
+m_built(false)
 {}
 
 NodeMapping::~NodeMapping()
-{}
+{
+    for (HashReader rdr(m_overlay); !rdr.isEnd(); rdr.next())
+        delete (std::vector<int>*)rdr.getVal();
+}
+
+// the objects of a node in the overlay(marked as updated once built)
+std::vector<int>* NodeMapping::overlay(const int a_nodeid)
+{
+    std::vector<int>* v = (std::vector<int>*)m_overlay.get(a_nodeid);
+    if (v == 0)
+    {
+        v = new std::vector<int>();
+        const int* oid;
+        const int cnt = objects(a_nodeid, oid);
+        v->assign(oid, oid + cnt);
+        m_overlay.put(a_nodeid, v);
+    }
+    if (m_built)
+    {
+        if (a_nodeid >= (int)m_dirty.size())
+        {
+            m_dirty.resize(a_nodeid + 1, false);
+            m_occupied.resize(a_nodeid + 1, false);
+        }
+        m_dirty[a_nodeid] = true;
+    }
+    return v;
+}
 
 void NodeMapping::addObject(const int a_nodeid, const int a_objid)
 {
@@ -25,6 +54,11 @@ void NodeMapping::addObject(const int a_nodeid, const int a_objid)
     a->append((void*)a_objid);
     a->sort();
 
+    std::vector<int>* v = overlay(a_nodeid);
+    v->insert(std::lower_bound(v->begin(), v->end(), a_objid), a_objid);
+    if (m_built)
+        m_occupied[a_nodeid] = true;
+
     // ------------------------------------------------------------------------
     // associate a node to an object
     // ------------------------------------------------------------------------
@@ -41,18 +75,68 @@ void NodeMapping::delObject(const int a_nodeid, const int a_objid)
     // ------------------------------------------------------------------------
     Array* a = (Array*)m_node2obj.get(a_nodeid);
     if (a != 0)
+    {
         a->remove((void*)a_objid);
 
+        std::vector<int>* v = overlay(a_nodeid);
+        v->erase(std::remove(v->begin(), v->end(), a_objid), v->end());
+        if (m_built)
+            m_occupied[a_nodeid] = !v->empty();
+    }
+
     // ------------------------------------------------------------------------
     // delete a node from an object
     // ------------------------------------------------------------------------
     m_obj2node.remove(a_objid);
 }
 
+void NodeMapping::build()
+{
+    // ------------------------------------------------------------------------
+    // the objects of the nodes in node order
+    // ------------------------------------------------------------------------
+    int nodes = 0;
+    for (HashReader rdr(m_overlay); !rdr.isEnd(); rdr.next())
+        nodes = std::max(nodes, rdr.getKey() + 1);
+    if (m_built)
+        nodes = std::max(nodes, (int)m_occupied.size());
+
+    std::vector<int> offset(nodes + 1, 0);
+    for (int n=0; n<nodes; n++)
+    {
+        const int* oid;
+        offset[n+1] = offset[n] + objects(n, oid);
+    }
+    std::vector<int> objs(offset[nodes]);
+    std::vector<bool> occupied(nodes, false);
+    for (int n=0; n<nodes; n++)
+    {
+        const int* oid;
+        const int cnt = objects(n, oid);
+        std::copy(oid, oid + cnt, objs.begin() + offset[n]);
+        occupied[n] = cnt > 0;
+    }
+
+    // ------------------------------------------------------------------------
+    // the overlay is folded in
+    // ------------------------------------------------------------------------
+    for (HashReader rdr(m_overlay); !rdr.isEnd(); rdr.next())
+        delete (std::vector<int>*)rdr.getVal();
+    m_overlay.clean();
+    m_offset.swap(offset);
+    m_objects.swap(objs);
+    m_occupied.swap(occupied);
+    m_dirty.assign(nodes, false);
+    m_built = true;
+}
+
 const Array* NodeMapping::findObject(const int a_nodeid) const
 {
     // ------------------------------------------------------------------------
     // find objects from a node
     // ------------------------------------------------------------------------
+    if (m_built && (a_nodeid < 0 || a_nodeid >= (int)m_occupied.size() ||
+        !m_occupied[a_nodeid]))
+        return 0;
     return (const Array*)m_node2obj.get(a_nodeid);
 }
@@ -8,17 +8,31 @@
 
     This file contains a class Mapping declaration.
     That maps objects to a node and vice versa
+
+    - build() lays the objects out densely for the searches: a bit per node
+      tells if it has objects, and the objects of the nodes are in one
+      array by node(CSR), so a node with none costs a bit test
+    - the nodes updated after build() are read from an overlay until the
+      next build()
 ---------------------------------------------------------------------------- */
 #ifndef nodemapping_defined
 #define nodemapping_defined
 
 #include "collection.h"
+#include <vector>
 
 class NodeMapping
 {
 public:
     Hash    m_node2obj;
     Hash    m_obj2node;
+protected:
+    bool                m_built;
+    std::vector<bool>   m_occupied;     // the node has objects
+    std::vector<bool>   m_dirty;        // updated since build(): in m_overlay
+    std::vector<int>    m_offset;       // objects of node n: m_offset[n..n+1)
+    std::vector<int>    m_objects;
+    Hash                m_overlay;      // node -> std::vector<int>* of objects
 public:
     // constructor/destructor
     NodeMapping();
@@ -27,9 +41,32 @@ public:
     // update
     void addObject(const int a_nodeid, const int a_objid);
     void delObject(const int a_nodeid, const int a_objid);
+    void build();                       // the dense layout of the objects
     //
     // search
     const Array* findObject(const int a_nodeid) const;
+    // the objects of a node: their number and a_oid(valid until an update)
+    int objects(const int a_nodeid, const int*& a_oid) const
+    {
+        if (m_built)
+        {
+            if (a_nodeid < 0 || a_nodeid >= (int)m_occupied.size() ||
+                !m_occupied[a_nodeid])
+                return 0;
+            if (!m_dirty[a_nodeid])
+            {
+                a_oid = &m_objects[m_offset[a_nodeid]];
+                return m_offset[a_nodeid+1] - m_offset[a_nodeid];
+            }
+        }
+        const std::vector<int>* v =
+            (const std::vector<int>*)m_overlay.get(a_nodeid);
+        if (v == 0 || v->empty()) return 0;
+        a_oid = &(*v)[0];
+        return v->size();
+    };
+protected:
+    std::vector<int>* overlay(const int a_nodeid);
 };
 
 #endif
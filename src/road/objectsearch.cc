@@ -11,6 +11,11 @@
 #include "edge.h"
 #include "nodemap.h"
 #include "graphplot.h"
+#include "pqueue.h"
+#include <memory>
+#include <vector>
+
+#define INFTY   1e10
 
 //-----------------------------------------------------------------------------
 // single point range search
@@ -18,53 +23,72 @@
 void ObjectSearch::rangeSearch(Graph& a_graph, NodeMapping& a_map,
                                const int a_src, const float a_range,
                                Array& a_result,
-                               int& a_nodeaccess, int& a_edgeaccess)
+                               int& a_nodeaccess, int& a_edgeaccess,
+                               const bool a_path)
+{
+    multiRangeSearch(a_graph, a_map, a_src, &a_range, 1, &a_result,
+        a_nodeaccess, a_edgeaccess, 0, a_path);
+}
+
+//-----------------------------------------------------------------------------
+// single point range search over several radii
+//-----------------------------------------------------------------------------
+void ObjectSearch::multiRangeSearch(Graph& a_graph, NodeMapping& a_map,
+                                    const int a_src, const float* a_radii,
+                                    const int a_bands, Array* a_result,
+                                    int& a_nodeaccess, int& a_edgeaccess,
+                                    Array* a_nodes, const bool a_path)
 {
     //-------------------------------------------------------------------------
     // initialization
     //-------------------------------------------------------------------------
-    a_result.clean();
+    for (int b=0; b<a_bands; b++)
+    {
+        a_result[b].clean();
+        if (a_nodes != 0) a_nodes[b].clean();
+    }
     a_nodeaccess = 0;
     a_edgeaccess = 0;
+    if (a_bands <= 0) return;
+    const float range = a_radii[a_bands-1];
+    int b = 0;                              // costs come out non-decreasing
 
     //-------------------------------------------------------------------------
     // Dijkstra's shortest path search (best first)
     //-------------------------------------------------------------------------
     Set visited(1000);
-    BinHeap h(ObjectSearchResult::compare);
-    h.insert(new ObjectSearchResult(a_src,0));
+    SearchTrail trail(a_path);
+    PQueue<SearchEntry> h(1000);
+    h.insert(SearchEntry(a_src,0,-1));
     while (!h.isEmpty())
     {
-        ObjectSearchResult* c = (ObjectSearchResult*)h.removeTop();
+        SearchEntry c = h.removeTop();
 
         //---------------------------------------------------------------------
         // Check if the node is beyond the search range. If so, terminate!!!
         //---------------------------------------------------------------------
-        if (c->m_cost > a_range)
-        {
-            delete c;
+        if (c.m_cost > range)
             break;
-        }
 
         //---------------------------------------------------------------------
         // Check if the node is visited. If so, skip it.
         //---------------------------------------------------------------------
-        if (visited.in((void*)c->m_nid))
-        {
-            delete c;
+        if (visited.in((void*)c.m_nid))
             continue;
-        }
         a_nodeaccess++;
 
-        visited.insert((void*)c->m_nid);
+        visited.insert((void*)c.m_nid);
+        b += band(&a_radii[b], a_bands-b, c.m_cost);
+        if (a_nodes != 0)
+            a_nodes[b].append((void*)c.m_nid);
+
+        const int t = trail.add(c.m_nid, c.m_prev);
 
-        Node* node = a_graph.getNode(c->m_nid);
+        Node* node = a_graph.getNode(c.m_nid);
         for (int e=0; e<node->m_edges.size(); e++)
         {
-            Edge* edge = (Edge*)node->m_edges.get(e);
-            h.insert(
-                new ObjectSearchResult(edge->m_neighbor, c->m_path,
-                c->m_cost + edge->m_cost));
+            Edge* edge = &node->m_edges[e];
+            h.insert(SearchEntry(edge->m_neighbor, c.m_cost + edge->m_cost, t));
             a_edgeaccess++;
         }
         delete node;
@@ -72,22 +96,17 @@ void ObjectSearch::rangeSearch(Graph& a_graph, NodeMapping& a_map,
         // --------------------------------------------------------------------
         // check if object is found
         // --------------------------------------------------------------------
-        const Array* objs = a_map.findObject(c->m_nid);
-        if (objs != 0)
+        const int* oid;
+        const int cnt = a_map.objects(c.m_nid, oid);
+        if (cnt > 0)
         {
-            c->addObjects(*objs);
-            a_result.append(c);
+            ObjectSearchResult* res =
+                new ObjectSearchResult(c.m_nid, trail, c.m_prev, c.m_cost);
+            res->addObjects(oid, cnt);
+            a_result[b].append(res);
         }
-        else
-            delete c;
     }
 
-    // ------------------------------------------------------------------------
-    // clean up
-    // ------------------------------------------------------------------------
-    while (!h.isEmpty())
-        delete (ObjectSearchResult*)h.removeTop();
-
     // ------------------------------------------------------------------------
     // all done
     // ------------------------------------------------------------------------
@@ -101,7 +120,8 @@ void ObjectSearch::rangeSearch(Graph& a_graph, NodeMapping& a_map,
 void ObjectSearch::kNNSearch(Graph& a_graph, NodeMapping& a_map,
                                const int a_src, const int k,
                                Array& a_result,
-                               int& a_nodeaccess, int& a_edgeaccess)
+                               int& a_nodeaccess, int& a_edgeaccess,
+                               const bool a_path)
 {
     //-------------------------------------------------------------------------
     // initialization
@@ -115,31 +135,29 @@ void ObjectSearch::kNNSearch(Graph& a_graph, NodeMapping& a_map,
     // Dijkstra's shortest path search (best first)
     //-------------------------------------------------------------------------
     Set visited(1000);
-    BinHeap h(ObjectSearchResult::compare);
-    h.insert(new ObjectSearchResult(a_src,0));
+    SearchTrail trail(a_path);
+    PQueue<SearchEntry> h(1000);
+    h.insert(SearchEntry(a_src,0,-1));
     while (!h.isEmpty())
     {
-        ObjectSearchResult* c = (ObjectSearchResult*)h.removeTop();
+        SearchEntry c = h.removeTop();
 
         //---------------------------------------------------------------------
         // Check if the node is visited. If so, skip it.
         //---------------------------------------------------------------------
-        if (visited.in((void*)c->m_nid))
-        {
-            delete c;
+        if (visited.in((void*)c.m_nid))
             continue;
-        }
         a_nodeaccess++;
 
-        visited.insert((void*)c->m_nid);
+        visited.insert((void*)c.m_nid);
+
+        const int t = trail.add(c.m_nid, c.m_prev);
 
-        Node* node = a_graph.getNode(c->m_nid);
+        Node* node = a_graph.getNode(c.m_nid);
         for (int e=0; e<node->m_edges.size(); e++)
         {
-            Edge* edge = (Edge*)node->m_edges.get(e);
-            h.insert(
-                new ObjectSearchResult(edge->m_neighbor, c->m_path,
-                c->m_cost + edge->m_cost));
+            Edge* edge = &node->m_edges[e];
+            h.insert(SearchEntry(edge->m_neighbor, c.m_cost + edge->m_cost, t));
             a_edgeaccess++;
         }
         delete node;
@@ -147,27 +165,20 @@ void ObjectSearch::kNNSearch(Graph& a_graph, NodeMapping& a_map,
         // --------------------------------------------------------------------
         // check if object is found
         // --------------------------------------------------------------------
-        const Array* objs = a_map.findObject(c->m_nid);
-        if (objs != 0)
+        const int* oid;
+        const int cnt = a_map.objects(c.m_nid, oid);
+        if (cnt > 0)
         {
-            c->addObjects(*objs);
-            a_result.append(c);
-            rescnt += objs->size();
+            ObjectSearchResult* res =
+                new ObjectSearchResult(c.m_nid, trail, c.m_prev, c.m_cost);
+            res->addObjects(oid, cnt);
+            a_result.append(res);
+            rescnt += cnt;
             if (rescnt >= k)   // once k objects are found, terminate!
                 break;
         }
-        else
-        {
-            delete c;
-        }
     }
 
-    // ------------------------------------------------------------------------
-    // clean up
-    // ------------------------------------------------------------------------
-    while (!h.isEmpty())
-        delete (ObjectSearchResult*)h.removeTop();
-
     // ------------------------------------------------------------------------
     // all done
     // ------------------------------------------------------------------------
@@ -197,32 +208,30 @@ void ObjectSearch::kNNSearch(Graph& a_graph, NodeMapping& a_map,
     // Dijkstra's shortest path search (best first)
     //-------------------------------------------------------------------------
     Set visited(1000);
-    BinHeap h(ObjectSearchResult::compare);
-    h.insert(new ObjectSearchResult(a_src,0));
+    SearchTrail trail;
+    PQueue<SearchEntry> h(1000);
+    h.insert(SearchEntry(a_src,0,-1));
     while (!h.isEmpty())
     {
-        ObjectSearchResult* c = (ObjectSearchResult*)h.removeTop();
+        SearchEntry c = h.removeTop();
 
         //---------------------------------------------------------------------
         // Check if the node is visited. If so, skip it.
         //---------------------------------------------------------------------
-        if (visited.in((void*)c->m_nid))
-        {
-            delete c;
+        if (visited.in((void*)c.m_nid))
             continue;
-        }
         a_nodeaccess++;
 
-        visited.insert((void*)c->m_nid);
-        a_visited.append((void*)c->m_nid);
+        visited.insert((void*)c.m_nid);
+
+        const int t = trail.add(c.m_nid, c.m_prev);
+        a_visited.append((void*)c.m_nid);
 
-        Node* node = a_graph.getNode(c->m_nid);
+        Node* node = a_graph.getNode(c.m_nid);
         for (int e=0; e<node->m_edges.size(); e++)
         {
-            Edge* edge = (Edge*)node->m_edges.get(e);
-            h.insert(
-                new ObjectSearchResult(edge->m_neighbor, c->m_path,
-                c->m_cost + edge->m_cost));
+            Edge* edge = &node->m_edges[e];
+            h.insert(SearchEntry(edge->m_neighbor, c.m_cost + edge->m_cost, t));
             a_edgeaccess++;
         }
         delete node;
@@ -230,33 +239,89 @@ void ObjectSearch::kNNSearch(Graph& a_graph, NodeMapping& a_map,
         // --------------------------------------------------------------------
         // check if object is found
         // --------------------------------------------------------------------
-        const Array* objs = a_map.findObject(c->m_nid);
-        if (objs != 0)
+        const int* oid;
+        const int cnt = a_map.objects(c.m_nid, oid);
+        if (cnt > 0)
         {
-            c->addObjects(*objs);
-            a_result.append(c);
-            rescnt += objs->size();
+            ObjectSearchResult* res =
+                new ObjectSearchResult(c.m_nid, trail, c.m_prev, c.m_cost);
+            res->addObjects(oid, cnt);
+            a_result.append(res);
+            rescnt += cnt;
             if (rescnt >= k)   // once k objects are found, terminate!
                 break;
         }
-        else
-        {
-            delete c;
-        }
     }
 
-    // ------------------------------------------------------------------------
-    // clean up
-    // ------------------------------------------------------------------------
-    while (!h.isEmpty())
-        delete (ObjectSearchResult*)h.removeTop();
-
     // ------------------------------------------------------------------------
     // all done
     // ------------------------------------------------------------------------
     return;
 }
 
+//-----------------------------------------------------------------------------
+// network expansion from one query point of a group, run a batch at a time:
+// the objects it reaches are kept for the caller to take
+//-----------------------------------------------------------------------------
+class GroupExpansion
+{
+public:
+    Graph&                      m_graph;
+    NodeMapping&                m_map;
+    Set                         m_visited;
+    SearchTrail                 m_trail;
+    PQueue<SearchEntry>         m_heap;
+    std::vector<SearchEntry>    m_found;    // objects reached(m_prev: trail index)
+    float                       m_range;    // nodes beyond are not expanded
+    int                         m_nodeaccess;
+    int                         m_edgeaccess;
+public:
+    GroupExpansion(Graph& a_graph, NodeMapping& a_map, const int a_src,
+                   const float a_range=INFTY):
+        m_graph(a_graph), m_map(a_map), m_visited(1000), m_heap(1000),
+        m_range(a_range), m_nodeaccess(0), m_edgeaccess(0)
+    {
+        m_heap.insert(SearchEntry(a_src,0,-1));
+    };
+    // the cost of any node not expanded yet is at least this
+    float frontier() const
+    {
+        return m_heap.isEmpty() ? INFTY : m_heap.top().m_cost;
+    };
+    // expand a_nodes nodes at most(-1: all in range)
+    void expand(const int a_nodes)
+    {
+        for (int n=0; !m_heap.isEmpty() && n!=a_nodes; )
+        {
+            SearchEntry c = m_heap.removeTop();
+            if (c.m_cost > m_range)
+            {
+                m_heap.clean();
+                break;
+            }
+            if (m_visited.in((void*)c.m_nid))
+                continue;
+            m_visited.insert((void*)c.m_nid);
+            m_nodeaccess++;
+            n++;
+            const int t = m_trail.add(c.m_nid, c.m_prev);
+
+            std::shared_ptr<const Node> node = m_graph.getSharedNode(c.m_nid);
+            for (int e=0; e<node->m_edges.size(); e++)
+            {
+                const Edge* edge = &node->m_edges[e];
+                m_heap.insert(SearchEntry(edge->m_neighbor, c.m_cost+edge->m_cost, t));
+                m_edgeaccess++;
+            }
+
+            const int* oids;
+            const int cnt = m_map.objects(c.m_nid, oids);
+            for (int j=0; j<cnt; j++)
+                m_found.push_back(SearchEntry(c.m_nid, c.m_cost, t, oids[j]));
+        }
+    };
+};
+
 //-----------------------------------------------------------------------------
 // multiple point range search
 //-----------------------------------------------------------------------------
@@ -264,262 +329,64 @@ void ObjectSearch::groupRangeSearch(Graph& a_graph, NodeMapping& a_map,
                                     const int* a_src, const float* a_range,
                                     const int a_cnt,
                                     Array& a_result,
-                                    int& a_nodeaccess, int& a_edgeaccess)
+                                    int& a_nodeaccess, int& a_edgeaccess,
+                                    const int a_threads)
 {
     // ------------------------------------------------------------------------
-    // local data structures:
-    //  carrier - node to be explored next and to be stored in priority queue
+    // expand from the query points, each up to its range
     // ------------------------------------------------------------------------
-    class carrier
+    std::vector<GroupExpansion*> exp(a_cnt);
+    for (int i=0; i<a_cnt; i++)
+        exp[i] = new GroupExpansion(a_graph, a_map, a_src[i], a_range[i]);
+    SegMemory* mem = &a_graph.memory();
+    forEachQuery(a_threads, a_cnt, &mem, 1, [&](int i)
     {
-    public:
-        const int   m_q;        // about which query (q)
-        const int   m_node;     // node to be explored
-        const float m_cost;     // distance from the source of q
-        Array       m_path;     // shortest path from q
-    public:
-        carrier(const int a_q, const int a_node, const float a_cost):
-            m_q(a_q), m_node(a_node), m_cost(a_cost)
-            {
-                m_path.append((void*)a_node);
-            };
-        carrier(const int a_q, const int a_node,
-            const float a_cost, Array& a_path):
-            m_q(a_q), m_node(a_node), m_cost(a_cost), m_path(a_path)
-            {
-                m_path.append((void*)a_node);
-            };
-        virtual ~carrier(){};
-        static int compare(const void* a0, const void* a1)
-        {
-            carrier* n0 = *(carrier**)a0;
-            carrier* n1 = *(carrier**)a1;
-            if (n0->m_cost < n1->m_cost) return -1;
-            if (n0->m_cost > n1->m_cost) return +1;
-            if (n0->m_q < n1->m_q) return -1;
-            if (n0->m_q > n1->m_q) return +1;
-            if (n0->m_node < n1->m_node) return -1;
-            if (n0->m_node > n1->m_node) return -1;
-            return 0;
-        }
-    };
+        exp[i]->expand(-1);
+    });
 
     // ------------------------------------------------------------------------
-    // initialization
+    // the objects reached from all
     // ------------------------------------------------------------------------
     Hash objects;
-
-    Array src[MAXQUERY], dest[MAXQUERY];
-    Set visited[MAXQUERY];
-    BinHeap h(carrier::compare);
-    for (int i=0; i<a_cnt; i++)
-        h.insert(new carrier(i, a_src[i], 0));
-
-    while (!h.isEmpty())
-    {
-        carrier* c = (carrier*)h.removeTop();
-        
-        // --------------------------------------------------------------------
-        // if the node from a corresponding query is farther than a threshold,
-        // skip it!
-        // --------------------------------------------------------------------
-        if (c->m_cost > a_range[c->m_q])
-        {
-            delete c;
-            continue;
-        }
-
-        // --------------------------------------------------------------------
-        // if the node is visited by a corresponding query, skip it!
-        // --------------------------------------------------------------------
-        if (visited[c->m_q].in((void*)c->m_node))
-        {
-            delete c;
-            continue;
-        }
-
-        // --------------------------------------------------------------------
-        // exploring the node
-        // --------------------------------------------------------------------
-        a_nodeaccess++;
-        visited[c->m_q].insert((void*)c->m_node);
-
-        Node* node = a_graph.getNode(c->m_node);
-        for (int e=0; e<node->m_edges.size(); e++)
-        {
-            Edge* edge = (Edge*)node->m_edges.get(e);
-            h.insert(
-                new carrier(c->m_q, edge->m_neighbor, c->m_cost+edge->m_cost, c->m_path));
-            src[c->m_q].append((void*)c->m_node);
-            dest[c->m_q].append((void*)edge->m_neighbor);
-            a_edgeaccess++;
-        }
-        delete node;
-
-        // --------------------------------------------------------------------
-        // keep the asscoiated objects if any
-        // --------------------------------------------------------------------
-        const Array* objs = a_map.findObject(c->m_node);
-        for (int j=0; objs!=0 && j<objs->size(); j++)
-        {
-            int oid = (long)objs->get(j);
-            GroupObjectSearchResult* obj =
-                (GroupObjectSearchResult*)objects.get(oid);
-            if (obj == 0)
-                objects.put(oid, obj =
-                new GroupObjectSearchResult(c->m_node, oid, a_cnt));
-            obj->m_cost[c->m_q] = c->m_cost;
-            obj->m_path[c->m_q].copy(c->m_path);
-        }
-
-        delete c;
-    }
-
-    //GraphPlot::plot("c:\\objectsearch.ps", a_graph,
-    //    src[0], dest[0], src[1], dest[1], a_src[0], a_src[1]);
+    Array done;
+    groupCollect(exp, GROUP_MAX, objects, done);
+    done.sort(GroupObjectSearchResult::compare);
+    for (int i=0; i<done.size(); i++)
+        a_result.append(done.get(i));
 
     for (HashReader rdr(objects); !rdr.isEnd(); rdr.next())
+        delete (GroupObjectSearchResult*)rdr.getVal();
+    objects.clean();
+    for (int i=0; i<a_cnt; i++)
     {
-        GroupObjectSearchResult* obj = (GroupObjectSearchResult*)rdr.getVal();
-        bool reachedByAll = true;
-        for (int i=0; i<a_cnt && reachedByAll; i++)
-            reachedByAll = (obj->m_cost[i] != -1);
-        if (reachedByAll)
-            a_result.append(obj);
-        else
-            delete obj;
+        a_nodeaccess += exp[i]->m_nodeaccess;
+        a_edgeaccess += exp[i]->m_edgeaccess;
+        delete exp[i];
     }
-    objects.clean();
 }
 
 //-----------------------------------------------------------------------------
 // multiple point kNN search
+// (a threshold algorithm over the expansions, see groupThreshold)
 //-----------------------------------------------------------------------------
 void ObjectSearch::groupKNNSearch(Graph& a_graph, NodeMapping& a_map,
                                   const int* a_src, const int a_cnt,
                                   const int a_k,
                                   Array& a_result,
-                                  int& a_nodeaccess, int& a_edgeaccess)
+                                  int& a_nodeaccess, int& a_edgeaccess,
+                                  const int a_agg, const int a_threads)
 {
-    // ------------------------------------------------------------------------
-    // local data structures:
-    //  carrier - node to be explored next and to be stored in priority queue
-    // ------------------------------------------------------------------------
-    class carrier
-    {
-    public:
-        const int   m_q;        // about which query (q)
-        const int   m_node;     // node to be explored
-        const float m_cost;     // distance from the source of q
-        Array       m_path;     // shortest path from q
-    public:
-        carrier(const int a_q, const int a_node, const float a_cost):
-            m_q(a_q), m_node(a_node), m_cost(a_cost)
-            {
-                m_path.append((void*)a_node);
-            };
-        carrier(const int a_q, const int a_node,
-            const float a_cost, Array& a_path):
-            m_q(a_q), m_node(a_node), m_cost(a_cost), m_path(a_path)
-            {
-                m_path.append((void*)a_node);
-            };
-        virtual ~carrier(){};
-        static int compare(const void* a0, const void* a1)
-        {
-            carrier* n0 = *(carrier**)a0;
-            carrier* n1 = *(carrier**)a1;
-            if (n0->m_cost < n1->m_cost) return -1;
-            if (n0->m_cost > n1->m_cost) return +1;
-            if (n0->m_q < n1->m_q) return -1;
-            if (n0->m_q > n1->m_q) return +1;
-            if (n0->m_node < n1->m_node) return -1;
-            if (n0->m_node > n1->m_node) return -1;
-            return 0;
-        }
-    };
-
-    // ------------------------------------------------------------------------
-    // initialization
-    // ------------------------------------------------------------------------
-    Hash objects;
-
-    Set visited[MAXQUERY];
-    BinHeap h(carrier::compare);
+    std::vector<GroupExpansion*> exp(a_cnt);
     for (int i=0; i<a_cnt; i++)
-        h.insert(new carrier(i, a_src[i], 0));
+        exp[i] = new GroupExpansion(a_graph, a_map, a_src[i]);
+    groupThreshold(exp, a_k, a_agg, a_threads, &a_graph.memory(), a_result);
 
-    while (!h.isEmpty())
-    {
-        carrier* c = (carrier*)h.removeTop();
-        
-        // --------------------------------------------------------------------
-        // if k answer objects are found, terminate
-        // --------------------------------------------------------------------
-        if (a_result.size() >= a_k)
-        {
-            delete c;
-            continue;
-        }
-
-        // --------------------------------------------------------------------
-        // if the node is visited by a corresponding query, skip it!
-        // --------------------------------------------------------------------
-        if (visited[c->m_q].in((void*)c->m_node))
-        {
-            delete c;
-            continue;
-        }
-
-        // --------------------------------------------------------------------
-        // exploring the node
-        // --------------------------------------------------------------------
-        a_nodeaccess++;
-        visited[c->m_q].insert((void*)c->m_node);
-
-        Node* node = a_graph.getNode(c->m_node);
-        for (int e=0; e<node->m_edges.size(); e++)
-        {
-            Edge* edge = (Edge*)node->m_edges.get(e);
-            h.insert(
-                new carrier(c->m_q, edge->m_neighbor, c->m_cost+edge->m_cost, c->m_path));
-            a_edgeaccess++;
-        }
-        delete node;
-
-        // --------------------------------------------------------------------
-        // keep the asscoiated objects if any
-        // --------------------------------------------------------------------
-        const Array* objs = a_map.findObject(c->m_node);
-        for (int j=0; objs!=0 && j<objs->size(); j++)
-        {
-            int oid = (long)objs->get(j);
-            GroupObjectSearchResult* obj =
-                (GroupObjectSearchResult*)objects.get(oid);
-            if (obj == 0)
-                objects.put(oid, obj =
-                new GroupObjectSearchResult(c->m_node, oid, a_cnt));
-            obj->m_cost[c->m_q] = c->m_cost;
-            obj->m_path[c->m_q].copy(c->m_path);
-            if (obj->allreached(a_cnt))
-            {
-                a_result.append(obj);
-                objects.remove(oid);
-            }
-        }
-
-        delete c;
-    }
-
-    // ------------------------------------------------------------------------
-    // clean up
-    // ------------------------------------------------------------------------
-    for (HashReader rdr(objects); !rdr.isEnd(); rdr.next())
+    for (int i=0; i<a_cnt; i++)
     {
-        GroupObjectSearchResult* obj = (GroupObjectSearchResult*)rdr.getVal();
-        delete obj;
+        a_nodeaccess += exp[i]->m_nodeaccess;
+        a_edgeaccess += exp[i]->m_edgeaccess;
+        delete exp[i];
     }
-    objects.clean();
 }
 
 void ObjectSearch::groupKNNSearch(Graph& a_graph, NodeMapping& a_map,
@@ -536,35 +403,21 @@ void ObjectSearch::groupKNNSearch(Graph& a_graph, NodeMapping& a_map,
     class carrier
     {
     public:
-        const int   m_q;        // about which query (q)
-        const int   m_node;     // node to be explored
-        const float m_cost;     // distance from the source of q
-        Array       m_path;     // shortest path from q
+        int     m_q;        // about which query (q)
+        int     m_node;     // node to be explored
+        float   m_cost;     // distance from the source of q
+        int     m_prev;     // trail index of the node it came from
     public:
-        carrier(const int a_q, const int a_node, const float a_cost):
-            m_q(a_q), m_node(a_node), m_cost(a_cost)
-            {
-                m_path.append((void*)a_node);
-            };
-        carrier(const int a_q, const int a_node,
-            const float a_cost, Array& a_path):
-            m_q(a_q), m_node(a_node), m_cost(a_cost), m_path(a_path)
-            {
-                m_path.append((void*)a_node);
-            };
-        virtual ~carrier(){};
-        static int compare(const void* a0, const void* a1)
+        carrier() {};
+        carrier(const int a_q, const int a_node, const float a_cost,
+            const int a_prev=-1):
+            m_q(a_q), m_node(a_node), m_cost(a_cost), m_prev(a_prev) {};
+        bool operator<(const carrier& a_c) const
         {
-            carrier* n0 = *(carrier**)a0;
-            carrier* n1 = *(carrier**)a1;
-            if (n0->m_cost < n1->m_cost) return -1;
-            if (n0->m_cost > n1->m_cost) return +1;
-            if (n0->m_q < n1->m_q) return -1;
-            if (n0->m_q > n1->m_q) return +1;
-            if (n0->m_node < n1->m_node) return -1;
-            if (n0->m_node > n1->m_node) return -1;
-            return 0;
-        }
+            if (m_cost != a_c.m_cost) return m_cost < a_c.m_cost;
+            if (m_q != a_c.m_q) return m_q < a_c.m_q;
+            return m_node < a_c.m_node;
+        };
     };
 
     // ------------------------------------------------------------------------
@@ -572,46 +425,41 @@ void ObjectSearch::groupKNNSearch(Graph& a_graph, NodeMapping& a_map,
     // ------------------------------------------------------------------------
     Hash objects;
 
-    Set visited[MAXQUERY];
-    BinHeap h(carrier::compare);
+    std::vector<Set> visited(a_cnt);
+    SearchTrail trail;
+    PQueue<carrier> h(1000);
     for (int i=0; i<a_cnt; i++)
-        h.insert(new carrier(i, a_src[i], 0));
+        h.insert(carrier(i, a_src[i], 0));
 
     while (!h.isEmpty())
     {
-        carrier* c = (carrier*)h.removeTop();
-        
+        carrier c = h.removeTop();
+
         // --------------------------------------------------------------------
         // if k answer objects are found, terminate
         // --------------------------------------------------------------------
         if (a_result.size() >= a_k)
-        {
-            delete c;
-            continue;
-        }
+            break;
 
         // --------------------------------------------------------------------
         // if the node is visited by a corresponding query, skip it!
         // --------------------------------------------------------------------
-        if (visited[c->m_q].in((void*)c->m_node))
-        {
-            delete c;
+        if (visited[c.m_q].in((void*)c.m_node))
             continue;
-        }
 
         // --------------------------------------------------------------------
         // exploring the node
         // --------------------------------------------------------------------
         a_nodeaccess++;
-        visited[c->m_q].insert((void*)c->m_node);
-        a_visited.append((void*)c->m_node);
+        visited[c.m_q].insert((void*)c.m_node);
+        const int t = trail.add(c.m_node, c.m_prev);
+        a_visited.append((void*)c.m_node);
 
-        Node* node = a_graph.getNode(c->m_node);
+        Node* node = a_graph.getNode(c.m_node);
         for (int e=0; e<node->m_edges.size(); e++)
         {
-            Edge* edge = (Edge*)node->m_edges.get(e);
-            h.insert(
-                new carrier(c->m_q, edge->m_neighbor, c->m_cost+edge->m_cost, c->m_path));
+            Edge* edge = &node->m_edges[e];
+            h.insert(carrier(c.m_q, edge->m_neighbor, c.m_cost+edge->m_cost, t));
             a_edgeaccess++;
         }
         delete node;
@@ -619,25 +467,26 @@ void ObjectSearch::groupKNNSearch(Graph& a_graph, NodeMapping& a_map,
         // --------------------------------------------------------------------
         // keep the asscoiated objects if any
         // --------------------------------------------------------------------
-        const Array* objs = a_map.findObject(c->m_node);
-        for (int j=0; objs!=0 && j<objs->size(); j++)
+        const int* oids;
+        const int cnt = a_map.objects(c.m_node, oids);
+        for (int j=0; j<cnt; j++)
         {
-            int oid = (long)objs->get(j);
+            int oid = oids[j];
             GroupObjectSearchResult* obj =
                 (GroupObjectSearchResult*)objects.get(oid);
             if (obj == 0)
                 objects.put(oid, obj =
-                new GroupObjectSearchResult(c->m_node, oid, a_cnt));
-            obj->m_cost[c->m_q] = c->m_cost;
-            obj->m_path[c->m_q].copy(c->m_path);
+                new GroupObjectSearchResult(c.m_node, oid, a_cnt));
+            obj->m_cost[c.m_q] = c.m_cost;
+            obj->m_path[c.m_q].clean();
+            trail.path(t, obj->m_path[c.m_q]);
             if (obj->allreached(a_cnt))
             {
-                a_result.append(obj);
+                if (a_result.size() < a_k) a_result.append(obj);
+                else delete obj;    // ties at the kth are cut
                 objects.remove(oid);
             }
         }
-
-        delete c;
     }
 
     // ------------------------------------------------------------------------
@@ -11,31 +11,45 @@
 #define objectsearch_defined
 
 #include "collection.h"
+#include "searchtrail.h"
+#include "segmem.h"
+#include "../common/task_pool.h"
 class Graph;
 class NodeMapping;
 
-#define MAXQUERY    10
+// aggregate cost of an object to a group of query points
+#define GROUP_MAX   0       // the farthest of the points
+#define GROUP_SUM   1       // the total over the points
 
 class ObjectSearchResult
 {
 public:
     const int   m_nid;
     const float m_cost;
-    Array       m_path;
+    NodePath    m_path;
     Array       m_objects;
 public:
     ObjectSearchResult(const int a_nid, const float a_cost):
         m_nid(a_nid), m_cost(a_cost)
-        { m_path.append((void*)m_nid); };
-    ObjectSearchResult(const int a_nid, const Array& a_path, const float a_cost):
+        { m_path.append(m_nid); };
+    ObjectSearchResult(const int a_nid, const NodePath& a_path, const float a_cost):
         m_nid(a_nid), m_path(a_path), m_cost(a_cost)
-        { m_path.append((void*)m_nid); };
+        { m_path.append(m_nid); };
+    ObjectSearchResult(const int a_nid, const SearchTrail& a_trail,
+                       const int a_prev, const float a_cost):
+        m_nid(a_nid), m_cost(a_cost)
+        { a_trail.path(a_prev, m_path); m_path.append(m_nid); };
     ~ObjectSearchResult()
         { m_path.clean(); };
     void addObjects(const Array& a_objs)
     {
         for (int i=0; i<a_objs.size(); i++)
-            m_objects.append(m_objects.get(i));
+            m_objects.append(a_objs.get(i));
+    }
+    void addObjects(const int* a_oid, const int a_cnt)
+    {
+        for (int i=0; i<a_cnt; i++)
+            m_objects.append((void*)a_oid[i]);
     }
     static int compare(const void* a0, const void* a1)
     {
@@ -52,24 +66,34 @@ class GroupObjectSearchResult
 public:
     const int   m_oid;
     int         m_nid;
-    float       m_cost[MAXQUERY];
-    Array       m_path[MAXQUERY];
+    const int   m_cnt;      // #query points
+    const int   m_agg;      // GROUP_MAX or GROUP_SUM
+    float*      m_cost;     // per query point, -1 if not reached
+    NodePath*   m_path;     // per query point
 public:
-    GroupObjectSearchResult(const int a_nid, const int a_oid, const int a_cnt):
-        m_nid(a_nid), m_oid(a_oid)
+    GroupObjectSearchResult(const int a_nid, const int a_oid, const int a_cnt,
+                            const int a_agg=GROUP_MAX):
+        m_oid(a_oid), m_nid(a_nid), m_cnt(a_cnt), m_agg(a_agg),
+        m_cost(new float[a_cnt]), m_path(new NodePath[a_cnt])
         {
-            for (int i=0; i<a_cnt+1; i++)   // initialize the cost to -1
+            for (int i=0; i<a_cnt; i++)     // initialize the cost to -1
                 m_cost[i] = -1;             // to signal the object is not
                                             // found currently
         };
-    ~GroupObjectSearchResult(){};
+    ~GroupObjectSearchResult()
+    {
+        delete[] m_cost;
+        delete[] m_path;
+    };
+    // the aggregate cost(of the costs up to the first point not reached)
     float sumcost() const
     {
         float ret = 0;
-        for (int i=0; i<MAXQUERY; i++)
+        for (int i=0; i<m_cnt; i++)
         {
             if (m_cost[i] == -1) break;
-            ret = ret > m_cost[i] ? ret : m_cost[i];
+            if (m_agg == GROUP_SUM) ret += m_cost[i];
+            else ret = ret > m_cost[i] ? ret : m_cost[i];
         }
         return ret;
     };
@@ -91,8 +115,156 @@ public:
         if (r0->m_oid > r1->m_oid) return +1;
         return 0;
     };
+private:
+    GroupObjectSearchResult(const GroupObjectSearchResult&);
+    GroupObjectSearchResult& operator=(const GroupObjectSearchResult&);
 };
 
+// ----------------------------------------------------------------------------
+// runs a_fn(i) for the a_cnt query points of a group on a_threads threads:
+// each thread reads the a_memcnt memories with its own access history, and
+// the histories are appended to those of the calling thread at the end
+// (point by point, so the result does not depend on the schedule)
+// ----------------------------------------------------------------------------
+template<class F>
+void forEachQuery(const int a_threads, const int a_cnt,
+                  SegMemory* const* a_mem, const int a_memcnt, F a_fn)
+{
+    if (a_threads <= 1 || a_cnt <= 1)
+    {
+        for (int i=0; i<a_cnt; i++)
+            a_fn(i);
+        return;
+    }
+    std::vector<Access> history(a_cnt * a_memcnt);
+    parallel_for(a_threads, a_cnt, [&](int a_worker, int i)
+    {
+        for (int m=0; m<a_memcnt; m++)
+            a_mem[m]->bindHistory(&history[i*a_memcnt + m]);
+        a_fn(i);
+        for (int m=0; m<a_memcnt; m++)
+            a_mem[m]->bindHistory(0);
+    });
+    for (int i=0; i<a_cnt; i++)
+        for (int m=0; m<a_memcnt; m++)
+            a_mem[m]->history().append(history[i*a_memcnt + m]);
+}
+
+// ----------------------------------------------------------------------------
+// group kNN search over the expansions from its query points, one each(as
+// ObjectSearch's GroupExpansion). an expansion keeps
+//  m_heap      - nodes to expand(m_heap.isEmpty() once exhausted)
+//  m_trail     - the nodes expanded
+//  m_found     - objects reached since last taken(m_prev: trail index)
+//  m_range     - nodes beyond are not expanded
+//  expand(n)   - expands n nodes at most
+//  frontier()  - the cost of any node not expanded yet is at least this
+// ----------------------------------------------------------------------------
+inline float groupAggregate(const float a_c0, const float a_c1, const int a_agg)
+{
+    if (a_agg == GROUP_SUM) return a_c0 + a_c1;
+    return a_c0 > a_c1 ? a_c0 : a_c1;
+}
+
+// takes the objects the expansions reached: an object reached from all the
+// query points moves to a_done
+template<class E>
+void groupCollect(std::vector<E*>& a_exp, const int a_agg,
+                  Hash& a_objects, Array& a_done)
+{
+    const int cnt = a_exp.size();
+    for (int q=0; q<cnt; q++)
+    {
+        for (int j=0; j<(int)a_exp[q]->m_found.size(); j++)
+        {
+            const SearchEntry& f = a_exp[q]->m_found[j];
+            GroupObjectSearchResult* obj =
+                (GroupObjectSearchResult*)a_objects.get(f.m_oid);
+            if (obj == 0)
+                a_objects.put(f.m_oid, obj =
+                new GroupObjectSearchResult(f.m_nid, f.m_oid, cnt, a_agg));
+            obj->m_cost[q] = f.m_cost;
+            obj->m_path[q].clean();
+            a_exp[q]->m_trail.path(f.m_prev, obj->m_path[q]);
+            if (obj->allreached(cnt))
+            {
+                a_done.append(obj);
+                a_objects.remove(f.m_oid);
+            }
+        }
+        a_exp[q]->m_found.clear();
+    }
+}
+
+// the expansions are sorted accesses of a threshold algorithm: they run in
+// rounds(on a_threads threads), and after a round an object not reached from
+// all costs at least its aggregate with the frontier of each expansion that
+// has not reached it. the search stops when k objects reached from all cost
+// no more than that; no expansion goes beyond the kth of them. a_result gets
+// the k least by cost, then object id(ties at the kth are cut)
+template<class E>
+void groupThreshold(std::vector<E*>& a_exp, const int a_k, const int a_agg,
+                    const int a_threads, SegMemory* a_mem, Array& a_result)
+{
+    const int cnt = a_exp.size();
+    Hash objects;       // objects reached from some
+    Array done;         // objects reached from all
+    for (int batch=64; ; batch*=2)
+    {
+        forEachQuery(a_threads, cnt, &a_mem, 1, [&](int i)
+        {
+            a_exp[i]->expand(batch);
+        });
+        groupCollect(a_exp, a_agg, objects, done);
+
+        // --------------------------------------------------------------------
+        // threshold: the least cost of the objects not reached from all
+        // --------------------------------------------------------------------
+        bool exhausted = true;
+        float threshold = 0;
+        for (int i=0; i<cnt; i++)
+        {
+            exhausted = exhausted && a_exp[i]->m_heap.isEmpty();
+            threshold = groupAggregate(threshold, a_exp[i]->frontier(), a_agg);
+        }
+        for (HashReader rdr(objects); !rdr.isEnd(); rdr.next())
+        {
+            GroupObjectSearchResult* obj = (GroupObjectSearchResult*)rdr.getVal();
+            float bound = 0;
+            for (int i=0; i<cnt; i++)
+                bound = groupAggregate(bound,
+                    obj->m_cost[i] != -1 ? obj->m_cost[i] : a_exp[i]->frontier(),
+                    a_agg);
+            threshold = threshold < bound ? threshold : bound;
+        }
+
+        // --------------------------------------------------------------------
+        // if k answer objects are found, terminate
+        // --------------------------------------------------------------------
+        done.sort(GroupObjectSearchResult::compare);
+        if (exhausted)
+            break;
+        if (done.size() >= a_k)
+        {
+            // an object farther from any point than the kth in all is out
+            const float kth = ((GroupObjectSearchResult*)done.get(a_k-1))->sumcost();
+            if (kth <= threshold)
+                break;
+            for (int i=0; i<cnt; i++)
+                a_exp[i]->m_range = kth;
+        }
+    }
+
+    for (int i=0; i<done.size(); i++)
+    {
+        if (i < a_k) a_result.append(done.get(i));
+        else delete (GroupObjectSearchResult*)done.get(i);
+    }
+    for (HashReader rdr(objects); !rdr.isEnd(); rdr.next())
+        delete (GroupObjectSearchResult*)rdr.getVal();
+    objects.clean();
+}
+
 class ObjectSearch
 {
 public:
@@ -102,15 +274,38 @@ public:
     static void rangeSearch(
         Graph& a_graph, NodeMapping& a_map,
         const int a_src, const float a_range,
-        Array& a_result, int& a_nodeaccess, int& a_edgeaccess);
+        Array& a_result, int& a_nodeaccess, int& a_edgeaccess,
+        const bool a_path=true);
+
+    // ------------------------------------------------------------------------
+    // single-point range search over several radii in one expansion
+    // (a_radii ascending; an object at cost c goes to a_result[b] of the
+    // first band b with c <= a_radii[b]; if a_nodes is given, a_nodes[b]
+    // collects the ids of nodes reached in band b, i.e. the isochrones)
+    // ------------------------------------------------------------------------
+    static void multiRangeSearch(
+        Graph& a_graph, NodeMapping& a_map,
+        const int a_src, const float* a_radii, const int a_bands,
+        Array* a_result, int& a_nodeaccess, int& a_edgeaccess,
+        Array* a_nodes=0, const bool a_path=true);
+    // the first band whose radius covers a cost, a_bands if none does
+    static int band(const float* a_radii, const int a_bands, const float a_cost)
+    {
+        int b = 0;
+        while (b < a_bands && a_cost > a_radii[b])
+            b++;
+        return b;
+    };
 
     // ------------------------------------------------------------------------
     // single-point kNN search
+    // (a_path false for results with no path: no trail is kept)
     // ------------------------------------------------------------------------
     static void kNNSearch(
         Graph& a_graph, NodeMapping& a_map,
         const int a_src, const int k,
-        Array& a_result,int& nodeaccess, int& edgeaccess);
+        Array& a_result,int& nodeaccess, int& edgeaccess,
+        const bool a_path=true);
     static void kNNSearch(
         Graph& a_graph, NodeMapping& a_map,
         const int a_src, const int k,
@@ -119,21 +314,26 @@ public:
 
     // ------------------------------------------------------------------------
     // multi-point range search
+    // (the expansions from the query points run on a_threads threads)
     // ------------------------------------------------------------------------
     static void groupRangeSearch(
         Graph& a_graph, NodeMapping& a_map,
         const int* a_src, const float* a_range,
         const int a_cnt,
-        Array& a_result, int& a_nodeaccess, int& a_edgeaccess);
+        Array& a_result, int& a_nodeaccess, int& a_edgeaccess,
+        const int a_threads=1);
 
     // ------------------------------------------------------------------------
-    // multi-point kNN search
+    // multi-point kNN search by aggregate cost a_agg(GROUP_MAX, GROUP_SUM)
+    // (the expansions from the query points run on a_threads threads, in
+    // rounds until the threshold of the aggregate is reached)
     // ------------------------------------------------------------------------
     static void groupKNNSearch(
         Graph& a_graph, NodeMapping& a_map,
         const int* a_src, const int a_cnt,
         const int a_k,
-        Array& a_result, int& a_nodeaccess, int& a_edgeaccess);
+        Array& a_result, int& a_nodeaccess, int& a_edgeaccess,
+        const int a_agg=GROUP_MAX, const int a_threads=1);
     static void groupKNNSearch(
         Graph& a_graph, NodeMapping& a_map,
         const int* a_src, const int a_cnt,
@@ -0,0 +1,124 @@
+/* ----------------------------------------------------------------------------
+    PackedSignatures: distance signatures of a node in fixed width records.
+---------------------------------------------------------------------------- */
+
+#include "packedsign.h"
+#include "distsign.h"
+#include <algorithm>
+#include <vector>
+#include <string.h>
+
+// constructor/destructor
+PackedSignatures::PackedSignatures():
+m_mem(0), m_sign(0), m_byid(0), m_size(0)
+{}
+
+PackedSignatures::PackedSignatures(const char* a_mem,
+                                   const std::shared_ptr<const void>& a_keep):
+m_mem(a_mem), m_keep(a_keep)
+{
+    const int* h = (const int*)a_mem;
+    m_size = h[1];
+    m_sign = (const Sign*)(h + 2);
+    m_byid = (const int*)(m_sign + m_size);
+}
+
+// ----------------------------------------------------------------------------
+// layout
+// ----------------------------------------------------------------------------
+bool PackedSignatures::isPacked(const char* a_mem)
+{
+    return ((const int*)a_mem)[0] == PACKEDSIGN_TAG;
+}
+
+int PackedSignatures::size(const int a_cnt)
+{
+    return PACKEDSIGN_HEADER + (sizeof(Sign) + sizeof(int))*a_cnt;
+}
+
+static bool byCost(const PackedSignatures::Sign& a0,
+                   const PackedSignatures::Sign& a1)
+{
+    if (a0.m_cost != a1.m_cost) return a0.m_cost < a1.m_cost;
+    return a0.m_oid < a1.m_oid;
+}
+
+// the record of the signatures s
+static void pack(std::vector<PackedSignatures::Sign>& s, char* a_mem, int& a_len)
+{
+    const int cnt = s.size();
+    std::sort(s.begin(), s.end(), byCost);
+    std::vector<int> byid(cnt);
+    for (int i=0; i<cnt; i++)
+        byid[i] = i;
+    std::sort(byid.begin(), byid.end(), [&s](const int a0, const int a1)
+        { return s[a0].m_oid < s[a1].m_oid; });
+
+    int* h = (int*)&a_mem[a_len];
+    h[0] = PACKEDSIGN_TAG;
+    h[1] = cnt;
+    PackedSignatures::Sign* sign = (PackedSignatures::Sign*)(h + 2);
+    for (int i=0; i<cnt; i++)
+        sign[i] = s[i];
+    int* id = (int*)(sign + cnt);
+    for (int i=0; i<cnt; i++)
+        id[i] = byid[i];
+    a_len += PackedSignatures::size(cnt);
+}
+
+void PackedSignatures::toMem(const Array& a_sign, char* a_mem, int& a_len)
+{
+    std::vector<Sign> s(a_sign.size());
+    for (int i=0; i<a_sign.size(); i++)
+    {
+        const DistSignature* d = (const DistSignature*)a_sign.get(i);
+        s[i].m_oid = d->m_oid;
+        s[i].m_cost = d->m_cost;
+        s[i].m_prev = d->m_prev;
+    }
+    pack(s, a_mem, a_len);
+}
+
+// a record of the id layout packed to a_rec(size(#signatures) bytes)
+void PackedSignatures::fromIDLayout(const char* a_mem, char* a_rec, int& a_len)
+{
+    const int cnt = *(const int*)a_mem;
+    const Sign* src = (const Sign*)(a_mem + sizeof(int));
+    std::vector<Sign> s(src, src + cnt);
+    pack(s, a_rec, a_len);
+}
+
+void PackedSignatures::toArray(Array& a_sign) const
+{
+    for (int j=0; j<m_size; j++)
+    {
+        const Sign* s = byID(j);
+        a_sign.append(new DistSignature(s->m_oid, s->m_cost, s->m_prev));
+    }
+}
+
+// a view that stays valid past the next read of the node memory
+PackedSignatures PackedSignatures::copy() const
+{
+    if (m_mem == 0) return PackedSignatures();
+    std::shared_ptr<char> rec(new char[length()], std::default_delete<char[]>());
+    memcpy(rec.get(), m_mem, length());
+    return PackedSignatures(rec.get(), rec);
+}
+
+// ----------------------------------------------------------------------------
+// search
+// ----------------------------------------------------------------------------
+const PackedSignatures::Sign* PackedSignatures::find(const int a_oid) const
+{
+    int lo = 0, hi = m_size - 1;
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        const Sign* s = byID(mid);
+        if (s->m_oid == a_oid) return s;
+        if (s->m_oid < a_oid) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+/* ----------------------------------------------------------------------------
+    This file contains a class PackedSignatures declaration.
+    It is a read only view of the distance signatures of a node in the packed
+    layout: fixed width records by cost, read in place(from a mapped or read
+    buffer) with no unmarshalling, no allocation and no sort.
+
+    record(4 byte words):
+        tag(-1), #signatures
+        (oid, cost, prev)[#]        by cost, then object id(DistSignature::
+                                    compare): the k nearest are a prefix
+        byid[#]                     record indices in object id order
+
+    - the id layout(DistIndex) has the number of signatures(>= 0) first and
+      the records in object id order, the tag tells the two apart
+    - an object is found by a binary search of byid
+---------------------------------------------------------------------------- */
+#ifndef packedsign_defined
+#define packedsign_defined
+
+#include "collection.h"
+#include <memory>
+
+#define PACKEDSIGN_TAG      -1
+#define PACKEDSIGN_HEADER   (sizeof(int)*2)
+
+class PackedSignatures
+{
+public:
+    class Sign                          // a signature in the record
+    {
+    public:
+        int     m_oid;
+        float   m_cost;
+        int     m_prev;
+    };
+protected:
+    const char*     m_mem;      // the record
+    const Sign*     m_sign;
+    const int*      m_byid;
+    int             m_size;
+    std::shared_ptr<const void> m_keep;     // holds the record if not 0
+public:
+    // constructor/destructor
+    PackedSignatures();
+    PackedSignatures(const char* a_mem, const std::shared_ptr<const void>& a_keep=
+        std::shared_ptr<const void>());
+    //
+    // layout
+    static bool isPacked(const char* a_mem);
+    static int size(const int a_cnt);                       // bytes of a record
+    static void toMem(const Array& a_sign, char* a_mem, int& a_len);
+    static void fromIDLayout(const char* a_mem, char* a_rec, int& a_len);
+    void toArray(Array& a_sign) const;  // new DistSignatures in object id order
+    PackedSignatures copy() const;      // holding its own copy of the record
+    //
+    // info
+    const char* record() const      { return m_mem; };
+    int length() const              { return size(m_size); };
+    int size() const                { return m_size; };
+    //
+    // signatures: i-th by cost
+    const Sign* get(const int a_i) const    { return &m_sign[a_i]; };
+    const Sign* byID(const int a_j) const   { return &m_sign[m_byid[a_j]]; };
+    //
+    // the signature of an object(0 if none)
+    const Sign* find(const int a_oid) const;
+};
+
+#endif
@@ -0,0 +1,498 @@
+/* ----------------------------------------------------------------------------
+    PagePool: fixed size page buffer pool(LRU or CLOCK) over pread.
+---------------------------------------------------------------------------- */
+
+#include "pagepool.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#define NIL -1
+
+// ----------------------------------------------------------------------------
+// io_uring by its system calls(no liburing): the submission and completion
+// rings and the submission entries mapped from the ring descriptor. reads the
+// kernel does not take are done by pread and complete from m_done
+// ----------------------------------------------------------------------------
+struct PagePool::Ring
+{
+    int     m_fd;
+    void*   m_sq;
+    size_t  m_sqlen;
+    void*   m_cq;
+    size_t  m_cqlen;
+    io_uring_sqe*   m_sqes;
+    size_t  m_sqeslen;
+    unsigned    *m_sqhead, *m_sqtail, *m_sqmask, *m_sqarray;
+    unsigned    *m_cqhead, *m_cqtail, *m_cqmask;
+    io_uring_cqe*   m_cqes;
+    std::vector<std::pair<int,int> >    m_done; // (tag, result) not submitted
+
+    Ring(): m_fd(-1), m_sq(MAP_FAILED), m_cq(MAP_FAILED), m_sqes((io_uring_sqe*)MAP_FAILED) {};
+    ~Ring()
+    {
+        if (m_sqes != MAP_FAILED) munmap(m_sqes, m_sqeslen);
+        if (m_cq != MAP_FAILED) munmap(m_cq, m_cqlen);
+        if (m_sq != MAP_FAILED) munmap(m_sq, m_sqlen);
+        if (m_fd != -1) close(m_fd);
+    };
+    bool open(const unsigned a_entries)
+    {
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        m_fd = syscall(__NR_io_uring_setup, a_entries, &p);
+        if (m_fd < 0) return false;
+        m_sqlen = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        m_cqlen = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        m_sqeslen = p.sq_entries * sizeof(io_uring_sqe);
+        m_sq = mmap(0, m_sqlen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            m_fd, IORING_OFF_SQ_RING);
+        m_cq = mmap(0, m_cqlen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            m_fd, IORING_OFF_CQ_RING);
+        m_sqes = (io_uring_sqe*)mmap(0, m_sqeslen, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+        if (m_sq == MAP_FAILED || m_cq == MAP_FAILED || m_sqes == MAP_FAILED)
+            return false;
+        m_sqhead = (unsigned*)((char*)m_sq + p.sq_off.head);
+        m_sqtail = (unsigned*)((char*)m_sq + p.sq_off.tail);
+        m_sqmask = (unsigned*)((char*)m_sq + p.sq_off.ring_mask);
+        m_sqarray = (unsigned*)((char*)m_sq + p.sq_off.array);
+        m_cqhead = (unsigned*)((char*)m_cq + p.cq_off.head);
+        m_cqtail = (unsigned*)((char*)m_cq + p.cq_off.tail);
+        m_cqmask = (unsigned*)((char*)m_cq + p.cq_off.ring_mask);
+        m_cqes = (io_uring_cqe*)((char*)m_cq + p.cq_off.cqes);
+        return true;
+    };
+    // queue a read, submitted by the next submit
+    void read(const int a_fd, char* a_buf, const int a_len, const long a_off,
+              const int a_tag)
+    {
+        const unsigned tail = *m_sqtail;
+        const unsigned i = tail & *m_sqmask;
+        io_uring_sqe* e = &m_sqes[i];
+        memset(e, 0, sizeof(*e));
+        e->opcode = IORING_OP_READ;
+        e->fd = a_fd;
+        e->addr = (unsigned long)a_buf;
+        e->len = a_len;
+        e->off = a_off;
+        e->user_data = a_tag;
+        m_sqarray[i] = i;
+        __atomic_store_n(m_sqtail, tail + 1, __ATOMIC_RELEASE);
+    };
+    // submit the a_cnt reads queued last: a short count is submitted again,
+    // and on an error the rest are taken back from the ring and read here
+    void submit(const int a_cnt)
+    {
+        int left = a_cnt;
+        while (left > 0)
+        {
+            const int n = syscall(__NR_io_uring_enter, m_fd, left, 0, 0, 0, 0);
+            if (n > 0)
+                left -= n;
+            else if (n == 0 || errno != EINTR)
+                break;
+        }
+        if (left <= 0) return;
+
+        // --------------------------------------------------------------------
+        // the entries from the kernel's head to the tail are not taken
+        // --------------------------------------------------------------------
+        const unsigned head = __atomic_load_n(m_sqhead, __ATOMIC_ACQUIRE);
+        const unsigned tail = *m_sqtail;
+        for (unsigned t=head; t!=tail; t++)
+        {
+            const io_uring_sqe& e = m_sqes[m_sqarray[t & *m_sqmask]];
+            long res = pread(e.fd, (char*)(unsigned long)e.addr, e.len, e.off);
+            if (res < 0) res = -errno;
+            m_done.push_back(std::make_pair((int)e.user_data, (int)res));
+        }
+        __atomic_store_n(m_sqtail, head, __ATOMIC_RELEASE);
+    };
+    // a completion(tag, result), blocking for one if a_wait
+    bool complete(const bool a_wait, int& a_tag, int& a_res)
+    {
+        if (!m_done.empty())
+        {
+            a_tag = m_done.back().first;
+            a_res = m_done.back().second;
+            m_done.pop_back();
+            return true;
+        }
+        while (true)
+        {
+            const unsigned head = *m_cqhead;
+            if (head != __atomic_load_n(m_cqtail, __ATOMIC_ACQUIRE))
+            {
+                const io_uring_cqe& c = m_cqes[head & *m_cqmask];
+                a_tag = (int)c.user_data;
+                a_res = c.res;
+                __atomic_store_n(m_cqhead, head + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+            if (!a_wait) return false;
+            syscall(__NR_io_uring_enter, m_fd, 0, 1, IORING_ENTER_GETEVENTS, 0, 0);
+        }
+    };
+};
+
+// constructor/destructor
+PagePool::PagePool(const char* a_fname, const int a_pagesize,
+                   const int a_frames, const int a_policy,
+                   const bool a_direct, const int a_readahead):
+m_fd(-1),
+m_pagesize(a_pagesize),
+m_frames(a_frames < 1 ? 1 : a_frames),
+m_policy(a_policy),
+m_readahead(a_readahead < 0 ? 0 : a_readahead),
+m_data(0), m_span(0),
+m_head(NIL), m_tail(NIL), m_hand(0), m_used(0),
+m_hits(0), m_misses(0), m_bytesread(0),
+m_ring(0), m_depth(0), m_prefetched(0), m_waits(0)
+{
+    // ------------------------------------------------------------------------
+    // a readahead never evicts the page it is for
+    // ------------------------------------------------------------------------
+    if (m_readahead > m_frames - 1)
+        m_readahead = m_frames - 1;
+
+    // ------------------------------------------------------------------------
+    // O_DIRECT needs aligned buffers, offsets and lengths: pages are all that
+    // ------------------------------------------------------------------------
+#ifdef O_DIRECT
+    if (a_direct)
+        m_fd = open(a_fname, O_RDONLY | O_DIRECT);
+#endif
+    if (m_fd == -1)
+        m_fd = open(a_fname, O_RDONLY);
+
+    void* p = 0;
+    if (posix_memalign(&p, 4096, (size_t)m_pagesize * m_frames) == 0)
+        m_data = (char*)p;
+    if (posix_memalign(&p, 4096, (size_t)m_pagesize * (m_readahead+1)) == 0)
+        m_span = (char*)p;
+    m_page.assign(m_frames, NIL);
+    m_ref.assign(m_frames, false);
+    m_prev.assign(m_frames, NIL);
+    m_next.assign(m_frames, NIL);
+    m_busy.assign(m_frames, false);
+}
+
+PagePool::~PagePool()
+{
+    while (!m_inflight.empty())
+        reap(true);
+    delete m_ring;
+    if (m_fd != -1)
+        close(m_fd);
+    ::free(m_data);
+    ::free(m_span);
+}
+
+// ----------------------------------------------------------------------------
+// recency list(LRU): head is the newest frame, tail the victim
+// ----------------------------------------------------------------------------
+void PagePool::unlink(const int a_frame)
+{
+    if (m_prev[a_frame] != NIL) m_next[m_prev[a_frame]] = m_next[a_frame];
+    else m_head = m_next[a_frame];
+    if (m_next[a_frame] != NIL) m_prev[m_next[a_frame]] = m_prev[a_frame];
+    else m_tail = m_prev[a_frame];
+}
+
+void PagePool::pushFront(const int a_frame)
+{
+    m_prev[a_frame] = NIL;
+    m_next[a_frame] = m_head;
+    if (m_head != NIL) m_prev[m_head] = a_frame;
+    m_head = a_frame;
+    if (m_tail == NIL) m_tail = a_frame;
+}
+
+void PagePool::touch(const int a_frame)
+{
+    if (m_policy == LRU)
+    {
+        unlink(a_frame);
+        pushFront(a_frame);
+    }
+    else
+        m_ref[a_frame] = true;
+}
+
+// a free frame or the one evicted for a new page
+int PagePool::victim()
+{
+    int f;
+    if (!m_spare.empty())
+    {
+        f = m_spare.back();
+        m_spare.pop_back();
+    }
+    else if (m_used < m_frames)
+        f = m_used++;
+    else if (m_policy == LRU)
+    {
+        f = m_tail;
+        unlink(f);
+    }
+    else
+    {
+        while (m_ref[m_hand] || m_busy[m_hand])
+        {
+            m_ref[m_hand] = false;
+            m_hand = (m_hand + 1) % m_frames;
+        }
+        f = m_hand;
+        m_hand = (m_hand + 1) % m_frames;
+    }
+    if (m_page[f] != NIL)
+        m_frame.erase(m_page[f]);
+    m_page[f] = NIL;
+    return f;
+}
+
+// ----------------------------------------------------------------------------
+// the frame of a missed page: read it and the run of missing pages after it
+// ----------------------------------------------------------------------------
+int PagePool::fetch(const int a_page)
+{
+    int n = 1;
+    while (n <= m_readahead && m_frame.find(a_page + n) == m_frame.end() &&
+        m_inflight.find(a_page + n) == m_inflight.end())
+        n++;
+    const long off = (long)a_page * m_pagesize;
+    long got = pread(m_fd, m_span, (size_t)n * m_pagesize, off);
+#ifdef O_DIRECT
+    if (got < 0 && (fcntl(m_fd, F_GETFL) & O_DIRECT))
+    {
+        // the page size does not suit O_DIRECT here: buffered from now on
+        fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) & ~O_DIRECT);
+        got = pread(m_fd, m_span, (size_t)n * m_pagesize, off);
+    }
+#endif
+    if (got < 0) got = 0;
+    m_bytesread += got;
+    if (got < (long)n * m_pagesize)
+        memset(m_span + got, 0, (size_t)n * m_pagesize - got);
+    const int pages = got == 0 ? 1 : (got + m_pagesize - 1) / m_pagesize;
+
+    // ------------------------------------------------------------------------
+    // the readahead pages go in first, unreferenced: the missed page is the
+    // newest and cannot be their victim
+    // ------------------------------------------------------------------------
+    for (int i=pages-1; i>=0; i--)
+    {
+        int f = victim();
+        memcpy(m_data + (long)f * m_pagesize, m_span + (long)i * m_pagesize,
+            m_pagesize);
+        m_page[f] = a_page + i;
+        m_frame[a_page + i] = f;
+        if (m_policy == LRU)
+            pushFront(f);
+        m_ref[f] = i == 0;
+        if (i == 0)
+            return f;
+    }
+    return NIL;
+}
+
+// read
+void PagePool::read(const long a_offset, char* a_buf, const int a_len)
+{
+    long pos = a_offset;
+    int done = 0;
+    while (done < a_len)
+    {
+        const int page = pos / m_pagesize;
+        const int in = pos - (long)page * m_pagesize;
+        const int len = a_len - done < m_pagesize - in ?
+            a_len - done : m_pagesize - in;
+
+        int f;
+        if (m_ring != 0 && m_inflight.find(page) != m_inflight.end())
+        {
+            m_waits++;
+            while (m_inflight.find(page) != m_inflight.end())
+                reap(true);
+        }
+        std::unordered_map<int,int>::iterator it = m_frame.find(page);
+        if (it != m_frame.end())
+        {
+            f = it->second;
+            m_hits++;
+            touch(f);
+        }
+        else
+        {
+            f = fetch(page);
+            m_misses++;
+        }
+        memcpy(a_buf + done, m_data + (long)f * m_pagesize + in, len);
+        done += len;
+        pos += len;
+    }
+}
+
+void PagePool::clean()
+{
+    while (!m_inflight.empty())
+        reap(true);
+    m_spare.clear();
+    m_frame.clear();
+    m_page.assign(m_frames, NIL);
+    m_ref.assign(m_frames, false);
+    m_head = m_tail = NIL;
+    m_hand = 0;
+    m_used = 0;
+}
+
+// ----------------------------------------------------------------------------
+// async reads: a frame per prefetched page, busy(not a victim, not in the
+// recency list) until its read completes, then an unreferenced page as one
+// read ahead. at most half the frames are in flight, a failed read gives its
+// frame back and the page is read on demand
+// ----------------------------------------------------------------------------
+bool PagePool::setAsync(const int a_depth)
+{
+    while (!m_inflight.empty())
+        reap(true);
+    delete m_ring;
+    m_ring = 0;
+    m_depth = a_depth < m_frames / 2 ? a_depth : m_frames / 2;
+    if (m_depth < 1 || m_fd == -1)
+        return false;
+    m_ring = new Ring;
+    if (!m_ring->open(m_depth))
+    {
+        delete m_ring;
+        m_ring = 0;
+    }
+    return m_ring != 0;
+}
+
+void PagePool::prefetch(const long a_offset, const int a_len)
+{
+    if (m_ring == 0 || a_len <= 0) return;
+    if ((int)m_inflight.size() >= m_depth)
+        reap(false);
+    const int first = a_offset / m_pagesize;
+    const int last = (a_offset + a_len - 1) / m_pagesize;
+    int cnt = 0;
+    for (int page=first; page<=last && (int)m_inflight.size()<m_depth; page++)
+    {
+        if (m_frame.find(page) != m_frame.end() ||
+            m_inflight.find(page) != m_inflight.end())
+            continue;
+        const int f = victim();
+        m_busy[f] = true;
+        m_page[f] = page;
+        m_inflight[page] = f;
+        m_ring->read(m_fd, m_data + (long)f * m_pagesize, m_pagesize,
+            (long)page * m_pagesize, f);
+        cnt++;
+    }
+    if (cnt > 0)
+        m_ring->submit(cnt);
+}
+
+void PagePool::reap(const bool a_wait)
+{
+    int f, res;
+    bool wait = a_wait;
+    while (m_ring->complete(wait, f, res))
+    {
+        wait = false;
+        const int page = m_page[f];
+        m_inflight.erase(page);
+        m_busy[f] = false;
+        if (res <= 0)
+        {
+            m_page[f] = NIL;
+            m_spare.push_back(f);
+            continue;
+        }
+        if (res < m_pagesize)
+            memset(m_data + (long)f * m_pagesize + res, 0, m_pagesize - res);
+        m_bytesread += res;
+        m_prefetched++;
+        m_frame[page] = f;
+        if (m_policy == LRU)
+            pushFront(f);
+        m_ref[f] = false;
+    }
+}
+
+bool PagePool::isAsync() const
+{
+    return m_ring != 0;
+}
+
+bool PagePool::peek(const long a_offset, char* a_buf, const int a_len) const
+{
+    long pos = a_offset;
+    int done = 0;
+    while (done < a_len)
+    {
+        const int page = pos / m_pagesize;
+        const int in = pos - (long)page * m_pagesize;
+        const int len = a_len - done < m_pagesize - in ?
+            a_len - done : m_pagesize - in;
+        std::unordered_map<int,int>::const_iterator it = m_frame.find(page);
+        if (it == m_frame.end())
+            return false;
+        memcpy(a_buf + done, m_data + (long)it->second * m_pagesize + in, len);
+        done += len;
+        pos += len;
+    }
+    return true;
+}
+
+// info
+bool PagePool::isOpen() const
+{
+    return m_fd != -1 && m_data != 0 && m_span != 0;
+}
+
+long PagePool::hits() const
+{
+    return m_hits;
+}
+
+long PagePool::misses() const
+{
+    return m_misses;
+}
+
+long PagePool::bytesread() const
+{
+    return m_bytesread;
+}
+
+long PagePool::prefetched() const
+{
+    return m_prefetched;
+}
+
+long PagePool::waits() const
+{
+    return m_waits;
+}
+
+void PagePool::resetCounters()
+{
+    m_hits = m_misses = m_bytesread = 0;
+    m_prefetched = m_waits = 0;
+}
+
+int PagePool::policy(const char* a_name)
+{
+    if (strcmp(a_name, "lru") == 0)     return LRU;
+    if (strcmp(a_name, "clock") == 0)   return CLOCK;
+    return -1;
+}
@@ -0,0 +1,98 @@
+/* ----------------------------------------------------------------------------
+    This file contains a class PagePool declaration.
+    It is a fixed size buffer pool of file pages under SegFMemory, so reads
+    of an index on disk are counted as the page hits and misses they cause
+    instead of being simulated(IOMeasure::pagelru).
+
+    - a_frames pages of a_pagesize bytes, eviction LRU or CLOCK
+    - pages are read with pread on a descriptor of its own, O_DIRECT if
+      asked(and the file system takes it, else buffered)
+    - a miss also reads up to a_readahead pages after the missed one that
+      are not in the pool, in one pread
+    - not thread safe: one pool per SegFMemory, which locks it for threaded
+      reads
+    - with setAsync, prefetch puts reads of pages soon needed in flight
+      through io_uring(a_depth at once) into frames of their own, a read of
+      such a page waits for it then, so several reads are on the device
+      while a search still works on what it has
+---------------------------------------------------------------------------- */
+#ifndef pagepool_defined
+#define pagepool_defined
+
+#include <vector>
+#include <unordered_map>
+
+class PagePool
+{
+public:
+    enum Policy { LRU, CLOCK };
+protected:
+    int     m_fd;
+    int     m_pagesize;
+    int     m_frames;
+    int     m_policy;
+    int     m_readahead;        // pages
+    char*   m_data;             // frames, page size aligned
+    char*   m_span;             // pread buffer of 1+readahead pages
+    std::vector<int>    m_page;     // page in a frame, -1 if free
+    std::vector<bool>   m_ref;      // reference bits(CLOCK)
+    std::vector<int>    m_prev;     // recency list(LRU), head = newest
+    std::vector<int>    m_next;
+    int     m_head, m_tail;
+    int     m_hand;             // clock hand
+    int     m_used;             // frames in use
+    std::unordered_map<int,int> m_frame;    // page -> frame
+    long    m_hits;
+    long    m_misses;
+    long    m_bytesread;
+    struct Ring;                // io_uring of the prefetches(0: none)
+    Ring*   m_ring;
+    int     m_depth;            // prefetches in flight at most
+    std::unordered_map<int,int> m_inflight; // page -> frame it is read into
+    std::vector<bool>   m_busy;     // frames being read, never victims
+    std::vector<int>    m_spare;    // frames of failed prefetches
+    long    m_prefetched;
+    long    m_waits;
+
+    int fetch(const int a_page);
+    void reap(const bool a_wait);   // completed prefetches into the pool
+    int victim();
+    void unlink(const int a_frame);
+    void pushFront(const int a_frame);
+    void touch(const int a_frame);
+public:
+    // constructor/destructor
+    PagePool(const char* a_fname, const int a_pagesize, const int a_frames,
+        const int a_policy=CLOCK, const bool a_direct=false,
+        const int a_readahead=0);
+    virtual ~PagePool();
+    //
+    // read a_len bytes at a_offset of the file through the pool
+    void read(const long a_offset, char* a_buf, const int a_len);
+    void clean();               // drop all pages(after the file changed)
+    //
+    // async reads: an io_uring of a_depth entries(false if the kernel has
+    // none), then prefetch starts reads of the pages of a_len bytes at
+    // a_offset that are neither in the pool nor in flight, as many as fit
+    bool setAsync(const int a_depth);
+    void prefetch(const long a_offset, const int a_len);
+    bool isAsync() const;
+    //
+    // a_len bytes at a_offset if all their pages are in the pool(no counts,
+    // no recency), else false
+    bool peek(const long a_offset, char* a_buf, const int a_len) const;
+    //
+    // info
+    bool isOpen() const;
+    long hits() const;          // pages found in the pool
+    long misses() const;        // pages read on demand
+    long bytesread() const;     // bytes read from the file(with readahead)
+    long prefetched() const;    // pages read by prefetch
+    long waits() const;         // reads that waited for a prefetch
+    void resetCounters();
+    //
+    // policy by name("lru", "clock"), -1 if none of them
+    static int policy(const char* a_name);
+};
+
+#endif
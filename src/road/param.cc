@@ -8,6 +8,7 @@
 #include "param.h"
 #include <string>
 #include <string.h>
+#include <stdlib.h>
 
 const char* Param::read(const int a_argc, const char** a_argv,
                         const char* a_param,
@@ -23,3 +24,20 @@ const char* Param::read(const int a_argc, const char** a_argv,
         }
     return a_def;
 }
+
+int Param::readList(const char* a_val, float* a_list, const int a_max)
+{
+    int cnt = 0;
+    char* end;
+    while (cnt < a_max)
+    {
+        const float v = (float)strtod(a_val, &end);
+        if (end == a_val)
+            break;
+        a_list[cnt++] = v;
+        if (*end != ',')
+            break;
+        a_val = end+1;
+    }
+    return cnt;
+}
@@ -22,6 +22,11 @@ public:
         const int a_argc, const char** a_argv,  // arguments
         const char* a_param,    // param flag e.g. "-i"
         const char* a_def);     // default value if the flag is not found
+
+    // a comma separated list of numbers, e.g. "0.1,0.2,0.5"
+    // (returns the count read, at most a_max)
+    static int readList(
+        const char* a_val, float* a_list, const int a_max);
 };
 
 #endif // PARAM_DEFINED
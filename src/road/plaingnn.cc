@@ -18,10 +18,14 @@
     -q: number of queries
     -k: number of NNs
     -v: turn verbose mode on (default: off)
+    -t: threads for the query points of a group (default: 1)
+    -a: aggregate cost, max or sum (default: max)
+    -m: map index files read-only, advised random, sequential, normal,
+        willneed or preload (default: off, buffered reads)
 ---------------------------------------------------------------------------- */
 
 #include "graph.h"
-#include "segfmem.h"
+#include "segmapmem.h"
 #include "param.h"
 #include "nodemap.h"
 #include "graphsearch.h"
@@ -35,6 +39,8 @@
 #include <stdlib.h>
 #include <math.h>
 #include <iostream>
+#include <vector>
+#include <memory>
 #include <fstream>
 
 using namespace std;
@@ -53,6 +59,9 @@ void helpmsg(const char* pgm)
     cerr << "-q: #queries" << endl;
     cerr << "-k: #NNs" << endl;
     cerr << "-v: turn verbose mode on (default: off)" << endl;
+    cerr << "-t: threads for the query points of a group (default: 1)" << endl;
+    cerr << "-a: aggregate cost, max or sum (default: max)" << endl;
+    cerr << "-m: map index files: random, sequential, normal, willneed or preload (default: off)" << endl;
 }
 
 int main(const int a_argc, const char** a_argv)
@@ -73,13 +82,19 @@ int main(const int a_argc, const char** a_argv)
     const char* cnumquery  = Param::read(a_argc, a_argv, "-q", "");
     const char* ck = Param::read(a_argc, a_argv, "-k", "");
     const char* vrbs = Param::read(a_argc, a_argv, "-v", "null");
+    const char* cmap = Param::read(a_argc, a_argv, "-m", "");
     bool verbose = strcmp(vrbs,"null") != 0;
+    int threads = atoi(Param::read(a_argc, a_argv, "-t", "1"));
+    if (threads < 1) threads = 1;
+    const int agg = strcmp(Param::read(a_argc, a_argv, "-a", "max"), "sum") == 0 ?
+        GROUP_SUM : GROUP_MAX;
 
     //-------------------------------------------------------------------------
     // access graph index file
     //-------------------------------------------------------------------------
     cerr << "loading a graph index ... ";
-    SegFMemory segmem(idxflname, PAGESIZE*10, PAGESIZE, 32, false);
+    std::unique_ptr<SegMemory> segmemp(SegMapMemory::open(idxflname, cmap, PAGESIZE*10, PAGESIZE, 32));
+    SegMemory& segmem = *segmemp;
     Graph graph(segmem);
     int graphsize = segmem.size();
     cerr << "[DONE]" << endl;
@@ -106,6 +121,7 @@ int main(const int a_argc, const char** a_argv)
         map.addObject(nodeid, objid);
         objsize += sizeof(int)*2;
     }
+    map.build();
     ftime(&endtime);  // time the the object index creation
     idxtime =
         ((endtime.time*1000 + endtime.millitm) -
@@ -146,7 +162,7 @@ int main(const int a_argc, const char** a_argv)
         struct timeb starttime, endtime;
         segmem.m_history.clean();
 
-        int src[MAXQUERY];
+        std::vector<int> src(numsrc);
         for (int j=0; j<numsrc; j++)
         {
             //----------------------------------------------------------------------
@@ -161,8 +177,8 @@ int main(const int a_argc, const char** a_argv)
         ftime(&starttime);  // time the algorithm
         ObjectSearch::groupKNNSearch(
             graph,map,
-            src,numsrc,k,
-            result,nodeaccess,edgeaccess);
+            src.data(),numsrc,k,
+            result,nodeaccess,edgeaccess,agg,threads);
         ftime(&endtime);
         float qtime = 
             ((endtime.time*1000 + endtime.millitm) -
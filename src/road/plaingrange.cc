@@ -18,10 +18,13 @@
     -q: number of queries
     -r: range
     -v: turn verbose mode on (default: off)
+    -t: threads for the query points of a group (default: 1)
+    -m: map index files read-only, advised random, sequential, normal,
+        willneed or preload (default: off, buffered reads)
 ---------------------------------------------------------------------------- */
 
 #include "graph.h"
-#include "segfmem.h"
+#include "segmapmem.h"
 #include "param.h"
 #include "nodemap.h"
 #include "graphsearch.h"
@@ -35,6 +38,8 @@
 #include <stdlib.h>
 #include <math.h>
 #include <iostream>
+#include <vector>
+#include <memory>
 #include <fstream>
 
 using namespace std;
@@ -53,6 +58,8 @@ void helpmsg(const char* pgm)
     cerr << "-q: #queries" << endl;
     cerr << "-r: range " << endl;
     cerr << "-v: turn verbose mode on (default: off)" << endl;
+    cerr << "-t: threads for the query points of a group (default: 1)" << endl;
+    cerr << "-m: map index files: random, sequential, normal, willneed or preload (default: off)" << endl;
 }
 
 int main(const int a_argc, const char** a_argv)
@@ -73,13 +80,17 @@ int main(const int a_argc, const char** a_argv)
     const char* cnumquery  = Param::read(a_argc, a_argv, "-q", "");
     const char* crange = Param::read(a_argc, a_argv, "-r", "");
     const char* vrbs = Param::read(a_argc, a_argv, "-v", "null");
+    const char* cmap = Param::read(a_argc, a_argv, "-m", "");
     bool verbose = strcmp(vrbs,"null") != 0;
+    int threads = atoi(Param::read(a_argc, a_argv, "-t", "1"));
+    if (threads < 1) threads = 1;
 
     //-------------------------------------------------------------------------
     // access graph index file
     //-------------------------------------------------------------------------
     cerr << "loading a graph index ... ";
-    SegFMemory segmem(idxflname, PAGESIZE*10, PAGESIZE, 32, false);
+    std::unique_ptr<SegMemory> segmemp(SegMapMemory::open(idxflname, cmap, PAGESIZE*10, PAGESIZE, 32));
+    SegMemory& segmem = *segmemp;
     Graph graph(segmem);
     int graphsize = segmem.size();
     cerr << "[DONE]" << endl;
@@ -106,6 +117,7 @@ int main(const int a_argc, const char** a_argv)
         map.addObject(nodeid, objid);
         objsize += sizeof(int)*2;
     }
+    map.build();
     ftime(&endtime);  // time the the object index creation
     idxtime =
         ((endtime.time*1000 + endtime.millitm) -
@@ -146,8 +158,8 @@ int main(const int a_argc, const char** a_argv)
         struct timeb starttime, endtime;
         segmem.m_history.clean();
 
-        int src[MAXQUERY];
-        float rng[MAXQUERY];
+        std::vector<int> src(numsrc);
+        std::vector<float> rng(numsrc);
         for (int j=0; j<numsrc; j++)
         {
             //----------------------------------------------------------------------
@@ -163,8 +175,8 @@ int main(const int a_argc, const char** a_argv)
         ftime(&starttime);  // time the algorithm
         ObjectSearch::groupRangeSearch(
             graph,map,
-            src,rng,numsrc,
-            result,nodeaccess,edgeaccess);
+            src.data(),rng.data(),numsrc,
+            result,nodeaccess,edgeaccess,threads);
         ftime(&endtime);
         float qtime = 
             ((endtime.time*1000 + endtime.millitm) -
@@ -0,0 +1,225 @@
+/* ----------------------------------------------------------------------------
+    This file contains class templates PQueue and IndexedPQueue declaration.
+    They are priority queues of values(no void*, no allocation per entry)
+    to replace Collection::BinHeap in the searches.
+
+    - both are d-ary heaps(D=4 by default) in one array, the top is the
+      least entry by the comparator L(std::less by default)
+    - PQueue keeps any copyable value, entries equal to the top in order
+      are removed in no particular order
+    - IndexedPQueue keeps at most one entry per int id, a position index
+      (FlatHash) makes insert a decrease-key when the id is queued already
+    - the interface follows BinHeap: insert, removeTop, top, size, isEmpty
+---------------------------------------------------------------------------- */
+#ifndef pqueue_defined
+#define pqueue_defined
+
+#include <vector>
+#include <functional>
+#include "flathash.h"
+
+template<class T, class L=std::less<T>, int D=4>
+class PQueue
+{
+protected:
+    std::vector<T>  m_heap;
+    L               m_less;
+
+    void up(int a_i)
+    {
+        T t = m_heap[a_i];
+        while (a_i > 0)
+        {
+            int p = (a_i - 1) / D;
+            if (!m_less(t, m_heap[p])) break;
+            m_heap[a_i] = m_heap[p];
+            a_i = p;
+        }
+        m_heap[a_i] = t;
+    };
+    void down(int a_i)
+    {
+        const int n = m_heap.size();
+        T t = m_heap[a_i];
+        while (true)
+        {
+            int c = a_i * D + 1;
+            if (c >= n) break;
+            int m = c;
+            for (int j=c+1; j<c+D && j<n; j++)
+                if (m_less(m_heap[j], m_heap[m])) m = j;
+            if (!m_less(m_heap[m], t)) break;
+            m_heap[a_i] = m_heap[m];
+            a_i = m;
+        }
+        m_heap[a_i] = t;
+    };
+public:
+    // constructor/destructor
+    PQueue(const int a_reserve=0, const L& a_less=L()): m_less(a_less)
+    {
+        m_heap.reserve(a_reserve);
+    };
+    virtual ~PQueue() {};
+    //
+    // update
+    void insert(const T& a_t)
+    {
+        m_heap.push_back(a_t);
+        up(m_heap.size() - 1);
+    };
+    T removeTop()       // the queue is not empty
+    {
+        T t = m_heap[0];
+        m_heap[0] = m_heap.back();
+        m_heap.pop_back();
+        if (!m_heap.empty()) down(0);
+        return t;
+    };
+    void clean()
+    {
+        m_heap.clear();
+    };
+    void reserve(const int a_n)
+    {
+        m_heap.reserve(a_n);
+    };
+    //
+    // search
+    const T& top() const
+    {
+        return m_heap[0];
+    };
+    int size() const
+    {
+        return m_heap.size();
+    };
+    bool isEmpty() const
+    {
+        return m_heap.empty();
+    };
+};
+
+template<class T, class L=std::less<T>, int D=4>
+class IndexedPQueue
+{
+protected:
+    class Entry
+    {
+    public:
+        int     m_id;
+        T       m_val;
+    };
+    std::vector<Entry>  m_heap;
+    FlatHash<int,int>   m_pos;      // id -> heap position
+    L                   m_less;
+
+    void set(const int a_i, const Entry& a_e)
+    {
+        m_heap[a_i] = a_e;
+        *m_pos.find(a_e.m_id) = a_i;
+    };
+    void up(int a_i)
+    {
+        Entry e = m_heap[a_i];
+        while (a_i > 0)
+        {
+            int p = (a_i - 1) / D;
+            if (!m_less(e.m_val, m_heap[p].m_val)) break;
+            set(a_i, m_heap[p]);
+            a_i = p;
+        }
+        set(a_i, e);
+    };
+    void down(int a_i)
+    {
+        const int n = m_heap.size();
+        Entry e = m_heap[a_i];
+        while (true)
+        {
+            int c = a_i * D + 1;
+            if (c >= n) break;
+            int m = c;
+            for (int j=c+1; j<c+D && j<n; j++)
+                if (m_less(m_heap[j].m_val, m_heap[m].m_val)) m = j;
+            if (!m_less(m_heap[m].m_val, e.m_val)) break;
+            set(a_i, m_heap[m]);
+            a_i = m;
+        }
+        set(a_i, e);
+    };
+public:
+    // constructor/destructor
+    IndexedPQueue(const int a_reserve=0, const L& a_less=L()):
+        m_pos(a_reserve), m_less(a_less)
+    {
+        m_heap.reserve(a_reserve);
+    };
+    virtual ~IndexedPQueue() {};
+    //
+    // update: queues a_id with a_val, or lowers its value if a_val is less
+    // than the queued one; false if neither happened
+    bool insert(const int a_id, const T& a_val)
+    {
+        int* pos = m_pos.find(a_id);
+        if (pos == 0)
+        {
+            Entry e;
+            e.m_id = a_id;
+            e.m_val = a_val;
+            m_pos.put(a_id, m_heap.size());
+            m_heap.push_back(e);
+            up(m_heap.size() - 1);
+            return true;
+        }
+        if (!m_less(a_val, m_heap[*pos].m_val))
+            return false;
+        m_heap[*pos].m_val = a_val;
+        up(*pos);
+        return true;
+    };
+    int removeTop(T& a_val)     // the id on top, the queue is not empty
+    {
+        Entry e = m_heap[0];
+        m_pos.remove(e.m_id);
+        Entry last = m_heap.back();
+        m_heap.pop_back();
+        if (!m_heap.empty())
+        {
+            m_heap[0] = last;
+            *m_pos.find(last.m_id) = 0;
+            down(0);
+        }
+        a_val = e.m_val;
+        return e.m_id;
+    };
+    void clean()
+    {
+        m_heap.clear();
+        m_pos.clean();
+    };
+    //
+    // search
+    int top() const
+    {
+        return m_heap[0].m_id;
+    };
+    const T& topVal() const
+    {
+        return m_heap[0].m_val;
+    };
+    bool in(const int a_id) const
+    {
+        return m_pos.in(a_id);
+    };
+    int size() const
+    {
+        return m_heap.size();
+    };
+    bool isEmpty() const
+    {
+        return m_heap.empty();
+    };
+};
+
+#endif
@@ -0,0 +1,69 @@
+/* ----------------------------------------------------------------------------
+    This file contains classes SearchEntry and SearchTrail declaration.
+    They let the network expansions queue small values instead of search
+    results, each carrying a copy of the path so far.
+---------------------------------------------------------------------------- */
+#ifndef searchtrail_defined
+#define searchtrail_defined
+
+#include "collection.h"
+#include "smallarray.h"
+#include <vector>
+
+// the nodes of a path, source first(most fit inline)
+typedef SmallArray<int,8> NodePath;
+
+// ----------------------------------------------------------------------------
+// a search queues entries by value(PQueue): the node, its cost, the object
+// it heads to(-1 if none) and where it came from in the trail of the search
+// ----------------------------------------------------------------------------
+class SearchEntry
+{
+public:
+    float   m_cost;
+    int     m_nid;
+    int     m_oid;
+    int     m_prev;     // trail index, -1 at a source
+public:
+    SearchEntry() {};
+    SearchEntry(const int a_nid, const float a_cost, const int a_prev,
+                const int a_oid=-1):
+        m_cost(a_cost), m_nid(a_nid), m_oid(a_oid), m_prev(a_prev) {};
+    bool operator<(const SearchEntry& a_e) const
+    {
+        if (m_cost != a_e.m_cost) return m_cost < a_e.m_cost;
+        return m_oid < a_e.m_oid;
+    };
+};
+
+// ----------------------------------------------------------------------------
+// the entries a search took off its queue, each with the index of the
+// entry it came from: a path is rebuilt from here for a result only, a
+// search that needs no path keeps no trail(results get their node only)
+// ----------------------------------------------------------------------------
+class SearchTrail
+{
+public:
+    const bool          m_keep;     // false: no paths(add returns -1)
+    std::vector<int>    m_nid;
+    std::vector<int>    m_prev;
+public:
+    SearchTrail(const bool a_keep=true): m_keep(a_keep) {};
+    int add(const int a_nid, const int a_prev)
+    {
+        if (!m_keep) return -1;
+        m_nid.push_back(a_nid);
+        m_prev.push_back(a_prev);
+        return m_nid.size() - 1;
+    };
+    void path(const int a_i, NodePath& a_path) const    // appends source .. a_i
+    {
+        std::vector<int> rev;
+        for (int i=a_i; i!=-1; i=m_prev[i])
+            rev.push_back(m_nid[i]);
+        for (int i=rev.size()-1; i>=0; i--)
+            a_path.append(rev[i]);
+    };
+};
+
+#endif
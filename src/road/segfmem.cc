@@ -6,7 +6,9 @@
 ---------------------------------------------------------------------------- */
 
 #include "segfmem.h"
+#include "pagepool.h"
 #include <string.h>
+#include <unistd.h>
 
 /*
     File structure:
@@ -25,6 +27,10 @@
                   memory size (memsize)
 
     Note: all addresses should be offset by the header.
+
+    The free list in the file is by address. While the memory is open it is
+    kept in m_free(by address, neighbours merge) and m_bysize(smallest fit),
+    only the size of an allocated segment is written at once.
 */
 
 
@@ -47,7 +53,13 @@ m_memsize(a_initsize),
 m_exp(a_exp),
 m_minsize(a_minsize),
 m_freelistheader(0),
-m_newfile(a_newfile)
+m_newfile(a_newfile),
+m_pool(0),
+m_dirty(false),
+m_freeloaded(false),
+m_freechanged(false),
+m_append(false),
+m_align(0)
 {
     // ------------------------------------------------------------------------
     // allocate buffer to read from file
@@ -73,8 +85,9 @@ m_newfile(a_newfile)
 SegFMemory::~SegFMemory()
 {
     // ------------------------------------------------------------------------
-    // refresh the header and put it back to memory
+    // the free list back to the file, then the header
     // ------------------------------------------------------------------------
+    storeFree();
     Header hdr;
     hdr.m_nodehash = m_header;
     hdr.m_freelist = m_freelistheader;
@@ -95,6 +108,7 @@ void SegFMemory::flush()
     // ------------------------------------------------------------------------
     // clean the header
     // ------------------------------------------------------------------------
+    m_dirty = true;
     Header hdr;
     hdr.m_nodehash = m_header = -1;
     hdr.m_freelist = m_freelistheader = sizeof(Header);
@@ -123,17 +137,42 @@ void SegFMemory::flush()
     // adjust the freelist
     // ------------------------------------------------------------------------
     m_freelistheader = sizeof(Header);
+    m_free.clear();
+    m_bysize.clear();
+    insertFree(sizeof(Header), segsize);
+    m_freeloaded = true;
+    m_freechanged = false;
 }
 
 // read/allocate/free
 void* SegFMemory::read(int a_pos)
 {
+    // ------------------------------------------------------------------------
+    // a thread with its own history reads into its own buffer
+    // ------------------------------------------------------------------------
+    Binding* b = binding();
+    if (b != 0)
+        return readShared(a_pos, *b);
+
     // ------------------------------------------------------------------------
     // read segment from the file
     // ------------------------------------------------------------------------
     int size=0, p=-1;
-    fseek(m_memfile, a_pos - sizeof(int), SEEK_SET);
-    fread(&size,sizeof(size),1,m_memfile);
+    if (m_pool != 0)
+    {
+        if (m_dirty)
+        {
+            fflush(m_memfile);
+            m_pool->clean();
+            m_dirty = false;
+        }
+        m_pool->read(a_pos - sizeof(int), (char*)&size, sizeof(size));
+    }
+    else
+    {
+        fseek(m_memfile, a_pos - sizeof(int), SEEK_SET);
+        fread(&size,sizeof(size),1,m_memfile);
+    }
 
     if ((int)(size+sizeof(int)) > m_buflen)
     {
@@ -142,7 +181,10 @@ void* SegFMemory::read(int a_pos)
         m_buffer = new char[m_buflen];
     }
     memset(m_buffer,0,m_buflen);
-    fread(m_buffer,size,1,m_memfile);
+    if (m_pool != 0)
+        m_pool->read(a_pos, m_buffer, size);
+    else
+        fread(m_buffer,size,1,m_memfile);
 
     // ------------------------------------------------------------------------
     // update the access history
@@ -157,17 +199,65 @@ void* SegFMemory::read(int a_pos)
     return m_buffer;
 }
 
+// ----------------------------------------------------------------------------
+// reentrant read: pread(no file position) or the pool under the read lock,
+// into the buffer of the calling thread
+// ----------------------------------------------------------------------------
+void* SegFMemory::readShared(int a_pos, Binding& a_binding)
+{
+    std::vector<char>& buf = a_binding.m_buffer;
+    int size = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_readlock);
+        if (m_dirty)
+        {
+            fflush(m_memfile);
+            if (m_pool != 0) m_pool->clean();
+            m_dirty = false;
+        }
+        if (m_pool != 0)
+        {
+            m_pool->read(a_pos - sizeof(int), (char*)&size, sizeof(size));
+            if (buf.size() < size + sizeof(int))
+                buf.resize(size + sizeof(int));
+            memset(&buf[0], 0, buf.size());
+            m_pool->read(a_pos, &buf[0], size);
+        }
+    }
+    if (m_pool == 0)
+    {
+        const int fd = fileno(m_memfile);
+        if (pread(fd, &size, sizeof(size), a_pos - sizeof(int)) != sizeof(size))
+            size = 0;
+        if (buf.size() < size + sizeof(int))
+            buf.resize(size + sizeof(int));
+        memset(&buf[0], 0, buf.size());
+        if (size > 0 && pread(fd, &buf[0], size, a_pos) < 0)
+            size = 0;
+    }
+
+    // ------------------------------------------------------------------------
+    // update the access history of the thread
+    // ------------------------------------------------------------------------
+    int start = a_pos - sizeof(int);
+    int end   = start + size + sizeof(int);
+    a_binding.m_history->append(start,end);
+    return &buf[0];
+}
+
 int SegFMemory::allocate(void* a_content, const int a_size)
 {
     // ------------------------------------------------------------------------
     // find a segment to fit the content in
     // ------------------------------------------------------------------------
+    m_dirty = true;
     const int size = a_size > m_minsize ? a_size : m_minsize;
-    int address = find(size);
-    if (address == -1)
+    int segsize = 0;
+    int address = find(size, segsize);
+    while (address == -1)
     {
         expand(m_exp > (int)(size+sizeof(int)) ? m_exp : size+sizeof(int));
-        address = find(size);
+        address = find(size, segsize);
     }
 
     // ------------------------------------------------------------------------
@@ -179,7 +269,7 @@ int SegFMemory::allocate(void* a_content, const int a_size)
     // ------------------------------------------------------------------------
     // release unsed portion of the segment as a segment
     // ------------------------------------------------------------------------
-    split(address, a_size);
+    split(address, a_size, segsize);
     return address + sizeof(int);
 }
 
@@ -188,62 +278,133 @@ void SegFMemory::free(int a_pos)
     // ------------------------------------------------------------------------
     // release memory for later use
     // ------------------------------------------------------------------------
+    m_dirty = true;
     int sz = 0;
     fseek(m_memfile, a_pos - sizeof(int), SEEK_SET);
     fread((char*)&sz, sizeof(int),1,m_memfile);
     maintain(a_pos-sizeof(int),sz);
 }
 
+// a record rewritten in place if its segment holds the content: the segment
+// keeps its size, so a record that shrinks may grow back in place
+int SegFMemory::reallocate(int a_pos, void* a_content, const int a_size)
+{
+    int sz = 0;
+    fseek(m_memfile, a_pos - sizeof(int), SEEK_SET);
+    fread((char*)&sz, sizeof(int),1,m_memfile);
+    if (sz < a_size)
+    {
+        free(a_pos);
+        return allocate(a_content, a_size);
+    }
+    m_dirty = true;
+    fseek(m_memfile, a_pos, SEEK_SET);
+    fwrite((char*)a_content, sizeof(char)*a_size, 1, m_memfile);
+    return a_pos;
+}
+
 // ----------------------------------------------------------------------------
-int SegFMemory::find(const int a_size)
+// the free list of the file into m_free, once
+// ----------------------------------------------------------------------------
+void SegFMemory::loadFree()
 {
-    // logic: largest block strategy
-    // 1. scan the free list for a free block whose block size is the largest
-    // 2. start from freelistheader
-    // 3. best is the address to the candidate
-    // 4. ptrbest is the point to the address to the candidate (used to
-    //    maintain free list)
-    // 5. return NIL if no good candidate is found
-    // 6. return the address and update the freelist
-    //
-    int smallest = -1;
-    int bref= -1;
+    if (m_freeloaded) return;
+    m_freeloaded = true;
     int ref = m_freelistheader;
-    int best=NIL;
-    int bbest=NIL;
-    while (ref != NIL)
+    while (ref != NIL && ref > 0 && m_free.find(ref) == m_free.end())
     {
         int sz = 0;
         fseek(m_memfile, ref, SEEK_SET);
         fread(&sz, sizeof(int), 1, m_memfile);
-        if (sz >= a_size && (sz < smallest || smallest == -1))
-        {
-            smallest = sz;
-            best = ref;
-            bbest = bref;
-        }
-        bref = ref;
+        insertFree(ref, sz);
         fread((char*)&ref, sizeof(int), 1, m_memfile);
-        if ((ref != -1 && ref < 0) || ref == bref)
-        {
-            int debug=10;
-        }
     }
-    if (best == NIL) return NIL;
+    m_freechanged = false;
+}
 
-    // make the previous free segment points to the next segment
-    int nextptr;
-    fseek(m_memfile, best+sizeof(int), SEEK_SET);
-    fread((char*)&nextptr,sizeof(int),1,m_memfile);
-    if (bbest == -1)
+// ----------------------------------------------------------------------------
+// m_free as the free list of the file: size and next pointer of each segment
+// ----------------------------------------------------------------------------
+void SegFMemory::storeFree()
+{
+    if (!m_freechanged) return;
+    m_freechanged = false;
+    m_freelistheader = m_free.empty() ? NIL : m_free.begin()->first;
+    for (std::map<int,int>::iterator it = m_free.begin(); it != m_free.end(); ++it)
+    {
+        std::map<int,int>::iterator next = it;
+        ++next;
+        int nextptr = next == m_free.end() ? NIL : next->first;
+        fseek(m_memfile, it->first, SEEK_SET);
+        fwrite((char*)&it->second, sizeof(int), 1, m_memfile);
+        fwrite((char*)&nextptr, sizeof(int), 1, m_memfile);
+    }
+}
+
+void SegFMemory::insertFree(const int a_address, const int a_size)
+{
+    m_free[a_address] = a_size;
+    m_bysize.insert(std::make_pair(a_size, a_address));
+    m_freechanged = true;
+}
+
+void SegFMemory::eraseFree(const int a_address)
+{
+    std::map<int,int>::iterator it = m_free.find(a_address);
+    m_bysize.erase(std::make_pair(it->second, a_address));
+    m_free.erase(it);
+    m_freechanged = true;
+}
+
+// ----------------------------------------------------------------------------
+int SegFMemory::find(const int a_size, int& a_segsize)
+{
+    // logic: smallest block that fits(the last block in append mode)
+    // 1. look the size up in m_bysize
+    // 2. return NIL if no good candidate is found
+    // 3. return the address and its size, out of the free list
+    //
+    loadFree();
+    int best = NIL;
+    if (m_append)
     {
-        m_freelistheader = nextptr;
+        std::map<int,int>::reverse_iterator last = m_free.rbegin();
+        if (last != m_free.rend() &&
+            last->first + last->second + (int)sizeof(int) == m_memsize + (int)sizeof(Header))
+        {
+            // a record that would cross a page boundary starts on the next
+            // page, the gap stays free(a page more if too short for a segment)
+            int address = last->first;
+            int segsize = last->second;
+            int gap = 0;
+            int need = a_size + sizeof(int);
+            if (m_align > 0 && need <= m_align && address % m_align + need > m_align)
+            {
+                gap = m_align - address % m_align;
+                if (gap < 2*(int)sizeof(int)) gap += m_align;
+            }
+            if (segsize - gap >= a_size)
+            {
+                best = address + gap;
+                if (gap > 0)
+                {
+                    eraseFree(address);
+                    insertFree(address, gap - sizeof(int));
+                    insertFree(best, segsize - gap);
+                }
+            }
+        }
     }
     else
     {
-        fseek(m_memfile, bbest+sizeof(int), SEEK_SET); 
-        fwrite((char*)&nextptr,sizeof(int), 1, m_memfile);
+        std::set<std::pair<int,int> >::iterator it =
+            m_bysize.lower_bound(std::make_pair(a_size, NIL));
+        if (it != m_bysize.end())
+            best = it->second;
     }
+    if (best == NIL) return NIL;
+    a_segsize = m_free[best];
+    eraseFree(best);
     return best;
 }
 
@@ -261,11 +422,6 @@ void SegFMemory::expand(const int a_size)
     for (int x=0; x<a_size; x+=m_minsize)
         fwrite(m_buffer, m_minsize, 1, m_memfile);
 
-    //
-    fseek(m_memfile,m_memsize + sizeof(Header), SEEK_SET);
-    int segsize = a_size - sizeof(int);
-    fwrite((char*)&segsize, sizeof(int), 1, m_memfile);
-    
     //
     maintain(m_memsize + sizeof(Header),a_size-sizeof(int));
 
@@ -273,103 +429,62 @@ void SegFMemory::expand(const int a_size)
     m_memsize += a_size;
 }
 
-void SegFMemory::split(const int a_address, const int a_size)
+// ----------------------------------------------------------------------------
+// size of the allocated segment to the file, the part beyond a_size a free
+// segment if it is larger than the min. allocation
+// ----------------------------------------------------------------------------
+void SegFMemory::split(const int a_address, const int a_size, const int a_segsize)
 {
-    fseek(m_memfile,a_address,SEEK_SET);
-    int segsize=0;
-    fread((char*)&segsize, sizeof(int), 1, m_memfile);
-
-    if (segsize - a_size > m_minsize)
+    int segsize = a_segsize;
+    if (a_segsize - a_size > m_minsize)
     {
-        // adjust the segment
-        int adjustsize = a_size;
-        fseek(m_memfile,a_address, SEEK_SET);
-        fwrite((char*)&adjustsize,sizeof(int), 1, m_memfile);
-
         // spawn a new segment
+        segsize = a_size;
         int newaddress =
             a_address + a_size + sizeof(int);
-        int newsize = segsize - a_size - sizeof(int);
-        fseek(m_memfile,newaddress,SEEK_SET);
-        fwrite((char*)&newsize, sizeof(int), 1, m_memfile);
-        //m_memfile.write((char*)&m_freelistheader, sizeof(int));
-        //m_freelistheader = newaddress;
+        int newsize = a_segsize - a_size - sizeof(int);
         maintain(newaddress,newsize);
     }
+    fseek(m_memfile,a_address, SEEK_SET);
+    fwrite((char*)&segsize,sizeof(int), 1, m_memfile);
 }
 
+// ----------------------------------------------------------------------------
+// put a free segment in the free list(by address), merged with the free
+// segments right before and after it
+// ----------------------------------------------------------------------------
 void SegFMemory::maintain(const int a_address, const int a_size)
 {
-    if (m_freelistheader == -1 || m_freelistheader > a_address)
+    loadFree();
+    int address = a_address;
+    int size = a_size;
+    std::map<int,int>::iterator next = m_free.lower_bound(a_address);
+    if (next != m_free.end() && next->first == (int)(a_address + a_size + sizeof(int)))
     {
-        fseek(m_memfile,a_address + sizeof(int),SEEK_SET);
-        fwrite((char*)&m_freelistheader, sizeof(int), 1, m_memfile);
-        m_freelistheader = a_address;
-        return;
+        size += sizeof(int) + next->second;
+        eraseFree(next->first);
     }
-
-    int pointer = m_freelistheader;
-    while (pointer < a_address)
+    next = m_free.lower_bound(a_address);
+    if (next != m_free.begin())
     {
-        int size = 0;
-        int next = 0;
-        fseek(m_memfile,pointer,SEEK_SET);
-        fread((char*)&size,sizeof(int),1,m_memfile);
-        if (pointer + size + sizeof(int) == a_address)
-        {
-            size += sizeof(int)+a_size;
-            fseek(m_memfile,pointer,SEEK_SET);
-            fwrite((char*)&size,sizeof(int), 1, m_memfile);
-            return;
-        }
-
-        fread((char*)&next,sizeof(int),1,m_memfile);
-        if (next == a_address + a_size + sizeof(int))
-        {
-            fseek(m_memfile,next,SEEK_SET);
-            int nextsize=0;
-            int nextnext=0;
-            fread((char*)&nextsize,sizeof(int),1,m_memfile);
-            fread((char*)&nextnext,sizeof(int),1,m_memfile);
-
-            // point to new free block
-            fseek(m_memfile,pointer+sizeof(int),SEEK_SET);
-            fwrite((char*)&a_address,sizeof(int), 1, m_memfile);
-            //
-            int newsize = a_size + sizeof(int) + nextsize;
-            fseek(m_memfile,a_address,SEEK_SET);
-            fwrite((char*)&newsize, sizeof(int), 1, m_memfile);
-            fwrite((char*)&nextnext, sizeof(int), 1, m_memfile);
-            return;
-        }
-        if (next == -1 || next > a_address)
+        std::map<int,int>::iterator prev = next;
+        --prev;
+        if (prev->first + prev->second + (int)sizeof(int) == a_address)
         {
-            // point to new free block
-            fseek(m_memfile,pointer+sizeof(int),SEEK_SET);
-            fwrite((char*)&a_address, sizeof(int), 1, m_memfile);
-            //
-            fseek(m_memfile,a_address+sizeof(int),SEEK_SET);
-            fwrite((char*)&next, sizeof(int), 1, m_memfile);
-            return;
+            address = prev->first;
+            size += sizeof(int) + prev->second;
+            eraseFree(prev->first);
         }
-        pointer = next;
     }
+    insertFree(address, size);
 }
 
 int SegFMemory::checkfreespace()
 {
+    loadFree();
     int freesize = 0;
-    int ptr = m_freelistheader;
-    while (ptr != -1)
-    {
-        int sz,next;
-        fseek(m_memfile,ptr,SEEK_SET);
-        fread((char*)&sz, sizeof(int),1,m_memfile);
-        fread((char*)&next, sizeof(int),1,m_memfile);
-
-        freesize += sz + sizeof(int);
-        ptr = next;
-    }
+    for (std::map<int,int>::iterator it = m_free.begin(); it != m_free.end(); ++it)
+        freesize += it->second + sizeof(int);
     return freesize;
 }
 
@@ -378,3 +493,31 @@ int SegFMemory::size() const
     return m_memsize;
 }
 
+void SegFMemory::setAppend(const bool a_append)
+{
+    m_append = a_append;
+}
+
+void SegFMemory::setAlign(const int a_pagesize)
+{
+    m_align = a_pagesize;
+}
+
+void SegFMemory::setPool(PagePool* a_pool)
+{
+    fflush(m_memfile);
+    m_pool = a_pool;
+    m_dirty = true;
+}
+
+// the whole record if its size is in the pool, else the page of its size
+void SegFMemory::prefetch(int a_pos)
+{
+    if (m_pool == 0 || !m_pool->isAsync()) return;
+    std::lock_guard<std::mutex> lock(m_readlock);
+    if (m_dirty) return;                // the next read cleans the pool
+    int size = 0;
+    if (!m_pool->peek(a_pos - sizeof(int), (char*)&size, sizeof(size)) || size < 0)
+        size = 1;
+    m_pool->prefetch(a_pos - sizeof(int), sizeof(int) + size);
+}
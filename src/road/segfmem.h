@@ -6,13 +6,22 @@
 
     This library contains a class SegmentFileMemory declaration.
     It provides facility to read/allocate/free a record of any size in a file.
+    A thread that bound its history(SegMemory::bindHistory) reads with pread
+    into a buffer of its own, so such threads may read at the same time.
+    The free list is read once(first allocate/free) and kept in memory, by
+    address and by size, then written back to the file on destruction.
 ---------------------------------------------------------------------------- */
 #ifndef segfmem_defined
 #define segfmem_defined
 
 #include <stdio.h>
+#include <mutex>
+#include <map>
+#include <set>
 #include "segmem.h"
 
+class PagePool;
+
 class SegFMemory: public SegMemory
 {
 protected:
@@ -24,11 +33,25 @@ protected:
     char*   m_buffer;
     int     m_buflen;
     bool    m_newfile;
+    PagePool*   m_pool;         // page buffer pool for reads(0: stdio)
+    bool    m_dirty;            // written since the pool was filled
+    std::mutex  m_readlock;     // the pool and m_dirty for threaded reads
+    std::map<int,int>   m_free;     // free segments: address -> size
+    std::set<std::pair<int,int> > m_bysize; // (size, address) of m_free
+    bool    m_freeloaded;       // m_free read from the file
+    bool    m_freechanged;      // m_free differs from the file's free list
+    bool    m_append;           // allocate at the end only(setAppend)
+    int     m_align;            // append: page a record is kept in(setAlign)
 
-    int find(const int a_size);
+    void loadFree();
+    void storeFree();
+    void insertFree(const int a_address, const int a_size);
+    void eraseFree(const int a_address);
+    int find(const int a_size, int& a_segsize);
     void expand(const int a_size);
-    void split(const int a_address, const int a_size);
+    void split(const int a_address, const int a_size, const int a_segsize);
     void maintain(const int a_address, const int a_size);
+    void* readShared(int a_pos, Binding& a_binding);
 public:
     // constructor/destructor
     SegFMemory(
@@ -44,8 +67,24 @@ public:
     virtual void* read(int a_pos);
     virtual int allocate(void* a_content, const int a_size);
     virtual void free(int a_pos);
+    virtual int reallocate(int a_pos, void* a_content, const int a_size);
     int checkfreespace();
     //
+    // bulk load: every record after the last one, free space is not reused
+    void setAppend(const bool a_append);
+    //
+    // with append: a record that fits in a page of a_pagesize(0 to stop)
+    // does not cross a page boundary, it starts on the next page instead
+    void setAlign(const int a_pagesize);
+    //
+    // read through a page pool of this file(not owned, 0 to stop)
+    void setPool(PagePool* a_pool);
+    //
+    // the pages of a record into the pool ahead of the read(the first only
+    // if its size is not in the pool yet), if the pool is async
+    // (PagePool::setAsync)
+    virtual void prefetch(int a_pos);
+    //
     virtual int size() const;
 };
 
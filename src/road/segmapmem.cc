@@ -0,0 +1,154 @@
+/* ----------------------------------------------------------------------------
+    SegMapMemory: read-only memory mapped index file.
+---------------------------------------------------------------------------- */
+
+#include "segmapmem.h"
+#include "segfmem.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+#define NIL -1
+
+// file header as written by SegFMemory
+typedef struct
+{
+    int m_nodehash;
+    int m_freelist;
+    int m_memsize;
+} Header;
+
+// constructor/destructor
+SegMapMemory::SegMapMemory(const char* a_fname, const int a_advice):
+m_map(0),
+m_maplen(0),
+m_memsize(0)
+{
+    // ------------------------------------------------------------------------
+    // map the whole file, the descriptor is not needed afterwards
+    // ------------------------------------------------------------------------
+    int fd = ::open(a_fname, O_RDONLY);
+    if (fd == -1) return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= (long)sizeof(Header))
+    {
+        if (a_advice == PRELOAD)
+            preload(fd, st.st_size);
+        else
+        {
+            void* p = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (p != MAP_FAILED)
+            {
+                m_map = (char*)p;
+                m_maplen = st.st_size;
+            }
+        }
+    }
+    close(fd);
+    if (m_map == 0) return;
+
+    // ------------------------------------------------------------------------
+    // access pattern
+    // ------------------------------------------------------------------------
+    int adv = MADV_RANDOM;
+    if (a_advice == NORMAL)     adv = MADV_NORMAL;
+    if (a_advice == SEQUENTIAL) adv = MADV_SEQUENTIAL;
+    if (a_advice == WILLNEED)   adv = MADV_WILLNEED;
+    if (a_advice != PRELOAD)
+        madvise(m_map, m_maplen, adv);
+
+    Header* hdr = (Header*)m_map;
+    m_header    = hdr->m_nodehash;
+    m_memsize   = hdr->m_memsize;
+}
+
+// ----------------------------------------------------------------------------
+// the whole file read once, in order, into anonymous memory: queries then
+// never touch the file or the page cache(cold and warm runs measure apart)
+// ----------------------------------------------------------------------------
+void SegMapMemory::preload(const int a_fd, const long a_len)
+{
+    void* p = mmap(0, a_len, PROT_READ|PROT_WRITE,
+                   MAP_PRIVATE|MAP_ANONYMOUS|MAP_POPULATE, -1, 0);
+    if (p == MAP_FAILED) return;
+    long done = 0;
+    while (done < a_len)
+    {
+        ssize_t n = ::read(a_fd, (char*)p + done, a_len - done);
+        if (n <= 0) break;
+        done += n;
+    }
+    if (done < a_len)
+    {
+        munmap(p, a_len);
+        return;
+    }
+    mprotect(p, a_len, PROT_READ);
+    m_map = (char*)p;
+    m_maplen = a_len;
+}
+
+SegMapMemory::~SegMapMemory()
+{
+    if (m_map != 0)
+        munmap(m_map, m_maplen);
+}
+
+// read/allocate/free
+void* SegMapMemory::read(int a_pos)
+{
+    // ------------------------------------------------------------------------
+    // the segment in place: size, then content
+    // ------------------------------------------------------------------------
+    int start = a_pos - sizeof(int);
+    if (m_map == 0 || start < 0 || a_pos > m_maplen)
+        return 0;
+    int size = *(int*)&m_map[start];
+
+    // ------------------------------------------------------------------------
+    // update the access history
+    // ------------------------------------------------------------------------
+    history().append(start, start + size + sizeof(int));
+    return &m_map[a_pos];
+}
+
+int SegMapMemory::allocate(void* a_content, const int a_size)
+{
+    return NIL;             // read-only
+}
+
+void SegMapMemory::free(int a_pos)
+{
+}
+
+int SegMapMemory::size() const
+{
+    return m_memsize;
+}
+
+bool SegMapMemory::isOpen() const
+{
+    return m_map != 0;
+}
+
+int SegMapMemory::advice(const char* a_name)
+{
+    if (strcmp(a_name, "normal") == 0)      return NORMAL;
+    if (strcmp(a_name, "random") == 0)      return RANDOM;
+    if (strcmp(a_name, "sequential") == 0)  return SEQUENTIAL;
+    if (strcmp(a_name, "willneed") == 0)    return WILLNEED;
+    if (strcmp(a_name, "preload") == 0)     return PRELOAD;
+    return -1;
+}
+
+SegMemory* SegMapMemory::open(const char* a_fname, const char* a_advice,
+                              const int a_initsize, const int a_exp,
+                              const int a_minsize)
+{
+    int adv = advice(a_advice);
+    if (adv == -1)
+        return new SegFMemory(a_fname, a_initsize, a_exp, a_minsize, false);
+    return new SegMapMemory(a_fname, adv);
+}
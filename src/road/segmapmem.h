@@ -0,0 +1,53 @@
+/* ----------------------------------------------------------------------------
+    This file contains a class SegmentMapMemory declaration.
+    It reads records of an index file(written by SegFMemory) through a
+    read-only memory mapping of the file.
+
+    - read() returns a pointer into the mapping: no copy, no buffer, so
+      readers on several threads do not clobber each other(each appends to
+      its own history, bindHistory, for IOMeasure)
+    - the mapping is advised to the kernel as normal, random(default, the
+      searches hop between nodes), sequential or willneed(prefetch all)
+    - preload reads the whole file into memory once at open instead of
+      mapping it, read() is then a pointer offset that never waits on I/O
+    - allocate/free do nothing: the index destructors that rewrite their
+      header leave the file as it is
+---------------------------------------------------------------------------- */
+#ifndef segmapmem_defined
+#define segmapmem_defined
+
+#include "segmem.h"
+
+class SegMapMemory: public SegMemory
+{
+protected:
+    char*   m_map;              // mapping of the whole file(0 if failed)
+    long    m_maplen;           // length of the mapping
+    int     m_memsize;          // bound of memory(from the header)
+    void preload(const int a_fd, const long a_len);
+public:
+    enum Advice { NORMAL, RANDOM, SEQUENTIAL, WILLNEED, PRELOAD };
+    // constructor/destructor
+    SegMapMemory(const char* a_fname, const int a_advice=RANDOM);
+    virtual ~SegMapMemory();
+    //
+    // read/allocate/free
+    virtual void* read(int a_pos);
+    virtual int allocate(void* a_content, const int a_size);
+    virtual void free(int a_pos);
+    //
+    virtual int size() const;
+    bool isOpen() const;
+    //
+    // advice by name("normal", "random", "sequential", "willneed",
+    // "preload"), -1 if the name is none of them
+    static int advice(const char* a_name);
+    //
+    // an index file for queries: mapped if a_advice names an advice,
+    // else(a_advice is "") a SegFMemory with the given sizes as before
+    static SegMemory* open(
+        const char* a_fname, const char* a_advice,
+        const int a_initsize, const int a_exp, const int a_minsize);
+};
+
+#endif
@@ -6,17 +6,46 @@
 
     This library contains an abstract SegmentMemory class declaration.
     It provides facilities to read/allocate/free space for records of any size.
+
+    Reads may run on several threads at once(allocate/free may not): a
+    thread that binds its own access history records its reads there and
+    gets its own read buffer, the histories are merged into m_history
+    (Access::append) for a report.
 ---------------------------------------------------------------------------- */
 #ifndef segmem_defined
 #define segmem_defined
 
 #include "access.h"
+#include <vector>
 
 class SegMemory
 {
 public:
     int     m_header;       // position of header infomation
-    Access  m_history;      // access history
+    Access  m_history;      // access history(threads without their own)
+protected:
+    // ------------------------------------------------------------------------
+    // what a thread bound for a memory: its history and read buffer
+    // ------------------------------------------------------------------------
+    class Binding
+    {
+    public:
+        const SegMemory*    m_mem;
+        Access*             m_history;
+        std::vector<char>   m_buffer;
+    };
+    static std::vector<Binding>& bindings()
+    {
+        static thread_local std::vector<Binding> b;
+        return b;
+    };
+    Binding* binding() const    // of the calling thread, 0 if none
+    {
+        std::vector<Binding>& b = bindings();
+        for (int i=0; i<(int)b.size(); i++)
+            if (b[i].m_mem == this) return &b[i];
+        return 0;
+    };
 public:
     // constructor/destructor
     SegMemory(): m_header(-1) {};
@@ -26,6 +55,39 @@ public:
     virtual void* read(int a_pos)=0;
     virtual int allocate(void* a_content, const int a_size)=0;
     virtual void free(int a_pos)=0;
+    virtual int reallocate(int a_pos, void* a_content, const int a_size)
+    {
+        free(a_pos);                    // the record moves
+        return allocate(a_content, a_size);
+    };
+    //
+    virtual int size() const=0;     // bound of memory
+    //
+    // a hint: the record at a_pos is read soon(SegFMemory with an async page
+    // pool starts reading it), nothing by default
+    virtual void prefetch(int a_pos) {};
+    //
+    // access history of the calling thread: a_history(owned by the caller)
+    // until bound to 0, m_history for a thread that has bound none
+    void bindHistory(Access* a_history)
+    {
+        std::vector<Binding>& b = bindings();
+        for (int i=0; i<(int)b.size(); i++)
+            if (b[i].m_mem == this)
+            {
+                b.erase(b.begin() + i);
+                break;
+            }
+        if (a_history == 0) return;
+        b.push_back(Binding());
+        b.back().m_mem = this;
+        b.back().m_history = a_history;
+    };
+    Access& history()
+    {
+        Binding* b = binding();
+        return b != 0 ? *b->m_history : m_history;
+    };
 };
 
 #endif
@@ -134,3 +134,8 @@ void SegMMemory::split(Segment* a_seg, const int a_size)
         m_freelistheader = address;
     }
 }
+
+int SegMMemory::size() const
+{
+    return m_memsize;
+}
@@ -46,6 +46,8 @@ public:
     virtual void* read(int a_pos);
     virtual int allocate(void* a_content, const int a_size);
     virtual void free(int a_pos);
+    //
+    virtual int size() const;
 };
 
 #endif
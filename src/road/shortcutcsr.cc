@@ -0,0 +1,168 @@
+/* ----------------------------------------------------------------------------
+    ShortcutCSR: compact(flattened) shortcut trees of BorderNode records.
+---------------------------------------------------------------------------- */
+
+#include "shortcutcsr.h"
+#include "bordernode.h"
+#include "shortcuttreenode.h"
+#include "edge.h"
+#include <vector>
+
+// constructor/destructor
+ShortcutCSR::ShortcutCSR():
+m_mem(0), m_subnet(0), m_child(0), m_link(0), m_links(0),
+m_nodes(0), m_roots(0)
+{}
+
+ShortcutCSR::ShortcutCSR(const char* a_mem,
+                         const std::shared_ptr<const void>& a_keep):
+m_mem(a_mem), m_keep(a_keep)
+{
+    const int* h = (const int*)a_mem;
+    m_nodes = h[4];
+    m_roots = h[5];
+    m_subnet = h + 8;
+    m_child = m_subnet + m_nodes;
+    m_link = m_child + m_nodes + 1;
+    m_links = (const Link*)(m_link + m_nodes + 1);
+}
+
+// ----------------------------------------------------------------------------
+// layout
+// ----------------------------------------------------------------------------
+bool ShortcutCSR::isCompact(const char* a_mem)
+{
+    return ((const int*)a_mem)[3] == SHORTCUTCSR_TAG;
+}
+
+// tree nodes of a border node in breadth first order
+static void flatten(const BorderNode& a_bnode,
+                    std::vector<const ShortcutTreeNode*>& a_order,
+                    std::vector<int>& a_depth)
+{
+    const Array* a = &a_bnode.m_shortcuttree;
+    int parent = -1;
+    while (true)
+    {
+        int first = a_order.size();
+        for (int i=0; i<a->size(); i++)
+            a_order.push_back((const ShortcutTreeNode*)a->get(i));
+        for (int i=first; i<(int)a_order.size(); i++)
+            a_depth.push_back(parent == -1 ? 1 : a_depth[parent]+1);
+        if (++parent >= (int)a_order.size())
+            break;
+        a = &a_order[parent]->m_child;
+    }
+}
+
+int ShortcutCSR::size(const BorderNode& a_bnode)
+{
+    std::vector<const ShortcutTreeNode*> order;
+    std::vector<int> d;
+    flatten(a_bnode, order, d);
+    int links = 0;
+    for (int i=0; i<(int)order.size(); i++)
+        links += order[i]->m_edges.size();
+    return SHORTCUTCSR_HEADER + sizeof(int)*(3*order.size() + 2) +
+        sizeof(Link)*links;
+}
+
+void ShortcutCSR::toMem(const BorderNode& a_bnode, char* a_mem, int& a_len)
+{
+    std::vector<const ShortcutTreeNode*> order;
+    std::vector<int> d;
+    flatten(a_bnode, order, d);
+    int nodes = order.size();
+    int links = 0;
+    for (int i=0; i<nodes; i++)
+        links += order[i]->m_edges.size();
+
+    // ------------------------------------------------------------------------
+    // header
+    // ------------------------------------------------------------------------
+    int* h = (int*)&a_mem[a_len];
+    h[0] = a_bnode.m_id;
+    *(float*)&h[1] = a_bnode.m_x;
+    *(float*)&h[2] = a_bnode.m_y;
+    h[3] = SHORTCUTCSR_TAG;
+    h[4] = nodes;
+    h[5] = a_bnode.m_shortcuttree.size();
+    h[6] = links;
+    h[7] = d.empty() ? 0 : d.back();
+
+    // ------------------------------------------------------------------------
+    // subnets, child and link offsets: breadth first, so the children of
+    // node i follow those of node i-1
+    // ------------------------------------------------------------------------
+    int* subnet = h + 8;
+    int* child = subnet + nodes;
+    int* link = child + nodes + 1;
+    Link* l = (Link*)(link + nodes + 1);
+    int c = h[5];
+    int e = 0;
+    for (int i=0; i<nodes; i++)
+    {
+        const ShortcutTreeNode* sc = order[i];
+        subnet[i] = sc->m_subnetid;
+        child[i] = c;
+        c += sc->m_child.size();
+        link[i] = e;
+        for (int j=0; j<sc->m_edges.size(); j++, e++)
+        {
+            const Edge* edge = &sc->m_edges[j];
+            l[e].m_neighbor = edge->m_neighbor;
+            l[e].m_cost = edge->m_cost;
+        }
+    }
+    child[nodes] = c;
+    link[nodes] = e;
+    a_len += (char*)(l + links) - (char*)h;
+}
+
+void ShortcutCSR::toBorderNode(BorderNode& a_bnode) const
+{
+    const int* h = (const int*)m_mem;
+    a_bnode.m_id = h[0];
+    a_bnode.m_x = *(const float*)&h[1];
+    a_bnode.m_y = *(const float*)&h[2];
+    a_bnode.m_isBorder = m_roots > 1;
+    std::vector<ShortcutTreeNode*> n(m_nodes);
+    for (int i=0; i<m_nodes; i++)
+    {
+        n[i] = new ShortcutTreeNode(m_subnet[i]);
+        if (childEnd(i) - childBegin(i) > 1) a_bnode.m_isBorder = true;
+        for (int j=linkBegin(i); j<linkEnd(i); j++)
+        {
+            n[i]->m_edges.append(Edge(m_links[j].m_neighbor, m_links[j].m_cost));
+            a_bnode.m_numlinks++;                   // record the number of links
+            if (m_subnet[i] == 0)                   // record the original edges
+                a_bnode.m_edges.append(Edge(m_links[j].m_neighbor, m_links[j].m_cost));
+        }
+    }
+    for (int i=0; i<m_roots; i++)
+        a_bnode.m_shortcuttree.append(n[i]);
+    for (int i=0; i<m_nodes; i++)
+        for (int j=childBegin(i); j<childEnd(i); j++)
+            n[i]->m_child.append(n[j]);
+}
+
+// ----------------------------------------------------------------------------
+// search: a scan of each level's siblings(a few per level)
+// ----------------------------------------------------------------------------
+int ShortcutCSR::find(const int* a_subnet, const int a_cnt) const
+{
+    int b = 0, e = m_roots;
+    int found = -1;
+    for (int level=0; level<a_cnt; level++)
+    {
+        found = -1;
+        for (int i=b; i<e && found==-1; i++)
+            if (m_subnet[i] == a_subnet[level])
+                found = i;
+        if (found == -1)
+            return -1;
+        b = childBegin(found);
+        e = childEnd(found);
+    }
+    return found;
+}
@@ -0,0 +1,89 @@
+/* ----------------------------------------------------------------------------
+    This file contains a class ShortcutCSR declaration.
+    It is a read only view of a BorderNode record in the compact layout: the
+    shortcut tree flattened so it is walked in place(from a mapped or read
+    buffer) with no unmarshalling and no allocation.
+
+    record(4 byte words):
+        id, x, y                    as in the tree layout
+        tag(-1), #nodes, #roots, #links, depth
+        subnet[#nodes]              subnet id of each tree node
+        child[#nodes+1]             children of node i: [child[i], child[i+1])
+        link[#nodes+1]              edges of node i: [link[i], link[i+1])
+        (neighbor, cost)[#links]    one block of edges
+
+    - tree nodes are in breadth first order, so the children of a node are
+      contiguous, the roots are nodes [0, #roots); siblings keep the order of
+      the tree layout(the first root is the subnet of the node itself, the
+      object mappings of hiernn and bench_nn follow it)
+    - the tree layout has the number of roots(>= 0) after id, x, y, the tag
+      tells the two apart
+    - walks keep a stack of one sibling range per level: trees are at most
+      MAXDEPTH deep(the levels of the partition, see hiergraphloader)
+---------------------------------------------------------------------------- */
+#ifndef shortcutcsr_defined
+#define shortcutcsr_defined
+
+#include <memory>
+
+#define SHORTCUTCSR_TAG     -1
+#define SHORTCUTCSR_HEADER  (sizeof(int)*8)
+
+class BorderNode;
+
+class ShortcutCSR
+{
+public:
+    static const int MAXDEPTH = 32;     // the bound of a walk stack
+    class Link                          // an edge in the record
+    {
+    public:
+        int     m_neighbor;
+        float   m_cost;
+    };
+protected:
+    const char*     m_mem;      // the record
+    const int*      m_subnet;
+    const int*      m_child;
+    const int*      m_link;
+    const Link*     m_links;
+    int             m_nodes;
+    int             m_roots;
+    std::shared_ptr<const void> m_keep;     // holds the record if not 0
+public:
+    // constructor/destructor
+    ShortcutCSR();
+    ShortcutCSR(const char* a_mem, const std::shared_ptr<const void>& a_keep=
+        std::shared_ptr<const void>());
+    //
+    // layout
+    static bool isCompact(const char* a_mem);
+    static int size(const BorderNode& a_bnode);
+    static void toMem(const BorderNode& a_bnode, char* a_mem, int& a_len);
+    void toBorderNode(BorderNode& a_bnode) const;   // the tree layout decoded
+    //
+    // info
+    const char* record() const      { return m_mem; };
+    int length() const              // bytes of the record
+    {
+        return SHORTCUTCSR_HEADER + sizeof(int)*(3*m_nodes + 2) +
+            sizeof(Link)*m_link[m_nodes];
+    };
+    int id() const                  { return *(const int*)m_mem; };
+    int nodes() const               { return m_nodes; };
+    int roots() const               { return m_roots; };
+    int depth() const               { return ((const int*)m_mem)[7]; };
+    //
+    // tree: node i
+    int subnet(const int a_i) const         { return m_subnet[a_i]; };
+    int childBegin(const int a_i) const     { return m_child[a_i]; };
+    int childEnd(const int a_i) const       { return m_child[a_i+1]; };
+    int linkBegin(const int a_i) const      { return m_link[a_i]; };
+    int linkEnd(const int a_i) const        { return m_link[a_i+1]; };
+    const Link* link(const int a_j) const   { return &m_links[a_j]; };
+    //
+    // the node of a subnet path from a root(-1 if none)
+    int find(const int* a_subnet, const int a_cnt) const;
+};
+
+#endif
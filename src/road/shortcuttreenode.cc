@@ -10,14 +10,11 @@
 
 ShortcutTreeNode::ShortcutTreeNode(const int a_subnetid):
 m_subnetid(a_subnetid),
-m_child(2,2),
-m_edges(5,5)
+m_child(2,2)
 {}
 
 ShortcutTreeNode::~ShortcutTreeNode()
 {
-    for (int i=0; i<m_edges.size(); i++)
-        delete (Edge*)m_edges.get(i);
     for (int i=0; i<m_child.size(); i++)
         delete (ShortcutTreeNode*)m_child.get(i);
 }
@@ -17,12 +17,14 @@
 //    this organizes shortcuts in different level of a graph as a tree.
 
 #include "collection.h"
+#include "smallarray.h"
+#include "edge.h"
 
 class ShortcutTreeNode
 {
 public:
     const int   m_subnetid;
-    Array       m_edges;        // edges to neighboring bordernodes/nodes
+    SmallArray<Edge,4>  m_edges;    // edges to neighboring bordernodes/nodes
     Array       m_child;        // child shortcut
 public:
     ShortcutTreeNode(const int a_subnetid);
@@ -0,0 +1,139 @@
+/* ----------------------------------------------------------------------------
+    This file contains a class template SmallArray declaration.
+    It keeps items of one type by value, not as (void*) like Collection::Array:
+    * the first N items live in the object itself, no allocation for them
+    * beyond that the space doubles, appends take amortized constant time
+    * it moves(the heap space changes hands) as well as copies
+---------------------------------------------------------------------------- */
+#ifndef smallarray_defined
+#define smallarray_defined
+
+#include <new>
+#include <utility>
+
+namespace Collection
+{
+    //-------------------------------------------------------------------------
+    //
+    // class SmallArray
+    // an array of T with room for N of them inline
+    //
+    template<class T, int N>
+    class SmallArray
+    {
+    // data members
+    protected:
+        T*      m_p;        // the items: m_buf until they outgrow it
+        int     m_max;      // no. of items
+        int     m_lim;      // room at m_p
+        alignas(T) char m_buf[N*sizeof(T)];
+    // methods
+    public:
+        // constructor/destructor
+        SmallArray(): m_p((T*)m_buf), m_max(0), m_lim(N) {};
+        SmallArray(const SmallArray& a_v): m_p((T*)m_buf), m_max(0), m_lim(N)
+            { copy(a_v); };
+        SmallArray(SmallArray&& a_v): m_p((T*)m_buf), m_max(0), m_lim(N)
+            { take(a_v); };
+        ~SmallArray()
+            { clean(); release(); };
+        SmallArray& operator=(const SmallArray& a_v)
+        {
+            if (this != &a_v) { clean(); copy(a_v); }
+            return *this;
+        };
+        SmallArray& operator=(SmallArray&& a_v)
+        {
+            if (this != &a_v) { clean(); release(); take(a_v); }
+            return *this;
+        };
+        //
+        // update
+        int append(const T& a_t)
+        {
+            if (m_max == m_lim) grow(m_lim*2);
+            new(&m_p[m_max]) T(a_t);
+            return ++m_max;
+        };
+        int append(const SmallArray& a_v)   // all items of another
+        {
+            reserve(m_max + a_v.m_max);
+            for (int i=0; i<a_v.m_max; i++)
+                new(&m_p[m_max++]) T(a_v.m_p[i]);
+            return m_max;
+        };
+        int removeAt(const int a_i)         // the last item takes its place
+        {
+            if (a_i != m_max-1) m_p[a_i] = std::move(m_p[m_max-1]);
+            m_p[--m_max].~T();
+            return m_max;
+        };
+        int clean()
+        {
+            for (int i=0; i<m_max; i++) m_p[i].~T();
+            m_max = 0;
+            return m_max;
+        };
+        void reserve(const int a_lim)
+        {
+            if (a_lim > m_lim) grow(a_lim);
+        };
+        //
+        // search
+        int size() const                        { return m_max; };
+        T& get(const int a_i)                   { return m_p[a_i]; };
+        const T& get(const int a_i) const       { return m_p[a_i]; };
+        T& operator[](const int a_i)            { return m_p[a_i]; };
+        const T& operator[](const int a_i) const{ return m_p[a_i]; };
+        T* begin()                              { return m_p; };
+        T* end()                                { return m_p + m_max; };
+        const T* begin() const                  { return m_p; };
+        const T* end() const                    { return m_p + m_max; };
+    protected:
+        void grow(const int a_lim)
+        {
+            T* p = (T*)::operator new(sizeof(T)*a_lim);
+            for (int i=0; i<m_max; i++)
+            {
+                new(&p[i]) T(std::move(m_p[i]));
+                m_p[i].~T();
+            }
+            release();
+            m_p = p;
+            m_lim = a_lim;
+        };
+        void release()                          // back to the inline room
+        {
+            if (m_p != (T*)m_buf) ::operator delete(m_p);
+            m_p = (T*)m_buf;
+            m_lim = N;
+        };
+        void copy(const SmallArray& a_v)
+        {
+            reserve(a_v.m_max);
+            for (int i=0; i<a_v.m_max; i++)
+                new(&m_p[i]) T(a_v.m_p[i]);
+            m_max = a_v.m_max;
+        };
+        void take(SmallArray& a_v)              // this is empty and inline
+        {
+            if (a_v.m_p == (T*)a_v.m_buf)
+            {
+                for (int i=0; i<a_v.m_max; i++)
+                    new(&m_p[i]) T(std::move(a_v.m_p[i]));
+                m_max = a_v.m_max;
+                a_v.clean();
+                return;
+            }
+            m_p = a_v.m_p;
+            m_max = a_v.m_max;
+            m_lim = a_v.m_lim;
+            a_v.m_p = (T*)a_v.m_buf;
+            a_v.m_max = 0;
+            a_v.m_lim = N;
+        };
+    };
+    //-------------------------------------------------------------------------
+}
+
+#endif
@@ -6,13 +6,13 @@
 ---------------------------------------------------------------------------- */
 
 #include "spatialmap.h"
+#include <algorithm>
 
-const float* ObjectCoor::m_refx=0;
-const float* ObjectCoor::m_refy=0;
-int ObjectCoor::m_cnt=0;
+#define RTREE_FANOUT    16
 
 // constructor/destructor
-SpatialMapping::SpatialMapping()
+SpatialMapping::SpatialMapping():
+m_stale(false)
 {
     m_obj2node.clean();
 }
@@ -28,6 +28,7 @@ void SpatialMapping::addObject(const int a_objid, const int a_nodeid,
                                const float m_x, const float m_y)
 {
     m_obj2node.append(new ObjectCoor(a_objid, a_nodeid, m_x, m_y));
+    m_stale = true;
 }
 
 void SpatialMapping::delObject(const int a_objid)
@@ -39,25 +40,168 @@ void SpatialMapping::delObject(const int a_objid)
         {
             m_obj2node.remove(c);
             delete c;
+            m_stale = true;
             break;
         }
     }
 }
 
-const Array* SpatialMapping::distOrder(const float a_x, const float a_y)
+// ----------------------------------------------------------------------------
+// bulk loading
+// ----------------------------------------------------------------------------
+// sort-tile-recursive order of a_cnt items: sorted by x, cut into vertical
+// slices of sqrt(#groups) groups, each slice sorted by y
+template<class T, class X, class Y>
+static void strSort(T* a_items, const int a_cnt, X a_x, Y a_y)
 {
-    ObjectCoor::m_refx = &a_x;
-    ObjectCoor::m_refy = &a_y;
-    ObjectCoor::m_cnt = 1;
-    m_obj2node.sort(ObjectCoor::compare);
-    return &m_obj2node;
+    const int groups = (a_cnt + RTREE_FANOUT - 1) / RTREE_FANOUT;
+    const int slices = (int)ceil(sqrt((double)groups));
+    const int slice = ((groups + slices - 1) / slices) * RTREE_FANOUT;
+    std::sort(a_items, a_items + a_cnt, [&](const T& a0, const T& a1)
+    {
+        if (a_x(a0) != a_x(a1)) return a_x(a0) < a_x(a1);
+        return a_y(a0) < a_y(a1);
+    });
+    for (int i=0; i<a_cnt; i+=slice)
+        std::sort(a_items + i, a_items + std::min(i + slice, a_cnt),
+            [&](const T& a0, const T& a1)
+        {
+            if (a_y(a0) != a_y(a1)) return a_y(a0) < a_y(a1);
+            return a_x(a0) < a_x(a1);
+        });
+}
+
+void SpatialMapping::build()
+{
+    m_stale = false;
+    m_leaves.clear();
+    m_rtree.clear();
+    for (int i=0; i<m_obj2node.size(); i++)
+        m_leaves.push_back((ObjectCoor*)m_obj2node.get(i));
+    const int cnt = m_leaves.size();
+    if (cnt == 0) return;
+
+    // ------------------------------------------------------------------------
+    // leaves
+    // ------------------------------------------------------------------------
+    strSort(m_leaves.data(), cnt,
+        [](const ObjectCoor* c) { return c->m_x; },
+        [](const ObjectCoor* c) { return c->m_y; });
+    for (int i=0; i<cnt; i+=RTREE_FANOUT)
+    {
+        RNode n;
+        n.m_first = i;
+        n.m_last = std::min(i + RTREE_FANOUT, cnt);
+        n.m_leaf = true;
+        n.m_lower[0] = n.m_upper[0] = m_leaves[i]->m_x;
+        n.m_lower[1] = n.m_upper[1] = m_leaves[i]->m_y;
+        for (int j=n.m_first+1; j<n.m_last; j++)
+        {
+            n.m_lower[0] = std::min(n.m_lower[0], m_leaves[j]->m_x);
+            n.m_upper[0] = std::max(n.m_upper[0], m_leaves[j]->m_x);
+            n.m_lower[1] = std::min(n.m_lower[1], m_leaves[j]->m_y);
+            n.m_upper[1] = std::max(n.m_upper[1], m_leaves[j]->m_y);
+        }
+        m_rtree.push_back(n);
+    }
+
+    // ------------------------------------------------------------------------
+    // upper levels, each in STR order of the node centers, up to the root
+    // ------------------------------------------------------------------------
+    int lo = 0;
+    int hi = m_rtree.size();
+    while (hi - lo > 1)
+    {
+        strSort(m_rtree.data() + lo, hi - lo,
+            [](const RNode& n) { return n.m_lower[0] + n.m_upper[0]; },
+            [](const RNode& n) { return n.m_lower[1] + n.m_upper[1]; });
+        for (int i=lo; i<hi; i+=RTREE_FANOUT)
+        {
+            RNode n = m_rtree[i];
+            n.m_first = i;
+            n.m_last = std::min(i + RTREE_FANOUT, hi);
+            n.m_leaf = false;
+            for (int j=n.m_first+1; j<n.m_last; j++)
+                for (int d=0; d<2; d++)
+                {
+                    n.m_lower[d] = std::min(n.m_lower[d], m_rtree[j].m_lower[d]);
+                    n.m_upper[d] = std::max(n.m_upper[d], m_rtree[j].m_upper[d]);
+                }
+            m_rtree.push_back(n);
+        }
+        lo = hi;
+        hi = m_rtree.size();
+    }
+}
+
+const std::vector<SpatialMapping::RNode>& SpatialMapping::rtree()
+{
+    if (m_stale) build();
+    return m_rtree;
+}
+
+// ----------------------------------------------------------------------------
+// browsing
+// ----------------------------------------------------------------------------
+SpatialBrowser::SpatialBrowser(SpatialMapping& a_map,
+                               const float a_x, const float a_y):
+m_map(a_map), m_x(1, a_x), m_y(1, a_y)
+{
+    const std::vector<SpatialMapping::RNode>& t = m_map.rtree();
+    if (!t.empty())
+        m_heap.insert(Entry(mindist(t.back()), -1, t.size()-1));
+}
+
+SpatialBrowser::SpatialBrowser(SpatialMapping& a_map,
+                               const float* a_x, const float* a_y, const int a_cnt):
+m_map(a_map), m_x(a_x, a_x + a_cnt), m_y(a_y, a_y + a_cnt)
+{
+    const std::vector<SpatialMapping::RNode>& t = m_map.rtree();
+    if (!t.empty())
+        m_heap.insert(Entry(mindist(t.back()), -1, t.size()-1));
+}
+
+// the least distance to a_node(the farthest of the points), no more than the
+// distance of any object in it, as ObjectCoor::distance computes it
+float SpatialBrowser::mindist(const SpatialMapping::RNode& a_node) const
+{
+    float d=0;
+    for (int i=0; i<(int)m_x.size(); i++)
+    {
+        float dx = 0, dy = 0;
+        if (m_x[i] < a_node.m_lower[0]) dx = a_node.m_lower[0] - m_x[i];
+        else if (m_x[i] > a_node.m_upper[0]) dx = m_x[i] - a_node.m_upper[0];
+        if (m_y[i] < a_node.m_lower[1]) dy = a_node.m_lower[1] - m_y[i];
+        else if (m_y[i] > a_node.m_upper[1]) dy = m_y[i] - a_node.m_upper[1];
+        float dd = sqrt(dx*dx + dy*dy);
+        d = d > dd ? d : dd;
+    }
+    return d;
 }
 
-const Array* SpatialMapping::distOrder(const float* a_x, const float* a_y, const int a_cnt)
+ObjectCoor* SpatialBrowser::next(float& a_dist)
 {
-    ObjectCoor::m_refx = a_x;
-    ObjectCoor::m_refy = a_y;
-    ObjectCoor::m_cnt = a_cnt;
-    m_obj2node.sort(ObjectCoor::compare);
-    return &m_obj2node;
+    const std::vector<SpatialMapping::RNode>& t = m_map.m_rtree;
+    while (!m_heap.isEmpty())
+    {
+        Entry e = m_heap.removeTop();
+        if (e.m_oid != -1)
+        {
+            a_dist = e.m_dist;
+            return m_map.m_leaves[e.m_idx];
+        }
+        const SpatialMapping::RNode& n = t[e.m_idx];
+        for (int i=n.m_first; i<n.m_last; i++)
+        {
+            if (n.m_leaf)
+            {
+                ObjectCoor* c = m_map.m_leaves[i];
+                m_heap.insert(Entry(
+                    c->distance(m_x.data(), m_y.data(), m_x.size()), c->m_oid, i));
+            }
+            else
+                m_heap.insert(Entry(mindist(t[i]), -1, i));
+        }
+    }
+    return 0;
 }
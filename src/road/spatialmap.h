@@ -7,13 +7,16 @@
     Copyright(c) Ken C. K. Lee 2008
 
     This file contains a class SpatialMapping declaration.
-    That maps objects to a coordinate and vice versa
+    That maps objects to a coordinate and vice versa, and a class
+    SpatialBrowser that ranks the objects by distance to query points
 ---------------------------------------------------------------------------- */
 #ifndef spatialmapping_defined
 #define spatialmapping_defined
 
 #include "collection.h"
+#include "pqueue.h"
 #include <math.h>
+#include <vector>
 
 class ObjectCoor
 {
@@ -25,11 +28,11 @@ public:
     ObjectCoor(const int a_oid, const int a_nid, const float a_x, const float a_y):
         m_oid(a_oid), m_nid(a_nid), m_x(a_x), m_y(a_y) {};
     ~ObjectCoor() {};
-    float distance(const float a_x, const float a_y)
+    float distance(const float a_x, const float a_y) const
     {
         return sqrt((a_x-m_x)*(a_x-m_x) + (a_y-m_y)*(a_y-m_y));
     }
-    float distance(const float* a_x, const float* a_y, const int a_cnt)
+    float distance(const float* a_x, const float* a_y, const int a_cnt) const
     {
         float d=0;
         for (int i=0; i<a_cnt; i++)
@@ -39,27 +42,30 @@ public:
         }
         return d;
     }
-    static const float* m_refx;
-    static const float* m_refy;
-    static int          m_cnt;
-    static int compare(const void* a0, const void* a1)
-    {
-        ObjectCoor* c0 = *(ObjectCoor**)a0;
-        ObjectCoor* c1 = *(ObjectCoor**)a1;
-        float dist0 = c0->distance(m_refx,m_refy,m_cnt);
-        float dist1 = c1->distance(m_refx,m_refy,m_cnt);
-        if (dist0 < dist1) return -1;
-        if (dist0 > dist1) return +1;
-        if (c0->m_oid < c1->m_oid) return -1;
-        if (c0->m_oid > c1->m_oid) return +1;
-        return 0;
-    };
 };
 
+// ----------------------------------------------------------------------------
+// the objects are indexed by a packed R-tree, bulk loaded(STR) by the first
+// search after an update; a node box is the bounding box of its objects
+// ----------------------------------------------------------------------------
 class SpatialMapping
 {
 public:
-    Array   m_obj2node;
+    class RNode
+    {
+    public:
+        float   m_lower[2];
+        float   m_upper[2];
+        int     m_first;    // children(nodes, or objects at a leaf)
+        int     m_last;     // ... exclusive
+        bool    m_leaf;
+    };
+    Array                       m_obj2node;
+    std::vector<ObjectCoor*>    m_leaves;   // the objects in leaf order
+    std::vector<RNode>          m_rtree;    // the root last
+    bool                        m_stale;    // updated since the last build
+protected:
+    void build();
 public:
     SpatialMapping();
     virtual ~SpatialMapping();
@@ -69,8 +75,47 @@ public:
     void delObject(const int a_objid);
     //
     // search
-    const Array* distOrder(const float a_x, const float a_y);
-    const Array* distOrder(const float* a_x, const float* a_y, const int a_cnt);
+    const std::vector<RNode>& rtree();
+};
+
+// ----------------------------------------------------------------------------
+// incremental nearest neighbor browsing of the objects of a SpatialMapping
+// by Euclidean distance(the farthest of a_cnt points), nearest first, ties
+// by object id; a browser keeps its own state, so searches do not interfere
+// ----------------------------------------------------------------------------
+class SpatialBrowser
+{
+protected:
+    class Entry
+    {
+    public:
+        float   m_dist;
+        int     m_oid;      // -1 for a node
+        int     m_idx;      // node or leaf object index
+    public:
+        Entry() {};
+        Entry(const float a_dist, const int a_oid, const int a_idx):
+            m_dist(a_dist), m_oid(a_oid), m_idx(a_idx) {};
+        bool operator<(const Entry& a_e) const
+        {
+            if (m_dist != a_e.m_dist) return m_dist < a_e.m_dist;
+            return m_oid < a_e.m_oid;   // nodes first
+        };
+    };
+    SpatialMapping&     m_map;
+    std::vector<float>  m_x, m_y;
+    PQueue<Entry>       m_heap;
+
+    float mindist(const SpatialMapping::RNode& a_node) const;
+public:
+    // constructor/destructor
+    SpatialBrowser(SpatialMapping& a_map, const float a_x, const float a_y);
+    SpatialBrowser(SpatialMapping& a_map,
+                   const float* a_x, const float* a_y, const int a_cnt);
+    ~SpatialBrowser() {};
+    //
+    // search: the next object and its distance(0 when none is left)
+    ObjectCoor* next(float& a_dist);
 };
 
 #endif
@@ -20,11 +20,15 @@
     -q: number of queries
     -r: range
     -v: turn verbose mode on (default: off)
+    -a: shortest path: dijkstra, bidir, astar or alt (default: astar)
+    -l: #landmarks for alt (default: 8)
+    -m: map index files read-only, advised random, sequential, normal,
+        willneed or preload (default: off, buffered reads)
 ---------------------------------------------------------------------------- */
 
 #include "graph.h"
 #include "node.h"
-#include "segfmem.h"
+#include "segmapmem.h"
 #include "graphsearch.h"
 #include "spatialsearch.h"
 #include "spatialmap.h"
@@ -38,6 +42,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <iostream>
+#include <memory>
 #include <fstream>
 
 using namespace std;
@@ -55,6 +60,9 @@ void helpmsg(const char* pgm)
     cerr << "-q: #queries" << endl;
     cerr << "-r: range " << endl;
     cerr << "-v: turn verbose mode on (default: off)" << endl;
+    cerr << "-a: shortest path: dijkstra, bidir, astar or alt (default: astar)" << endl;
+    cerr << "-l: #landmarks for alt (default: 8)" << endl;
+    cerr << "-m: map index files: random, sequential, normal, willneed or preload (default: off)" << endl;
 }
 
 int main(const int a_argc, const char** a_argv)
@@ -74,17 +82,33 @@ int main(const int a_argc, const char** a_argv)
     const char* cnumquery  = Param::read(a_argc, a_argv, "-q", "");
     const char* crange = Param::read(a_argc, a_argv, "-r", "");
     const char* vrbs = Param::read(a_argc, a_argv, "-v", "null");
+    const char* cmap = Param::read(a_argc, a_argv, "-m", "");
     bool verbose = strcmp(vrbs,"null") != 0;
+    const char* calgo = Param::read(a_argc, a_argv, "-a", "astar");
+    const int algo =
+        strcmp(calgo,"dijkstra") == 0 ? SP_DIJKSTRA :
+        strcmp(calgo,"bidir") == 0 ? SP_BIDIJKSTRA :
+        strcmp(calgo,"alt") == 0 ? SP_ALT : SP_ASTAR;
+    const int numlandmark = atoi(Param::read(a_argc, a_argv, "-l", "8"));
 
     //-------------------------------------------------------------------------
     // access graph index file
     //-------------------------------------------------------------------------
     cerr << "loading a graph index ... ";
-    SegFMemory segmem(idxflname, PAGESIZE*10, PAGESIZE, 32, false);
+    std::unique_ptr<SegMemory> segmemp(SegMapMemory::open(idxflname, cmap, PAGESIZE*10, PAGESIZE, 32));
+    SegMemory& segmem = *segmemp;
     Graph graph(segmem);
     int graphsize = segmem.size();
     cerr << "[DONE]" << endl;
 
+    Landmarks landmarks;
+    if (algo == SP_ALT)
+    {
+        cerr << "selecting landmarks ... ";
+        landmarks.build(graph, numlandmark);
+        cerr << "[DONE]" << endl;
+    }
+
     //-------------------------------------------------------------------------
     // access object file
     //-------------------------------------------------------------------------
@@ -160,7 +184,8 @@ int main(const int a_argc, const char** a_argv)
         //----------------------------------------------------------------------
         ftime(&starttime);  // time the algorithm
         SpatialObjectSearch::rangeSearch(
-            graph, smap, src, range*diameter, result, nodeaccess, edgeaccess);
+            graph, smap, src, range*diameter,
+            result, nodeaccess, edgeaccess, algo, &landmarks);
         ftime(&endtime);
         float qtime = 
             ((endtime.time*1000 + endtime.millitm) -
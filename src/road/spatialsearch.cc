@@ -10,13 +10,15 @@
 #include "graph.h"
 #include "node.h"
 #include "graphsearch.h"
+#include <vector>
 
 //-----------------------------------------------------------------------------
 // single-point range search
 //-----------------------------------------------------------------------------
 void SpatialObjectSearch::rangeSearch(Graph& a_graph, SpatialMapping& a_smap,
                                       const int a_src, const float a_range,
-                                      Array& a_result, int& a_nodeaccess, int& a_edgeaccess)
+                                      Array& a_result, int& a_nodeaccess, int& a_edgeaccess,
+                                      const int a_algo, const Landmarks* a_landmarks)
 {
     //-------------------------------------------------------------------------
     // initialization
@@ -32,23 +34,23 @@ void SpatialObjectSearch::rangeSearch(Graph& a_graph, SpatialMapping& a_smap,
     //-------------------------------------------------------------------------
     // find candidates
     //-------------------------------------------------------------------------
-    const Array* cand = a_smap.distOrder(x,y);
+    SpatialBrowser cand(a_smap, x, y);
     
     //-------------------------------------------------------------------------
     // examine the true network distance of individual candidates
     // if the Eculidean distance exceeds the range, quit!
     //-------------------------------------------------------------------------
-    for (int i=0; i<cand->size(); i++)
+    float cost;
+    for (ObjectCoor* c = cand.next(cost); c != 0; c = cand.next(cost))
     {
-        ObjectCoor* c = (ObjectCoor*)cand->get(i);
-        float cost = c->distance(x,y);
         if (cost > a_range) break;  // terminate
 
         //---------------------------------------------------------------------
-        // use A* algorithm to determine the true distance
+        // use a_algo to determine the true distance
         //---------------------------------------------------------------------
         int na=0, ea=0;
-        GraphSearchResult* gsr = GraphSearch::aStar(a_graph, a_src, c->m_nid, na, ea);
+        GraphSearchResult* gsr = GraphSearch::shortestPathSearch(
+            a_graph, a_src, c->m_nid, na, ea, a_algo, a_landmarks);
         a_nodeaccess += na;
         a_edgeaccess += ea;
         if (gsr->m_cost < a_range)
@@ -72,7 +74,8 @@ void SpatialObjectSearch::rangeSearch(Graph& a_graph, SpatialMapping& a_smap,
 //-----------------------------------------------------------------------------
 void SpatialObjectSearch::kNNSearch(Graph& a_graph, SpatialMapping& a_smap,
                                     const int a_src, const int a_k,
-                                    Array& a_result, int& a_nodeaccess, int& a_edgeaccess)
+                                    Array& a_result, int& a_nodeaccess, int& a_edgeaccess,
+                                    const int a_algo, const Landmarks* a_landmarks)
 {
     //-------------------------------------------------------------------------
     // initialization
@@ -89,24 +92,23 @@ void SpatialObjectSearch::kNNSearch(Graph& a_graph, SpatialMapping& a_smap,
     //-------------------------------------------------------------------------
     // find candidates
     //-------------------------------------------------------------------------
-    const Array* cand = a_smap.distOrder(x,y);
+    SpatialBrowser cand(a_smap, x, y);
     
     //-------------------------------------------------------------------------
     // examine the true network distance of individual candidates
     // if the Eculidean distance exceeds the range, quit!
     //-------------------------------------------------------------------------
-    for (int i=0; i<cand->size(); i++)
+    float dist;
+    for (ObjectCoor* c = cand.next(dist); c != 0; c = cand.next(dist))
     {
-        ObjectCoor* c = (ObjectCoor*)cand->get(i);
-        float dist = c->distance(x,y);
         if (dist > distance) break;  // terminate
 
         //---------------------------------------------------------------------
-        // use A* algorithm to determine the true distance
+        // use a_algo to determine the true distance
         //---------------------------------------------------------------------
         int na=0, ea=0;
-        GraphSearchResult* gsr =
-            GraphSearch::aStar(a_graph, a_src, c->m_nid, na, ea);
+        GraphSearchResult* gsr = GraphSearch::shortestPathSearch(
+            a_graph, a_src, c->m_nid, na, ea, a_algo, a_landmarks);
         a_nodeaccess += na;
         a_edgeaccess += ea;
 
@@ -153,16 +155,15 @@ void SpatialObjectSearch::kNNSearch(Graph& a_graph, SpatialMapping& a_smap,
     //-------------------------------------------------------------------------
     // find candidates
     //-------------------------------------------------------------------------
-    const Array* cand = a_smap.distOrder(x,y);
+    SpatialBrowser cand(a_smap, x, y);
     
     //-------------------------------------------------------------------------
     // examine the true network distance of individual candidates
     // if the Eculidean distance exceeds the range, quit!
     //-------------------------------------------------------------------------
-    for (int i=0; i<cand->size(); i++)
+    float dist;
+    for (ObjectCoor* c = cand.next(dist); c != 0; c = cand.next(dist))
     {
-        ObjectCoor* c = (ObjectCoor*)cand->get(i);
-        float dist = c->distance(x,y);
         if (dist > distance) break;  // terminate
 
         //---------------------------------------------------------------------
@@ -199,7 +200,8 @@ void SpatialObjectSearch::groupRangeSearch(Graph& a_graph, SpatialMapping& a_sma
                                            const int* a_src, const float* a_range,
                                            const int a_cnt,
                                            Array& a_result,
-                                           int& a_nodeaccess, int& a_edgeaccess)
+                                           int& a_nodeaccess, int& a_edgeaccess,
+                                           const int a_algo, const Landmarks* a_landmarks)
 {
     //-------------------------------------------------------------------------
     // initialization
@@ -207,7 +209,7 @@ void SpatialObjectSearch::groupRangeSearch(Graph& a_graph, SpatialMapping& a_sma
     a_result.clean();
     a_nodeaccess = 0;
     a_edgeaccess = 0;
-    float x[MAXQUERY], y[MAXQUERY];
+    std::vector<float> x(a_cnt), y(a_cnt);
 
     for (int i=0; i<a_cnt; i++)
     {
@@ -220,16 +222,19 @@ void SpatialObjectSearch::groupRangeSearch(Graph& a_graph, SpatialMapping& a_sma
     //-------------------------------------------------------------------------
     // find candidates
     //-------------------------------------------------------------------------
-    const Array* cand = a_smap.distOrder(x,y,a_cnt);
+    SpatialBrowser cand(a_smap, x.data(), y.data(), a_cnt);
+    float maxrange = 0;
+    for (int j=0; j<a_cnt; j++)
+        maxrange = maxrange > a_range[j] ? maxrange : a_range[j];
     
     //-------------------------------------------------------------------------
     // examine the true network distance of individual candidates
-    // if the Eculidean distance exceeds the range, quit!
+    // if the Eculidean distance exceeds the largest range, quit!
     //-------------------------------------------------------------------------
-    for (int i=0; i<cand->size(); i++)
+    float cost;
+    for (ObjectCoor* c = cand.next(cost); c != 0; c = cand.next(cost))
     {
-        ObjectCoor* c = (ObjectCoor*)cand->get(i);
-        float cost = c->distance(x,y,a_cnt);
+        if (cost > maxrange) break;  // terminate
 
         bool covered = true;
         for (int j=0; j<a_cnt && covered; j++)
@@ -238,14 +243,15 @@ void SpatialObjectSearch::groupRangeSearch(Graph& a_graph, SpatialMapping& a_sma
         if (!covered) continue;
 
         //---------------------------------------------------------------------
-        // use A* algorithm to determine the true distances from each src
+        // use a_algo to determine the true distances from each src
         //---------------------------------------------------------------------
         bool satisfied = true;
         int na=0, ea=0;
         GroupObjectSearchResult* r = new GroupObjectSearchResult(c->m_nid, c->m_oid, a_cnt);
         for (int j=0; j<a_cnt; j++)
         {
-            GraphSearchResult* gsr = GraphSearch::aStar(a_graph, a_src[j], c->m_nid, na, ea);
+            GraphSearchResult* gsr = GraphSearch::shortestPathSearch(
+                a_graph, a_src[j], c->m_nid, na, ea, a_algo, a_landmarks);
             a_nodeaccess += na;
             a_edgeaccess += ea;
             if (gsr->m_cost > a_range[j])
@@ -255,7 +261,7 @@ void SpatialObjectSearch::groupRangeSearch(Graph& a_graph, SpatialMapping& a_sma
                 break;
             }
             r->m_cost[j] = gsr->m_cost;
-            r->m_path[j].copy(gsr->m_path);
+            r->m_path[j] = gsr->m_path;
             delete gsr;
         }
 
@@ -274,7 +280,8 @@ void SpatialObjectSearch::groupKNNSearch(Graph& a_graph, SpatialMapping& a_smap,
                                          const int* a_src, const int a_cnt,
                                          const int a_k,
                                          Array& a_result,
-                                         int& a_nodeaccess, int& a_edgeaccess)
+                                         int& a_nodeaccess, int& a_edgeaccess,
+                                         const int a_algo, const Landmarks* a_landmarks)
 {
     //-------------------------------------------------------------------------
     // initialization
@@ -283,7 +290,7 @@ void SpatialObjectSearch::groupKNNSearch(Graph& a_graph, SpatialMapping& a_smap,
     a_result.clean();
     a_nodeaccess = 0;
     a_edgeaccess = 0;
-    float x[MAXQUERY], y[MAXQUERY];
+    std::vector<float> x(a_cnt), y(a_cnt);
 
     for (int i=0; i<a_cnt; i++)
     {
@@ -296,31 +303,30 @@ void SpatialObjectSearch::groupKNNSearch(Graph& a_graph, SpatialMapping& a_smap,
     //-------------------------------------------------------------------------
     // find candidates
     //-------------------------------------------------------------------------
-    const Array* cand = a_smap.distOrder(x,y,a_cnt);
+    SpatialBrowser cand(a_smap, x.data(), y.data(), a_cnt);
     
     //-------------------------------------------------------------------------
     // examine the true network distance of individual candidates
     // if the Eculidean distance exceeds the range, quit!
     //-------------------------------------------------------------------------
-    for (int i=0; i<cand->size(); i++)
+    float cost;
+    for (ObjectCoor* c = cand.next(cost); c != 0; c = cand.next(cost))
     {
-        ObjectCoor* c = (ObjectCoor*)cand->get(i);
-        float cost = c->distance(x,y,a_cnt);
-
         if (cost > maxdist) break;
 
         //---------------------------------------------------------------------
-        // use A* algorithm to determine the true distances from each src
+        // use a_algo to determine the true distances from each src
         //---------------------------------------------------------------------
         int na=0, ea=0;
         GroupObjectSearchResult* r = new GroupObjectSearchResult(c->m_nid, c->m_oid, a_cnt);
         for (int j=0; j<a_cnt; j++)
         {
-            GraphSearchResult* gsr = GraphSearch::aStar(a_graph, a_src[j], c->m_nid, na, ea);
+            GraphSearchResult* gsr = GraphSearch::shortestPathSearch(
+                a_graph, a_src[j], c->m_nid, na, ea, a_algo, a_landmarks);
             a_nodeaccess += na;
             a_edgeaccess += ea;
             r->m_cost[j] = gsr->m_cost;
-            r->m_path[j].copy(gsr->m_path);
+            r->m_path[j] = gsr->m_path;
             delete gsr;
         }
         a_result.append(r);
@@ -347,7 +353,7 @@ void SpatialObjectSearch::groupKNNSearch(Graph& a_graph, SpatialMapping& a_smap,
     a_result.clean();
     a_nodeaccess = 0;
     a_edgeaccess = 0;
-    float x[MAXQUERY], y[MAXQUERY];
+    std::vector<float> x(a_cnt), y(a_cnt);
 
     for (int i=0; i<a_cnt; i++)
     {
@@ -360,17 +366,15 @@ void SpatialObjectSearch::groupKNNSearch(Graph& a_graph, SpatialMapping& a_smap,
     //-------------------------------------------------------------------------
     // find candidates
     //-------------------------------------------------------------------------
-    const Array* cand = a_smap.distOrder(x,y,a_cnt);
+    SpatialBrowser cand(a_smap, x.data(), y.data(), a_cnt);
     
     //-------------------------------------------------------------------------
     // examine the true network distance of individual candidates
     // if the Eculidean distance exceeds the range, quit!
     //-------------------------------------------------------------------------
-    for (int i=0; i<cand->size(); i++)
+    float cost;
+    for (ObjectCoor* c = cand.next(cost); c != 0; c = cand.next(cost))
     {
-        ObjectCoor* c = (ObjectCoor*)cand->get(i);
-        float cost = c->distance(x,y,a_cnt);
-
         if (cost > maxdist) break;
 
         //---------------------------------------------------------------------
@@ -384,7 +388,7 @@ void SpatialObjectSearch::groupKNNSearch(Graph& a_graph, SpatialMapping& a_smap,
             a_nodeaccess += na;
             a_edgeaccess += ea;
             r->m_cost[j] = gsr->m_cost;
-            r->m_path[j].copy(gsr->m_path);
+            r->m_path[j] = gsr->m_path;
             delete gsr;
         }
         a_result.append(r);
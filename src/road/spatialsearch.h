@@ -12,9 +12,14 @@
 #define spatialobjectsearch_defined
 
 #include "objectsearch.h"
+#include "graphsearch.h"
 class Graph;
 class SpatialMapping;
 
+// ----------------------------------------------------------------------------
+// the network cost of a candidate is found by a_algo(GraphSearch::
+// shortestPathSearch), the searches with a trace use A*
+// ----------------------------------------------------------------------------
 class SpatialObjectSearch
 {
 public:
@@ -24,7 +29,8 @@ public:
     static void rangeSearch(
         Graph& a_graph, SpatialMapping& a_smap,
         const int a_src, const float a_range,
-        Array& a_result, int& a_nodeaccess, int& a_edgeaccess);
+        Array& a_result, int& a_nodeaccess, int& a_edgeaccess,
+        const int a_algo=SP_ASTAR, const Landmarks* a_landmarks=0);
 
 
     // ------------------------------------------------------------------------
@@ -33,7 +39,8 @@ public:
     static void kNNSearch(
         Graph& a_graph, SpatialMapping& a_map,
         const int a_src, const int a_k,
-        Array& a_result,int& a_nodeaccess, int& a_edgeaccess);
+        Array& a_result,int& a_nodeaccess, int& a_edgeaccess,
+        const int a_algo=SP_ASTAR, const Landmarks* a_landmarks=0);
     static void kNNSearch(
         Graph& a_graph, SpatialMapping& a_map,
         const int a_src, const int a_k,
@@ -48,7 +55,8 @@ public:
         Graph& a_graph, SpatialMapping& a_smap,
         const int* a_src, const float* a_range,
         const int a_cnt,
-        Array& a_result, int& a_nodeaccess, int& a_edgeaccess);
+        Array& a_result, int& a_nodeaccess, int& a_edgeaccess,
+        const int a_algo=SP_ASTAR, const Landmarks* a_landmarks=0);
 
     // ------------------------------------------------------------------------
     // multi-point kNN search
@@ -57,7 +65,8 @@ public:
         Graph& a_graph, SpatialMapping& a_smap,
         const int* a_src, const int a_cnt,
         const int a_k,
-        Array& a_result, int& a_nodeaccess, int& a_edgeaccess);
+        Array& a_result, int& a_nodeaccess, int& a_edgeaccess,
+        const int a_algo=SP_ASTAR, const Landmarks* a_landmarks=0);
     static void groupKNNSearch(
         Graph& a_graph, SpatialMapping& a_smap,
         const int* a_src, const int a_cnt,
@@ -66,4 +75,4 @@ public:
         Array& a_visited);
 };
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -0,0 +1,272 @@
+/* ----------------------------------------------------------------------------
+    SPMortonList: shortest path quadtree leaves as a sorted morton code list.
+---------------------------------------------------------------------------- */
+
+#include "spmorton.h"
+#include "spqdtree.h"
+#include "spqdtreenode.h"
+#include "point.h"
+#include "bound.h"
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// constructor/destructor
+SPMortonList::SPMortonList():
+m_mem(0), m_code(0), m_cell(0), m_size(0), m_depth(0)
+{}
+
+SPMortonList::SPMortonList(const char* a_mem,
+                           const std::shared_ptr<const void>& a_keep):
+m_mem(a_mem), m_keep(a_keep)
+{
+    const int* h = (const int*)a_mem;
+    m_size = h[1];
+    m_depth = h[2];
+    m_lower[0] = *(const float*)&h[4];
+    m_lower[1] = *(const float*)&h[5];
+    m_upper[0] = *(const float*)&h[6];
+    m_upper[1] = *(const float*)&h[7];
+    m_code = (const unsigned long long*)(h + 8);
+    m_cell = (const Cell*)(m_code + m_size);
+}
+
+SPMortonList::SPMortonList(const std::shared_ptr<const SPQuadtree>& a_tree):
+m_mem(0), m_code(0), m_cell(0), m_size(0), m_depth(0), m_tree(a_tree)
+{}
+
+SPMortonList SPMortonList::copy() const
+{
+    if (m_mem == 0 || m_keep) return *this;
+    std::shared_ptr<char> rec(new char[length()], std::default_delete<char[]>());
+    memcpy(rec.get(), m_mem, length());
+    return SPMortonList(rec.get(), rec);
+}
+
+// ----------------------------------------------------------------------------
+// layout
+// ----------------------------------------------------------------------------
+bool SPMortonList::isMorton(const char* a_mem)
+{
+    return ((const int*)a_mem)[0] == SPMORTON_TAG;
+}
+
+class MortonCell
+{
+public:
+    unsigned long long      m_path;     // quadrants from the root
+    SPMortonList::Cell      m_cell;
+};
+
+// the leaves of a tree with a next node, in no order
+static void leaves(const SPQuadtree& a_tree, std::vector<MortonCell>& a_cells)
+{
+    if (a_tree.m_root == 0) return;
+
+    std::vector<std::pair<SPQuadtreeNode*, unsigned long long> > s;
+    s.push_back(std::make_pair(a_tree.m_root, 0ULL));
+    while (!s.empty())
+    {
+        SPQuadtreeNode* node = s.back().first;
+        unsigned long long path = s.back().second;
+        s.pop_back();
+        if (node->numChild() > 0)
+        {
+            for (int i=0; i<node->numChild(); i++)
+                s.push_back(std::make_pair(node->getChild(i), (path << 2) | i));
+        }
+        else if (node->next() != -1)
+        {
+            MortonCell c;
+            c.m_path = path;
+            c.m_cell.m_next = node->next();
+            c.m_cell.m_mindist = node->mindist();
+            c.m_cell.m_level = node->m_level;
+            a_cells.push_back(c);
+        }
+    }
+}
+
+int SPMortonList::depth(const SPQuadtree& a_tree)
+{
+    std::vector<MortonCell> cells;
+    leaves(a_tree, cells);
+    int d = 0;
+    for (int i=0; i<(int)cells.size(); i++)
+        d = d > cells[i].m_cell.m_level ? d : cells[i].m_cell.m_level;
+    return d;
+}
+
+int SPMortonList::size(const SPQuadtree& a_tree)
+{
+    std::vector<MortonCell> cells;
+    leaves(a_tree, cells);
+    return SPMORTON_HEADER + (sizeof(unsigned long long) + sizeof(Cell))*cells.size();
+}
+
+void SPMortonList::toMem(const SPQuadtree& a_tree, char* a_mem, int& a_len)
+{
+    std::vector<MortonCell> cells;
+    leaves(a_tree, cells);
+    const int cnt = cells.size();
+    int d = 0;
+    for (int i=0; i<cnt; i++)
+        d = d > cells[i].m_cell.m_level ? d : cells[i].m_cell.m_level;
+    for (int i=0; i<cnt; i++)
+        cells[i].m_path <<= 2*(d - cells[i].m_cell.m_level);
+    std::sort(cells.begin(), cells.end(),
+        [](const MortonCell& a0, const MortonCell& a1)
+        { return a0.m_path < a1.m_path; });
+
+    // ------------------------------------------------------------------------
+    // header
+    // ------------------------------------------------------------------------
+    int* h = (int*)&a_mem[a_len];
+    h[0] = SPMORTON_TAG;
+    h[1] = cnt;
+    h[2] = d;
+    h[3] = 0;
+    *(float*)&h[4] = a_tree.m_bound.m_lower[0];
+    *(float*)&h[5] = a_tree.m_bound.m_lower[1];
+    *(float*)&h[6] = a_tree.m_bound.m_upper[0];
+    *(float*)&h[7] = a_tree.m_bound.m_upper[1];
+
+    // ------------------------------------------------------------------------
+    // codes, then cells
+    // ------------------------------------------------------------------------
+    unsigned long long* code = (unsigned long long*)(h + 8);
+    Cell* cell = (Cell*)(code + cnt);
+    for (int i=0; i<cnt; i++)
+    {
+        code[i] = cells[i].m_path;
+        cell[i] = cells[i].m_cell;
+    }
+    a_len += (char*)(cell + cnt) - (char*)h;
+}
+
+void SPMortonList::toTree(SPQuadtree& a_tree) const
+{
+    for (int i=0; i<m_size; i++)
+    {
+        // --------------------------------------------------------------------
+        // the bound of the cell: its quadrants from the root
+        // --------------------------------------------------------------------
+        const int level = m_cell[i].m_level;
+        const unsigned long long path = m_code[i] >> 2*(m_depth - level);
+        float l[2] = {m_lower[0], m_lower[1]};
+        float u[2] = {m_upper[0], m_upper[1]};
+        for (int j=level-1; j>=0; j--)
+        {
+            const int q = (path >> 2*j) & 3;
+            for (int d=0; d<2; d++)
+            {
+                float c = (l[d] + u[d])/2;
+                if (q & (1 << d)) l[d] = c;
+                else u[d] = c;
+            }
+        }
+        Point ptl(2,l), ptu(2,u);
+        Bound bd(ptl,ptu);
+        a_tree.addNode(SPQuadtreeNode(level, bd, m_cell[i].m_next, m_cell[i].m_mindist));
+    }
+}
+
+// ----------------------------------------------------------------------------
+// search
+// ----------------------------------------------------------------------------
+// the code of a point: the quadrant split as SPQuadtreeNode::createChild
+bool SPMortonList::code(const Point& a_pt, unsigned long long& a_code) const
+{
+    float l[2], u[2];
+    for (int d=0; d<2; d++)
+    {
+        if (a_pt[d] < m_lower[d] || a_pt[d] > m_upper[d]) return false;
+        l[d] = m_lower[d];
+        u[d] = m_upper[d];
+    }
+    a_code = 0;
+    for (int level=0; level<m_depth; level++)
+    {
+        int q = 0;
+        for (int d=0; d<2; d++)
+        {
+            float c = (l[d] + u[d])/2;
+            if (a_pt[d] >= c) { q |= 1 << d; l[d] = c; }
+            else u[d] = c;
+        }
+        a_code = (a_code << 2) | q;
+    }
+    return true;
+}
+
+// the last cell starting at or before the code, if it covers the code(-1 if
+// none), searched from a_from: a cell starting at or before the code
+int SPMortonList::cell(const unsigned long long a_code, const int a_from) const
+{
+    const unsigned long long* c =
+        std::upper_bound(m_code + a_from, m_code + m_size, a_code);
+    if (c == m_code) return -1;
+    const int i = c - m_code - 1;
+    if (a_code - m_code[i] >= (1ULL << 2*(m_depth - m_cell[i].m_level))) return -1;
+    return i;
+}
+
+const SPMortonList::Cell* SPMortonList::find(const Point& a_pt) const
+{
+    unsigned long long c;
+    if (m_size == 0 || !code(a_pt, c)) return 0;
+    const int i = cell(c, 0);
+    return i != -1 ? &m_cell[i] : 0;
+}
+
+int SPMortonList::next(const Point& a_pt) const
+{
+    if (m_tree) return m_tree->next(a_pt);
+    const Cell* c = find(a_pt);
+    return c != 0 ? c->m_next : -1;
+}
+
+float SPMortonList::mindist(const Point& a_pt) const
+{
+    if (m_tree) return m_tree->mindist(a_pt);
+    const Cell* c = find(a_pt);
+    return c != 0 ? c->m_mindist : INFTY;
+}
+
+void SPMortonList::lookup(const Point* const* a_pt, const int a_cnt,
+                          int* a_next, float* a_mindist) const
+{
+    if (m_tree)
+    {
+        for (int i=0; i<a_cnt; i++)
+        {
+            a_next[i] = m_tree->next(*a_pt[i]);
+            a_mindist[i] = m_tree->mindist(*a_pt[i]);
+        }
+        return;
+    }
+
+    // ------------------------------------------------------------------------
+    // the points by code: each search starts at the cell of the last
+    // ------------------------------------------------------------------------
+    std::vector<std::pair<unsigned long long, int> > c;
+    c.reserve(a_cnt);
+    for (int i=0; i<a_cnt; i++)
+    {
+        a_next[i] = -1;
+        a_mindist[i] = INFTY;
+        unsigned long long k;
+        if (m_size > 0 && code(*a_pt[i], k))
+            c.push_back(std::make_pair(k, i));
+    }
+    std::sort(c.begin(), c.end());
+    int from = 0;
+    for (int i=0; i<(int)c.size(); i++)
+    {
+        const int j = cell(c[i].first, from);
+        if (j == -1) continue;
+        a_next[c[i].second] = m_cell[j].m_next;
+        a_mindist[c[i].second] = m_cell[j].m_mindist;
+        from = j;
+    }
+}
@@ -0,0 +1,91 @@
+/* ----------------------------------------------------------------------------
+    This file contains a class SPMortonList declaration.
+    It is a read only view of the shortest path quadtree of a node in the
+    morton layout: the leaf cells as a list sorted by morton(z-order) code,
+    binary searched in place(from a mapped or read buffer) with no
+    unmarshalling and no allocation.
+
+    record(4 byte words):
+        tag(-1), #cells, depth, 0
+        lower x, lower y, upper x, upper y      area bound
+        code[#cells]            (8 bytes each) first code of a cell at depth
+        (next, mindist, level)[#cells]
+
+    - the code of a point is the path of the quadrants of it from the root,
+      two bits(x, then y upper half) a level; a point on a split line goes to
+      the upper half, as the tree search(SPQuadtree::findNode) does
+    - a cell of level l covers codes [code, code + 4^(depth-l)), the cells
+      with no next node are not kept: a point in none(or out of the area)
+      has next node -1 and mindist INFTY
+    - the tree layout(DistBrws) has the number of leaves(>= 0) first, the
+      tag tells the two apart; trees deeper than MAXDEPTH stay in it
+---------------------------------------------------------------------------- */
+#ifndef spmorton_defined
+#define spmorton_defined
+
+#include <memory>
+
+#define SPMORTON_TAG        -1
+#define SPMORTON_HEADER     (sizeof(int)*8)
+
+class SPQuadtree;
+class Point;
+
+class SPMortonList
+{
+public:
+    static const int MAXDEPTH = 31;     // codes of 64 bits
+    class Cell                          // a leaf cell in the record
+    {
+    public:
+        int     m_next;
+        float   m_mindist;
+        int     m_level;
+    };
+protected:
+    const char*                 m_mem;      // the record
+    const unsigned long long*   m_code;
+    const Cell*                 m_cell;
+    int                         m_size;
+    int                         m_depth;
+    float                       m_lower[2];
+    float                       m_upper[2];
+    std::shared_ptr<const void> m_keep;     // holds the record if not 0
+    std::shared_ptr<const SPQuadtree> m_tree;   // a tree too deep(0: none)
+
+    bool code(const Point& a_pt, unsigned long long& a_code) const;
+    int cell(const unsigned long long a_code, const int a_from) const;
+public:
+    // constructor/destructor
+    SPMortonList();
+    SPMortonList(const char* a_mem, const std::shared_ptr<const void>& a_keep=
+        std::shared_ptr<const void>());
+    SPMortonList(const std::shared_ptr<const SPQuadtree>& a_tree);
+    SPMortonList copy() const;          // a view that holds its record
+    //
+    // layout
+    static bool isMorton(const char* a_mem);
+    static int depth(const SPQuadtree& a_tree);     // levels of kept cells
+    static int size(const SPQuadtree& a_tree);      // bytes of a record
+    static void toMem(const SPQuadtree& a_tree, char* a_mem, int& a_len);
+    void toTree(SPQuadtree& a_tree) const;      // the tree layout decoded
+    //
+    // info
+    const char* record() const      { return m_mem; };
+    int length() const              // bytes of the record
+    {
+        return SPMORTON_HEADER + (sizeof(unsigned long long) + sizeof(Cell))*m_size;
+    };
+    int size() const                { return m_size; };
+    //
+    // search: the cell of a point(0 if none)
+    const Cell* find(const Point& a_pt) const;
+    int next(const Point& a_pt) const;
+    float mindist(const Point& a_pt) const;
+    //
+    // search: next and mindist of a_cnt points in one pass, by code
+    void lookup(const Point* const* a_pt, const int a_cnt,
+                int* a_next, float* a_mindist) const;
+};
+
+#endif
@@ -73,16 +73,42 @@ SPQuadtreeNode* SPQuadtree::findNode(const Bound& a_bd)
     return 0;
 }
 
-float SPQuadtree::mindist(const Point& a_pt)
+const SPQuadtreeNode* SPQuadtree::findNode(const Point& a_pt) const
 {
-    SPQuadtreeNode* node = findNode(a_pt);
-    return node->mindist();
+    if (m_root == 0)
+        return 0;
+
+    Stack s;
+    s.push(m_root);
+    while (!s.isEmpty())
+    {
+        SPQuadtreeNode* node = (SPQuadtreeNode*)s.pop();
+        if (node->m_bound.contain(a_pt))
+        {
+            if (node->numChild() > 0)
+            {
+                for (int i=0; i<node->numChild(); i++)
+                    s.push(node->getChild(i));
+            }
+            else
+            {
+                return node;
+            }
+        }
+    }
+    return 0;
+}
+
+float SPQuadtree::mindist(const Point& a_pt) const
+{
+    const SPQuadtreeNode* node = findNode(a_pt);
+    return node != 0 ? node->mindist() : SPQuadtreeNode(0, m_bound).mindist();
 }
 
-int SPQuadtree::next(const Point& a_pt)
+int SPQuadtree::next(const Point& a_pt) const
 {
-    SPQuadtreeNode* node = findNode(a_pt);
-    return node->next();
+    const SPQuadtreeNode* node = findNode(a_pt);
+    return node != 0 ? node->next() : SPQuadtreeNode(0, m_bound).next();
 }
 
 int SPQuadtree::addObject(SPQuadtreeRec* a_rec)
@@ -30,14 +30,15 @@ public:
 protected:
     SPQuadtreeNode* findNode(const Point& a_pt);   // find a node containing this point
     SPQuadtreeNode* findNode(const Bound& a_bd);   // find a node containing this bound
+    const SPQuadtreeNode* findNode(const Point& a_pt) const;   // the same, no root created
 public:
     // constructor/destructor
     SPQuadtree(const int a_oid, const Bound& a_bound);
     virtual ~SPQuadtree();
     //
     // search
-    virtual int next(const Point& a_pt);        // determine the next node to go for a point
-    virtual float mindist(const Point& a_pt);   // determine the mindist from the node
+    virtual int next(const Point& a_pt) const;      // determine the next node to go for a point
+    virtual float mindist(const Point& a_pt) const; // determine the mindist from the node
     //
     // update
     virtual int addObject(SPQuadtreeRec* a_rec);
@@ -13,6 +13,17 @@
 #include<stack>
 #include<algorithm>
 #include<sys/time.h>
+#include<string.h>
+#include<unistd.h>
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<mutex>
+#include<condition_variable>
+#include<limits.h>
+#include "../common/query_stats.h"
+#include "../common/task_pool.h"
+#include "../common/radix_heap.h"
 using namespace std;
 
 // MACRO for time tick
@@ -23,12 +34,13 @@ long long ts, te;
 #define TIME_TICK_PRINT(T) printf("%s RESULT: %lld (0.01MS)\r\n", (#T), te - ts );
 // ----------
 
-#define FILE_NODE "../../src/data/wa.scc.cnode"
-#define FILE_EDGE "../../src/data/wa.scc.cedge"
+// defaults, or from the command line(see main)
+char FILE_NODE[256] = "../../src/data/wa.scc.cnode";
+char FILE_EDGE[256] = "../../src/data/wa.scc.cedge";
 
-#define FILE_MORTON "./data/wa.morton"
+char FILE_MORTON[256] = "./data/wa.morton";
 // cal=10000 SF=NA=100 ny=100000 e=100000 col=100000
-#define WEIGHT_INFLATE_FACTOR 1
+int WEIGHT_INFLATE_FACTOR = 1;
 #define ROUND_FACTOR 0.5
 #define MAX_INF  1e100
 #define MIN_INF -1e100
@@ -63,7 +75,36 @@ typedef struct{
 }MortonList;
 
 vector<Node> Nodes;
-vector<MortonList> MortonLists;
+
+// ----- MORTON STORE -----
+// FILE_MORTON mapped read only(morton_load), the lists stay as morton_list_save wrote them:
+// max_level, count, then count blocks of z_order(8 bytes) and first_path(4 bytes) packed.
+// a source's list is found by the offset table and searched in place, so the pages of the
+// sources never queried are not read and the store need not fit in memory.
+// FILE_MORTON.lambda has the lambda interval of every block(morton_list_lambda), the blocks
+// of all the lists in order, a pair of floats each.
+// a packed store(-z, morton_pack) starts with MORTON_PACKED, the node count, the block count,
+// then the list offset and the blocks before the list of each node(long longs). a packed list
+// is max_level, count, a table of the first z_order and the data offset(12 bytes like a
+// block, so morton_list_binary_search runs on it) of every MORTON_GROUP blocks, then a varint
+// per block: the z_order delta from the block before in the group(0 for the first) shifted
+// over the index of first_path among the neighbours of the source. a lookup decodes one group
+typedef struct{
+	bool packed;
+	const char* base;
+	long long size;
+	vector<long long> offset;	// start of the list of each source
+	vector<long long> block;	// blocks in the lists before the one of each source
+	vector<long long> code;	// z_order of each node at MORTON_DEPTH levels
+	const float* lambda;	// NULL if there are no intervals for this store
+	long long lambda_size;
+	vector<float> lambda_min;	// least lambda- of the list of each source, < 0 until asked
+}MortonStore;
+MortonStore Morton = { false, NULL, 0 };
+#define MORTON_BLOCK 12
+#define MORTON_PACKED 0x5a434c53
+#define MORTON_GROUP 16
+#define MORTON_DEPTH 31	// levels of a precomputed z_order(2 bits each in a long long)
 
 double min_llx, min_lly;
 double max_urx, max_ury;
@@ -127,21 +168,28 @@ void init(){
 	init_input();
 }
 
-// SPFA
-void SPFA_first_path( int src, int* &first_path ){
-	// min_dis array
-	int *min_dis = new int[ Nodes.size() ];
-	bool *used = new bool[ Nodes.size() ];
+// scratch of SPFA_first_path, one per build thread
+typedef struct{
+	vector<int> min_dis;
+	vector<char> used;
 	deque<int> q;
+}SPFA_Scratch;
+
+// SPFA
+void SPFA_first_path( int src, int* first_path, SPFA_Scratch& scratch ){
+	vector<int>& min_dis = scratch.min_dis;
+	vector<char>& used = scratch.used;
+	deque<int>& q = scratch.q;
 	
 	// init for each starting node
-	memset( used, 0, sizeof(bool) * Nodes.size() );
-	memset( min_dis, -1, sizeof(int) * Nodes.size() );
+	used.assign( Nodes.size(), 0 );
+	min_dis.assign( Nodes.size(), -1 );
+	q.clear();
 	min_dis[src] = 0;
 	q.push_back(src);
 	used[src] = true;
-	// init for first_path
-	first_path[src] = -1;
+	// init for first_path(-1: not reached)
+	for ( int i = 0; i < Nodes.size(); i++ ) first_path[i] = -1;
 	for ( int i = 0; i < Nodes[src].adjnodes.size(); i++ ){
 		first_path[Nodes[src].adjnodes[i]] = Nodes[src].adjnodes[i];
 	}
@@ -215,11 +263,60 @@ void SPFA_first_path( int src, int* &first_path ){
 			}	
 		}
 	}
-	
-	delete[] used;
-	delete[] min_dis;
+}
 
+// workspace of dijkstra_first_path, one per build thread: the entry of a node is valid
+// while its stamp is the one of the current search(no clearing per source), its fields
+// side by side for one cache line per edge relaxed
+typedef struct{
+	int dis;
+	int first_path;
+	int stamp;	// reached in search stamp, negated once settled
+}Dijkstra_Entry;
 
+typedef struct{
+	vector<Dijkstra_Entry> entry;
+	int current;
+	RadixHeap<int> heap;
+}Dijkstra_Scratch;
+
+// dijkstra from src, a radix heap over the integer weights(-d, -p in build). first_path of a
+// node is the node after src on its shortest path, set as the path is found: settle( v,
+// first_path ) is called for every node reached but src, in the order they are settled.
+// unlike SPFA it has no bad cases, but SPFA with the label heuristics above was about twice
+// as fast on road networks, so it stays the default
+template<class F>
+void dijkstra_first_path( int src, Dijkstra_Scratch& w, F settle ){
+	if ( w.entry.size() != Nodes.size() ){
+		Dijkstra_Entry e = { 0, -1, 0 };
+		w.entry.assign( Nodes.size(), e );
+		w.current = 0;
+	}
+	int cur = ++w.current;
+	radix_clear( w.heap );
+
+	Dijkstra_Entry s = { 0, -1, cur };
+	w.entry[src] = s;
+	radix_push( w.heap, 0, src );
+	while( !radix_empty( w.heap ) ){
+		pair<unsigned,int> top = radix_pop( w.heap );
+		int v = top.second;
+		Dijkstra_Entry& ev = w.entry[v];
+		if ( ev.stamp != cur || (int)top.first != ev.dis ) continue;
+		ev.stamp = -cur;
+		if ( v != src ) settle( v, ev.first_path );
+
+		for ( int j = 0; j < Nodes[v].adjnodes.size(); j++ ){
+			int cid = Nodes[v].adjnodes[j];
+			int d = ev.dis + Nodes[v].adjweight[j];
+			Dijkstra_Entry& ec = w.entry[cid];
+			if ( ( ec.stamp == cur && ec.dis <= d ) || ec.stamp == -cur ) continue;
+			ec.stamp = cur;
+			ec.dis = d;
+			ec.first_path = v == src ? cid : ev.first_path;
+			radix_push( w.heap, (unsigned)d, cid );
+		}
+	}
 }
 
 bool in_rect( double x, double y, double llx, double lly, double urx, double ury ){
@@ -337,6 +434,39 @@ void quadtree_split(int pos, int &dest, int& dest_first_path, QuadTree &qt){
 	qt[pos].leafinvlist.clear();
 }
 
+// slimming of a built quad tree, bottom up: an inner node whose children are all leaves of
+// one color(an empty one, first_path -1, takes any) becomes a leaf of that color, and the
+// inverted lists, only for quadtree_add, are dropped. the nodes left in the tree
+int quadtree_slim( QuadTree& qt ){
+	// children come after their parent(quadtree_split appends them)
+	for ( int pos = qt.size() - 1; pos >= 0; pos-- ){
+		vector<int>().swap( qt[pos].leafinvlist );
+		if ( qt[pos].isleaf ) continue;
+		int color = -1;
+		bool same = true;
+		for ( int i = 0; i < qt[pos].children.size() && same; i++ ){
+			QuadTreeNode& child = qt[qt[pos].children[i]];
+			if ( !child.isleaf || ( child.first_path != -1 && color != -1 && child.first_path != color ) ) same = false;
+			else if ( child.first_path != -1 ) color = child.first_path;
+		}
+		if ( same ){
+			qt[pos].isleaf = true;
+			qt[pos].first_path = color;
+			qt[pos].children.clear();
+		}
+	}
+
+	int size = 0;
+	vector<int> stk( 1, 0 );
+	while( !stk.empty() ){
+		int pos = stk.back();
+		stk.pop_back();
+		size++;
+		stk.insert( stk.end(), qt[pos].children.begin(), qt[pos].children.end() );
+	}
+	return size;
+}
+
 void quadtree_add( int dest, int dest_first_path, QuadTree &qt ){
 	int pos = 0;
 	double x = Nodes[dest].x;
@@ -366,39 +496,32 @@ void quadtree_add( int dest, int dest_first_path, QuadTree &qt ){
 	}
 }
 
-int morton_list_binary_search( vector<MortonBlock> &morton_list, long long value ){
-	int left = 0;
-	int right = morton_list.size() - 1;
-	int mid;
-	while( left <= right ){
-		mid = ( left + right ) / 2;
-		if ( mid == left ){
-			if ( value >= morton_list[right].z_order ){
-				return right;
-			}
-			else{
-				return left;
-			}
-		}
-		else if ( value < morton_list[mid].z_order ){
-			right = mid - 1;
-		}
-		else{
-			left = mid;
-		}
+// last block of a list with z_order <= value(the first if none), -1 for an empty list.
+// branch free: the range halves by a conditional move, not a jump
+int morton_list_binary_search( const char* blocks, int count, long long value ){
+	if ( count == 0 ) return -1;
+	const char* base = blocks;
+	long long z_order;
+	while( count > 1 ){
+		int half = count / 2;
+		memcpy( &z_order, base + (long long)half * MORTON_BLOCK, sizeof(long long) );
+		base = z_order <= value ? base + (long long)half * MORTON_BLOCK : base;
+		count -= half;
 	}
+	return ( base - blocks ) / MORTON_BLOCK;
 }
 
-int morton_find( int src, int dest ){
-	double x = Nodes[dest].x;
-	double y = Nodes[dest].y;
+// z_order of a node at max_level levels, the quadrants of quadtree_split by in_rect
+long long morton_code( int nid, int max_level ){
+	double x = Nodes[nid].x;
+	double y = Nodes[nid].y;
 	double llx = min_llx;
 	double lly = min_lly;
 	double urx = max_urx;
 	double ury = max_ury;
 	long long z_order = 0;
 
-	for ( int i = 0; i < MortonLists[src].max_level; i++ ){
+	for ( int i = 0; i < max_level; i++ ){
 		double mid_x = ( llx + urx ) / 2;
 		double mid_y = ( lly + ury ) / 2;
 		if ( in_rect( x, y, llx, mid_y, mid_x, ury ) ){
@@ -422,9 +545,122 @@ int morton_find( int src, int dest ){
 			ury = mid_y;
 		}
 	}
+	return z_order;
+}
+
+// the descent of a level only depends on the ones above it, so the z_order at any
+// max_level <= MORTON_DEPTH is a prefix of the precomputed one(morton_code_init)
+long long morton_shift( int nid, int max_level ){
+	return max_level <= MORTON_DEPTH ?
+		Morton.code[nid] >> ( 2 * ( MORTON_DEPTH - max_level ) ) : morton_code( nid, max_level );
+}
+
+void morton_code_init(){
+	Morton.code.resize( Nodes.size() );
+	for ( int i = 0; i < Nodes.size(); i++ ){
+		Morton.code[i] = morton_code( i, MORTON_DEPTH );
+	}
+}
 
-	int rst_pos = morton_list_binary_search( MortonLists[src].array, z_order );
-	return MortonLists[src].array[rst_pos].first_path;
+// bits of the index of first_path among the neighbours of src in a packed list
+int morton_path_bits( int src ){
+	int bits = 0;
+	while( ( 1 << bits ) < Nodes[src].adjnodes.size() ) bits++;
+	return bits;
+}
+
+unsigned long long morton_varint( const unsigned char* &p ){
+	unsigned long long v = 0;
+	for ( int shift = 0; ; shift += 7 ){
+		v |= (unsigned long long)( *p & 127 ) << shift;
+		if ( ( *p++ & 128 ) == 0 ) return v;
+	}
+}
+
+// group g of the packed list of src decoded up to the last block with z_order <= value, at
+// most upto blocks into the group(the first if none): its position in the list and first_path
+int morton_group_scan( int src, int g, long long value, int upto, int &first_path ){
+	const char* list = Morton.base + Morton.offset[src];
+	int count;
+	memcpy( &count, list + sizeof(int), sizeof(int) );
+	int groups = ( count + MORTON_GROUP - 1 ) / MORTON_GROUP;
+	long long z_order;
+	int data;
+	memcpy( &z_order, list + sizeof(int) * 2 + (long long)g * MORTON_BLOCK, sizeof(long long) );
+	memcpy( &data, list + sizeof(int) * 2 + (long long)g * MORTON_BLOCK + sizeof(long long), sizeof(int) );
+	const unsigned char* p = (const unsigned char*)list + sizeof(int) * 2 + (long long)groups * MORTON_BLOCK + data;
+
+	int bits = morton_path_bits( src );
+	int n = min( MORTON_GROUP, count - g * MORTON_GROUP );
+	int k = 0;
+	unsigned long long v = morton_varint( p );
+	while( k + 1 < n && k < upto ){
+		unsigned long long next = morton_varint( p );
+		z_order += next >> bits;
+		if ( z_order > value ) break;
+		v = next;
+		k++;
+	}
+	first_path = Nodes[src].adjnodes[v & ( ( 1ULL << bits ) - 1 )];
+	return g * MORTON_GROUP + k;
+}
+
+// block of the list of src covering dest, by its index in the store(-1 for an empty list).
+// code is the z_order of dest at MORTON_DEPTH levels(Morton.code), a walk to dest keeps it
+long long morton_block( int src, int dest, long long code ){
+	const char* list = Morton.base + Morton.offset[src];
+	int max_level, count;
+	memcpy( &max_level, list, sizeof(int) );
+	memcpy( &count, list + sizeof(int), sizeof(int) );
+
+	long long value = max_level <= MORTON_DEPTH ?
+		code >> ( 2 * ( MORTON_DEPTH - max_level ) ) : morton_code( dest, max_level );
+	if ( Morton.packed ){
+		int g = morton_list_binary_search( list + sizeof(int) * 2, ( count + MORTON_GROUP - 1 ) / MORTON_GROUP, value );
+		int first_path;
+		return g < 0 ? -1 : Morton.block[src] + morton_group_scan( src, g, value, MORTON_GROUP, first_path );
+	}
+	int rst_pos = morton_list_binary_search( list + sizeof(int) * 2, count, value );
+	return rst_pos < 0 ? -1 : Morton.block[src] + rst_pos;
+}
+
+long long morton_block( int src, int dest ){
+	return morton_block( src, dest, Morton.code[dest] );
+}
+
+// first_path of block b of the list of src
+int morton_block_first_path( int src, long long b ){
+	int first_path;
+	if ( Morton.packed ){
+		int pos = b - Morton.block[src];
+		morton_group_scan( src, pos / MORTON_GROUP, LLONG_MAX, pos % MORTON_GROUP, first_path );
+		return first_path;
+	}
+	const char* block = Morton.base + Morton.offset[src] + sizeof(int) * 2 +
+		( b - Morton.block[src] ) * MORTON_BLOCK;
+	memcpy( &first_path, block + sizeof(long long), sizeof(int) );
+	return first_path;
+}
+
+int morton_find( int src, int dest ){
+	long long b = morton_block( src, dest );
+	return b < 0 ? -1 : morton_block_first_path( src, b );
+}
+
+// path src -> dest by the first paths of the store into path, src and dest included: the
+// node count, -1 if it does not reach dest within max_len nodes. it only reads the mapped
+// store and the graph, so threads may expand paths at once after morton_load
+int silc_path( int src, int dest, int* path, int max_len ){
+	long long code = Morton.code[dest];
+	int n = 0;
+	for ( int current = src; n < max_len; ){
+		path[n++] = current;
+		if ( current == dest ) return n;
+		long long b = morton_block( current, dest, code );
+		if ( b < 0 ) return -1;
+		current = morton_block_first_path( current, b );
+	}
+	return -1;
 }
 
 void morton_list_save( MortonList& morton_list, FILE* &fout ){
@@ -447,33 +683,238 @@ void morton_list_save( MortonList& morton_list, FILE* &fout ){
 }
 
 
+long long graph_fingerprint();
+
+// offset table of a plain store
+void morton_load_offsets(){
+	char file_idx[300];
+	sprintf( file_idx, "%s.idx", FILE_MORTON );
+	FILE* fidx = fopen( file_idx, "rb" );
+	int count;
+	long long fp, end = 0;
+	if ( fidx != NULL &&
+		fread( &count, sizeof(int), 1, fidx ) == 1 && count == Nodes.size() &&
+		fread( &fp, sizeof(long long), 1, fidx ) == 1 && fp == graph_fingerprint() ){
+		while( Morton.offset.size() < Nodes.size() && fread( &fp, sizeof(long long), 1, fidx ) == 1 ){
+			Morton.offset.push_back( end );
+			end = fp;
+		}
+	}
+	if ( fidx != NULL ) fclose( fidx );
+	if ( Morton.offset.size() != Nodes.size() || end != Morton.size ){
+		Morton.offset.clear();
+		end = 0;
+		for ( int i = 0; i < Nodes.size(); i++ ){
+			if ( end + (long long)sizeof(int) * 2 > Morton.size ){
+				printf("SHORT %s AT QUAD=%d\n", FILE_MORTON, i );
+				exit(1);
+			}
+			Morton.offset.push_back( end );
+			memcpy( &count, Morton.base + end + sizeof(int), sizeof(int) );
+			end += sizeof(int) * 2 + (long long)count * MORTON_BLOCK;
+		}
+	}
+	Morton.block.resize( Nodes.size() );
+	for ( int i = 0; i < Nodes.size(); i++ ){
+		Morton.block[i] = ( Morton.offset[i] - (long long)sizeof(int) * 2 * i ) / MORTON_BLOCK;
+	}
+}
+
+// maps FILE_MORTON, the offset table from the header of a packed store, else from
+// FILE_MORTON.idx(see build) if it is the one of this graph and complete, else from one
+// pass over the list headers
 void morton_load(){
-	FILE* fin = fopen( FILE_MORTON, "rb" );
+	if ( Morton.base != NULL ) munmap( (void*)Morton.base, Morton.size );
+	Morton.base = NULL;
+	Morton.offset.clear();
+
+	int fd = open( FILE_MORTON, O_RDONLY );
+	struct stat st;
+	if ( fd < 0 || fstat( fd, &st ) != 0 ){
+		printf("CANNOT OPEN %s\n", FILE_MORTON );
+		exit(1);
+	}
+	Morton.size = st.st_size;
+	void* p = mmap( NULL, Morton.size > 0 ? Morton.size : 1, PROT_READ, MAP_SHARED, fd, 0 );
+	close( fd );
+	if ( p == MAP_FAILED ){
+		printf("CANNOT MAP %s\n", FILE_MORTON );
+		exit(1);
+	}
+	Morton.base = (const char*)p;
+
+	// z_order of every node, once
+	morton_code_init();
+
+	// offset table
+	int magic = 0;
+	if ( Morton.size >= sizeof(int) ) memcpy( &magic, Morton.base, sizeof(int) );
+	Morton.packed = magic == MORTON_PACKED;
+	long long blocks;
+	if ( Morton.packed ){
+		const char* table = Morton.base + sizeof(int) * 2 + sizeof(long long);
+		int count = -1;
+		if ( Morton.size >= table - Morton.base ) memcpy( &count, Morton.base + sizeof(int), sizeof(int) );
+		if ( count != Nodes.size() || Morton.size < table - Morton.base + sizeof(long long) * 2 * (long long)count ){
+			printf("BAD %s\n", FILE_MORTON );
+			exit(1);
+		}
+		memcpy( &blocks, Morton.base + sizeof(int) * 2, sizeof(long long) );
+		Morton.offset.resize( count );
+		Morton.block.resize( count );
+		for ( int i = 0; i < count; i++ ){
+			memcpy( &Morton.offset[i], table + sizeof(long long) * 2 * i, sizeof(long long) );
+			memcpy( &Morton.block[i], table + sizeof(long long) * ( 2 * i + 1 ), sizeof(long long) );
+		}
+	}
+	else morton_load_offsets();
+	if ( !Morton.packed ) blocks = ( Morton.size - (long long)sizeof(int) * 2 * Nodes.size() ) / MORTON_BLOCK;
+
+	// lambda intervals, if built with this store
+	if ( Morton.lambda != NULL ) munmap( (void*)Morton.lambda, Morton.lambda_size );
+	Morton.lambda = NULL;
+	char file_lambda[300];
+	sprintf( file_lambda, "%s.lambda", FILE_MORTON );
+	fd = open( file_lambda, O_RDONLY );
+	if ( fd >= 0 && fstat( fd, &st ) == 0 && blocks > 0 && st.st_size == blocks * 2 * sizeof(float) ){
+		p = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+		if ( p != MAP_FAILED ){
+			Morton.lambda = (const float*)p;
+			Morton.lambda_size = st.st_size;
+		}
+	}
+	if ( fd >= 0 ) close( fd );
+	Morton.lambda_min.assign( Nodes.size(), -1 );
+}
 
-	// init clear
-	MortonLists.clear();
-	
-	int max_level;
-	int array_count;
-	long long z_order;
-	int first_path;
-	for ( int i = 0; i < Nodes.size(); i++ ){
-		MortonList morton_list;
-		// max_level
-		fread( &max_level, sizeof(int), 1, fin );
-		morton_list.max_level = max_level;
-		// array
-		fread( &array_count, sizeof(int), 1, fin );
-		for ( int j = 0; j < array_count; j++ ){
-			fread( &z_order, sizeof(long long), 1, fin);
-			fread( &first_path, sizeof(int), 1, fin);
-			MortonBlock mb = { z_order, first_path };
-			morton_list.array.push_back(mb);
-		}
-		// push
-		MortonLists.push_back(morton_list);
-	}	
-	fclose( fin );
+void morton_put_varint( vector<unsigned char>& data, unsigned long long v ){
+	while( v >= 128 ){
+		data.push_back( ( v & 127 ) | 128 );
+		v >>= 7;
+	}
+	data.push_back( v );
+}
+
+// -z: FILE_MORTON rewritten packed(see MortonStore) in place. the blocks keep their order so
+// FILE_MORTON.lambda stays valid, FILE_MORTON.idx is removed(a build after this starts over)
+void morton_pack(){
+	morton_load();
+	if ( Morton.packed ) return;
+	char file_pack[300], file_idx[300];
+	sprintf( file_pack, "%s.pack", FILE_MORTON );
+	sprintf( file_idx, "%s.idx", FILE_MORTON );
+	FILE* fout = fopen( file_pack, "wb" );
+	if ( fout == NULL ){
+		printf("CANNOT OPEN %s\n", file_pack );
+		exit(1);
+	}
+	int magic = MORTON_PACKED, node_count = Nodes.size();
+	long long blocks = ( Morton.size - (long long)sizeof(int) * 2 * node_count ) / MORTON_BLOCK;
+	long long end = sizeof(int) * 2 + sizeof(long long) * ( 1 + 2 * (long long)node_count );
+	vector<long long> table( 2 * node_count );
+	fseeko( fout, end, SEEK_SET );
+
+	vector<char> groups;
+	vector<unsigned char> data;
+	for ( int i = 0; i < node_count; i++ ){
+		const char* list = Morton.base + Morton.offset[i];
+		int max_level, count;
+		memcpy( &max_level, list, sizeof(int) );
+		memcpy( &count, list + sizeof(int), sizeof(int) );
+		int bits = morton_path_bits( i );
+		if ( 2 * max_level + bits > 64 ){
+			printf("CANNOT PACK %s AT QUAD=%d\n", FILE_MORTON, i );
+			exit(1);
+		}
+
+		groups.clear();
+		data.clear();
+		long long z_order, last = 0;
+		int first_path;
+		for ( int b = 0; b < count; b++ ){
+			memcpy( &z_order, list + sizeof(int) * 2 + (long long)b * MORTON_BLOCK, sizeof(long long) );
+			memcpy( &first_path, list + sizeof(int) * 2 + (long long)b * MORTON_BLOCK + sizeof(long long), sizeof(int) );
+			int index = 0;
+			while( index < Nodes[i].adjnodes.size() && Nodes[i].adjnodes[index] != first_path ) index++;
+			if ( index == Nodes[i].adjnodes.size() ){
+				printf("CANNOT PACK %s AT QUAD=%d\n", FILE_MORTON, i );
+				exit(1);
+			}
+			if ( b % MORTON_GROUP == 0 ){
+				int pos = data.size();
+				groups.insert( groups.end(), (char*)&z_order, (char*)&z_order + sizeof(long long) );
+				groups.insert( groups.end(), (char*)&pos, (char*)&pos + sizeof(int) );
+				last = z_order;
+			}
+			morton_put_varint( data, ( (unsigned long long)( z_order - last ) << bits ) | index );
+			last = z_order;
+		}
+		fwrite( &max_level, sizeof(int), 1, fout );
+		fwrite( &count, sizeof(int), 1, fout );
+		fwrite( groups.data(), 1, groups.size(), fout );
+		fwrite( data.data(), 1, data.size(), fout );
+		table[2*i] = end;
+		table[2*i+1] = Morton.block[i];
+		end += sizeof(int) * 2 + groups.size() + data.size();
+	}
+	fseeko( fout, 0, SEEK_SET );
+	fwrite( &magic, sizeof(int), 1, fout );
+	fwrite( &node_count, sizeof(int), 1, fout );
+	fwrite( &blocks, sizeof(long long), 1, fout );
+	fwrite( table.data(), sizeof(long long), table.size(), fout );
+	if ( fclose( fout ) != 0 || rename( file_pack, FILE_MORTON ) != 0 ){
+		printf("CANNOT WRITE %s\n", FILE_MORTON );
+		exit(1);
+	}
+	remove( file_idx );
+	printf("PACKED %lld BYTES TO %lld\n", Morton.size, end );
+}
+
+
+// least lambda- over the blocks of the list of src that have an interval, 0 if none: no
+// node is nearer to src than it times the euclidean distance
+float morton_lambda_min( int src ){
+	if ( Morton.lambda_min[src] >= 0 ) return Morton.lambda_min[src];
+	int count;
+	memcpy( &count, Morton.base + Morton.offset[src] + sizeof(int), sizeof(int) );
+	float m = -1;
+	for ( long long b = Morton.block[src]; b < Morton.block[src] + count; b++ ){
+		if ( Morton.lambda[2*b+1] > 0 && ( m < 0 || Morton.lambda[2*b] < m ) ) m = Morton.lambda[2*b];
+	}
+	return Morton.lambda_min[src] = m < 0 ? 0 : m;
+}
+
+double get_euclidean_dis( int src, int dest );
+
+// lambda interval of each block of the list of src: the least and the greatest ratio of
+// network to euclidean distance over the nodes in the block(lambda- and lambda+ of the SILC
+// paper), rounded outwards to floats, 0, 0 for a block no node falls in. dis(v) is the
+// network distance of v from src, < 0 if not reached
+template<class F>
+void morton_list_lambda( int src, MortonList& morton_list, F dis, vector<float>& lambda ){
+	int count = morton_list.array.size();
+	vector<double> lo( count, MAX_INF ), hi( count, 0 );
+	for ( int j = 0; j < Nodes.size(); j++ ){
+		double d = dis( j );
+		double e = get_euclidean_dis( src, j );
+		if ( j == src || d < 0 || e <= 0 ) continue;
+		long long z_order = morton_shift( j, morton_list.max_level );
+		int pos = 0;
+		for ( int n = count; n > 1; ){
+			int half = n / 2;
+			pos = morton_list.array[pos + half].z_order <= z_order ? pos + half : pos;
+			n -= half;
+		}
+		if ( d / e < lo[pos] ) lo[pos] = d / e;
+		if ( d / e > hi[pos] ) hi[pos] = d / e;
+	}
+	lambda.assign( 2 * count, 0 );
+	for ( int b = 0; b < count; b++ ){
+		if ( hi[b] == 0 ) continue;
+		float l = lo[b], h = hi[b];
+		lambda[2*b] = l > lo[b] ? nextafterf( l, 0 ) : l;
+		lambda[2*b+1] = h < hi[b] ? nextafterf( h, MAX_INF ) : h;
+	}
 }
 
 typedef struct{
@@ -489,24 +930,23 @@ void get_morton_list_by_quadtree( QuadTree& qt, MortonList& morton_list ){
 
 	// init result list
 	vector<MortonBlock> rst;
+	vector<int> rst_level;
 	int max_level = 0;
 	
-	// init get max level of quad tree;
-	for ( int i = 0; i < qt.size(); i++ ){
-		if ( qt[i].level > max_level ) max_level = qt[i].level;
-	}
-	
-	// hierarchy traversal
+	// hierarchy traversal(the max level of the tree as slimmed, quadtree_slim leaves
+	// the nodes it cut off in qt)
 	while( !stk.empty() ){
 		Stack_Status top = stk.top();
 		stk.pop();
+		if ( qt[top.id].level > max_level ) max_level = qt[top.id].level;
 		// if leaf, then add to rst
 		if ( qt[top.id].isleaf ){
 			if ( qt[top.id].first_path != -1 ){
 				MortonBlock mb;
-			    mb.z_order = top.z_order_start << ( 2 * ( max_level - qt[top.id].level ) );
+			    mb.z_order = top.z_order_start;
 				mb.first_path = qt[top.id].first_path;
 				rst.push_back( mb );
+				rst_level.push_back( qt[top.id].level );
 			}		
 		}
 		else{
@@ -517,6 +957,10 @@ void get_morton_list_by_quadtree( QuadTree& qt, MortonList& morton_list ){
 		}
 	}
 	
+	for ( int i = 0; i < rst.size(); i++ ){
+		rst[i].z_order <<= 2 * ( max_level - rst_level[i] );
+	}
+
 	// merge siblings
 	morton_list.max_level = max_level;
 	morton_list.array.clear();
@@ -563,21 +1007,122 @@ void print_morton_list(MortonList& morton_list){
 	printf("\n----------\n");
 }
 
-void build(){
-	FILE *fout = fopen( FILE_MORTON, "wb" );
+// ----- BUILD -----
+// -j N: build threads, sources handed out in order by parallel_for(see ../common/task_pool.h),
+// each thread with its own search scratch and quad tree. the lists are written in source
+// order by whichever thread finishes the next one. FILE_MORTON.idx is the offset table:
+// a graph fingerprint, then the end offset of every list written. it is flushed with
+// FILE_MORTON every CHECKPOINT lists, a build stopped half way resumes after the last
+// list in the table
+// -d: first paths by dijkstra_first_path instead of SPFA_first_path
+// -p: dijkstra coloring the quad tree in the search pass, each node added as it is settled,
+// instead of adding the nodes by id from the first path array
+int build_threads = 1;
+bool build_dijkstra = false;
+bool build_one_pass = false;
+#define CHECKPOINT 256
+#define BUILD_WINDOW 1024	// lists built ahead of the writer at most
+
+long long graph_fingerprint(){
+	unsigned long long h = 14695981039346656037ULL;
+	for ( int i = 0; i < Nodes.size(); i++ ){
+		for ( int j = 0; j < Nodes[i].adjnodes.size(); j++ ){
+			h = ( h ^ (unsigned)Nodes[i].adjnodes[j] ) * 1099511628211ULL;
+			h = ( h ^ (unsigned)Nodes[i].adjweight[j] ) * 1099511628211ULL;
+		}
+		h = ( h ^ (unsigned)i ) * 1099511628211ULL;
+	}
+	return (long long)h;
+}
 
-	int * fp = new int[ Nodes.size() ];
+// lists already in FILE_MORTON by its offset table, both files cut back to them
+int build_resume( FILE* &fout, FILE* &fidx, FILE* &flambda, long long &end ){
+	char file_idx[300], file_lambda[300];
+	sprintf( file_idx, "%s.idx", FILE_MORTON );
+	sprintf( file_lambda, "%s.lambda", FILE_MORTON );
+	int node_count = Nodes.size();
+	long long fingerprint = graph_fingerprint();
+	int done = 0;
+	end = 0;
+
+	fidx = fopen( file_idx, "r+b" );
+	fout = fopen( FILE_MORTON, "r+b" );
+	flambda = fopen( file_lambda, "r+b" );
+	int count;
+	long long fp, offset;
+	if ( fidx != NULL && fout != NULL && flambda != NULL &&
+		fread( &count, sizeof(int), 1, fidx ) == 1 && count == node_count &&
+		fread( &fp, sizeof(long long), 1, fidx ) == 1 && fp == fingerprint ){
+		while( done < node_count && fread( &offset, sizeof(long long), 1, fidx ) == 1 ){
+			done++;
+			end = offset;
+		}
+	}
+	// lambda intervals of the blocks written
+	long long lambda_end = ( end - (long long)sizeof(int) * 2 * done ) / MORTON_BLOCK * 2 * sizeof(float);
+	if ( flambda != NULL ){
+		fseeko( flambda, 0, SEEK_END );
+		if ( ftello( flambda ) < lambda_end ) done = 0;
+	}
+	if ( done == 0 || done == node_count ){
+		// nothing to resume(or a finished build): start over
+		if ( fidx != NULL ) fclose( fidx );
+		if ( fout != NULL ) fclose( fout );
+		if ( flambda != NULL ) fclose( flambda );
+		fidx = fopen( file_idx, "wb" );
+		fout = fopen( FILE_MORTON, "wb" );
+		flambda = fopen( file_lambda, "wb" );
+		fwrite( &node_count, sizeof(int), 1, fidx );
+		fwrite( &fingerprint, sizeof(long long), 1, fidx );
+		end = 0;
+		return 0;
+	}
+	fflush( fidx );
+	ftruncate( fileno(fidx), sizeof(int) + sizeof(long long) * ( 1 + done ) );
+	fseeko( fidx, 0, SEEK_END );
+	ftruncate( fileno(fout), end );
+	fseeko( fout, 0, SEEK_END );
+	fflush( flambda );
+	ftruncate( fileno(flambda), lambda_end );
+	fseeko( flambda, 0, SEEK_END );
+	printf("RESUME AT QUAD=%d\n", done );
+	return done;
+}
 
-	MortonLists.clear();
+// a list built but not written yet
+typedef struct{
+	MortonList morton_list;
+	vector<float> lambda;
+	int size;	// of the quad tree
+}Pending_List;
 
-	for ( int i = 0; i < Nodes.size(); i++ ){
-		if ( i > 999 ) break;
+void build(){
+	FILE *fout, *fidx, *flambda;
+	long long end;
+	int done = build_resume( fout, fidx, flambda, end );
+	morton_code_init();
+
+	vector<SPFA_Scratch> spfa( build_threads );
+	vector<Dijkstra_Scratch> dijkstra( build_threads );
+	vector< vector<int> > fps( build_threads, vector<int>( Nodes.size() ) );
+	vector<QuadTree> qts( build_threads );
+
+	// lists done but not written yet
+	map<int, Pending_List> pending;
+	int next_write = done;
+	mutex lock;
+	condition_variable written;
+
+	parallel_for( build_threads, Nodes.size() - done, [&]( int worker, int task ){
+		int i = done + task;
+		{
+			unique_lock<mutex> lk( lock );
+			written.wait( lk, [&](){ return i < next_write + BUILD_WINDOW; } );
+		}
 
-		// get first path first
-		SPFA_first_path( i, fp );
-		
 		// build quad tree
-		QuadTree qt;
+		QuadTree& qt = qts[worker];
+		qt.clear();
 		// init root
 		QuadTreeNode root;
 		root.llx = min_llx; root.lly = min_lly;
@@ -587,38 +1132,76 @@ void build(){
 		root.level = 0;
 		qt.push_back(root);
 
-		// start
-		for ( int j = 0; j < Nodes.size(); j++ ){
-			if ( i == j ) continue;
-			quadtree_add( j, fp[j], qt );
+		// start(the source itself and nodes not reached left out)
+		if ( build_one_pass ){
+			dijkstra_first_path( i, dijkstra[worker], [&]( int v, int first_path ){
+				quadtree_add( v, first_path, qt );
+			} );
+		}
+		else{
+			// get first path first
+			int* fp = &fps[worker][0];
+			if ( build_dijkstra ){
+				fill( fps[worker].begin(), fps[worker].end(), -1 );
+				dijkstra_first_path( i, dijkstra[worker], [&]( int v, int first_path ){
+					fp[v] = first_path;
+				} );
+			}
+			else SPFA_first_path( i, fp, spfa[worker] );
+			for ( int j = 0; j < Nodes.size(); j++ ){
+				if ( fp[j] == -1 ) continue;
+				quadtree_add( j, fp[j], qt );
+			}
 		}
 
-		// get morton list
+		// slim, then get morton list
+		int size = quadtree_slim( qt );
 		MortonList morton_list;
 		get_morton_list_by_quadtree(qt, morton_list);
 
-		// push to MortonLists
-		// MortonLists.push_back( morton_list );
-		morton_list_save( morton_list, fout );
+		// lambda intervals by the distances of the search
+		vector<float> lambda;
+		if ( build_one_pass || build_dijkstra ){
+			Dijkstra_Scratch& w = dijkstra[worker];
+			morton_list_lambda( i, morton_list, [&]( int v ){
+				return w.entry[v].stamp == w.current || w.entry[v].stamp == -w.current ? w.entry[v].dis : -1;
+			}, lambda );
+		}
+		else{
+			SPFA_Scratch& w = spfa[worker];
+			morton_list_lambda( i, morton_list, [&]( int v ){ return w.min_dis[v]; }, lambda );
+		}
 
-/*		// check 	
-		for ( int j = 0; j < Nodes.size(); j++ ){
-			if ( i == j ) continue;
-			int mp = morton_find(i,j);
-			if ( fp[j] != mp ){
-				printf("QUAD=%d J=%d FP=%d MORTON=%d\n", i, j, fp[j], mp );
+		// write the lists due, in source order
+		unique_lock<mutex> lk( lock );
+		Pending_List& p = pending[i];
+		p.morton_list.max_level = morton_list.max_level;
+		p.morton_list.array.swap( morton_list.array );
+		p.lambda.swap( lambda );
+		p.size = size;
+		while( !pending.empty() && pending.begin()->first == next_write ){
+			Pending_List& pl = pending.begin()->second;
+			morton_list_save( pl.morton_list, fout );
+			fwrite( &pl.lambda[0], sizeof(float), pl.lambda.size(), flambda );
+			end += sizeof(int) * 2 + ( sizeof(long long) + sizeof(int) ) * (long long)pl.morton_list.array.size();
+			fwrite( &end, sizeof(long long), 1, fidx );
+			printf("ADD QUAD=%d SIZE=%d BLOCKS=%d\n", next_write, pl.size, (int)pl.morton_list.array.size() );
+			pending.erase( pending.begin() );
+			next_write++;
+			if ( next_write % CHECKPOINT == 0 ){
+				fflush( fout );
+				fflush( flambda );
+				fflush( fidx );
 			}
 		}
-*/	
-
-//		if ( i > 0 )break;
-
-		printf("ADD QUAD=%d SIZE=%d\n", i, (int)qt.size() );
+		written.notify_all();
+	} );
 
-	}	
-
-	delete[] fp;
 	fclose(fout);
+	fclose(flambda);
+	fclose(fidx);
+	long long blocks = ( end - (long long)sizeof(int) * 2 * Nodes.size() ) / MORTON_BLOCK;
+	printf("BLOCKS=%lld PER_QUAD=%.2lf BYTES=%lld\n", blocks, (double)blocks / Nodes.size(), end );
 }
 
 typedef struct{
@@ -641,6 +1224,16 @@ double get_euclidean_dis( int src, int dest ){
 	return sqrt((Nodes[src].x - Nodes[dest].x) * (Nodes[src].x - Nodes[dest].x) + (Nodes[src].y - Nodes[dest].y) * (Nodes[src].y - Nodes[dest].y));
 }
 
+// weight of edge current -> next(shortest of parallel edges)
+int get_edge_weight( int current, int next ){
+	int w = -1;
+	for ( int i = 0; i < Nodes[current].adjnodes.size(); i++ ){
+		if ( Nodes[current].adjnodes[i] == next && ( w < 0 || Nodes[current].adjweight[i] < w ) ) w = Nodes[current].adjweight[i];
+	}
+	return w;
+}
+
+// network distance along the first hops, edge weights summed(euclidean hops only when weights are euclidean)
 double get_graph_dis( int src, int dest ){
 	int current = src;
 	int next;
@@ -648,73 +1241,328 @@ double get_graph_dis( int src, int dest ){
 
 	while( current != dest ){
 		next = morton_find( current, dest );
-		rst += get_euclidean_dis(current, next);
+		rst += get_edge_weight(current, next);
 		current = next;
 	}
 
 	return rst;
 }
 
-void knn_query( int src, int K, vector<int>& cands, vector<int> &result ){
-	vector<Search_Status> l;
-	int pos = 0;
+// ----- OBJECT GRID -----
+// the candidates of knn_query bucketed in a uniform grid over the bounding box of the graph,
+// built once per object set(the same vector from query to query), so a query takes them in
+// euclidean order from its node a ring of cells at a time(ObjectStream) instead of sorting
+// them all, and only the rings its answers reach are looked at
+typedef struct{
+	const int* cands;	// object set it was built for
+	int count;
+	int side;	// cells per row and column
+	double cell_x, cell_y;
+	vector<int> start;	// objects of cell c in ids[start[c], start[c+1])
+	vector<int> ids;
+}ObjectGrid;
+ObjectGrid Objects = { NULL, 0 };
+
+int object_grid_cell( double v, double low, double cell ){
+	int c = cell > 0 ? (int)( ( v - low ) / cell ) : 0;
+	return c < 0 ? 0 : ( c >= Objects.side ? Objects.side - 1 : c );
+}
+
+void object_grid_build( const vector<int>& cands ){
+	Objects.cands = cands.data();
+	Objects.count = cands.size();
+	Objects.side = (int)sqrt( cands.size() / 2.0 );
+	if ( Objects.side < 1 ) Objects.side = 1;
+	Objects.cell_x = ( max_urx - min_llx ) / Objects.side;
+	Objects.cell_y = ( max_ury - min_lly ) / Objects.side;
+
+	// counting sort by cell
+	vector<int> cell( cands.size() );
+	Objects.start.assign( Objects.side * Objects.side + 1, 0 );
 	for ( int i = 0; i < cands.size(); i++ ){
-		Search_Status current = { cands[i], get_euclidean_dis(src, cands[i]) }; 
-		l.push_back( current );
+		cell[i] = object_grid_cell( Nodes[cands[i]].y, min_lly, Objects.cell_y ) * Objects.side +
+			object_grid_cell( Nodes[cands[i]].x, min_llx, Objects.cell_x );
+		Objects.start[cell[i] + 1]++;
+	}
+	for ( int c = 0; c < Objects.side * Objects.side; c++ ) Objects.start[c + 1] += Objects.start[c];
+	Objects.ids.resize( cands.size() );
+	vector<int> fill( Objects.start.begin(), Objects.start.end() - 1 );
+	for ( int i = 0; i < cands.size(); i++ ) Objects.ids[fill[cell[i]]++] = cands[i];
+}
+
+// the objects in euclidean order from src: those of the cells within ring of the cell of src
+// are in the heap, any other is at least as far as the border of that square of cells
+typedef struct{
+	int src;
+	int cx, cy, ring;
+	vector< pair<double,int> > heap;	// min heap of euclidean distance, object
+}ObjectStream;
+
+void object_stream_ring( ObjectStream& s ){
+	for ( int dy = -s.ring; dy <= s.ring; dy++ ){
+		int y = s.cy + dy;
+		if ( y < 0 || y >= Objects.side ) continue;
+		int step = ( dy == -s.ring || dy == s.ring ) ? 1 : 2 * s.ring;
+		for ( int dx = -s.ring; dx <= s.ring; dx += step > 0 ? step : 1 ){
+			int x = s.cx + dx;
+			if ( x < 0 || x >= Objects.side ) continue;
+			for ( int i = Objects.start[y * Objects.side + x]; i < Objects.start[y * Objects.side + x + 1]; i++ ){
+				s.heap.push_back( make_pair( get_euclidean_dis( s.src, Objects.ids[i] ), Objects.ids[i] ) );
+				push_heap( s.heap.begin(), s.heap.end(), greater< pair<double,int> >() );
+			}
+		}
+	}
+}
+
+void object_stream_init( ObjectStream& s, int src ){
+	s.src = src;
+	s.cx = object_grid_cell( Nodes[src].x, min_llx, Objects.cell_x );
+	s.cy = object_grid_cell( Nodes[src].y, min_lly, Objects.cell_y );
+	s.ring = 0;
+	s.heap.clear();
+	object_stream_ring( s );
+}
+
+// euclidean distance of the next object, MAX_INF if there is none
+double object_stream_peek( ObjectStream& s ){
+	double x = Nodes[s.src].x, y = Nodes[s.src].y;
+	while( true ){
+		double border = MAX_INF;
+		if ( s.cx - s.ring > 0 ) border = min( border, x - ( min_llx + ( s.cx - s.ring ) * Objects.cell_x ) );
+		if ( s.cx + s.ring < Objects.side - 1 ) border = min( border, min_llx + ( s.cx + s.ring + 1 ) * Objects.cell_x - x );
+		if ( s.cy - s.ring > 0 ) border = min( border, y - ( min_lly + ( s.cy - s.ring ) * Objects.cell_y ) );
+		if ( s.cy + s.ring < Objects.side - 1 ) border = min( border, min_lly + ( s.cy + s.ring + 1 ) * Objects.cell_y - y );
+		if ( !s.heap.empty() && s.heap[0].first <= border ) return s.heap[0].first;
+		if ( border >= MAX_INF ) return MAX_INF;
+		s.ring++;
+		object_stream_ring( s );
+	}
+}
+
+// the next object, after object_stream_peek found one
+int object_stream_next( ObjectStream& s ){
+	pop_heap( s.heap.begin(), s.heap.end(), greater< pair<double,int> >() );
+	int id = s.heap.back().second;
+	s.heap.pop_back();
+	return id;
+}
+
+// a candidate of knn_query walked up to current, its distance in [lo, hi]
+typedef struct{
+	int id;
+	int current;
+	long long block;	// of the list of current covering id, -1 if none
+	double walked;	// network distance src -> current
+	double lo, hi;
+}Refine_Status;
+
+typedef struct{
+	bool operator()( const Refine_Status& l, const Refine_Status& r ){
+		return l.lo > r.lo;
 	}
-	sort( l.begin(), l.end(), l_compare );
+}Refine_Status_Comp;
+
+// bounds of a candidate at its current node: the walk so far plus the lambda interval of
+// the block(see morton_list_lambda) times the euclidean distance left, or the euclidean
+// distance left alone as the lower bound if the store has no intervals(weights no shorter
+// than the straight line). the bounds only tighten
+void refine_bounds( Refine_Status& c ){
+	if ( c.current == c.id ){
+		c.lo = c.hi = c.walked;
+		return;
+	}
+	c.block = morton_block( c.current, c.id );
+	double e = get_euclidean_dis( c.current, c.id );
+	double lo = c.walked + e, hi = MAX_INF;
+	if ( Morton.lambda != NULL ){
+		lo = c.walked;
+		if ( c.block >= 0 && e > 0 && Morton.lambda[2*c.block+1] > 0 ){
+			lo = c.walked + Morton.lambda[2*c.block] * e * ( 1 - 1e-9 );
+			hi = c.walked + Morton.lambda[2*c.block+1] * e * ( 1 + 1e-9 );
+		}
+	}
+	if ( lo > c.lo ) c.lo = lo;
+	if ( hi < c.hi ) c.hi = hi;
+}
+
+// best first refinement(SILC): the candidate of the least lower bound walks one hop
+// at a time, it is the next nearest once its upper bound is no more than the lower
+// bound of every other candidate(always when it reaches its node). the candidates
+// join in euclidean order(ObjectStream) while the next could have a lower bound less
+// than the least so far, scale times its euclidean distance
+void knn_query( int src, int K, vector<int>& cands, vector<int> &result ){
+	if ( Objects.cands != cands.data() || Objects.count != cands.size() ) object_grid_build( cands );
 	result.clear();
 
 	// time start here!
 	TIME_TICK_START
 
-	vector<Search_Status> pq;
-	while( pos < cands.size() && result.size() < K ){
-		if ( pq.empty() ){
-			Search_Status top = { l[pos].id, get_graph_dis(src, l[pos].id) };
-			pq.push_back(top);
-			make_heap( pq.begin(), pq.end(), Search_Status_Comp() );
-			pos ++;
+	double scale = Morton.lambda != NULL ? morton_lambda_min( src ) * ( 1 - 1e-9 ) : 1;
+	ObjectStream s;
+	object_stream_init( s, src );
+	vector<Refine_Status> pq;
+	while( result.size() < K ){
+		double e = object_stream_peek( s );
+		while( e < MAX_INF && ( pq.empty() || scale * e <= pq[0].lo ) ){
+			Refine_Status c = { object_stream_next( s ), src, -1, 0, 0, MAX_INF };
+			refine_bounds( c );
+			pq.push_back( c );
+			push_heap( pq.begin(), pq.end(), Refine_Status_Comp() );
+			e = object_stream_peek( s );
 		}
-		else{
-			if ( l[pos].dis < pq[0].dis ){
-				Search_Status top = { l[pos].id, get_graph_dis(src, l[pos].id) };
-				pq.push_back(top);
-				make_heap( pq.begin(), pq.end(), Search_Status_Comp() );
-				pos ++;
-			}
-			else{
-				result.push_back( pq[0].id );
-				pop_heap( pq.begin(), pq.end(), Search_Status_Comp() );
-				pq.pop_back();
-			}
-		}
-		/*Search_Status top = pq[0];
-		pop_heap( pq.begin(), pq.end(), Search_Status_Comp() );
+		if ( pq.empty() ) break;
+
+		pop_heap( pq.begin(), pq.end(), Refine_Status_Comp() );
+		Refine_Status c = pq.back();
 		pq.pop_back();
+		double next = e < MAX_INF ? scale * e : MAX_INF;
+		if ( !pq.empty() && pq[0].lo < next ) next = pq[0].lo;
+		if ( c.current == c.id || c.hi <= next ){
+			result.push_back( c.id );
+			continue;
+		}
 
-		if ( top.isgd ){
-			result.push_back( top.id );
+		// one hop further
+		int n = morton_block_first_path( c.current, c.block );
+		c.walked += get_edge_weight( c.current, n );
+		c.current = n;
+		refine_bounds( c );
+		pq.push_back( c );
+		push_heap( pq.begin(), pq.end(), Refine_Status_Comp() );
+	}
+}
+
+// benchmark(../bench/bench.sh): objects "vid oid", queries "locid K",
+// per query "ID=vid DIS=d" per answer and the time line, as gtree_query
+void knn_bench( const char* object_file, const char* query_file, const char* stats_file ){
+	vector<int> o, result;
+	int oid, id, locid, K;
+	FILE* fin = fopen( object_file, "r" );
+	if ( fin == NULL ){
+		printf("CANNOT OPEN %s\n", object_file );
+		exit(1);
+	}
+	while( fscanf(fin,"%d %d", &oid, &id ) == 2 ){
+		o.push_back(oid);
+	}
+	fclose( fin );
+	fin = fopen( query_file, "r" );
+	if ( fin == NULL ){
+		printf("CANNOT OPEN %s\n", query_file );
+		exit(1);
+	}
+	const char* const phase_names[1] = { "total" };
+	QueryStats* stats = NULL;
+	if ( stats_file != NULL ){
+		stats = new QueryStats;
+		stats_init( *stats );
+	}
+	while( fscanf(fin, "%d %d", &locid, &K ) == 2 ){
+		stats_begin( stats );
+		long long t0 = stats_now();
+		knn_query(locid, K, o, result);
+		TIME_TICK_END
+		stats_add( stats, 0, stats_now() - t0 );
+		stats_end( stats, 1 );
+		for ( int i = 0; i < result.size(); i++ ){
+			printf("ID=%d DIS=%d\n", result[i], (int)get_graph_dis(locid, result[i]) );
 		}
-		else{
-			top.dis = get_graph_dis( src, top.id );
-			top.isgd = true;		
-			pq.push_back(top);
-			make_heap( pq.begin(), pq.end(), Search_Status_Comp() );
-		}*/
+		TIME_TICK_PRINT("KNN_SEARCH")
 	}
-	
-	/*
-	for ( int i = 0 ; i < result.size(); i++ ){
-		printf("ID=%d DIS=%lf\n", result[i], get_graph_dis(src,result[i]));
+	fclose( fin );
+	if ( stats != NULL && ! stats_json_save( stats_file, *stats, phase_names, 1, NULL, 0 ) ){
+		printf("CANNOT WRITE %s\n", stats_file );
 	}
-	*/
-	
 }
 
-int main(){
+// paths(-r): pairs "src dest"(query_path), per pair "DIS=d PATH=src ... dest", "DIS=-1" if
+// not reached, and the time line
+void path_bench( const char* path_file, const char* stats_file ){
+	FILE* fin = fopen( path_file, "r" );
+	if ( fin == NULL ){
+		printf("CANNOT OPEN %s\n", path_file );
+		exit(1);
+	}
+	const char* const phase_names[1] = { "total" };
+	QueryStats* stats = NULL;
+	if ( stats_file != NULL ){
+		stats = new QueryStats;
+		stats_init( *stats );
+	}
+	vector<int> path( Nodes.size() );
+	int src, dest;
+	while( fscanf(fin, "%d %d", &src, &dest ) == 2 ){
+		stats_begin( stats );
+		long long t0 = stats_now();
+		TIME_TICK_START
+		int n = silc_path( src, dest, &path[0], path.size() );
+		TIME_TICK_END
+		stats_add( stats, 0, stats_now() - t0 );
+		stats_end( stats, 1 );
+		long long dis = n < 0 ? -1 : 0;
+		for ( int i = 0; i + 1 < n; i++ ) dis += get_edge_weight( path[i], path[i+1] );
+		printf("DIS=%lld", dis );
+		if ( n > 0 ) printf(" PATH=");
+		for ( int i = 0; i < n; i++ ) printf( i > 0 ? " %d" : "%d", path[i] );
+		printf("\n");
+		TIME_TICK_PRINT("PATH_SEARCH")
+	}
+	fclose( fin );
+	if ( stats != NULL && ! stats_json_save( stats_file, *stats, phase_names, 1, NULL, 0 ) ){
+		printf("CANNOT WRITE %s\n", stats_file );
+	}
+}
+
+// usage: silc [-j N] [-d|-p] [-z] [-r] [FILE_NODE FILE_EDGE WEIGHT_INFLATE_FACTOR FILE_MORTON BUILD [FILE_OBJECT FILE_QUERY [FILE_STATS]]]
+//	-j N: build with N threads, -d: dijkstra first paths, -p: and quad trees colored in the search pass(see build)
+//	BUILD = 1: build FILE_MORTON first(resuming a stopped build), then exit unless FILE_OBJECT, FILE_QUERY are given
+//	-z: pack FILE_MORTON(see morton_pack) after the build if any
+//	-r FILE_NODE FILE_EDGE WEIGHT_INFLATE_FACTOR FILE_MORTON BUILD FILE_PATH [FILE_STATS]: expand paths(path_bench)
+//	FILE_OBJECT, FILE_QUERY: answer the queries(knn_bench) instead of the experiment below
+int main( int argc, char* argv[] ){
+	// options out of the positional arguments
+	int args = 1;
+	bool pack = false, paths = false;
+	for ( int i = 1; i < argc; i++ ){
+		if ( strcmp( argv[i], "-j" ) == 0 && i + 1 < argc ){
+			build_threads = atoi( argv[++i] );
+			if ( build_threads < 1 ) build_threads = 1;
+		}
+		else if ( strcmp( argv[i], "-d" ) == 0 ) build_dijkstra = true;
+		else if ( strcmp( argv[i], "-p" ) == 0 ) build_one_pass = true;
+		else if ( strcmp( argv[i], "-z" ) == 0 ) pack = true;
+		else if ( strcmp( argv[i], "-r" ) == 0 ) paths = true;
+		else argv[args++] = argv[i];
+	}
+	argc = args;
+
+	if ( argc >= 6 ){
+		strcpy( FILE_NODE, argv[1] );
+		strcpy( FILE_EDGE, argv[2] );
+		WEIGHT_INFLATE_FACTOR = atoi( argv[3] );
+		strcpy( FILE_MORTON, argv[4] );
+	}
 	init();
 
+	if ( argc >= 6 && atoi( argv[5] ) == 1 ){
+		TIME_TICK_START
+		build();
+		TIME_TICK_END
+		TIME_TICK_PRINT("BUILD");
+	}
+	if ( argc >= 6 && pack ) morton_pack();
+	if ( argc >= 7 && paths ){
+		morton_load();
+		path_bench( argv[6], argc >= 8 ? argv[7] : NULL );
+		return 0;
+	}
+	if ( argc >= 8 ){
+		morton_load();
+		knn_bench( argv[6], argv[7], argc >= 9 ? argv[8] : NULL );
+		return 0;
+	}
+	if ( argc >= 6 ) return 0;
+
 /*	TIME_TICK_START	
 	build();
 	TIME_TICK_END
@@ -996,89 +996,97 @@ double get_graph_dis( int src, int dest ){
 
 
 
-void knn_query( int src, int K, vector<int>& cands, vector<int> &result ){
+// a candidate of knn_query walked up to current: the hops so far plus the straight
 
-//	TIME_TICK_START
+// line left bound its distance from below
 
-	vector<Search_Status> l;
+typedef struct{
+
+	int id;
+
+	int current;
+
+	double walked;
+
+	double lo;
+
+}Refine_Status;
 
-	int pos = 0;
 
-	for ( int i = 0; i < cands.size(); i++ ){
 
-		Search_Status current = { cands[i], get_euclidean_dis(src, cands[i]) }; 
+typedef struct{
+
+	bool operator()( const Refine_Status& l, const Refine_Status& r ){
 
-		l.push_back( current );
+		return l.lo > r.lo;
 
 	}
 
-	sort( l.begin(), l.end(), l_compare );
+}Refine_Status_Comp;
 
-	result.clear();
 
-//	TIME_TICK_END
 
-//	TIME_TICK_PRINT("pre")
+// best first refinement: the candidate of the least bound walks one hop at a time
 
-//	cout<<"Enclidean done"<<endl;
+// instead of its whole path at once, it is the next nearest once it reaches its node
 
-	// time start here!
+void knn_query( int src, int K, vector<int>& cands, vector<int> &result ){
 
-//	TIME_TICK_START
+	vector<Refine_Status> pq;
 
-	vector<Search_Status> pq;
+	for ( int i = 0; i < cands.size(); i++ ){
 
-	while( pos < cands.size() && result.size() < K ){
+		Refine_Status current = { cands[i], src, 0, get_euclidean_dis(src, cands[i]) };
 
-		// printf("pq=%d result=%d\n", pq.size(), result.size());
+		pq.push_back( current );
 
+	}
 
+	make_heap( pq.begin(), pq.end(), Refine_Status_Comp() );
 
-		if ( pq.empty() ){
+	result.clear();
 
-			Search_Status top = { l[pos].id, get_graph_dis(src, l[pos].id) };
 
-			pq.push_back(top);
 
-			make_heap( pq.begin(), pq.end(), Search_Status_Comp() );
+	// time start here!
 
-			pos ++;
+	while( !pq.empty() && result.size() < K ){
 
-		}
+		pop_heap( pq.begin(), pq.end(), Refine_Status_Comp() );
 
-		else{
+		Refine_Status top = pq.back();
 
-			if ( l[pos].dis < pq[0].dis ){
+		pq.pop_back();
 
-				Search_Status top = { l[pos].id, get_graph_dis(src, l[pos].id) };
+		if ( top.current == top.id ){
 
-				pq.push_back(top);
+			result.push_back( top.id );
 
-				make_heap( pq.begin(), pq.end(), Search_Status_Comp() );
+			continue;
 
-				pos ++;
+		}
 
-			}
 
-			else{
 
-				result.push_back( pq[0].id );
+		int next = morton_find( top.current, top.id );
 
-				pop_heap( pq.begin(), pq.end(), Search_Status_Comp() );
+		top.walked += get_euclidean_dis( top.current, next );
 
-				pq.pop_back();
+		top.current = next;
 
-			}
+		top.lo = top.walked + get_euclidean_dis( next, top.id );
 
-		}
+		pq.push_back( top );
+
+		push_heap( pq.begin(), pq.end(), Refine_Status_Comp() );
 
 	}
 
-//	TIME_TICK_END
+}
+
+
 
-//	TIME_TICK_PRINT("cal")
 
-}
 
 
 